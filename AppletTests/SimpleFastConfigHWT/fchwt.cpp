@@ -17,15 +17,21 @@
 #define WIDTH 512
 #define HEIGHT 512
 
+// 1 to trigger from the NI-DAQ with TriggerSource, 0 for any external trigger
+#define USE_TRIGGER_SOURCE 1
+
 #define DAQ_PIN "Dev4/ctr0"
-#define BUF_SIZE 2048
-// min = 2.5e-8 s, max = 53.6871 s for SIG_DELAY, HI_TIME, LO_TIME
+#define DAQ_STAMP_PIN "Dev4/ctr1" // measures the periods of DAQ_PIN
+#define DAQ_STAMP_TERM "/Dev4/Ctr0InternalOutput"
+// min = 2.5e-8 s, max = 53.6871 s for SIG_DELAY and the high and low times
 #define SIG_DELAY 0
-#define HI_TIME 4e-3//120e-9
-#define LO_TIME 235e-6//120e-9
+#define TRIGGER_FREQ 20 // Hz, below 1/EXPOSURE
+#define TRIGGER_FREQ2 40 // Hz, from half of the images on
+#define TRIGGER_DUTY 0.05
+#define NUM_TRIGGERS 1000
 
 #include <stdio.h>
-#include <NIDAQmx.h>
+#include "TriggerSource.h"
 
 int FCInit(Fg_Struct *fg, int w, int h)
 {
@@ -64,33 +70,16 @@ int FCInit(Fg_Struct *fg, int w, int h)
 	return FG_OK;
 }
 
-#if 0
+#if USE_TRIGGER_SOURCE
+// the pulses of TriggerSource, their stamps paired with the grabber timestamps
 int main(void)
 {
-	char errBuff[BUF_SIZE]={'\0'};
-	TaskHandle taskHandle = 0;
-	int i, rc;
-	unsigned __int64 freq, loop_start, loop_stop;
-	double dur;
+	TriggerSource trig;
+	TriggerSource::Config cfg;
+	TriggerSource::Jitter jit;
 	Fg_Struct *fg = NULL;
-	IplImage *cvDisplay = NULL;
-	unsigned char *img;
-	int j, k;
-	int mode, w, h, nr;
-
-	/*
-	rc = SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS );
-	if(rc == FALSE) {
-      return GetLastError();
-   } 
-   */
-
-	/*
-	rc = SetThreadPriority(GetCurrentThread(), HIGH_PRIORITY_CLASS);
-	if(rc == FALSE) {
-      return GetLastError();
-   }
-   */
+	int rc, mode, w, h, nr;
+	__int64 ts;
 
 	w = WIDTH;
 	h = HEIGHT;
@@ -121,7 +110,6 @@ int main(void)
 
 	// the following pinouts pertain to PORTA (sub-D15 labelled L1 on the meIV TTL output card)
 	rc = TRGINSRC_1; // pin 12 on meIV TTL output card (compatible with meIII FG board)
-	rc = TRGINSRC_0; // pin 11 on meIV TTL output card (compatible with meIII FG board)
 	if(Fg_setParameter(fg, FG_TRIGGERINSRC, &rc, PORT_A) < 0) {
 		printf("trig in: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
@@ -136,14 +124,6 @@ int main(void)
 		return rc;
 	}
 
-    rc = FG_ON;
-	if(Fg_setParameter(fg, FG_EXSYNCINVERT, &rc, PORT_A) < 0) {
-		printf("sync invert: %s\n", Fg_getLastErrorDescription(fg));
-		rc = Fg_getLastErrorNumber(fg);
-		Fg_FreeGrabber(fg);
-		return rc;
-	}
-
 	if(Fg_AllocMem(fg, w*h*NUM_BUFFERS, NUM_BUFFERS, PORT_A) == NULL){
 		printf("mem: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
@@ -151,105 +131,74 @@ int main(void)
 		return rc;
 	}
 
-    if(FCInit(fg, w, h) != FG_OK) {
+	if(FCInit(fg, w, h) != FG_OK) {
 		printf("FCInit: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-        FastConfigFree(PORT_A);
+		FastConfigFree(PORT_A);
 		Fg_FreeGrabber(fg);
 		return rc;
-    }
+	}
 
 	if(Fg_Acquire(fg, PORT_A, NUM_IMAGES) < 0){
 		printf("acq: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-        FastConfigFree(PORT_A);
+		FastConfigFree(PORT_A);
 		Fg_FreeGrabber(fg);
 		return rc;
 	}
 
-	cvDisplay = cvCreateImage(cvSize(w, h), 8, 1);
-	cvNamedWindow(WINDOW, CV_WINDOW_AUTOSIZE);
-
-	rc = DAQmxCreateTask("", &taskHandle);
-	if(rc < 0) {
-		DAQmxGetExtendedErrorInfo(errBuff, BUF_SIZE);
-		printf("create daq task %s\n", errBuff);
-		return rc;
-	}
-
-	rc = DAQmxCreateCOPulseChanTime(taskHandle, DAQ_PIN, "", DAQmx_Val_Seconds, DAQmx_Val_Low, SIG_DELAY, LO_TIME, HI_TIME);
-	if(rc < 0) {
-		DAQmxGetExtendedErrorInfo(errBuff, BUF_SIZE);
-		printf("create pulse task %s\n", errBuff);
-		DAQmxStopTask(taskHandle);
-		DAQmxClearTask(taskHandle);
-		return rc;
-	}
-
-	/*
-	rc = DAQmxCfgImplicitTiming(taskHandle, DAQmx_Val_FiniteSamps , 2000);
-	if(rc < 0) {
-		DAQmxGetExtendedErrorInfo(errBuff, BUF_SIZE);
-		printf("implicit timing %s\n", errBuff);
-		DAQmxStopTask(taskHandle);
-		DAQmxClearTask(taskHandle);
-		return rc;
+	cfg = TriggerSource::defaults();
+	cfg.counter = DAQ_PIN;
+	cfg.stampCounter = DAQ_STAMP_PIN;
+	cfg.stampTerm = DAQ_STAMP_TERM;
+	cfg.freq = TRIGGER_FREQ;
+	cfg.duty = TRIGGER_DUTY;
+	cfg.delay = SIG_DELAY;
+	cfg.pulses = NUM_TRIGGERS;
+	if(!trig.open(cfg) || !trig.start()) {
+		FastConfigFree(PORT_A);
+		Fg_FreeGrabber(fg);
+		return -1;
 	}
-	*/
 
-	printf("actual \t expected \t error \n");
-	QueryPerformanceFrequency((LARGE_INTEGER *) &freq);
+	// half of the images at TRIGGER_FREQ, then at TRIGGER_FREQ2
+	printf("image \t stamp \t fg timestamp\n");
 	nr = 0;
-	for(i = 0; i < 30; i++) {
-		QueryPerformanceCounter((LARGE_INTEGER *) &loop_start);
-		if(DAQmxStartTask(taskHandle) < 0) {
-			DAQmxGetExtendedErrorInfo(errBuff, BUF_SIZE);
-			printf("start pulse task %s\n", errBuff);
-			DAQmxStopTask(taskHandle);
-			DAQmxClearTask(taskHandle);
-			return rc;
+	while(nr < NUM_TRIGGERS) {
+		if(nr == NUM_TRIGGERS/2 && !trig.setFrequency(TRIGGER_FREQ2, TRIGGER_DUTY)) {
+			break;
 		}
 
-		nr++;
-		rc = Fg_getLastPicNumberBlocking(fg, nr, PORT_A, TIMEOUT);
+		rc = Fg_getLastPicNumberBlocking(fg, nr + 1, PORT_A, TIMEOUT);
 		if(rc <= FG_OK) {
 			printf("get images: %s\n", Fg_getLastErrorDescription(fg));
-			rc = Fg_getLastErrorNumber(fg);
 			break;
 		}
-
-		if(DAQmxWaitUntilTaskDone(taskHandle, TIMEOUT) < 0) {
-			DAQmxGetExtendedErrorInfo(errBuff, BUF_SIZE);
-			printf("wait pulse task %s\n", errBuff);
-			DAQmxStopTask(taskHandle);
-			DAQmxClearTask(taskHandle);
-			return rc;
+		if(rc != nr + 1) {
+			printf("lost %d images at %d, the pulses do not match any more\n", rc - nr - 1, nr + 1);
+			break;
 		}
+		nr = rc;
 
-		if(DAQmxStopTask(taskHandle) < 0) {
-			DAQmxGetExtendedErrorInfo(errBuff, BUF_SIZE);
-			printf("stop pulse task %s\n", errBuff);
-			DAQmxStopTask(taskHandle);
-			DAQmxClearTask(taskHandle);
-			return rc;
+		ts = nr;
+		if(Fg_getParameter(fg, FG_TIMESTAMP, &ts, PORT_A) < 0) {
+			printf("timestamp: %s\n", Fg_getLastErrorDescription(fg));
+			continue;
 		}
-		QueryPerformanceCounter((LARGE_INTEGER *) &loop_stop);
-
-		dur = (loop_stop - loop_start) / (freq * 1.0);
-		printf("%gs \t %gs \t %gs \n", dur, LO_TIME + HI_TIME, dur - LO_TIME - HI_TIME);
 
-		img = (unsigned char *) Fg_getImagePtr(fg, rc, PORT_A);
-		for(k = 0; k < h; k++) {
-			for(j = 0; j < w; j++) {
-				cvDisplay->imageData[j + (k * w)] = img[j + (k * w)];
-				cvDisplay->imageDataOrigin[j + (k * w)] = img[j + (k * w)];
-			}
+		trig.poll();
+		if(!trig.frame(nr, (double) ts)) {
+			printf("%d \t no stamp (%u pulses stamped)\n", nr, trig.pulses());
 		}
-
-		cvShowImage(WINDOW, cvDisplay);
-		cvWaitKey(200);
 	}
-	cvReleaseImage(&cvDisplay);
+	trig.poll();
+
+	jit = trig.jitter();
+	printf("%d images, trigger to frame %g us at the first pulse, drift %g us/s\n",
+		jit.n, jit.offset, jit.drift);
+	printf("jitter std %g us, min %g us, max %g us\n", jit.std, jit.min, jit.max);
+
+	trig.close();
 
 	if(Fg_setExsync(fg, FG_OFF, PORT_A) < 0) {
 		printf("sync off: %s\n", Fg_getLastErrorDescription(fg));
@@ -267,15 +216,12 @@ int main(void)
 		printf("free grabber: %s\n", Fg_getLastErrorDescription(fg));
 	}
 
-	DAQmxStopTask(taskHandle);
-	DAQmxClearTask(taskHandle);
-
 	return 0;
 }
 #endif
 
 
-#if 1
+#if !USE_TRIGGER_SOURCE
 
 int main(void)
 {
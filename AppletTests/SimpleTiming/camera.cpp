@@ -6,6 +6,7 @@
 #include "fgrab_prototyp.h"
 #include "fgrab_define.h"
 #include "FastConfig.h"
+#include "timing.h"
 
 #define APPLET "FastConfig.dll"
 #define WINDOW "SimpleAppletTest"
@@ -15,9 +16,7 @@
 #define PAUSE 10 // ms
 #define SHOW_DISP 0
 
-int close_cam(Fg_Struct *fg);
-int update_roi(Fg_Struct *fg, int w, int h, double e, double f);
-int open_cam(Fg_Struct **gr, int mode);
+int update_roi(Fg_Struct *fg, int label, int w, int h, double e, double f, int init);
 int get_images(Fg_Struct *fg, int num_imgs);
 int show_images(Fg_Struct *fg, int *nr, int num_images, int w, int h);
 
@@ -49,7 +48,9 @@ int update_roi(Fg_Struct *fg, int label, int w, int h, double e, double f, int i
 	return rc;
 }
 
-int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
+// mem: NULL for the buffers of Fg_Acquire(), or the buffers of
+// Fg_AcquireAPCEx() are returned in it
+int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h, void **mem)
 {
 	Fg_Struct *fg = NULL;
 	FastConfigSequence mFcs;
@@ -59,14 +60,14 @@ int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
 	if(fg == NULL) {
 		printf("init: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-		close_cam(fg);
+		close_cam(fg, NULL);
 		return rc;
 	}
 
 	if(Fg_setParameter(fg, FG_TRIGGERMODE, &mode, PORT_A) < 0) {
 		printf("mode: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-		close_cam(fg);
+		close_cam(fg, NULL);
 		return rc;
 	}
 
@@ -74,14 +75,24 @@ int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
 	if(Fg_setParameter(fg, FG_CAMERA_LINK_CAMTYP, &rc, PORT_A) < 0) {
 		printf("dual tap: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-		close_cam(fg);
+		close_cam(fg, NULL);
+		return rc;
+	}
+
+	// the pulse of the NI-DAQ counter, as in fchwt.cpp
+	// pin 12 on meIV TTL output card (compatible with meIII FG board)
+	rc = TRGINSRC_1;
+	if(mode == ASYNC_TRIGGER && Fg_setParameter(fg, FG_TRIGGERINSRC, &rc, PORT_A) < 0) {
+		printf("trig in: %s\n", Fg_getLastErrorDescription(fg));
+		rc = Fg_getLastErrorNumber(fg);
+		close_cam(fg, NULL);
 		return rc;
 	}
 
 	if(Fg_setExsync(fg, FG_ON, PORT_A) < 0) {
 		printf("sync on: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-		close_cam(fg);
+		close_cam(fg, NULL);
 		return rc;
 	}
 
@@ -90,7 +101,7 @@ int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
 	if(Fg_setParameter(fg, FG_EXSYNCINVERT, &rc, PORT_A) < 0) {
 		printf("sync invert: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-		close_cam(fg);
+		close_cam(fg, NULL);
 		return rc;
 	}
 
@@ -98,14 +109,23 @@ int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
 	if(Fg_setParameter(fg, FG_EXSYNCPOLARITY, &rc, PORT_A) < 0) {
 		printf("sync polarity: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-		close_cam(fg);
+		close_cam(fg, NULL);
 		return rc;
 	}
 
-	if(Fg_AllocMem(fg, w*h*num_images, num_images, PORT_A) == NULL) {
+	if(mem != NULL) {
+		*mem = Fg_AllocMemEx(fg, w*h*num_images, num_images);
+		if(*mem == NULL) {
+			printf("mem ex: %s\n", Fg_getLastErrorDescription(fg));
+			rc = Fg_getLastErrorNumber(fg);
+			close_cam(fg, NULL);
+			return rc;
+		}
+	}
+	else if(Fg_AllocMem(fg, w*h*num_images, num_images, PORT_A) == NULL) {
 		printf("mem: %s\n", Fg_getLastErrorDescription(fg));
 		rc = Fg_getLastErrorNumber(fg);
-		close_cam(fg);
+		close_cam(fg, NULL);
 		return rc;
 	}
 
@@ -114,7 +134,7 @@ int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
 	if(FastConfigInit(PORT_A) != FG_OK) {
         printf("fc init: %s\n", Fg_getLastErrorDescription(fg));
         rc = Fg_getLastErrorNumber(fg);
-        close_cam(fg);
+        close_cam(fg, NULL);
         return rc;
     }
 
@@ -126,7 +146,7 @@ int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
     if(Fg_setParameter(fg, FG_FASTCONFIG_SEQUENCE, &mFcs, PORT_A) != FG_OK) {
         printf("fc seq: %s\n", Fg_getLastErrorDescription(fg));
         rc = Fg_getLastErrorNumber(fg);
-        close_cam(fg);
+        close_cam(fg, NULL);
         return rc;
     }
 
@@ -136,13 +156,9 @@ int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h)
 
 int get_images(Fg_Struct *fg, int num_imgs)
 {
-	int rc;
-
 	if(Fg_Acquire(fg, PORT_A, GRAB_INFINITE) < 0) {
 		printf("acq: %s\n", Fg_getLastErrorDescription(fg));
-		rc = Fg_getLastErrorNumber(fg);
-        close_cam(fg);
-		return rc;
+		return Fg_getLastErrorNumber(fg);
 	}
 
 	return FG_OK;
@@ -169,13 +185,19 @@ int show_images(Fg_Struct *fg, int *nr, int num_imgs, int w, int h)
 	return FG_OK;
 }
 
-int close_cam(Fg_Struct *fg)
+// mem: of open_cam(), the APC has been stopped with it already
+int close_cam(Fg_Struct *fg, void *mem)
 {
 	if(Fg_setExsync(fg, FG_OFF, PORT_A) < 0) {
 		printf("sync off: %s\n", Fg_getLastErrorDescription(fg));
 	}
 
-	if(Fg_stopAcquire(fg, PORT_A) != FG_OK) {
+	if(mem != NULL) {
+		if(Fg_FreeMemEx(fg, mem) != FG_OK) {
+			printf("free mem: %s\n", Fg_getLastErrorDescription(fg));
+		}
+	}
+	else if(Fg_stopAcquire(fg, PORT_A) != FG_OK) {
 		printf("stop acq: %s\n", Fg_getLastErrorDescription(fg));
 	}
 
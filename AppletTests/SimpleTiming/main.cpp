@@ -1,62 +1,166 @@
-#include "fgrab_struct.h"
-#include "fgrab_prototyp.h"
-#include "fgrab_define.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#define NUM_IMGS 3
+#include "timing.h"
 
+// SimpleTiming [modes] [images]
+//
+// modes: any of f (free run), s (software trigger), h (hardware trigger),
+// a (APC), r (ROI writes), all by default.  Each mode runs over the grid
+// below and prints one line per ROI and exposure:
+//
+//   mode w h e received dropped missed min p50 p90 p99 max mean rate
+//
+// the latencies in us, the rate in images/s; mode is the index of bench_mode.
+// r times the landing of the ROI writes in the free run and with the software
+// trigger, with and without DO_INIT, and prints
+//
+//   mode init w h e samples never missed write_mean write_max p50 p90 p99 max
+//     interval_mean interval_max frames[1] .. frames[TAG_MAX_FRAMES]
+//
+// frames[n] the writes that were on the n-th image after them.
+// Lines starting with % are comments to importdata().
 
-#define WIDTH 524
-#define HEIGHT 1
-#define EXPOSURE 600
+#define NUM_IMGS 1000
+#define PRINT_RAW 0 // every latency after its line, sorted
+#define UPDATE_ROI 0
 
 #define MIN_EXP 1
-#define MAX_EXP 1
+#define MAX_EXP 100
 
 #define MIN_WIDTH 16
-#define MAX_WIDTH 16
+#define MAX_WIDTH 528
+#define WIDTH_STEP 128
 #define MIN_HEIGHT 1
-#define MAX_HEIGHT 1
-
-#define MIN_LENGTH 128
-#define MAX_LENGTH 128
-
-
-extern int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h);
-extern int close_cam(Fg_Struct *fg);
-extern int method1(Fg_Struct *fg, int num_imgs, int w, int h, double e, double f);
-extern int method2(Fg_Struct *fg, int num_imgs, int w, int h, double e, double f);
-extern int method3(Fg_Struct *fg, int num_imgs, int w, int h, double e, double f);
+#define MAX_HEIGHT 4
 
 int main(int argc, char *argv[])
 {
+	const char *modes = (argc > 1) ? argv[1] : "fshar";
+	const char *letters = "fsha"; // in the order of bench_mode
+	int num_imgs = (argc > 2) ? atoi(argv[2]) : NUM_IMGS;
 	Fg_Struct *fg;
-	int w,h;
-	double e;
-
-	for(e = MIN_EXP; e <= MAX_EXP; e *= 10) {
-		for(w = MIN_WIDTH; w <= MAX_WIDTH; w += 4) {
-			for(h = MIN_HEIGHT; h <= MAX_HEIGHT; h++) {
-				if(open_cam(&fg, ASYNC_SOFTWARE_TRIGGER, NUM_IMGS, w, h) == FG_OK) {
-					method2(fg, NUM_IMGS, w, h, e, e);
-					close_cam(fg);
+	void *mem;
+	bench_buffers buf;
+	bench_config c;
+	bench_result r;
+	tag_result t;
+	int tag_modes[2] = {BENCH_FREE_RUN, BENCH_SOFTWARE};
+	int init, k;
+	bench_result best[BENCH_NUM_MODES];
+	bench_config best_c[BENCH_NUM_MODES];
+	int m, i;
+
+	if(num_imgs <= 0) {
+		printf("usage: %s [fshar] [images]\n", argv[0]);
+		return -1;
+	}
+
+	if(bench_alloc(&buf, num_imgs) != FG_OK) {
+		printf("no memory for %d images\n", num_imgs);
+		return -1;
+	}
+
+	memset(best, 0, sizeof(best));
+	printf("%% mode w h e received dropped missed min p50 p90 p99 max mean rate\n");
+	for(m = 0; m < BENCH_NUM_MODES; m++) {
+		if(strchr(modes, letters[m]) == NULL) {
+			continue;
+		}
+#if !USE_DAQ
+		if(m == BENCH_HARDWARE) {
+			printf("%% %s: built without NIDAQmx\n", bench_name(m));
+			continue;
+		}
+#endif
+		printf("%% %s\n", bench_name(m));
+
+		c.mode = m;
+		c.num_imgs = num_imgs;
+		c.update_roi = UPDATE_ROI;
+		for(c.e = MIN_EXP; c.e <= MAX_EXP; c.e *= 10) {
+			for(c.w = MIN_WIDTH; c.w <= MAX_WIDTH; c.w += WIDTH_STEP) {
+				for(c.h = MIN_HEIGHT; c.h <= MAX_HEIGHT; c.h++) {
+					// the free run at the shortest frame time the camera takes
+					c.f = c.e;
+					if(open_cam(&fg, bench_trigger_mode(m), num_imgs, c.w, c.h,
+						(m == BENCH_APC) ? &mem : NULL) != FG_OK) {
+						continue;
+					}
+					if(m != BENCH_APC) {
+						mem = NULL;
+					}
+
+					if(bench(fg, mem, &c, &buf, &r) != FG_OK) {
+						printf("%% %s %d %d %f: no images\n", bench_name(m), c.w, c.h, c.e);
+					}
+					else {
+						printf("%d %d %d %f %d %d %d %f %f %f %f %f %f %f\n",
+							m, c.w, c.h, c.e, r.received, r.dropped, r.missed,
+							r.min, r.p50, r.p90, r.p99, r.max, r.mean, r.rate);
+						if(r.rate > best[m].rate) {
+							best[m] = r;
+							best_c[m] = c;
+						}
+#if PRINT_RAW
+						for(i = 0; i < r.received; i++) {
+							printf("%% %f\n", buf.latency[i]);
+						}
+#endif
+					}
+					close_cam(fg, mem);
 				}
 			}
 		}
 	}
 
-	/*
-				if(open_cam(&fg, GRABBER_CONTROLLED, NUM_IMGS, w, h) == FG_OK) {
-					method1(fg, NUM_IMGS, w, h, EXPOSURE, EXPOSURE);
-					close_cam(fg);
+	if(strchr(modes, 'r') != NULL) {
+		printf("%% mode init w h e samples never missed write_mean write_max p50 p90 p99 max interval_mean interval_max frames\n");
+		c.num_imgs = num_imgs;
+		c.update_roi = 0;
+		for(k = 0; k < 2; k++) {
+			c.mode = tag_modes[k];
+			for(init = 0; init <= 1; init++) {
+				printf("%% roi writes, %s, %s\n", bench_name(c.mode), init ? "DO_INIT" : "!DO_INIT");
+				for(c.e = MIN_EXP; c.e <= MAX_EXP; c.e *= 10) {
+					for(c.w = MIN_WIDTH; c.w <= MAX_WIDTH; c.w += WIDTH_STEP) {
+						for(c.h = MIN_HEIGHT; c.h <= MAX_HEIGHT; c.h++) {
+							c.f = c.e;
+							if(open_cam(&fg, bench_trigger_mode(c.mode), num_imgs, c.w, c.h, NULL) != FG_OK) {
+								continue;
+							}
+
+							if(tag_latency(fg, &c, init, &buf, &t) != FG_OK) {
+								printf("%% %s %d %d %d %f: no tags\n", bench_name(c.mode), init, c.w, c.h, c.e);
+							}
+							else {
+								printf("%d %d %d %d %f %d %d %d %f %f %f %f %f %f %f %f",
+									c.mode, init, c.w, c.h, c.e, t.samples, t.never, t.missed,
+									t.write_mean, t.write_max, t.p50, t.p90, t.p99, t.max,
+									t.interval_mean, t.interval_max);
+								for(i = 1; i <= TAG_MAX_FRAMES; i++) {
+									printf(" %d", t.frames[i]);
+								}
+								printf("\n");
+							}
+							close_cam(fg, NULL);
+						}
+					}
 				}
-	*/
+			}
+		}
+	}
 
-	/*
-	if(open_cam(&fg, GRABBER_CONTROLLED, NUM_IMGS, WIDTH, HEIGHT) == FG_OK) {
-		method3(fg, NUM_IMGS, WIDTH, HEIGHT, EXPOSURE, FRAME_TIME);
-		close_cam(fg);
+	// the fastest each mode went, to pick one by
+	for(m = 0; m < BENCH_NUM_MODES; m++) {
+		if(best[m].rate > 0.) {
+			printf("%% %s: at most %.1f images/s at %d x %d, %.0f us, latency p50 %.1f p99 %.1f us\n",
+				bench_name(m), best[m].rate, best_c[m].w, best_c[m].h, best_c[m].e,
+				best[m].p50, best[m].p99);
+		}
 	}
-	*/
 
+	bench_free(&buf);
 	return FG_OK;
-}
\ No newline at end of file
+}
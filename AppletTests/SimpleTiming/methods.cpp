@@ -1,290 +1,375 @@
 #include <errno.h>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
 
-#include "fgrab_struct.h"
-#include "fgrab_prototyp.h"
-#include "fgrab_define.h"
+#include "timing.h"
 
-#define TIMEOUT 2
-#define GRAB_TWO 2
-#define FRAME_TIME_MAX 1000000
-#define FT_ERROR 5.0
-#define FT_DELTA .1
+#if USE_DAQ
+#include <NIDAQmx.h>
+#endif
+
+#define TIMEOUT 2 // s
+#define MAX_MISSED 10 // timeouts before a run is given up
 #define DO_INIT 1
 
+// the trigger pulse, see fchwt.cpp
+// min = 2.5e-8 s, max = 53.6871 s for SIG_DELAY, HI_TIME, LO_TIME
+#define DAQ_PIN "Dev4/ctr0"
+#define DAQ_BUF_SIZE 2048
+#define SIG_DELAY 0
+#define HI_TIME 10e-6
+#define LO_TIME 10e-6
+
 extern int update_roi(Fg_Struct *fg, int label, int w, int h, double e, double f, int init);
 extern int get_images(Fg_Struct *fg, int num_imgs);
-extern int show_images(Fg_Struct *fg, int *nr, int num_images, int w, int h);
 
-int overhead(int num_imgs)
-{
-	// in an average sense
-	//int i = 0, img_nr = 0;
-	//unsigned int nr[16];
-	//unsigned __int64 loop_start, loop_stop;
-
-	//QueryPerformanceCounter(&loop_start);
-	//while(i < num_imgs) {
-	//	QueryPerformanceCounter(pc_start + i);
-	//	nr[i] = img_nr;
-	//	i++;
-	//	QueryPerformanceCounter(pc_stop + i);
-	//}
-	//QueryPerformanceCounter(&loop_stop));
+// of the APC, written by the callback thread of the grabber
+static struct {
+	HANDLE arrived;
+	unsigned __int64 when;
+	int nr;
+} apc;
 
+int apc_arrived(int i, void *b)
+{
+	QueryPerformanceCounter((LARGE_INTEGER *) &apc.when);
+	apc.nr = i;
+	SetEvent(apc.arrived);
 	return FG_OK;
 }
 
-int method1(Fg_Struct *fg, int num_imgs, int w, int h, double e, double f)
+const char *bench_name(int mode)
 {
-	int i = 0, img_nr = 0;
-	int rc;
-	int *nr;
-	unsigned char *img = NULL;
-	unsigned __int64 freq, loop_start, loop_stop;
-	unsigned __int64 *pc_ts;
-	unsigned __int64 *fg_ts;
-
-	nr = (int *) calloc(num_imgs, sizeof(int));
-	if(nr == NULL) {
-		return -ENOMEM;
+	switch(mode) {
+		case BENCH_FREE_RUN:
+			return "free_run";
+		case BENCH_SOFTWARE:
+			return "software";
+		case BENCH_HARDWARE:
+			return "hardware";
+		case BENCH_APC:
+			return "apc";
 	}
+	return "unknown";
+}
 
-	pc_ts = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
-	if(pc_ts == NULL) {
-		return -ENOMEM;
+// FG_TRIGGERMODE for open_cam()
+int bench_trigger_mode(int mode)
+{
+	switch(mode) {
+		case BENCH_FREE_RUN:
+			return GRABBER_CONTROLLED;
+		case BENCH_HARDWARE:
+			return ASYNC_TRIGGER;
 	}
+	return ASYNC_SOFTWARE_TRIGGER;
+}
 
-	fg_ts = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
-	if(fg_ts == NULL) {
+int bench_alloc(bench_buffers *b, int num_imgs)
+{
+	memset(b, 0, sizeof(bench_buffers));
+	b->len = num_imgs;
+	b->trigger = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
+	b->arrive = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
+	b->latency = (double *) calloc(num_imgs, sizeof(double));
+	if(b->trigger == NULL || b->arrive == NULL || b->latency == NULL) {
+		bench_free(b);
 		return -ENOMEM;
 	}
 
-	update_roi(fg, 0xabf, w, h, e, f, DO_INIT);
-	get_images(fg, num_imgs);
-	QueryPerformanceCounter((LARGE_INTEGER *) &loop_start);
-	while(i < num_imgs) {
-		QueryPerformanceCounter((LARGE_INTEGER *) (pc_ts + i));
-		img_nr = Fg_getLastPicNumberBlocking(fg, i + 1, PORT_A, TIMEOUT);
-		if(img_nr > FG_OK) {
-			img = (unsigned char *) Fg_getImagePtr(fg, img_nr, PORT_A);
-			update_roi(fg, i, w, h, e, f, !DO_INIT);
-		}
-		nr[i] = img_nr;
-		i++;
+	if(QueryPerformanceFrequency((LARGE_INTEGER *) &b->freq) != TRUE) {
+		bench_free(b);
+		return -ENODEV;
 	}
-	QueryPerformanceCounter((LARGE_INTEGER *) &loop_stop);
 
-	printf("%d %d %f -1\n", w, h, e);
-	rc = QueryPerformanceFrequency((LARGE_INTEGER *) &freq);
-	printf("%lld %lld %lld -1\n", 
-		((rc == TRUE) ? freq : -ENODEV), loop_start, loop_stop);
-	for(i = 0; i < num_imgs; i++) {
-		fg_ts[i] = nr[i];
-		rc = Fg_getParameter(fg, FG_TIMESTAMP, fg_ts + i, PORT_A);
-		printf("%d %lld %lld -1\n", nr[i], pc_ts[i], ((rc < 0) ? rc : fg_ts[i]));
-	}
+	return FG_OK;
+}
 
-	show_images(fg, nr, num_imgs, w, h);
+void bench_free(bench_buffers *b)
+{
+	free(b->trigger);
+	free(b->arrive);
+	free(b->latency);
+	memset(b, 0, sizeof(bench_buffers));
+}
 
-	free(nr);
-	free(pc_ts);
-	free(fg_ts);
-	return FG_OK;
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
 }
 
-int method2(Fg_Struct *fg, int num_imgs, int w, int h, double e, double f)
+// of the sorted latencies
+static double percentile(const double *sorted, int n, double p)
 {
-	int i = 0, img_nr = 0, rc;
-	int *nr;
-	unsigned char *img = NULL;
-	unsigned __int64 freq, loop_start, loop_stop;
-	unsigned __int64 *pc_start;
-	unsigned __int64 *pc_stop;
-	unsigned __int64 *fg_ts;
-
-	nr = (int *) calloc(num_imgs, sizeof(int));
-	if(nr == NULL) {
-		return -ENOMEM;
+	int k = (int) ceil(p / 100. * n) - 1;
+	if(k < 0) {
+		k = 0;
 	}
+	return sorted[k];
+}
 
-	pc_start = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
-	if(pc_start == NULL) {
-		return -ENOMEM;
+/*
+ * One mode at one ROI: num_imgs images, each taken as soon as the one before
+ * it is in, so the rate is the most the mode sustains.  The trigger and the
+ * arrival of each image are QueryPerformanceCounter() stamps on the PC:
+ *
+ *   free run  the request of the next image to Fg_getLastPicNumberBlocking()
+ *   software  Fg_sendSoftwareTrigger() to Fg_getLastPicNumberBlocking()
+ *   hardware  DAQmxStartTask() of the pulse to Fg_getLastPicNumberBlocking()
+ *   apc       Fg_sendSoftwareTrigger() to the callback of the grabber
+ *
+ * so each includes what a control loop would pay on its side of the driver.
+ * On return b->latency holds the latencies of the images received, sorted.
+ */
+int bench(Fg_Struct *fg, void *mem, const bench_config *c, bench_buffers *b, bench_result *r)
+{
+	int i, n = 0, img_nr, expect = 1, rc = FG_OK;
+	unsigned __int64 loop_start, loop_stop;
+#if USE_DAQ
+	char errBuff[DAQ_BUF_SIZE] = {'\0'};
+	TaskHandle taskHandle = 0;
+#endif
+
+	memset(r, 0, sizeof(bench_result));
+	if(c->num_imgs > b->len) {
+		return -EINVAL;
 	}
 
-	pc_stop = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
-	if(pc_stop == NULL) {
-		return -ENOMEM;
+	update_roi(fg, 0, c->w, c->h, c->e, c->f, DO_INIT);
+
+	if(c->mode == BENCH_HARDWARE) {
+#if USE_DAQ
+		rc = DAQmxCreateTask("", &taskHandle);
+		if(rc < 0) {
+			DAQmxGetExtendedErrorInfo(errBuff, DAQ_BUF_SIZE);
+			printf("create daq task %s\n", errBuff);
+			return rc;
+		}
+
+		rc = DAQmxCreateCOPulseChanTime(taskHandle, DAQ_PIN, "", DAQmx_Val_Seconds, DAQmx_Val_Low, SIG_DELAY, LO_TIME, HI_TIME);
+		if(rc < 0) {
+			DAQmxGetExtendedErrorInfo(errBuff, DAQ_BUF_SIZE);
+			printf("create pulse task %s\n", errBuff);
+			DAQmxClearTask(taskHandle);
+			return rc;
+		}
+#else
+		return -ENODEV;
+#endif
 	}
 
-	fg_ts = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
-	if(fg_ts == NULL) {
-		return -ENOMEM;
+	if(c->mode == BENCH_APC) {
+		apc.arrived = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if(apc.arrived == NULL) {
+			return -ENOMEM;
+		}
+		if(Fg_AcquireAPCEx(fg, PORT_A, GRAB_INFINITE, ACQ_STANDARD, mem, apc_arrived, fg) < 0) {
+			printf("acq apc: %s\n", Fg_getLastErrorDescription(fg));
+			CloseHandle(apc.arrived);
+			return Fg_getLastErrorNumber(fg);
+		}
+	}
+	else if((rc = get_images(fg, c->num_imgs)) != FG_OK) {
+		return rc;
 	}
 
-	update_roi(fg, 0, w, h, e, f, DO_INIT);
-	get_images(fg, num_imgs);
 	QueryPerformanceCounter((LARGE_INTEGER *) &loop_start);
-	while(i < num_imgs) {
-		QueryPerformanceCounter((LARGE_INTEGER *) (pc_start + i));
-		if(Fg_sendSoftwareTrigger(fg, PORT_A) < 0) { // this always seems to return success, never busy
-			printf("swt: %s\n", Fg_getLastErrorDescription(fg));
+	for(i = 0; i < c->num_imgs && r->missed < MAX_MISSED; i++) {
+		QueryPerformanceCounter((LARGE_INTEGER *) (b->trigger + n));
+
+		switch(c->mode) {
+			case BENCH_SOFTWARE:
+			case BENCH_APC:
+				if(Fg_sendSoftwareTrigger(fg, PORT_A) < 0) {
+					printf("swt: %s\n", Fg_getLastErrorDescription(fg));
+				}
+				break;
+#if USE_DAQ
+			case BENCH_HARDWARE:
+				if(DAQmxStartTask(taskHandle) < 0) {
+					DAQmxGetExtendedErrorInfo(errBuff, DAQ_BUF_SIZE);
+					printf("start pulse task %s\n", errBuff);
+				}
+				break;
+#endif
+		}
+
+		if(c->mode == BENCH_APC) {
+			img_nr = -1;
+			if(WaitForSingleObject(apc.arrived, TIMEOUT * 1000) == WAIT_OBJECT_0) {
+				img_nr = apc.nr;
+				b->arrive[n] = apc.when;
+			}
+		}
+		else {
+			img_nr = Fg_getLastPicNumberBlocking(fg, expect, PORT_A, TIMEOUT);
+			QueryPerformanceCounter((LARGE_INTEGER *) (b->arrive + n));
+		}
+
+#if USE_DAQ
+		if(c->mode == BENCH_HARDWARE) {
+			DAQmxWaitUntilTaskDone(taskHandle, TIMEOUT);
+			DAQmxStopTask(taskHandle);
 		}
-		img_nr = Fg_getLastPicNumberBlocking(fg, i + 1, PORT_A, TIMEOUT);
-		if(img_nr > FG_OK) {
-			img = (unsigned char *) Fg_getImagePtr(fg, img_nr, PORT_A);
-			update_roi(fg, 0, w, h, e, f, DO_INIT);
+#endif
+
+		if(img_nr < expect) {
+			r->missed++;
+			continue;
 		}
-		nr[i] = img_nr;
-		QueryPerformanceCounter((LARGE_INTEGER *) (pc_stop + i));
+		r->dropped += img_nr - expect;
+		expect = img_nr + 1;
+
+		b->latency[n] = (double) (b->arrive[n] - b->trigger[n]) / b->freq * 1e6;
+		n++;
 
-		i++;
+		if(c->update_roi) {
+			update_roi(fg, i, c->w, c->h, c->e, c->f, !DO_INIT);
+		}
 	}
 	QueryPerformanceCounter((LARGE_INTEGER *) &loop_stop);
 
-	printf("%d %d %f -1\n", w, h, e);
-	rc = QueryPerformanceFrequency((LARGE_INTEGER *) &freq);
-	printf("%lld %lld %lld -1\n", 
-		((rc == TRUE) ? freq : -ENODEV), loop_start, loop_stop);
-	for(i = 0; i < num_imgs; i++) {
-		fg_ts[i] = nr[i];
-		rc = Fg_getParameter(fg, FG_TIMESTAMP, fg_ts + i, PORT_A);
-		printf("%d %lld %lld %lld\n", 
-			nr[i], pc_start[i], pc_stop[i], ((rc < 0) ? rc : fg_ts[i]));
+#if USE_DAQ
+	if(c->mode == BENCH_HARDWARE) {
+		DAQmxClearTask(taskHandle);
 	}
+#endif
 
-	show_images(fg, nr, num_imgs, w, h);
+	if(c->mode == BENCH_APC) {
+		if(Fg_stopAcquireEx(fg, PORT_A, mem, STOP_ASYNC) != FG_OK) {
+			printf("stop acq: %s\n", Fg_getLastErrorDescription(fg));
+		}
+		// no callback may come after the event is gone, see fapcmain.cpp
+		Sleep(TIMEOUT * 1000);
+		CloseHandle(apc.arrived);
+		apc.arrived = NULL;
+	}
 
-	free(nr);
-	free(pc_start);
-	free(pc_stop);
-	free(fg_ts);
-	return FG_OK;
-}
+	r->received = n;
+	if(n > 0) {
+		qsort(b->latency, n, sizeof(double), compare_double);
+		r->min = b->latency[0];
+		r->max = b->latency[n - 1];
+		r->p50 = percentile(b->latency, n, 50.);
+		r->p90 = percentile(b->latency, n, 90.);
+		r->p99 = percentile(b->latency, n, 99.);
+		for(i = 0; i < n; i++) {
+			r->mean += b->latency[i];
+		}
+		r->mean /= n;
+		r->rate = n / ((double) (loop_stop - loop_start) / b->freq);
+	}
 
+	return (n > 0) ? FG_OK : -EAGAIN;
+}
 
-int method3(Fg_Struct *fg, int num_imgs, int w, int h, double e, double f)
+/*
+ * How long a writeParameterSet() takes to land on the camera: every write gets
+ * its own tag as the label of the parameter set, and the images after it are
+ * read until FG_IMAGE_TAG shows that tag.  The delay is counted in images
+ * (frames[1] is the next image) and in us from the start of the write to the
+ * image with the tag in PC memory.  With init the set is written DO_INIT, as
+ * method2 did; without, as write_roi() does in the free run.  Only the free
+ * run and the software trigger: c->mode is BENCH_FREE_RUN or BENCH_SOFTWARE.
+ *
+ * The blocking wait returns the newest image, so when the free run outruns
+ * the loop an image in between is not looked at, and a tag that landed on it
+ * is counted on the next one read.
+ */
+int tag_latency(Fg_Struct *fg, const bench_config *c, int init, bench_buffers *b, tag_result *r)
 {
-	int i = 0, img_nr = 0;
-	int *nr;
-	double act_f;
-	unsigned char *img = NULL;
-	unsigned __int64 *fg_ts, pic1, pic2;
-
-	nr = (int *) calloc(num_imgs, sizeof(int));
-	if(nr == NULL) {
-		return -ENOMEM;
+	int k, frames, found, first, img_nr, prev_nr = 0, expect = 1, n = 0, rc;
+	unsigned int tag, got;
+	unsigned __int64 w0, w1, arrive, prev = 0;
+	double us, intervals = 0.;
+	int num_intervals = 0;
+
+	memset(r, 0, sizeof(tag_result));
+	if(c->num_imgs > b->len || (c->mode != BENCH_FREE_RUN && c->mode != BENCH_SOFTWARE)) {
+		return -EINVAL;
 	}
 
-	fg_ts = (unsigned __int64 *) calloc(num_imgs, sizeof(unsigned __int64));
-	if(fg_ts == NULL) {
-		return -ENOMEM;
+	update_roi(fg, 0, c->w, c->h, c->e, c->f, DO_INIT);
+	if((rc = get_images(fg, c->num_imgs)) != FG_OK) {
+		return rc;
 	}
 
-	///////// find the largest frame time that breaks the programmed frame time
-
-	act_f = 0;
-	update_roi(fg, 0xfab, w, h, e, f, DO_INIT);
-	while(1) {
-		get_images(fg, GRAB_TWO);
-		img_nr = Fg_getLastPicNumberBlocking(fg, i + 2, PORT_A, TIMEOUT);
-		if(img_nr > FG_OK) {
-			pic1 = img_nr - 1;
-			if(Fg_getParameter(fg, FG_TIMESTAMP, (LARGE_INTEGER *) &pic1, PORT_A) < FG_OK) {
-				continue;
-			}
-			
-			pic2 = img_nr;
-			if(Fg_getParameter(fg, FG_TIMESTAMP, (LARGE_INTEGER *) &pic2, PORT_A) < FG_OK) {
-				continue;
-			}
-
-			if(pic2 < pic1) {
-				// overflow
-				act_f = (_UI64_MAX - pic1) + pic2 + 1;
-			}
-			else {
-				act_f = pic2 - pic1;
-			}
-
-			// stopping condition
-			if(fabs(act_f - f) > FT_ERROR) {
-				break;
-			}
+	for(k = 0; k < c->num_imgs && r->missed < MAX_MISSED; k++) {
+		tag = (k % TAG_MASK) + 1; // 0 is the tag of the first set
 
-			if(Fg_stopAcquire(fg, PORT_A) != FG_OK) {
-				printf("stop acq: %s\n", Fg_getLastErrorDescription(fg));
-			}
+		QueryPerformanceCounter((LARGE_INTEGER *) &w0);
+		update_roi(fg, tag, c->w, c->h, c->e, c->f, init);
+		QueryPerformanceCounter((LARGE_INTEGER *) &w1);
 
-			f -= FT_DELTA;
-			update_roi(fg, 0xfab, w, h, e, f, !DO_INIT);
-			printf("%f\n", f);
+		us = (double) (w1 - w0) / b->freq * 1e6;
+		r->write_mean += us;
+		if(us > r->write_max) {
+			r->write_max = us;
 		}
-		else {
-			// an error occurred
-			printf("method3 loop1: %s\n", Fg_getLastErrorDescription(fg));
-			return img_nr;
-		}
-	}
 
-	///////// use f found above as largest frame time that breaks the programmed frame time
-	if(Fg_stopAcquire(fg, PORT_A) != FG_OK) {
-		printf("stop acq: %s\n", Fg_getLastErrorDescription(fg));
-	}
-
-	i = 0;
-	act_f = f - num_imgs/2*FT_DELTA;
-	update_roi(fg, 0xfab, w, h, e, act_f, DO_INIT);
-	while(i < num_imgs) {
-		get_images(fg, GRAB_TWO);
-		img_nr = Fg_getLastPicNumberBlocking(fg, i + 2, PORT_A, TIMEOUT);
-		if(img_nr > FG_OK) {
-			nr[i] = img_nr;
-
-			pic1 = img_nr - 1;
-			if(Fg_getParameter(fg, FG_TIMESTAMP, (LARGE_INTEGER *) &pic1, PORT_A) < FG_OK) {
-				continue;
-			}
-			
-			pic2 = img_nr;
-			if(Fg_getParameter(fg, FG_TIMESTAMP, (LARGE_INTEGER *) &pic2, PORT_A) < FG_OK) {
-				continue;
+		found = 0;
+		frames = 0;
+		first = expect;
+		while(!found && frames < TAG_MAX_FRAMES) {
+			if(c->mode == BENCH_SOFTWARE && Fg_sendSoftwareTrigger(fg, PORT_A) < 0) {
+				printf("swt: %s\n", Fg_getLastErrorDescription(fg));
 			}
-
-			if(pic2 < pic1) {
-				// overflow
-				fg_ts[i] = (_UI64_MAX - pic1) + pic2 + 1;
+			img_nr = Fg_getLastPicNumberBlocking(fg, expect, PORT_A, TIMEOUT);
+			QueryPerformanceCounter((LARGE_INTEGER *) &arrive);
+			if(img_nr < expect) {
+				r->missed++;
+				break;
 			}
-			else {
-				fg_ts[i] = pic2 - pic1;
+			expect = img_nr + 1;
+			frames = img_nr - first + 1;
+
+			// per image, over the images the wait went past
+			if(prev != 0) {
+				us = (double) (arrive - prev) / b->freq * 1e6 / (img_nr - prev_nr);
+				intervals += us;
+				num_intervals++;
+				if(us > r->interval_max) {
+					r->interval_max = us;
+				}
 			}
+			prev = arrive;
+			prev_nr = img_nr;
 
-			if(Fg_stopAcquire(fg, PORT_A) != FG_OK) {
-				printf("stop acq: %s\n", Fg_getLastErrorDescription(fg));
+			got = img_nr;
+			if(Fg_getParameter(fg, FG_IMAGE_TAG, &got, PORT_A) < 0) {
+				printf("tag: %s\n", Fg_getLastErrorDescription(fg));
+				continue;
 			}
+			found = (got & TAG_MASK) == tag;
+		}
 
-			i++;
-			f = FT_DELTA*i + act_f;
-			update_roi(fg, i, w, h, e, f, !DO_INIT);
+		if(found && frames <= TAG_MAX_FRAMES) {
+			r->frames[frames]++;
+			b->latency[n++] = (double) (arrive - w0) / b->freq * 1e6;
 		}
 		else {
-			// an error occurred
-			printf("method3 loop2: %s\n", Fg_getLastErrorDescription(fg));
-			return img_nr;
+			r->never++;
 		}
 	}
 
-	///////////////////////////////////////////////////////////
-
-	printf("%d %d %f\n", w, h, e);
-	for(i = 0; i < num_imgs; i++) {
-		printf("%d %lld %lld\n", nr[i], fg_ts[i]);
+	r->samples = n;
+	if(k > 0) {
+		r->write_mean /= k;
+	}
+	if(num_intervals > 0) {
+		r->interval_mean = intervals / num_intervals;
+	}
+	if(n > 0) {
+		qsort(b->latency, n, sizeof(double), compare_double);
+		r->p50 = percentile(b->latency, n, 50.);
+		r->p90 = percentile(b->latency, n, 90.);
+		r->p99 = percentile(b->latency, n, 99.);
+		r->max = b->latency[n - 1];
 	}
 
-	show_images(fg, nr, num_imgs, w, h);
-
-	free(nr);
-	free(fg_ts);
-	return FG_OK;
-}
\ No newline at end of file
+	return (n > 0) ? FG_OK : -EAGAIN;
+}
@@ -0,0 +1,71 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "fgrab_struct.h"
+#include "fgrab_prototyp.h"
+#include "fgrab_define.h"
+
+// 0 to build without NIDAQmx, the hardware trigger is then left out
+#define USE_DAQ 1
+
+// how the PC gets each image, see bench() in methods.cpp
+enum bench_mode {
+	BENCH_FREE_RUN,	// GRABBER_CONTROLLED, the grabber paces the camera at the frame time
+	BENCH_SOFTWARE,	// ASYNC_SOFTWARE_TRIGGER, Fg_sendSoftwareTrigger() per image
+	BENCH_HARDWARE,	// ASYNC_TRIGGER, an NI-DAQ counter pulse per image as in fchwt.cpp
+	BENCH_APC,		// ASYNC_SOFTWARE_TRIGGER, the image delivered by an APC callback as in fapcmain.cpp
+	BENCH_NUM_MODES
+};
+
+typedef struct {
+	int mode;		// bench_mode
+	int num_imgs;
+	int w, h;
+	double e, f;	// exposure and frame time, us
+	int update_roi;	// rewrite the ROI after every image, as method1/2 did
+} bench_config;
+
+// of a run, in us; latency is from the trigger, or for the free run from the
+// request of the next image, to the image in PC memory
+typedef struct {
+	int received;
+	int dropped;	// skipped by the grabber
+	int missed;		// timed out
+	double min, p50, p90, p99, max, mean;
+	double rate;	// images/s, back to back
+} bench_result;
+
+// the landing of a ROI write, see tag_latency() in methods.cpp
+#define TAG_MAX_FRAMES 16 // images waited for a tag before it is counted as never
+#define TAG_MASK 0xffff // of the tag as FG_IMAGE_TAG reports it
+
+typedef struct {
+	int samples;	// the writes that landed
+	int never;		// not within TAG_MAX_FRAMES images
+	int missed;		// images timed out
+	int frames[TAG_MAX_FRAMES + 1];	// writes that landed in the n-th image after them
+	double write_mean, write_max;	// of writeParameterSet() itself, us
+	double p50, p90, p99, max;		// of the write to the image with its tag, us
+	double interval_mean, interval_max;	// between images during the writes, us
+} tag_result;
+
+// what the runs share, allocated once for the largest num_imgs
+typedef struct {
+	int len;
+	unsigned __int64 freq;
+	unsigned __int64 *trigger;
+	unsigned __int64 *arrive;
+	double *latency;
+} bench_buffers;
+
+extern int bench_alloc(bench_buffers *b, int num_imgs);
+extern void bench_free(bench_buffers *b);
+extern int bench(Fg_Struct *fg, void *mem, const bench_config *c, bench_buffers *b, bench_result *r);
+extern int tag_latency(Fg_Struct *fg, const bench_config *c, int init, bench_buffers *b, tag_result *r);
+extern const char *bench_name(int mode);
+extern int bench_trigger_mode(int mode);
+
+extern int open_cam(Fg_Struct **gr, int mode, int num_images, int w, int h, void **mem);
+extern int close_cam(Fg_Struct *fg, void *mem);
+
+#endif // TIMING_H
@@ -0,0 +1,82 @@
+/**
+* @file applet.cpp the host side of the applet that finds the object on the frame
+* grabber.
+*
+* FastConfig.dll DMAs every pixel of a ROI to the host, where <code>threshold_blob</code>
+* reads each one once to binarize it and sum its moments.  With APPLET_MOMENTS the board
+* is loaded with APPLET_NAME instead, a FastConfig applet that does the same pass on the
+* FPGA as the pixels come off the camera link and only DMAs an AppletResult per image.
+* The ROI sequence and the parameter sets work like with FastConfig.dll, only the
+* buffers are APPLET_BUF_SIZE bytes instead of a whole ROI.
+*
+* <code>applet_result</code> leaves the TrackingWindow in the state
+* <code>threshold_blob</code> leaves it in, so <code>update_position</code>,
+* <code>adapt_roi</code> and <code>write_comm</code> take either one.  The applet looks at
+* the whole ROI rather than the padded blob window and has no histogram, so an
+* AutoThreshold is not followed, and <code>win->img</code> points to the result rather
+* than to pixels.
+*
+* @see APPLET_MOMENTS
+*/
+
+#include "fcdynamic.h"
+
+/**
+* sets the threshold the moments applet binarizes the pixels of a camera with.
+*
+* @param cam an initialized Camera with the moments applet loaded
+* @param t the threshold value of a single pixel
+*
+* @return <code>FG_OK</code> on success, otherwise the error of the frame grabber
+*/
+
+int applet_threshold(Camera *cam, int t)
+{
+	int rc;
+
+	rc = Fg_setParameter(cam->fg, APPLET_THRESHOLD, &t, cam->port);
+	if(rc != FG_OK) {
+		printf("applet: could not set the threshold: %s\n",
+			Fg_getLastErrorDescription(cam->fg));
+		return Fg_getLastErrorNumber(cam->fg);
+	}
+
+	return FG_OK;
+}
+
+/**
+* updates a TrackingWindow with what the moments applet found in its image.
+*
+* @param win the TrackingWindow the image was taken with
+* @param r the AppletResult in the DMA buffer of the image
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @note like <code>threshold_blob</code>, the blob parameters of <code>win</code> are
+* only updated when an object is found, except for <code>win->area</code>, which is set
+* to 0.  A result of another parameter set than <code>win->roi</code> is treated as no
+* object, the image was taken while the sequence was being changed.
+*/
+
+int applet_result(TrackingWindow *win, const AppletResult *r)
+{
+	BlobMoments m;
+
+	if(r == NULL || r->roi != win->roi || r->xmax < 0 || r->area == 0) {
+		win->area = 0;
+		return !OBJECT_FOUND;
+	}
+
+	assert(r->xmax < win->roi_w && r->ymax < win->roi_h);
+
+	win->blob_xmin = r->xmin;
+	win->blob_ymin = r->ymin;
+	win->blob_xmax = r->xmax;
+	win->blob_ymax = r->ymax;
+
+	m = r->moments;
+	blob_shape(win, &m, r->area);
+
+	return OBJECT_FOUND;
+}
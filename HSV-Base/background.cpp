@@ -0,0 +1,190 @@
+/**
+* @file background.cpp subtracts a reference image of the background before thresholding.
+*
+* a single threshold can not tell the object from specular highlights or the bright hand
+* disk, so the blob window has to be padded and searched past them.  A Background holds
+* a reference image of the scene without the object in the image reference frame, so it
+* stays put while the ROIs move over it.  <code>threshold</code> and
+* <code>threshold_blob</code> hand every row of the blob window to
+* <code>background_row</code> right before they histogram and binarize it, which
+* replaces the pixels with their saturated absolute difference to the reference while
+* the row is in the cache, so the window is still only read from memory once.
+*
+* the reference is either static, loaded from an image taken without the object by
+* <code>background_load</code>, or refreshed every <code>period</code> images: the
+* pixels of the blob window that are background after subtracting are averaged into
+* it.  The pixels of the object are left out, so a still object does not fade into the
+* reference.  A reference that was not loaded starts out black, which subtracts nothing
+* until the background was learned.
+*/
+
+#include "fcdynamic.h"
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+* sets up a Background for a <code>w</code> x <code>h</code> image.
+*
+* the reference is only allocated again if the size changed, so a reference that was
+* loaded or learned survives setting up the windows again for the next run.
+*
+* @param b the Background to set up
+* @param w the width of the image reference frame
+* @param h the height of the image reference frame
+* @param period the images between two refreshes, 0 for a static reference
+*
+* @return <code>FG_OK</code> or <code>ENOMEM</code>
+*/
+
+int background_init(Background *b, int w, int h, int period)
+{
+	if(b->ref == NULL || b->w != w || b->h != h) {
+		free(b->ref);
+		b->ref = (unsigned char *) calloc((size_t) w * h, sizeof(unsigned char));
+		if(b->ref == NULL) {
+			memset(b, 0, sizeof(Background));
+			printf("background: not enough memory for a %dx%d reference\n", w, h);
+			return ENOMEM;
+		}
+		b->w = w;
+		b->h = h;
+	}
+
+	b->period = (period < 0) ? 0 : period;
+	b->count = 0;
+
+	return FG_OK;
+}
+
+/**
+* loads the reference of a Background from a gray scale image of its size.
+*
+* @param b a Background set up by <code>background_init</code>
+* @param name the image file, taken without the object in view
+*
+* @return <code>FG_OK</code>, <code>ENOENT</code> if the file could not be loaded or
+* <code>EINVAL</code> if it is not the size of the reference
+*/
+
+int background_load(Background *b, const char *name)
+{
+	int i;
+	IplImage *img;
+
+	img = cvLoadImage(name, CV_LOAD_IMAGE_GRAYSCALE);
+	if(img == NULL) {
+		printf("background: could not load %s\n", name);
+		return ENOENT;
+	}
+
+	if(img->width != b->w || img->height != b->h) {
+		printf("background: %s is not %dx%d\n", name, b->w, b->h);
+		cvReleaseImage(&img);
+		return EINVAL;
+	}
+
+	// the rows of an IplImage may be padded
+	for(i = 0; i < b->h; i++) {
+		memcpy(b->ref + (size_t) i * b->w, img->imageData + i * img->widthStep, b->w);
+	}
+	cvReleaseImage(&img);
+
+	return FG_OK;
+}
+
+/**
+* frees the reference of a Background
+*/
+
+void background_free(Background *b)
+{
+	free(b->ref);
+	memset(b, 0, sizeof(Background));
+}
+
+/**
+* what <code>background_row</code> does to the rows of the next image of a window.
+*
+* @return <code>BG_NONE</code> if the window has no Background, <code>BG_REFRESH</code>
+* if the image is due for a refresh, <code>BG_SUBTRACT</code> otherwise
+*/
+
+int background_begin(TrackingWindow *win)
+{
+	Background *b = win->bg;
+
+	if(b == NULL || b->ref == NULL) {
+		return BG_NONE;
+	}
+
+	if(b->period > 0 && ++b->count >= b->period) {
+		b->count = 0;
+		return BG_REFRESH;
+	}
+
+	return BG_SUBTRACT;
+}
+
+/**
+* replaces the pixels [xmin, xmax) of row <code>i</code> of the ROI by their saturated
+* absolute difference to the reference.
+*
+* with <code>BG_REFRESH</code> the reference pixels whose difference is below
+* <code>t</code> move half of the way to the image, like <code>_mm_avg_epu8</code>.
+* When <code>USE_SSE2</code> is set the row is done 16 pixels at a time, the absolute
+* difference being the or of the two saturated differences, one of which is 0.
+*
+* @param win the TrackingWindow of the image
+* @param mode what <code>background_begin</code> returned for the image
+* @param i the row in the ROI reference frame
+* @param xmin the first pixel of the row
+* @param xmax one past the last pixel of the row
+* @param t the threshold the row is binarized with next
+*/
+
+void background_row(TrackingWindow *win, int mode, int i, int xmin, int xmax, int t)
+{
+	int j, d;
+	unsigned char *row, *ref;
+	Background *b = win->bg;
+#if USE_SSE2
+	__m128i px, rf, diff, keep, tv, any;
+#endif
+
+	row = &PIXEL(win, i, 0);
+	ref = b->ref + (size_t) (win->roi_yoff + i) * b->w + win->roi_xoff;
+	t = (t < 0) ? 0 : ((t > WHITE + 1) ? WHITE + 1 : t);
+	j = xmin;
+
+#if USE_SSE2
+	// a difference is kept out of the refresh if max(d, t) == d, which needs t <= 255
+	tv = _mm_set1_epi8((char) ((t > WHITE) ? WHITE : t));
+	any = (t > WHITE) ? _mm_setzero_si128() : _mm_set1_epi8((char) 0xff);
+	for(; j + 16 <= xmax; j += 16) {
+		px = _mm_loadu_si128((__m128i *) (row + j));
+		rf = _mm_loadu_si128((__m128i *) (ref + j));
+		diff = _mm_or_si128(_mm_subs_epu8(px, rf), _mm_subs_epu8(rf, px));
+		_mm_storeu_si128((__m128i *) (row + j), diff);
+
+		if(mode == BG_REFRESH) {
+			keep = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(diff, tv), diff), any);
+			rf = _mm_or_si128(_mm_and_si128(keep, rf),
+				_mm_andnot_si128(keep, _mm_avg_epu8(rf, px)));
+			_mm_storeu_si128((__m128i *) (ref + j), rf);
+		}
+	}
+#endif
+
+	for(; j < xmax; j++) {
+		d = row[j] - ref[j];
+		if(d < 0) {
+			d = -d;
+		}
+		if(mode == BG_REFRESH && d < t) {
+			ref[j] = (unsigned char) ((ref[j] + row[j] + 1) >> 1);
+		}
+		row[j] = (unsigned char) d;
+	}
+}
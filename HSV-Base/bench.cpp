@@ -0,0 +1,243 @@
+/**
+* @file bench.cpp summarizes the runs of a timing sweep into one JSON file.
+*
+* the timing sweep in main.cpp writes one trace per run and timing_parser.py turns them
+* into means and standard deviations afterwards.  The benchmark summary is computed in
+* place instead: after every run <code>bench_run</code> sorts the per-image times of the
+* run and appends the percentiles, the achieved frame rate and the images the frame
+* grabber lost to the file opened by <code>bench_open</code>.  The file starts with the
+* build and host the sweep ran on, so summaries of different builds and machines can be
+* compared directly.
+*
+* the file looks like:
+*
+* <pre>
+* {
+* "build": "Oct 14 2026 10:00:00", "host": "TRACKER1", "online": 1, ...,
+* "runs": [
+* {"run": 1, "width": 16, "height": 16, "frame_us": 100000, ...},
+* ...
+* ]
+* }
+* </pre>
+*
+* all times are in microseconds.  "latency" is the time from an image being handed to
+* the tracking loop until its ROI was updated and "period" the time between two images
+* being recorded, so "period_p50" is the typical achieved frame time.  "thresh" and
+* "track" are the two timed stages of the loop.  bench_history.py keeps the runs of
+* every summary and compares builds.
+*/
+
+#include "fcdynamic.h"
+
+#define NOT_APPLICABLE -1
+
+static FILE *bench = NULL;
+static int runs = 0;
+
+/**
+* the nearest-rank percentile of the sorted values
+*/
+static double percentile(double *sorted, int n, double p)
+{
+	int i;
+
+	if(n <= 0) {
+		return 0;
+	}
+
+	i = (int) ceil(p / 100.0 * n) - 1;
+	if(i < 0) {
+		i = 0;
+	}
+	if(i >= n) {
+		i = n - 1;
+	}
+
+	return sorted[i];
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+/**
+* the mean and standard deviation of n values
+*/
+static void mean_std(double *x, int n, double *mean, double *std)
+{
+	int i;
+	double s = 0, ss = 0;
+
+	*mean = 0;
+	*std = 0;
+	if(n == 0) {
+		return;
+	}
+
+	for(i = 0; i < n; i++) {
+		s += x[i];
+		ss += x[i] * x[i];
+	}
+	*mean = s / n;
+	if(n > 1) {
+		*std = sqrt((ss - n * *mean * *mean) / (n - 1));
+	}
+}
+
+/**
+* creates the benchmark summary and writes the build and host information.
+*
+* @param name the name of the JSON file, an existing file is overwritten
+*
+* @return <code>FG_OK</code> on success, <code>EIO</code> if the file could not be
+* created
+*
+* @see bench_run
+* @see bench_close
+*/
+
+int bench_open(char *name)
+{
+	char host[MAX_COMPUTERNAME_LENGTH + 1];
+	DWORD len = sizeof(host);
+
+	if(fopen_s(&bench, name, "w") != 0) {
+		printf("bench: could not create %s\n", name);
+		bench = NULL;
+		return EIO;
+	}
+
+	if(!GetComputerNameA(host, &len)) {
+		strcpy_s(host, sizeof(host), "unknown");
+	}
+
+	runs = 0;
+	fprintf(bench, "{\n");
+	fprintf(bench, "\"build\": \"%s %s\", \"host\": \"%s\", ", __DATE__, __TIME__, host);
+	fprintf(bench, "\"online\": %d, \"use_sse2\": %d, \"fused_blob\": %d, ",
+		ONLINE, USE_SSE2, FUSED_BLOB);
+	fprintf(bench, "\"label_blobs\": %d, \"predict_roi\": %d, \"adapt_roi\": %d, ",
+		LABEL_BLOBS, PREDICT_ROI, ADAPT_ROI);
+	fprintf(bench, "\"applet_moments\": %d,\n", APPLET_MOMENTS);
+	fprintf(bench, "\"runs\": [\n");
+	fflush(bench);
+
+	return FG_OK;
+}
+
+/**
+* adds the summary of one timing run to the file opened by <code>bench_open</code>.
+*
+* <code>bench_run</code> has to be called before the frame grabber is released, so the
+* number of lost images can still be read from it.  Images that were never recorded
+* because the run stopped early are left out of the statistics.  If no file is open
+* <code>bench_run</code> does nothing.
+*
+* @param fg the frame grabber the run used, or NULL if the images came from disk
+* @param timer the timing data of the run
+*
+* @return <code>FG_OK</code> on success, <code>ENOMEM</code> if there was no memory to
+* sort the times
+*/
+
+int bench_run(Fg_Struct *fg, TimingInfo *timer)
+{
+	int n, found, lost;
+	double us, elapsed, fps, mean, std, period_mean, period_std;
+	double *latency, *period, *thresh, *track;
+	FrameInfo *frame = timer->frame;
+
+	if(bench == NULL) {
+		return FG_OK;
+	}
+
+	latency = (double *) malloc(timer->num_imgs * sizeof(double));
+	period = (double *) malloc(timer->num_imgs * sizeof(double));
+	thresh = (double *) malloc(timer->num_imgs * sizeof(double));
+	track = (double *) malloc(timer->num_imgs * sizeof(double));
+	if(latency == NULL || period == NULL || thresh == NULL || track == NULL) {
+		free(latency);
+		free(period);
+		free(thresh);
+		free(track);
+		return ENOMEM;
+	}
+
+	us = 1e6 / timer->freq.QuadPart;
+	found = 0;
+	for(n = 0; n < timer->num_imgs && frame[n].pc_ts.QuadPart != 0; n++) {
+		latency[n] = (frame[n].blob_stop.QuadPart - frame[n].grab_stop.QuadPart) * us;
+		thresh[n] = (frame[n].thresh_stop.QuadPart - frame[n].thresh_start.QuadPart) * us;
+		track[n] = (frame[n].blob_stop.QuadPart - frame[n].blob_start.QuadPart) * us;
+		if(n > 0) {
+			period[n - 1] = (frame[n].pc_ts.QuadPart - frame[n - 1].pc_ts.QuadPart) * us;
+		}
+		if(frame[n].blob_found == OBJECT_FOUND) {
+			found++;
+		}
+	}
+
+	elapsed = (n > 1) ? (frame[n - 1].pc_ts.QuadPart - frame[0].pc_ts.QuadPart) * us : 0;
+	fps = (elapsed > 0) ? (n - 1) * 1e6 / elapsed : 0;
+	lost = (fg != NULL) ? cam_status(fg, NUMBER_OF_LOST_IMAGES, PORT_A) : NOT_APPLICABLE;
+
+	mean_std(latency, n, &mean, &std);
+	mean_std(period, (n > 1) ? n - 1 : 0, &period_mean, &period_std);
+	qsort(latency, n, sizeof(double), compare_double);
+	qsort(period, (n > 1) ? n - 1 : 0, sizeof(double), compare_double);
+	qsort(thresh, n, sizeof(double), compare_double);
+	qsort(track, n, sizeof(double), compare_double);
+
+	runs++;
+	fprintf(bench, "%s{\"run\": %d, \"width\": %d, \"height\": %d, ",
+		(runs > 1) ? ",\n" : "", runs, timer->roi_w, timer->roi_h);
+	fprintf(bench, "\"frame_us\": %g, \"exposure_us\": %g, ", timer->roi_f, timer->roi_e);
+	fprintf(bench, "\"requested\": %d, \"recorded\": %d, \"found\": %d, \"lost\": %d, ",
+		timer->num_imgs, n, found, lost);
+	fprintf(bench, "\"requested_fps\": %.1f, \"achieved_fps\": %.1f, ",
+		(timer->roi_f > 0) ? 1e6 / timer->roi_f : 0, fps);
+	fprintf(bench, "\"latency_mean\": %.2f, \"latency_std\": %.2f, ", mean, std);
+	fprintf(bench, "\"latency_p50\": %.2f, \"latency_p99\": %.2f, \"latency_p999\": %.2f, ",
+		percentile(latency, n, 50), percentile(latency, n, 99), percentile(latency, n, 99.9));
+	fprintf(bench, "\"period_mean\": %.2f, \"period_std\": %.2f, ", period_mean, period_std);
+	fprintf(bench, "\"period_p50\": %.2f, \"period_p99\": %.2f, \"period_p999\": %.2f, ",
+		percentile(period, n - 1, 50), percentile(period, n - 1, 99),
+		percentile(period, n - 1, 99.9));
+	fprintf(bench, "\"thresh_p50\": %.2f, \"thresh_p99\": %.2f, ",
+		percentile(thresh, n, 50), percentile(thresh, n, 99));
+	fprintf(bench, "\"track_p50\": %.2f, \"track_p99\": %.2f}",
+		percentile(track, n, 50), percentile(track, n, 99));
+	fflush(bench);
+
+	printf("bench: %dx%d frame %g us: %.1f fps, latency p50 %.2f p99 %.2f us, lost %d\n",
+		timer->roi_w, timer->roi_h, timer->roi_f, fps, percentile(latency, n, 50),
+		percentile(latency, n, 99), lost);
+
+	free(latency);
+	free(period);
+	free(thresh);
+	free(track);
+
+	return FG_OK;
+}
+
+/**
+* finishes and closes the file opened by <code>bench_open</code>.
+*/
+
+int bench_close()
+{
+	if(bench == NULL) {
+		return FG_OK;
+	}
+
+	fprintf(bench, "\n]\n}\n");
+	fclose(bench);
+	bench = NULL;
+
+	return FG_OK;
+}
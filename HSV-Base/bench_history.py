@@ -0,0 +1,181 @@
+"""
+	Keeps the runs of the benchmark summaries written by bench.cpp and compares
+	builds.
+
+	python bench_history.py add bench.json [history.csv] [build]
+		appends every run of bench.json to history.csv, under the name build
+		(the build date and time of the summary if it is left out).
+
+	python bench_history.py compare history.csv base new
+		compares the runs of build new with the runs of build base on the same
+		host, ROI size, frame time and exposure.  A run setting is flagged when
+		the achieved frame rate dropped by a significant amount, or the p99 of
+		a stage time rose by more than P99_TOLERANCE.  The exit status is 1 if
+		anything was flagged.
+
+	A note on local variable suffix naming conventions:
+	b = base build, n = new build
+"""
+
+from math import sqrt
+from sys import argv, exit
+import csv
+import json
+import os
+import time
+
+# a run is identified by these columns
+KEY = ['host', 'width', 'height', 'frame_us', 'exposure_us']
+
+# the columns of the history, in order
+COLUMNS = ['added', 'build'] + KEY + [
+			'online', 'use_sse2', 'fused_blob', 'label_blobs', 'predict_roi',
+			'adapt_roi', 'applet_moments',
+			'requested', 'recorded', 'found', 'lost',
+			'requested_fps', 'achieved_fps',
+			'latency_mean', 'latency_std', 'latency_p50', 'latency_p99', 'latency_p999',
+			'period_mean', 'period_std', 'period_p50', 'period_p99', 'period_p999',
+			'thresh_p50', 'thresh_p99', 'track_p50', 'track_p99'
+		]
+
+# the stage times whose p99 is compared
+P99 = ['latency_p99', 'period_p99', 'thresh_p99', 'track_p99']
+
+# the fraction a p99 may rise by before it is flagged
+P99_TOLERANCE = 0.10
+
+# the fraction the frame rate has to drop by to be flagged, however significant
+MIN_DROP = 0.01
+
+# one-sided critical values of Student's t at 1% for 1 to 30 degrees of freedom
+T_CRIT = [31.82, 6.965, 4.541, 3.747, 3.365, 3.143, 2.998, 2.896, 2.821, 2.764,
+			2.718, 2.681, 2.650, 2.624, 2.602, 2.583, 2.567, 2.552, 2.539, 2.528,
+			2.518, 2.508, 2.500, 2.492, 2.485, 2.479, 2.473, 2.467, 2.462, 2.457]
+Z_CRIT = 2.326
+
+def add(summary, history, build):
+	"""Append the runs of a bench.json summary to the history."""
+	f = open(summary)
+	s = json.load(f)
+	f.close()
+
+	if build is None:
+		build = s['build']
+
+	exists = os.path.exists(history)
+	f = open(history, 'ab')
+	w = csv.DictWriter(f, COLUMNS, restval='', extrasaction='ignore')
+	if not exists:
+		w.writerow(dict(zip(COLUMNS, COLUMNS)))
+
+	added = time.strftime('%Y-%m-%d %H:%M:%S')
+	for run in s['runs']:
+		row = dict(s)
+		row.update(run)
+		row['added'] = added
+		row['build'] = build
+		w.writerow(row)
+
+	f.close()
+	print 'added %d runs of %s to %s' % (len(s['runs']), build, history)
+
+def load(history):
+	"""The runs of the history, grouped by build and then by KEY."""
+	builds = {}
+	f = open(history, 'rb')
+	for row in csv.DictReader(f):
+		key = tuple([row[k] for k in KEY])
+		builds.setdefault(row['build'], {}).setdefault(key, []).append(row)
+	f.close()
+
+	return builds
+
+def pooled(runs):
+	"""The mean, variance and number of the frame periods of all runs."""
+	n = 0
+	s = 0.0
+	ss = 0.0
+
+	for r in runs:
+		k = int(r['recorded']) - 1
+		if k <= 0:
+			continue
+		m = float(r['period_mean'])
+		sd = float(r['period_std'])
+		n = n + k
+		s = s + k * m
+		ss = ss + (k - 1) * sd * sd + k * m * m
+
+	if n < 2:
+		return (0.0, 0.0, n)
+
+	m = s / n
+	return (m, (ss - n * m * m) / (n - 1), n)
+
+def slower(b, n):
+	"""True if the mean period of n is significantly longer than the one of b."""
+	(m_b, v_b, n_b) = b
+	(m_n, v_n, n_n) = n
+	if n_b < 2 or n_n < 2 or m_n <= m_b:
+		return False
+
+	# Welch's t test with the Welch-Satterthwaite degrees of freedom
+	e_b = v_b / n_b
+	e_n = v_n / n_n
+	if e_b + e_n == 0:
+		return True
+	t = (m_n - m_b) / sqrt(e_b + e_n)
+	df = (e_b + e_n) ** 2 / (e_b * e_b / (n_b - 1) + e_n * e_n / (n_n - 1))
+
+	if df < len(T_CRIT):
+		return t > T_CRIT[max(int(df), 1) - 1]
+	return t > Z_CRIT
+
+def median(x):
+	x = sorted(x)
+	return x[len(x) / 2] if len(x) % 2 else (x[len(x) / 2 - 1] + x[len(x) / 2]) / 2.0
+
+def compare(history, base, new):
+	"""Print the run settings that got worse from build base to build new."""
+	builds = load(history)
+	for name in (base, new):
+		if name not in builds:
+			print 'no runs of build %s in %s' % (name, history)
+			return 2
+
+	flagged = 0
+	print '\t'.join(KEY + ['measure', base, new, 'change'])
+	for key in sorted(builds[base].keys()):
+		if key not in builds[new]:
+			continue
+		runs_b = builds[base][key]
+		runs_n = builds[new][key]
+
+		b = pooled(runs_b)
+		n = pooled(runs_n)
+		if b[0] > 0 and n[0] > 0 and slower(b, n) and n[0] > b[0] * (1 + MIN_DROP):
+			fps_b = 1e6 / b[0]
+			fps_n = 1e6 / n[0]
+			print '\t'.join(list(key) + ['achieved_fps', '%.1f' % fps_b, '%.1f' % fps_n,
+				'%+.1f%%' % (100 * (fps_n - fps_b) / fps_b)])
+			flagged = flagged + 1
+
+		for p in P99:
+			x_b = median([float(r[p]) for r in runs_b if r[p] != ''] or [0])
+			x_n = median([float(r[p]) for r in runs_n if r[p] != ''] or [0])
+			if x_b > 0 and x_n > x_b * (1 + P99_TOLERANCE):
+				print '\t'.join(list(key) + [p, '%.2f' % x_b, '%.2f' % x_n,
+					'%+.1f%%' % (100 * (x_n - x_b) / x_b)])
+				flagged = flagged + 1
+
+	print '%d regressions from %s to %s' % (flagged, base, new)
+	return 1 if flagged else 0
+
+if len(argv) >= 3 and argv[1] == 'add':
+	add(argv[2], argv[3] if len(argv) > 3 else 'bench_history.csv',
+		argv[4] if len(argv) > 4 else None)
+elif len(argv) == 5 and argv[1] == 'compare':
+	exit(compare(argv[2], argv[3], argv[4]))
+else:
+	print __doc__
+	exit(2)
@@ -0,0 +1,504 @@
+/**
+* @file bitimg.cpp morphology on binarized images packed 64 pixels to a word.
+*
+* <code>erode</code> and <code>boundary</code> in imgproc.cpp look at four neighbors per
+* pixel through <code>PIXEL</code>, check the bounds of each one and change the image in
+* place, so their result depends on the order the pixels are visited.  A BitImage holds
+* one bit per pixel instead, so a whole word of 64 pixels and its four neighbors are
+* combined with a handful of shifts, ANDs and ORs, and every operation writes a separate
+* destination so the result does not depend on the scan order.
+*
+* bit k of word m in a row is pixel m * 64 + k of that row.  The unused bits at the end
+* of each row are always zero and pixels outside the image count as background, which
+* matches how <code>boundary</code> treats the edge of the window.
+*
+* the structuring element is the 4-connected cross the rest of imgproc.cpp uses.
+*/
+
+#include "fcdynamic.h"
+
+#if USE_SSE2
+#include <intrin.h>
+#endif
+
+#define BITS 64
+#define WORD_BITS(x) ((x) / BITS)
+#define BIT(x) ((x) % BITS)
+
+#define ROW(b, i) ((b)->bits + (i) * (b)->words)
+
+/**
+* the images used by <code>packed_erode</code> and <code>packed_blob</code>, grown to
+* the largest ROI they have seen.  Every thread has its own, so the workers of
+* window_run.cpp can pack their windows at the same time.
+*/
+static __declspec(thread) BitImage packed = {0};
+static __declspec(thread) BitImage scratch = {0};
+
+/**
+* the mask of the bits in the last word of a row that are inside the image
+*/
+static bitword last_mask(BitImage *b)
+{
+	int n = b->w - (b->words - 1) * BITS;
+
+	return (n == BITS) ? ~(bitword) 0 : (((bitword) 1 << n) - 1);
+}
+
+static int first_bit(bitword w)
+{
+	unsigned long bit;
+
+#if USE_SSE2
+	// there is no 64 bit scan on 32 bit targets
+	if((unsigned int) w != 0) {
+		_BitScanForward(&bit, (unsigned int) w);
+		return bit;
+	}
+	_BitScanForward(&bit, (unsigned int) (w >> 32));
+	return bit + 32;
+#else
+	for(bit = 0; !(w & 1); bit++) {
+		w >>= 1;
+	}
+	return bit;
+#endif
+}
+
+static int last_bit(bitword w)
+{
+	unsigned long bit;
+
+#if USE_SSE2
+	if((unsigned int) (w >> 32) != 0) {
+		_BitScanReverse(&bit, (unsigned int) (w >> 32));
+		return bit + 32;
+	}
+	_BitScanReverse(&bit, (unsigned int) w);
+	return bit;
+#else
+	for(bit = BITS - 1; !(w >> bit); bit--);
+	return bit;
+#endif
+}
+
+/**
+* allocates a BitImage large enough for a <code>w</code> x <code>h</code> window.
+*
+* @return <code>FG_OK</code> on success, otherwise <code>ENOMEM</code>
+*/
+
+int bits_alloc(BitImage *b, int w, int h)
+{
+	memset(b, 0, sizeof(BitImage));
+
+	b->max_words = (WORD_BITS(w + BITS - 1)) * h;
+	b->bits = (bitword *) calloc(b->max_words, sizeof(bitword));
+	if(b->bits == NULL) {
+		return ENOMEM;
+	}
+
+	return FG_OK;
+}
+
+void bits_free(BitImage *b)
+{
+	free(b->bits);
+	b->bits = NULL;
+	b->max_words = 0;
+}
+
+static int bits_size(BitImage *b, int x, int y, int w, int h)
+{
+	b->x = x;
+	b->y = y;
+	b->w = w;
+	b->h = h;
+	b->words = WORD_BITS(w + BITS - 1);
+
+	if(b->words * h > b->max_words) {
+		b->w = 0;
+		b->h = 0;
+		b->words = 0;
+		return ENOMEM;
+	}
+
+	return FG_OK;
+}
+
+/**
+* packs the binarized pixels inside the blob rectangle of <code>win</code>.
+*
+* the BitImage covers [<code>win->blob_xmin</code>, <code>win->blob_ymin</code>] up to
+* but not including [<code>win->blob_xmax</code>, <code>win->blob_ymax</code>], the same
+* pixels <code>threshold</code> binarized.  A bit is set for every
+* <code>FOREGROUND</code> pixel.
+*
+* @param win the TrackingWindow after <code>threshold</code>
+* @param b the BitImage to pack into, allocated with <code>bits_alloc</code>
+*
+* @return <code>FG_OK</code> on success, <code>ENOMEM</code> if <code>b</code> is too
+* small for the blob rectangle
+*/
+
+int bits_pack(TrackingWindow *win, BitImage *b)
+{
+	int i, j, rc;
+	unsigned char *px;
+	bitword *row, word;
+
+	rc = bits_size(b, win->blob_xmin, win->blob_ymin, win->blob_xmax - win->blob_xmin,
+		win->blob_ymax - win->blob_ymin);
+	if(rc != FG_OK) {
+		return rc;
+	}
+
+	for(i = 0; i < b->h; i++) {
+		px = &PIXEL(win, b->y + i, b->x);
+		row = ROW(b, i);
+		word = 0;
+
+		for(j = 0; j < b->w; j++) {
+			word |= (bitword) (px[j] == FOREGROUND) << BIT(j);
+			if(BIT(j) == BITS - 1) {
+				row[WORD_BITS(j)] = word;
+				word = 0;
+			}
+		}
+		if(BIT(b->w) != 0) {
+			row[WORD_BITS(b->w)] = word;
+		}
+	}
+
+	return FG_OK;
+}
+
+/**
+* writes a BitImage back into the pixels of <code>win</code>.
+*
+* set bits become <code>fg</code> pixels and cleared bits <code>BACKGROUND</code>
+* pixels, so the result of <code>bits_boundary</code> can be shown as
+* <code>BORDER</code> like <code>boundary</code> does.
+*
+* @param b the BitImage to unpack
+* @param win the TrackingWindow the BitImage was packed from
+* @param fg the value of the pixels with their bit set
+*/
+
+void bits_unpack(BitImage *b, TrackingWindow *win, int fg)
+{
+	int i, j;
+	unsigned char *px;
+	bitword *row;
+
+	for(i = 0; i < b->h; i++) {
+		px = &PIXEL(win, b->y + i, b->x);
+		row = ROW(b, i);
+
+		for(j = 0; j < b->w; j++) {
+			px[j] = ((row[WORD_BITS(j)] >> BIT(j)) & 1) ? fg : BACKGROUND;
+		}
+	}
+}
+
+/**
+* the operations computed from a pixel word and its four neighbors
+*/
+enum bits_op {BITS_ERODE, BITS_DILATE, BITS_BOUNDARY, BITS_DENOISE};
+
+static int bits_apply(BitImage *src, BitImage *dst, int op)
+{
+	int i, m, rc;
+	bitword c, up, down, left, right, prev, next, mask;
+	bitword *row, *above, *below, *out;
+
+	rc = bits_size(dst, src->x, src->y, src->w, src->h);
+	if(rc != FG_OK) {
+		return rc;
+	}
+	if(src->words == 0) {
+		return FG_OK;
+	}
+	mask = last_mask(src);
+
+	for(i = 0; i < src->h; i++) {
+		row = ROW(src, i);
+		above = (i > 0) ? ROW(src, i - 1) : NULL;
+		below = (i + 1 < src->h) ? ROW(src, i + 1) : NULL;
+		out = ROW(dst, i);
+
+		prev = 0;
+		for(m = 0; m < src->words; m++) {
+			c = row[m];
+			next = (m + 1 < src->words) ? row[m + 1] : 0;
+			up = above ? above[m] : 0;
+			down = below ? below[m] : 0;
+
+			// bit k of left is the pixel left of pixel k, carried in from the previous word
+			left = (c << 1) | (prev >> (BITS - 1));
+			right = (c >> 1) | (next << (BITS - 1));
+
+			switch(op) {
+				case BITS_ERODE:
+					c &= up & down & left & right;
+					break;
+				case BITS_DILATE:
+					c |= up | down | left | right;
+					break;
+				case BITS_BOUNDARY:
+					c &= ~(up & down & left & right);
+					break;
+				case BITS_DENOISE:
+					c &= up | down | left | right;
+					break;
+			}
+
+			prev = row[m];
+			out[m] = c;
+		}
+
+		// dilation can spill into the unused bits at the end of the row
+		out[src->words - 1] &= mask;
+	}
+
+	return FG_OK;
+}
+
+/**
+* shrinks the foreground by one pixel, a pixel stays set if it and its four neighbors
+* are set.
+*
+* @param src the BitImage to erode
+* @param dst the result, which must not be <code>src</code>
+*
+* @return <code>FG_OK</code> on success, <code>ENOMEM</code> if <code>dst</code> is too
+* small
+*/
+
+int bits_erode(BitImage *src, BitImage *dst)
+{
+	return bits_apply(src, dst, BITS_ERODE);
+}
+
+/**
+* grows the foreground by one pixel, a pixel is set if it or one of its four neighbors
+* is set.
+*
+* @see bits_erode
+*/
+
+int bits_dilate(BitImage *src, BitImage *dst)
+{
+	return bits_apply(src, dst, BITS_DILATE);
+}
+
+/**
+* keeps the foreground pixels with at least one background neighbor, like
+* <code>boundary</code>.
+*
+* @see bits_erode
+*/
+
+int bits_boundary(BitImage *src, BitImage *dst)
+{
+	return bits_apply(src, dst, BITS_BOUNDARY);
+}
+
+/**
+* clears the foreground pixels without a foreground neighbor, which is what
+* <code>erode</code> in imgproc.cpp does, without depending on the scan order.
+*
+* @see bits_erode
+*/
+
+int bits_denoise(BitImage *src, BitImage *dst)
+{
+	return bits_apply(src, dst, BITS_DENOISE);
+}
+
+/**
+* an erosion followed by a dilation, removes foreground specks smaller than the cross.
+*
+* @param b the BitImage to open, which holds the result
+* @param tmp a BitImage as large as <code>b</code> used for the erosion
+*
+* @return <code>FG_OK</code> on success, <code>ENOMEM</code> if <code>tmp</code> is too
+* small
+*/
+
+int bits_open(BitImage *b, BitImage *tmp)
+{
+	int rc;
+
+	rc = bits_erode(b, tmp);
+	if(rc != FG_OK) {
+		return rc;
+	}
+
+	return bits_dilate(tmp, b);
+}
+
+/**
+* a dilation followed by an erosion, fills background holes smaller than the cross.
+*
+* @see bits_open
+*/
+
+int bits_close(BitImage *b, BitImage *tmp)
+{
+	int rc;
+
+	rc = bits_dilate(b, tmp);
+	if(rc != FG_OK) {
+		return rc;
+	}
+
+	return bits_erode(tmp, b);
+}
+
+/**
+* produces a tight rectangular bounding box around the set bits.
+*
+* <code>bits_blob</code> is <code>blob</code> for a BitImage: it only looks at whole
+* words and finds the first and last set bit of a word with a bit scan.
+*
+* @param b the BitImage packed from <code>win</code>
+* @param win the TrackingWindow to update with the bounding box in the ROI reference
+* frame
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @note like <code>blob</code>, the blob parameters of <code>win</code> are only updated
+* when an object is found.
+*/
+
+int bits_blob(BitImage *b, TrackingWindow *win)
+{
+	int i, m, x;
+	int box_xmin, box_ymin, box_xmax, box_ymax;
+	bitword *row;
+
+	box_xmin = b->w;
+	box_ymin = b->h;
+	box_xmax = -1;
+	box_ymax = -1;
+
+	for(i = 0; i < b->h; i++) {
+		row = ROW(b, i);
+
+		for(m = 0; m < b->words; m++) {
+			if(row[m] == 0) {
+				continue;
+			}
+
+			x = m * BITS + first_bit(row[m]);
+			if(box_xmin > x) {
+				box_xmin = x;
+			}
+			x = m * BITS + last_bit(row[m]);
+			if(box_xmax < x) {
+				box_xmax = x;
+			}
+			if(box_ymin > i) {
+				box_ymin = i;
+			}
+			box_ymax = i;
+		}
+	}
+
+	if(box_ymax < 0) {
+		return !OBJECT_FOUND;
+	}
+
+	win->blob_xmin = b->x + box_xmin;
+	win->blob_ymin = b->y + box_ymin;
+	win->blob_xmax = b->x + box_xmax;
+	win->blob_ymax = b->y + box_ymax;
+
+	assert(win->blob_xmin >= 0);
+	assert(win->blob_ymin >= 0);
+	assert(win->blob_xmax <= win->roi_w);
+	assert(win->blob_ymax <= win->roi_h);
+
+	return OBJECT_FOUND;
+}
+
+/**
+* makes sure <code>b</code> can hold a <code>w</code> x <code>h</code> window, growing it
+* if it cannot.
+*/
+static int bits_reserve(BitImage *b, int w, int h)
+{
+	if(WORD_BITS(w + BITS - 1) * h <= b->max_words) {
+		return FG_OK;
+	}
+
+	bits_free(b);
+	return bits_alloc(b, w, h);
+}
+
+/**
+* a drop-in replacement for <code>erode</code> that packs the blob rectangle, removes
+* the isolated foreground pixels with <code>bits_denoise</code> and writes the result
+* back.
+*
+* @param win the TrackingWindow after <code>threshold</code>
+*
+* @return <code>FG_OK</code> on success, <code>ENOMEM</code> if the BitImages could not
+* be allocated
+*
+* @note the BitImages are kept in thread local variables and only freed with the
+* process, so every thread calling <code>packed_erode</code> keeps its own.
+*/
+
+int packed_erode(TrackingWindow *win)
+{
+	int rc;
+	PMC_SAMPLE(pmc);
+
+	rc = bits_reserve(&packed, win->roi_w, win->roi_h);
+	if(rc == FG_OK) {
+		rc = bits_reserve(&scratch, win->roi_w, win->roi_h);
+	}
+	if(rc != FG_OK) {
+		return rc;
+	}
+
+	PMC_BEGIN(pmc);
+	bits_pack(win, &packed);
+	bits_denoise(&packed, &scratch);
+	bits_unpack(&scratch, win, FOREGROUND);
+	PMC_END(PMC_ERODE, win->roi, pmc);
+
+	return FG_OK;
+}
+
+/**
+* a drop-in replacement for <code>blob</code> that works on the packed image.
+*
+* <code>packed_blob</code> packs the blob rectangle, removes the isolated foreground
+* pixels and takes the bounding box with <code>bits_blob</code>, so
+* <code>position</code> never goes back to the byte image after
+* <code>threshold</code>.
+*
+* @param win the TrackingWindow after <code>threshold</code>
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @see packed_erode
+*/
+
+int packed_blob(TrackingWindow *win)
+{
+	if(bits_reserve(&packed, win->roi_w, win->roi_h) != FG_OK ||
+		bits_reserve(&scratch, win->roi_w, win->roi_h) != FG_OK) {
+		return !OBJECT_FOUND;
+	}
+
+	bits_pack(win, &packed);
+	bits_denoise(&packed, &scratch);
+
+	return bits_blob(&scratch, win);
+}
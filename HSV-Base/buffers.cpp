@@ -0,0 +1,169 @@
+/**
+* @file buffers.cpp decides how many DMA buffers a run gets and how large they are.
+*
+* the frame grabber keeps writing images while the tracking loop is busy, so the ring
+* has to hold every image that completes while the loop is away from it.  After every
+* timing run <code>buffers_observe</code> keeps the longest time the loop was away,
+* and <code>buffers_needed</code> turns it into a count for the next run at its frame
+* time.  The estimate follows the runs: a worse run raises it right away, better runs
+* only lower it by BUFFER_DECAY per run, so one quiet run does not undo the margin.
+* Until a run was observed NUM_BUFFERS is used.
+*
+* every buffer is sized for the largest ROI of the sequence, so a sequence that mixes
+* ROI sizes or grows its ROIs with <code>adapt_roi</code> does not overrun them.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the least and the most buffers a run gets
+*/
+#define MIN_BUFFERS 4
+#define MAX_BUFFERS 1024
+
+/**
+* the most bytes of pinned memory the buffers of one run may take
+*/
+#define MAX_BUFFER_MEM (64 * 1024 * 1024)
+
+/**
+* the buffers kept on top of the ones the worst observed latency needs
+*/
+#define BUFFER_SLACK 2
+
+/**
+* the fraction of the old estimate kept by a run that was away for less time
+*/
+#define BUFFER_DECAY 0.5
+
+static double worst_us = 0;
+
+/**
+* updates the latency estimate with the timing data of a run.
+*
+* the loop is away from the ring from the time it got an image until it asks for the
+* next one, which is the time it took to process the image and record it.
+*
+* @param timer the timing data of the run
+*/
+
+void buffers_observe(TimingInfo *timer)
+{
+	int n;
+	double us, away, worst;
+	FrameInfo *frame = timer->frame;
+
+	us = 1e6 / timer->freq.QuadPart;
+	worst = 0;
+	for(n = 1; n < timer->num_imgs && frame[n].pc_ts.QuadPart != 0; n++) {
+		away = (frame[n].grab_start.QuadPart - frame[n - 1].grab_stop.QuadPart) * us;
+		if(away > worst) {
+			worst = away;
+		}
+	}
+
+	if(n < 2) {
+		return;
+	}
+
+	if(worst > worst_us) {
+		worst_us = worst;
+	}
+	else {
+		worst_us = BUFFER_DECAY * worst_us + (1 - BUFFER_DECAY) * worst;
+	}
+}
+
+/**
+* the largest buffer any ROI of the sequence needs, in bytes
+*
+* a ROI can grow to <code>roi_max_w</code> x <code>roi_max_h</code>, or stays its size
+* if the maximum was never set.
+*/
+
+int buffer_size(TrackingSequence *tseq)
+{
+	int i, w, h, size, max;
+	TrackingWindow *win;
+
+	max = 0;
+	for(i = 0; i < tseq->seq_len; i++) {
+		win = tseq->windows + tseq->seq[i];
+		w = (win->roi_max_w > win->roi_w) ? win->roi_max_w : win->roi_w;
+		h = (win->roi_max_h > win->roi_h) ? win->roi_max_h : win->roi_h;
+		size = FRAME_BUF_SIZE(w, h);
+		if(size > max) {
+			max = size;
+		}
+	}
+
+	return max;
+}
+
+/**
+* the number of buffers a run with images every <code>frame</code> microseconds needs.
+*
+* @param frame the shortest time between two images of the run in microseconds, 0 or
+* less if it is not known
+* @param size the size of one buffer from <code>buffer_size</code>
+*
+* @return the number of buffers, at least MIN_BUFFERS and at most what fits in
+* MAX_BUFFER_MEM
+*/
+
+int buffers_needed(double frame, int size)
+{
+	int n, most;
+
+	if(worst_us <= 0 || frame <= 0) {
+		n = NUM_BUFFERS;
+	}
+	else {
+		n = (int) ceil(worst_us / frame) + BUFFER_SLACK;
+	}
+
+	most = buffers_most(size);
+	if(n > most) {
+		n = most;
+	}
+	if(n < MIN_BUFFERS) {
+		n = MIN_BUFFERS;
+	}
+
+	return n;
+}
+
+/**
+* the most buffers of <code>size</code> bytes a run may get, at most MAX_BUFFERS and
+* what fits in MAX_BUFFER_MEM
+*/
+
+int buffers_most(int size)
+{
+	int most = (size > 0) ? MAX_BUFFER_MEM / size : MAX_BUFFERS;
+
+	return (most > MAX_BUFFERS) ? MAX_BUFFERS : most;
+}
+
+/**
+* sets <code>tseq->buffers</code> and <code>tseq->buf_size</code> for the next run
+*
+* the frame time is the shortest of the ROIs of the sequence.
+*/
+
+void buffers_plan(TrackingSequence *tseq)
+{
+	int i;
+	double frame, f;
+
+	frame = 0;
+	for(i = 0; i < tseq->seq_len; i++) {
+		f = tseq->windows[tseq->seq[i]].max_frame;
+		if(f > 0 && (frame == 0 || f < frame)) {
+			frame = f;
+		}
+	}
+
+	tseq->buf_size = buffer_size(tseq);
+	tseq->buffers = buffers_needed(frame, tseq->buf_size);
+}
@@ -1,11 +1,50 @@
 /**
-* @file cam.cpp contains functions for initiatlizing, acquiring, and deinitializing the 
+* @file cam.cpp contains functions for initiatlizing, acquiring, and deinitializing the
 * frame grabber and camera.
+*
+* every camera is a Camera, which holds the frame grabber handle, the port, the image
+* memory and the ROI parameter sets of one TrackCam.  Cameras on two ports of the same
+* board share one Fg_Struct, so the board is only initialized by the first of them and
+* only freed by the last.  <code>init_cam</code>, <code>acquire_imgs</code>,
+* <code>deinit_cam</code> and <code>get_mem</code> work on a default camera on port A
+* of the first board, which is what the single camera programs use.
+*
+* a session keeps the default camera open across the runs of a timing sweep.  Loading
+* the applet and pinning the image memory take far longer than a run, so between
+* <code>session_open</code> and <code>session_close</code> <code>init_cam</code> hands
+* out the open camera and <code>deinit_cam</code> only stops the acquisition, and each
+* run only changes the ROI parameter sets.
+*
+* with PINNED_DMA the image memory comes from <code>pinned_alloc</code> and is handed to
+* the grabber buffer by buffer under a memory head, so the acquisition and the status
+* of the port go through the Ex functions of the SDK with that head;
+* <code>cam_status</code> and the FrameRing pick the right ones.
+*
+* @note cameras have to be opened and closed from one thread; once acquiring, each
+* camera can be driven from its own thread.
 */
 
 #include "fcdynamic.h"
 
-static const unsigned long *mem;
+static Camera cam0;
+static Camera *cams[MAX_CAMS];
+static int num_cams = 0;
+
+/**
+* the buffers of the default camera while a session is open, 0 otherwise
+*/
+static int session_buffers = 0;
+static int session_buf_size = 0;
+
+/**
+* Returns the camera used by <code>init_cam</code> and the ROI functions without a
+* Camera argument.
+*/
+
+Camera *default_cam()
+{
+	return &cam0;
+}
 
 /**
 * Returns a pointer to buffer memory allocated by the frame buffer.
@@ -13,133 +52,511 @@ static const unsigned long *mem;
 
 const unsigned long *get_mem()
 {
-	return mem;
+	return cam0.mem;
 }
 
 /**
-* Initializes the framegrabber and camera.
-* 
-* init_cam performs the necessary initialization routines prior to
+* the open camera on <code>board</code>, if there is one
+*/
+static Camera *find_board(int board)
+{
+	int i;
+
+	for(i = 0; i < num_cams; i++) {
+		if(cams[i]->board == board) {
+			return cams[i];
+		}
+	}
+
+	return NULL;
+}
+
+#if PINNED_DMA
+/**
+* allocates the buffers of <code>cam</code> with <code>pinned_alloc</code> and adds them
+* to a memory head of the grabber, one buffer every <code>memsize / buffers</code> bytes
+*/
+static int alloc_pinned(Camera *cam, Fg_Struct *fg, int memsize, int buffers)
+{
+	int i, rc, size;
+	unsigned char *mem;
+	dma_mem *head;
+
+	size = memsize / buffers;
+	mem = (unsigned char *) pinned_alloc(memsize);
+	if(mem == NULL) {
+		printf("camera: no memory for %d buffers of %d bytes\n", buffers, size);
+		return ENOMEM;
+	}
+
+	head = Fg_AllocMemHead(fg, memsize, buffers);
+	if(head == NULL) {
+		pinned_free(mem);
+		return Fg_getLastErrorNumber(fg);
+	}
+
+	for(i = 0; i < buffers; i++) {
+		if(Fg_AddMem(fg, mem + i * size, size, i, head) < 0) {
+			rc = Fg_getLastErrorNumber(fg);
+			while(--i >= 0) {
+				Fg_DelMem(fg, head, i);
+			}
+			Fg_FreeMemHead(fg, head);
+			pinned_free(mem);
+			return rc;
+		}
+	}
+
+	if(pinned_kind(mem) == PINNED_PAGEABLE) {
+		printf("camera: could not lock the %d buffers in memory\n", buffers);
+	}
+
+	cam->mem = (const unsigned long *) mem;
+	cam->head = head;
+	cam->buffers = buffers;
+
+	return FG_OK;
+}
+
+/**
+* gives the buffers of <code>alloc_pinned</code> back
+*/
+static int free_pinned(Camera *cam)
+{
+	int i, rc;
+
+	for(i = 0; i < cam->buffers; i++) {
+		Fg_DelMem(cam->fg, cam->head, i);
+	}
+	rc = Fg_FreeMemHead(cam->fg, cam->head);
+	pinned_free((void *) cam->mem);
+	cam->head = NULL;
+
+	return rc;
+}
+#endif
+
+static void forget(Camera *cam)
+{
+	int i;
+
+	for(i = 0; i < num_cams; i++) {
+		if(cams[i] == cam) {
+			cams[i] = cams[--num_cams];
+			return;
+		}
+	}
+}
+
+/**
+* gives back what <code>cam_init</code> set up for a camera it could not open: the
+* FastConfig state of the port if <code>fastconfig</code> is set, and the board if no
+* other camera shares it (<code>other</code> is NULL).
+*
+* @return the error of the frame grabber that made <code>cam_init</code> fail
+*/
+static int init_failed(Fg_Struct *fg, Camera *other, int port, int fastconfig)
+{
+	int rc = Fg_getLastErrorNumber(fg);
+
+	if(fastconfig) {
+		FastConfigFree(port);
+	}
+	if(other == NULL) {
+		Fg_FreeGrabber(fg);
+	}
+
+	return rc;
+}
+
+/**
+* Initializes the framegrabber and the camera on one of its ports.
+*
+* cam_init performs the necessary initialization routines prior to
 * acquiring images.  <code>memsize</code> should equal the image
 * width x image height x <code>buffers</code>.  Although this is
 * not enforced, undesired behavior may result.
-* 
-* @param grabber an uninitialized Fg_Struct object defined in the Silicon Software API
+*
+* the board is only initialized if no other camera on it is open, otherwise the
+* camera shares the Fg_Struct of the other camera.  The ROI parameters of
+* <code>cam</code> are kept, so the ROIs can be set up before the camera is opened like
+* with <code>init_cam</code>, but <code>cam</code> has to be zeroed before its first use.
+*
+* @param cam the Camera to initialize
+* @param board the index of the frame grabber board, 0 for the first board
+* @param port the port of the board the camera is connected to, PORT_A or PORT_B
 * @param memsize the image buffer memory size in bytes
 * @param buffers the number of buffer to divide the memsize bytes into
 * @param camlink the camera link type as defined in the Silicon Software API
 *
+* @return <code>FG_OK</code> on success, <code>EBUSY</code> if the port is already open,
+* <code>EINVAL</code> if <code>MAX_CAMS</code> cameras are open, otherwise the error of
+* the frame grabber
+*
 * @note camlink is typically set to <code>FG_CL_DUALTAP_8_BIT</code>
 * in order to maximize the number of pixel information that can be sent
 * over the cable (physically) connecting the framegrabber and camera.
+*
+* @see cam_deinit
 */
 
-int init_cam(Fg_Struct **grabber, int memsize, int buffers, int camlink)
+int cam_init(Camera *cam, int board, int port, int memsize, int buffers, int camlink)
 {
-	int rc;
+	int i, rc;
+	Camera *other;
 	Fg_Struct *fg = NULL;
 
-	fg = Fg_Init("FastConfig.dll", 0);
-	if(fg == NULL) {
-		return Fg_getLastErrorNumber(fg);
+	for(i = 0; i < num_cams; i++) {
+		if(cams[i] == cam || (cams[i]->board == board && cams[i]->port == port)) {
+			printf("camera on board %d port %d is already open\n", board, port);
+			return EBUSY;
+		}
+	}
+	if(num_cams == MAX_CAMS) {
+		return EINVAL;
 	}
 
-	rc = Fg_setParameter(fg, FG_CAMERA_LINK_CAMTYP, &camlink, PORT_A);
+	// the ROI parameter sets may already have been set up, only the grabber is new
+	cam->board = board;
+	cam->port = port;
+
+	other = find_board(board);
+	if(other != NULL) {
+		fg = other->fg;
+	}
+	else {
+		fg = Fg_Init(APPLET_NAME, board);
+		if(fg == NULL) {
+			return Fg_getLastErrorNumber(fg);
+		}
+	}
+
+	rc = Fg_setParameter(fg, FG_CAMERA_LINK_CAMTYP, &camlink, port);
 	if(rc != FG_OK) {
-		return Fg_getLastErrorNumber(fg);
+		return init_failed(fg, other, port, FALSE);
 	}
 
-	rc = FastConfigInit(PORT_A);
+	rc = FastConfigInit(port);
 	if(rc != FG_OK) {
-		return Fg_getLastErrorNumber(fg);
+		return init_failed(fg, other, port, FALSE);
 	}
 
-	mem = Fg_AllocMem(fg, memsize, buffers, PORT_A);
-	if(mem == NULL) {
-		return Fg_getLastErrorNumber(fg);
+#if PINNED_DMA
+	rc = alloc_pinned(cam, fg, memsize, buffers);
+	if(rc != FG_OK) {
+		init_failed(fg, other, port, TRUE);
+		return rc;
 	}
+#else
+	cam->mem = Fg_AllocMem(fg, memsize, buffers, port);
+	if(cam->mem == NULL) {
+		return init_failed(fg, other, port, TRUE);
+	}
+	cam->head = NULL;
+	cam->buffers = buffers;
+#endif
+
+	cam->fg = fg;
+	cams[num_cams++] = cam;
 
-	*grabber = fg;
 	return FG_OK;
 }
 
 /**
 * Transfers the initial region of interest (ROI) information to the frame grabber.
-* 
-* acquire_imgs tells the frame grabber to start grabbing an infinite number of images.
+*
+* cam_acquire tells the frame grabber to start grabbing an infinite number of images
+* on the port of <code>cam</code>.
 * This function will also write the ROI parameters to the frame grabber.  The active
 * ROIs will become active on the camera in the order that <code>seq</code> lists
 * them.  After cycling through the list, the sequence repeats itself from the beginning.
-* A <code>seq</code> cannot exceed 4,096 entires and <code>seq_len</code> must equal 
+* A <code>seq</code> cannot exceed 4,096 entires and <code>seq_len</code> must equal
 * the number of entries in <code>seq</code>.
 *
-* @param grabber an initialized Fg_Struct object defined in the Silicon Software API
+* @param cam a Camera initialized by <code>cam_init</code>
 * @param seq the sequence specifying when a ROI is active
 * @param seq_len the length of <code>seq</code>.
 *
 * @see roi.cpp
 */
 
-int acquire_imgs(Fg_Struct *fg, int *seq, int seq_len)
+int cam_acquire(Camera *cam, int *seq, int seq_len)
 {
 	int rc, i;
+	int all[MAX_ROI];
 
-	rc = roi_sequence(fg, seq, seq_len);
+	rc = cam_roi_sequence(cam, seq, seq_len);
 	if(rc != FG_OK) {
 		printf("init of roi failed\n");
-		return Fg_getLastErrorNumber(fg);
+		return Fg_getLastErrorNumber(cam->fg);
 	}
 
+	// the frame grabber has not seen any of the parameter sets yet
 	for(i = 0; i < MAX_ROI; i++) {
-		rc = write_roi(fg, i, 0, !DO_INIT);
-		if(rc != FG_OK) {
-			printf("init of roi %d failed\n", i);
-			return Fg_getLastErrorNumber(fg);
-		}
+		cam_roi_invalidate(cam, i);
+		all[i] = i;
+	}
+
+	rc = cam_write_rois(cam, all, MAX_ROI, 0);
+	if(rc != FG_OK) {
+		printf("init of rois failed\n");
+		return Fg_getLastErrorNumber(cam->fg);
 	}
 
-	rc = Fg_Acquire(fg, PORT_A, GRAB_INFINITE);
-	if(rc != FG_OK){ 
+	if(cam->head != NULL) {
+		rc = Fg_AcquireEx(cam->fg, cam->port, GRAB_INFINITE, ACQ_STANDARD, cam->head);
+	}
+	else {
+		rc = Fg_Acquire(cam->fg, cam->port, GRAB_INFINITE);
+	}
+	if(rc != FG_OK){
 		printf("acquire failed\n");
-		return Fg_getLastErrorNumber(fg);
+		return Fg_getLastErrorNumber(cam->fg);
 	}
+	cam->acquiring = TRUE;
 
 	return FG_OK;
 }
 
-/** 
-* Stops grabbing images and frees resources associated with the frame grabber
+/**
+* Stops grabbing images on the port of <code>cam</code> and keeps the camera open.
 *
-* deinit_cam stops the frame grabber from acquiring images and frees the resources
-* used by the frame grabber.
-
-* @param grabber an initialized Fg_Struct object defined in the Silicon Software API
+* @param cam a Camera initialized by <code>cam_init</code>
 */
 
-int deinit_cam(Fg_Struct *fg)
+int cam_stop(Camera *cam)
 {
 	int rc;
 
-	rc = Fg_stopAcquire(fg, PORT_A);
+	if(cam->fg == NULL || !cam->acquiring) {
+		return FG_OK;
+	}
+
+	if(cam->head != NULL) {
+		rc = Fg_stopAcquireEx(cam->fg, cam->port, cam->head, STOP_SYNC);
+	}
+	else {
+		rc = Fg_stopAcquire(cam->fg, cam->port);
+	}
 	if(rc != FG_OK) {
 		printf("stop acquire failed\n");
-		return Fg_getLastErrorNumber(fg);
+		return Fg_getLastErrorNumber(cam->fg);
 	}
+	cam->acquiring = FALSE;
+
+	return FG_OK;
+}
 
-	rc = Fg_FreeMem(fg, PORT_A);
+/**
+* Stops grabbing images and frees resources associated with the camera
+*
+* cam_deinit stops the frame grabber from acquiring images on the port of
+* <code>cam</code> and frees the memory of the port.  The frame grabber itself is only
+* freed when no other camera on the board is open.
+*
+* @param cam a Camera initialized by <code>cam_init</code>
+*/
+
+int cam_deinit(Camera *cam)
+{
+	int rc;
+	Fg_Struct *fg = cam->fg;
+
+	if(fg == NULL) {
+		return FG_OK;
+	}
+
+	rc = cam_stop(cam);
+	if(rc != FG_OK) {
+		return rc;
+	}
+
+#if PINNED_DMA
+	rc = free_pinned(cam);
+#else
+	rc = Fg_FreeMem(fg, cam->port);
+#endif
 	if(rc != FG_OK) {
 		return Fg_getLastErrorNumber(fg);
 	}
 
-	rc = FastConfigFree(PORT_A);
+	rc = FastConfigFree(cam->port);
 	if(rc != FG_OK) {
 		return Fg_getLastErrorNumber(fg);
 	}
 
+	forget(cam);
+	cam->fg = NULL;
+	cam->mem = NULL;
+	if(find_board(cam->board) != NULL) {
+		return FG_OK;
+	}
+
 	rc = Fg_FreeGrabber(fg);
 	if(rc != FG_OK) {
 		return Fg_getLastErrorNumber(fg);
 	}
 
 	return FG_OK;
-}
\ No newline at end of file
+}
+
+/**
+* Returns a status of the port, see <code>Fg_getStatus</code>, of the memory head of
+* the camera on it if it has one.
+*
+* @param fg the Fg_Struct of the camera
+* @param param the status, like <code>NUMBER_OF_LOST_IMAGES</code>
+* @param port the port of the camera
+*/
+
+int cam_status(Fg_Struct *fg, int param, int port)
+{
+	int i;
+
+	for(i = 0; i < num_cams; i++) {
+		if(cams[i]->fg == fg && cams[i]->port == port && cams[i]->head != NULL) {
+			return Fg_getStatusEx(fg, param, 0, port, cams[i]->head);
+		}
+	}
+
+	return Fg_getStatus(fg, param, 0, port);
+}
+
+/**
+* Initializes the framegrabber and camera.
+*
+* init_cam opens the default camera on port A of the first board, see
+* <code>cam_init</code>.
+*
+* @param grabber an uninitialized Fg_Struct object defined in the Silicon Software API
+* @param memsize the image buffer memory size in bytes
+* @param buffers the number of buffer to divide the memsize bytes into
+* @param camlink the camera link type as defined in the Silicon Software API
+*/
+
+int init_cam(Fg_Struct **grabber, int memsize, int buffers, int camlink)
+{
+	int rc;
+
+	if(session_buffers > 0) {
+		// the session's memory is already allocated and divided
+		if(buffers != session_buffers || memsize > session_buffers * session_buf_size) {
+			printf("init: the session has %d buffers of %d bytes\n", session_buffers,
+				session_buf_size);
+			return EINVAL;
+		}
+		*grabber = cam0.fg;
+		return FG_OK;
+	}
+
+	rc = cam_init(&cam0, 0, PORT_A, memsize, buffers, camlink);
+	if(rc != FG_OK) {
+		return rc;
+	}
+
+	*grabber = cam0.fg;
+	return FG_OK;
+}
+
+/**
+* Starts acquiring on the default camera, see <code>cam_acquire</code>.
+*
+* @param grabber the Fg_Struct returned by <code>init_cam</code>
+* @param seq the sequence specifying when a ROI is active
+* @param seq_len the length of <code>seq</code>.
+*/
+
+int acquire_imgs(Fg_Struct *fg, int *seq, int seq_len)
+{
+	return cam_acquire(&cam0, seq, seq_len);
+}
+
+/**
+* Stops and closes the default camera, see <code>cam_deinit</code>.  While a session is
+* open the camera is only stopped.
+*
+* @param grabber the Fg_Struct returned by <code>init_cam</code>
+*/
+
+int deinit_cam(Fg_Struct *fg)
+{
+	if(session_buffers > 0) {
+		return cam_stop(&cam0);
+	}
+
+	return cam_deinit(&cam0);
+}
+
+/**
+* Opens the default camera for the runs that follow, until <code>session_close</code>.
+*
+* the buffers are allocated once, so they have to hold the largest ROI of every run.
+*
+* @param buf_size the bytes of one buffer
+* @param buffers the number of buffers
+* @param camlink the camera link type as defined in the Silicon Software API
+*
+* @return <code>FG_OK</code> on success, otherwise the error of <code>cam_init</code>
+*/
+
+int session_open(int buf_size, int buffers, int camlink)
+{
+	int rc;
+
+	if(session_buffers > 0) {
+		return EBUSY;
+	}
+
+	rc = cam_init(&cam0, 0, PORT_A, buf_size * buffers, buffers, camlink);
+	if(rc != FG_OK) {
+		printf("session: %s\n", Fg_getLastErrorDescription(cam0.fg));
+		return rc;
+	}
+
+	session_buffers = buffers;
+	session_buf_size = buf_size;
+	printf("session: %d buffers of %d bytes\n", buffers, buf_size);
+
+	return FG_OK;
+}
+
+/**
+* the buffers of the open session.
+*
+* @param buffers set to the number of buffers, may be NULL
+* @param buf_size set to the bytes of one buffer, may be NULL
+*
+* @return TRUE if a session is open, FALSE otherwise and nothing is set
+*/
+
+int session_buffers_of(int *buffers, int *buf_size)
+{
+	if(session_buffers == 0) {
+		return FALSE;
+	}
+
+	if(buffers != NULL) {
+		*buffers = session_buffers;
+	}
+	if(buf_size != NULL) {
+		*buf_size = session_buf_size;
+	}
+
+	return TRUE;
+}
+
+/**
+* Closes the camera opened by <code>session_open</code>.
+*/
+
+int session_close()
+{
+	if(session_buffers == 0) {
+		return FG_OK;
+	}
+
+	session_buffers = 0;
+	session_buf_size = 0;
+
+	return cam_deinit(&cam0);
+}
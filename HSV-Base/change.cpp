@@ -0,0 +1,262 @@
+/**
+* @file change.cpp skips the blob pass for the images of a ROI in which nothing moved.
+*
+* while the object is held still, during a calibration hold or by the stabilization
+* controller, the fused pass of every image of a ROI finds the bounding box and moments
+* of the image before.  A ChangeDetect keeps every CHANGE_ROW_STEP-th row of the blob
+* window of the last image that went through the pass, before it was binarized, and
+* <code>change_blob</code> sums the absolute differences of the same rows of the next
+* image to it with <code>_mm_sad_epu8</code>, 16 pixels at a time.  Up to
+* <code>noise</code> gray values per sampled pixel the image is taken to be the same,
+* and the result of the last pass is handed out again; the window keeps the timestamp
+* of its new image, so the motion model sees the object stand still.
+*
+* the rows are compared against the image of the last pass, not the one before, so a
+* slow drift adds up until it shows.  The row step is kept under half the height of the
+* object, so every object is crossed by two rows, but an object that comes into the
+* blob window between the rows is only seen by a pass; every <code>refresh</code>
+* images a pass is made whatever the rows say.  A window that moved, changed size or
+* threshold, and one with an automatic threshold, automatic exposure or background,
+* which need every image, always gets the pass.
+*
+* @note the pixels of a skipped image are not binarized, which only shows in the image
+* <code>display_run</code> draws.
+*/
+
+#include "fcdynamic.h"
+
+#if USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+* sets up a ChangeDetect for a window of up to <code>w</code> x <code>h</code> pixels.
+*
+* the rows are only allocated again if they do not fit, the detector starts without a
+* result so the first image goes through the pass.
+*
+* @param c the ChangeDetect to set up
+* @param w the largest ROI width of the window
+* @param h the largest ROI height of the window
+* @param noise the mean absolute difference per sampled pixel that is still no change
+* @param refresh the images between two passes a still image gets anyway, 0 for never
+*
+* @return <code>FG_OK</code> or <code>ENOMEM</code>
+*/
+
+int change_init(ChangeDetect *c, int w, int h, int noise, int refresh)
+{
+	int size;
+
+	// a row step of 1 for an object of a row or two
+	size = w * h;
+	if(c->ref == NULL || c->size < size) {
+		free(c->ref);
+		c->ref = (unsigned char *) malloc(size);
+		if(c->ref == NULL) {
+			memset(c, 0, sizeof(ChangeDetect));
+			printf("change: not enough memory for %d sampled pixels\n", size);
+			return ENOMEM;
+		}
+		c->size = size;
+	}
+
+	c->noise = (noise < 0) ? 0 : noise;
+	c->refresh = (refresh < 0) ? 0 : refresh;
+	c->count = 0;
+	c->valid = FALSE;
+	c->reused = 0;
+	c->passes = 0;
+
+	return FG_OK;
+}
+
+/**
+* releases the rows of a ChangeDetect
+*/
+
+void change_free(ChangeDetect *c)
+{
+	free(c->ref);
+	memset(c, 0, sizeof(ChangeDetect));
+}
+
+/**
+* the sum of the absolute differences of <code>n</code> pixels, 16 at a time with SSE2
+*/
+static unsigned int sad_row(const unsigned char *a, const unsigned char *b, int n)
+{
+	int j;
+	unsigned int sum;
+#if USE_SSE2
+	__m128i acc;
+
+	acc = _mm_setzero_si128();
+	for(j = 0; j + 16 <= n; j += 16) {
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (a + j)),
+			_mm_loadu_si128((const __m128i *) (b + j))));
+	}
+	// the sums of the low and the high 8 pixels are in the two halves
+	sum = (unsigned int) _mm_cvtsi128_si32(acc) +
+		(unsigned int) _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#else
+	j = 0;
+	sum = 0;
+#endif
+	for(; j < n; j++) {
+		sum += (a[j] > b[j]) ? a[j] - b[j] : b[j] - a[j];
+	}
+
+	return sum;
+}
+
+/**
+* whether the sampled rows of the blob window are within the noise of the last pass,
+* stopping at the first row that is not
+*/
+static int unchanged(TrackingWindow *win, ChangeDetect *c)
+{
+	int i, w, rows;
+	unsigned int sad, limit;
+	const unsigned char *ref;
+
+	w = c->xmax - c->xmin;
+	rows = (c->ymax - c->ymin + c->step - 1) / c->step;
+	limit = (unsigned int) (c->noise * w * rows);
+
+	sad = 0;
+	ref = c->ref;
+	for(i = c->ymin; i < c->ymax; i += c->step) {
+		sad += sad_row(&PIXEL(win, i, c->xmin), ref, w);
+		if(sad > limit) {
+			return FALSE;
+		}
+		ref += w;
+	}
+
+	return TRUE;
+}
+
+/**
+* finds the object's bounding box, and its moments, unless the image is the same as
+* the one of the last pass of the window.
+*
+* with a ChangeDetect in <code>win->change</code> the sampled rows of the image are
+* compared with those of the last image that went through the pass, and within the
+* noise its result is put back into <code>win</code>.  Otherwise the rows are kept and
+* the pass is made: <code>stage_pass</code>, which runs the StagePlan of the window or
+* the built-in pass.
+*
+* @param win the TrackingWindow to update with the object's bounding box
+* @param t the threshold value
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @see change.cpp
+*/
+
+int change_blob(TrackingWindow *win, int t)
+{
+	int i, rc, w, step;
+	unsigned char *ref;
+	ChangeDetect *c;
+
+	c = win->change;
+	if(c == NULL || win->autot != NULL || win->autoe != NULL || win->bg != NULL) {
+		return stage_pass(win, t);
+	}
+
+	if(c->valid && (c->refresh == 0 || c->count < c->refresh) && c->t == t &&
+		c->roi_xoff == win->roi_xoff && c->roi_yoff == win->roi_yoff &&
+		c->roi_w == win->roi_w && c->roi_h == win->roi_h &&
+		c->xmin == win->blob_xmin && c->ymin == win->blob_ymin &&
+		c->xmax == win->blob_xmax && c->ymax == win->blob_ymax && unchanged(win, c)) {
+		win->blob_xmin = c->box_xmin;
+		win->blob_ymin = c->box_ymin;
+		win->blob_xmax = c->box_xmax;
+		win->blob_ymax = c->box_ymax;
+		win->moments = c->moments;
+		win->area = c->area;
+		win->cx = c->cx;
+		win->cy = c->cy;
+		win->theta = c->theta;
+		c->count++;
+		c->reused++;
+		return c->found;
+	}
+
+	// two rows across the last object, however small
+	step = CHANGE_ROW_STEP;
+	if(c->valid && c->found == OBJECT_FOUND && (c->box_ymax - c->box_ymin + 1) / 2 < step) {
+		step = (c->box_ymax - c->box_ymin + 1) / 2;
+	}
+	if(step < 1) {
+		step = 1;
+	}
+
+	c->valid = FALSE;
+	w = win->blob_xmax - win->blob_xmin;
+	if(w > 0 && win->blob_ymax > win->blob_ymin &&
+		w * ((win->blob_ymax - win->blob_ymin + step - 1) / step) <= c->size) {
+		ref = c->ref;
+		for(i = win->blob_ymin; i < win->blob_ymax; i += step) {
+			memcpy(ref, &PIXEL(win, i, win->blob_xmin), w);
+			ref += w;
+		}
+		c->valid = TRUE;
+	}
+	c->step = step;
+	c->t = t;
+	c->roi_xoff = win->roi_xoff;
+	c->roi_yoff = win->roi_yoff;
+	c->roi_w = win->roi_w;
+	c->roi_h = win->roi_h;
+	c->xmin = win->blob_xmin;
+	c->ymin = win->blob_ymin;
+	c->xmax = win->blob_xmax;
+	c->ymax = win->blob_ymax;
+
+	rc = stage_pass(win, t);
+
+	c->found = rc;
+	c->box_xmin = win->blob_xmin;
+	c->box_ymin = win->blob_ymin;
+	c->box_xmax = win->blob_xmax;
+	c->box_ymax = win->blob_ymax;
+	c->moments = win->moments;
+	c->area = win->area;
+	c->cx = win->cx;
+	c->cy = win->cy;
+	c->theta = win->theta;
+	c->count = 0;
+	c->passes++;
+
+	return rc;
+}
+
+/**
+* prints how many images of the ROIs of a sequence were handed the last result
+*
+* @param tseq the TrackingSequence of the run
+*/
+
+void change_summary(TrackingSequence *tseq)
+{
+	int i, k;
+	ChangeDetect *c;
+
+	for(i = 0; i < tseq->seq_len; i++) {
+		c = tseq->windows[tseq->seq[i]].change;
+		if(c == NULL || (c->reused == 0 && c->passes == 0)) {
+			continue;
+		}
+		// a ROI that appears in the sequence more than once is printed once
+		for(k = 0; k < i && tseq->seq[k] != tseq->seq[i]; k++);
+		if(k < i) {
+			continue;
+		}
+		printf("roi %d: %u images unchanged, %u blob passes\n", tseq->seq[i], c->reused,
+			c->passes);
+	}
+}
@@ -0,0 +1,137 @@
+/**
+* @file clock.cpp maps the frame grabber timestamps to the host's performance counter.
+*
+* FG_TIMESTAMP is taken by the frame grabber when an image arrives, in a timebase of
+* its own that drifts against <code>QueryPerformanceCounter</code>.  A ClockModel fits
+* host = offset + slope * fg over the (timestamp, time the host got the image) pairs
+* of the recent images, so the time of every image can be given in host time.  The
+* sums forget old pairs by CLOCK_FORGET per image, which follows the drift without
+* letting one late image move the fit.
+*
+* the host always gets an image some time after it was stamped, and the fit goes
+* through the average of that delay.  The images that got to the host the quickest
+* are the closest to their stamp, so the fit is moved down to the smallest recent
+* residual.  That floor rises by CLOCK_FLOOR_RISE microseconds per image, so it comes
+* back up when the fit moves.
+*
+* all host times are in microseconds of the performance counter.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the weight a pair keeps per image that follows it
+*/
+#define CLOCK_FORGET 0.999
+
+/**
+* the microseconds the floor of the residuals rises per image
+*/
+#define CLOCK_FLOOR_RISE 0.05
+
+/**
+* the pairs needed before the slope is fitted, until then the timestamps are assumed to
+* be in microseconds
+*/
+#define CLOCK_MIN_PAIRS 16
+
+/**
+* empties a ClockModel
+*/
+
+void clock_init(ClockModel *c)
+{
+	LARGE_INTEGER freq;
+
+	memset(c, 0, sizeof(ClockModel));
+	QueryPerformanceFrequency(&freq);
+	c->us_per_tick = 1e6 / freq.QuadPart;
+	c->slope = 1;
+}
+
+/**
+* adds the timestamp of an image and the time the host got it to the fit.
+*
+* @param c the ClockModel of the frame grabber port the image came from
+* @param fg_ts the FG_TIMESTAMP of the image
+* @param host the <code>QueryPerformanceCounter</code> value when the image was handed
+* to the host
+*/
+
+void clock_update(ClockModel *c, __int64 fg_ts, LONGLONG host)
+{
+	double x, y, dx, dy, w, r;
+
+	// the fit is relative to the first pair so the sums keep their precision
+	if(c->pairs == 0) {
+		c->fg0 = fg_ts;
+		c->host0 = host;
+	}
+	x = (double) (fg_ts - c->fg0);
+	y = (host - c->host0) * c->us_per_tick;
+
+	// exponentially weighted running means and co-moments
+	w = c->weight * CLOCK_FORGET + 1;
+	dx = x - c->mean_x;
+	dy = y - c->mean_y;
+	c->mean_x += dx / w;
+	c->mean_y += dy / w;
+	c->cxx = c->cxx * CLOCK_FORGET + dx * (x - c->mean_x);
+	c->cxy = c->cxy * CLOCK_FORGET + dx * (y - c->mean_y);
+	c->weight = w;
+	c->pairs++;
+
+	if(c->pairs >= CLOCK_MIN_PAIRS && c->cxx > 0) {
+		c->slope = c->cxy / c->cxx;
+	}
+	c->offset = c->mean_y - c->slope * c->mean_x;
+
+	r = y - (c->offset + c->slope * x);
+	if(c->pairs == 1 || r < c->floor) {
+		c->floor = r;
+	}
+	else {
+		c->floor += CLOCK_FLOOR_RISE;
+	}
+}
+
+/**
+* the host time a frame grabber timestamp corresponds to.
+*
+* @param c the ClockModel of the port the timestamp came from
+* @param fg_ts a FG_TIMESTAMP
+*
+* @return the host time in microseconds, 0 before the first <code>clock_update</code>
+*/
+
+double clock_host_us(ClockModel *c, __int64 fg_ts)
+{
+	if(c->pairs == 0) {
+		return 0;
+	}
+
+	return c->host0 * c->us_per_tick + c->offset + c->floor +
+		c->slope * (double) (fg_ts - c->fg0);
+}
+
+/**
+* the host time of the middle of the exposure of an image.
+*
+* the TrackCam sends an image right after its exposure, so the grabber stamps the end
+* of the exposure.
+*
+* @param c the ClockModel of the port the image came from
+* @param fg_ts the FG_TIMESTAMP of the image
+* @param exposure the exposure time of the image in microseconds
+*
+* @return the host time in microseconds, 0 before the first <code>clock_update</code>
+*/
+
+double clock_exposure_us(ClockModel *c, __int64 fg_ts, double exposure)
+{
+	if(c->pairs == 0) {
+		return 0;
+	}
+
+	return clock_host_us(c, fg_ts) - exposure / 2;
+}
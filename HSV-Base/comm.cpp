@@ -1,21 +1,209 @@
-// WinCommExample.cpp : Defines the entry point for the console application.
-//
+/**
+* @file comm.cpp publishes the tracking results over a serial port or UDP.
+*
+* <code>write_comm</code> is called from the tracking loop with the result of every
+* image.  It only packs the result into a single-producer/single-consumer queue and
+* returns, a writer thread takes the results off the queue and sends them, so the
+* tracking loop never waits on the port.  When the port is slower than the tracker the
+* writer only sends the newest result of each ROI and skips the older ones, so the
+* receiver always gets the latest position instead of a growing backlog.
+*
+* every result is sent as one packed, little-endian CommFrame (see below) that starts
+* with the <code>COMM_SYNC</code> bytes and ends with a CRC-16, so a receiver on a
+* serial line can find the start of a frame again after losing bytes.
+*/
 
-#include <windows.h>
-#include <conio.h>
+// winsock2.h has to come before windows.h
+#include <winsock2.h>
 #include "fcdynamic.h"
 
-#define BYTES_TO_SEND 10
+#pragma comment(lib, "ws2_32.lib")
 
-static HANDLE hComm;
-static unsigned char info[BYTES_TO_SEND];
+#define COMM_SERIAL 0
+#define COMM_UDP 1
 
-int open_comm()
+/**
+* the transport used to publish the results, COMM_SERIAL or COMM_UDP
+*/
+#define COMM_TRANSPORT COMM_UDP
+
+#define COMM_PORT TEXT("COM4")
+#define COMM_BAUD 921600
+#define COMM_HOST "192.168.1.65"
+#define COMM_UDP_PORT 3491
+
+#define COMM_SYNC0 'H'
+#define COMM_SYNC1 'V'
+
+/**
+* the number of results the queue holds, must be a power of two
+*/
+#define COMM_QUEUE_LEN 256
+#define COMM_QUEUE_MASK (COMM_QUEUE_LEN - 1)
+
+/**
+* the longest the writer sleeps before looking at the queue again, in milliseconds
+*/
+#define COMM_WAIT 1
+
+#pragma pack(push, 1)
+
+/**
+* one tracking result as it is sent over the wire
+*
+* the blob is given in the image reference frame, so the receiver does not need to know
+* where the ROI was.
+*/
+
+struct comm_frame {
+	unsigned char sync[2]; /**< always <code>COMM_SYNC0</code>, <code>COMM_SYNC1</code> */
+	unsigned char roi;
+	unsigned char found; /**< 1 if the blob was found in the image */
+	unsigned int seq; /**< counts every result, gaps are results that were skipped */
+	__int64 ts; /**< the frame grabber timestamp of the image */
+	__int64 exp_us; /**< the middle of the exposure in host microseconds, 0 if unknown */
+	short blob_x; /**< the x coordinate of the blob center */
+	short blob_y; /**< the y coordinate of the blob center */
+	short blob_w;
+	short blob_h;
+#if WORLD_COORDS
+	float world_x; /**< the centroid on the z = 0 plane of the calibration, see world.cpp */
+	float world_y;
+#endif
+	unsigned short crc; /**< CRC-16-CCITT of the bytes before it */
+};
+
+#pragma pack(pop)
+
+typedef struct comm_frame CommFrame;
+
+/**
+* the single-producer/single-consumer queue between <code>write_comm</code> and the
+* writer thread
+*/
+
+struct comm_queue {
+	volatile LONG head;
+	volatile LONG tail;
+	CommFrame frames[COMM_QUEUE_LEN];
+};
+
+typedef struct comm_queue CommQueue;
+
+static HANDLE hComm = INVALID_HANDLE_VALUE;
+static SOCKET sock = INVALID_SOCKET;
+static struct sockaddr_in dest;
+
+static CommQueue queue;
+static HANDLE writer = NULL;
+static HANDLE wake = NULL;
+static volatile LONG running = FALSE;
+static unsigned int seq = 0;
+static volatile LONG dropped = 0;
+
+static unsigned short crc16(const unsigned char *data, int len)
+{
+	int i;
+	unsigned short crc = 0xffff;
+
+	while(len-- > 0) {
+		crc ^= (unsigned short) (*data++ << 8);
+		for(i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+
+	return crc;
+}
+
+static int send_frame(CommFrame *frame)
+{
+#if COMM_TRANSPORT == COMM_UDP
+	if(sendto(sock, (const char *) frame, sizeof(CommFrame), 0, (struct sockaddr *) &dest,
+		sizeof(dest)) != sizeof(CommFrame)) {
+		return WSAGetLastError();
+	}
+#else
+	DWORD bytes;
+
+	if(WriteFile(hComm, frame, sizeof(CommFrame), &bytes, NULL) == FALSE) {
+		return GetLastError();
+	}
+#endif
+
+	return 0;
+}
+
+static DWORD WINAPI write_thread(LPVOID param)
+{
+	int i, pending;
+	LONG head, tail;
+	CommFrame latest[MAX_ROI];
+	int fresh[MAX_ROI];
+
+	memset(fresh, 0, sizeof(fresh));
+
+	while(running || queue.head != queue.tail) {
+		head = queue.head;
+		tail = queue.tail;
+		MemoryBarrier();
+
+		// keep only the newest result of each roi
+		pending = 0;
+		for(; head != tail; head++) {
+			i = queue.frames[head & COMM_QUEUE_MASK].roi;
+			latest[i] = queue.frames[head & COMM_QUEUE_MASK];
+			if(!fresh[i]) {
+				fresh[i] = TRUE;
+				pending++;
+			}
+		}
+		MemoryBarrier();
+		queue.head = head;
+
+		if(pending == 0) {
+			WaitForSingleObject(wake, COMM_WAIT);
+			continue;
+		}
+
+		for(i = 0; i < MAX_ROI; i++) {
+			if(fresh[i]) {
+				send_frame(latest + i);
+				fresh[i] = FALSE;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int open_port()
 {
-	hComm = CreateFile( TEXT("COM4"),
-                    GENERIC_READ | GENERIC_WRITE, 
-                    0, 
-                    0, 
+#if COMM_TRANSPORT == COMM_UDP
+	WSADATA wsa;
+
+	if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		return -1;
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(sock == INVALID_SOCKET) {
+		WSACleanup();
+		return -2;
+	}
+
+	memset(&dest, 0, sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_port = htons(COMM_UDP_PORT);
+	dest.sin_addr.s_addr = inet_addr(COMM_HOST);
+#else
+	DCB dcb = {0};
+	COMMTIMEOUTS timeouts = {0};
+
+	hComm = CreateFile(COMM_PORT,
+                    GENERIC_READ | GENERIC_WRITE,
+                    0,
+                    0,
                     OPEN_EXISTING,
                     0,
                     0);
@@ -24,13 +212,14 @@ int open_comm()
 		return -1;
 	}
 
-	DCB dcb = {0};
 	if(GetCommState(hComm, &dcb) == 0) {
 		CloseHandle(hComm);
 		return -3;
 	}
 
-	dcb.BaudRate = CBR_9600;
+	// DCB takes any rate the port supports, not only the CBR_ constants
+	dcb.BaudRate = COMM_BAUD;
+	dcb.ByteSize = 8;
 	dcb.fParity = FALSE;
 	dcb.Parity = NOPARITY;
 	dcb.StopBits = ONESTOPBIT;
@@ -42,35 +231,143 @@ int open_comm()
 		return -4;
 	}
 
+	// never let a stuck port hold up the writer for long
+	timeouts.WriteTotalTimeoutConstant = 10;
+	SetCommTimeouts(hComm, &timeouts);
+#endif
+
 	return 0;
 }
 
-int write_comm(TrackingWindow *win, int box_x, int box_y)
+static void close_port()
 {
-/*
-	double theta;
-	DWORD bytes;
+#if COMM_TRANSPORT == COMM_UDP
+	closesocket(sock);
+	sock = INVALID_SOCKET;
+	WSACleanup();
+#else
+	CloseHandle(hComm);
+	hComm = INVALID_HANDLE_VALUE;
+#endif
+}
+
+/**
+* opens the port given by <code>COMM_TRANSPORT</code> and starts the writer thread.
+*
+* @return 0 on success, otherwise a negative value
+*/
+
+int open_comm()
+{
+	int rc;
+
+	rc = open_port();
+	if(rc != 0) {
+		return rc;
+	}
+
+	memset(&queue, 0, sizeof(queue));
+	seq = 0;
+	dropped = 0;
+	running = TRUE;
 
-	theta = atan2(win->yc - box_y, win->xc - box_x) * 10000;
-	info[0] = 'X';
-	info[1] = (unsigned char) (cvRound(win->xc) >> 8);
-	info[2] = (unsigned char) cvRound(win->xc);
-	info[3] = 'Y';
-	info[4] = (unsigned char) (cvRound(win->yc) >> 8);
-	info[5] = (unsigned char) cvRound(win->yc);
-	info[6] = 'T';
-	info[7] = (unsigned char) (cvRound(theta) >> 8);
-	info[8] = (unsigned char) (cvRound(theta));
-
-	if(WriteFile(hComm, info, BYTES_TO_SEND, &bytes, NULL) == FALSE) {
+	wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	writer = CreateThread(NULL, 0, write_thread, NULL, 0, NULL);
+	if(wake == NULL || writer == NULL) {
+		running = FALSE;
+		if(wake != NULL) {
+			CloseHandle(wake);
+		}
+		close_port();
 		return -5;
 	}
+
+	return 0;
+}
+
+/**
+* publishes the position of the blob in <code>win</code>.
+*
+* <code>write_comm</code> never blocks.  It is meant to be called right after
+* <code>position</code> with the result of the image in <code>win->img</code>.
+*
+* @param win the TrackingWindow updated by <code>position</code>
+* @param found the value returned by <code>position</code>
+*
+* @return 0 if the result was queued, -1 if the queue was full and it was dropped
+*
+* @note <code>position</code> has already moved and padded the ROI and the blob for the
+* next image when it returns, so the box that is published is the one it kept with
+* <code>seen_blob</code>, where the blob was seen rather than where it is expected next.
 */
+
+int write_comm(TrackingWindow *win, int found)
+{
+	LONG tail = queue.tail;
+	CommFrame *frame;
+#if WORLD_COORDS
+	double wx, wy;
+#endif
+
+	seq++;
+	if(tail - queue.head == COMM_QUEUE_LEN) {
+		InterlockedIncrement(&dropped);
+		return -1;
+	}
+
+	frame = queue.frames + (tail & COMM_QUEUE_MASK);
+	frame->sync[0] = COMM_SYNC0;
+	frame->sync[1] = COMM_SYNC1;
+	frame->roi = (unsigned char) win->roi;
+	frame->found = found == OBJECT_FOUND;
+	frame->seq = seq;
+	frame->ts = win->ts;
+	frame->exp_us = (__int64) win->exp_us;
+	frame->blob_x = (short) win->seen_x;
+	frame->blob_y = (short) win->seen_y;
+	frame->blob_w = (short) win->seen_w;
+	frame->blob_h = (short) win->seen_h;
+#if WORLD_COORDS
+	// one lookup in the table of the ROI, see world_attach
+#if BLOB_MOMENTS
+	world_point(win, win->cx, win->cy, &wx, &wy);
+#else
+	world_point(win, frame->blob_x, frame->blob_y, &wx, &wy);
+#endif
+	frame->world_x = (float) wx;
+	frame->world_y = (float) wy;
+#endif
+	frame->crc = crc16((unsigned char *) frame, sizeof(CommFrame) - sizeof(frame->crc));
+
+	MemoryBarrier();
+	queue.tail = tail + 1;
+	SetEvent(wake);
+
 	return 0;
 }
 
+/**
+* sends the results still in the queue, stops the writer thread and closes the port.
+*/
+
 int close_comm()
 {
-	CloseHandle(hComm);
+	if(writer == NULL) {
+		return 0;
+	}
+
+	running = FALSE;
+	SetEvent(wake);
+	WaitForSingleObject(writer, INFINITE);
+	CloseHandle(writer);
+	CloseHandle(wake);
+	writer = NULL;
+	wake = NULL;
+
+	if(dropped > 0) {
+		printf("comm: %d results dropped\n", dropped);
+	}
+
+	close_port();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,498 @@
+/**
+* @file config.cpp reads the camera, blob and sweep parameters from an INI file.
+*
+* the parameters used to be macros in main.cpp and skeleton.cpp, so trying another
+* exposure or sweep meant a rebuild.  <code>config_load</code> parses a small INI file
+* once at startup into a Config, which main.cpp then uses to set up the
+* TrackingSequence.  Only the keys found in the file are changed, so a file only needs
+* to list what differs from the defaults.
+*
+* the file looks like:
+*
+* <pre>
+* ; comments start with ';' or '#'
+* [camera]
+* exposure = 20000
+* frame_time = 50000
+*
+* [blob]
+* threshold = 128
+*
+* [sequence]
+* seq = 0, 5
+* </pre>
+*
+* the threshold and exposure can also be changed while the camera is running.
+* <code>config_watch</code> starts a thread that reads the file again whenever it is
+* written, and the tracking loop picks the new values up between images with
+* <code>config_poll</code>, which only costs a compare as long as nothing changed.
+*/
+
+#include "fcdynamic.h"
+#include <stddef.h>
+
+#define CONFIG_LINE 256
+
+#define CFG_INT 0
+#define CFG_DOUBLE 1
+#define CFG_SEQ 2
+#define CFG_STR 3
+
+/**
+* one key of the INI file and where its value goes in a Config
+*/
+struct config_key {
+	const char *section;
+	const char *key;
+	int type;
+	size_t offset;
+};
+
+typedef struct config_key ConfigKey;
+
+static const ConfigKey keys[] = {
+	{"camera", "exposure", CFG_DOUBLE, offsetof(Config, exposure)},
+	{"camera", "frame_time", CFG_DOUBLE, offsetof(Config, frame_time)},
+	{"camera", "img_width", CFG_INT, offsetof(Config, img_w)},
+	{"camera", "img_height", CFG_INT, offsetof(Config, img_h)},
+
+	{"blob", "bounding_box", CFG_INT, offsetof(Config, bounding_box)},
+	{"blob", "xmin", CFG_INT, offsetof(Config, blob_xmin)},
+	{"blob", "ymin", CFG_INT, offsetof(Config, blob_ymin)},
+	{"blob", "width", CFG_INT, offsetof(Config, blob_w)},
+	{"blob", "height", CFG_INT, offsetof(Config, blob_h)},
+	{"blob", "threshold", CFG_INT, offsetof(Config, threshold)},
+	{"blob", "auto_threshold", CFG_INT, offsetof(Config, auto_threshold)},
+	{"blob", "otsu_period", CFG_INT, offsetof(Config, otsu_period)},
+	{"blob", "otsu_smooth", CFG_INT, offsetof(Config, otsu_smooth)},
+
+	{"background", "subtract", CFG_INT, offsetof(Config, background)},
+	{"background", "period", CFG_INT, offsetof(Config, bg_period)},
+	{"background", "file", CFG_STR, offsetof(Config, bg_file)},
+
+	{"exposure", "auto", CFG_INT, offsetof(Config, auto_exposure)},
+	{"exposure", "contrast", CFG_INT, offsetof(Config, ae_contrast)},
+	{"exposure", "min", CFG_DOUBLE, offsetof(Config, ae_min)},
+	{"exposure", "period", CFG_INT, offsetof(Config, ae_period)},
+
+	{"change", "detect", CFG_INT, offsetof(Config, change_detect)},
+	{"change", "noise", CFG_INT, offsetof(Config, change_noise)},
+	{"change", "refresh", CFG_INT, offsetof(Config, change_refresh)},
+	{"stages", "plan", CFG_STR, offsetof(Config, stages)},
+	{"merge", "rois", CFG_INT, offsetof(Config, merge_rois)},
+	{"merge", "gap", CFG_INT, offsetof(Config, merge_gap)},
+	{"rigid", "link", CFG_STR, offsetof(Config, rigid_link)},
+	{"flight", "images", CFG_INT, offsetof(Config, flight_images)},
+	{"world", "calibration", CFG_STR, offsetof(Config, world_file)},
+	{"world", "margin", CFG_INT, offsetof(Config, world_margin)},
+
+	{"sequence", "seq", CFG_SEQ, offsetof(Config, seq)},
+	{"sequence", "latest_wins", CFG_INT, offsetof(Config, latest_wins)},
+
+	{"search", "roi", CFG_INT, offsetof(Config, search_roi)},
+	{"search", "every", CFG_INT, offsetof(Config, search_every)},
+	{"search", "width", CFG_INT, offsetof(Config, search_w)},
+	{"search", "height", CFG_INT, offsetof(Config, search_h)},
+	{"search", "exposure", CFG_DOUBLE, offsetof(Config, search_exposure)},
+
+	{"sweep", "num_imgs", CFG_INT, offsetof(Config, num_imgs)},
+	{"sweep", "min_width", CFG_INT, offsetof(Config, min_width)},
+	{"sweep", "max_width", CFG_INT, offsetof(Config, max_width)},
+	{"sweep", "width_step", CFG_INT, offsetof(Config, width_step)},
+	{"sweep", "min_frame", CFG_DOUBLE, offsetof(Config, min_frame)},
+	{"sweep", "max_frame", CFG_DOUBLE, offsetof(Config, max_frame)},
+	{"sweep", "frame_step", CFG_DOUBLE, offsetof(Config, frame_step)},
+	{"sweep", "exposure_step", CFG_DOUBLE, offsetof(Config, exposure_step)},
+	{"sweep", "replay_frame", CFG_DOUBLE, offsetof(Config, replay_frame)},
+
+	{"timing", "line_us", CFG_DOUBLE, offsetof(Config, line_us)},
+	{"timing", "pixel_us", CFG_DOUBLE, offsetof(Config, pixel_us)},
+	{"timing", "gap_us", CFG_DOUBLE, offsetof(Config, gap_us)},
+	{"timing", "short_width", CFG_INT, offsetof(Config, short_width)},
+
+	{"process", "realtime", CFG_INT, offsetof(Config, rt_profile)},
+	{"process", "cpu", CFG_INT, offsetof(Config, rt_cpu)},
+	{"process", "mmcss", CFG_STR, offsetof(Config, rt_task)},
+	{"process", "timer_ms", CFG_INT, offsetof(Config, rt_timer)},
+};
+
+#define NUM_KEYS ((int) (sizeof(keys) / sizeof(keys[0])))
+
+/**
+* the values handed to <code>config_poll</code> by the watcher thread
+*/
+static CRITICAL_SECTION lock;
+static int lock_init = FALSE;
+static volatile LONG gen = 0;
+static LONG seen = 0;
+static int live_threshold;
+static double live_exposure;
+
+static char watch_name[FILENAME_MAX];
+static HANDLE watcher = NULL;
+static HANDLE stop = NULL;
+static HANDLE change = INVALID_HANDLE_VALUE;
+
+/**
+* fills <code>cfg</code> with the parameters main.cpp was built with.
+*
+* @param cfg the Config to initialize
+*/
+
+void config_defaults(Config *cfg)
+{
+	FrameTiming timing;
+
+	memset(cfg, 0, sizeof(Config));
+
+	// trackcam
+	cfg->exposure = 20000;
+	cfg->frame_time = 50000;
+	cfg->img_w = 1024;
+	cfg->img_h = 1024;
+
+	// initial blob position in the image reference frame
+	cfg->bounding_box = 1024;
+	cfg->blob_xmin = 404 + 45;
+	cfg->blob_ymin = 731 + 56;
+	cfg->blob_w = 25;
+	cfg->blob_h = 20;
+	cfg->threshold = 128;
+	cfg->auto_threshold = FALSE;
+	cfg->otsu_period = OTSU_PERIOD;
+	cfg->otsu_smooth = OTSU_SMOOTH;
+	cfg->background = FALSE;
+	cfg->bg_period = BG_PERIOD;
+	cfg->auto_exposure = FALSE;
+	cfg->ae_contrast = AE_CONTRAST;
+	cfg->ae_min = AE_MIN_EXPOSURE;
+	cfg->ae_period = AE_PERIOD;
+	cfg->change_detect = FALSE;
+	cfg->change_noise = CHANGE_NOISE;
+	cfg->change_refresh = CHANGE_REFRESH;
+	cfg->merge_rois = FALSE;
+	cfg->merge_gap = MERGE_GAP;
+	cfg->flight_images = FLIGHT_IMAGES;
+	cfg->world_margin = WORLD_MARGIN;
+
+	cfg->seq[0] = ROI_0;
+	cfg->seq[1] = ROI_5;
+	cfg->seq_len = 2;
+	cfg->latest_wins = FALSE;
+
+	cfg->search_roi = -1;
+	cfg->search_every = SEARCH_EVERY;
+	cfg->search_w = 0;
+	cfg->search_h = 0;
+	cfg->search_exposure = 0;
+
+	// timer sweep
+	cfg->num_imgs = 100;
+	cfg->min_width = 16;
+	cfg->max_width = 128;
+	cfg->width_step = 2;
+	cfg->min_frame = 10;
+	cfg->max_frame = 100000; // us (10 fps)
+	cfg->frame_step = 10;
+	cfg->exposure_step = 4;
+	cfg->replay_frame = 1000; // us (1 kHz), the simulated frame time when ONLINE == 0
+
+	// the shortest frame times, measured on the oscilloscope
+	frame_timing_init(&timing, CAMLINK);
+	cfg->line_us = timing.line_us;
+	cfg->pixel_us = timing.pixel_us;
+	cfg->gap_us = timing.gap_us;
+	cfg->short_width = timing.short_width;
+
+	// main is the acquisition thread, the pipeline stages pin themselves, see jobs.cpp
+	cfg->rt_profile = TRUE;
+	cfg->rt_cpu = -1;
+	strcpy_s(cfg->rt_task, FILENAME_MAX, "Capture");
+	cfg->rt_timer = 1;
+}
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while(*s == ' ' || *s == '\t') {
+		s++;
+	}
+
+	end = s + strlen(s);
+	while(end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' ||
+		end[-1] == '\n')) {
+		end--;
+	}
+	*end = '\0';
+
+	return s;
+}
+
+static int parse_seq(Config *cfg, char *value)
+{
+	int n = 0, roi;
+	char *tok, *ctx = NULL;
+
+	for(tok = strtok_s(value, ", \t", &ctx); tok != NULL; tok = strtok_s(NULL, ", \t", &ctx)) {
+		roi = atoi(tok);
+		if(n == MAX_ROI || roi < ROI_0 || roi > ROI_7) {
+			return EINVAL;
+		}
+		cfg->seq[n++] = roi;
+	}
+
+	if(n == 0) {
+		return EINVAL;
+	}
+
+	cfg->seq_len = n;
+	return FG_OK;
+}
+
+static int set_key(Config *cfg, const char *section, char *key, char *value)
+{
+	int i;
+	char *field;
+
+	for(i = 0; i < NUM_KEYS; i++) {
+		if(strcmp(keys[i].section, section) != 0 || strcmp(keys[i].key, key) != 0) {
+			continue;
+		}
+
+		field = (char *) cfg + keys[i].offset;
+		switch(keys[i].type) {
+			case CFG_INT:
+				*(int *) field = atoi(value);
+				return FG_OK;
+			case CFG_DOUBLE:
+				*(double *) field = atof(value);
+				return FG_OK;
+			case CFG_SEQ:
+				return parse_seq(cfg, value);
+			case CFG_STR:
+				// the string keys are file names, the MMCSS task and lists of names
+				return (strcpy_s(field, FILENAME_MAX, value) == 0) ? FG_OK : EINVAL;
+		}
+	}
+
+	return ENOENT;
+}
+
+/**
+* reads the parameters in <code>name</code> into <code>cfg</code>.
+*
+* keys that are not in the file keep the value they had, so <code>cfg</code> should be
+* set up with <code>config_defaults</code> first.  Unknown keys and bad values are
+* reported and skipped.
+*
+* @param cfg the Config to update
+* @param name the name of the INI file
+*
+* @return <code>FG_OK</code> on success, <code>ENOENT</code> if the file could not be
+* opened or <code>EINVAL</code> if a line could not be used
+*/
+
+int config_load(Config *cfg, char *name)
+{
+	int rc = FG_OK, line = 0;
+	char buf[CONFIG_LINE], section[CONFIG_LINE];
+	char *s, *eq, *end;
+	FILE *fp = NULL;
+
+	if(fopen_s(&fp, name, "r") != 0) {
+		return ENOENT;
+	}
+
+	section[0] = '\0';
+	while(fgets(buf, sizeof(buf), fp) != NULL) {
+		line++;
+		s = trim(buf);
+		if(*s == '\0' || *s == ';' || *s == '#') {
+			continue;
+		}
+
+		if(*s == '[') {
+			end = strchr(s, ']');
+			if(end == NULL) {
+				printf("config: %s:%d: missing ]\n", name, line);
+				rc = EINVAL;
+				continue;
+			}
+			*end = '\0';
+			strcpy_s(section, sizeof(section), trim(s + 1));
+			continue;
+		}
+
+		eq = strchr(s, '=');
+		if(eq == NULL) {
+			printf("config: %s:%d: expected key = value\n", name, line);
+			rc = EINVAL;
+			continue;
+		}
+		*eq = '\0';
+
+		if(set_key(cfg, section, trim(s), trim(eq + 1)) != FG_OK) {
+			printf("config: %s:%d: bad key or value [%s] %s\n", name, line, section, trim(s));
+			rc = EINVAL;
+		}
+	}
+
+	fclose(fp);
+
+	// the timing sweep never ends if the steps don't grow the width or shrink the frame
+	if(cfg->width_step < 2 || cfg->frame_step <= 1) {
+		printf("config: %s: width_step must be >= 2 and frame_step > 1\n", name);
+		rc = EINVAL;
+	}
+
+	if(cfg->search_roi >= MAX_ROI || (cfg->search_roi >= 0 && cfg->search_every < 2)) {
+		printf("config: %s: the search roi must be < %d and every >= 2\n", name, MAX_ROI);
+		rc = EINVAL;
+	}
+
+	return rc;
+}
+
+static DWORD WINAPI watch_thread(LPVOID param)
+{
+	Config cfg;
+	HANDLE events[2];
+
+	events[0] = stop;
+	events[1] = change;
+
+	while(WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+		// the directory changed, reload only if the file still parses
+		config_defaults(&cfg);
+		cfg.threshold = live_threshold;
+		cfg.exposure = live_exposure;
+		if(config_load(&cfg, watch_name) == FG_OK &&
+			(cfg.threshold != live_threshold || cfg.exposure != live_exposure)) {
+			EnterCriticalSection(&lock);
+			live_threshold = cfg.threshold;
+			live_exposure = cfg.exposure;
+			LeaveCriticalSection(&lock);
+			InterlockedIncrement(&gen);
+		}
+
+		FindNextChangeNotification(change);
+	}
+
+	return 0;
+}
+
+/**
+* reloads the threshold and exposure in <code>name</code> whenever the file is written.
+*
+* the watcher thread only waits on a change notification of the directory holding the
+* file, so it uses no time while the file is left alone.
+*
+* @param cfg the Config the tracking loop started with
+* @param name the name of the INI file
+*
+* @return <code>FG_OK</code> on success, otherwise <code>ENODEV</code>
+*
+* @see config_poll
+*/
+
+int config_watch(Config *cfg, char *name)
+{
+	char dir[FILENAME_MAX];
+	char *slash;
+
+	if(watcher != NULL) {
+		config_unwatch();
+	}
+
+	strcpy_s(watch_name, sizeof(watch_name), name);
+	strcpy_s(dir, sizeof(dir), name);
+	slash = strrchr(dir, '\\');
+	if(slash == NULL) {
+		slash = strrchr(dir, '/');
+	}
+	if(slash != NULL) {
+		*slash = '\0';
+	}
+	else {
+		strcpy_s(dir, sizeof(dir), ".");
+	}
+
+	InitializeCriticalSection(&lock);
+	lock_init = TRUE;
+	live_threshold = cfg->threshold;
+	live_exposure = cfg->exposure;
+	gen = 0;
+	seen = 0;
+
+	change = FindFirstChangeNotificationA(dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE);
+	stop = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if(change == INVALID_HANDLE_VALUE || stop == NULL) {
+		printf("config: could not watch %s\n", dir);
+		config_unwatch();
+		return ENODEV;
+	}
+
+	watcher = CreateThread(NULL, 0, watch_thread, NULL, 0, NULL);
+	if(watcher == NULL) {
+		config_unwatch();
+		return ENODEV;
+	}
+
+	return FG_OK;
+}
+
+/**
+* hands out the threshold and exposure if the file changed since the last call.
+*
+* <code>config_poll</code> is meant to be called once per image from the tracking loop.
+* It only compares a counter unless the watcher thread has read new values.
+*
+* @param threshold updated with the new threshold if the file changed
+* @param exposure updated with the new exposure in microseconds if the file changed
+*
+* @return TRUE if the values were updated, otherwise FALSE
+*/
+
+int config_poll(int *threshold, double *exposure)
+{
+	LONG g = gen;
+
+	if(g == seen) {
+		return FALSE;
+	}
+
+	EnterCriticalSection(&lock);
+	*threshold = live_threshold;
+	*exposure = live_exposure;
+	LeaveCriticalSection(&lock);
+	seen = g;
+
+	return TRUE;
+}
+
+/**
+* stops the thread started by <code>config_watch</code>.
+*/
+
+void config_unwatch()
+{
+	if(watcher != NULL) {
+		SetEvent(stop);
+		WaitForSingleObject(watcher, INFINITE);
+		CloseHandle(watcher);
+		watcher = NULL;
+	}
+	if(change != INVALID_HANDLE_VALUE) {
+		FindCloseChangeNotification(change);
+		change = INVALID_HANDLE_VALUE;
+	}
+	if(stop != NULL) {
+		CloseHandle(stop);
+		stop = NULL;
+	}
+	if(lock_init) {
+		DeleteCriticalSection(&lock);
+		lock_init = FALSE;
+	}
+}
@@ -5,12 +5,25 @@
 
 #include "fcdynamic.h"
 
-#define MAIN_WIN "main"
-#define THRESH_WIN "thresh"
-#define THRESH_TRACK "thresh_track"
-
 #define CHAR_TO_INT(c) ((c) - 0x30)
 
+/**
+* the milliseconds between two samples of the frame grabber's buffers
+*/
+#define MONITOR_PERIOD 10
+
+/**
+* while the backlog of the buffers is high only every DISPLAY_DECIMATE-th image is
+* handed to the GUI, so copying the pixels does not make the loop lose images
+*/
+#define DISPLAY_DECIMATE 8
+
+/**
+* how long the step mode sleeps between two looks at the console with PREVIEW set, in
+* milliseconds
+*/
+#define CONSOLE_WAIT 20
+
 static void help()
 {
 	char hmsg[] = 
@@ -42,6 +55,9 @@ static void help()
 		"*  's': to enter step mode\n"
 		"*  press any key, but 's' to advance to the next frame\n"
 		"\n"
+		"* To write the last images of every ROI to disk, with a flight recorder, press:\n"
+		"*  'f': to dump them\n"
+		"\n"
 		"* To get this help message, press: \n"
 		"*  'h': to print this help message \n"
 		"\n"
@@ -54,6 +70,160 @@ static void help()
 		_getch();
 }
 
+/**
+* the state of the GUI modes, changed by the keys posted from the GUI thread
+*/
+struct display_state {
+	int find_blob;
+	int do_thresh;
+	int calib;
+	int pause_frame;
+	int quit;
+	int t; /**< the threshold */
+	TrackingWindow *sel; /**< the ROI moved by the mouse in relocate mode */
+};
+
+typedef struct display_state DisplayState;
+
+/**
+* starts the automatic thresholds from a threshold the user picked
+*/
+static void reseed_thresholds(TrackingSequence *tseq, int t)
+{
+	int i;
+	TrackingWindow *win;
+
+	for(i = 0; i < tseq->seq_len; i++) {
+		win = tseq->windows + tseq->seq[i];
+		if(win->autot != NULL) {
+			auto_threshold_set(win->autot, t);
+		}
+	}
+}
+
+/**
+* starts the GUI thread, or with PREVIEW the stream to the remote viewer (see
+* preview.cpp)
+*/
+static int display_start(TrackingSequence *tseq)
+{
+#if PREVIEW
+	TrackingWindow *win = tseq->windows + tseq->seq[0];
+
+	return preview_start(win->img_w, win->img_h);
+#else
+	return gui_start(tseq);
+#endif
+}
+
+static void display_publish(TrackingWindow *cur, int xoff, int yoff, int img_nr, int calib)
+{
+#if PREVIEW
+	preview_publish(cur->img, cur->img_step, xoff, yoff, cur->roi_w, cur->roi_h, img_nr, cur,
+		calib);
+#else
+	gui_publish(cur, xoff, yoff, img_nr, calib);
+#endif
+}
+
+/**
+* takes the next command of the GUI thread, or with PREVIEW the next key pressed on the
+* console, since no window takes the keys then
+*/
+static int display_command(GuiCommand *cmd, DWORD timeout)
+{
+#if PREVIEW
+	while(!_kbhit()) {
+		if(timeout == 0) {
+			return FALSE;
+		}
+		Sleep(CONSOLE_WAIT);
+	}
+	cmd->type = GUI_KEY;
+	cmd->value = _getch();
+
+	return TRUE;
+#else
+	return gui_command(cmd, timeout);
+#endif
+}
+
+static void display_stop()
+{
+#if PREVIEW
+	preview_stop();
+#else
+	gui_stop();
+#endif
+}
+
+/**
+* applies one command from the GUI thread
+*
+* @return the key pressed, or -1 if the command was not a key
+*/
+static int handle_command(TrackingSequence *tseq, GuiCommand *cmd, DisplayState *st)
+{
+	int i;
+
+	if(cmd->type == GUI_THRESHOLD) {
+		st->t = cmd->value;
+		reseed_thresholds(tseq, st->t);
+		return -1;
+	}
+
+	if(cmd->type == GUI_MOUSE) {
+		// set_region is only called from the tracking loop, so it can change the window
+		if(st->calib && st->sel != NULL) {
+			set_region(cmd->value, cmd->x, cmd->y, 0, st->sel);
+		}
+		return -1;
+	}
+
+	switch(cmd->value) {
+		case 'q':
+			st->quit = 1;
+			break;
+		case 's':
+			st->pause_frame = !st->pause_frame;
+			break;
+		case 'i':
+			st->calib = !st->calib;
+			if(!st->calib) {
+				st->sel = NULL;
+			}
+			break;
+		case '0':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+			if(st->calib) {
+				st->sel = tseq->windows + CHAR_TO_INT(cmd->value);
+			}
+			break;
+		case 't':
+			st->do_thresh = !st->do_thresh;
+			break;
+		case 'p':
+			st->find_blob = !st->find_blob;
+			break;
+		case 'f':
+			for(i = 0; i < tseq->seq_len; i++) {
+				flight_dump(tseq->windows + tseq->seq[i], "asked");
+			}
+			break;
+		case 'h':
+			help();
+			break;
+	}
+
+	return cmd->value;
+}
+
 /**
 * shows the tracking software in action
 *
@@ -90,12 +260,30 @@ static void help()
 *	's': to enter step mode
 *	press any key, but 's' to advance to the next frame
 *
+* To write the last images of every ROI to disk, with <code>images</code> of [flight] set
+* in the config file, press:
+*	'f': to dump them, see flight.cpp
+*
 * To get help, press:
 *	'h': to print a help message
 *
 * To quite the GUI, press:
 *	'q': to quit
 *
+* The GUI is drawn by its own thread (see gui.cpp) at most <code>GUI_RATE</code> times a
+* second, so the tracking loop does not wait on it.  The keys, mouse events and the
+* trackbar come back to the tracking loop as commands that are handled between images.
+* With <code>PREVIEW</code> set no window is opened: the images are streamed to a remote
+* viewer by preview.cpp and the keys are read from the console instead.
+*
+* With <code>auto_threshold</code> set in the config file every ROI follows the lighting
+* on its own, and a threshold set with the trackbar is where they start from again.
+*
+* The threshold and exposure can also be changed by editing the config file while the
+* GUI is running, if <code>config_watch</code> was called before <code>display_run</code>.
+* With the automatic exposure of exposure.cpp the exposure read is the longest one the
+* ROIs are shortened from.
+*
 * @param tseq the TrackingSequence specifying the active ROIs and their initial positions
 * in the image prior to tracking an object
 * @param frame the frame time (e.g. length of time between images) in microseconds
@@ -105,16 +293,25 @@ static void help()
 
 int display_run(TrackingSequence *tseq, double frame, double exposure)
 {
-	int rc, input = 0;
-	int find_blob, do_thresh, calib, pause_frame;
-	const int value = 0;
-	int img_nr;
+	int i, rc, key;
+	int img_nr, xoff, yoff;
+#if !ONLINE
 	int cur_win;
+	int fused, found = !OBJECT_FOUND;
+#endif
 	TrackingWindow *cur;
-	IplImage *cvDisplay = NULL;
+	DisplayState st;
+	GuiCommand cmd;
 
 #if ONLINE
 	Fg_Struct *fg = NULL;
+	FrameRing ring;
+	FrameView view;
+	FgMonitor mon;
+	FgMonitorSnapshot snap;
+	int pressure = FG_PRESSURE_OK;
+	int n;
+	const int *rois;
 #else
 	IplImage *faux_fg = NULL;
 	unsigned char *data = NULL;
@@ -127,19 +324,15 @@ int display_run(TrackingSequence *tseq, double frame, double exposure)
 
 	//initialize parameters
 	rc = FG_OK;
+#if !ONLINE
 	cur_win = 0;
-	find_blob = 0;
-	do_thresh = 0;
+#endif
 	img_nr = 1;
-	calib = 0;
-	pause_frame = 0;
-	cur = tseq->windows + tseq->seq[cur_win];
-
-	cvDisplay = cvCreateImage(cvSize(cur->img_w, cur->img_h), 8, 1);
-	cvNamedWindow(MAIN_WIN, CV_WINDOW_AUTOSIZE);
-	cvCreateTrackbar(THRESH_TRACK, MAIN_WIN, (int *) &value, WHITE + 1, NULL);
+	memset(&st, 0, sizeof(st));
+	cur = tseq->windows + tseq->seq[0];
 
 #if ONLINE
+	merge_start(tseq);
 	rc = StartGrabbing(&fg, tseq, NULL);
 #else
 	rc = StartGrabbing(NULL, tseq, &data);
@@ -147,126 +340,166 @@ int display_run(TrackingSequence *tseq, double frame, double exposure)
 	if(rc != FG_OK) {
 		return rc;
 	}
+#if ONLINE
+	rc = StartRing(&ring, fg, tseq);
+	if(rc != FG_OK) {
+		deinit_cam(fg);
+		return rc;
+	}
+	if(fg_monitor_start(&mon, fg, PORT_A, default_cam()->head, tseq->buffers, MONITOR_PERIOD,
+		NULL, NULL) != 0) {
+		deinit_cam(fg);
+		return ENOMEM;
+	}
+#endif
+
+	rc = display_start(tseq);
+	if(rc != FG_OK) {
+		printf("display: could not start the gui\n");
+#if ONLINE
+		fg_monitor_stop(&mon);
+		deinit_cam(fg);
+#endif
+		return rc;
+	}
 
 	// start image loop
-	while(1) {
+	while(!st.quit) {
+#if ONLINE
+		// the ROI of the tag of the image, see ring_next
+		ring_next(&ring, &view, TIMEOUT);
+		if(view.data != NULL) {
+			cur = tseq->windows + view.roi;
+		}
+		img_nr = view.img;
+		if(!merge_frame(tseq, cur, &view)) {
+			// the object of a guest is found in the image of its host
+			ring_release(&ring, &view);
+			fg_monitor_consumed(&mon, img_nr);
+			continue;
+		}
+#else
+		// the animation has no lost frames, the sequence keeps count
 		cur = tseq->windows + tseq->seq[cur_win];
 		cur_win++;
 		cur_win %= tseq->seq_len;
-#if ONLINE
-		img_nr = Fg_getLastPicNumberBlocking(fg, img_nr, PORT_A, TIMEOUT);
-		cur->img = (unsigned char *) Fg_getImagePtr(fg, img_nr, PORT_A);
-#else
 		GetNextImage(&faux_fg, img_nr, ANIMATION_NAME, ANIMATION_LENGTH, TRUE);
 		cur->img = data;
+		cur->img_step = cur->roi_w;
 		CopyImageToTrackingWindow(cur, faux_fg);
+		cur->ts = img_nr;
 		img_nr++;
 #endif
 
 		if(cur->img != NULL) {
-			// process image
-			if(do_thresh) {
-				threshold(cur, cvGetTrackbarPos(THRESH_TRACK, MAIN_WIN));
-				erode(cur);
+			// get input
+			while(display_command(&cmd, 0)) {
+				handle_command(tseq, &cmd, &st);
 			}
-			
-			// copy image processing results
-			CopyTrackingWindowToImage(cur, cvDisplay);
 
-			// update roi
-			if(find_blob) {
-				rc = position(cur);
-				if(rc != OBJECT_FOUND) {
-					printf("blob lost in img %d!!!!  reinitialize tracker.\n", img_nr);
+			// pick up a threshold or exposure written to the config file
+			if(config_poll(&st.t, &exposure)) {
+				gui_threshold(st.t);
+				reseed_thresholds(tseq, st.t);
+				for(i = 0; i < tseq->seq_len; i++) {
+					auto_exposure_limit(tseq->windows + tseq->seq[i], exposure);
+#if ONLINE
+					roi_exposure(tseq->seq[i], exposure, frame);
+#endif
 				}
+				RTLOG_INFO("config: threshold %d exposure %.0f\n", st.t, exposure);
 			}
 
-#if ONLINE
-			write_roi(fg, cur->roi, img_nr + tseq->seq_len, !DO_INIT);
-#endif
+			// the pixels as they came, before they are binarized
+			flight_put(cur, img_nr, st.t);
 
-			// get input
-			input = cvWaitKey(1);
-			if(input == 'q') {
-				break;
+			// process image, in one pass over the rows if the window has a StagePlan
+			fused = st.do_thresh && st.find_blob && cur->stages != NULL;
+			if(fused) {
+				found = stage_pass(cur, st.t);
 			}
-
-			switch(input) {
-				case 's':
-					pause_frame = !pause_frame;
-					break;
-				case 'i':
-					calib = !calib;
-					if(!calib) {
-						cvSetMouseCallback(MAIN_WIN, NULL, NULL);
-					}
-					break;
-				case '0':
-				case '1':
-				case '2':
-				case '3':
-				case '4':
-				case '5':
-				case '6':
-				case '7':
-					if(calib) {
-						cvSetMouseCallback(MAIN_WIN, set_region, 
-							tseq->windows + CHAR_TO_INT(input));
-					}
-					break;
-				case 't':
-					do_thresh = !do_thresh;
-					break;
-				case 'p':
-					find_blob = !find_blob;
-					break;
-				case 'h':
-					help();
-					break;
+			else if(st.do_thresh) {
+				threshold(cur, st.t);
+#if PACKED_MORPH
+				packed_erode(cur);
+#else
+				erode(cur);
+#endif
 			}
 
-			// draw image
-			if(calib) {
-				// roi box
-				cvRectangle(cvDisplay, 
-							cvPoint(cur->roi_xoff, 
-									cur->roi_yoff), 
-							cvPoint(cur->roi_xoff + cur->roi_w, 
-									cur->roi_yoff + cur->roi_h), 
-							cvScalar(128));
-			
-				// blob box
-				cvRectangle(cvDisplay, 
-							cvPoint(cur->blob_xmin + cur->roi_xoff, 
-									cur->blob_ymin + cur->roi_yoff), 
-							cvPoint(cur->blob_xmax + cur->roi_xoff, 
-									cur->blob_ymax + cur->roi_yoff), 
-							cvScalar(128));
-			}
+			// the pixels are shown where they were captured, before the roi moves
+			xoff = cur->roi_xoff;
+			yoff = cur->roi_yoff;
 
-			cvShowImage(MAIN_WIN, cvDisplay);
+			// update roi
+			if(st.find_blob) {
+				rc = fused ? update_position(cur, found) : position(cur);
+				flight_result(cur, rc);
+#if RECOVER_LOST
+				if(rc != OBJECT_FOUND && cur->lost_imgs == 1) {
+					RTLOG_WARN("blob lost in img %d, searching...\n", img_nr);
+				}
+#else
+				if(rc != OBJECT_FOUND) {
+					RTLOG_WARN("blob lost in img %d!!!!  reinitialize tracker.\n", img_nr);
+				}
+#endif
+				if(tseq->adapt) {
+					adapt_roi(cur, rc);
+				}
+#if PUBLISH
+				write_comm(cur, rc);
+#endif
+			}
 
-			printf("roi (%d): x %d y %d w %d h %d\n", cur->roi,
-				cur->roi_xoff, cur->roi_yoff, cur->roi_w, cur->roi_h);
+			// hand the results to the gui thread, fewer of them when falling behind
+#if ONLINE
+			fg_monitor_read(&mon, &snap);
+			if(snap.pressure != pressure) {
+				pressure = snap.pressure;
+				RTLOG_WARN("display: %d of %d buffers behind, %d images lost\n", snap.backlog,
+					snap.buffers, snap.lost);
+			}
+			if(pressure == FG_PRESSURE_OK || img_nr % DISPLAY_DECIMATE == 0) {
+				display_publish(cur, xoff, yoff, img_nr, st.calib);
+			}
 
-			printf("blob: x %d y %d w %d h %d\n",
-				cur->blob_xmin, cur->blob_ymin, 
-				cur->blob_xmax - cur->blob_xmin, cur->blob_ymax - cur->blob_ymin);
+			merge_guests(tseq, cur, &view, st.t);
+			n = merge_plan(tseq, cur, &rois);
+			write_rois(fg, rois, n, img_nr + sequence_gap(tseq, img_nr, cur->roi));
+			ring_release(&ring, &view);
+			fg_monitor_consumed(&mon, img_nr);
+#else
+			display_publish(cur, xoff, yoff, img_nr, st.calib);
+#endif
 
-			if(pause_frame) {
-				if(cvWaitKey(0) == 's') {
-					pause_frame = 0;
+			// in step mode wait for a key before the next image
+			while(st.pause_frame && !st.quit) {
+				if(display_command(&cmd, INFINITE)) {
+					key = handle_command(tseq, &cmd, &st);
+					if(key != -1) {
+						break;
+					}
 				}
 			}
 		}
 		else {
-			printf("img is null: %d\n", img_nr);
+			RTLOG_ERROR("img is null: %d\n", img_nr);
 			break;
 		}
 	}
-	cvReleaseImage(&cvDisplay);
+	display_stop();
 
 #if ONLINE
+	fg_monitor_stop(&mon);
+	fg_monitor_read(&mon, &snap);
+	printf("lost %d images, the frame grabber %d; %d placed by their tag off the sequence, %d without a tag\n",
+		ring.lost, snap.lost, ring.retagged, ring.untagged);
+	if(ring.latest) {
+		printf("skipped %d images for newer ones of their ROI\n", ring.skipped);
+	}
+	merge_summary(tseq);
+
 	rc = deinit_cam(fg);
 	if(rc != FG_OK) {
 		printf("deinit: %s\n", Fg_getLastErrorDescription(fg));
@@ -278,8 +511,8 @@ int display_run(TrackingSequence *tseq, double frame, double exposure)
 	}
 #else
 	cvReleaseImage(&faux_fg);
-	free(data);
+	pinned_free(data);
 #endif
 
 	return FG_OK;
-}
\ No newline at end of file
+}
@@ -0,0 +1,172 @@
+/**
+* @file exposure.cpp shortens the exposure of every ROI to what its object needs.
+*
+* the frame time of a TrackCam ROI can not be shorter than its exposure plus the time
+* to clock it out, see frametime.cpp, so the fixed EXPOSURE of a bright object is frame
+* rate thrown away.  An AutoExposure takes the histogram of the blob window in the same
+* pass that binarizes it, every <code>period</code> images, and reads the peak of the
+* object and the mean of the window from it.  The TrackCam is linear, so scaling the
+* exposure scales both of them: <code>auto_exposure_end</code> scales the exposure of the
+* ROI towards the one that puts the peak <code>contrast</code> gray values over the mean.
+*
+* the new exposure goes to <code>cam_roi_exposure_time</code>, which gives the ROI the
+* frame time it can run at with it, and is sent with the next <code>write_roi</code> of
+* the tracking loop like any other change of the ROI.  A window without its object has
+* no peak and is exposed longer, up to the exposure it was set up with, so a lost object
+* is not lost to the dark as well.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the fraction (1 / AE_SMOOTH) of the way to the new exposure an update moves, the new
+* exposure is only seen a sequence of images later
+*/
+#define AE_SMOOTH 2
+
+/**
+* the least change of the exposure, as a fraction of it, worth a parameter set write
+*/
+#define AE_DEADBAND 0.05
+
+/**
+* the gray values the peak of the object is kept over a threshold that does not follow
+* the exposure, one that is not from an AutoThreshold
+*/
+#define AE_HEADROOM 16
+
+/**
+* sets up an automatic exposure.
+*
+* the first histogram is taken from the next image, so the exposure adapts right away.
+*
+* @param ae the AutoExposure to initialize
+* @param exposure the exposure the ROI was set up with, the longest one used
+* @param min the shortest exposure in microseconds
+* @param contrast the peak over mean gray value the exposure is shortened to
+* @param period the number of images between two histograms, at least 1
+*
+* @see AE_PERIOD
+* @see AE_CONTRAST
+* @see AE_MIN_EXPOSURE
+*/
+
+void auto_exposure_init(AutoExposure *ae, double exposure, double min, int contrast,
+	int period)
+{
+	memset(ae, 0, sizeof(AutoExposure));
+	ae->max = exposure;
+	ae->min = (min < exposure) ? min : exposure;
+	ae->contrast = (contrast < 1) ? 1 : ((contrast > WHITE) ? WHITE : contrast);
+	ae->period = (period < 1) ? 1 : period;
+	ae->count = ae->period - 1;
+	ae->peak = -1;
+}
+
+/**
+* sets the exposure of <code>win</code> to <code>exposure</code>, like after the user
+* picked one, and makes it the longest one its AutoExposure uses.
+*/
+
+void auto_exposure_limit(TrackingWindow *win, double exposure)
+{
+	AutoExposure *ae = win->autoe;
+
+	win->exposure = exposure;
+	if(ae != NULL) {
+		ae->max = exposure;
+		if(ae->min > exposure) {
+			ae->min = exposure;
+		}
+	}
+}
+
+/**
+* the histogram to fill with the blob window of the next image of <code>win</code>, if
+* it is due for one
+*/
+
+unsigned int *auto_exposure_begin(TrackingWindow *win)
+{
+	AutoExposure *ae = win->autoe;
+
+	if(ae == NULL) {
+		return NULL;
+	}
+
+	if(++ae->count < ae->period) {
+		return NULL;
+	}
+
+	ae->count = 0;
+	memset(ae->hist, 0, sizeof(ae->hist));
+
+	return ae->hist;
+}
+
+/**
+* scales the exposure of <code>win</code> by the histogram just filled.
+*
+* the peak is the brightest gray value MIN_BLOB_AREA pixels reach, so single hot pixels
+* do not count, and a window whose peak is already <code>contrast</code> over its mean
+* is exposed <code>contrast / (peak - mean)</code> times as long.  The exposure moves
+* 1 / AE_SMOOTH of the way there and is left alone for changes below AE_DEADBAND.
+*
+* @param win the TrackingWindow that was just binarized
+* @param t the threshold it was binarized with
+*/
+
+void auto_exposure_end(TrackingWindow *win, int t)
+{
+	int i;
+	unsigned int n, above;
+	double sum, scale, exposure;
+	AutoExposure *ae = win->autoe;
+
+	n = 0;
+	sum = 0;
+	for(i = 0; i <= WHITE; i++) {
+		n += ae->hist[i];
+		sum += (double) i * ae->hist[i];
+	}
+	if(n == 0) {
+		return;
+	}
+
+	above = 0;
+	for(i = WHITE; i > 0 && above + ae->hist[i] < MIN_BLOB_AREA; i--) {
+		above += ae->hist[i];
+	}
+	ae->peak = i;
+	ae->mean = sum / n;
+
+	if(ae->peak - ae->mean < 1) {
+		scale = WHITE;
+	}
+	else {
+		scale = ae->contrast / (ae->peak - ae->mean);
+	}
+
+	// the object has to stay over a fixed threshold, it gets as dark as the exposure
+	if(win->autot == NULL && ae->peak > 0 && scale * ae->peak < t + AE_HEADROOM) {
+		scale = (double) (t + AE_HEADROOM) / ae->peak;
+	}
+
+	exposure = win->exposure * (1 + (scale - 1) / AE_SMOOTH);
+	if(exposure > ae->max) {
+		exposure = ae->max;
+	}
+	if(exposure < ae->min) {
+		exposure = ae->min;
+	}
+	if(fabs(exposure - win->exposure) < AE_DEADBAND * win->exposure) {
+		return;
+	}
+
+	win->exposure = exposure;
+
+	// no parameter set to change when the images come from disk
+	if(win->max_frame > 0) {
+		cam_roi_exposure_time(win->cam, win->roi, exposure);
+	}
+}
@@ -21,6 +21,14 @@
 #include "fgrab_define.h"
 #include "FastConfig.h"
 
+#include "TracePoint.h"
+#include "RtLog.h"
+#include "PinnedMem.h"
+#include "FgMonitor.h"
+#include "FrameTiming.h"
+#include "RtProfile.h"
+#include "PmcProfile.h"
+
 // constants
 /**
 * determines whether to use code meant for a live camera or images from a file
@@ -30,8 +38,423 @@
 */
 #define ONLINE 1
 
+/**
+* determines whether images replayed from memory arrive at the simulated frame rate
+*
+* REPLAY_PACE makes <code>replay_next</code> wait until the simulated time of each image
+* has passed (REPLAY_PACE != 0), like waiting on the camera would.  Otherwise the images
+* are handed out as fast as they are asked for (REPLAY_PACE == 0), so offline timing
+* runs only measure the tracking code.
+*
+* @see replay.cpp
+*/
+#define REPLAY_PACE 0
+
+/**
+* selects the SSE2 kernel in <code>threshold_blob</code>
+*
+* USE_SSE2 vectorizes the threshold and bounding box pass (USE_SSE2 != 0) or keeps the
+* scalar loop (USE_SSE2 == 0) for processors or compilers without SSE2 support.
+*/
+#define USE_SSE2 1
+
+/**
+* determines whether the tracking loop uses the fused threshold and bounding box pass
+*
+* FUSED_BLOB replaces the separate <code>threshold</code> and <code>blob</code> passes
+* with a single call to <code>threshold_blob</code> (FUSED_BLOB != 0).
+*
+* @see threshold_blob
+* @see update_position
+*/
+#define FUSED_BLOB 1
+
+/**
+* determines whether <code>threshold_blob</code> also measures the object's moments
+*
+* BLOB_MOMENTS accumulates the intensity-weighted moments of the foreground pixels in
+* the fused pass and fills in the sub-pixel centroid, area and orientation of the
+* TrackingWindow (BLOB_MOMENTS != 0).  With BLOB_MOMENTS == 0 only the bounding box is
+* found.
+*
+* @see blob_moments
+*/
+#define BLOB_MOMENTS 1
+
+/**
+* determines whether the fused pass grows the object from its predicted centre
+*
+* GROW_BLOB makes the tracking loops call <code>grow_blob</code>, which flood fills the
+* object from the middle of its blob rectangle and reads only its pixels and their
+* edge, in place of <code>threshold_blob</code>, which reads the whole rectangle
+* (GROW_BLOB != 0).  The ROI is limited to GROW_MAX_W x GROW_MAX_H pixels, the fill to
+* GROW_STACK pending spans, and the seed to a pixel within GROW_SEED_RADIUS of the
+* centre; outside of these, and with an automatic threshold, automatic exposure or
+* background, <code>grow_blob</code> calls <code>threshold_blob</code>.
+*
+* @see grow.cpp
+*/
+#define GROW_BLOB 0
+#define GROW_MAX_W 1024
+#define GROW_MAX_H 1024
+#define GROW_STACK 4096
+#define GROW_SEED_RADIUS 4
+
+/**
+* determines whether the frame grabber finds the object instead of the host
+*
+* APPLET_MOMENTS loads APPLET_NAME, a FastConfig applet that also binarizes the ROI and
+* sums the bounding box and moments of <code>threshold_blob</code> on the board, and
+* only an AppletResult per image is DMA'd to the host (APPLET_MOMENTS != 0).  With
+* APPLET_MOMENTS == 0 FastConfig.dll sends the pixels and the host does the work.
+*
+* @see applet.cpp
+*/
+#define APPLET_MOMENTS 0
+
+#if APPLET_MOMENTS
+#define APPLET_NAME "FastConfigMoments.dll"
+#else
+#define APPLET_NAME "FastConfig.dll"
+#endif
+
+/**
+* the parameter of the moments applet that holds the threshold of a single pixel
+*/
+#define APPLET_THRESHOLD 0x10100
+
+/**
+* the size of the DMA buffer of one AppletResult, padded like the applet pads it
+*/
+#define APPLET_BUF_SIZE 128
+
+/**
+* determines who allocates the DMA buffers of a camera
+*
+* PINNED_DMA makes <code>cam_init</code> allocate the buffers with
+* <code>pinned_alloc</code>, in large pages where the user has the right to them, and
+* hand them to the frame grabber with <code>Fg_AddMem</code> (PINNED_DMA != 0).  The
+* ring then walks them with one TLB entry per 2 MB instead of per 4 kB page.  With
+* PINNED_DMA == 0 the driver allocates them with <code>Fg_AllocMem</code>.  Either way
+* every buffer starts on a PINNED_ALIGN boundary, see FRAME_BUF_SIZE.
+*
+* @see cam.cpp
+* @see PinnedMem.h
+*/
+#define PINNED_DMA 1
+
+/**
+* determines how the timing data of a run is saved
+*
+* BINARY_TRACE writes each run to a memory-mapped binary file with
+* <code>WriteTimingTrace</code> (BINARY_TRACE != 0) instead of printing the table to
+* stdout with <code>PrintTimingData</code> (BINARY_TRACE == 0).
+*/
+#define BINARY_TRACE 1
+
+/**
+* STREAM_STATS makes <code>time_run</code> summarize the images as they come in with a
+* StreamStats of fixed size (STREAM_STATS != 0) instead of keeping a FrameInfo per image
+* for the trace, so a soak test can run for days.  A checkpoint is printed every
+* STREAM_CHECKPOINT images, and a run of 0 images goes on until a key is pressed.
+*
+* @see stream.cpp
+*/
+#define STREAM_STATS 0
+#define STREAM_CHECKPOINT 100000
+
+/**
+* selects how <code>position</code> finds the blob
+*
+* LABEL_BLOBS splits the ROI into connected components with <code>label_blobs</code>
+* and follows the largest one (LABEL_BLOBS != 0) instead of taking the bounding box of
+* every foreground pixel with <code>blob</code> (LABEL_BLOBS == 0).
+*
+* @see label.cpp
+*/
+#define LABEL_BLOBS 1
+
+/**
+* selects the bit-packed morphology of bitimg.cpp
+*
+* PACKED_MORPH packs the binarized ROI 64 pixels to a word and removes the isolated
+* foreground pixels and takes the bounding box on the packed image with
+* <code>packed_erode</code> and <code>packed_blob</code> (PACKED_MORPH != 0), instead of
+* <code>erode</code> and <code>blob</code> (PACKED_MORPH == 0).  <code>position</code>
+* only uses <code>packed_blob</code> when LABEL_BLOBS == 0.
+*
+* @see bitimg.cpp
+*/
+#define PACKED_MORPH 1
+
+/**
+* the most components <code>label_blobs</code> reports for one ROI
+*/
+#define MAX_BLOBS 8
+
+/**
+* components with fewer pixels than MIN_BLOB_AREA are treated as noise
+*/
+#define MIN_BLOB_AREA 4
+
+/**
+* the default number of images between two histograms of an automatic threshold
+*
+* @see auto_threshold
+*/
+#define OTSU_PERIOD 8
+
+/**
+* the default fraction (1 / OTSU_SMOOTH) of the way an automatic threshold moves to
+* each new Otsu threshold
+*/
+#define OTSU_SMOOTH 4
+
+/**
+* the least difference between the mean gray values of the two classes for an Otsu
+* threshold to be used, so a window without the object does not pull the threshold
+* into the background noise
+*/
+#define OTSU_MIN_CONTRAST 24
+
+/**
+* the default number of images between two refreshes of a Background
+*
+* @see background.cpp
+*/
+#define BG_PERIOD 16
+
+/**
+* the defaults of an AutoExposure: the images between two histograms, the peak over
+* mean gray value the exposure is shortened to, and the shortest exposure in microseconds
+*
+* @see exposure.cpp
+*/
+#define AE_PERIOD 16
+#define AE_CONTRAST 96
+#define AE_MIN_EXPOSURE 20
+
+/**
+* the defaults of a ChangeDetect: the rows between two sampled ones, the mean absolute
+* difference per sampled pixel that is still no change, and the images between two
+* passes of a still image
+*
+* @see change.cpp
+*/
+#define CHANGE_ROW_STEP 8
+#define CHANGE_NOISE 2
+#define CHANGE_REFRESH 100
+
+/**
+* the stages a StagePlan can run, as bits of <code>stages</code>, in the order they run
+*
+* @see stages.cpp
+*/
+#define STAGE_BACKGROUND 0x01
+#define STAGE_THRESHOLD 0x02
+#define STAGE_ERODE 0x04
+#define STAGE_BLOB 0x08
+#define STAGE_MOMENTS 0x10
+#define STAGE_BOUNDARY 0x20
+
+/**
+* the pixels two ROIs may be apart and still get one ROI of the frame grabber, and the
+* height of the ROI left in the slot of a guest
+*
+* @see merge.cpp
+*/
+#define MERGE_GAP 8
+#define MERGE_IDLE_H 1
+
+/**
+* the images a FlightRecorder keeps of a ROI by default, 0 for none, the prefix of the
+* files of its dumps, followed by the ROI and the number of the dump, and the length of
+* the reason kept with a dump
+*
+* @see flight.cpp
+*/
+#define FLIGHT_IMAGES 0
+#define FLIGHT_PREFIX "flight"
+#define FLIGHT_WHY 16
+
+/**
+* determines whether the ROI is placed where the object is predicted to be
+*
+* PREDICT_ROI centers the ROI on where a constant velocity model expects the object to
+* be the next time the ROI is active (PREDICT_ROI != 0) instead of on where the object
+* was last seen (PREDICT_ROI == 0).
+*
+* @see update_position
+*/
+#define PREDICT_ROI 1
+
+/**
+* the position and velocity gains of the alpha-beta filter used by PREDICT_ROI
+*
+* the velocity gain follows from the position gain by the Benedict-Bordner relation
+* beta = alpha^2 / (2 - alpha), which is the steady state of a constant velocity Kalman
+* filter.
+*/
+#define PREDICT_ALPHA 0.75
+#define PREDICT_BETA (PREDICT_ALPHA * PREDICT_ALPHA / (2.0 - PREDICT_ALPHA))
+
+/**
+* determines whether the ROIs are resized while tracking
+*
+* ADAPT_ROI grows a ROI while its object is lost or moving fast and shrinks it while the
+* object is tracked steadily, shortening the frame time along with it (ADAPT_ROI != 0).
+* With ADAPT_ROI == 0 the ROIs keep the size they were given for the whole run.
+*
+* @see adapt_roi
+*/
+#define ADAPT_ROI 0
+
+/**
+* determines whether the tracking results are published with <code>write_comm</code>
+*
+* @see comm.cpp
+*/
+#define PUBLISH 0
+
+/**
+* determines whether the live tools stream a preview to a remote viewer instead of
+* showing their images in a window on the acquisition PC
+*
+* @see preview.cpp
+*/
+#define PREVIEW 0
+
+/**
+* the images <code>preview_publish</code> is given per preview it sends
+*/
+#define PREVIEW_EVERY 8
+
+/**
+* the pixels of an image per pixel of a preview, each way
+*/
+#define PREVIEW_DECIMATE 2
+
+/**
+* determines whether the published results carry the world coordinates of the centroid
+*
+* WORLD_COORDS adds the point on the z = 0 plane of a TDah calibration, loaded with
+* <code>world_load</code> from the calibration of [world] in the configuration file, to
+* every CommFrame (WORLD_COORDS != 0).  The point is looked up in a table per ROI that
+* <code>world_attach</code> fills with the world coordinates of the pixels around the
+* ROI, WORLD_MARGIN of them past the largest ROI by default.
+*
+* @see world.cpp
+*/
+#define WORLD_COORDS 0
+#define WORLD_MARGIN 32
+
+/**
+* the smallest ROI <code>adapt_roi</code> shrinks to, a multiple of 4 greater than 8
+*/
+#define ADAPT_MIN_SIZE 16
+
+/**
+* the narrowest ROI <code>set_roi_box</code> sets, a multiple of 4 greater than 8
+*/
+#define ROI_MIN_W 12
+
+/**
+* the largest strip the 1D kernels of line.cpp take
+*
+* a line ROI is 1 to LINE_MAX_H rows of at most LINE_MAX_W pixels, the width of the
+* camera.  Taller ROIs are for the 2D tracker.
+*
+* @see line_centroid
+*/
+#define LINE_MAX_W 1024
+#define LINE_MAX_H 8
+
+/**
+* what <code>line_run</code> looks for in a strip
+*
+* LINE_CENTROID is the centroid of the bright columns, LINE_RISING and LINE_FALLING an
+* edge that goes from dark to bright or from bright to dark from left to right.
+*/
+#define LINE_CENTROID 0
+#define LINE_RISING 1
+#define LINE_FALLING -1
+
+/**
+* the number of pixels a ROI changes by when it is shrunk, a multiple of 4
+*/
+#define ADAPT_STEP 8
+
+/**
+* the free pixels kept between the object (plus its predicted motion) and the ROI border
+*/
+#define ADAPT_MARGIN 8
+
+/**
+* the number of images in a row a ROI has to be larger than needed before it is shrunk
+*/
+#define ADAPT_STABLE 16
+
+/**
+* the ROI of a marker of a RigidBody: the multiple of the error of the model and the
+* free pixels kept around the marker, and the images the error is averaged over
+*
+* @see rigid.cpp
+*/
+#define RIGID_SIGMA 3
+#define RIGID_MARGIN 2
+#define RIGID_SMOOTH 8
+
+/**
+* determines whether a lost object is searched for
+*
+* RECOVER_LOST makes <code>update_position</code> look for an object it lost in
+* stages, each one looking further than the last, until the object is found again
+* (RECOVER_LOST != 0).  With RECOVER_LOST == 0 a lost object stays lost until the
+* tracker is set up again.
+*
+* @see update_position
+*/
+#define RECOVER_LOST 1
+
+/**
+* the stages of the search for a lost object
+*
+* RECOVER_WIDEN looks in the whole ROI instead of the padded blob box, RECOVER_GROW
+* also grows the ROI to <code>roi_max_w</code> x <code>roi_max_h</code>, and
+* RECOVER_SCAN moves the ROI over the whole image one tile at a time.
+*/
+#define RECOVER_NONE 0
+#define RECOVER_WIDEN 1
+#define RECOVER_GROW 2
+#define RECOVER_SCAN 3
+
+/**
+* the number of images an object is searched for by RECOVER_WIDEN and RECOVER_GROW
+* before moving on to the next stage
+*/
+#define RECOVER_WIDEN_IMGS 2
+#define RECOVER_GROW_IMGS 4
+
 #define MIN_SEQ_LEN 2
 
+/**
+* the most entries of a sequence the frame grabber runs, see search_sequence
+*/
+#define MAX_SEQ_LEN 4096
+
+/**
+* the images between two of a search window in the sequence search_sequence builds
+*/
+#define SEARCH_EVERY 32
+
+/**
+* the <code>hint</code> a search window leaves a lost window, [x, y] in the image
+* reference frame, 0 is no hint
+*/
+#define SEARCH_HINT(x, y) ((((y) << 16) | (x)) + 1)
+#define SEARCH_HINT_X(h) (((h) - 1) & 0xffff)
+#define SEARCH_HINT_Y(h) (((h) - 1) >> 16)
+
 #define ANIMATION_LENGTH 32
 #define ANIMATION_NAME "cross/Slide"
 
@@ -48,6 +471,38 @@
 #define DO_INIT 1
 #define MAX_ROI 8 /* limited by FastConfig Applet (see meIII documentation) */
 
+/**
+* the label <code>write_roi</code> gives a parameter set, which the frame grabber returns
+* in the upper 16 bits of FG_IMAGE_TAG of every image taken with it: ROI_TAGGED, the
+* image number of the write and the index of the ROI.  An image of an applet that does
+* not tag has no ROI_TAGGED and is placed by its image number instead.
+*
+* @see ring_next
+*/
+#define ROI_TAGGED 0x8000
+#define ROI_TAG_BITS 3 /* of the index, MAX_ROI is 1 << ROI_TAG_BITS */
+#define ROI_TAG(index, img) (ROI_TAGGED | (((img) << ROI_TAG_BITS) & 0x7fff) | (index))
+#define ROI_TAG_OF(img_tag) ((int) ((((unsigned) (img_tag)) >> 16) & 0xffff))
+#define ROI_OF_TAG(tag) ((tag) & (MAX_ROI - 1))
+
+/**
+* the number of DMA buffers until <code>buffers_observe</code> has seen a run
+*
+* @see buffers.cpp
+*/
+#define NUM_BUFFERS 16
+#define CAMLINK FG_CL_DUALTAP_8_BIT
+
+/**
+* the size of the DMA buffer of one image of a w x h ROI, padded so the next buffer
+* starts on a cache line for the aligned loads of the kernels
+*/
+#if APPLET_MOMENTS
+#define FRAME_BUF_SIZE(w, h) PINNED_STRIDE(APPLET_BUF_SIZE)
+#else
+#define FRAME_BUF_SIZE(w, h) PINNED_STRIDE((w) * (h))
+#endif
+
 /** 
 * the eight indices enumerated as ROI_n
 *
@@ -56,18 +511,387 @@
 */
 enum roi_index {ROI_0 = 0, ROI_1, ROI_2, ROI_3, ROI_4, ROI_5, ROI_6, ROI_7};
 
+/**
+* what <code>background_row</code> does to the rows of an image
+*
+* @see background_begin
+*/
+enum background_mode {BG_NONE = 0, BG_SUBTRACT, BG_REFRESH};
+
 // macros
 /**
 * set or get the pixel at location [<code>i</code>, <code>j</code>] in the 
 * tracking_window <code>win</code> pixel array.
 *
 * @note [<code>i</code>, <code>j</code>] is considered in the ROI reference frame.
+* @note the rows of <code>img</code> are <code>img_step</code> bytes apart, which is
+* <code>roi_w</code> for a DMA buffer but not for an image the window is a part of.
 */
 
-#define PIXEL(win, i, j) ((win)->img[(j) + ((i) * (win)->roi_w)])
+#define PIXEL(win, i, j) ((win)->img[(j) + ((i) * (win)->img_step)])
 
 // variables and types
 
+/**
+* the state of the constant velocity model that predicts where an object is going
+*
+* the model does not need to know the units of the timestamps, only that they increase.
+* The frame grabber timestamps are used when tracking live and the image numbers when
+* reading images from disk.
+*
+* @see update_position
+*/
+
+struct motion_model {
+	int valid; /**< set once the model has a measurement to extrapolate from */
+	__int64 ts; /**< the timestamp of the last measurement */
+	double x; /**< the filtered x coordinate in the image reference frame */
+	double y; /**< the filtered y coordinate in the image reference frame */
+	double vx; /**< the x velocity in pixels per timestamp tick */
+	double vy; /**< the y velocity in pixels per timestamp tick */
+	double dt; /**< the time between the last two measurements */
+};
+
+typedef struct motion_model MotionModel;
+
+/**
+* the windows of the markers of one rigid object and the pose they are predicted from
+*
+* @see rigid.cpp
+*/
+
+struct rigid_body {
+	int count; /**< the number of markers */
+	struct tracking_window *wins[MAX_ROI]; /**< the window of every marker */
+	double bx[MAX_ROI]; /**< the position of every marker on the body */
+	double by[MAX_ROI];
+	double mx[MAX_ROI]; /**< the last position of every marker in the image reference frame */
+	double my[MAX_ROI];
+	__int64 mts[MAX_ROI]; /**< the timestamp of the last position */
+	int seen; /**< the bits of the markers measured so far */
+
+	int valid; /**< set once the body has been learned and has a pose */
+	__int64 ts; /**< the time of the pose */
+	double x; /**< the position of the body in the image reference frame */
+	double y;
+	double theta; /**< the angle of the body in radians */
+	double vx; /**< the velocity in pixels per timestamp tick */
+	double vy;
+	double omega; /**< the angular velocity in radians per timestamp tick */
+	double err; /**< the root mean square distance of the markers to the body in pixels */
+	CRITICAL_SECTION lock;
+};
+
+typedef struct rigid_body RigidBody;
+
+/**
+* the world coordinates of the pixels a ROI can reach
+*
+* @see world.cpp
+*/
+
+struct world_map {
+	int xoff; /**< the table's x coordinate in the image reference frame */
+	int yoff;
+	int w;
+	int h;
+	float *xy; /**< the world x and y of every pixel, row by row */
+};
+
+typedef struct world_map WorldMap;
+
+/**
+* a copy of the values in a parameter set
+*
+* the FastConfig parameter sets can not be compared, so the values they were last set to
+* are kept next to them.  A setter only touches the parameter set if the value really
+* changed, and <code>write_rois</code> only writes the parameter sets that changed since
+* they were last written.
+*
+* @see roi.cpp
+*/
+
+struct roi_state {
+	int set; /**< the ROI_WINDOW, ROI_TIME and ROI_LINLOG values that are valid */
+	int dirty; /**< set if the parameter set changed since it was last written */
+	int x;
+	int width;
+	int y;
+	int height;
+	double exp;
+	double ft; /**< the frame time of the parameter set, after frametime_clamp */
+	double ask; /**< the frame time last asked for, before frametime_clamp */
+	int linlog[4];
+};
+
+typedef struct roi_state RoiState;
+
+/**
+* the most cameras one process can open with <code>cam_init</code>
+*/
+#define MAX_CAMS 4
+
+/**
+* one TrackCam on one port of a frame grabber board
+*
+* everything that used to be kept in static variables by cam.cpp and roi.cpp belongs to
+* a camera, so several cameras can be driven from one process, each one from its own
+* thread.  Two cameras on the two ports of one board share the board's Fg_Struct.
+*
+* @see cam_init
+*/
+
+struct camera {
+	Fg_Struct *fg;
+	int board; /**< the index of the frame grabber board */
+	int port; /**< the port of the board, PORT_A or PORT_B */
+	const unsigned long *mem; /**< the image buffers allocated for the port */
+	dma_mem *head; /**< the buffers handed to the grabber with PINNED_DMA, else NULL */
+	int buffers; /**< the number of buffers in <code>mem</code> */
+	int acquiring; /**< set by <code>cam_acquire</code>, cleared by <code>cam_stop</code> */
+	FC_ParameterSet rois[MAX_ROI];
+	RoiState state[MAX_ROI];
+};
+
+typedef struct camera Camera;
+
+/**
+* a threshold that follows the lighting of one ROI
+*
+* every <code>period</code> images <code>threshold</code> or <code>threshold_blob</code>
+* builds the histogram of the blob window in the same pass that binarizes it and
+* computes its Otsu threshold.  The threshold in use moves 1 / <code>smooth</code> of the
+* way to the Otsu threshold, so one bad histogram can not make the object disappear.
+*
+* @see auto_threshold_init
+*/
+
+struct auto_threshold {
+	int t; /**< the threshold in use */
+	double level; /**< the smoothed Otsu threshold, <code>t</code> is its rounded value */
+	int period; /**< the number of images between two histograms */
+	int smooth; /**< the threshold moves 1 / smooth of the way to the Otsu threshold */
+	int count; /**< the number of images since the last histogram */
+	int otsu; /**< the last Otsu threshold, -1 if the last histogram had no contrast */
+	unsigned int hist[WHITE + 1];
+};
+
+typedef struct auto_threshold AutoThreshold;
+
+/**
+* a reference image of the background, subtracted from the blob window before it is
+* binarized.
+*
+* the reference is kept in the image reference frame, so the ROIs can move over it.  It
+* is static with a <code>period</code> of 0, otherwise every <code>period</code> images
+* of a window the background pixels of its blob window are averaged into it.  A window
+* has its own Background, so the refreshes of the windows of a sequence never write the
+* same reference.
+*
+* @see background.cpp
+*/
+
+struct background {
+	unsigned char *ref; /**< the reference, w x h pixels */
+	int w; /**< the width of the image reference frame */
+	int h; /**< the height of the image reference frame */
+	int period; /**< the number of images between two refreshes, 0 for a static reference */
+	int count; /**< the number of images since the last refresh */
+};
+
+typedef struct background Background;
+
+/**
+* an exposure that follows the brightness of the object in one ROI
+*
+* the TrackCam can not start the next image before the exposure ends, so a ROI that is
+* exposed longer than its object needs caps the frame rate.  Every <code>period</code>
+* images <code>threshold</code> or <code>threshold_blob</code> builds the histogram of
+* the blob window, and the exposure is scaled towards the one that puts the peak of the
+* object <code>contrast</code> gray values over the mean of the window, but never past
+* [<code>min</code>, <code>max</code>].
+*
+* @see exposure.cpp
+*/
+
+struct auto_exposure {
+	double min; /**< the shortest exposure in microseconds */
+	double max; /**< the longest exposure, the one the ROI was set up with */
+	int contrast; /**< the peak over mean gray value the exposure is shortened to */
+	int period; /**< the number of images between two histograms */
+	int count; /**< the number of images since the last histogram */
+	int peak; /**< the peak gray value of the last histogram */
+	double mean; /**< the mean gray value of the last histogram */
+	unsigned int hist[WHITE + 1];
+};
+
+typedef struct auto_exposure AutoExposure;
+
+/**
+* the raw intensity-weighted moments of the foreground pixels in one image
+*
+* every foreground pixel adds its gray value w to the sums, m10 is the sum of w * x and
+* m11 the sum of w * x * y, with x and y in the ROI reference frame.
+*
+* @see threshold_blob
+*/
+
+struct blob_moments {
+	__int64 m00;
+	__int64 m10;
+	__int64 m01;
+	__int64 m20;
+	__int64 m11;
+	__int64 m02;
+};
+
+typedef struct blob_moments BlobMoments;
+
+/**
+* sampled rows of the last image of a window that went through the blob pass, and its
+* result, handed out again while the rows of the next images stay within the noise.
+*
+* @see change.cpp
+*/
+
+struct change_detect {
+	unsigned char *ref; /**< every step-th row of the blob window, before it was binarized */
+	int size; /**< the bytes of ref */
+	int noise; /**< the mean absolute difference per sampled pixel that is still no change */
+	int refresh; /**< the images between two passes of a still image, 0 for never */
+	int count; /**< the images since the last pass */
+	int valid; /**< set once ref holds the rows of a pass */
+
+	int step; /**< the rows from one sampled row to the next */
+	int t; /**< the threshold of the pass */
+	int roi_xoff; /**< the ROI and blob window of the pass */
+	int roi_yoff;
+	int roi_w;
+	int roi_h;
+	int xmin;
+	int ymin;
+	int xmax;
+	int ymax;
+
+	int found; /**< the result of the pass */
+	int box_xmin;
+	int box_ymin;
+	int box_xmax;
+	int box_ymax;
+	BlobMoments moments;
+	int area;
+	double cx;
+	double cy;
+	double theta;
+
+	unsigned int reused; /**< the images handed the result of the last pass */
+	unsigned int passes; /**< the images that went through the pass */
+};
+
+typedef struct change_detect ChangeDetect;
+
+/**
+* the stages of a window's pass, compiled from the config file into one walk over the
+* rows of its blob window.
+*
+* @see stages.cpp
+*/
+
+struct stage_plan {
+	int stages; /**< the STAGE_ bits of the stages to run */
+	int erode_lag; /**< the rows blob and moments run behind threshold */
+	int lag; /**< the rows boundary runs behind threshold */
+	int builtin; /**< set if <code>threshold_blob</code> runs the same stages */
+	unsigned char *gray; /**< two rows before they are binarized, for moments */
+	int gray_w; /**< the pixels of a row of gray */
+};
+
+typedef struct stage_plan StagePlan;
+
+/**
+* the ROIs written to the frame grabber for the windows of a sequence, with the windows
+* that came close sharing the ROI of the first of them.
+*
+* @see merge.cpp
+*/
+
+struct roi_merge {
+	int gap; /**< the pixels two ROIs may be apart and still be merged */
+	int max_pixels; /**< the pixels of a ROI a buffer holds */
+	int host[MAX_ROI]; /**< the ROI whose image a window is run on, its own if not merged */
+	int x[MAX_ROI]; /**< the ROI of the frame grabber, in the image reference frame */
+	int y[MAX_ROI];
+	int w[MAX_ROI];
+	int h[MAX_ROI];
+
+	unsigned int joins; /**< the times a window became the guest of another */
+	unsigned int shared; /**< the passes of guests on the image of their host */
+	unsigned int idle; /**< the images of guests that were skipped */
+};
+
+typedef struct roi_merge RoiMerge;
+
+/**
+* what a FlightRecorder keeps of an image besides its pixels, see flight.cpp
+*/
+
+typedef struct flight_image FlightImage;
+
+/**
+* the last images of a window, in a ring allocated up front, and a second ring the dump
+* thread writes to disk after the object was lost
+*
+* only the loop of the window touches the ring being filled; the dump ring belongs to
+* the dump thread while <code>pending</code> is set.
+*
+* @see flight.cpp
+*/
+
+struct flight_recorder {
+	unsigned char *pixels; /**< n slots of size bytes, the ring being filled */
+	FlightImage *meta; /**< of every slot of pixels */
+	unsigned char *dump_pixels; /**< the ring being written, swapped with pixels */
+	FlightImage *dump_meta;
+	int size; /**< the bytes of a slot, the largest ROI of the window */
+	int n; /**< the slots of a ring */
+	int roi;
+
+	unsigned int count; /**< the images put since the last dump */
+	unsigned int dump_count; /**< the images put into the dump ring */
+	int was_found; /**< the object was found in the last image */
+	char why[FLIGHT_WHY]; /**< what asked for the dump */
+	volatile LONG pending; /**< set while the dump ring is handed to the dump thread */
+
+	unsigned int dumps; /**< the dumps handed to the dump thread */
+	unsigned int missed; /**< the dumps asked for while the last one was being written */
+};
+
+typedef struct flight_recorder FlightRecorder;
+
+/**
+* what the moments applet writes to the DMA buffer of an image instead of its pixels
+*
+* the sums are the ones <code>threshold_blob</code> keeps, over every pixel of the ROI
+* at or above the threshold, and the bounding box is in the ROI reference frame with
+* <code>xmax</code> < 0 when no pixel was.
+*
+* @see APPLET_MOMENTS
+*/
+
+struct applet_result {
+	int img; /**< the image number counted by the applet */
+	int roi; /**< the parameter set the image was taken with */
+	int area;
+	int xmin;
+	int ymin;
+	int xmax;
+	int ymax;
+	int reserved;
+	BlobMoments moments;
+};
+
+typedef struct applet_result AppletResult;
+
 /** 
 * Keeps updated state information on the position of the ROI and the object
 * being tracked.
@@ -99,10 +923,46 @@ struct tracking_window {
 	int blob_ymin; /**< the object's uppermost y coordinate in the ROI reference frame */
 	int blob_xmax; /**< the object's lowermost x coordinate in the ROI reference frame */
 	int blob_ymax; /**< the object's lowermost y coordinate in the ROI reference frame */
+	int seen_x; /**< the center of the object found in img, in the image reference frame */
+	int seen_y; /**< the center of the object found in img, in the image reference frame */
+	int seen_w; /**< the width of the object found in img, before it was padded */
+	int seen_h; /**< the height of the object found in img, before it was padded */
 	
 	int img_w; /**< the image's total width */
 	int img_h; /**< the image's total height */
 	unsigned char *img; /**< point to the grayscale 8-bit image data */
+	int img_step; /**< the bytes from one row of img to the next, see window_frame */
+	__int64 ts; /**< the timestamp of img, used to predict the object's motion */
+	double exp_us; /**< the middle of the exposure of img in host microseconds */
+
+	MotionModel motion; /**< where the object is going, updated by update_position */
+
+	int roi_max_w; /**< the largest ROI width the frame grabber buffers can hold */
+	int roi_max_h; /**< the largest ROI height the frame grabber buffers can hold */
+	double max_frame; /**< the frame time of a roi_max_w x roi_max_h ROI */
+	double exposure; /**< the exposure time of the ROI */
+	int stable; /**< the number of images in a row the ROI was larger than needed */
+	int lost; /**< the search stage while the object is lost, RECOVER_NONE otherwise */
+	int lost_imgs; /**< the number of images in a row the object was not found in */
+	int scan; /**< the next tile searched in the RECOVER_SCAN stage */
+	Camera *cam; /**< the camera of the ROI, NULL for the one opened by init_cam */
+	AutoThreshold *autot; /**< the automatic threshold, NULL to use the threshold passed in */
+	Background *bg; /**< the background subtracted before thresholding, NULL for none */
+	AutoExposure *autoe; /**< the automatic exposure, NULL to keep <code>exposure</code> */
+	ChangeDetect *change; /**< reuses the result of still images, NULL to find every blob */
+	StagePlan *stages; /**< the stages of the pass, NULL for the built-in pass */
+	RigidBody *body; /**< the rigid object the marker of the ROI is on, or NULL */
+	FlightRecorder *flight; /**< keeps the last images to dump on a loss, NULL for none */
+	WorldMap *world; /**< the world coordinates around the ROI, NULL without a calibration */
+	struct tracking_window *tracks; /**< the windows by ROI a search window looks for, or NULL */
+	int track_mask; /**< the bits of the ROIs in <code>tracks</code> a search window looks for */
+	volatile LONG hint; /**< where a search window saw a lost object, see SEARCH_HINT */
+
+	BlobMoments moments; /**< the moments of the object found by threshold_blob */
+	int area; /**< the number of foreground pixels, 0 if the object was not found */
+	double cx; /**< the centroid x coordinate in the image reference frame */
+	double cy; /**< the centroid y coordinate in the image reference frame */
+	double theta; /**< the angle of the major axis to the x axis in radians */
 };
 
 /**
@@ -129,6 +989,11 @@ typedef struct tracking_window TrackingWindow;
 struct tracking_sequence {
 	int *seq;
 	int seq_len;
+	int adapt; /**< resize the ROIs with <code>adapt_roi</code> while tracking */
+	int latest; /**< hand out only the newest image of every ROI, see <code>ring_next</code> */
+	int buffers; /**< the DMA buffers of the run, set by <code>buffers_plan</code> */
+	int buf_size; /**< the bytes of one buffer, enough for the largest ROI */
+	RoiMerge *merge; /**< merges the ROIs that come close, NULL for one ROI per window */
 
 	TrackingWindow windows[MAX_ROI];
 };
@@ -141,6 +1006,107 @@ struct tracking_sequence {
 
 typedef struct tracking_sequence TrackingSequence;
 
+/**
+* the run-time parameters read by <code>config_load</code>
+*
+* all times are in microseconds and the blob is given in the image reference frame.
+*
+* @see config.cpp
+*/
+
+struct config {
+	double exposure;
+	double frame_time;
+	int img_w;
+	int img_h;
+
+	int bounding_box; /**< the initial width and height of the ROIs */
+	int blob_xmin;
+	int blob_ymin;
+	int blob_w;
+	int blob_h;
+	int threshold;
+	int auto_threshold; /**< set to follow the lighting with an AutoThreshold per ROI */
+	int otsu_period;
+	int otsu_smooth;
+
+	int background; /**< set to subtract a Background per ROI before thresholding */
+	int bg_period; /**< the images between two refreshes of the Background, 0 for never */
+	char bg_file[FILENAME_MAX]; /**< the reference image, empty to learn it from black */
+
+	int auto_exposure; /**< set to shorten the exposure with an AutoExposure per ROI */
+	int ae_contrast; /**< the peak over mean gray value of an AutoExposure */
+	double ae_min; /**< the shortest exposure of an AutoExposure */
+	int ae_period; /**< the images between two histograms of an AutoExposure */
+
+	int change_detect; /**< set to skip the blob pass of still images with a ChangeDetect */
+	int change_noise; /**< the mean absolute difference per sampled pixel of no change */
+	int change_refresh; /**< the images between two passes of a still image, 0 for never */
+
+	char stages[FILENAME_MAX]; /**< the stages of the pass of every ROI, empty for the built-in */
+
+	int merge_rois; /**< set to give ROIs that come close one ROI of the frame grabber */
+	int merge_gap; /**< the pixels two ROIs may be apart and still be merged */
+
+	char rigid_link[FILENAME_MAX]; /**< the ROIs of the markers of a rigid object, or empty */
+
+	int flight_images; /**< the images a FlightRecorder per ROI keeps, 0 for none */
+
+	char world_file[FILENAME_MAX]; /**< the TDah binary calibration of the camera, or empty */
+	int world_margin; /**< the pixels the world table of a ROI reaches past the largest ROI */
+
+	int search_roi; /**< the ROI of the search window, -1 for none */
+	int search_every; /**< the images between two of the search window */
+	int search_w; /**< the size of the search window, 0 for the image size */
+	int search_h;
+	double search_exposure; /**< the exposure of the search window, 0 for the same */
+
+	int seq[MAX_ROI]; /**< the order in which the ROIs are activated */
+	int seq_len;
+	int latest_wins; /**< set to skip the older images of a ROI when the loop falls behind */
+
+	int num_imgs; /**< the number of images in each run of the timing sweep */
+	int min_width;
+	int max_width;
+	int width_step; /**< the factor the ROI width grows by between runs */
+	double min_frame;
+	double max_frame;
+	double frame_step; /**< the factor the frame time shrinks by between runs */
+	double exposure_step; /**< the number of exposures tried per frame time */
+	double replay_frame; /**< the simulated frame time when ONLINE == 0 */
+
+	double line_us; /**< the transfer time model of the camera, see FrameTiming.h */
+	double pixel_us;
+	double gap_us;
+	int short_width;
+
+	int rt_profile; /**< 1 to start with the real-time profile of RtProfile.h */
+	int rt_cpu; /**< the core of the acquisition thread, -1 for none, -2 for the last */
+	char rt_task[FILENAME_MAX]; /**< the MMCSS task, empty for none */
+	int rt_timer; /**< the timer resolution in ms, 0 to leave it */
+};
+
+typedef struct config Config;
+
+#define GUI_KEY 0 /**< a key was pressed, value holds the key */
+#define GUI_MOUSE 1 /**< a mouse event in the image, value holds the OpenCV event */
+#define GUI_THRESHOLD 2 /**< the threshold trackbar moved, value holds the threshold */
+
+/**
+* an input event posted by the GUI thread to the tracking loop
+*
+* @see gui.cpp
+*/
+
+struct gui_command {
+	int type;
+	int value;
+	int x; /**< the x coordinate of a mouse event in the image reference frame */
+	int y; /**< the y coordinate of a mouse event in the image reference frame */
+};
+
+typedef struct gui_command GuiCommand;
+
 /**
 * timing information for a particular frame
 *
@@ -200,40 +1166,438 @@ struct timing_info {
 
 typedef struct timing_info TimingInfo;
 
+/**
+* the P-square estimate of one percentile, five markers that move with the values
+*
+* @see stream.cpp
+*/
+
+struct p2_quantile {
+	double p; /**< the percentile as a fraction */
+	int count; /**< the values seen, the first five are the markers sorted */
+	double q[5]; /**< the heights of the markers */
+	double pos[5]; /**< the positions of the markers */
+	double want[5]; /**< the desired positions of the markers */
+};
+
+typedef struct p2_quantile P2Quantile;
+
+/**
+* the running statistics of one timed stage, in microseconds
+*
+* @see stream.cpp
+*/
+
+struct stream_stat {
+	__int64 n;
+	double mean; /**< Welford's running mean */
+	double m2; /**< the running sum of the squared differences to the mean */
+	double min;
+	double max;
+	int min_img; /**< the image the minimum was seen in */
+	int max_img; /**< the image the maximum was seen in */
+	P2Quantile p50;
+	P2Quantile p99;
+	P2Quantile p999;
+};
+
+typedef struct stream_stat StreamStat;
+
+/**
+* the statistics of a timing run that keeps no per-image records
+*
+* @see STREAM_STATS
+*/
+
+struct stream_stats {
+	__int64 imgs; /**< the images summarized */
+	__int64 found; /**< the images the object was found in */
+	LARGE_INTEGER last_ts; /**< when the last image was recorded, 0 before the first */
+	LARGE_INTEGER start;
+	double us; /**< the microseconds of one performance counter tick */
+
+	StreamStat latency; /**< from the image being handed out to its ROI being updated */
+	StreamStat period; /**< between two images being recorded */
+	StreamStat grab;
+	StreamStat thresh;
+	StreamStat track;
+};
+
+typedef struct stream_stats StreamStats;
+
+/**
+* a completed image handed out by a FrameRing
+*
+* frame_view points straight into the frame grabber's DMA memory, so the pixels are only
+* valid until the view is given back with <code>ring_release</code> and the grabber
+* comes around to the buffer again.
+*
+* @see ring.cpp
+*/
+
+struct frame_view {
+	int img; /**< the image number */
+	int roi; /**< the index of the ROI that captured the image */
+	__int64 fg_ts; /**< the frame grabber timestamp of the image (or the error code) */
+	double exp_us; /**< the middle of the exposure in host microseconds, see clock.cpp */
+	unsigned char *data; /**< the image data inside the frame grabber memory */
+};
+
+typedef struct frame_view FrameView;
+
+/**
+* the number of jobs a JobQueue can hold, must be a power of two
+*/
+#define JOB_QUEUE_LEN 16
+#define JOB_QUEUE_MASK (JOB_QUEUE_LEN - 1)
+
+/**
+* one image moving between the threads of <code>pipeline_run</code> and
+* <code>window_run</code>
+*/
+struct pipeline_job {
+	int frame; /**< the index into <code>TimingInfo.frame</code> */
+	int found; /**< the result of <code>update_position</code> */
+	FrameView view;
+};
+
+typedef struct pipeline_job PipelineJob;
+
+/**
+* a single-producer/single-consumer queue of jobs
+*
+* only the producer writes <code>tail</code> and only the consumer writes
+* <code>head</code>, so pushing and popping never need a lock.
+*
+* @see jobs.cpp
+*/
+struct job_queue {
+	volatile LONG head;
+	volatile LONG tail;
+	PipelineJob jobs[JOB_QUEUE_LEN];
+};
+
+typedef struct job_queue JobQueue;
+
+/**
+* a running linear fit from the frame grabber timestamps to the host's performance
+* counter
+*
+* @see clock.cpp
+*/
+
+struct clock_model {
+	int pairs; /**< the number of timestamps fitted */
+	__int64 fg0; /**< the first timestamp, the fit is relative to it */
+	LONGLONG host0; /**< the host counter when the first image was handed out */
+	double us_per_tick; /**< of the host counter */
+	double weight; /**< the sum of the weights of the pairs */
+	double mean_x;
+	double mean_y;
+	double cxx;
+	double cxy;
+	double slope; /**< host microseconds per timestamp tick */
+	double offset; /**< host microseconds at fg0, relative to host0 */
+	double floor; /**< the smallest recent residual, the quickest delivery */
+};
+
+typedef struct clock_model ClockModel;
+
+/**
+* bookkeeping for handing out the frame grabber's DMA buffers without copying
+*
+* @see ring.cpp
+* @see FrameView
+*/
+
+struct frame_ring {
+	Fg_Struct *fg;
+	int port; /**< the port of <code>fg</code> the images come from */
+	unsigned char *mem; /**< the memory returned by <code>get_mem</code> */
+	dma_mem *head; /**< the memory head of <code>mem</code>, NULL for Fg_AllocMem */
+	int buffers; /**< the number of buffers in <code>mem</code> */
+	int buf_size; /**< the size of one buffer in bytes */
+	int *seq; /**< the ROI sequence, used to tag each image with its ROI */
+	int seq_len;
+	TrackingWindow *windows; /**< the windows of the sequence, for the exposure times */
+	ClockModel clock; /**< maps the timestamps of the port to host time */
+
+	int next; /**< the next image number to hand out */
+	int last; /**< the last completed image number seen from the grabber */
+	int held; /**< the number of images handed out but not released */
+	int lost; /**< the number of images overwritten before they were processed */
+	int shift; /**< the sequence positions the camera is ahead of the image numbers */
+	int retagged; /**< images whose tag moved them off the ROI of their image number */
+	int untagged; /**< images placed by their image number, without a tag */
+	int latest; /**< set to skip an image when a newer one of its ROI has completed */
+	int skipped; /**< images skipped for a newer one of their ROI */
+};
+
+typedef struct frame_ring FrameRing;
+
+/**
+* one connected component found by <code>label_blobs</code>
+*
+* all of the coordinates are in the ROI reference frame.
+*
+* @see label.cpp
+*/
+
+struct blob_info {
+	int area; /**< the number of pixels in the component */
+	double cx; /**< the x coordinate of the centroid */
+	double cy; /**< the y coordinate of the centroid */
+	int xmin; /**< the component's uppermost x coordinate */
+	int ymin; /**< the component's uppermost y coordinate */
+	int xmax; /**< the component's lowermost x coordinate */
+	int ymax; /**< the component's lowermost y coordinate */
+};
+
+typedef struct blob_info BlobInfo;
+
+/**
+* the components found in one ROI, sorted by area with the largest first
+*
+* @see label_blobs
+*/
+
+struct blob_list {
+	int count;
+	BlobInfo blobs[MAX_BLOBS];
+};
+
+typedef struct blob_list BlobList;
+
+/**
+* one word of a BitImage row, bit k of word m is pixel m * 64 + k of the row
+*/
+typedef unsigned __int64 bitword;
+
+/**
+* a binarized window with one bit per pixel
+*
+* the BitImage covers the <code>w</code> x <code>h</code> pixels starting at
+* [<code>x</code>, <code>y</code>] in the ROI reference frame, each row starts on a new
+* word and the bits past the end of a row are zero.
+*
+* @see bitimg.cpp
+*/
+
+struct bit_image {
+	int x; /**< the x coordinate of the first pixel in the ROI */
+	int y; /**< the y coordinate of the first pixel in the ROI */
+	int w;
+	int h;
+	int words; /**< the number of words in one row */
+	int max_words; /**< the number of words allocated */
+	bitword *bits;
+};
+
+typedef struct bit_image BitImage;
+
 // functions
 extern int init_cam(Fg_Struct **grabber, int memsize, int buffers, int camlink);
 extern int acquire_imgs(Fg_Struct *fg, int *sequence, int seq_len);
 extern int deinit_cam(Fg_Struct *fg);
+extern int session_open(int buf_size, int buffers, int camlink);
+extern int session_buffers_of(int *buffers, int *buf_size);
+extern int session_close();
 extern const unsigned long *get_mem();
+extern Camera *default_cam();
+extern int cam_init(Camera *cam, int board, int port, int memsize, int buffers, int camlink);
+extern int cam_acquire(Camera *cam, int *seq, int seq_len);
+extern int cam_stop(Camera *cam);
+extern int cam_deinit(Camera *cam);
+extern int cam_status(Fg_Struct *fg, int param, int port);
+
+extern int ring_init(FrameRing *ring, Fg_Struct *fg, TrackingSequence *tseq, int buffers,
+	int buf_size);
+extern int ring_init_cam(FrameRing *ring, Camera *cam, TrackingSequence *tseq, int buffers,
+	int buf_size);
+extern int ring_next(FrameRing *ring, FrameView *view, int timeout);
+extern int ring_release(FrameRing *ring, FrameView *view);
+extern int ring_in_flight(FrameRing *ring);
+
+extern void clock_init(ClockModel *c);
+extern void clock_update(ClockModel *c, __int64 fg_ts, LONGLONG host);
+extern double clock_host_us(ClockModel *c, __int64 fg_ts);
+extern double clock_exposure_us(ClockModel *c, __int64 fg_ts, double exposure);
+
+extern int replay_load(char *name, int len);
+extern int replay_load_raw(char *name, int w, int h);
+extern int replay_size(int *w, int *h);
+extern int replay_start(TrackingSequence *tseq, double frame);
+extern int replay_next(FrameView *view);
+extern void replay_free();
 
 extern int roi_sequence(Fg_Struct *fg, int *seq, int len);
+extern int cam_roi_sequence(Camera *cam, int *seq, int len);
+extern int cam_roi_window(Camera *cam, int index, int x, int width, int y, int height);
+extern int cam_roi_exposure(Camera *cam, int index, double exp, double ft);
+extern int cam_roi_exposure_time(Camera *cam, int index, double exp);
+extern int cam_roi_linlog(Camera *cam, int index, int use_linlog, int ll1, int ll2, int comp);
+extern int cam_write_roi(Camera *cam, int index, int imgNr, int doInit);
+extern int cam_write_rois(Camera *cam, const int *indices, int n, int imgNr);
+extern void cam_roi_invalidate(Camera *cam, int index);
 extern int set_roi(int index, int width, int height, int exposure, int frame);
 extern int roi_window(int index, int x, int width, int y, int height);
 extern int roi_exposure(int index, double exp, double ft);
 extern int roi_linlog(int index, int use_linglog, int ll1, int ll2, int comp);
 extern int write_roi(Fg_Struct *fg, int index, int imgNr, int doInit);
+extern int write_rois(Fg_Struct *fg, const int *indices, int n, int imgNr);
+extern void roi_invalidate(int index);
 
 extern int threshold(TrackingWindow *win, int t);
 extern int boundary(TrackingWindow *win);
 extern int erode(TrackingWindow *win);
+extern void boundary_row(TrackingWindow *win, int i);
+extern void erode_row(TrackingWindow *win, int i);
+extern int threshold_blob(TrackingWindow *win, int t);
+extern int grow_blob(TrackingWindow *win, int t);
+extern int change_init(ChangeDetect *c, int w, int h, int noise, int refresh);
+extern void change_free(ChangeDetect *c);
+extern int change_blob(TrackingWindow *win, int t);
+extern void change_summary(TrackingSequence *tseq);
+extern int stage_init(StagePlan *p, const char *spec, int w);
+extern void stage_free(StagePlan *p);
+extern int stage_pass(TrackingWindow *win, int t);
+extern void merge_start(TrackingSequence *tseq);
+extern int merge_frame(TrackingSequence *tseq, TrackingWindow *win, FrameView *view);
+extern int merge_guests(TrackingSequence *tseq, TrackingWindow *host, FrameView *view, int t);
+extern void merge_rect(TrackingSequence *tseq, int roi, int *x, int *y, int *w, int *h);
+extern int merge_plan(TrackingSequence *tseq, TrackingWindow *cur, const int **rois);
+extern void merge_summary(TrackingSequence *tseq);
+extern int rigid_init(RigidBody *b, TrackingWindow *win, const char *link);
+extern void rigid_free(RigidBody *b);
+extern int rigid_predict(TrackingWindow *win, int x, int y, int *lead_x, int *lead_y);
+extern int rigid_margin(TrackingWindow *win, int *margin);
+extern int flight_init(FlightRecorder *fr, int roi, int w, int h, int n);
+extern void flight_free(FlightRecorder *fr);
+extern void flight_put(TrackingWindow *win, int img, int t);
+extern void flight_result(TrackingWindow *win, int found);
+extern int flight_dump(TrackingWindow *win, const char *why);
+extern void flight_summary(TrackingSequence *tseq);
+extern int world_load(const char *name);
+extern void world_free();
+extern int world_attach(TrackingWindow *win, int margin);
+extern int world_point(TrackingWindow *win, double x, double y, double *wx, double *wy);
+extern void auto_threshold_init(AutoThreshold *at, int t, int period, int smooth);
+extern void auto_threshold_set(AutoThreshold *at, int t);
+extern unsigned int *auto_threshold_begin(TrackingWindow *win, int *t);
+extern void auto_threshold_end(AutoThreshold *at);
+extern void histogram_row(unsigned int *hist, const unsigned char *row, int xmin, int xmax);
+extern int background_init(Background *b, int w, int h, int period);
+extern int background_load(Background *b, const char *name);
+extern void background_free(Background *b);
+extern int background_begin(TrackingWindow *win);
+extern void background_row(TrackingWindow *win, int mode, int i, int xmin, int xmax, int t);
+extern void auto_exposure_init(AutoExposure *ae, double exposure, double min, int contrast,
+	int period);
+extern void auto_exposure_limit(TrackingWindow *win, double exposure);
+extern unsigned int *auto_exposure_begin(TrackingWindow *win);
+extern void auto_exposure_end(TrackingWindow *win, int t);
+extern void blob_shape(TrackingWindow *win, BlobMoments *m, int area);
+
+extern int applet_threshold(Camera *cam, int t);
+extern int applet_result(TrackingWindow *win, const AppletResult *r);
 
 extern int time_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double exposure);
 extern int display_run(TrackingSequence *tseq, double frame, double exposure);
+extern int pipeline_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double exposure);
+extern int window_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double exposure);
+
+extern int job_push(JobQueue *q, PipelineJob *job);
+extern int job_pop(JobQueue *q, PipelineJob *job);
+extern HANDLE start_stage(LPTHREAD_START_ROUTINE stage, void *param, int cpu);
+extern int multi_run(Camera *cams, TrackingSequence *tseqs, int ncams, int num_imgs, int t,
+	double frame, double exposure);
+extern int record_run(TrackingSequence *tseq, int num_imgs, char *name, int display);
+extern int line_run(TrackingSequence *tseq, int num_imgs, int t, int edge, double frame,
+	double exposure);
 
 extern void set_roi_box(TrackingWindow *win, int x, int y);
 extern void fix_blob_bounds(TrackingWindow *win);
 extern void set_region(int e, int x, int y, int flags, void *param);
+extern void window_frame(TrackingWindow *win, FrameView *view);
 extern int position(TrackingWindow *cur);
+extern int update_position(TrackingWindow *cur, int found);
+extern void seen_blob(TrackingWindow *win);
 extern int blob(TrackingWindow *win);
+extern int position_blobs(TrackingWindow *cur, BlobList *list);
+extern int adapt_roi(TrackingWindow *cur, int found);
+
+extern int search_sequence(int *seq, int max, const int *track, int track_len, int search,
+	int every);
+extern int sequence_gap(TrackingSequence *tseq, int img, int roi);
+extern void search_setup(TrackingWindow *win, TrackingWindow *tracks, const int *seq,
+	int seq_len, int w, int h);
+extern int search_position(TrackingWindow *win, int found);
+
+extern int line_centroid(TrackingWindow *win, int t);
+extern int line_edge(TrackingWindow *win, int t, int dir);
+extern int line_follow(TrackingWindow *win, int found);
+
+extern int label_blobs(TrackingWindow *win, BlobList *list);
+extern int select_blob(TrackingWindow *win, BlobList *list, int index);
+extern int bits_alloc(BitImage *b, int w, int h);
+extern void bits_free(BitImage *b);
+extern int bits_pack(TrackingWindow *win, BitImage *b);
+extern void bits_unpack(BitImage *b, TrackingWindow *win, int fg);
+extern int bits_erode(BitImage *src, BitImage *dst);
+extern int bits_dilate(BitImage *src, BitImage *dst);
+extern int bits_boundary(BitImage *src, BitImage *dst);
+extern int bits_denoise(BitImage *src, BitImage *dst);
+extern int bits_open(BitImage *b, BitImage *tmp);
+extern int bits_close(BitImage *b, BitImage *tmp);
+extern int bits_blob(BitImage *b, TrackingWindow *win);
+extern int packed_erode(TrackingWindow *win);
+extern int packed_blob(TrackingWindow *win);
 
 extern int open_comm();
-extern int write_comm(TrackingWindow *win, int box_x, int box_y);
+extern int write_comm(TrackingWindow *win, int found);
 extern int close_comm();
 
+extern void config_defaults(Config *cfg);
+extern int config_load(Config *cfg, char *name);
+extern int config_watch(Config *cfg, char *name);
+extern int config_poll(int *threshold, double *exposure);
+extern void config_unwatch();
+
+extern void buffers_observe(TimingInfo *timer);
+extern int buffer_size(TrackingSequence *tseq);
+extern int buffers_needed(double frame, int size);
+extern int buffers_most(int size);
+extern void buffers_plan(TrackingSequence *tseq);
+
+extern void frametime_config(Config *cfg);
+extern double frametime_clamp(int width, int height, double exposure, double frame);
+extern int frametime_calibrate(int on);
+extern void frametime_observe(TimingInfo *timer);
+
+extern int bench_open(char *name);
+extern int bench_run(Fg_Struct *fg, TimingInfo *timer);
+extern int bench_close();
+
+extern int gui_start(TrackingSequence *tseq);
+extern void gui_publish(TrackingWindow *win, int xoff, int yoff, int img_nr, int calib);
+extern int gui_command(GuiCommand *cmd, DWORD timeout);
+extern void gui_threshold(int t);
+extern void gui_stop();
+
+extern int preview_start(int img_w, int img_h);
+extern void preview_publish(const unsigned char *pixels, int step, int xoff, int yoff, int w, int h,
+	int img_nr, TrackingWindow *win, int calib);
+extern void preview_stop();
+
 extern int StartGrabbing(Fg_Struct **fg, TrackingSequence *tseq, unsigned char **data);
+extern int StartRing(FrameRing *ring, Fg_Struct *fg, TrackingSequence *tseq);
 extern void CopyTrackingWindowToImage(TrackingWindow *win, IplImage *img);
 extern void CopyImageToTrackingWindow(TrackingWindow *win, IplImage *img);
 extern void PrintTimingData(Fg_Struct *fg, TimingInfo *timing_info);
+extern int WriteTimingTrace(Fg_Struct *fg, TimingInfo *timing_info);
+extern void stream_init(StreamStats *s, LARGE_INTEGER freq);
+extern void stream_add(StreamStats *s, FrameInfo *frame);
+extern void stream_print(StreamStats *s, const char *label);
 extern void GetNextImage(IplImage **img, int nr, char *name, int seq_len, int show_name);
 extern int SetTrackCamParameters(TrackingWindow *win, double frame, double exposure);
 
@@ -0,0 +1,410 @@
+/**
+* @file flight.cpp keeps the last images of every ROI and writes them to disk when the
+* object is lost.
+*
+* a full recording with <code>record_run</code> or <code>capture_video</code> costs too
+* much to leave running, so when a window loses its object there are no pixels to tell
+* why.  A FlightRecorder keeps the last <code>n</code> images of a window in a ring it
+* allocated up front: <code>flight_put</code> copies the ROI into the next slot before the
+* blob pass binarizes it, a few KB for a tracking ROI, and <code>flight_result</code> adds
+* what the pass made of it.  The frame grabber buffers go back to the ring right after
+* the pass, so they can not be kept instead of the copy.
+*
+* when the object is lost, or <code>flight_dump</code> is called, the filled ring is
+* swapped with a second one, so the loop goes on into the empty ring without copying,
+* and one dump thread shared by all recorders writes the full one to
+* FLIGHT_PREFIX_roi_number.hsf while the loop runs.  A dump asked for while the last one
+* of the window is still being written is only counted.
+*
+* the file is a flight_file_header followed by one flight_image and its roi_w x roi_h
+* pixels per image, the oldest first.  All fields are little-endian and packed.
+*/
+
+#include "fcdynamic.h"
+
+#define FLIGHT_MAGIC "HSVF"
+#define FLIGHT_VERSION 1
+
+/**
+* the recorders the dump thread looks at, those of two cameras
+*/
+#define FLIGHT_MAX (2 * MAX_ROI)
+
+#pragma pack(push, 1)
+
+/**
+* the header at the start of a dump
+*/
+
+struct flight_file_header {
+	char magic[4]; /**< always <code>FLIGHT_MAGIC</code> */
+	unsigned int version;
+	unsigned int num_imgs; /**< the number of images in the file */
+	int roi;
+	char why[FLIGHT_WHY]; /**< what asked for the dump, like "lost" */
+	__int64 freq; /**< the frequency of the performance counter */
+};
+
+/**
+* what is kept of an image besides its pixels, which follow right after it
+*/
+
+struct flight_image {
+	int img;
+	int roi_x;
+	int roi_y;
+	int roi_w;
+	int roi_h;
+	int t; /**< the threshold of the blob pass */
+	int found; /**< what the pass found, -1 if the dump came before its result */
+	int blob_xmin; /**< the bounding box after the pass, in the ROI reference frame */
+	int blob_ymin;
+	int blob_xmax;
+	int blob_ymax;
+	double cx; /**< the centroid in the image reference frame */
+	double cy;
+	__int64 fg_ts;
+	__int64 pc_ts;
+};
+
+#pragma pack(pop)
+
+typedef struct flight_file_header FlightFileHeader;
+
+static FlightRecorder *recorders[FLIGHT_MAX];
+static int num_recorders = 0;
+static HANDLE dumper = NULL;
+static HANDLE wake = NULL;
+static volatile LONG quit = FALSE;
+static volatile LONG dump_nr = 0;
+
+/**
+* writes the images of the dump ring of a recorder, the oldest first
+*/
+static void write_dump(FlightRecorder *fr)
+{
+	unsigned int i, n, first;
+	char name[FILENAME_MAX];
+	FILE *fp;
+	FlightImage *m;
+	FlightFileHeader hdr;
+	LARGE_INTEGER freq;
+
+	n = (fr->dump_count < (unsigned int) fr->n) ? fr->dump_count : fr->n;
+	first = (fr->dump_count < (unsigned int) fr->n) ? 0 : fr->dump_count % fr->n;
+
+	sprintf_s(name, sizeof(name), "%s_%d_%03d.hsf", FLIGHT_PREFIX, fr->roi,
+		(int) InterlockedIncrement(&dump_nr));
+	if(fopen_s(&fp, name, "wb") != 0) {
+		printf("flight: could not create %s\n", name);
+		return;
+	}
+
+	QueryPerformanceFrequency(&freq);
+	memset(&hdr, 0, sizeof(FlightFileHeader));
+	memcpy(hdr.magic, FLIGHT_MAGIC, sizeof(hdr.magic));
+	hdr.version = FLIGHT_VERSION;
+	hdr.num_imgs = n;
+	hdr.roi = fr->roi;
+	memcpy(hdr.why, fr->why, sizeof(hdr.why));
+	hdr.freq = freq.QuadPart;
+	fwrite(&hdr, sizeof(FlightFileHeader), 1, fp);
+
+	for(i = 0; i < n; i++) {
+		m = fr->dump_meta + (first + i) % fr->n;
+		fwrite(m, sizeof(FlightImage), 1, fp);
+		fwrite(fr->dump_pixels + (size_t) ((first + i) % fr->n) * fr->size, 1,
+			m->roi_w * m->roi_h, fp);
+	}
+
+	if(fclose(fp) != 0) {
+		printf("flight: could not write %s\n", name);
+		return;
+	}
+	printf("flight: roi %d %s, %u images in %s\n", fr->roi, fr->why, n, name);
+}
+
+static DWORD WINAPI dump_thread(LPVOID param)
+{
+	int i;
+
+	while(!quit) {
+		WaitForSingleObject(wake, INFINITE);
+		for(i = 0; i < FLIGHT_MAX; i++) {
+			if(recorders[i] != NULL && recorders[i]->pending) {
+				write_dump(recorders[i]);
+				InterlockedExchange(&recorders[i]->pending, FALSE);
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+* waits until the dump of a recorder is on disk
+*/
+static void wait_dump(FlightRecorder *fr)
+{
+	while(fr->pending) {
+		Sleep(1);
+	}
+}
+
+/**
+* sets up a FlightRecorder for the last <code>n</code> images of a window of up to
+* <code>w</code> x <code>h</code> pixels.
+*
+* the rings are only allocated again if they do not fit, the first recorder starts the
+* dump thread.
+*
+* @param fr the FlightRecorder to set up
+* @param roi the index of the ROI of the window, for the names of the dumps
+* @param w the largest ROI width of the window
+* @param h the largest ROI height of the window
+* @param n the images kept
+*
+* @return <code>FG_OK</code> or <code>ENOMEM</code>
+*/
+
+int flight_init(FlightRecorder *fr, int roi, int w, int h, int n)
+{
+	int i, free_slot;
+
+	wait_dump(fr);
+
+	if(fr->pixels == NULL || fr->size < w * h || fr->n < n) {
+		flight_free(fr);
+		fr->pixels = (unsigned char *) malloc((size_t) w * h * n);
+		fr->dump_pixels = (unsigned char *) malloc((size_t) w * h * n);
+		fr->meta = (FlightImage *) malloc(sizeof(FlightImage) * n);
+		fr->dump_meta = (FlightImage *) malloc(sizeof(FlightImage) * n);
+		if(fr->pixels == NULL || fr->dump_pixels == NULL || fr->meta == NULL ||
+			fr->dump_meta == NULL) {
+			printf("flight: not enough memory for %d %dx%d images\n", 2 * n, w, h);
+			flight_free(fr);
+			return ENOMEM;
+		}
+		fr->size = w * h;
+		fr->n = n;
+	}
+
+	fr->roi = roi;
+	fr->count = 0;
+	fr->was_found = FALSE;
+	fr->dumps = 0;
+	fr->missed = 0;
+
+	// the dump thread looks at every recorder set up and not freed
+	free_slot = -1;
+	for(i = 0; i < FLIGHT_MAX && recorders[i] != fr; i++) {
+		if(recorders[i] == NULL && free_slot < 0) {
+			free_slot = i;
+		}
+	}
+	if(i == FLIGHT_MAX) {
+		if(free_slot < 0) {
+			printf("flight: more than %d recorders\n", FLIGHT_MAX);
+			flight_free(fr);
+			return ENOMEM;
+		}
+		recorders[free_slot] = fr;
+		num_recorders++;
+	}
+
+	if(dumper == NULL) {
+		quit = FALSE;
+		wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+		dumper = CreateThread(NULL, 0, dump_thread, NULL, 0, NULL);
+		if(dumper == NULL) {
+			printf("flight: could not create the dump thread\n");
+			flight_free(fr);
+			return ENOMEM;
+		}
+		SetThreadPriority(dumper, THREAD_PRIORITY_BELOW_NORMAL);
+	}
+
+	return FG_OK;
+}
+
+/**
+* releases the rings of a FlightRecorder once its dump is on disk, the last one stops
+* the dump thread
+*/
+
+void flight_free(FlightRecorder *fr)
+{
+	int i;
+
+	wait_dump(fr);
+
+	for(i = 0; i < FLIGHT_MAX; i++) {
+		if(recorders[i] == fr) {
+			recorders[i] = NULL;
+			num_recorders--;
+		}
+	}
+	if(num_recorders == 0 && dumper != NULL) {
+		InterlockedExchange(&quit, TRUE);
+		SetEvent(wake);
+		WaitForSingleObject(dumper, INFINITE);
+		CloseHandle(dumper);
+		CloseHandle(wake);
+		dumper = NULL;
+		wake = NULL;
+	}
+
+	free(fr->pixels);
+	free(fr->dump_pixels);
+	free(fr->meta);
+	free(fr->dump_meta);
+	memset(fr, 0, sizeof(FlightRecorder));
+}
+
+/**
+* copies the ROI of a window into the next slot of its FlightRecorder, before the blob
+* pass changes the pixels
+*
+* @param win the TrackingWindow with the image, after <code>window_frame</code>
+* @param img the number of the image
+* @param t the threshold of the pass
+*/
+
+void flight_put(TrackingWindow *win, int img, int t)
+{
+	int i, slot;
+	unsigned char *dst;
+	FlightImage *m;
+	FlightRecorder *fr;
+	LARGE_INTEGER pc_ts;
+
+	fr = win->flight;
+	if(fr == NULL || win->img == NULL || win->roi_w * win->roi_h > fr->size) {
+		return;
+	}
+
+	QueryPerformanceCounter(&pc_ts);
+	slot = fr->count % fr->n;
+	m = fr->meta + slot;
+	m->img = img;
+	m->roi_x = win->roi_xoff;
+	m->roi_y = win->roi_yoff;
+	m->roi_w = win->roi_w;
+	m->roi_h = win->roi_h;
+	m->t = t;
+	m->found = -1;
+	m->fg_ts = win->ts;
+	m->pc_ts = pc_ts.QuadPart;
+
+	dst = fr->pixels + (size_t) slot * fr->size;
+	if(win->img_step == win->roi_w) {
+		memcpy(dst, win->img, win->roi_w * win->roi_h);
+	}
+	else {
+		for(i = 0; i < win->roi_h; i++) {
+			memcpy(dst + i * win->roi_w, &PIXEL(win, i, 0), win->roi_w);
+		}
+	}
+	fr->count++;
+}
+
+/**
+* adds the result of the pass to the last image put, and dumps the ring when it is the
+* first image of the object being lost
+*
+* @param win the TrackingWindow after <code>update_position</code>
+* @param found the result of <code>update_position</code>
+*/
+
+void flight_result(TrackingWindow *win, int found)
+{
+	FlightImage *m;
+	FlightRecorder *fr;
+
+	fr = win->flight;
+	if(fr == NULL || fr->count == 0) {
+		return;
+	}
+
+	m = fr->meta + (fr->count - 1) % fr->n;
+	m->found = found;
+	m->blob_xmin = win->blob_xmin;
+	m->blob_ymin = win->blob_ymin;
+	m->blob_xmax = win->blob_xmax;
+	m->blob_ymax = win->blob_ymax;
+	m->cx = win->cx;
+	m->cy = win->cy;
+
+	if(found != OBJECT_FOUND && fr->was_found) {
+		flight_dump(win, "lost");
+	}
+	fr->was_found = (found == OBJECT_FOUND);
+}
+
+/**
+* hands the images kept of a window to the dump thread and starts a new ring
+*
+* @param win the TrackingWindow to dump
+* @param why what asked for the dump, put into the file
+*
+* @return <code>FG_OK</code>, <code>EINVAL</code> without a FlightRecorder or images, or
+* <code>EBUSY</code> while the last dump of the window is still being written
+*/
+
+int flight_dump(TrackingWindow *win, const char *why)
+{
+	unsigned char *pixels;
+	FlightImage *meta;
+	FlightRecorder *fr;
+
+	fr = win->flight;
+	if(fr == NULL || fr->count == 0) {
+		return EINVAL;
+	}
+	if(fr->pending) {
+		fr->missed++;
+		return EBUSY;
+	}
+
+	pixels = fr->dump_pixels;
+	meta = fr->dump_meta;
+	fr->dump_pixels = fr->pixels;
+	fr->dump_meta = fr->meta;
+	fr->pixels = pixels;
+	fr->meta = meta;
+	fr->dump_count = fr->count;
+	fr->count = 0;
+	strncpy_s(fr->why, sizeof(fr->why), why, _TRUNCATE);
+	fr->dumps++;
+
+	InterlockedExchange(&fr->pending, TRUE);
+	SetEvent(wake);
+
+	return FG_OK;
+}
+
+/**
+* prints how many dumps the recorders of a sequence wrote and missed
+*
+* @param tseq the TrackingSequence of the run
+*/
+
+void flight_summary(TrackingSequence *tseq)
+{
+	int i, k;
+	FlightRecorder *fr;
+
+	for(i = 0; i < tseq->seq_len; i++) {
+		fr = tseq->windows[tseq->seq[i]].flight;
+		if(fr == NULL || (fr->dumps == 0 && fr->missed == 0)) {
+			continue;
+		}
+		// a ROI that appears in the sequence more than once is printed once
+		for(k = 0; k < i && tseq->seq[k] != tseq->seq[i]; k++);
+		if(k < i) {
+			continue;
+		}
+		printf("roi %d: %u flight dumps, %u missed while writing\n", tseq->seq[i], fr->dumps,
+			fr->missed);
+	}
+}
@@ -0,0 +1,142 @@
+/**
+* @file frametime.cpp keeps the ROIs at frame times the TrackCam can run.
+*
+* the camera has to clock an image out before it can take the next one, so a frame
+* time shorter than the exposure plus the transfer time of the ROI is not kept, and
+* the timing sweep used to find that out by trying.  <code>cam_roi_exposure</code>
+* now raises every frame time to the shortest one the model of FrameTiming.h allows
+* for the ROI, see <code>frametime_clamp</code>.
+*
+* the model starts from the [timing] section of the config file.  While the timing
+* sweep runs with <code>frametime_calibrate(TRUE)</code> the frame times are not
+* raised, every run the camera could not keep up with is added to the calibration by
+* <code>frametime_observe</code>, and <code>frametime_calibrate(FALSE)</code> fits the
+* model and prints a [timing] section for the config file.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the fraction the images of a run have to come slower than its frame time for the
+* run to be limited by the camera
+*/
+#define FRAMETIME_SLOW 0.01
+
+static FrameTiming timing;
+static int timing_set = FALSE;
+static int calibrating = FALSE;
+
+/**
+* the model, the oscilloscope values for CAMLINK until <code>frametime_config</code>
+*/
+static FrameTiming *model()
+{
+	if(!timing_set) {
+		frame_timing_init(&timing, CAMLINK);
+		timing_set = TRUE;
+	}
+
+	return &timing;
+}
+
+/**
+* sets the model to the [timing] section of a Config
+*/
+
+void frametime_config(Config *cfg)
+{
+	FrameTiming *t = model();
+
+	t->line_us = cfg->line_us;
+	t->pixel_us = cfg->pixel_us;
+	t->gap_us = cfg->gap_us;
+	t->short_width = cfg->short_width;
+}
+
+/**
+* the frame time a ROI runs at when it is asked for <code>frame</code>.
+*
+* @param width the width of the ROI
+* @param height the height of the ROI
+* @param exposure the exposure time in microseconds
+* @param frame the frame time asked for in microseconds
+*
+* @return <code>frame</code>, or the shortest frame time of the ROI if
+* <code>frame</code> is shorter and the model is not being calibrated
+*/
+
+double frametime_clamp(int width, int height, double exposure, double frame)
+{
+	if(calibrating || frame <= 0 || exposure < 0) {
+		return frame;
+	}
+
+	return frame_timing_clamp(model(), width, height, exposure, frame);
+}
+
+/**
+* starts or finishes calibrating the model.
+*
+* @param on TRUE to empty the calibration and stop raising the frame times, FALSE to
+* fit the model to the observed runs and raise the frame times again
+*
+* @return <code>FG_OK</code>, or <code>EINVAL</code> if the runs were too few to fit
+* the model, it is then left as it was
+*/
+
+int frametime_calibrate(int on)
+{
+	FrameTiming *t = model();
+
+	if(on) {
+		memset(t->ata, 0, sizeof(t->ata));
+		memset(t->atb, 0, sizeof(t->atb));
+		t->runs = 0;
+		calibrating = TRUE;
+		return FG_OK;
+	}
+
+	calibrating = FALSE;
+	if(frame_timing_fit(t) != 0) {
+		printf("frametime: %d runs the camera could not keep up with, too few to fit\n",
+			t->runs);
+		return EINVAL;
+	}
+
+	printf("frametime: fitted to %d runs, for the config file:\n", t->runs);
+	printf("[timing]\nline_us = %.4f\npixel_us = %.6f\ngap_us = %.4f\nshort_width = %d\n",
+		t->line_us, t->pixel_us, t->gap_us, t->short_width);
+
+	return FG_OK;
+}
+
+/**
+* adds a timing run to the calibration if the camera could not keep up with it.
+*
+* the period is taken from the frame grabber timestamps, so a slow tracking loop does
+* not look like a slow camera as long as no images were lost.
+*
+* @param timer the timing data of the run
+*/
+
+void frametime_observe(TimingInfo *timer)
+{
+	int n;
+	double period;
+	FrameInfo *frame = timer->frame;
+
+	if(!calibrating || timer->roi_f <= 0) {
+		return;
+	}
+
+	for(n = 0; n < timer->num_imgs && frame[n].pc_ts.QuadPart != 0; n++);
+	if(n < 2 || frame[n - 1].img <= frame[0].img) {
+		return;
+	}
+
+	period = (double) (frame[n - 1].fg_ts - frame[0].fg_ts) /
+		(frame[n - 1].img - frame[0].img);
+	if(period > timer->roi_f * (1 + FRAMETIME_SLOW)) {
+		frame_timing_observe(model(), timer->roi_w, timer->roi_h, timer->roi_e, period);
+	}
+}
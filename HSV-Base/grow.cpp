@@ -0,0 +1,237 @@
+/**
+* @file grow.cpp a seeded region growing that only visits the pixels of the object.
+*
+* <code>threshold_blob</code> reads every pixel of the blob rectangle every image, so
+* its cost is the area of the rectangle however small the object is in it.
+* <code>grow_blob</code> starts from the predicted centre of the object instead, the
+* middle of the blob rectangle <code>update_position</code> placed around it, and grows
+* the 8-connected foreground region from there with a scanline flood fill: a span of
+* foreground pixels is taken in one row, and only the pixels one to either side of it in
+* the rows above and below are looked at for the spans that continue it.  The threshold
+* is applied on the fly and the pixels are left as they are; a bit per pixel in a thread
+* local bitmap remembers what was visited, and only the words of the bounding box of
+* the object are cleared again afterwards.  The cost is the object and its edge, so the
+* ROI can be given a generous margin for free.
+*
+* the region may grow past the blob rectangle up to the edges of the ROI, and only the
+* component of the seed is measured, so a noise pixel elsewhere in the ROI does not
+* stretch the bounding box.  The result is the bounding box and the gray value weighted
+* moments <code>threshold_blob</code> gives for that component.
+*
+* <code>grow_blob</code> falls back to <code>threshold_blob</code> when there is no
+* foreground pixel within GROW_SEED_RADIUS of the seed (the object moved off its
+* prediction or is lost, and the search of <code>update_position</code> needs the whole
+* rectangle), when the span stack overflows, and when the ROI has an automatic
+* threshold, automatic exposure or background, which take their histograms or
+* differences from every pixel of the rectangle.
+*
+* @note the bitmap and the stack are thread local, so every worker of
+* <code>window_run</code> has its own.
+*/
+
+#include "fcdynamic.h"
+
+#define GROW_WORDS (GROW_MAX_W / 64)
+
+/**
+* a pixel a span of the region continues from, in the ROI reference frame
+*/
+struct grow_seed {
+	int x;
+	int y;
+};
+
+typedef struct grow_seed GrowSeed;
+
+static __declspec(thread) unsigned __int64 visited[GROW_MAX_H][GROW_WORDS];
+static __declspec(thread) GrowSeed stack[GROW_STACK];
+
+#define VISITED(y, x) (visited[y][(x) >> 6] & ((unsigned __int64) 1 << ((x) & 63)))
+#define VISIT(y, x) (visited[y][(x) >> 6] |= ((unsigned __int64) 1 << ((x) & 63)))
+
+/**
+* the foreground pixel nearest the middle of the blob rectangle, looked for in square
+* rings up to GROW_SEED_RADIUS pixels out
+*
+* @return TRUE with the pixel in <code>sx</code>, <code>sy</code>, FALSE if there is none
+*/
+static int find_seed(TrackingWindow *win, int t, int *sx, int *sy)
+{
+	int r, dx, dy, x, y, cx, cy;
+
+	cx = (win->blob_xmin + win->blob_xmax) / 2;
+	cy = (win->blob_ymin + win->blob_ymax) / 2;
+
+	for(r = 0; r <= GROW_SEED_RADIUS; r++) {
+		for(dy = -r; dy <= r; dy++) {
+			for(dx = -r; dx <= r; dx++) {
+				if(dx != -r && dx != r && dy != -r && dy != r) {
+					continue;
+				}
+				x = cx + dx;
+				y = cy + dy;
+				if(x >= 0 && x < win->roi_w && y >= 0 && y < win->roi_h &&
+					PIXEL(win, y, x) >= t) {
+					*sx = x;
+					*sy = y;
+					return TRUE;
+				}
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+* clears the words of the bitmap under a bounding box
+*/
+static void clear_visited(int xmin, int ymin, int xmax, int ymax)
+{
+	int y;
+
+	for(y = ymin; y <= ymax; y++) {
+		memset(&visited[y][xmin >> 6], 0,
+			((xmax >> 6) - (xmin >> 6) + 1) * sizeof(unsigned __int64));
+	}
+}
+
+/**
+* finds the object's bounding box, and its moments, by growing it from its predicted
+* centre
+*
+* @param win the TrackingWindow to update with the object's bounding box
+* @param t the threshold value
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @note unlike <code>threshold_blob</code> the pixels are not binarized, unless it falls
+* back to <code>threshold_blob</code>.
+*
+* @see GROW_BLOB
+* @see threshold_blob
+*/
+
+int grow_blob(TrackingWindow *win, int t)
+{
+	int i, j, k, n, x, y, lx, rx, w, h, end, in_run, overflow;
+	int box_xmin, box_ymin, box_xmax, box_ymax;
+	unsigned char *row;
+#if BLOB_MOMENTS
+	int area;
+	__int64 s0, s1, s2;
+	BlobMoments m;
+#endif
+
+	w = win->roi_w;
+	h = win->roi_h;
+	if(win->autot != NULL || win->autoe != NULL || win->bg != NULL || w > GROW_MAX_W ||
+		h > GROW_MAX_H || !find_seed(win, t, &x, &y)) {
+		return threshold_blob(win, t);
+	}
+
+	box_xmin = box_xmax = x;
+	box_ymin = box_ymax = y;
+#if BLOB_MOMENTS
+	area = 0;
+	memset(&m, 0, sizeof(m));
+#endif
+	overflow = FALSE;
+
+	stack[0].x = x;
+	stack[0].y = y;
+	n = 1;
+	while(n > 0 && !overflow) {
+		n--;
+		x = stack[n].x;
+		y = stack[n].y;
+		if(VISITED(y, x)) {
+			continue;
+		}
+
+		// the span of the seed in its row
+		row = &PIXEL(win, y, 0);
+		for(lx = x; lx > 0 && row[lx - 1] >= t && !VISITED(y, lx - 1); lx--);
+		for(rx = x; rx < w - 1 && row[rx + 1] >= t && !VISITED(y, rx + 1); rx++);
+
+#if BLOB_MOMENTS
+		s0 = 0;
+		s1 = 0;
+		s2 = 0;
+#endif
+		for(j = lx; j <= rx; j++) {
+			VISIT(y, j);
+#if BLOB_MOMENTS
+			s0 += row[j];
+			s1 += (__int64) row[j] * j;
+			s2 += (__int64) row[j] * j * j;
+#endif
+		}
+#if BLOB_MOMENTS
+		area += rx - lx + 1;
+		m.m00 += s0;
+		m.m10 += s1;
+		m.m20 += s2;
+		m.m01 += y * s0;
+		m.m11 += y * s1;
+		m.m02 += (__int64) y * y * s0;
+#endif
+		if(box_xmin > lx) {
+			box_xmin = lx;
+		}
+		if(box_xmax < rx) {
+			box_xmax = rx;
+		}
+		if(box_ymin > y) {
+			box_ymin = y;
+		}
+		if(box_ymax < y) {
+			box_ymax = y;
+		}
+
+		// the spans that touch it in the rows above and below, diagonals included
+		end = (rx < w - 1) ? rx + 1 : rx;
+		for(k = -1; k <= 1; k += 2) {
+			i = y + k;
+			if(i < 0 || i >= h) {
+				continue;
+			}
+			row = &PIXEL(win, i, 0);
+			in_run = FALSE;
+			for(j = (lx > 0) ? lx - 1 : lx; j <= end; j++) {
+				if(row[j] < t || VISITED(i, j)) {
+					in_run = FALSE;
+					continue;
+				}
+				if(in_run) {
+					continue;
+				}
+				if(n == GROW_STACK) {
+					overflow = TRUE;
+					break;
+				}
+				stack[n].x = j;
+				stack[n].y = i;
+				n++;
+				in_run = TRUE;
+			}
+		}
+	}
+
+	// every visited pixel is inside the box
+	clear_visited(box_xmin, box_ymin, box_xmax, box_ymax);
+	if(overflow) {
+		return threshold_blob(win, t);
+	}
+
+	win->blob_xmin = box_xmin;
+	win->blob_ymin = box_ymin;
+	win->blob_xmax = box_xmax;
+	win->blob_ymax = box_ymax;
+#if BLOB_MOMENTS
+	blob_shape(win, &m, area);
+#endif
+
+	return OBJECT_FOUND;
+}
@@ -0,0 +1,359 @@
+/**
+* @file gui.cpp draws the display_run GUI from its own thread.
+*
+* showing an image, drawing the boxes, printing the ROI and waiting for a key used to
+* happen on the acquisition thread after every image, so turning the GUI on halved the
+* tracking rate.  The tracking loop now only copies the ROI it just processed into a
+* triple buffer with <code>gui_publish</code>, which never waits.  The GUI thread takes
+* the newest snapshot out of the triple buffer at <code>GUI_RATE</code> and draws it,
+* so snapshots published between two redraws are simply replaced.
+*
+* OpenCV has to create and pump its windows from one thread, so the window, the
+* trackbar and the mouse callback all belong to the GUI thread.  Keys, mouse events and
+* trackbar changes are posted back to the tracking loop through a command queue, which
+* it drains between images with <code>gui_command</code>.
+*/
+
+#include "fcdynamic.h"
+
+#define MAIN_WIN "main"
+#define THRESH_TRACK "thresh_track"
+
+/**
+* the most times per second the GUI is redrawn
+*/
+#define GUI_RATE 30
+#define GUI_PERIOD (1000 / GUI_RATE)
+
+/**
+* the number of commands the queue holds, must be a power of two
+*/
+#define GUI_QUEUE_LEN 64
+#define GUI_QUEUE_MASK (GUI_QUEUE_LEN - 1)
+
+/**
+* marks the middle slot of the triple buffer as holding a snapshot the GUI has not
+* drawn yet
+*/
+#define GUI_FRESH 4
+
+#define NO_THRESHOLD -1
+
+/**
+* one snapshot of a TrackingWindow and the pixels it was tracked in
+*
+* the ROI of <code>win</code> has already been moved for the next image, so the pixels
+* are drawn where they were captured, at [<code>xoff</code>, <code>yoff</code>].
+*/
+
+struct gui_slot {
+	TrackingWindow win;
+	int img_nr;
+	int calib; /**< draw the ROI and blob boxes */
+	int xoff;
+	int yoff;
+	int w;
+	int h;
+	unsigned char *pixels;
+};
+
+typedef struct gui_slot GuiSlot;
+
+struct gui_queue {
+	volatile LONG head;
+	volatile LONG tail;
+	GuiCommand cmds[GUI_QUEUE_LEN];
+};
+
+typedef struct gui_queue GuiQueue;
+
+static GuiSlot slots[3];
+static volatile LONG middle = 0;
+static LONG back = 1;
+static LONG front = 2;
+
+static GuiQueue queue;
+static HANDLE posted = NULL;
+static HANDLE ready = NULL;
+static HANDLE thread = NULL;
+static volatile LONG running = FALSE;
+static volatile LONG new_threshold = NO_THRESHOLD;
+
+static int img_w = 0;
+static int img_h = 0;
+
+static void post(GuiCommand *cmd)
+{
+	LONG tail = queue.tail;
+
+	// the GUI thread is the only producer, a full queue drops the newest command
+	if(tail - queue.head == GUI_QUEUE_LEN) {
+		return;
+	}
+
+	queue.cmds[tail & GUI_QUEUE_MASK] = *cmd;
+	MemoryBarrier();
+	queue.tail = tail + 1;
+	SetEvent(posted);
+}
+
+static void on_mouse(int e, int x, int y, int flags, void *param)
+{
+	GuiCommand cmd;
+
+	cmd.type = GUI_MOUSE;
+	cmd.value = e;
+	cmd.x = x;
+	cmd.y = y;
+	post(&cmd);
+}
+
+static void draw(GuiSlot *s, IplImage *canvas)
+{
+	int i;
+	TrackingWindow *cur = &s->win;
+
+	for(i = 0; i < s->h; i++) {
+		memcpy(canvas->imageData + (s->yoff + i) * canvas->widthStep + s->xoff,
+			s->pixels + i * s->w, s->w);
+	}
+
+	if(s->calib) {
+		// roi box
+		cvRectangle(canvas,
+					cvPoint(cur->roi_xoff,
+							cur->roi_yoff),
+					cvPoint(cur->roi_xoff + cur->roi_w,
+							cur->roi_yoff + cur->roi_h),
+					cvScalar(128));
+
+		// blob box
+		cvRectangle(canvas,
+					cvPoint(cur->blob_xmin + cur->roi_xoff,
+							cur->blob_ymin + cur->roi_yoff),
+					cvPoint(cur->blob_xmax + cur->roi_xoff,
+							cur->blob_ymax + cur->roi_yoff),
+					cvScalar(128));
+	}
+
+	cvShowImage(MAIN_WIN, canvas);
+
+	printf("roi (%d): x %d y %d w %d h %d\n", cur->roi,
+		cur->roi_xoff, cur->roi_yoff, cur->roi_w, cur->roi_h);
+
+	printf("blob: x %d y %d w %d h %d\n",
+		cur->blob_xmin, cur->blob_ymin,
+		cur->blob_xmax - cur->blob_xmin, cur->blob_ymax - cur->blob_ymin);
+}
+
+static DWORD WINAPI gui_thread(LPVOID param)
+{
+	int key, pos, t = 0;
+	const int value = 0;
+	LONG m;
+	GuiCommand cmd;
+	IplImage *canvas;
+
+	canvas = cvCreateImage(cvSize(img_w, img_h), 8, 1);
+	cvZero(canvas);
+	cvNamedWindow(MAIN_WIN, CV_WINDOW_AUTOSIZE);
+	cvCreateTrackbar(THRESH_TRACK, MAIN_WIN, (int *) &value, WHITE + 1, NULL);
+	cvSetMouseCallback(MAIN_WIN, on_mouse, NULL);
+	SetEvent(ready);
+
+	while(running) {
+		// cvWaitKey also runs the window's message loop, which calls on_mouse
+		key = cvWaitKey(GUI_PERIOD);
+		if(key != -1) {
+			cmd.type = GUI_KEY;
+			cmd.value = key;
+			post(&cmd);
+		}
+
+		m = InterlockedExchange(&new_threshold, NO_THRESHOLD);
+		if(m != NO_THRESHOLD) {
+			cvSetTrackbarPos(THRESH_TRACK, MAIN_WIN, m);
+			t = m;
+		}
+
+		pos = cvGetTrackbarPos(THRESH_TRACK, MAIN_WIN);
+		if(pos != t) {
+			t = pos;
+			cmd.type = GUI_THRESHOLD;
+			cmd.value = t;
+			post(&cmd);
+		}
+
+		if(middle & GUI_FRESH) {
+			front = InterlockedExchange(&middle, front) & ~GUI_FRESH;
+			draw(slots + front, canvas);
+		}
+	}
+
+	cvDestroyWindow(MAIN_WIN);
+	cvReleaseImage(&canvas);
+
+	return 0;
+}
+
+/**
+* opens the GUI window and starts the thread that draws it.
+*
+* @param tseq the TrackingSequence that will be shown, used for the size of the image
+*
+* @return <code>FG_OK</code> on success, otherwise <code>ENOMEM</code>
+*
+* @see gui_stop
+*/
+
+int gui_start(TrackingSequence *tseq)
+{
+	int i;
+	TrackingWindow *win = tseq->windows + tseq->seq[0];
+
+	img_w = win->img_w;
+	img_h = win->img_h;
+
+	memset(slots, 0, sizeof(slots));
+	for(i = 0; i < 3; i++) {
+		slots[i].pixels = (unsigned char *) malloc(img_w * img_h);
+		if(slots[i].pixels == NULL) {
+			gui_stop();
+			return ENOMEM;
+		}
+	}
+	middle = 0;
+	back = 1;
+	front = 2;
+
+	memset(&queue, 0, sizeof(queue));
+	new_threshold = NO_THRESHOLD;
+	running = TRUE;
+
+	posted = CreateEvent(NULL, FALSE, FALSE, NULL);
+	ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if(posted == NULL || ready == NULL) {
+		gui_stop();
+		return ENOMEM;
+	}
+
+	thread = CreateThread(NULL, 0, gui_thread, NULL, 0, NULL);
+	if(thread == NULL) {
+		gui_stop();
+		return ENOMEM;
+	}
+	WaitForSingleObject(ready, INFINITE);
+
+	return FG_OK;
+}
+
+/**
+* hands the GUI the newest processed ROI.
+*
+* <code>gui_publish</code> copies the ROI pixels and <code>win</code> into the back slot
+* of the triple buffer and swaps it with the middle slot, so it never waits for the GUI.
+* It has to be called before the image is given back to the frame grabber.
+*
+* @param win the TrackingWindow after <code>position</code>
+* @param xoff the x coordinate the ROI pixels were captured at
+* @param yoff the y coordinate the ROI pixels were captured at
+* @param img_nr the image number, shown by the GUI
+* @param calib draw the ROI and blob boxes
+*/
+
+void gui_publish(TrackingWindow *win, int xoff, int yoff, int img_nr, int calib)
+{
+	int i, w, h;
+	GuiSlot *s = slots + back;
+
+	w = win->roi_w;
+	h = win->roi_h;
+	if(thread == NULL || win->img == NULL) {
+		return;
+	}
+
+	s->win = *win;
+	s->win.img = s->pixels;
+	s->win.img_step = w;
+	s->img_nr = img_nr;
+	s->calib = calib;
+	s->xoff = xoff;
+	s->yoff = yoff;
+	s->w = w;
+	s->h = h;
+	for(i = 0; i < h; i++) {
+		memcpy(s->pixels + i * w, win->img + i * win->img_step, w);
+	}
+
+	back = InterlockedExchange(&middle, back | GUI_FRESH) & ~GUI_FRESH;
+}
+
+/**
+* takes the next key, mouse event or threshold change off the command queue.
+*
+* @param cmd updated with the command
+* @param timeout how long to wait for a command in milliseconds, 0 to only look or
+* <code>INFINITE</code>
+*
+* @return TRUE if <code>cmd</code> holds a command, otherwise FALSE
+*/
+
+int gui_command(GuiCommand *cmd, DWORD timeout)
+{
+	LONG head = queue.head;
+
+	if(head == queue.tail) {
+		if(timeout == 0 || thread == NULL) {
+			return FALSE;
+		}
+		WaitForSingleObject(posted, timeout);
+		if(head == queue.tail) {
+			return FALSE;
+		}
+	}
+
+	MemoryBarrier();
+	*cmd = queue.cmds[head & GUI_QUEUE_MASK];
+	MemoryBarrier();
+	queue.head = head + 1;
+
+	return TRUE;
+}
+
+/**
+* moves the threshold trackbar, for a threshold that was not set with the trackbar.
+*/
+
+void gui_threshold(int t)
+{
+	InterlockedExchange(&new_threshold, t);
+}
+
+/**
+* stops the GUI thread and closes the window.
+*/
+
+void gui_stop()
+{
+	int i;
+
+	running = FALSE;
+	if(thread != NULL) {
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+		thread = NULL;
+	}
+	if(posted != NULL) {
+		CloseHandle(posted);
+		posted = NULL;
+	}
+	if(ready != NULL) {
+		CloseHandle(ready);
+		ready = NULL;
+	}
+
+	for(i = 0; i < 3; i++) {
+		free(slots[i].pixels);
+		slots[i].pixels = NULL;
+	}
+}
@@ -4,6 +4,210 @@
 
 #include "fcdynamic.h"
 
+#if USE_SSE2
+#include <emmintrin.h>
+#include <intrin.h>
+#endif
+
+#if BLOB_MOMENTS
+#if USE_SSE2
+static int hsum_epi32(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	return _mm_cvtsi128_si32(v);
+}
+
+static int popcount16(int m)
+{
+	m = m - ((m >> 1) & 0x5555);
+	m = (m & 0x3333) + ((m >> 2) & 0x3333);
+	m = (m + (m >> 4)) & 0x0f0f;
+
+	return (m + (m >> 8)) & 0x1f;
+}
+#endif
+#endif
+
+/**
+* turns the raw moments into the centroid and orientation of the TrackingWindow
+*/
+void blob_shape(TrackingWindow *win, BlobMoments *m, int area)
+{
+	double x, y, mu20, mu11, mu02;
+
+	win->moments = *m;
+	win->area = area;
+	if(m->m00 == 0) {
+		return;
+	}
+
+	x = (double) m->m10 / m->m00;
+	y = (double) m->m01 / m->m00;
+	mu20 = (double) m->m20 / m->m00 - x * x;
+	mu11 = (double) m->m11 / m->m00 - x * y;
+	mu02 = (double) m->m02 / m->m00 - y * y;
+
+	win->cx = win->roi_xoff + x;
+	win->cy = win->roi_yoff + y;
+	win->theta = 0.5 * atan2(2 * mu11, mu20 - mu02);
+}
+
+/**
+* the Otsu threshold of a histogram
+*
+* the threshold splits the gray values into a background class below it and a
+* foreground class at or above it, and Otsu's threshold is the one with the largest
+* variance between the two classes.  Every threshold in an empty stretch of gray values
+* gives the same classes, so the middle of the stretch is taken to be as far from both
+* classes as possible.
+*
+* @return the threshold, or -1 if the classes are less than OTSU_MIN_CONTRAST apart or
+* the foreground has fewer than MIN_BLOB_AREA pixels
+*/
+static int otsu(const unsigned int *hist)
+{
+	int i, best_t, last_t;
+	double n, sum, wb, sb, wf, mb, mf, var, best_var, best_diff, best_wf;
+
+	n = 0;
+	sum = 0;
+	for(i = 0; i <= WHITE; i++) {
+		n += hist[i];
+		sum += (double) i * hist[i];
+	}
+
+	wb = 0;
+	sb = 0;
+	best_t = -1;
+	last_t = -1;
+	best_var = -1;
+	best_diff = 0;
+	best_wf = 0;
+	for(i = 1; i <= WHITE; i++) {
+		wb += hist[i - 1];
+		sb += (double) (i - 1) * hist[i - 1];
+		wf = n - wb;
+		if(wb == 0) {
+			continue;
+		}
+		if(wf == 0) {
+			break;
+		}
+
+		mb = sb / wb;
+		mf = (sum - sb) / wf;
+		var = wb * wf * (mf - mb) * (mf - mb);
+		if(var > best_var) {
+			best_var = var;
+			best_t = i;
+			last_t = i;
+			best_diff = mf - mb;
+			best_wf = wf;
+		}
+		else if(var == best_var && last_t == i - 1) {
+			last_t = i;
+		}
+	}
+
+	if(best_t < 0 || best_diff < OTSU_MIN_CONTRAST || best_wf < MIN_BLOB_AREA) {
+		return -1;
+	}
+
+	return (best_t + last_t) / 2;
+}
+
+/**
+* sets up an automatic threshold.
+*
+* the first histogram is taken from the next image, so the threshold adapts right away.
+*
+* @param at the AutoThreshold to initialize
+* @param t the threshold to start with
+* @param period the number of images between two histograms, at least 1
+* @param smooth the threshold moves 1 / smooth of the way to each Otsu threshold, 1 to
+* jump straight to it
+*
+* @see OTSU_PERIOD
+* @see OTSU_SMOOTH
+*/
+
+void auto_threshold_init(AutoThreshold *at, int t, int period, int smooth)
+{
+	memset(at, 0, sizeof(AutoThreshold));
+	at->period = (period < 1) ? 1 : period;
+	at->smooth = (smooth < 1) ? 1 : smooth;
+	at->count = at->period - 1;
+	at->otsu = -1;
+	auto_threshold_set(at, t);
+}
+
+/**
+* moves an automatic threshold to <code>t</code>, like after the user picked a threshold.
+*/
+
+void auto_threshold_set(AutoThreshold *at, int t)
+{
+	at->t = t;
+	at->level = t;
+}
+
+/**
+* the threshold to binarize <code>win</code> with and the histogram to fill, if this
+* image is due for one
+*/
+unsigned int *auto_threshold_begin(TrackingWindow *win, int *t)
+{
+	AutoThreshold *at = win->autot;
+
+	if(at == NULL) {
+		return NULL;
+	}
+
+	*t = at->t;
+	if(++at->count < at->period) {
+		return NULL;
+	}
+
+	at->count = 0;
+	memset(at->hist, 0, sizeof(at->hist));
+
+	return at->hist;
+}
+
+/**
+* moves the threshold towards the Otsu threshold of the histogram just filled
+*/
+void auto_threshold_end(AutoThreshold *at)
+{
+	at->otsu = otsu(at->hist);
+	if(at->otsu < 0) {
+		return;
+	}
+
+	at->level += (at->otsu - at->level) / at->smooth;
+	at->t = (int) (at->level + 0.5);
+}
+
+/**
+* adds one row of the blob window to a histogram, before it is binarized
+*/
+void histogram_row(unsigned int *hist, const unsigned char *row, int xmin, int xmax)
+{
+	int j;
+
+	for(j = xmin; j + 4 <= xmax; j += 4) {
+		hist[row[j]]++;
+		hist[row[j + 1]]++;
+		hist[row[j + 2]]++;
+		hist[row[j + 3]]++;
+	}
+	for(; j < xmax; j++) {
+		hist[row[j]]++;
+	}
+}
+
 /**
 * binarizes an image
 *
@@ -11,26 +215,268 @@
 * threshold level, <code>t</code>.  All values less than <code>t</code> are colored as
 * <code>BACKGROUND</code> pixels, otherwise the pixel is a <code>FOREGROUND</code> pixel.
 *
+* if <code>win->autot</code> is set its threshold is used instead of <code>t</code>, and
+* every <code>win->autot->period</code> images the histogram of each row is taken just
+* before the row is binarized.  If <code>win->bg</code> is set each row is replaced by
+* its difference to the background first, see <code>background_row</code>.  The
+* histograms of <code>win->autoe</code> are taken the same way, see exposure.cpp.
+*
 * @param win the TrackingWindow to threshold
 * @param t the threshold value
+*
+* @see auto_threshold
+* @see background.cpp
 */
 
 int threshold(TrackingWindow *win, int t)
 {
-	int i, j, xmax, ymax;
+	int i, j, xmax, ymax, bg;
+	unsigned int *hist, *ehist;
+	PMC_SAMPLE(pmc);
 
+	PMC_BEGIN(pmc);
 	xmax = win->blob_xmax;
 	ymax = win->blob_ymax;
+	hist = auto_threshold_begin(win, &t);
+	ehist = auto_exposure_begin(win);
+	bg = background_begin(win);
 
 	for(i = win->blob_ymin; i < ymax; i++) {
+		if(bg != BG_NONE) {
+			background_row(win, bg, i, win->blob_xmin, xmax, t);
+		}
+		if(hist != NULL) {
+			histogram_row(hist, &PIXEL(win, i, 0), win->blob_xmin, xmax);
+		}
+		if(ehist != NULL) {
+			histogram_row(ehist, &PIXEL(win, i, 0), win->blob_xmin, xmax);
+		}
 		for(j = win->blob_xmin; j < xmax; j++) {
 			PIXEL(win, i, j) = (PIXEL(win, i, j) < t) ? BACKGROUND : FOREGROUND;
 		}
 	}
 
+	if(hist != NULL) {
+		auto_threshold_end(win->autot);
+	}
+	if(ehist != NULL) {
+		auto_exposure_end(win, t);
+	}
+	PMC_END(PMC_THRESHOLD, win->roi, pmc);
+
 	return 0;
 }
 
+/**
+* binarizes an image and finds the object's bounding box in a single pass
+*
+* <code>threshold_blob</code> produces the same pixels as <code>threshold</code> and the
+* same bounding box as <code>blob</code>, but it only walks the blob window once.  When
+* <code>USE_SSE2</code> is set each row is binarized 16 pixels at a time with vector
+* compares, and the compare mask is used to update the bounding box without looking at
+* the pixels again.  The remaining pixels of each row are handled by the scalar loop.
+*
+* with <code>BLOB_MOMENTS</code> set the same pass also sums the moments of the
+* foreground pixels weighted by their gray value before thresholding.  The vector loop
+* masks the pixels with the compare result and sums them with <code>_mm_sad_epu8</code>
+* and <code>_mm_madd_epi16</code> against the lane offsets and their squares, so every
+* sum is exact.  The moments give the sub-pixel centroid, the area and the orientation
+* of the object; they are only available from this pass because <code>threshold</code>
+* overwrites the gray values.
+*
+* an automatic threshold in <code>win->autot</code>, an automatic exposure in
+* <code>win->autoe</code> and a background in <code>win->bg</code> are handled like in
+* <code>threshold</code>.  The background is
+* subtracted and the histogram of a row is taken while the row is in the cache right
+* before the vector loop binarizes it, so the window is still only read from memory
+* once.  The moments are then weighted by the difference to the background.
+*
+* @param win the TrackingWindow to threshold and update with the object's bounding box
+* @param t the threshold value
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @note like <code>blob</code>, the blob parameters of <code>win</code> are only updated
+* when an object is found, except for <code>win->area</code>, which is set to 0.
+*
+* @see USE_SSE2
+* @see BLOB_MOMENTS
+*/
+
+int threshold_blob(TrackingWindow *win, int t)
+{
+	int i, j, xmin, xmax, ymax, bg;
+	int box_xmin, box_ymin, box_xmax, box_ymax;
+	unsigned char *row;
+	unsigned int *hist, *ehist;
+#if USE_SSE2
+	int vec_end, mask;
+	unsigned long bit;
+	__m128i tv, fg, bg, px, cmp;
+#endif
+#if BLOB_MOMENTS
+	int area;
+	__int64 s0, s1, s2;
+	BlobMoments m;
+#if USE_SSE2
+	int a, b, c;
+	__m128i zero, k_lo, k_hi, k2_lo, k2_hi, w, w_lo, w_hi, sum;
+#endif
+#endif
+
+	xmin = win->blob_xmin;
+	xmax = win->blob_xmax;
+	ymax = win->blob_ymax;
+
+	box_xmin = xmax;
+	box_ymin = ymax;
+	box_xmax = -1;
+	box_ymax = -1;
+	hist = auto_threshold_begin(win, &t);
+	ehist = auto_exposure_begin(win);
+	bg = background_begin(win);
+
+#if USE_SSE2
+	// p >= t is computed as max(p, t) == p, which only works if t fits in a byte
+	if(t < 0) {
+		t = 0;
+	}
+	vec_end = (t <= 255) ? xmin + ((xmax - xmin) & ~15) : xmin;
+	tv = _mm_set1_epi8((char) t);
+	fg = _mm_set1_epi8((char) FOREGROUND);
+	bg = _mm_set1_epi8((char) BACKGROUND);
+#endif
+#if BLOB_MOMENTS
+	area = 0;
+	memset(&m, 0, sizeof(m));
+#if USE_SSE2
+	zero = _mm_setzero_si128();
+	k_lo = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+	k_hi = _mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+	k2_lo = _mm_setr_epi16(0, 1, 4, 9, 16, 25, 36, 49);
+	k2_hi = _mm_setr_epi16(64, 81, 100, 121, 144, 169, 196, 225);
+#endif
+#endif
+
+	for(i = win->blob_ymin; i < ymax; i++) {
+		row = &PIXEL(win, i, 0);
+		j = xmin;
+		if(bg != BG_NONE) {
+			background_row(win, bg, i, xmin, xmax, t);
+		}
+		if(hist != NULL) {
+			histogram_row(hist, row, xmin, xmax);
+		}
+		if(ehist != NULL) {
+			histogram_row(ehist, row, xmin, xmax);
+		}
+#if BLOB_MOMENTS
+		s0 = 0;
+		s1 = 0;
+		s2 = 0;
+#endif
+#if USE_SSE2
+		for(; j < vec_end; j += 16) {
+			px = _mm_loadu_si128((__m128i *) (row + j));
+			cmp = _mm_cmpeq_epi8(_mm_max_epu8(px, tv), px);
+			_mm_storeu_si128((__m128i *) (row + j),
+				_mm_or_si128(_mm_and_si128(cmp, fg), _mm_andnot_si128(cmp, bg)));
+
+			mask = _mm_movemask_epi8(cmp);
+			if(mask) {
+#if BLOB_MOMENTS
+				// a, b and c are the sums of w, w * k and w * k * k over the lanes k,
+				// which are moved to x = j + k once they are added to the row sums
+				w = _mm_and_si128(px, cmp);
+				sum = _mm_sad_epu8(w, zero);
+				a = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+				w_lo = _mm_unpacklo_epi8(w, zero);
+				w_hi = _mm_unpackhi_epi8(w, zero);
+				b = hsum_epi32(_mm_add_epi32(_mm_madd_epi16(w_lo, k_lo),
+					_mm_madd_epi16(w_hi, k_hi)));
+				c = hsum_epi32(_mm_add_epi32(_mm_madd_epi16(w_lo, k2_lo),
+					_mm_madd_epi16(w_hi, k2_hi)));
+
+				s0 += a;
+				s1 += (__int64) j * a + b;
+				s2 += (__int64) j * j * a + 2 * (__int64) j * b + c;
+				area += popcount16(mask);
+#endif
+				_BitScanForward(&bit, mask);
+				if(box_xmin > j + (int) bit) {
+					box_xmin = j + bit;
+				}
+				_BitScanReverse(&bit, mask);
+				if(box_xmax < j + (int) bit) {
+					box_xmax = j + bit;
+				}
+				if(box_ymin > i) {
+					box_ymin = i;
+				}
+				box_ymax = i;
+			}
+		}
+#endif
+		for(; j < xmax; j++) {
+			if(row[j] < t) {
+				row[j] = BACKGROUND;
+			}
+			else {
+#if BLOB_MOMENTS
+				s0 += row[j];
+				s1 += (__int64) row[j] * j;
+				s2 += (__int64) row[j] * j * j;
+				area++;
+#endif
+				row[j] = FOREGROUND;
+				if(box_xmin > j) {
+					box_xmin = j;
+				}
+				if(box_xmax < j) {
+					box_xmax = j;
+				}
+				if(box_ymin > i) {
+					box_ymin = i;
+				}
+				box_ymax = i;
+			}
+		}
+#if BLOB_MOMENTS
+		m.m00 += s0;
+		m.m10 += s1;
+		m.m20 += s2;
+		m.m01 += i * s0;
+		m.m11 += i * s1;
+		m.m02 += (__int64) i * i * s0;
+#endif
+	}
+
+	if(hist != NULL) {
+		auto_threshold_end(win->autot);
+	}
+	if(ehist != NULL) {
+		auto_exposure_end(win, t);
+	}
+
+	if(box_ymax < 0) {
+#if BLOB_MOMENTS
+		win->area = 0;
+#endif
+		return !OBJECT_FOUND;
+	}
+
+	win->blob_xmin = box_xmin;
+	win->blob_ymin = box_ymin;
+	win->blob_xmax = box_xmax;
+	win->blob_ymax = box_ymax;
+#if BLOB_MOMENTS
+	blob_shape(win, &m, area);
+#endif
+
+	return OBJECT_FOUND;
+}
+
 /**
 * finds the boundary of an image
 *
@@ -42,29 +488,40 @@ int threshold(TrackingWindow *win, int t)
 
 int boundary(TrackingWindow *win)
 {
-	int i, j, xmax, ymax;
+	int i;
+
+	for(i = win->blob_ymin; i < win->blob_ymax; i++) {
+		boundary_row(win, i);
+	}
+
+	return 0;
+}
+
+/**
+* marks the boundary pixels of row <code>i</code> of the blob window, see
+* <code>boundary</code>; it reads the rows above and below, which have to be binarized
+*/
+void boundary_row(TrackingWindow *win, int i)
+{
+	int j, xmax, ymax;
 
 	xmax = win->blob_xmax;
 	ymax = win->blob_ymax;
 
-	for(i = win->blob_ymin; i < ymax; i++) {
-		for(j = win->blob_xmin; j < xmax; j++) {
-			if( // center pixel
-				PIXEL(win, i, j) == FOREGROUND &&
-				// upper neighbor
-				((i - 1 < 0) || PIXEL(win, i - 1, j) == BACKGROUND ||
-				// lower neighbor
-				(i > ymax - 2) || PIXEL(win, i + 1, j) == BACKGROUND ||
-				// left neighbor
-				(j - 1 < 0) || PIXEL(win, i, j - 1) == BACKGROUND ||
-				// right neighbor
-				(j > xmax - 2) || PIXEL(win, i, j + 1) == BACKGROUND)) {
-					PIXEL(win, i, j) = BORDER;
-			}
+	for(j = win->blob_xmin; j < xmax; j++) {
+		if( // center pixel
+			PIXEL(win, i, j) == FOREGROUND &&
+			// upper neighbor
+			((i - 1 < 0) || PIXEL(win, i - 1, j) == BACKGROUND ||
+			// lower neighbor
+			(i > ymax - 2) || PIXEL(win, i + 1, j) == BACKGROUND ||
+			// left neighbor
+			(j - 1 < 0) || PIXEL(win, i, j - 1) == BACKGROUND ||
+			// right neighbor
+			(j > xmax - 2) || PIXEL(win, i, j + 1) == BACKGROUND)) {
+				PIXEL(win, i, j) = BORDER;
 		}
 	}
-
-	return 0;
 }
 
 /**
@@ -79,27 +536,41 @@ int boundary(TrackingWindow *win)
 
 int erode(TrackingWindow *win)
 {
-	int i, j, xmax, ymax;
+	int i;
+	PMC_SAMPLE(pmc);
+
+	PMC_BEGIN(pmc);
+	for(i = win->blob_ymin; i < win->blob_ymax; i++) {
+		erode_row(win, i);
+	}
+	PMC_END(PMC_ERODE, win->roi, pmc);
+
+	return 0;
+}
+
+/**
+* removes the stray pixels of row <code>i</code> of the blob window, see
+* <code>erode</code>; it reads the rows above and below, which have to be binarized
+*/
+void erode_row(TrackingWindow *win, int i)
+{
+	int j, xmax, ymax;
 
 	xmax = win->blob_xmax;
 	ymax = win->blob_ymax;
 
-	for(i = win->blob_ymin; i < ymax; i++) {
-		for(j = win->blob_xmin; j < xmax; j++) {
-			if( // center pixel
-				PIXEL(win, i, j) == FOREGROUND &&
-				// upper neighbor
-				(((i - 1 >= 0) && PIXEL(win, i - 1, j) == BACKGROUND) &&
-				// lower neighbor
-				((i + 1 < ymax) && PIXEL(win, i + 1, j) == BACKGROUND) &&
-				// left neighbor
-				((j - 1 >= 0) && PIXEL(win, i, j - 1) == BACKGROUND) &&
-				// right neighbor
-				((j + 1 < xmax) && PIXEL(win, i, j + 1) == BACKGROUND))) {
-					PIXEL(win, i, j) = BACKGROUND;
-			}
+	for(j = win->blob_xmin; j < xmax; j++) {
+		if( // center pixel
+			PIXEL(win, i, j) == FOREGROUND &&
+			// upper neighbor
+			(((i - 1 >= 0) && PIXEL(win, i - 1, j) == BACKGROUND) &&
+			// lower neighbor
+			((i + 1 < ymax) && PIXEL(win, i + 1, j) == BACKGROUND) &&
+			// left neighbor
+			((j - 1 >= 0) && PIXEL(win, i, j - 1) == BACKGROUND) &&
+			// right neighbor
+			((j + 1 < xmax) && PIXEL(win, i, j + 1) == BACKGROUND))) {
+				PIXEL(win, i, j) = BACKGROUND;
 		}
 	}
-
-	return 0;
 }
@@ -0,0 +1,82 @@
+/**
+* @file jobs.cpp the lock-free job queues and pinned threads of the multi-threaded runs.
+*
+* pipeline_run.cpp and window_run.cpp split the tracking loop over threads that each run
+* on a processor of their own and hand images to each other as PipelineJobs through
+* JobQueues.  A JobQueue has exactly one producer and one consumer, so pushing and
+* popping never take a lock.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* adds a job to the queue, only called by the producer of <code>q</code>
+*
+* @return <code>FG_OK</code>, or <code>!FG_OK</code> if the queue is full
+*/
+
+int job_push(JobQueue *q, PipelineJob *job)
+{
+	LONG tail = q->tail;
+
+	if(tail - q->head == JOB_QUEUE_LEN) {
+		return !FG_OK;
+	}
+
+	q->jobs[tail & JOB_QUEUE_MASK] = *job;
+	MemoryBarrier();
+	q->tail = tail + 1;
+
+	return FG_OK;
+}
+
+/**
+* takes the oldest job off the queue, only called by the consumer of <code>q</code>
+*
+* @return <code>FG_OK</code>, or <code>!FG_OK</code> if the queue is empty
+*/
+
+int job_pop(JobQueue *q, PipelineJob *job)
+{
+	LONG head = q->head;
+
+	if(head == q->tail) {
+		return !FG_OK;
+	}
+
+	MemoryBarrier();
+	*job = q->jobs[head & JOB_QUEUE_MASK];
+	MemoryBarrier();
+	q->head = head + 1;
+
+	return FG_OK;
+}
+
+/**
+* creates a suspended, time critical thread pinned to a processor.
+*
+* @param stage the function the thread runs
+* @param param handed to <code>stage</code>
+* @param cpu the processor the thread runs on
+*
+* @return the thread, which has to be started with <code>ResumeThread</code>, or NULL
+* if it could not be created
+*/
+
+HANDLE start_stage(LPTHREAD_START_ROUTINE stage, void *param, int cpu)
+{
+	HANDLE h;
+
+	h = CreateThread(NULL, 0, stage, param, CREATE_SUSPENDED, NULL);
+	if(h == NULL) {
+		printf("jobs: could not create thread (%d)\n", GetLastError());
+		return NULL;
+	}
+
+	if(SetThreadAffinityMask(h, ((DWORD_PTR) 1) << cpu) == 0) {
+		printf("jobs: could not pin thread to cpu %d\n", cpu);
+	}
+	SetThreadPriority(h, THREAD_PRIORITY_TIME_CRITICAL);
+
+	return h;
+}
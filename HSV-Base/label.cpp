@@ -0,0 +1,317 @@
+/**
+* @file label.cpp a run-length encoded connected-component labeler for finding several
+* objects inside one ROI.
+*
+* <code>blob</code> returns one bounding box around every foreground pixel, so two
+* markers in the same ROI merge into one box and a few noise pixels stretch it.
+* <code>label_blobs</code> instead splits the foreground into 8-connected components and
+* returns the area, centroid and bounding box of each one.
+*
+* the image is walked once, row by row, inside the blob rectangle of the TrackingWindow.
+* Each row is turned into runs of foreground pixels, and a run is joined to every run of
+* the previous row it touches with a union-find over the run labels.  The statistics
+* are summed into the root label as the runs are found, so once the last row is done
+* every root label already holds the statistics of its component and the pixels are
+* never visited a second time.
+*
+* @note the runs and labels are kept in thread local arrays, so every thread has its
+* own and <code>label_blobs</code> can run on several threads at a time.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the most runs <code>label_blobs</code> can track in one image
+*
+* a 128x128 ROI has at most 64 runs per row, so 8192 covers the worst case of that size.
+* Larger ROIs with more runs than this are labeled up to the row where the runs ran out.
+*/
+#define MAX_RUNS 8192
+
+/**
+* a run of foreground pixels from <code>xmin</code> to <code>xmax</code> (inclusive) in
+* one row
+*/
+struct blob_run {
+	int xmin;
+	int xmax;
+	int label;
+};
+
+typedef struct blob_run BlobRun;
+
+/**
+* the union-find node and running statistics of one label
+*/
+struct blob_label {
+	int parent;
+	int area;
+	__int64 sum_x;
+	__int64 sum_y;
+	int xmin;
+	int ymin;
+	int xmax;
+	int ymax;
+};
+
+typedef struct blob_label BlobLabel;
+
+static __declspec(thread) BlobRun runs[MAX_RUNS];
+static __declspec(thread) BlobLabel labels[MAX_RUNS];
+
+static int find_label(int l)
+{
+	int root = l, next;
+
+	while(labels[root].parent != root) {
+		root = labels[root].parent;
+	}
+
+	// compress the path so later finds are a single step
+	while(labels[l].parent != root) {
+		next = labels[l].parent;
+		labels[l].parent = root;
+		l = next;
+	}
+
+	return root;
+}
+
+/**
+* joins the components of labels a and b and returns the root of the joined component
+*/
+static int union_labels(int a, int b)
+{
+	BlobLabel *ra, *rb;
+
+	a = find_label(a);
+	b = find_label(b);
+	if(a == b) {
+		return a;
+	}
+
+	// keep the older label as the root so the roots stay in scan order
+	if(b < a) {
+		int tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	ra = labels + a;
+	rb = labels + b;
+
+	rb->parent = a;
+	ra->area += rb->area;
+	ra->sum_x += rb->sum_x;
+	ra->sum_y += rb->sum_y;
+	if(ra->xmin > rb->xmin) {
+		ra->xmin = rb->xmin;
+	}
+	if(ra->ymin > rb->ymin) {
+		ra->ymin = rb->ymin;
+	}
+	if(ra->xmax < rb->xmax) {
+		ra->xmax = rb->xmax;
+	}
+	if(ra->ymax < rb->ymax) {
+		ra->ymax = rb->ymax;
+	}
+
+	return a;
+}
+
+/**
+* adds the run to the statistics of label l's component
+*/
+static void add_run(int l, BlobRun *run, int y)
+{
+	int n;
+	BlobLabel *root = labels + find_label(l);
+
+	n = run->xmax - run->xmin + 1;
+	root->area += n;
+	root->sum_x += ((__int64) (run->xmin + run->xmax) * n) / 2;
+	root->sum_y += (__int64) y * n;
+	if(root->xmin > run->xmin) {
+		root->xmin = run->xmin;
+	}
+	if(root->xmax < run->xmax) {
+		root->xmax = run->xmax;
+	}
+	if(root->ymax < y) {
+		root->ymax = y;
+	}
+}
+
+static void insert_blob(BlobList *list, BlobLabel *l)
+{
+	int i;
+	BlobInfo *b;
+
+	// keep the list sorted by area, dropping the smallest blob when it is full
+	if(list->count == MAX_BLOBS) {
+		if(list->blobs[MAX_BLOBS - 1].area >= l->area) {
+			return;
+		}
+		i = MAX_BLOBS - 1;
+	}
+	else {
+		i = list->count++;
+	}
+
+	for(; i > 0 && list->blobs[i - 1].area < l->area; i--) {
+		list->blobs[i] = list->blobs[i - 1];
+	}
+
+	b = list->blobs + i;
+	b->area = l->area;
+	b->cx = (double) l->sum_x / l->area;
+	b->cy = (double) l->sum_y / l->area;
+	b->xmin = l->xmin;
+	b->ymin = l->ymin;
+	b->xmax = l->xmax;
+	b->ymax = l->ymax;
+}
+
+/**
+* splits the foreground pixels inside the blob rectangle into 8-connected components.
+*
+* <code>label_blobs</code> searches the same rectangle as <code>blob</code>, from
+* [<code>win->blob_xmin</code>, <code>win->blob_ymin</code>] up to but not including
+* [<code>win->blob_xmax</code>, <code>win->blob_ymax</code>], and assumes the image has
+* been binarized by <code>threshold</code>.  Components smaller than
+* <code>MIN_BLOB_AREA</code> pixels are treated as noise and left out of the list.
+*
+* @param win the TrackingWindow holding the image and the rectangle to search
+* @param list updated with up to <code>MAX_BLOBS</code> components sorted by area, the
+* largest first.  The centroids and bounding boxes are in the ROI reference frame and
+* the bounding boxes include their maximum coordinates like the one found by
+* <code>blob</code>.
+*
+* @return if at least one component is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @see select_blob
+*/
+
+int label_blobs(TrackingWindow *win, BlobList *list)
+{
+	int i, j, l, nruns, nlabels, prev, prev_end, row;
+	unsigned char *px;
+	BlobRun *run;
+
+	nruns = 0;
+	nlabels = 0;
+	prev = 0;
+	prev_end = 0;
+	list->count = 0;
+
+	for(i = win->blob_ymin; i < win->blob_ymax; i++) {
+		px = &PIXEL(win, i, 0);
+		row = nruns;
+
+		for(j = win->blob_xmin; j < win->blob_xmax; j++) {
+			if(px[j] != FOREGROUND) {
+				continue;
+			}
+
+			if(nruns == MAX_RUNS) {
+				break;
+			}
+
+			run = runs + nruns++;
+			run->xmin = j;
+			while(j + 1 < win->blob_xmax && px[j + 1] == FOREGROUND) {
+				j++;
+			}
+			run->xmax = j;
+			run->label = -1;
+
+			// the runs of the previous row are sorted, so skip the ones that end
+			// before this run and join the ones that overlap it (8-connected)
+			while(prev < prev_end && runs[prev].xmax + 1 < run->xmin) {
+				prev++;
+			}
+			for(l = prev; l < prev_end && runs[l].xmin <= run->xmax + 1; l++) {
+				if(run->label == -1) {
+					run->label = find_label(runs[l].label);
+				}
+				else {
+					run->label = union_labels(run->label, runs[l].label);
+				}
+			}
+			// the last run touched may also touch the next run in this row
+			if(l > prev) {
+				prev = l - 1;
+			}
+
+			if(run->label == -1) {
+				run->label = nlabels++;
+				labels[run->label].parent = run->label;
+				labels[run->label].area = 0;
+				labels[run->label].sum_x = 0;
+				labels[run->label].sum_y = 0;
+				labels[run->label].xmin = run->xmin;
+				labels[run->label].ymin = i;
+				labels[run->label].xmax = run->xmax;
+				labels[run->label].ymax = i;
+			}
+
+			add_run(run->label, run, i);
+		}
+
+		prev = row;
+		prev_end = nruns;
+
+		if(nruns == MAX_RUNS) {
+			printf("label_blobs: ran out of runs at row %d\n", i);
+			break;
+		}
+	}
+
+	for(l = 0; l < nlabels; l++) {
+		if(labels[l].parent == l && labels[l].area >= MIN_BLOB_AREA) {
+			insert_blob(list, labels + l);
+		}
+	}
+
+	return list->count > 0 ? OBJECT_FOUND : !OBJECT_FOUND;
+}
+
+/**
+* makes one of the components found by <code>label_blobs</code> the TrackingWindow's
+* blob.
+*
+* <code>select_blob</code> copies the component's bounding box into the blob parameters
+* of <code>win</code>, so <code>update_position</code> can center the ROI on it the same
+* way it does with the box found by <code>blob</code>.
+*
+* @param win the TrackingWindow to update
+* @param list the components found by <code>label_blobs</code>
+* @param index the component to select, 0 is the largest
+*
+* @return if <code>index</code> is a valid component then <code>OBJECT_FOUND</code>,
+* else <code>!OBJECT_FOUND</code>
+*/
+
+int select_blob(TrackingWindow *win, BlobList *list, int index)
+{
+	BlobInfo *b;
+
+	if(index < 0 || index >= list->count) {
+		return !OBJECT_FOUND;
+	}
+
+	b = list->blobs + index;
+	win->blob_xmin = b->xmin;
+	win->blob_ymin = b->ymin;
+	win->blob_xmax = b->xmax;
+	win->blob_ymax = b->ymax;
+
+	assert(win->blob_xmin >= 0);
+	assert(win->blob_ymin >= 0);
+	assert(win->blob_xmax <= win->roi_w);
+	assert(win->blob_ymax <= win->roi_h);
+
+	return OBJECT_FOUND;
+}
@@ -0,0 +1,200 @@
+/**
+* @file line.cpp 1D kernels for ROIs that are only a few rows tall.
+*
+* at the maximum line rate of the camera the ROI is a strip of 1 to LINE_MAX_H rows and
+* the object only moves along it, so instead of <code>threshold_blob</code> the rows
+* are summed into one column profile and the position is found in the profile.
+* <code>line_centroid</code> finds the centroid of the columns brighter than the
+* threshold, <code>line_edge</code> finds the steepest crossing of the threshold in one
+* direction to a fraction of a pixel.  Both leave the image untouched and read every
+* pixel once.
+*
+* like in the rest of the tracker the position is written to <code>win->cx</code> in the
+* image reference frame, with the center of pixel j at j.  <code>win->cy</code> is the
+* middle of the strip.
+*
+* @see line_run.cpp
+*/
+
+#include "fcdynamic.h"
+
+/**
+* sums the rows of the ROI into <code>profile</code>, which holds roi_w values
+*/
+static void line_profile(TrackingWindow *win, int *profile)
+{
+	int i, j, w, h;
+	unsigned char *row;
+
+	w = win->roi_w;
+	h = win->roi_h;
+
+	row = win->img;
+	for(j = 0; j < w; j++) {
+		profile[j] = row[j];
+	}
+
+	for(i = 1; i < h; i++) {
+		row += win->img_step;
+		for(j = 0; j < w; j++) {
+			profile[j] += row[j];
+		}
+	}
+}
+
+/**
+* sets the blob of <code>win</code> to a strip around the position, the whole height
+* of the ROI
+*/
+static void line_blob(TrackingWindow *win, int xmin, int xmax)
+{
+	win->blob_xmin = xmin;
+	win->blob_xmax = xmax;
+	win->blob_ymin = 0;
+	win->blob_ymax = win->roi_h;
+	win->cy = win->roi_yoff + (win->roi_h - 1) / 2.0;
+	seen_blob(win);
+}
+
+/**
+* finds the centroid of the bright columns of a line ROI.
+*
+* every column whose sum over the rows is above <code>t</code> times the rows is
+* weighted by how far it is above, so the centroid moves smoothly as the object moves
+* across a pixel.
+*
+* @param win the TrackingWindow of the strip, at most LINE_MAX_H rows
+* @param t the threshold of a single pixel
+*
+* @return if a column is above the threshold then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @note <code>win->area</code> is set to the columns above the threshold, 0 if the
+* object was not found.  The blob and the centroid are only updated when it was found.
+*/
+
+int line_centroid(TrackingWindow *win, int t)
+{
+	int profile[LINE_MAX_W];
+	int j, v, xmin, xmax, area;
+	__int64 s0, s1;
+
+	assert(win->roi_h >= 1 && win->roi_h <= LINE_MAX_H);
+	assert(win->roi_w <= LINE_MAX_W);
+
+	line_profile(win, profile);
+	t *= win->roi_h;
+
+	s0 = 0;
+	s1 = 0;
+	area = 0;
+	xmin = win->roi_w;
+	xmax = -1;
+	for(j = 0; j < win->roi_w; j++) {
+		v = profile[j] - t;
+		if(v > 0) {
+			s0 += v;
+			s1 += (__int64) v * j;
+			area++;
+			if(j < xmin) {
+				xmin = j;
+			}
+			xmax = j;
+		}
+	}
+
+	win->area = area;
+	if(area == 0) {
+		return !OBJECT_FOUND;
+	}
+
+	win->cx = win->roi_xoff + (double) s1 / s0;
+	line_blob(win, xmin, xmax + 1);
+
+	return OBJECT_FOUND;
+}
+
+/**
+* finds an edge in a line ROI to a fraction of a pixel.
+*
+* the edge is where the column profile crosses <code>t</code> times the rows, going up
+* for LINE_RISING and down for LINE_FALLING from left to right.  Of several crossings
+* the steepest one is taken, and the position is interpolated linearly between the
+* two columns on either side of it.
+*
+* @param win the TrackingWindow of the strip, at most LINE_MAX_H rows
+* @param t the threshold of a single pixel
+* @param dir LINE_RISING or LINE_FALLING
+*
+* @return if there is a crossing then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @note <code>win->area</code> is set to the difference of the two columns of the edge,
+* its contrast, 0 if there was no edge.
+*/
+
+int line_edge(TrackingWindow *win, int t, int dir)
+{
+	int profile[LINE_MAX_W];
+	int j, a, b, d, best, at;
+
+	assert(win->roi_h >= 1 && win->roi_h <= LINE_MAX_H);
+	assert(win->roi_w <= LINE_MAX_W);
+	assert(dir == LINE_RISING || dir == LINE_FALLING);
+
+	line_profile(win, profile);
+	t *= win->roi_h;
+
+	best = 0;
+	at = -1;
+	for(j = 1; j < win->roi_w; j++) {
+		// a falling edge is a rising edge of the negated profile
+		a = dir * (profile[j - 1] - t);
+		b = dir * (profile[j] - t);
+		d = b - a;
+		if(a < 0 && b >= 0 && d > best) {
+			best = d;
+			at = j;
+		}
+	}
+
+	win->area = best;
+	if(at < 0) {
+		return !OBJECT_FOUND;
+	}
+
+	a = dir * (profile[at - 1] - t);
+	win->cx = win->roi_xoff + (at - 1) + (double) -a / best;
+	line_blob(win, at - 1, at + 1);
+
+	return OBJECT_FOUND;
+}
+
+/**
+* moves a line ROI along its row so that it is centered on the position.
+*
+* the rows of the strip stay where they are and nothing happens when the object was
+* not found, a lost object has to come back into the strip.
+*
+* @param win the TrackingWindow updated by <code>line_centroid</code> or
+* <code>line_edge</code>
+* @param found their result
+*
+* @return <code>found</code>
+*/
+
+int line_follow(TrackingWindow *win, int found)
+{
+	int old_xoff;
+
+	if(found != OBJECT_FOUND) {
+		return found;
+	}
+
+	old_xoff = win->roi_xoff;
+	set_roi_box(win, (int) (win->cx + 0.5), win->roi_yoff + win->roi_h / 2);
+	win->blob_xmin -= win->roi_xoff - old_xoff;
+	win->blob_xmax -= win->roi_xoff - old_xoff;
+
+	return found;
+}
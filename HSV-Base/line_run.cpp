@@ -0,0 +1,202 @@
+/**
+* @file line_run.cpp senses the position of an object along a line at the maximum line
+* rate of the camera.
+*
+* the ROIs of the sequence are strips of 1 to LINE_MAX_H rows set up by main.cpp, and
+* each image is handled by <code>line_centroid</code> or <code>line_edge</code> instead
+* of the 2D tracker.  The loop only keeps the position, the grabber timestamp and the
+* time of the kernel of every image, so the work per image stays a small fraction of a
+* frame time of a few tens of microseconds.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* moves the strips along with the object with <code>line_follow</code>
+*
+* with LINE_FOLLOW == 0 the strips stay where main.cpp put them and no parameter set is
+* written while the loop runs, which is the fastest when the strip covers the whole
+* travel of the object.
+*/
+#define LINE_FOLLOW 0
+
+/**
+* prints the position in every image after the summary
+*/
+#define LINE_PRINT 0
+
+/**
+* what is kept of one image
+*/
+struct line_sample {
+	int img;
+	int found;
+	double x; /**< the position in the image reference frame */
+	__int64 fg_ts;
+	LONGLONG ticks; /**< of the kernel */
+};
+
+typedef struct line_sample LineSample;
+
+/**
+* the position along the strips of <code>num_imgs</code> images.
+*
+* at the end the images per second, the lost images, the images the object was found in
+* and the time of the kernel are printed.
+*
+* @param tseq the TrackingSequence of the strips
+* @param num_imgs the number of images
+* @param t the threshold value of a single pixel
+* @param edge LINE_CENTROID for the centroid of the bright columns, LINE_RISING or
+* LINE_FALLING for the edge in that direction
+* @param frame the frame time in microseconds
+* @param exposure the exposure time in microseconds
+*
+* @return <code>FG_OK</code> on success, <code>EINVAL</code> if a strip is too tall or
+* too wide for the kernels, <code>ENOMEM</code> if the samples could not be allocated
+*/
+
+int line_run(TrackingSequence *tseq, int num_imgs, int t, int edge, double frame,
+	double exposure)
+{
+	int i, rc, total_imgs, found;
+	double secs, mean, max, us;
+	TrackingWindow *cur;
+	LineSample *samples;
+	LARGE_INTEGER freq, start, stop, k0, k1;
+	FrameView view;
+#if ONLINE
+	Fg_Struct *fg = NULL;
+	FrameRing ring;
+#endif
+
+	for(i = 0; i < tseq->seq_len; i++) {
+		cur = tseq->windows + tseq->seq[i];
+		if(cur->roi_h < 1 || cur->roi_h > LINE_MAX_H || cur->roi_w > LINE_MAX_W) {
+			printf("line_run: ROI %d is %d x %d, at most %d x %d\n", cur->roi, cur->roi_w,
+				cur->roi_h, LINE_MAX_W, LINE_MAX_H);
+			return EINVAL;
+		}
+	}
+
+	samples = (LineSample *) calloc(num_imgs, sizeof(LineSample));
+	if(samples == NULL) {
+		return ENOMEM;
+	}
+	QueryPerformanceFrequency(&freq);
+
+#if ONLINE
+	rc = StartGrabbing(&fg, tseq, NULL);
+#else
+	rc = replay_start(tseq, frame);
+#endif
+	if(rc != FG_OK) {
+		free(samples);
+		return rc;
+	}
+#if ONLINE
+	rc = StartRing(&ring, fg, tseq);
+	if(rc != FG_OK) {
+		deinit_cam(fg);
+		free(samples);
+		return rc;
+	}
+#endif
+
+	total_imgs = 0;
+	found = 0;
+	QueryPerformanceCounter(&start);
+	while(total_imgs < num_imgs) {
+#if ONLINE
+		rc = ring_next(&ring, &view, TIMEOUT);
+#else
+		rc = replay_next(&view);
+#endif
+		if(rc != FG_OK || view.data == NULL) {
+			printf("img is null: %d\n", view.img);
+			break;
+		}
+
+		cur = tseq->windows + view.roi;
+		window_frame(cur, &view);
+
+		QueryPerformanceCounter(&k0);
+		if(edge == LINE_CENTROID) {
+			rc = line_centroid(cur, t);
+		}
+		else {
+			rc = line_edge(cur, t, edge);
+		}
+#if LINE_FOLLOW
+		rc = line_follow(cur, rc);
+#endif
+		QueryPerformanceCounter(&k1);
+
+#if PUBLISH
+		write_comm(cur, rc);
+#endif
+#if ONLINE
+#if LINE_FOLLOW
+		write_rois(fg, &cur->roi, 1, view.img);
+#endif
+		ring_release(&ring, &view);
+#endif
+
+		samples[total_imgs].img = view.img;
+		samples[total_imgs].found = rc;
+		samples[total_imgs].x = cur->cx;
+		samples[total_imgs].fg_ts = view.fg_ts;
+		samples[total_imgs].ticks = k1.QuadPart - k0.QuadPart;
+		if(rc == OBJECT_FOUND) {
+			found++;
+		}
+		total_imgs++;
+	}
+	QueryPerformanceCounter(&stop);
+
+	mean = 0;
+	max = 0;
+	for(i = 0; i < total_imgs; i++) {
+		us = samples[i].ticks * 1e6 / freq.QuadPart;
+		mean += us;
+		if(us > max) {
+			max = us;
+		}
+	}
+	if(total_imgs > 0) {
+		mean /= total_imgs;
+	}
+
+	secs = (double) (stop.QuadPart - start.QuadPart) / freq.QuadPart;
+	cur = tseq->windows + tseq->seq[0];
+	printf("line %d x %d, f %.1f us, e %.1f us: %d images in %.3f s (%.1f fps), found %d",
+		cur->roi_w, cur->roi_h, frame, exposure, total_imgs, secs,
+		(secs > 0) ? total_imgs / secs : 0, found);
+#if ONLINE
+	printf(", lost %d (ring %d, retagged %d), skipped %d", cam_status(fg, NUMBER_OF_LOST_IMAGES, PORT_A),
+		ring.lost, ring.retagged, ring.skipped);
+#endif
+	printf(", kernel mean %.2f max %.2f us\n", mean, max);
+
+#if LINE_PRINT
+	for(i = 0; i < total_imgs; i++) {
+		printf("%d %I64d %d %f\n", samples[i].img, samples[i].fg_ts, samples[i].found,
+			samples[i].x);
+	}
+#endif
+
+	rc = FG_OK;
+#if ONLINE
+	rc = deinit_cam(fg);
+	if(rc != FG_OK) {
+		printf("deinit: %s\n", Fg_getLastErrorDescription(fg));
+	}
+#endif
+	free(samples);
+
+	if(total_imgs < num_imgs) {
+		return !FG_OK;
+	}
+
+	return rc;
+}
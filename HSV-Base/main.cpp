@@ -6,67 +6,52 @@
 
 #define TIMING 0
 #define RECORD 0
+#define RAW_RECORD 1 // record raw ROIs with record_run instead of an AVI
+#define RECORD_FILE "capture.hsr"
+#define RECORD_IMGS 10000
+#define RECORD_DISPLAY 0 // show every n-th recorded image, 0 for none
+#define PIPELINE 0
+#define SWEEP_SESSION 1 // keep the grabber open across the runs of the timing sweep, see cam.cpp
+#define PARALLEL_WINDOWS 0 // process every window of the sequence on its own thread, see window_run.cpp
+#define MULTI_CAM 0 // track on port A and port B of the board at once, see multi_run.cpp
+#define LINE_SCAN 0 // sense the position along a strip at the maximum line rate, see line_run.cpp
+#define LINE_W 1024 // the strip, centered on the initial blob
+#define LINE_H 1 // 1 to LINE_MAX_H rows
+#define LINE_KERNEL LINE_CENTROID // or LINE_RISING, LINE_FALLING
+#define TRACE_FILE "moments.trc"
 
-// TRACKCAM
-#define EXPOSURE 20000
-#define FRAME_TIME 50000
-#define IMG_WIDTH 1024
-#define IMG_HEIGHT 1024
-
-// TIMER
-#define NUM_IMGS 100
-#define WIDTH_STEP 2
-#define MIN_WIDTH 16
-#define MAX_WIDTH 128
-#define MIN_FRAME 10
-#define MAX_FRAME 100000 // us (10 fps)
-#define FRAME_STEP 10
-#define EXPOSURE_STEP 4
-
-// INITIAL BLOB POSITION IN IMG COORD FRAME
-#define INITIAL_ROI_X 0
-#define INITIAL__ROI_Y 0
-#define BOUNDING_BOX 1024
-#define INITIAL_BLOB_XMIN (404+45)
-#define INITIAL_BLOB_YMIN (731+56)
-#define INITIAL_BLOB_WIDTH 25
-#define INITIAL_BLOB_HEIGHT 20
-#define THRESHOLD 128
-
-#define SEQ {ROI_0, ROI_5}
-#define SEQ_LEN 2
-
-void initial_blob_positions(TrackingWindow *win)
+// the camera, blob and sweep parameters, see config.cpp
+#define CONFIG_FILE "moments.ini"
+#define BENCH_FILE "bench.json" // the summary of the timing sweep, see bench.cpp
+
+void initial_blob_positions(TrackingWindow *win, Config *cfg)
 {
-	win[ROI_0].blob_xmin = INITIAL_BLOB_XMIN;
-	win[ROI_0].blob_ymin = INITIAL_BLOB_YMIN;
-	win[ROI_0].blob_xmax = INITIAL_BLOB_XMIN + INITIAL_BLOB_WIDTH;
-	win[ROI_0].blob_ymax = INITIAL_BLOB_YMIN + INITIAL_BLOB_HEIGHT;
-
-	win[ROI_5].blob_xmin = INITIAL_BLOB_XMIN;
-	win[ROI_5].blob_ymin = INITIAL_BLOB_YMIN;
-	win[ROI_5].blob_xmax = INITIAL_BLOB_XMIN + INITIAL_BLOB_WIDTH;
-	win[ROI_5].blob_ymax = INITIAL_BLOB_YMIN + INITIAL_BLOB_HEIGHT;
+	int i;
+
+	for(i = 0; i < cfg->seq_len; i++) {
+		win[cfg->seq[i]].blob_xmin = cfg->blob_xmin;
+		win[cfg->seq[i]].blob_ymin = cfg->blob_ymin;
+		win[cfg->seq[i]].blob_xmax = cfg->blob_xmin + cfg->blob_w;
+		win[cfg->seq[i]].blob_ymax = cfg->blob_ymin + cfg->blob_h;
+	}
 }
 
-void reset(TrackingWindow *win, int roi_box, double frame, double exposure)
+void reset(TrackingWindow *win, AutoThreshold *autos, Background *bgs, AutoExposure *aes,
+	ChangeDetect *cds, StagePlan *sps, RigidBody *body, FlightRecorder *frs, Config *cfg,
+	int roi_box, double frame, double exposure)
 {
-	int i;
+	int i, k, fresh;
 	int img_w, img_h;
 	int blob_cx, blob_cy;
-	IplImage *img = NULL;
 
 	memset(win, 0, sizeof(TrackingWindow) * MAX_ROI);
-	initial_blob_positions(win);
+	initial_blob_positions(win, cfg);
 
 #if ONLINE
-	img_w = IMG_WIDTH;
-	img_h = IMG_HEIGHT;
+	img_w = cfg->img_w;
+	img_h = cfg->img_h;
 #else
-	GetNextImage(&img, 0, ANIMATION_NAME, ANIMATION_LENGTH, FALSE);
-	img_w = img->width;
-	img_h = img->height;
-	cvReleaseImage(&img);
+	replay_size(&img_w, &img_h);
 #endif
 
 	for(i = 0; i < MAX_ROI; i++) {
@@ -79,29 +64,108 @@ void reset(TrackingWindow *win, int roi_box, double frame, double exposure)
 		win[i].img_w = img_w;
 		win[i].img_h = img_h;
 
+		// the frame grabber buffers are sized for roi_box, adapt_roi can't grow past it
+		win[i].roi_max_w = roi_box;
+		win[i].roi_max_h = roi_box;
+		win[i].max_frame = frame;
+		win[i].exposure = exposure;
+
 		set_roi_box(win + i, blob_cx, blob_cy);
 		fix_blob_bounds(win + i);
 
+		// the search window is as large as the buffers of the sequence, see search.cpp
+		if(i == cfg->search_roi) {
+			search_setup(win + i, win, cfg->seq, cfg->seq_len, cfg->search_w, cfg->search_h);
+			if(cfg->search_exposure > 0 && exposure > 0) {
+				win[i].exposure = cfg->search_exposure;
+			}
+		}
+
+		if(cfg->auto_threshold) {
+			auto_threshold_init(autos + i, cfg->threshold, cfg->otsu_period, cfg->otsu_smooth);
+			win[i].autot = autos + i;
+		}
+
+		// nothing to shorten when the images come from disk
+		if(cfg->auto_exposure && exposure > 0) {
+			auto_exposure_init(aes + i, win[i].exposure, cfg->ae_min, cfg->ae_contrast,
+				cfg->ae_period);
+			win[i].autoe = aes + i;
+		}
+
+		// the reference is kept across resets, so it is only loaded the first time
+		if(cfg->background) {
+			fresh = (bgs[i].ref == NULL);
+			if(background_init(bgs + i, img_w, img_h, cfg->bg_period) == FG_OK) {
+				if(fresh && cfg->bg_file[0] != '\0') {
+					background_load(bgs + i, cfg->bg_file);
+				}
+				win[i].bg = bgs + i;
+			}
+		}
+
+		// a search window moves every time, there is nothing to reuse
+		if(cfg->change_detect && i != cfg->search_roi) {
+			if(change_init(cds + i, win[i].roi_max_w, win[i].roi_max_h, cfg->change_noise,
+				cfg->change_refresh) == FG_OK) {
+				win[i].change = cds + i;
+			}
+		}
+
+		if(cfg->stages[0] != '\0') {
+			if(stage_init(sps + i, cfg->stages, win[i].roi_max_w) == FG_OK) {
+				win[i].stages = sps + i;
+			}
+		}
+
+		// only the ROIs of the sequence, a ring of images of every ROI would be a lot
+		for(k = 0; k < cfg->seq_len && cfg->seq[k] != i; k++);
+		if(cfg->flight_images > 0 && k < cfg->seq_len && i != cfg->search_roi) {
+			if(flight_init(frs + i, i, win[i].roi_max_w, win[i].roi_max_h,
+				cfg->flight_images) == FG_OK) {
+				win[i].flight = frs + i;
+			}
+		}
+
+		// the table only covers where the ROI can go from where it starts
+		if(cfg->world_file[0] != '\0' && (k < cfg->seq_len || i == cfg->search_roi)) {
+			world_attach(win + i, cfg->world_margin);
+		}
+
 #if ONLINE
-		SetTrackCamParameters(win + i, frame, exposure);
+		SetTrackCamParameters(win + i, frame, win[i].exposure);
 #endif
 	}
+
+	// the windows were cleared, the body links them again
+	if(cfg->rigid_link[0] != '\0') {
+		rigid_init(body, win, cfg->rigid_link);
+	}
 }
 
-int capture_video(TrackingSequence *tseq, int num_imgs)
+int capture_video(TrackingSequence *tseq, Config *cfg, int num_imgs)
 {
 	int rc, img_nr, total_imgs;
 	IplImage *cvDisplay = NULL;
 	Fg_Struct *fg = NULL;
+	FrameRing ring;
+	FrameView view;
 	CvVideoWriter *writer;
 
 	total_imgs = 0;
 	img_nr = 1;
-	cvDisplay = cvCreateImageHeader(cvSize(IMG_WIDTH, IMG_HEIGHT), 8, 1);
+	cvDisplay = cvCreateImageHeader(cvSize(cfg->img_w, cfg->img_h), 8, 1);
+#if PREVIEW
+	rc = preview_start(cfg->img_w, cfg->img_h);
+	if(rc != FG_OK) {
+		return rc;
+	}
+#else
 	cvNamedWindow("win", CV_WINDOW_AUTOSIZE);
+#endif
 
-	writer = cvCreateVideoWriter("out.avi", -1, 1e6 / FRAME_TIME,
-							cvSize(IMG_WIDTH,IMG_HEIGHT), FALSE);
+	writer = cvCreateVideoWriter("out.avi", -1, 1e6 / cfg->frame_time,
+							cvSize(cfg->img_w, cfg->img_h), FALSE);
 
 	if(writer == NULL) {
 		return EINVAL;
@@ -111,17 +175,31 @@ int capture_video(TrackingSequence *tseq, int num_imgs)
 	if(rc != FG_OK) {
 		return rc;
 	}
+
+	rc = StartRing(&ring, fg, tseq);
+	if(rc != FG_OK) {
+		deinit_cam(fg);
+		return rc;
+	}
 	
 	while(total_imgs < num_imgs) {
-		img_nr = Fg_getLastPicNumberBlocking(fg, img_nr, PORT_A, TIMEOUT);
-		cvDisplay->imageData = (char *) Fg_getImagePtr(fg, img_nr, PORT_A);
-		cvDisplay->imageDataOrigin = (char *) Fg_getImagePtr(fg, img_nr, PORT_A);
+		ring_next(&ring, &view, TIMEOUT);
+		img_nr = view.img;
+		cvDisplay->imageData = (char *) view.data;
+		cvDisplay->imageDataOrigin = (char *) view.data;
 
 		if(cvDisplay->imageData != NULL) {
 			total_imgs++;
 			cvWriteFrame(writer, cvDisplay);
+#if PREVIEW
+			preview_publish(view.data, cfg->img_w, 0, 0, cfg->img_w, cfg->img_h, img_nr, NULL,
+				FALSE);
+			ring_release(&ring, &view);
+#else
 			cvShowImage("win", cvDisplay);
+			ring_release(&ring, &view);
 			cvWaitKey(20);
+#endif
 		}
 		else {
 			printf("img is null: %d\n", img_nr);
@@ -136,56 +214,287 @@ int capture_video(TrackingSequence *tseq, int num_imgs)
 	}
 	cvReleaseVideoWriter(&writer);
 	cvReleaseImageHeader(&cvDisplay);
+#if PREVIEW
+	preview_stop();
+#endif
 
 	return FG_OK;
 }
 
+int track_two_cameras(Config *cfg)
+{
+	int i, k, rc;
+	Camera cams[2];
+	TrackingSequence tseqs[2];
+	static AutoThreshold autos[2][MAX_ROI];
+	static Background bgs[2][MAX_ROI];
+	static AutoExposure aes[2][MAX_ROI];
+	static ChangeDetect cds[2][MAX_ROI];
+	static StagePlan sps[2][MAX_ROI];
+	static RigidBody bodies[2];
+	static FlightRecorder frs[2][MAX_ROI];
+
+	memset(cams, 0, sizeof(cams));
+	cams[0].port = PORT_A;
+	cams[1].port = PORT_B;
+
+	for(i = 0; i < 2; i++) {
+		tseqs[i].seq = cfg->seq;
+		tseqs[i].seq_len = cfg->seq_len;
+		tseqs[i].adapt = ADAPT_ROI;
+		tseqs[i].latest = cfg->latest_wins;
+		tseqs[i].merge = NULL;
+		reset(tseqs[i].windows, autos[i], bgs[i], aes[i], cds[i], sps[i], bodies + i, frs[i],
+			cfg, cfg->bounding_box, cfg->frame_time, cfg->exposure);
+	}
+
+	rc = multi_run(cams, tseqs, 2, cfg->num_imgs, cfg->threshold, cfg->frame_time,
+		cfg->exposure);
+
+	// the last dumps are written before the rings go
+	for(i = 0; i < 2; i++) {
+		for(k = 0; k < MAX_ROI; k++) {
+			flight_free(frs[i] + k);
+		}
+	}
+
+	return rc;
+}
+
+int sense_line(TrackingSequence *tseq, Config *cfg)
+{
+	int i;
+	TrackingWindow *win;
+	static AutoThreshold autos[MAX_ROI];
+	static Background bgs[MAX_ROI];
+	static AutoExposure aes[MAX_ROI];
+	static ChangeDetect cds[MAX_ROI];
+	static StagePlan sps[MAX_ROI];
+	static RigidBody body;
+	static FlightRecorder frs[MAX_ROI];
+
+	reset(tseq->windows, autos, bgs, aes, cds, sps, &body, frs, cfg, LINE_W, cfg->frame_time,
+		cfg->exposure);
+	initial_blob_positions(tseq->windows, cfg);
+
+	for(i = 0; i < cfg->seq_len; i++) {
+		win = tseq->windows + cfg->seq[i];
+		win->roi_h = LINE_H;
+		win->roi_max_h = LINE_H;
+		set_roi_box(win, cfg->blob_xmin + cfg->blob_w / 2, cfg->blob_ymin + cfg->blob_h / 2);
+		fix_blob_bounds(win);
+#if ONLINE
+		SetTrackCamParameters(win, cfg->frame_time, cfg->exposure);
+#endif
+	}
+
+	return line_run(tseq, cfg->num_imgs, cfg->threshold, LINE_KERNEL, cfg->frame_time,
+		cfg->exposure);
+}
+
 int main(int argc, char *argv[])
 {
 	int rc = FG_OK;
 	TrackingSequence tseq;
+	Config cfg;
+	static AutoThreshold autos[MAX_ROI];
+	static Background bgs[MAX_ROI];
+	static AutoExposure aes[MAX_ROI];
+	static ChangeDetect cds[MAX_ROI];
+	static StagePlan sps[MAX_ROI];
+	static RigidBody body;
+	static FlightRecorder frs[MAX_ROI];
+	static int search_seq[MAX_SEQ_LEN];
+	static RoiMerge merge;
 	double frame = 0, exposure = 0, exp_step = 0;
-	int box = 0;
-	int seq[] = SEQ;
+	int i, box = 0, buf_size = 0;
+	char *config_file = (argc > 1) ? argv[1] : CONFIG_FILE;
+	RtProfileConfig rtc;
+	RtProfile rt;
+
+	config_defaults(&cfg);
+	rc = config_load(&cfg, config_file);
+	if(rc == ENOENT) {
+		printf("main: no %s, using the built-in parameters\n", config_file);
+	}
+	else if(rc != FG_OK) {
+		return rc;
+	}
+
+	frametime_config(&cfg);
+
+	if(cfg.world_file[0] != '\0') {
+		rc = world_load(cfg.world_file);
+		if(rc != FG_OK) {
+			return rc;
+		}
+	}
+
+	// the process ending undoes the profile, so the early returns below don't revert it
+	if(cfg.rt_profile) {
+		rt_profile_defaults(&rtc);
+		rtc.mmcss_task = cfg.rt_task[0] ? cfg.rt_task : NULL;
+		rtc.timer_ms = cfg.rt_timer;
+		rtc.cpu = cfg.rt_cpu;
+		rt_profile_apply(&rt, &rtc);
+		rt_profile_report(&rt, stdout);
+	}
+
+	tseq.seq = cfg.seq;
+	tseq.seq_len = cfg.seq_len;
+	tseq.adapt = ADAPT_ROI;
+	tseq.latest = cfg.latest_wins;
+	tseq.merge = NULL;
+
+	if(cfg.search_roi >= 0) {
+		rc = search_sequence(search_seq, MAX_SEQ_LEN, cfg.seq, cfg.seq_len, cfg.search_roi,
+			cfg.search_every);
+		if(rc < 0) {
+			printf("main: no sequence with roi %d every %d images\n", cfg.search_roi,
+				cfg.search_every);
+			return EINVAL;
+		}
+		tseq.seq = search_seq;
+		tseq.seq_len = rc;
+		rc = FG_OK;
+	}
+
+#if !ONLINE
+	// decode the images once so the timing runs don't measure the jpeg decoder
+	rc = replay_load(ANIMATION_NAME, ANIMATION_LENGTH);
+	if(rc != FG_OK) {
+		return rc;
+	}
+#endif
 
-	tseq.seq = (int *) &seq;
-	tseq.seq_len = SEQ_LEN;
+#if PUBLISH
+	rc = open_comm();
+	if(rc != 0) {
+		printf("main: could not open the result publisher (%d)\n", rc);
+		return rc;
+	}
+#endif
+
+	// only records anything if TRACE_POINTS is defined
+	TRACE_START(TRACE_FILE);
+	// and the counters of the kernels if PMC_PROFILE is, see PmcProfile.h
+	PMC_START();
+	RTLOG_START(NULL);
 
 #if (ONLINE && RECORD)
-	reset(tseq.windows, BOUNDING_BOX, FRAME_TIME, EXPOSURE);
-	return capture_video(&tseq, 100);
+	reset(tseq.windows, autos, bgs, aes, cds, sps, &body, frs, &cfg, cfg.bounding_box, cfg.frame_time, cfg.exposure);
+#if RAW_RECORD
+	rc = record_run(&tseq, RECORD_IMGS, RECORD_FILE, RECORD_DISPLAY);
+#else
+	rc = capture_video(&tseq, &cfg, 100);
+#endif
+	RTLOG_STOP();
+	TRACE_STOP();
+	PMC_STOP(stdout);
+	return rc;
 #endif
 
+#if (ONLINE && MULTI_CAM)
+	rc = track_two_cameras(&cfg);
+	RTLOG_STOP();
+	TRACE_STOP();
+	PMC_STOP(stdout);
+	return rc;
+#endif
+
+#if LINE_SCAN
+	rc = sense_line(&tseq, &cfg);
+	RTLOG_STOP();
+	TRACE_STOP();
+	PMC_STOP(stdout);
+	return rc;
+#endif
+
+	// the guests of a merged ROI are run in the thread of their host, see merge.cpp
+	merge.gap = cfg.merge_gap;
+	tseq.merge = (cfg.merge_rois && !PIPELINE && !PARALLEL_WINDOWS && !APPLET_MOMENTS) ?
+		&merge : NULL;
+
 #if TIMING
-	box = MIN_WIDTH;
-	while(box <= MAX_WIDTH) {
+	bench_open(BENCH_FILE);
+#if ONLINE
+	// the sweep asks for frame times the camera can't keep up with to calibrate them
+	frametime_calibrate(TRUE);
+#if SWEEP_SESSION
+	// one set of buffers for the largest ROI of the sweep, see cam.cpp
+	buf_size = FRAME_BUF_SIZE(cfg.max_width, cfg.max_width);
+	rc = session_open(buf_size, buffers_most(buf_size), CAMLINK);
+	if(rc != FG_OK) {
+		bench_close();
+		RTLOG_STOP();
+		TRACE_STOP();
+		PMC_STOP(stdout);
+		return rc;
+	}
+#endif
+#endif
+	box = cfg.min_width;
+	while(box <= cfg.max_width) {
 	#if ONLINE
-		for(frame = MAX_FRAME; frame >= MIN_FRAME; frame /= FRAME_STEP) {
-			if(frame == MIN_FRAME) {
-				exp_step = EXPOSURE_STEP;
+		for(frame = cfg.max_frame; frame >= cfg.min_frame; frame /= cfg.frame_step) {
+			if(frame == cfg.min_frame) {
+				exp_step = cfg.exposure_step;
 			}
 			else {
-				exp_step = (frame - MIN_FRAME) / EXPOSURE_STEP;
+				exp_step = (frame - cfg.min_frame) / cfg.exposure_step;
 			}
 
-			for(exposure = MIN_FRAME; exposure <= frame; exposure += exp_step) {
-					reset(tseq.windows, box, frame, exposure);
-					time_run(&tseq, NUM_IMGS, THRESHOLD, frame, exposure);
+			for(exposure = cfg.min_frame; exposure <= frame; exposure += exp_step) {
+					reset(tseq.windows, autos, bgs, aes, cds, sps, &body, frs, &cfg, box, frame, exposure);
+		#if PIPELINE
+					pipeline_run(&tseq, cfg.num_imgs, cfg.threshold, frame, exposure);
+		#elif PARALLEL_WINDOWS
+					window_run(&tseq, cfg.num_imgs, cfg.threshold, frame, exposure);
+		#else
+					time_run(&tseq, cfg.num_imgs, cfg.threshold, frame, exposure);
+		#endif
 			}
 		}
 	#else
-		reset(tseq.windows, box, -1, -1);
-		time_run(&tseq, NUM_IMGS, THRESHOLD, -1, -1);
+		reset(tseq.windows, autos, bgs, aes, cds, sps, &body, frs, &cfg, box, -1, -1);
+		time_run(&tseq, cfg.num_imgs, cfg.threshold, cfg.replay_frame, -1);
 	#endif
-		box *= WIDTH_STEP;
+		box *= cfg.width_step;
 	}
+#if ONLINE
+	frametime_calibrate(FALSE);
+#if SWEEP_SESSION
+	session_close();
+#endif
+#endif
+	bench_close();
 #else
-	reset(tseq.windows, BOUNDING_BOX, FRAME_TIME, EXPOSURE);
-	rc = display_run(&tseq, FRAME_TIME, EXPOSURE);
+	reset(tseq.windows, autos, bgs, aes, cds, sps, &body, frs, &cfg, cfg.bounding_box, cfg.frame_time, cfg.exposure);
+	// the threshold and exposure can be changed in the file while display_run is running
+	config_watch(&cfg, config_file);
+	rc = display_run(&tseq, cfg.frame_time, cfg.exposure);
+	config_unwatch();
 	if(rc != FG_OK) {
 		_getch();
 	}
 #endif
+	RTLOG_STOP();
+	TRACE_STOP();
+	PMC_STOP(stdout);
+#if PUBLISH
+	close_comm();
+#endif
+#if !ONLINE
+	replay_free();
+#endif
+	for(i = 0; i < MAX_ROI; i++) {
+		background_free(bgs + i);
+		change_free(cds + i);
+		stage_free(sps + i);
+		flight_free(frs + i);
+	}
+	rigid_free(&body);
+	world_free();
 
 	return rc;
 }
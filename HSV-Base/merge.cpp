@@ -0,0 +1,388 @@
+/**
+* @file merge.cpp gives the objects of ROIs that come close one ROI of the frame grabber.
+*
+* every object is tracked by a ROI of its own, and when two objects come close their
+* ROIs overlap and the pixels they share are transferred and processed twice.  A
+* RoiMerge keeps the ROIs written to the frame grabber apart from the ROIs of the
+* windows: after every image <code>merge_plan</code> looks for windows of the sequence
+* whose ROIs overlap or are less than <code>gap</code> pixels apart and gives the first
+* of them in the sequence, the host, one ROI of the frame grabber around all of them,
+* with x and the width multiples of 4 and no more pixels than a buffer holds.  The
+* others, its guests, are left a ROI_MIN_W x MERGE_IDLE_H ROI of the frame grabber in
+* their slot of the sequence, whose images <code>merge_frame</code> tells the loop to
+* skip.
+*
+* the windows keep tracking in their own ROI, only their image is a part of the larger
+* one: <code>merge_frame</code> points a window at its ROI inside the image of the
+* frame grabber, like a search tile, so the blob pass, <code>update_position</code> and
+* <code>adapt_roi</code> work the same with and without merging.
+* <code>merge_guests</code> runs the guests of a host on its image right after the
+* host, so every object of a merged ROI gets a result with every image of the host.
+* The merged ROI transfers the pixels the windows share once, and the slots of the
+* guests in the sequence only cost their idle ROI.  The sequence on the frame grabber
+* stays the one of the run; a ROI leaves the merge again as soon as its object moves
+* away, with the next plan.
+*
+* a search window, a window whose object is lost and windows of different cameras are
+* never merged, the first two move their ROI by more than the gap at once.  The
+* guests are run in the thread of their host, which leaves the loops that process
+* one image at a time, <code>time_run</code> and <code>display_run</code>.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the windows of the sequence, every ROI once in the order it first comes up
+*/
+static int sequence_rois(TrackingSequence *tseq, int *rois)
+{
+	int i, k, n;
+
+	n = 0;
+	for(i = 0; i < tseq->seq_len; i++) {
+		for(k = 0; k < n && rois[k] != tseq->seq[i]; k++);
+		if(k == n) {
+			rois[n++] = tseq->seq[i];
+		}
+	}
+
+	return n;
+}
+
+/**
+* whether a window can share a ROI of the frame grabber
+*/
+static int mergeable(TrackingWindow *win)
+{
+	return win->tracks == NULL && win->lost == RECOVER_NONE && win->hint == 0;
+}
+
+/**
+* the frame time of a window with a w x h ROI, scaled like <code>adapt_roi</code> does
+*/
+static double frame_of(TrackingSequence *tseq, TrackingWindow *win, int w, int h)
+{
+	double frame;
+
+	if(!tseq->adapt) {
+		return win->max_frame;
+	}
+
+	frame = win->max_frame * ((double) (w * h) / (win->roi_max_w * win->roi_max_h));
+	if(frame < win->exposure) {
+		frame = win->exposure;
+	}
+
+	return frame;
+}
+
+/**
+* starts a run with every window in a ROI of its own.
+*
+* @param tseq the TrackingSequence of the run, its windows set up by <code>reset</code>
+*
+* @note does nothing without a RoiMerge in <code>tseq->merge</code>
+*/
+
+void merge_start(TrackingSequence *tseq)
+{
+	int i, k, n, rois[MAX_SEQ_LEN];
+	RoiMerge *m = tseq->merge;
+	TrackingWindow *win;
+
+	if(m == NULL) {
+		return;
+	}
+
+	m->max_pixels = 0;
+	for(i = 0; i < MAX_ROI; i++) {
+		win = tseq->windows + i;
+		m->host[i] = i;
+		m->x[i] = win->roi_xoff;
+		m->y[i] = win->roi_yoff;
+		m->w[i] = win->roi_w;
+		m->h[i] = win->roi_h;
+	}
+
+	// the buffers hold the largest ROI of the sequence, see buffers.cpp
+	n = sequence_rois(tseq, rois);
+	for(k = 0; k < n; k++) {
+		win = tseq->windows + rois[k];
+		if(m->max_pixels < win->roi_max_w * win->roi_max_h) {
+			m->max_pixels = win->roi_max_w * win->roi_max_h;
+		}
+	}
+
+	m->joins = 0;
+	m->shared = 0;
+	m->idle = 0;
+}
+
+/**
+* points a window at its ROI inside the image of ROI <code>hw</code> of the frame
+* grabber
+*
+* @return FALSE if the image does not hold all of the ROI of the window
+*/
+static int view_in(RoiMerge *m, TrackingWindow *win, int hw, FrameView *view)
+{
+	int dx, dy;
+
+	dx = win->roi_xoff - m->x[hw];
+	dy = win->roi_yoff - m->y[hw];
+	if(dx < 0 || dy < 0 || dx + win->roi_w > m->w[hw] || dy + win->roi_h > m->h[hw]) {
+		return FALSE;
+	}
+
+	win->img = view->data + dy * m->w[hw] + dx;
+	win->img_step = m->w[hw];
+	win->ts = view->fg_ts;
+	win->exp_us = view->exp_us;
+
+	return TRUE;
+}
+
+/**
+* hands the image of a ROI of the frame grabber to its window, like
+* <code>window_frame</code> does, or tells the loop to skip it.
+*
+* @param tseq the TrackingSequence of the run
+* @param win the TrackingWindow of the ROI that captured the image
+* @param view the image, its data is NULL if there is none
+*
+* @return TRUE if the window has the image, FALSE if it is the image of a guest, whose
+* object is found in the image of its host, or of a ROI that has just moved
+*/
+
+int merge_frame(TrackingSequence *tseq, TrackingWindow *win, FrameView *view)
+{
+	RoiMerge *m = tseq->merge;
+
+	if(m == NULL || view->data == NULL) {
+		window_frame(win, view);
+		return TRUE;
+	}
+
+	if(m->host[win->roi] != win->roi || !view_in(m, win, win->roi, view)) {
+		m->idle++;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+* runs the guests of a host on its image, right after the pass of the host.
+*
+* every guest gets the fused pass, <code>change_blob</code>, and
+* <code>update_position</code>, and with <code>tseq->adapt</code> set
+* <code>adapt_roi</code>, like the host in <code>time_run</code>.
+*
+* @param tseq the TrackingSequence of the run
+* @param host the TrackingWindow whose image <code>view</code> is
+* @param view the image of the host
+* @param t the threshold value
+*
+* @return the number of guests run
+*/
+
+int merge_guests(TrackingSequence *tseq, TrackingWindow *host, FrameView *view, int t)
+{
+	int i, n, rc;
+	RoiMerge *m = tseq->merge;
+	TrackingWindow *g;
+
+	if(m == NULL) {
+		return 0;
+	}
+
+	n = 0;
+	for(i = 0; i < MAX_ROI; i++) {
+		if(i == host->roi || m->host[i] != host->roi) {
+			continue;
+		}
+		g = tseq->windows + i;
+		if(!view_in(m, g, host->roi, view)) {
+			continue;
+		}
+
+		rc = update_position(g, change_blob(g, t));
+		if(tseq->adapt) {
+			adapt_roi(g, rc);
+		}
+#if PUBLISH
+		write_comm(g, rc);
+#endif
+		m->shared++;
+		n++;
+	}
+
+	return n;
+}
+
+/**
+* the ROI of the frame grabber of a window, the ROI of the window without a RoiMerge
+*
+* @param tseq the TrackingSequence of the run
+* @param roi the index of the ROI
+* @param x set to the ROI in the image reference frame
+* @param y
+* @param w
+* @param h
+*/
+
+void merge_rect(TrackingSequence *tseq, int roi, int *x, int *y, int *w, int *h)
+{
+	RoiMerge *m = tseq->merge;
+	TrackingWindow *win = tseq->windows + roi;
+
+	if(m == NULL) {
+		*x = win->roi_xoff;
+		*y = win->roi_yoff;
+		*w = win->roi_w;
+		*h = win->roi_h;
+		return;
+	}
+
+	*x = m->x[roi];
+	*y = m->y[roi];
+	*w = m->w[roi];
+	*h = m->h[roi];
+}
+
+/**
+* merges the ROIs of the windows that came close and splits those that moved apart,
+* after <code>cur</code> was run.
+*
+* the windows are taken in the order of the sequence, and every window that is not a
+* guest yet takes the later windows within <code>gap</code> pixels of its ROI, or of the
+* ROIs it took already, as its guests, as long as the ROI around them fits a buffer.
+* The ROIs of the frame grabber are set with <code>cam_roi_window</code> and
+* <code>cam_roi_exposure</code>, which leave a ROI that stays the same alone.
+*
+* @param tseq the TrackingSequence of the run
+* @param cur the TrackingWindow that was just run
+* @param rois set to the ROIs to hand to <code>write_rois</code>
+*
+* @return the number of entries in <code>rois</code>
+*/
+
+int merge_plan(TrackingSequence *tseq, TrackingWindow *cur, const int **rois)
+{
+	int a, b, k, n, r, x0, y0, x1, y1, list[MAX_SEQ_LEN];
+	int host[MAX_ROI], ux0[MAX_ROI], uy0[MAX_ROI], ux1[MAX_ROI], uy1[MAX_ROI];
+	RoiMerge *m = tseq->merge;
+	TrackingWindow *wa, *wb, *win;
+
+	if(m == NULL) {
+		*rois = &cur->roi;
+		return 1;
+	}
+
+	n = sequence_rois(tseq, list);
+	for(k = 0; k < n; k++) {
+		r = list[k];
+		win = tseq->windows + r;
+		host[r] = r;
+		ux0[r] = win->roi_xoff;
+		uy0[r] = win->roi_yoff;
+		ux1[r] = win->roi_xoff + win->roi_w;
+		uy1[r] = win->roi_yoff + win->roi_h;
+	}
+
+	for(a = 0; a < n; a++) {
+		wa = tseq->windows + list[a];
+		if(host[wa->roi] != wa->roi || !mergeable(wa)) {
+			continue;
+		}
+		for(b = a + 1; b < n; b++) {
+			wb = tseq->windows + list[b];
+			if(host[wb->roi] != wb->roi || !mergeable(wb) || wb->cam != wa->cam) {
+				continue;
+			}
+			r = wa->roi;
+			if(wb->roi_xoff >= ux1[r] + m->gap || wb->roi_xoff + wb->roi_w + m->gap <= ux0[r] ||
+				wb->roi_yoff >= uy1[r] + m->gap || wb->roi_yoff + wb->roi_h + m->gap <= uy0[r]) {
+				continue;
+			}
+
+			// the ROIs of the windows are on the 4 pixel grid already
+			x0 = (wb->roi_xoff < ux0[r]) ? wb->roi_xoff : ux0[r];
+			y0 = (wb->roi_yoff < uy0[r]) ? wb->roi_yoff : uy0[r];
+			x1 = (wb->roi_xoff + wb->roi_w > ux1[r]) ? wb->roi_xoff + wb->roi_w : ux1[r];
+			y1 = (wb->roi_yoff + wb->roi_h > uy1[r]) ? wb->roi_yoff + wb->roi_h : uy1[r];
+			x0 &= ~3;
+			x1 = (x1 + 3) & ~3;
+			if(x1 > wa->img_w || (x1 - x0) * (y1 - y0) > m->max_pixels) {
+				continue;
+			}
+
+			host[wb->roi] = r;
+			ux0[r] = x0;
+			uy0[r] = y0;
+			ux1[r] = x1;
+			uy1[r] = y1;
+		}
+	}
+
+	for(k = 0; k < n; k++) {
+		r = list[k];
+		win = tseq->windows + r;
+		if(host[r] != r) {
+			if(m->host[r] == r) {
+				m->joins++;
+			}
+			// the idle ROI of a guest, the grabber needs a slot of the sequence filled
+			x0 = win->roi_xoff;
+			y0 = win->roi_yoff;
+			x1 = x0 + ROI_MIN_W;
+			y1 = y0 + MERGE_IDLE_H;
+		}
+		else {
+			x0 = ux0[r];
+			y0 = uy0[r];
+			x1 = ux1[r];
+			y1 = uy1[r];
+		}
+
+		// a window that is in a merge, or just left one, has the frame grabber's ROI
+		// set over the one update_position set
+		if(host[r] != r || m->host[r] != r || x0 != m->x[r] || y0 != m->y[r] ||
+			x1 - x0 != m->w[r] || y1 - y0 != m->h[r]) {
+			cam_roi_window(win->cam, r, x0, x1 - x0, y0, y1 - y0);
+			if(win->max_frame > 0) {
+				// the clamp raises the frame time of an idle ROI to the shortest one
+				cam_roi_exposure(win->cam, r, win->exposure,
+					(host[r] != r) ? win->exposure : frame_of(tseq, win, x1 - x0, y1 - y0));
+			}
+		}
+
+		m->host[r] = host[r];
+		m->x[r] = x0;
+		m->y[r] = y0;
+		m->w[r] = x1 - x0;
+		m->h[r] = y1 - y0;
+	}
+
+	// the parameter sets that did not change are skipped
+	*rois = tseq->seq;
+	return tseq->seq_len;
+}
+
+/**
+* prints how often the windows of a run shared the ROI of another one
+*
+* @param tseq the TrackingSequence of the run
+*/
+
+void merge_summary(TrackingSequence *tseq)
+{
+	RoiMerge *m = tseq->merge;
+
+	if(m == NULL || m->joins == 0) {
+		return;
+	}
+
+	printf("merge: a roi joined another %u times, %u objects found in the image of a host, "
+		"%u images skipped\n", m->joins, m->shared, m->idle);
+}
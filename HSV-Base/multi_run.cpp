@@ -0,0 +1,226 @@
+/**
+* @file multi_run.cpp tracks with several TrackCams at the same time.
+*
+* every camera gets its own TrackingSequence and its own thread, which runs the same
+* loop as time_run.cpp over a FrameRing of that camera.  The cameras share nothing but
+* the frame grabber board when they are on two ports of it, so the threads never wait
+* for each other.  All threads are released at the same time, so the frame rates they
+* print at the end can be compared directly.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the state of one camera's tracking thread
+*/
+struct multi_cam {
+	Camera *cam;
+	TrackingSequence *tseq;
+	FrameRing ring;
+	HANDLE thread;
+	int num_imgs;
+	int t;
+	int imgs; /**< the number of images tracked */
+	int found; /**< the number of images the blob was found in */
+	int rc;
+	LARGE_INTEGER start;
+	LARGE_INTEGER stop;
+};
+
+typedef struct multi_cam MultiCam;
+
+static HANDLE go = NULL;
+
+static DWORD WINAPI track_thread(LPVOID param)
+{
+	int rc;
+	MultiCam *m = (MultiCam *) param;
+	TrackingWindow *cur;
+	FrameView view;
+
+	WaitForSingleObject(go, INFINITE);
+
+	QueryPerformanceCounter(&m->start);
+	while(m->imgs < m->num_imgs) {
+		rc = ring_next(&m->ring, &view, TIMEOUT);
+		if(rc != FG_OK) {
+			printf("camera %d/%d: img is null: %d\n", m->cam->board, m->cam->port, view.img);
+			m->rc = rc;
+			break;
+		}
+
+		cur = m->tseq->windows + view.roi;
+		window_frame(cur, &view);
+
+#if APPLET_MOMENTS
+		rc = update_position(cur, applet_result(cur, (AppletResult *) view.data));
+#elif FUSED_BLOB
+		flight_put(cur, view.img, m->t);
+		TRACE_POINT(TRACE_POSITION_START);
+		rc = update_position(cur, change_blob(cur, m->t));
+		TRACE_POINT(TRACE_POSITION_STOP);
+		flight_result(cur, rc);
+#else
+		flight_put(cur, view.img, m->t);
+		threshold(cur, m->t);
+		rc = position(cur);
+		flight_result(cur, rc);
+#endif
+		if(m->tseq->adapt) {
+			adapt_roi(cur, rc);
+		}
+
+		cam_write_rois(m->cam, &cur->roi, 1, view.img);
+		ring_release(&m->ring, &view);
+
+		if(rc == OBJECT_FOUND) {
+			m->found++;
+		}
+		m->imgs++;
+	}
+	QueryPerformanceCounter(&m->stop);
+
+	return 0;
+}
+
+/**
+* opens one camera, moves the windows of its sequence to it and starts acquiring
+*/
+static int start_camera(MultiCam *m, double frame, double exposure)
+{
+	int i, rc;
+	TrackingWindow *win;
+
+	for(i = 0; i < m->tseq->seq_len; i++) {
+		win = m->tseq->windows + m->tseq->seq[i];
+		win->cam = m->cam;
+		rc = SetTrackCamParameters(win, frame, exposure);
+		if(rc != FG_OK) {
+			return rc;
+		}
+	}
+
+	buffers_plan(m->tseq);
+	rc = cam_init(m->cam, m->cam->board, m->cam->port,
+		m->tseq->buf_size * m->tseq->buffers, m->tseq->buffers, CAMLINK);
+	if(rc != FG_OK) {
+		printf("init camera %d/%d: %s\n", m->cam->board, m->cam->port,
+			Fg_getLastErrorDescription(m->cam->fg));
+		return rc;
+	}
+
+	rc = cam_acquire(m->cam, m->tseq->seq, m->tseq->seq_len);
+	if(rc != FG_OK) {
+		printf("acquire camera %d/%d: %s\n", m->cam->board, m->cam->port,
+			Fg_getLastErrorDescription(m->cam->fg));
+		cam_deinit(m->cam);
+		return rc;
+	}
+
+	rc = ring_init_cam(&m->ring, m->cam, m->tseq, m->tseq->buffers, m->tseq->buf_size);
+	if(rc != FG_OK) {
+		cam_deinit(m->cam);
+		return rc;
+	}
+
+	return FG_OK;
+}
+
+/**
+* tracks <code>num_imgs</code> images on every camera at the same time.
+*
+* the cameras have to be zeroed and only need <code>board</code> and <code>port</code>
+* set, everything else is set up by <code>cam_init</code>.  The windows of <code>tseqs[i]</code> are moved to
+* <code>cams[i]</code>, so each sequence has to be set up as for <code>time_run</code>.
+* At the end the frame rate, the images the blob was found in and the images the frame
+* grabber lost are printed for every camera.
+*
+* @param cams the cameras, one per sequence
+* @param tseqs the TrackingSequence of each camera
+* @param ncams the number of cameras, at most <code>MAX_CAMS</code>
+* @param num_imgs the number of images to track on each camera
+* @param t the threshold value to be used with <code>threshold</code>
+* @param frame the frame time in microseconds
+* @param exposure the exposure time in microseconds
+*
+* @return <code>FG_OK</code> on success, <code>EINVAL</code> for a bad number of cameras,
+* <code>ENOMEM</code> if a thread could not be started, otherwise the first camera error
+*/
+
+int multi_run(Camera *cams, TrackingSequence *tseqs, int ncams, int num_imgs, int t,
+	double frame, double exposure)
+{
+	int i, j, n, rc = FG_OK;
+	double secs;
+	LARGE_INTEGER freq;
+	MultiCam m[MAX_CAMS];
+
+	if(ncams <= 0 || ncams > MAX_CAMS) {
+		return EINVAL;
+	}
+	QueryPerformanceFrequency(&freq);
+
+	go = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if(go == NULL) {
+		return ENOMEM;
+	}
+
+	memset(m, 0, sizeof(m));
+	for(n = 0; n < ncams; n++) {
+		m[n].cam = cams + n;
+		m[n].tseq = tseqs + n;
+		m[n].num_imgs = num_imgs;
+		m[n].t = t;
+
+		rc = start_camera(m + n, frame, exposure);
+		if(rc != FG_OK) {
+			break;
+		}
+
+		m[n].thread = CreateThread(NULL, 0, track_thread, m + n, 0, NULL);
+		if(m[n].thread == NULL) {
+			cam_deinit(m[n].cam);
+			rc = ENOMEM;
+			break;
+		}
+	}
+
+	// a camera that failed to start stops the others before they track anything
+	for(i = 0; i < n; i++) {
+		if(rc != FG_OK) {
+			m[i].num_imgs = 0;
+		}
+	}
+	SetEvent(go);
+
+	for(i = 0; i < n; i++) {
+		WaitForSingleObject(m[i].thread, INFINITE);
+		CloseHandle(m[i].thread);
+
+		if(rc == FG_OK) {
+			secs = (double) (m[i].stop.QuadPart - m[i].start.QuadPart) / freq.QuadPart;
+			printf("camera %d/%d: %d images in %.3f s (%.1f fps), found %d, lost %d (ring %d, retagged %d), skipped %d\n",
+				m[i].cam->board, m[i].cam->port, m[i].imgs, secs,
+				(secs > 0) ? m[i].imgs / secs : 0, m[i].found,
+				cam_status(m[i].cam->fg, NUMBER_OF_LOST_IMAGES, m[i].cam->port),
+				m[i].ring.lost, m[i].ring.retagged, m[i].ring.skipped);
+			change_summary(tseqs + i);
+			flight_summary(tseqs + i);
+			if(m[i].rc != FG_OK) {
+				rc = m[i].rc;
+			}
+		}
+	}
+
+	for(i = 0; i < n; i++) {
+		cam_deinit(m[i].cam);
+		for(j = 0; j < m[i].tseq->seq_len; j++) {
+			m[i].tseq->windows[m[i].tseq->seq[j]].cam = NULL;
+		}
+	}
+
+	CloseHandle(go);
+	go = NULL;
+
+	return rc;
+}
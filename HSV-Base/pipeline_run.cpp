@@ -0,0 +1,303 @@
+/**
+* @file pipeline_run.cpp a version of time_run.cpp that splits the tracking loop into
+* three threads.
+*
+* the acquisition thread takes images from a FrameRing, the processing thread runs
+* <code>threshold_blob</code> and <code>update_position</code>, and the write thread
+* sends the updated ROI to the frame grabber with <code>write_rois</code>.  The threads
+* pass jobs to each other through the JobQueues of jobs.cpp, which do not take any
+* locks, so the next ROI in the sequence can be processed while the parameter
+* set of the previous one is still being written.  Images the write thread is done with
+* are handed back to the acquisition thread, which is the only thread touching the ring
+* until it took its last image; the write thread releases the rest itself.
+*
+* @note the parameter sets in roi.cpp are not locked, so the processing thread only
+* updates the position of a ROI once the write thread has written every job of that ROI
+* before it.  Consecutive entries of the ROI sequence should be different ROIs (like
+* <code>SEQ {ROI_0, ROI_5}</code>), or the processing thread waits on every write.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the processor each stage is pinned to
+*/
+#define ACQUIRE_CPU 1
+#define PROCESS_CPU 2
+#define WRITE_CPU 3
+
+/**
+* the state shared by the three stages
+*/
+struct pipeline {
+	Fg_Struct *fg;
+	FrameRing ring;
+	TrackingSequence *tseq;
+	TimingInfo *timer;
+	int t;
+
+	JobQueue grabbed; /**< acquisition -> processing */
+	JobQueue processed; /**< processing -> write */
+	JobQueue written; /**< write -> acquisition, images to release */
+	volatile LONG writing[MAX_ROI]; /**< the processed jobs of every ROI not yet written */
+
+	volatile LONG acquired; /**< set once the acquisition thread is done */
+	volatile LONG stopped; /**< set once the processing thread is done */
+	volatile LONG failed; /**< set if the acquisition thread did not get an image */
+};
+
+typedef struct pipeline Pipeline;
+
+static void release_written(Pipeline *p)
+{
+	PipelineJob job;
+
+	while(job_pop(&p->written, &job) == FG_OK) {
+		ring_release(&p->ring, &job.view);
+	}
+}
+
+static DWORD WINAPI acquire_stage(LPVOID param)
+{
+	int i;
+	PipelineJob job;
+	Pipeline *p = (Pipeline *) param;
+	FrameInfo *frame;
+
+	for(i = 0; i < p->timer->num_imgs; i++) {
+		frame = p->timer->frame + i;
+
+		release_written(p);
+
+		QueryPerformanceCounter(&frame->grab_start);
+		if(ring_next(&p->ring, &job.view, TIMEOUT) != FG_OK) {
+			printf("img is null: %d\n", job.view.img);
+			InterlockedExchange(&p->failed, TRUE);
+			// only print the images that made it through the pipeline
+			p->timer->num_imgs = i;
+			break;
+		}
+		QueryPerformanceCounter(&frame->grab_stop);
+
+		frame->img = job.view.img;
+		frame->fg_ts = job.view.fg_ts;
+		job.frame = i;
+		while(job_push(&p->grabbed, &job) != FG_OK) {
+			release_written(p);
+			YieldProcessor();
+		}
+	}
+
+	InterlockedExchange(&p->acquired, TRUE);
+	return 0;
+}
+
+static DWORD WINAPI process_stage(LPVOID param)
+{
+	PipelineJob job;
+	Pipeline *p = (Pipeline *) param;
+	TrackingWindow *cur;
+	FrameInfo *frame;
+
+	while(1) {
+		if(job_pop(&p->grabbed, &job) != FG_OK) {
+			if(p->acquired && p->grabbed.head == p->grabbed.tail) {
+				break;
+			}
+			YieldProcessor();
+			continue;
+		}
+
+		frame = p->timer->frame + job.frame;
+		cur = p->tseq->windows + job.view.roi;
+		window_frame(cur, &job.view);
+
+		// the pixels as they came, before the pass binarizes them
+		flight_put(cur, job.view.img, p->t);
+
+		QueryPerformanceCounter(&frame->thresh_start);
+		job.found = change_blob(cur, p->t);
+		QueryPerformanceCounter(&frame->thresh_stop);
+
+		// the write thread may still be writing the parameter set of the ROI
+		while(p->writing[job.view.roi] != 0) {
+			YieldProcessor();
+		}
+
+		QueryPerformanceCounter(&frame->blob_start);
+		job.found = update_position(cur, job.found);
+		flight_result(cur, job.found);
+		if(p->tseq->adapt) {
+			adapt_roi(cur, job.found);
+		}
+#if PUBLISH
+		write_comm(cur, job.found);
+#endif
+		QueryPerformanceCounter(&frame->blob_stop);
+
+		frame->blob_found = job.found;
+		memcpy(&frame->win, cur, sizeof(TrackingWindow));
+
+		InterlockedIncrement(p->writing + job.view.roi);
+		while(job_push(&p->processed, &job) != FG_OK) {
+			YieldProcessor();
+		}
+	}
+
+	InterlockedExchange(&p->stopped, TRUE);
+	return 0;
+}
+
+static DWORD WINAPI write_stage(LPVOID param)
+{
+	PipelineJob job;
+	Pipeline *p = (Pipeline *) param;
+
+	while(1) {
+		if(job_pop(&p->processed, &job) != FG_OK) {
+			if(p->stopped && p->processed.head == p->processed.tail) {
+				break;
+			}
+			YieldProcessor();
+			continue;
+		}
+
+		write_rois(p->fg, &job.view.roi, 1, job.view.img);
+		QueryPerformanceCounter(&(p->timer->frame[job.frame].pc_ts));
+		InterlockedDecrement(p->writing + job.view.roi);
+
+		while(job_push(&p->written, &job) != FG_OK) {
+			// nothing drains the queue once the acquisition thread is done
+			if(p->acquired) {
+				release_written(p);
+				continue;
+			}
+			YieldProcessor();
+		}
+	}
+
+	return 0;
+}
+
+/**
+* times the tracking loop with acquisition, image processing and ROI writes running on
+* their own threads.
+*
+* <code>pipeline_run</code> takes the same parameters and prints the same timing table
+* as <code>time_run</code>, so the two can be compared with timing_parser.py.  The
+* threshold and blob columns are measured on the processing thread, the grab columns on
+* the acquisition thread and the performance counter timestamp is taken once the ROI is
+* written.
+*
+* @param tseq the TrackingSequence specifying the active ROIs and their initial positions
+* in the image prior to tracking an object
+* @param num_imgs the number of images to acquire
+* @param t the threshold value to be used with <code>threshold_blob</code>
+* @param frame the frame time (e.g. length of time between images) in microseconds
+* @param exposure the exposure time (e.g. length of time the shutter is kept open) in
+* microseconds
+*
+* @note the stages are pinned to <code>ACQUIRE_CPU</code>, <code>PROCESS_CPU</code> and
+* <code>WRITE_CPU</code>, which means the machine needs at least four processors.
+*
+* @see time_run
+*/
+
+int pipeline_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double exposure)
+{
+#if ONLINE
+	int i, rc;
+	Pipeline p;
+	TimingInfo timer;
+	HANDLE stages[3];
+	TrackingWindow *cur;
+
+	if(tseq->seq_len < MIN_SEQ_LEN) {
+		printf("invalid sequence length...need at least %d windows\n", MIN_SEQ_LEN);
+		return EINVAL;
+	}
+
+	memset(&p, 0, sizeof(Pipeline));
+	cur = tseq->windows + tseq->seq[0];
+
+	memset(&timer, 0, sizeof(TimingInfo));
+	timer.num_imgs = num_imgs;
+	timer.roi_e = exposure;
+	timer.roi_f = frame;
+	timer.roi_w = cur->roi_w;
+	timer.roi_h = cur->roi_h;
+	timer.frame = (frame_info *) calloc(num_imgs, sizeof(FrameInfo));
+	if(timer.frame == NULL) {
+		return ENOMEM;
+	}
+	if(!QueryPerformanceFrequency(&timer.freq)) {
+		printf("main: no perfmance counter\n");
+		free(timer.frame);
+		return ENODEV;
+	}
+
+	rc = StartGrabbing(&p.fg, tseq, NULL);
+	if(rc != FG_OK) {
+		free(timer.frame);
+		return rc;
+	}
+
+	rc = StartRing(&p.ring, p.fg, tseq);
+	if(rc != FG_OK) {
+		deinit_cam(p.fg);
+		free(timer.frame);
+		return rc;
+	}
+
+	p.tseq = tseq;
+	p.timer = &timer;
+	p.t = t;
+
+	stages[0] = start_stage(acquire_stage, &p, ACQUIRE_CPU);
+	stages[1] = start_stage(process_stage, &p, PROCESS_CPU);
+	stages[2] = start_stage(write_stage, &p, WRITE_CPU);
+	if(stages[0] == NULL || stages[1] == NULL || stages[2] == NULL) {
+		for(i = 0; i < 3; i++) {
+			if(stages[i] != NULL) {
+				TerminateThread(stages[i], 0);
+				CloseHandle(stages[i]);
+			}
+		}
+		deinit_cam(p.fg);
+		free(timer.frame);
+		return ENOMEM;
+	}
+
+	QueryPerformanceCounter(&timer.loop_start);
+	for(i = 0; i < 3; i++) {
+		ResumeThread(stages[i]);
+	}
+	WaitForMultipleObjects(3, stages, TRUE, INFINITE);
+	QueryPerformanceCounter(&timer.loop_stop);
+
+	for(i = 0; i < 3; i++) {
+		CloseHandle(stages[i]);
+	}
+	release_written(&p);
+
+	bench_run(p.fg, &timer);
+#if BINARY_TRACE
+	WriteTimingTrace(p.fg, &timer);
+#else
+	PrintTimingData(p.fg, &timer);
+#endif
+
+	rc = deinit_cam(p.fg);
+	if(rc != FG_OK) {
+		printf("deinit: %s\n", Fg_getLastErrorDescription(p.fg));
+		free(timer.frame);
+		return rc;
+	}
+	free(timer.frame);
+
+	return p.failed ? !FG_OK : FG_OK;
+#else
+	// there is no frame grabber to overlap with when reading images from disk
+	return time_run(tseq, num_imgs, t, frame, exposure);
+#endif
+}
@@ -0,0 +1,360 @@
+/**
+* @file preview.cpp streams a low-rate preview of the tracking to a remote viewer.
+*
+* gui.cpp took the drawing off the tracking loop, but the window, its message loop and
+* the printing still run on the acquisition PC, and the operator has to stand at the rig
+* to see them.  With <code>PREVIEW</code> set the tools hand their images to
+* <code>preview_publish</code> instead, which keeps every PREVIEW_EVERY-th of them:
+* every PREVIEW_DECIMATE-th pixel of every PREVIEW_DECIMATE-th row and the ROI and blob
+* boxes are copied into a triple buffer, like the one of <code>gui_publish</code>, and
+* it returns.  A thread of the lowest priority takes the newest preview out of the triple
+* buffer, compresses it to a JPEG, or leaves the decimated pixels raw (see
+* <code>PREVIEW_FORMAT</code>), and sends it over UDP to <code>PREVIEW_HOST</code>.  No
+* window is opened on the acquisition PC at all.
+*
+* A preview is sent as datagrams of at most <code>PREVIEW_PART</code> bytes of the image
+* each, every one with a PreviewHeader in front.  The viewer puts the parts of a preview
+* back together by <code>frame</code> and <code>part</code>, draws the boxes of the
+* header over it and drops a preview that misses a part; the next one follows shortly.
+*/
+
+// winsock2.h has to come before windows.h
+#include <winsock2.h>
+#include "fcdynamic.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+#define PREVIEW_RAW 0
+#define PREVIEW_JPEG 1
+
+/**
+* how the pixels of a preview are sent, PREVIEW_RAW or PREVIEW_JPEG
+*/
+#define PREVIEW_FORMAT PREVIEW_JPEG
+#define PREVIEW_QUALITY 70
+
+#define PREVIEW_HOST "192.168.1.65"
+#define PREVIEW_UDP_PORT 3492
+
+/**
+* the image bytes of one datagram, so a part fits one ethernet frame
+*/
+#define PREVIEW_PART 1400
+
+#define PREVIEW_SYNC0 'H'
+#define PREVIEW_SYNC1 'P'
+
+/**
+* marks the middle slot of the triple buffer as holding a preview the thread has not
+* sent yet
+*/
+#define PREVIEW_FRESH 4
+
+/**
+* the roi of a preview of a full frame
+*/
+#define PREVIEW_NO_ROI 0xff
+
+/**
+* the longest the thread sleeps before looking at <code>running</code> again, in
+* milliseconds
+*/
+#define PREVIEW_WAIT 100
+
+#pragma pack(push, 1)
+
+/**
+* the header of every part of a preview as it is sent over the wire
+*
+* the boxes are given in the image reference frame, like the blob of a CommFrame, so the
+* viewer draws them over the pixels placed at [<code>x</code>, <code>y</code>] after
+* dividing both by <code>decimate</code>.
+*/
+
+struct preview_header {
+	unsigned char sync[2]; /**< always <code>PREVIEW_SYNC0</code>, <code>PREVIEW_SYNC1</code> */
+	unsigned char format; /**< PREVIEW_RAW or PREVIEW_JPEG */
+	unsigned char decimate;
+	unsigned char roi; /**< <code>PREVIEW_NO_ROI</code> for a full frame */
+	unsigned char calib; /**< 1 if the boxes should be drawn */
+	unsigned short frame; /**< counts the previews sent, the parts of one have the same */
+	unsigned short part;
+	unsigned short parts;
+	unsigned int img_nr;
+	unsigned int bytes; /**< of the whole image, raw or JPEG */
+	short x; /**< where the pixels were captured, in image pixels */
+	short y;
+	unsigned short w; /**< the size of the decimated pixels */
+	unsigned short h;
+	short roi_box[4]; /**< x, y, w and h of the ROI the blob is tracked in next */
+	short blob_box[4]; /**< xmin, ymin, xmax and ymax of the blob */
+};
+
+#pragma pack(pop)
+
+typedef struct preview_header PreviewHeader;
+
+struct preview_slot {
+	PreviewHeader head;
+	unsigned char *pixels; /**< the decimated pixels, <code>head.w</code> to a row */
+};
+
+typedef struct preview_slot PreviewSlot;
+
+static PreviewSlot slots[3];
+static volatile LONG middle = 0;
+static LONG back = 1;
+static LONG front = 2;
+
+static SOCKET sock = INVALID_SOCKET;
+static struct sockaddr_in dest;
+
+static HANDLE thread = NULL;
+static HANDLE wake = NULL;
+static volatile LONG running = FALSE;
+
+static int max_w = 0;
+static int max_h = 0;
+static unsigned int published = 0;
+static unsigned short frame = 0;
+static volatile LONG sent = 0;
+static volatile LONG failures = 0;
+
+static char packet[sizeof(PreviewHeader) + PREVIEW_PART];
+
+static void send_preview(PreviewSlot *s)
+{
+	int i, n, bytes;
+	const unsigned char *data;
+#if PREVIEW_FORMAT == PREVIEW_JPEG
+	CvMat img;
+	CvMat *jpeg;
+	int params[3] = {CV_IMWRITE_JPEG_QUALITY, PREVIEW_QUALITY, 0};
+
+	cvInitMatHeader(&img, s->head.h, s->head.w, CV_8UC1, s->pixels);
+	jpeg = cvEncodeImage(".jpg", &img, params);
+	if(jpeg == NULL) {
+		InterlockedIncrement(&failures);
+		return;
+	}
+	data = jpeg->data.ptr;
+	bytes = jpeg->rows * jpeg->cols;
+#else
+	data = s->pixels;
+	bytes = s->head.w * s->head.h;
+#endif
+
+	s->head.format = PREVIEW_FORMAT;
+	s->head.frame = frame++;
+	s->head.bytes = bytes;
+	s->head.parts = (unsigned short) ((bytes + PREVIEW_PART - 1) / PREVIEW_PART);
+
+	for(i = 0; i < s->head.parts; i++) {
+		n = min(PREVIEW_PART, bytes - i * PREVIEW_PART);
+		s->head.part = (unsigned short) i;
+		memcpy(packet, &s->head, sizeof(PreviewHeader));
+		memcpy(packet + sizeof(PreviewHeader), data + i * PREVIEW_PART, n);
+
+		// the rest of a preview that lost a part is of no use to the viewer
+		if(sendto(sock, packet, sizeof(PreviewHeader) + n, 0, (struct sockaddr *) &dest,
+			sizeof(dest)) != (int) sizeof(PreviewHeader) + n) {
+			InterlockedIncrement(&failures);
+			break;
+		}
+	}
+	if(i == s->head.parts) {
+		InterlockedIncrement(&sent);
+	}
+
+#if PREVIEW_FORMAT == PREVIEW_JPEG
+	cvReleaseMat(&jpeg);
+#endif
+}
+
+static DWORD WINAPI preview_thread(LPVOID param)
+{
+	while(running) {
+		WaitForSingleObject(wake, PREVIEW_WAIT);
+		if(!(middle & PREVIEW_FRESH)) {
+			continue;
+		}
+
+		front = InterlockedExchange(&middle, front) & ~PREVIEW_FRESH;
+		send_preview(slots + front);
+	}
+
+	return 0;
+}
+
+/**
+* opens the socket to <code>PREVIEW_HOST</code> and starts the thread that sends the
+* previews.
+*
+* @param img_w the width of the largest image that will be published
+* @param img_h the height of the largest image that will be published
+*
+* @return <code>FG_OK</code> on success, <code>ENOMEM</code> if the buffers or the thread
+* could not be had, <code>EIO</code> if the socket could not be opened
+*
+* @see preview_stop
+*/
+
+int preview_start(int img_w, int img_h)
+{
+	int i;
+	WSADATA wsa;
+
+	max_w = img_w / PREVIEW_DECIMATE;
+	max_h = img_h / PREVIEW_DECIMATE;
+
+	memset(slots, 0, sizeof(slots));
+	for(i = 0; i < 3; i++) {
+		slots[i].pixels = (unsigned char *) malloc(max_w * max_h);
+		if(slots[i].pixels == NULL) {
+			preview_stop();
+			return ENOMEM;
+		}
+	}
+	middle = 0;
+	back = 1;
+	front = 2;
+	published = 0;
+	frame = 0;
+	sent = 0;
+	failures = 0;
+
+	if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		preview_stop();
+		return EIO;
+	}
+	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if(sock == INVALID_SOCKET) {
+		WSACleanup();
+		preview_stop();
+		return EIO;
+	}
+	memset(&dest, 0, sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_port = htons(PREVIEW_UDP_PORT);
+	dest.sin_addr.s_addr = inet_addr(PREVIEW_HOST);
+
+	running = TRUE;
+	wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if(wake != NULL) {
+		thread = CreateThread(NULL, 0, preview_thread, NULL, 0, NULL);
+	}
+	if(thread == NULL) {
+		preview_stop();
+		return ENOMEM;
+	}
+
+	// the previews get what the tracking loop leaves of the CPU
+	SetThreadPriority(thread, THREAD_PRIORITY_LOWEST);
+
+	return FG_OK;
+}
+
+/**
+* hands the preview thread an image, of which it keeps every PREVIEW_EVERY-th.
+*
+* <code>preview_publish</code> copies the decimated pixels and the boxes of
+* <code>win</code> into the back slot of the triple buffer and swaps it with the middle
+* slot, so it never waits for the thread or the network.  Like <code>gui_publish</code>
+* it has to be called before the image is given back to the frame grabber.
+*
+* @param pixels the first pixel of the image or ROI
+* @param step the bytes from one row of <code>pixels</code> to the next
+* @param xoff the x coordinate the pixels were captured at
+* @param yoff the y coordinate the pixels were captured at
+* @param w the width of the pixels
+* @param h the height of the pixels
+* @param img_nr the image number, sent along with the preview
+* @param win the TrackingWindow after <code>position</code>, or NULL for a full frame
+* without boxes
+* @param calib the viewer should draw the ROI and blob boxes
+*/
+
+void preview_publish(const unsigned char *pixels, int step, int xoff, int yoff, int w, int h,
+	int img_nr, TrackingWindow *win, int calib)
+{
+	int i, j;
+	const unsigned char *src;
+	unsigned char *dst;
+	PreviewSlot *s = slots + back;
+
+	if(thread == NULL || pixels == NULL || published++ % PREVIEW_EVERY != 0) {
+		return;
+	}
+
+	w = min(w / PREVIEW_DECIMATE, max_w);
+	h = min(h / PREVIEW_DECIMATE, max_h);
+	if(w == 0 || h == 0) {
+		return;
+	}
+
+	for(i = 0; i < h; i++) {
+		src = pixels + i * PREVIEW_DECIMATE * step;
+		dst = s->pixels + i * w;
+		for(j = 0; j < w; j++) {
+			dst[j] = src[j * PREVIEW_DECIMATE];
+		}
+	}
+
+	memset(&s->head, 0, sizeof(PreviewHeader));
+	s->head.sync[0] = PREVIEW_SYNC0;
+	s->head.sync[1] = PREVIEW_SYNC1;
+	s->head.decimate = PREVIEW_DECIMATE;
+	s->head.roi = PREVIEW_NO_ROI;
+	s->head.calib = win != NULL && calib;
+	s->head.img_nr = img_nr;
+	s->head.x = (short) xoff;
+	s->head.y = (short) yoff;
+	s->head.w = (unsigned short) w;
+	s->head.h = (unsigned short) h;
+	if(win != NULL) {
+		s->head.roi = (unsigned char) win->roi;
+		s->head.roi_box[0] = (short) win->roi_xoff;
+		s->head.roi_box[1] = (short) win->roi_yoff;
+		s->head.roi_box[2] = (short) win->roi_w;
+		s->head.roi_box[3] = (short) win->roi_h;
+		s->head.blob_box[0] = (short) (win->roi_xoff + win->blob_xmin);
+		s->head.blob_box[1] = (short) (win->roi_yoff + win->blob_ymin);
+		s->head.blob_box[2] = (short) (win->roi_xoff + win->blob_xmax);
+		s->head.blob_box[3] = (short) (win->roi_yoff + win->blob_ymax);
+	}
+
+	back = InterlockedExchange(&middle, back | PREVIEW_FRESH) & ~PREVIEW_FRESH;
+	SetEvent(wake);
+}
+
+/**
+* stops the preview thread and closes the socket.
+*/
+
+void preview_stop()
+{
+	int i;
+
+	running = FALSE;
+	if(thread != NULL) {
+		SetEvent(wake);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+		thread = NULL;
+		printf("preview: %d previews sent, %d failed\n", sent, failures);
+	}
+	if(wake != NULL) {
+		CloseHandle(wake);
+		wake = NULL;
+	}
+	if(sock != INVALID_SOCKET) {
+		closesocket(sock);
+		sock = INVALID_SOCKET;
+		WSACleanup();
+	}
+
+	for(i = 0; i < 3; i++) {
+		free(slots[i].pixels);
+		slots[i].pixels = NULL;
+	}
+}
@@ -0,0 +1,432 @@
+/**
+* @file record.cpp streams the raw ROI images to disk at the full rate of the camera.
+*
+* <code>capture_video</code> in main.cpp encodes every image into an AVI and shows it on
+* screen, which limits it to about 50 fps.  <code>record_run</code> instead copies each
+* image out of the frame grabber buffers into a large staging ring and a background
+* thread writes the ring to a preallocated file with unbuffered, overlapped writes, so
+* the acquisition loop never waits on the disk.
+*
+* the file starts with one <code>RECORD_SECTOR</code> sized block holding a
+* record_file_header.  It is followed by one fixed size record per image: a
+* record_header, the roi_w x roi_h pixels of the ROI and padding up to the next sector.
+* All fields are little-endian and packed.
+*/
+
+#include "fcdynamic.h"
+
+#define RECORD_MAGIC "HSVR"
+#define RECORD_VERSION 1
+
+/**
+* the alignment unbuffered writes need, covers disks with 512 byte and 4 KB sectors
+*/
+#define RECORD_SECTOR 4096
+
+/**
+* the memory used for the staging ring, which decides how long the disk may stall
+*/
+#define RECORD_MEMORY (64 * 1024 * 1024)
+
+/**
+* the most records sent to the disk with one write and the number of writes in flight
+*/
+#define RECORD_BATCH 64
+#define RECORD_IO 2
+
+#define ALIGN(n, a) (((n) + (a) - 1) / (a) * (a))
+
+#pragma pack(push, 1)
+
+/**
+* the header in the first sector of a recording
+*/
+
+struct record_file_header {
+	char magic[4]; /**< always <code>RECORD_MAGIC</code> */
+	unsigned int version;
+	unsigned int header_size; /**< the offset of the first record */
+	unsigned int record_size; /**< the size of a record including its padding */
+	unsigned int num_imgs; /**< the number of records in the file */
+	unsigned int dropped; /**< images skipped because the staging ring was full */
+	unsigned int lost; /**< images overwritten in the frame grabber before they were copied */
+	__int64 freq; /**< the frequency of the performance counter */
+};
+
+/**
+* the start of each record, the pixels follow right after it
+*/
+
+struct record_header {
+	int img;
+	int roi;
+	int roi_x;
+	int roi_y;
+	int roi_w;
+	int roi_h;
+	int intact; /**< 0 if the grabber overwrote the image while it was being copied */
+	__int64 fg_ts;
+	__int64 pc_ts;
+};
+
+#pragma pack(pop)
+
+typedef struct record_file_header RecordFileHeader;
+typedef struct record_header RecordHeader;
+
+/**
+* the staging ring shared by the acquisition loop and the write thread
+*
+* only the acquisition loop writes <code>tail</code> and only the write thread writes
+* <code>head</code>.  A slot is free again once the write covering it has completed.
+*/
+
+struct recorder {
+	HANDLE file;
+	unsigned char *slots;
+	int slot_size;
+	int nslots;
+
+	volatile LONG head; /**< the oldest slot not yet on disk */
+	volatile LONG tail; /**< the next slot to fill */
+	volatile LONG done; /**< set once the last image is in the ring */
+	volatile LONG failed; /**< the error of a failed write */
+};
+
+typedef struct recorder Recorder;
+
+static DWORD WINAPI write_thread(LPVOID param)
+{
+	int i, k, busy, first, n;
+	int count[RECORD_IO];
+	LONG issued, tail;
+	DWORD bytes;
+	__int64 offset;
+	OVERLAPPED ov[RECORD_IO];
+	Recorder *r = (Recorder *) param;
+
+	memset(ov, 0, sizeof(ov));
+	for(i = 0; i < RECORD_IO; i++) {
+		ov[i].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	}
+
+	i = 0;
+	busy = 0;
+	issued = 0;
+	offset = RECORD_SECTOR;
+
+	while(!r->failed) {
+		tail = r->tail;
+		MemoryBarrier();
+
+		// queue the filled slots, but only as far as the end of the slot memory
+		if(busy < RECORD_IO && issued != tail) {
+			k = (i + busy) % RECORD_IO;
+			first = issued % r->nslots;
+			n = tail - issued;
+			if(n > r->nslots - first) {
+				n = r->nslots - first;
+			}
+			if(n > RECORD_BATCH) {
+				n = RECORD_BATCH;
+			}
+
+			ov[k].Offset = (DWORD) offset;
+			ov[k].OffsetHigh = (DWORD) (offset >> 32);
+			if(!WriteFile(r->file, r->slots + first * r->slot_size, n * r->slot_size, NULL,
+				ov + k) && GetLastError() != ERROR_IO_PENDING) {
+				InterlockedExchange(&r->failed, GetLastError());
+				break;
+			}
+
+			count[k] = n;
+			issued += n;
+			offset += (__int64) n * r->slot_size;
+			busy++;
+			continue;
+		}
+
+		// the slots of the oldest write are free once it is on disk
+		if(busy > 0) {
+			if(!GetOverlappedResult(r->file, ov + i, &bytes, TRUE)) {
+				InterlockedExchange(&r->failed, GetLastError());
+				break;
+			}
+			InterlockedExchangeAdd(&r->head, count[i]);
+			i = (i + 1) % RECORD_IO;
+			busy--;
+			continue;
+		}
+
+		if(r->done && r->tail == issued) {
+			break;
+		}
+		SwitchToThread();
+	}
+
+	// let the writes still in flight finish before the slots are freed
+	for(; busy > 0; busy--, i = (i + 1) % RECORD_IO) {
+		GetOverlappedResult(r->file, ov + i, &bytes, TRUE);
+	}
+	for(i = 0; i < RECORD_IO; i++) {
+		CloseHandle(ov[i].hEvent);
+	}
+
+	return 0;
+}
+
+static int write_header(Recorder *r, RecordFileHeader *hdr)
+{
+	int rc = FG_OK;
+	DWORD bytes;
+	OVERLAPPED ov;
+	unsigned char *sector;
+
+	// unbuffered writes need an aligned buffer
+	sector = (unsigned char *) VirtualAlloc(NULL, RECORD_SECTOR, MEM_COMMIT, PAGE_READWRITE);
+	if(sector == NULL) {
+		return ENOMEM;
+	}
+	memcpy(sector, hdr, sizeof(RecordFileHeader));
+
+	memset(&ov, 0, sizeof(ov));
+	ov.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if((!WriteFile(r->file, sector, RECORD_SECTOR, NULL, &ov) &&
+		GetLastError() != ERROR_IO_PENDING) ||
+		!GetOverlappedResult(r->file, &ov, &bytes, TRUE)) {
+		rc = GetLastError();
+	}
+
+	CloseHandle(ov.hEvent);
+	VirtualFree(sector, 0, MEM_RELEASE);
+
+	return rc;
+}
+
+static int set_file_size(HANDLE file, __int64 size)
+{
+	LARGE_INTEGER pos;
+
+	pos.QuadPart = size;
+	if(!SetFilePointerEx(file, pos, NULL, FILE_BEGIN) || !SetEndOfFile(file)) {
+		return GetLastError();
+	}
+
+	return FG_OK;
+}
+
+/**
+* records <code>num_imgs</code> raw images of the ROIs in <code>tseq</code> to a file.
+*
+* <code>record_run</code> sizes each record for the largest ROI in the sequence,
+* preallocates the whole file and then copies every image the frame grabber completes
+* into the staging ring, along with its ROI position, image number and timestamps.
+* Images are only skipped if the disk falls so far behind that the staging ring fills
+* up, and those are counted in the file header.
+*
+* @param tseq the TrackingSequence specifying the ROIs to record
+* @param num_imgs the number of images to record
+* @param name the name of the file to record to
+* @param display show every <code>display</code>-th image on screen, 0 to not show any.
+* Showing an image takes a few milliseconds, so it should be rare enough for the frame
+* grabber buffers to cover it.
+*
+* @return <code>FG_OK</code> if every image was recorded, otherwise an error from the
+* frame grabber or the file system
+*/
+
+int record_run(TrackingSequence *tseq, int num_imgs, char *name, int display)
+{
+	int i, rc, size, total_imgs, dropped;
+	unsigned char *slot;
+	HANDLE writer;
+	Fg_Struct *fg = NULL;
+	FrameRing ring;
+	FrameView view;
+	Recorder r;
+	RecordHeader *rec;
+	RecordFileHeader hdr;
+	TrackingWindow *win;
+	LARGE_INTEGER freq, pc_ts;
+	IplImage cvDisplay;
+
+	memset(&r, 0, sizeof(Recorder));
+	QueryPerformanceFrequency(&freq);
+
+	// every record has room for the largest ROI in the sequence
+	size = 0;
+	for(i = 0; i < tseq->seq_len; i++) {
+		win = tseq->windows + tseq->seq[i];
+		if(size < win->roi_w * win->roi_h) {
+			size = win->roi_w * win->roi_h;
+		}
+	}
+	r.slot_size = ALIGN(sizeof(RecordHeader) + size, RECORD_SECTOR);
+	r.nslots = RECORD_MEMORY / r.slot_size;
+	if(r.nslots < 2 * RECORD_BATCH) {
+		r.nslots = 2 * RECORD_BATCH;
+	}
+
+	r.slots = (unsigned char *) VirtualAlloc(NULL, (SIZE_T) r.nslots * r.slot_size,
+		MEM_COMMIT, PAGE_READWRITE);
+	if(r.slots == NULL) {
+		printf("record: not enough memory for %d records\n", r.nslots);
+		return ENOMEM;
+	}
+
+	r.file = CreateFileA(name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, NULL);
+	if(r.file == INVALID_HANDLE_VALUE) {
+		printf("record: could not create %s\n", name);
+		VirtualFree(r.slots, 0, MEM_RELEASE);
+		return GetLastError();
+	}
+
+	// allocate the file up front so the writes do not have to extend it
+	rc = set_file_size(r.file, RECORD_SECTOR + (__int64) num_imgs * r.slot_size);
+	if(rc != FG_OK) {
+		printf("record: could not allocate %s\n", name);
+		CloseHandle(r.file);
+		VirtualFree(r.slots, 0, MEM_RELEASE);
+		return rc;
+	}
+
+	rc = StartGrabbing(&fg, tseq, NULL);
+	if(rc == FG_OK) {
+		rc = StartRing(&ring, fg, tseq);
+		if(rc != FG_OK) {
+			deinit_cam(fg);
+		}
+		// a recording keeps every image, however far behind the disk is
+		ring.latest = FALSE;
+	}
+	if(rc != FG_OK) {
+		CloseHandle(r.file);
+		VirtualFree(r.slots, 0, MEM_RELEASE);
+		return rc;
+	}
+
+	writer = CreateThread(NULL, 0, write_thread, &r, 0, NULL);
+	if(writer == NULL) {
+		printf("record: could not create the write thread\n");
+		deinit_cam(fg);
+		CloseHandle(r.file);
+		VirtualFree(r.slots, 0, MEM_RELEASE);
+		return ENOMEM;
+	}
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+	if(display > 0) {
+#if PREVIEW
+		win = tseq->windows + tseq->seq[0];
+		if(preview_start(win->img_w, win->img_h) != FG_OK) {
+			printf("record: could not start the preview\n");
+		}
+#else
+		cvNamedWindow("record", CV_WINDOW_AUTOSIZE);
+#endif
+	}
+
+	total_imgs = 0;
+	dropped = 0;
+	while(total_imgs + dropped < num_imgs && !r.failed) {
+		rc = ring_next(&ring, &view, TIMEOUT);
+		if(rc != FG_OK) {
+			printf("img is null: %d\n", view.img);
+			break;
+		}
+		QueryPerformanceCounter(&pc_ts);
+
+		if(r.tail - r.head == r.nslots) {
+			// the disk fell behind, skipping is better than stalling the grabber
+			dropped++;
+			ring_release(&ring, &view);
+			continue;
+		}
+
+		win = tseq->windows + view.roi;
+		slot = r.slots + (r.tail % r.nslots) * r.slot_size;
+		rec = (RecordHeader *) slot;
+		rec->img = view.img;
+		rec->roi = view.roi;
+		rec->roi_x = win->roi_xoff;
+		rec->roi_y = win->roi_yoff;
+		rec->roi_w = win->roi_w;
+		rec->roi_h = win->roi_h;
+		rec->fg_ts = view.fg_ts;
+		rec->pc_ts = pc_ts.QuadPart;
+		memcpy(slot + sizeof(RecordHeader), view.data, win->roi_w * win->roi_h);
+		rec->intact = ring_release(&ring, &view) == FG_OK;
+
+		MemoryBarrier();
+		r.tail++;
+		total_imgs++;
+
+#if PREVIEW
+		// the preview keeps every PREVIEW_EVERY-th image on its own
+		if(display > 0) {
+			preview_publish(slot + sizeof(RecordHeader), win->roi_w, rec->roi_x, rec->roi_y,
+				win->roi_w, win->roi_h, view.img, win, FALSE);
+		}
+#else
+		if(display > 0 && total_imgs % display == 0) {
+			cvInitImageHeader(&cvDisplay, cvSize(win->roi_w, win->roi_h), 8, 1);
+			cvDisplay.imageData = (char *) slot + sizeof(RecordHeader);
+			cvShowImage("record", &cvDisplay);
+			cvWaitKey(1);
+		}
+#endif
+	}
+
+	InterlockedExchange(&r.done, TRUE);
+	WaitForSingleObject(writer, INFINITE);
+	CloseHandle(writer);
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+
+	if(display > 0) {
+#if PREVIEW
+		preview_stop();
+#else
+		cvDestroyWindow("record");
+#endif
+	}
+
+	memset(&hdr, 0, sizeof(RecordFileHeader));
+	memcpy(hdr.magic, RECORD_MAGIC, sizeof(hdr.magic));
+	hdr.version = RECORD_VERSION;
+	hdr.header_size = RECORD_SECTOR;
+	hdr.record_size = r.slot_size;
+	hdr.num_imgs = r.failed ? r.head : total_imgs;
+	hdr.dropped = dropped;
+	hdr.lost = ring.lost;
+	hdr.freq = freq.QuadPart;
+
+	printf("recorded %d images to %s, %d dropped, %d lost\n", hdr.num_imgs, name, dropped,
+		ring.lost);
+	if(r.failed) {
+		printf("record: write failed (%d)\n", r.failed);
+	}
+
+	// the header is written last, so a recording that did not finish has no magic
+	i = write_header(&r, &hdr);
+	if(i == FG_OK) {
+		i = set_file_size(r.file, RECORD_SECTOR + (__int64) hdr.num_imgs * r.slot_size);
+	}
+	CloseHandle(r.file);
+	VirtualFree(r.slots, 0, MEM_RELEASE);
+
+	rc = deinit_cam(fg);
+	if(rc != FG_OK) {
+		printf("deinit: %s\n", Fg_getLastErrorDescription(fg));
+		return rc;
+	}
+
+	if(r.failed) {
+		return r.failed;
+	}
+	if(i != FG_OK) {
+		return i;
+	}
+
+	return (dropped == 0 && total_imgs == num_imgs) ? FG_OK : !FG_OK;
+}
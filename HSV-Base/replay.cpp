@@ -0,0 +1,294 @@
+/**
+* @file replay.cpp a stand-in for the camera that replays images held in memory.
+*
+* reading images from disk with <code>GetNextImage</code> decodes a JPEG and copies it
+* pixel by pixel on every frame, so offline timing runs mostly measure the JPEG decoder.
+* The replay source decodes the whole sequence (or reads a raw capture) once into one
+* contiguous arena and afterwards hands out images the way a FrameRing does: in order,
+* tagged with the ROI of the sequence that captured them and with a timestamp.
+*
+* the camera only sends the pixels inside the active ROI, so <code>replay_next</code>
+* copies the ROI rows out of the full image into a buffer owned by the replay.  That copy
+* stands in for the DMA transfer from the frame grabber and is the only work done per
+* image besides keeping time.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the full sized images, one after the other
+*/
+static unsigned char *arena = NULL;
+static int arena_w = 0;
+static int arena_h = 0;
+static int frames = 0;
+
+/**
+* holds the ROI of the last image handed out
+*/
+static unsigned char *roi_buf = NULL;
+
+static TrackingSequence *replay_seq = NULL;
+static int next = 1;
+static double frame_time = 0;
+static LARGE_INTEGER start;
+static LARGE_INTEGER freq;
+
+static int replay_alloc(int w, int h, int n)
+{
+	replay_free();
+
+	arena = (unsigned char *) malloc((size_t) w * h * n);
+	roi_buf = (unsigned char *) malloc((size_t) w * h);
+	if(arena == NULL || roi_buf == NULL) {
+		printf("replay: not enough memory for %d %dx%d images\n", n, w, h);
+		replay_free();
+		return ENOMEM;
+	}
+
+	arena_w = w;
+	arena_h = h;
+	frames = n;
+
+	return FG_OK;
+}
+
+/**
+* decodes a sequence of jpeg images into memory.
+*
+* the images must be named <code>name</code>x.jpg with x running from 1 to
+* <code>len</code>, like the sequence read by <code>GetNextImage</code>, and must all
+* have the same size.
+*
+* @param name the base name of the jpeg files
+* @param len the number of images in the sequence
+*
+* @return <code>FG_OK</code> on success, <code>ENOENT</code> if an image could not be
+* loaded, <code>EINVAL</code> if the images are not all the same size or
+* <code>ENOMEM</code> if the arena could not be allocated
+*/
+
+int replay_load(char *name, int len)
+{
+	int i, j, rc;
+	char file[FILENAME_MAX];
+	IplImage *img = NULL;
+
+	for(i = 0; i < len; i++) {
+		sprintf_s(file, sizeof(file), "%s%d.jpg", name, i + 1);
+		img = cvLoadImage(file, CV_LOAD_IMAGE_GRAYSCALE);
+		if(img == NULL) {
+			printf("replay: could not load %s\n", file);
+			replay_free();
+			return ENOENT;
+		}
+
+		if(i == 0) {
+			rc = replay_alloc(img->width, img->height, len);
+			if(rc != FG_OK) {
+				cvReleaseImage(&img);
+				return rc;
+			}
+		}
+		else if(img->width != arena_w || img->height != arena_h) {
+			printf("replay: %s is not %dx%d\n", file, arena_w, arena_h);
+			cvReleaseImage(&img);
+			replay_free();
+			return EINVAL;
+		}
+
+		// the rows of an IplImage may be padded
+		for(j = 0; j < arena_h; j++) {
+			memcpy(arena + ((size_t) i * arena_h + j) * arena_w,
+				img->imageData + j * img->widthStep, arena_w);
+		}
+
+		cvReleaseImage(&img);
+	}
+
+	return FG_OK;
+}
+
+/**
+* reads a raw capture of full sized 8-bit images into memory.
+*
+* the file holds nothing but <code>w</code> x <code>h</code> images back to back, the
+* number of images is taken from the size of the file.
+*
+* @param name the name of the raw file
+* @param w the width of the images
+* @param h the height of the images
+*
+* @return <code>FG_OK</code> on success, <code>ENOENT</code> if the file could not be
+* read, <code>EINVAL</code> if it does not hold a whole image or <code>ENOMEM</code>
+* if the arena could not be allocated
+*/
+
+int replay_load_raw(char *name, int w, int h)
+{
+	int rc, n;
+	__int64 size;
+	FILE *fp = NULL;
+
+	if(fopen_s(&fp, name, "rb") != 0) {
+		printf("replay: could not open %s\n", name);
+		return ENOENT;
+	}
+
+	_fseeki64(fp, 0, SEEK_END);
+	size = _ftelli64(fp);
+	_fseeki64(fp, 0, SEEK_SET);
+
+	n = (int) (size / ((__int64) w * h));
+	if(n <= 0) {
+		printf("replay: %s does not hold a %dx%d image\n", name, w, h);
+		fclose(fp);
+		return EINVAL;
+	}
+
+	rc = replay_alloc(w, h, n);
+	if(rc != FG_OK) {
+		fclose(fp);
+		return rc;
+	}
+
+	if(fread(arena, (size_t) w * h, n, fp) != (size_t) n) {
+		printf("replay: could not read %s\n", name);
+		fclose(fp);
+		replay_free();
+		return ENOENT;
+	}
+
+	fclose(fp);
+	return FG_OK;
+}
+
+/**
+* returns the size of the images loaded by <code>replay_load</code> or
+* <code>replay_load_raw</code>.
+*
+* @return <code>FG_OK</code> if images are loaded, otherwise <code>ENODEV</code>
+*/
+
+int replay_size(int *w, int *h)
+{
+	if(arena == NULL) {
+		return ENODEV;
+	}
+
+	*w = arena_w;
+	*h = arena_h;
+
+	return FG_OK;
+}
+
+/**
+* starts handing out images from the first one loaded.
+*
+* @param tseq the sequence in which the ROI are active, used to tag each image with the
+* ROI that captured it and to cut the ROI out of the image
+* @param frame the simulated frame time in microseconds, or a value <= 0 to hand out the
+* images as fast as they are asked for with the image number as timestamp
+*
+* @return <code>FG_OK</code> on success, <code>ENODEV</code> if no images are loaded
+*/
+
+int replay_start(TrackingSequence *tseq, double frame)
+{
+	if(arena == NULL) {
+		printf("replay: no images loaded\n");
+		return ENODEV;
+	}
+
+	replay_seq = tseq;
+	next = 1;
+	frame_time = frame;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&start);
+
+	return FG_OK;
+}
+
+/**
+* hands out the next image, like <code>ring_next</code> does for the frame grabber.
+*
+* the images are replayed forward and then backward, so the object keeps moving
+* smoothly when the sequence wraps around.  Image number n has the timestamp n x the
+* frame time in microseconds.  If <code>REPLAY_PACE</code> is set,
+* <code>replay_next</code> also waits for that time to pass since
+* <code>replay_start</code>, like waiting on a camera would.
+*
+* @param view updated with the image number, ROI index, timestamp and a pointer to the
+* ROI pixels, which stay valid until the next call
+*
+* @return <code>FG_OK</code> if <code>view</code> holds a new image, otherwise
+* <code>ENODEV</code> and <code>view->data</code> is NULL
+*/
+
+int replay_next(FrameView *view)
+{
+	int i, f, period, x, y, w, h;
+	unsigned char *src;
+	TrackingWindow *win;
+#if REPLAY_PACE
+	LARGE_INTEGER now;
+#endif
+
+	if(arena == NULL || replay_seq == NULL) {
+		view->img = -ENODEV;
+		view->data = NULL;
+		return ENODEV;
+	}
+
+	view->img = next++;
+	view->roi = replay_seq->seq[(view->img - 1) % replay_seq->seq_len];
+
+	// the simulated images are stamped at the end of their exposure, like the grabber's
+	win = replay_seq->windows + view->roi;
+	if(frame_time > 0) {
+		view->fg_ts = (__int64) (view->img * frame_time);
+		view->exp_us = start.QuadPart * 1e6 / freq.QuadPart + view->fg_ts -
+			win->exposure / 2;
+#if REPLAY_PACE
+		do {
+			QueryPerformanceCounter(&now);
+		} while((now.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart < view->fg_ts);
+#endif
+	}
+	else {
+		view->fg_ts = view->img;
+		view->exp_us = 0;
+	}
+
+	// forward then backward through the frames
+	period = frames > 1 ? 2 * frames : 1;
+	f = (view->img - 1) % period;
+	if(f >= frames) {
+		f = period - 1 - f;
+	}
+
+	// the ROI the frame grabber would have taken, which is larger when ROIs are merged
+	merge_rect(replay_seq, view->roi, &x, &y, &w, &h);
+	src = arena + ((size_t) f * arena_h + y) * arena_w + x;
+	for(i = 0; i < h; i++) {
+		memcpy(roi_buf + i * w, src + (size_t) i * arena_w, w);
+	}
+	view->data = roi_buf;
+
+	return FG_OK;
+}
+
+/**
+* frees the images loaded by <code>replay_load</code> or <code>replay_load_raw</code>.
+*/
+
+void replay_free()
+{
+	free(arena);
+	free(roi_buf);
+	arena = NULL;
+	roi_buf = NULL;
+	arena_w = 0;
+	arena_h = 0;
+	frames = 0;
+}
@@ -0,0 +1,346 @@
+/**
+* @file rigid.cpp predicts the markers of one rigid object from the pose of the object.
+*
+* a TrackingWindow follows its marker with a constant velocity model of its own, see
+* <code>predict_motion</code>, and its ROI has to be large enough for the model to be
+* off by the motion of the marker until it has settled.  The markers of one object do
+* not move on their own, though: <code>SampleLoopTask</code> takes the orientation of
+* the object from the centroids of two ROIs on it.  A RigidBody links the windows of
+* such markers.  It learns where every marker sits on the body the first time all of
+* them have been seen, and from then on estimates the pose of the body, its position
+* and angle, from the last position of every marker with an alpha-beta filter like the
+* one of <code>predict_motion</code>.  The ROI of every linked window is centered on
+* where the pose puts its marker the next time the ROI is active.
+*
+* the markers are measured in images taken at different times, so before the pose is
+* fitted every marker is moved to the time of the newest one with the velocity the
+* pose gives its point of the body.  The fit is the least squares rotation of the body
+* onto the markers about their centroid.  The root mean square distance of the markers
+* to the fitted body is the error of the model, and with ADAPT_ROI set
+* <code>adapt_roi</code> sizes a linked ROI to its marker plus RIGID_SIGMA times that
+* error and RIGID_MARGIN, instead of the motion of the marker and ADAPT_MARGIN, so the
+* ROIs of a rigid object shrink to about the size of their markers.
+*
+* the windows of a body may run in different threads, see window_run.cpp, so the body
+* is kept under a lock.  A window that lost its object is left out of the fit until it
+* finds it again, a body with less than two markers only extrapolates its pose.
+*/
+
+#include "fcdynamic.h"
+#include <math.h>
+
+/**
+* the marker of a window in a body, -1 if the window is not linked to it
+*/
+static int marker_of(RigidBody *b, TrackingWindow *win)
+{
+	int k;
+
+	for(k = 0; k < b->count; k++) {
+		if(b->wins[k] == win) {
+			return k;
+		}
+	}
+
+	return -1;
+}
+
+/**
+* links the windows of a list of ROIs into one rigid object.
+*
+* @param b the RigidBody to set up
+* @param win the windows of the sequence, indexed by their ROI
+* @param link the ROIs of the markers, separated by commas or blanks, like "0, 5"
+*
+* @return <code>FG_OK</code>, or <code>EINVAL</code> if there are less than two different
+* ROIs in <code>link</code> or one is not a ROI
+*/
+
+int rigid_init(RigidBody *b, TrackingWindow *win, const char *link)
+{
+	int k, n, roi, rois[MAX_ROI];
+	const char *s;
+	char *end;
+
+	n = 0;
+	s = link;
+	while(*s != '\0') {
+		while(*s == ' ' || *s == '\t' || *s == ',') {
+			s++;
+		}
+		if(*s == '\0') {
+			break;
+		}
+		roi = (int) strtol(s, &end, 10);
+		if(end == s || roi < 0 || roi >= MAX_ROI) {
+			printf("rigid: %s is no list of rois\n", link);
+			return EINVAL;
+		}
+		for(k = 0; k < n && rois[k] != roi; k++);
+		if(k == n) {
+			rois[n++] = roi;
+		}
+		s = end;
+	}
+	if(n < 2) {
+		printf("rigid: a body needs two rois, %s has %d\n", link, n);
+		return EINVAL;
+	}
+
+	rigid_free(b);
+	InitializeCriticalSection(&b->lock);
+	b->count = n;
+	for(k = 0; k < n; k++) {
+		b->wins[k] = win + rois[k];
+		win[rois[k]].body = b;
+	}
+
+	return FG_OK;
+}
+
+/**
+* unlinks the windows of a RigidBody
+*/
+
+void rigid_free(RigidBody *b)
+{
+	int k;
+
+	if(b->count > 0) {
+		for(k = 0; k < b->count; k++) {
+			b->wins[k]->body = NULL;
+		}
+		DeleteCriticalSection(&b->lock);
+	}
+	memset(b, 0, sizeof(RigidBody));
+}
+
+/**
+* the point of marker k on the body at a pose
+*/
+static void body_point(RigidBody *b, int k, double x, double y, double theta, double *px,
+	double *py)
+{
+	double c = cos(theta), s = sin(theta);
+
+	*px = x + c * b->bx[k] - s * b->by[k];
+	*py = y + s * b->bx[k] + c * b->by[k];
+}
+
+/**
+* fits the body to the markers moved to time <code>ts</code>
+*
+* @return the number of markers in the fit, the pose is only set with two or more
+*/
+static int fit_pose(RigidBody *b, __int64 ts, double *x, double *y, double *theta,
+	double *err)
+{
+	int k, n;
+	double c, s, dt, mx[MAX_ROI], my[MAX_ROI], cx, cy, sx, sy, sxy, syx, sxx, syy, d;
+	double rx, ry, px, py;
+
+	c = cos(b->theta);
+	s = sin(b->theta);
+	n = 0;
+	cx = 0;
+	cy = 0;
+	for(k = 0; k < b->count; k++) {
+		if(b->wins[k]->lost != RECOVER_NONE) {
+			mx[k] = my[k] = 0;
+			continue;
+		}
+		// a point of the body moves with the body and around its center
+		rx = c * b->bx[k] - s * b->by[k];
+		ry = s * b->bx[k] + c * b->by[k];
+		dt = (double) (ts - b->mts[k]);
+		mx[k] = b->mx[k] + (b->vx - b->omega * ry) * dt;
+		my[k] = b->my[k] + (b->vy + b->omega * rx) * dt;
+		cx += mx[k];
+		cy += my[k];
+		n++;
+	}
+	if(n < 2) {
+		return n;
+	}
+	cx /= n;
+	cy /= n;
+
+	// the rotation that takes the centered body onto the centered markers
+	sx = 0;
+	sy = 0;
+	for(k = 0; k < b->count; k++) {
+		if(b->wins[k]->lost == RECOVER_NONE) {
+			sx += b->bx[k];
+			sy += b->by[k];
+		}
+	}
+	sx /= n;
+	sy /= n;
+	sxx = sxy = syx = syy = 0;
+	for(k = 0; k < b->count; k++) {
+		if(b->wins[k]->lost != RECOVER_NONE) {
+			continue;
+		}
+		sxx += (b->bx[k] - sx) * (mx[k] - cx);
+		sxy += (b->bx[k] - sx) * (my[k] - cy);
+		syx += (b->by[k] - sy) * (mx[k] - cx);
+		syy += (b->by[k] - sy) * (my[k] - cy);
+	}
+	*theta = atan2(sxy - syx, sxx + syy);
+
+	// the body center is where the centroid of the markers in the fit puts it
+	c = cos(*theta);
+	s = sin(*theta);
+	*x = cx - (c * sx - s * sy);
+	*y = cy - (s * sx + c * sy);
+
+	d = 0;
+	for(k = 0; k < b->count; k++) {
+		if(b->wins[k]->lost == RECOVER_NONE) {
+			body_point(b, k, *x, *y, *theta, &px, &py);
+			d += (px - mx[k]) * (px - mx[k]) + (py - my[k]) * (py - my[k]);
+		}
+	}
+	*err = sqrt(d / n);
+
+	return n;
+}
+
+/**
+* updates the pose of the body of a window with the marker measured in its image and
+* predicts how far the marker moves before the ROI being written is active.
+*
+* the marker is predicted one period of its window ahead, the time since its last
+* measurement, like <code>predict_motion</code> does.
+*
+* @param win the TrackingWindow of the marker, linked to a RigidBody
+* @param x the measured x coordinate of the marker in the image reference frame
+* @param y the measured y coordinate of the marker in the image reference frame
+* @param lead_x set to how far the marker is expected to move in x
+* @param lead_y set to how far the marker is expected to move in y
+*
+* @return TRUE if the pose gave the lead, FALSE while the body has not seen every
+* marker yet, then the lead is 0
+*
+* @note like the lead of <code>predict_motion</code> the lead is limited to half of the
+* ROI.
+*/
+
+int rigid_predict(TrackingWindow *win, int x, int y, int *lead_x, int *lead_y)
+{
+	int k, n;
+	double dt, period, px, py, theta, fx, fy, ftheta, err, rx, ry, rtheta;
+	RigidBody *b = win->body;
+
+	*lead_x = 0;
+	*lead_y = 0;
+
+	EnterCriticalSection(&b->lock);
+
+	k = marker_of(b, win);
+	period = 0;
+	if((b->seen & (1 << k)) && win->ts > b->mts[k]) {
+		period = (double) (win->ts - b->mts[k]);
+	}
+	b->mx[k] = x;
+	b->my[k] = y;
+	b->mts[k] = win->ts;
+	b->seen |= 1 << k;
+
+	// the body is what the markers look like the first time they have all been seen
+	if(!b->valid) {
+		if(b->seen != (1 << b->count) - 1) {
+			LeaveCriticalSection(&b->lock);
+			return FALSE;
+		}
+		b->x = 0;
+		b->y = 0;
+		for(k = 0; k < b->count; k++) {
+			b->x += b->mx[k] / b->count;
+			b->y += b->my[k] / b->count;
+		}
+		for(k = 0; k < b->count; k++) {
+			b->bx[k] = b->mx[k] - b->x;
+			b->by[k] = b->my[k] - b->y;
+		}
+		b->theta = 0;
+		b->vx = 0;
+		b->vy = 0;
+		b->omega = 0;
+		b->err = 0;
+		b->ts = win->ts;
+		b->valid = TRUE;
+		LeaveCriticalSection(&b->lock);
+		return FALSE;
+	}
+
+	// predict the pose to the time of the measurement and correct it with the fit
+	dt = (double) (win->ts - b->ts);
+	if(dt > 0) {
+		b->x += b->vx * dt;
+		b->y += b->vy * dt;
+		b->theta += b->omega * dt;
+		b->ts = win->ts;
+	}
+	n = fit_pose(b, b->ts, &fx, &fy, &ftheta, &err);
+	if(n >= 2) {
+		rx = fx - b->x;
+		ry = fy - b->y;
+		rtheta = atan2(sin(ftheta - b->theta), cos(ftheta - b->theta));
+		b->x += PREDICT_ALPHA * rx;
+		b->y += PREDICT_ALPHA * ry;
+		b->theta += PREDICT_ALPHA * rtheta;
+		if(dt > 0) {
+			b->vx += PREDICT_BETA * rx / dt;
+			b->vy += PREDICT_BETA * ry / dt;
+			b->omega += PREDICT_BETA * rtheta / dt;
+		}
+		b->err += (err - b->err) / RIGID_SMOOTH;
+	}
+
+	theta = b->theta + b->omega * period;
+	body_point(b, marker_of(b, win), b->x + b->vx * period, b->y + b->vy * period, theta,
+		&px, &py);
+
+	LeaveCriticalSection(&b->lock);
+
+	*lead_x = cvRound(px) - x;
+	*lead_y = cvRound(py) - y;
+
+	if(*lead_x > win->roi_w / 2) {
+		*lead_x = win->roi_w / 2;
+	}
+	if(*lead_x < -win->roi_w / 2) {
+		*lead_x = -win->roi_w / 2;
+	}
+	if(*lead_y > win->roi_h / 2) {
+		*lead_y = win->roi_h / 2;
+	}
+	if(*lead_y < -win->roi_h / 2) {
+		*lead_y = -win->roi_h / 2;
+	}
+
+	return TRUE;
+}
+
+/**
+* the pixels the pose of the body of a window may be off at its marker
+*
+* @param win a TrackingWindow linked to a RigidBody
+* @param margin set to RIGID_SIGMA times the error of the model plus RIGID_MARGIN
+*
+* @return TRUE if the body has a pose, FALSE before it has seen every marker
+*/
+
+int rigid_margin(TrackingWindow *win, int *margin)
+{
+	int valid;
+	RigidBody *b = win->body;
+
+	EnterCriticalSection(&b->lock);
+	valid = b->valid;
+	*margin = (int) ceil(RIGID_SIGMA * b->err) + RIGID_MARGIN;
+	LeaveCriticalSection(&b->lock);
+
+	return valid;
+}
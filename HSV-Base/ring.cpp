@@ -0,0 +1,330 @@
+/**
+* @file ring.cpp a zero-copy view of the frame grabber's DMA buffers.
+*
+* the frame grabber writes image number n into buffer (n - 1) % buffers of the memory
+* allocated by <code>init_cam</code>.  Instead of asking for one particular image number
+* and then looking up its pointer, a FrameRing hands out every completed image in order
+* as a FrameView that points straight into that memory.  The consumer gives the buffer
+* back with <code>ring_release</code> once it is done with the pixels.
+*
+* the grabber keeps acquiring into its buffers no matter what the consumer is doing, so
+* a release does not hold a buffer back from the grabber.  What the ring does is keep
+* count of how many buffers are between the grabber and the consumer, so it can tell
+* when an image was overwritten before (or while) the consumer looked at it.
+*
+* the ROI of an image is the one in its FG_IMAGE_TAG, see <code>ROI_TAG</code>, not the
+* one the sequence has at its image number: a frame the camera took but the grabber
+* never received moves every later image one ROI along the sequence, and with the tag
+* that costs the one image instead of every window for the rest of the run.  The
+* sequence position a tag was found at is kept, so an image without a tag is placed
+* after the last one that had one.
+*
+* with <code>latest</code> set a loop that falls behind does not work through the
+* backlog: of the completed images only the newest one of every ROI is handed out and
+* the older ones are counted in <code>skipped</code>, so the results of the loop are
+* never more than a sequence behind the camera.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* sets up a FrameRing over the memory returned by <code>get_mem</code>.
+*
+* @param ring the FrameRing to initialize
+* @param fg an initialized and acquiring Fg_Struct object defined in the Silicon Software
+* API
+* @param tseq the sequence in which the ROI are active, used to tag each image with the
+* ROI that captured it
+* @param buffers the number of buffers passed to <code>init_cam</code>
+* @param buf_size the size of one buffer in bytes
+*
+* @return <code>FG_OK</code> on success, <code>EINVAL</code> if the frame grabber memory
+* has not been allocated or the sizes are not valid
+*/
+
+int ring_init(FrameRing *ring, Fg_Struct *fg, TrackingSequence *tseq, int buffers,
+	int buf_size)
+{
+	return ring_init_cam(ring, default_cam(), tseq, buffers, buf_size);
+}
+
+/**
+* sets up a FrameRing over the image memory of one camera.
+*
+* @param ring the FrameRing to initialize
+* @param cam an acquiring Camera
+* @param tseq the sequence in which the ROI are active
+* @param buffers the number of buffers passed to <code>cam_init</code>
+* @param buf_size the size of one buffer in bytes
+*
+* @return <code>FG_OK</code> on success, <code>EINVAL</code> if the memory of the camera
+* has not been allocated or the sizes are not valid
+*
+* @see ring_init
+*/
+
+int ring_init_cam(FrameRing *ring, Camera *cam, TrackingSequence *tseq, int buffers,
+	int buf_size)
+{
+	memset(ring, 0, sizeof(FrameRing));
+
+	if(cam->mem == NULL || buffers <= 0 || buf_size <= 0 || tseq->seq_len <= 0) {
+		printf("ring init: frame grabber memory is not allocated\n");
+		return EINVAL;
+	}
+
+	ring->fg = cam->fg;
+	ring->port = cam->port;
+	ring->mem = (unsigned char *) cam->mem;
+	ring->head = cam->head;
+	ring->buffers = buffers;
+	ring->buf_size = buf_size;
+	ring->seq = tseq->seq;
+	ring->seq_len = tseq->seq_len;
+	ring->windows = tseq->windows;
+	ring->next = 1;
+	ring->latest = tseq->latest;
+	clock_init(&ring->clock);
+
+	return FG_OK;
+}
+
+/**
+* the last completed image number of the port, of the memory head with PINNED_DMA
+*/
+static int last_pic(FrameRing *ring)
+{
+	if(ring->head != NULL) {
+		return Fg_getLastPicNumberEx(ring->fg, ring->port, ring->head);
+	}
+
+	return Fg_getLastPicNumber(ring->fg, ring->port);
+}
+
+/**
+* waits up to <code>timeout</code> seconds for image <code>img</code> to complete
+*/
+static int last_pic_blocking(FrameRing *ring, int img, int timeout)
+{
+	if(ring->head != NULL) {
+		return Fg_getLastPicNumberBlockingEx(ring->fg, img, ring->port, timeout, ring->head);
+	}
+
+	return Fg_getLastPicNumberBlocking(ring->fg, img, ring->port, timeout);
+}
+
+/**
+* a parameter of image <code>img</code> like its tag or timestamp, which
+* <code>value</code> holds the image number of for <code>Fg_getParameter</code>
+*/
+static int img_param(FrameRing *ring, int param, void *value, int img)
+{
+	if(ring->head != NULL) {
+		return Fg_getParameterEx(ring->fg, param, value, ring->port, ring->head, img);
+	}
+
+	return Fg_getParameter(ring->fg, param, value, ring->port);
+}
+
+/**
+* the position of <code>roi</code> in the sequence, the first one at or after
+* <code>pos</code>, or -1 if the sequence does not have it.
+*/
+static int seq_find(FrameRing *ring, int roi, int pos)
+{
+	int i, p;
+
+	for(i = 0; i < ring->seq_len; i++) {
+		p = (pos + i) % ring->seq_len;
+		if(ring->seq[p] == roi) {
+			return p;
+		}
+	}
+
+	return -1;
+}
+
+/**
+* the ROI of image <code>img</code>, of its tag if it has one.
+*/
+static int ring_roi(FrameRing *ring, int img)
+{
+	int pos, p, tag;
+	unsigned int img_tag;
+
+	pos = (img - 1 + ring->shift) % ring->seq_len;
+
+	img_tag = img;
+	if(img_param(ring, FG_IMAGE_TAG, &img_tag, img) != FG_OK ||
+		!(ROI_TAG_OF(img_tag) & ROI_TAGGED)) {
+		ring->untagged++;
+		return ring->seq[pos];
+	}
+
+	tag = ROI_TAG_OF(img_tag);
+	p = seq_find(ring, ROI_OF_TAG(tag), pos);
+	if(p < 0) {
+		ring->untagged++;
+		return ring->seq[pos];
+	}
+	if(p != pos) {
+		ring->retagged++;
+		ring->shift = (ring->shift + p - pos + ring->seq_len) % ring->seq_len;
+	}
+
+	return ring->seq[p];
+}
+
+/**
+* whether an image of the ROI of image <code>img</code> completed after it, up to
+* <code>last</code>; the ROIs are the ones of the sequence, without reading the tags.
+*/
+static int ring_superseded(FrameRing *ring, int img, int last)
+{
+	int i, pos, n;
+
+	pos = (img - 1 + ring->shift) % ring->seq_len;
+	n = last - img;
+	if(n > ring->seq_len) {
+		n = ring->seq_len;
+	}
+	for(i = 1; i <= n; i++) {
+		if(ring->seq[(pos + i) % ring->seq_len] == ring->seq[pos]) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+* hands out the oldest completed image the consumer has not seen yet.
+*
+* <code>ring_next</code> only blocks when no image newer than the last one handed out
+* has completed.  If the grabber has lapped the ring since the last call, the images
+* that were overwritten are skipped and counted in <code>ring->lost</code>.  The ROI of
+* the view is of the tag of the image, see <code>ring_roi</code>.  With
+* <code>ring->latest</code> it is the oldest image no newer one of its ROI has
+* completed after, and the ones before it are counted in <code>ring->skipped</code>.
+*
+* @param ring the FrameRing to take the image from
+* @param view updated with the image number, ROI index, frame grabber timestamp, the
+* middle of the exposure in host time and a pointer to the pixels of the image
+* @param timeout the number of seconds to wait for the next image
+*
+* @return <code>FG_OK</code> if <code>view</code> holds a new image, otherwise the error
+* returned by the frame grabber and <code>view->data</code> is NULL
+*/
+
+int ring_next(FrameRing *ring, FrameView *view, int timeout)
+{
+	int rc, last;
+	LARGE_INTEGER now;
+
+	last = ring->last;
+	if(ring->latest && last >= ring->next) {
+		// what completed while the consumer was busy
+		rc = last_pic(ring);
+		if(rc > last) {
+			last = ring->last = rc;
+		}
+	}
+	if(last < ring->next) {
+		last = last_pic_blocking(ring, ring->next, timeout);
+		if(last < FG_OK) {
+			view->img = last;
+			view->data = NULL;
+			return last;
+		}
+		ring->last = last;
+	}
+
+	// the grabber lapped the ring, the oldest buffers hold newer images
+	if(last - ring->next >= ring->buffers) {
+		ring->lost += last - ring->buffers + 1 - ring->next;
+		ring->next = last - ring->buffers + 1;
+	}
+
+	while(ring->latest && ring->next < last && ring_superseded(ring, ring->next, last)) {
+		ring->next++;
+		ring->skipped++;
+	}
+
+	view->img = ring->next;
+	view->roi = ring_roi(ring, view->img);
+	view->data = ring->mem + ((view->img - 1) % ring->buffers) * ring->buf_size;
+
+	view->fg_ts = view->img;
+	rc = img_param(ring, FG_TIMESTAMP, &(view->fg_ts), view->img);
+	if(rc != FG_OK) {
+		view->fg_ts = rc;
+		view->exp_us = 0;
+	}
+	else {
+		QueryPerformanceCounter(&now);
+		clock_update(&ring->clock, view->fg_ts, now.QuadPart);
+		view->exp_us = clock_exposure_us(&ring->clock, view->fg_ts,
+			ring->windows[view->roi].exposure);
+	}
+
+	ring->next++;
+	ring->held++;
+
+	return FG_OK;
+}
+
+/**
+* gives an image handed out by <code>ring_next</code> back to the ring.
+*
+* @param ring the FrameRing <code>view</code> was taken from
+* @param view the image the consumer is done with
+*
+* @return <code>FG_OK</code> if the image was intact the whole time it was held,
+* <code>EINVAL</code> if the grabber overwrote the buffer before it was released
+*/
+
+int ring_release(FrameRing *ring, FrameView *view)
+{
+	int last;
+
+	if(ring->held > 0) {
+		ring->held--;
+	}
+
+	last = last_pic(ring);
+	if(last > ring->last) {
+		ring->last = last;
+	}
+
+	if(ring->last - view->img >= ring->buffers) {
+		ring->lost++;
+		return EINVAL;
+	}
+
+	return FG_OK;
+}
+
+/**
+* the number of buffers between the grabber and the consumer.
+*
+* <code>ring_in_flight</code> counts the images that have completed but have not been
+* handed out yet plus the images handed out but not released yet.  When it reaches the
+* number of buffers the next image acquired will overwrite an image the consumer has not
+* processed.
+*
+* @param ring the FrameRing to query
+*
+* @return the number of buffers in use
+*/
+
+int ring_in_flight(FrameRing *ring)
+{
+	int last;
+
+	last = last_pic(ring);
+	if(last > ring->last) {
+		ring->last = last;
+	}
+
+	return (ring->last - (ring->next - 1)) + ring->held;
+}
@@ -5,7 +5,20 @@
 
 #include "fcdynamic.h"
 
-static FC_ParameterSet rois[MAX_ROI];
+/**
+* the parts of a parameter set that have been given a value
+*/
+#define ROI_WINDOW 1
+#define ROI_TIME 2
+#define ROI_LINLOG 4
+
+/**
+* the camera the ROI functions work on, NULL is the camera opened by <code>init_cam</code>
+*/
+static Camera *camera_of(Camera *cam)
+{
+	return (cam != NULL) ? cam : default_cam();
+}
 
 /**
 * Writes the active ROI sequence to the frame grabber
@@ -16,23 +29,24 @@ static FC_ParameterSet rois[MAX_ROI];
 * A <code>seq</code> cannot exceed 4,096 entires and <code>seq_len</code> must equal 
 * the number of entries in <code>seq</code>.
 *
-* @param grabber an initialized Fg_Struct object defined in the Silicon Software API
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
 * @param seq the sequence specifying when a ROI is active
 * @param len the length of <code>seq</code>.
 */
 
-int roi_sequence(Fg_Struct *fg, int *seq, int len)
+int cam_roi_sequence(Camera *cam, int *seq, int len)
 {
 	int rc;
 	FastConfigSequence	fcs;
+	Camera *c = camera_of(cam);
 
 	// set the roi sequence
 	fcs.mLengthOfSequence = len;
 	fcs.mRoiPagePointer = seq;
-	rc = Fg_setParameter(fg, FG_FASTCONFIG_SEQUENCE, &fcs, PORT_A);
+	rc = Fg_setParameter(c->fg, FG_FASTCONFIG_SEQUENCE, &fcs, c->port);
 	if(rc != FG_OK) {
 		printf("set parameter fast config sequence failed\n");
-		return Fg_getLastErrorNumber(fg);
+		return Fg_getLastErrorNumber(c->fg);
 	}
 
 	return FG_OK;
@@ -52,6 +66,7 @@ int roi_sequence(Fg_Struct *fg, int *seq, int len)
 * by <code>index</code> is NEVER written to the camera.  You must call 
 * <code>write_roi</code> after calling this function for changes to take effect.
 *
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
 * @param index the ROI where the parameters are saved
 * @param x the topmost x (or column) position in pixels
 * @param y the topmost y (or row) position in pixels
@@ -62,16 +77,30 @@ int roi_sequence(Fg_Struct *fg, int *seq, int len)
 * @see write_roi
 */
 
-int roi_window(int index, int x, int width, int y, int height)
+int cam_roi_window(Camera *cam, int index, int x, int width, int y, int height)
 {
 	int rc;
+	Camera *c = camera_of(cam);
+	RoiState *s = c->state + index;
 
-	rc = setParameterSetRoi(&rois[index], x, width, y, height);
+	if((s->set & ROI_WINDOW) && s->x == x && s->width == width && s->y == y && 
+		s->height == height) {
+		return FG_OK;
+	}
+
+	rc = setParameterSetRoi(&c->rois[index], x, width, y, height);
 	if(rc != FG_OK) {
 		printf("set parameterset roi failed\n");
 		return rc;
 	}
 
+	s->set |= ROI_WINDOW;
+	s->dirty = TRUE;
+	s->x = x;
+	s->width = width;
+	s->y = y;
+	s->height = height;
+
 	return FG_OK;
 }
 
@@ -87,6 +116,10 @@ int roi_window(int index, int x, int width, int y, int height)
 * by <code>index</code> is NEVER written to the camera.  You must call 
 * <code>write_roi</code> after calling this function for changes to take effect.
 *
+* a frame time shorter than the camera can transfer the window in is raised to the
+* shortest one, see frametime.cpp, so the window should be set first.
+*
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
 * @param index the ROI where the parameters are saved
 * @param exp the exposure time in microseconds
 * @param ft the frame time in microseconds
@@ -95,19 +128,63 @@ int roi_window(int index, int x, int width, int y, int height)
 * @see write_roi
 */
 
-int roi_exposure(int index, double exp, double ft)
+int cam_roi_exposure(Camera *cam, int index, double exp, double ft)
 {
 	int rc;
+	double ask = ft;
+	Camera *c = camera_of(cam);
+	RoiState *s = c->state + index;
+
+	if(s->set & ROI_WINDOW) {
+		ft = frametime_clamp(s->width, s->height, exp, ft);
+	}
+
+	if((s->set & ROI_TIME) && s->exp == exp && s->ft == ft) {
+		s->ask = ask;
+		return FG_OK;
+	}
 
-	rc = setParameterSetTime(&rois[index], exp, ft);
+	rc = setParameterSetTime(&c->rois[index], exp, ft);
 	if(rc != FG_OK) {
 		printf("set parameterset set time failed\n");
 		return rc;
 	}
 
+	s->set |= ROI_TIME;
+	s->dirty = TRUE;
+	s->exp = exp;
+	s->ft = ft;
+	s->ask = ask;
+
 	return FG_OK;
 }
 
+/**
+* Changes only the exposure time of the <code>index</code>-th ROI.
+*
+* the frame time last asked for with <code>cam_roi_exposure</code> is clamped again for
+* the new exposure, so a shorter exposure also gives the ROI the shorter frame time it
+* can now run at, and a longer one raises it as far as needed.  Like
+* <code>cam_roi_exposure</code> nothing is sent before <code>write_roi</code>.
+*
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
+* @param index the ROI where the parameters are saved
+* @param exp the exposure time in microseconds
+*
+* @return <code>FG_OK</code>, or <code>EINVAL</code> if the ROI has no frame time yet
+*/
+
+int cam_roi_exposure_time(Camera *cam, int index, double exp)
+{
+	RoiState *s = camera_of(cam)->state + index;
+
+	if(!(s->set & ROI_TIME)) {
+		return EINVAL;
+	}
+
+	return cam_roi_exposure(cam, index, exp, s->ask);
+}
+
 /**
 * Specifies the linlog parameters of the image for <code>index</code>-th ROI.
 *
@@ -119,6 +196,7 @@ int roi_exposure(int index, double exp, double ft)
 * by <code>index</code> is NEVER written to the camera.  You must call 
 * <code>write_roi</code> after calling this function for changes to take effect.
 *
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
 * @param index the ROI where the parameters are saved
 * @param use_linlog a boolean value (0 = FALSE)
 * @param ll1 linlog parameter 1 (see Photonfocus doc for description)
@@ -129,16 +207,30 @@ int roi_exposure(int index, double exp, double ft)
 * @see write_roi
 */
 
-int roi_linlog(int index, int use_linlog, int ll1, int ll2, int comp)
+int cam_roi_linlog(Camera *cam, int index, int use_linlog, int ll1, int ll2, int comp)
 {
 	int rc;
+	Camera *c = camera_of(cam);
+	RoiState *s = c->state + index;
 
-	rc = setParameterSetLinlog(&rois[index], use_linlog, ll1, ll2, comp);
+	if((s->set & ROI_LINLOG) && s->linlog[0] == use_linlog && s->linlog[1] == ll1 &&
+		s->linlog[2] == ll2 && s->linlog[3] == comp) {
+		return FG_OK;
+	}
+
+	rc = setParameterSetLinlog(&c->rois[index], use_linlog, ll1, ll2, comp);
 	if(rc != FG_OK) {
 		printf("set parameterset linlog failed\n");
 		return rc;
 	}
 
+	s->set |= ROI_LINLOG;
+	s->dirty = TRUE;
+	s->linlog[0] = use_linlog;
+	s->linlog[1] = ll1;
+	s->linlog[2] = ll2;
+	s->linlog[3] = comp;
+
 	return FG_OK;
 }
 
@@ -153,22 +245,128 @@ int roi_linlog(int index, int use_linlog, int ll1, int ll2, int comp)
 * to take place.  For more information about the triggering modes consult the Silicon
 * software API.
 *
-* @param grabber an initialized Fg_Struct object defined in the Silicon Software API
+* the parameter set goes out with the label <code>ROI_TAG(index, imgNr)</code>, which
+* comes back in FG_IMAGE_TAG of every image it takes, so <code>ring_next</code> knows
+* the ROI of an image even when the grabber missed one before it.
+*
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
 * @param index the ROI where the parameters are saved
-* @param imgNr the (minimum) image that the ROI will be active for
+* @param imgNr the (minimum) image that the ROI will be active for, in the label
 * @param doInit perform a reinitialization of the camera ROI (see Silicon Software API)
 *
 * @see roi_index
 */
-int write_roi(Fg_Struct *fg, int index, int imgNr, int doInit)
+int cam_write_roi(Camera *cam, int index, int imgNr, int doInit)
 {
 	int rc;
+	Camera *c = camera_of(cam);
 
-	rc = writeParameterSet(fg, &rois[index], index, imgNr, doInit, PORT_A);
+	rc = writeParameterSet(c->fg, &c->rois[index], index, ROI_TAG(index, imgNr), doInit, c->port);
 	if(rc != FG_OK) {
 		printf("write parameterset failed\n");
-		return Fg_getLastErrorNumber(fg);
+		return Fg_getLastErrorNumber(c->fg);
+	}
+	c->state[index].dirty = FALSE;
+
+	return FG_OK;
+}
+
+/**
+* Writes the ROIs in <code>indices</code> that changed since they were last written.
+*
+* write_rois is a batched <code>write_roi</code> for the camera's free running mode.
+* Each <code>writeParameterSet</code> is a full round trip through the driver, so the
+* ROIs whose parameters are the same as the last time they were written are skipped.
+* An index may appear more than once in <code>indices</code> (like in a ROI sequence),
+* it is written at most once.
+*
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
+* @param indices the ROIs to write
+* @param n the number of entries in <code>indices</code>
+* @param imgNr the (minimum) image that the ROIs will be active for
+*
+* @return <code>FG_OK</code> if every changed ROI was written, otherwise the error of
+* the first write that failed
+*
+* @note the FastConfig API always writes a whole parameter set, so a ROI where only the
+* position changed costs the same as one where everything changed.
+*
+* @see write_roi
+* @see roi_invalidate
+*/
+
+int cam_write_rois(Camera *cam, const int *indices, int n, int imgNr)
+{
+	int i, rc;
+	Camera *c = camera_of(cam);
+
+	for(i = 0; i < n; i++) {
+		// writing also clears dirty, so repeated indices are skipped
+		if(!c->state[indices[i]].dirty) {
+			continue;
+		}
+
+		rc = cam_write_roi(c, indices[i], imgNr, !DO_INIT);
+		if(rc != FG_OK) {
+			return rc;
+		}
 	}
 
 	return FG_OK;
+}
+
+/**
+* Marks the <code>index</code>-th ROI as changed so the next <code>write_rois</code>
+* writes it.
+*
+* after the frame grabber is initialized it has not been sent any parameter set, so
+* every ROI has to be invalidated before the first <code>write_rois</code>.
+*
+* @param cam an initialized Camera, or NULL for the camera opened by <code>init_cam</code>
+* @param index the ROI to invalidate
+*/
+
+void cam_roi_invalidate(Camera *cam, int index)
+{
+	camera_of(cam)->state[index].dirty = TRUE;
+}
+
+/*
+* the ROI functions of the camera opened by <code>init_cam</code>.  <code>fg</code> has
+* to be the Fg_Struct returned by <code>init_cam</code>.
+*/
+
+int roi_sequence(Fg_Struct *fg, int *seq, int len)
+{
+	return cam_roi_sequence(NULL, seq, len);
+}
+
+int roi_window(int index, int x, int width, int y, int height)
+{
+	return cam_roi_window(NULL, index, x, width, y, height);
+}
+
+int roi_exposure(int index, double exp, double ft)
+{
+	return cam_roi_exposure(NULL, index, exp, ft);
+}
+
+int roi_linlog(int index, int use_linlog, int ll1, int ll2, int comp)
+{
+	return cam_roi_linlog(NULL, index, use_linlog, ll1, ll2, comp);
+}
+
+int write_roi(Fg_Struct *fg, int index, int imgNr, int doInit)
+{
+	return cam_write_roi(NULL, index, imgNr, doInit);
+}
+
+int write_rois(Fg_Struct *fg, const int *indices, int n, int imgNr)
+{
+	return cam_write_rois(NULL, indices, n, imgNr);
+}
+
+void roi_invalidate(int index)
+{
+	cam_roi_invalidate(NULL, index);
 }
\ No newline at end of file
@@ -0,0 +1,228 @@
+/**
+* @file search.cpp interleaves a large search ROI with the small ROIs that track.
+*
+* a lost object is looked for by its own ROI in stages, see <code>update_position</code>,
+* and in the last stage the ROI scans the image tile by tile, which with a small ROI
+* takes many sequence periods.  A search window is a ROI of its own, as large as the
+* image or a part of it and possibly exposed shorter, that is only active once every
+* <code>every</code> images of a long sequence, so it costs the track windows little
+* of their rate.  <code>search_sequence</code> builds such a sequence for the frame
+* grabber, which takes up to MAX_SEQ_LEN entries.
+*
+* the search window goes through the same tracking loops as the others:
+* <code>update_position</code> hands its image to <code>search_position</code>, which
+* labels the objects in it and leaves each lost track window a hint where the nearest
+* one is.  The hint is taken up by the track window the next time it runs, in its own
+* thread, so several windows can be processed at the same time like in window_run.cpp.
+* The buffers are sized for the largest ROI of the sequence, see buffers.cpp.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* builds a sequence that runs the ROIs of <code>track</code> in turn, with the search ROI
+* in place of every <code>every</code>-th of them.
+*
+* the sequence is as long as it takes for every track ROI to come up equally often,
+* <code>track_len / gcd(every - 1, track_len)</code> periods of <code>every</code>
+* entries.  A track ROI equal to <code>search</code> is left out.
+*
+* @param seq filled with the sequence
+* @param max the entries <code>seq</code> has room for, at most MAX_SEQ_LEN
+* @param track the ROIs that track objects
+* @param track_len the number of entries in <code>track</code>
+* @param search the ROI of the search window
+* @param every the search ROI is active once every <code>every</code> images, at least 2
+*
+* @return the length of the sequence, or -1 if it does not fit in <code>max</code>
+*/
+
+int search_sequence(int *seq, int max, const int *track, int track_len, int search, int every)
+{
+	int i, n, k, a, b, r, periods, rois[MAX_SEQ_LEN];
+
+	n = 0;
+	for(i = 0; i < track_len && n < MAX_SEQ_LEN; i++) {
+		if(track[i] != search) {
+			rois[n++] = track[i];
+		}
+	}
+	if(n == 0 || every < 2) {
+		return -1;
+	}
+
+	// the track ROIs come around evenly after lcm(every - 1, n) track entries
+	a = every - 1;
+	b = n;
+	while(b != 0) {
+		r = a % b;
+		a = b;
+		b = r;
+	}
+	periods = n / a;
+
+	if(periods * every > max || periods * every > MAX_SEQ_LEN) {
+		return -1;
+	}
+
+	k = 0;
+	for(i = 0; i < periods * every; i++) {
+		if(i % every == every - 1) {
+			seq[i] = search;
+		}
+		else {
+			seq[i] = rois[k++ % n];
+		}
+	}
+
+	return periods * every;
+}
+
+/**
+* the number of images after image <code>img</code> until <code>roi</code> is active
+* again, the length of the sequence if it is only active once in it
+*
+* @param tseq the TrackingSequence the frame grabber runs
+* @param img the number of an image, counted from 1 like the frame grabber does
+* @param roi the ROI
+*/
+
+int sequence_gap(TrackingSequence *tseq, int img, int roi)
+{
+	int i, pos;
+
+	pos = (img - 1) % tseq->seq_len;
+	for(i = 1; i < tseq->seq_len; i++) {
+		if(tseq->seq[(pos + i) % tseq->seq_len] == roi) {
+			return i;
+		}
+	}
+
+	return tseq->seq_len;
+}
+
+/**
+* makes <code>win</code> the search window of the ROIs in <code>seq</code>.
+*
+* the window is <code>w</code> x <code>h</code> in the middle of the image, searched as a
+* whole, and keeps its size, <code>adapt_roi</code> leaves it alone.
+*
+* @param win the TrackingWindow of the search ROI, its image size already set
+* @param tracks the windows of the sequence, indexed by their ROI
+* @param seq the track ROIs
+* @param seq_len the number of entries in <code>seq</code>
+* @param w the width of the search window, 0 or less for the width of the image
+* @param h the height of the search window, 0 or less for the height of the image
+*/
+
+void search_setup(TrackingWindow *win, TrackingWindow *tracks, const int *seq, int seq_len,
+	int w, int h)
+{
+	int i;
+
+	win->roi_w = (w > 0 && w < win->img_w) ? w : win->img_w;
+	win->roi_h = (h > 0 && h < win->img_h) ? h : win->img_h;
+	win->roi_max_w = win->roi_w;
+	win->roi_max_h = win->roi_h;
+	set_roi_box(win, win->img_w / 2, win->img_h / 2);
+
+	win->tracks = tracks;
+	win->track_mask = 0;
+	for(i = 0; i < seq_len; i++) {
+		if(seq[i] != win->roi) {
+			win->track_mask |= 1 << seq[i];
+		}
+	}
+
+	win->blob_xmin = 0;
+	win->blob_ymin = 0;
+	win->blob_xmax = win->roi_w;
+	win->blob_ymax = win->roi_h;
+}
+
+/**
+* hands the objects in the image of a search window to the track windows that lost
+* theirs.
+*
+* the objects are the components <code>label_blobs</code> finds in the binarized image.
+* An object inside the ROI of a track window that still tracks is taken, the others go
+* to the lost windows, each one getting the object nearest to the center of its ROI as
+* its <code>hint</code>.  The lost state of a window may be a little old when it is run
+* by another thread, which costs at most a hint that is not needed.
+*
+* @param win the search window, binarized by <code>threshold</code> or
+* <code>threshold_blob</code>
+* @param found the result of the search for a blob in the image
+*
+* @return <code>OBJECT_FOUND</code> if a lost window was given a hint, else
+* <code>!OBJECT_FOUND</code>
+*/
+
+int search_position(TrackingWindow *win, int found)
+{
+	int i, k, best, given, taken[MAX_BLOBS];
+	double x, y, dx, dy, d, best_d;
+	BlobList list;
+	BlobInfo *b;
+	TrackingWindow *t;
+
+	given = 0;
+	if(found == OBJECT_FOUND && label_blobs(win, &list) == OBJECT_FOUND) {
+		memset(taken, 0, sizeof(taken));
+
+		// the objects that are tracked already
+		for(i = 0; i < MAX_ROI; i++) {
+			t = win->tracks + i;
+			if(!(win->track_mask & (1 << i)) || t->lost != RECOVER_NONE) {
+				continue;
+			}
+			for(k = 0; k < list.count; k++) {
+				x = win->roi_xoff + list.blobs[k].cx;
+				y = win->roi_yoff + list.blobs[k].cy;
+				if(x >= t->roi_xoff && x < t->roi_xoff + t->roi_w &&
+					y >= t->roi_yoff && y < t->roi_yoff + t->roi_h) {
+					taken[k] = TRUE;
+				}
+			}
+		}
+
+		for(i = 0; i < MAX_ROI; i++) {
+			t = win->tracks + i;
+			if(!(win->track_mask & (1 << i)) || t->lost == RECOVER_NONE) {
+				continue;
+			}
+
+			best = -1;
+			best_d = 0;
+			for(k = 0; k < list.count; k++) {
+				if(taken[k]) {
+					continue;
+				}
+				dx = win->roi_xoff + list.blobs[k].cx - (t->roi_xoff + t->roi_w / 2);
+				dy = win->roi_yoff + list.blobs[k].cy - (t->roi_yoff + t->roi_h / 2);
+				d = dx * dx + dy * dy;
+				if(best < 0 || d < best_d) {
+					best = k;
+					best_d = d;
+				}
+			}
+			if(best < 0) {
+				break;
+			}
+
+			taken[best] = TRUE;
+			b = list.blobs + best;
+			InterlockedExchange(&t->hint, SEARCH_HINT(win->roi_xoff + (int) b->cx,
+				win->roi_yoff + (int) b->cy));
+			given++;
+		}
+	}
+
+	// the whole window is searched every time
+	win->blob_xmin = 0;
+	win->blob_ymin = 0;
+	win->blob_xmax = win->roi_w;
+	win->blob_ymax = win->roi_h;
+
+	return given > 0 ? OBJECT_FOUND : !OBJECT_FOUND;
+}
@@ -33,7 +33,6 @@
 #define NUM_BUFFERS 16 /**< typical setting (max is 1,000,000 shouldn't exceed 1.6 GB)*/
 #define MEMSIZE(w, h) ((w) * (h) * NUM_BUFFERS)
 
-#define SEQ {ROI_0}
 #define SEQ_LEN 1
 #define CAMLINK FG_CL_DUALTAP_8_BIT
 
@@ -52,6 +51,7 @@
 #define THRESHOLD 59
 #define DISPLAY "Simple Tracking" /**< name of display GUI */
 #define NEXT_IMAGE 2 /**< next valid image to grab */
+#define CONFIG_FILE "skeleton.ini" /**< overrides the parameters above (see config.cpp) */
 
 /** Sets the initial positions of the camera's window and blob's window
 *
@@ -76,7 +76,7 @@
 *  and "blob" refers to the software's parameters.
 */
 
-void set_initial_positions(TrackingWindow *win)
+void set_initial_positions(TrackingWindow *win, Config *cfg)
 {
 	int blob_cx, blob_cy;
 	/* The following example shows how to initialize the ROI for the camera ("roi_")
@@ -86,19 +86,20 @@ void set_initial_positions(TrackingWindow *win)
 
 	// insert initial image coordinates of ROI 0 for camera
 	win->roi = ROI_0;
-	win->roi_w = ROI_BOX;
-	win->roi_h = ROI_BOX;
-	win->img_w = IMG_WIDTH;
-	win->img_h = IMG_HEIGHT;
+	win->roi_w = cfg->bounding_box;
+	win->roi_h = cfg->bounding_box;
+	win->img_step = win->roi_w;
+	win->img_w = cfg->img_w;
+	win->img_h = cfg->img_h;
 
 	// store the camera's ROI 0 information
-	SetTrackCamParameters(win + ROI_0, FRAME_TIME, EXPOSURE);
+	SetTrackCamParameters(win + ROI_0, cfg->frame_time, cfg->exposure);
 
 	// insert initial image coordinates of blob 0 (for software use)
-	win->blob_xmin = INITIAL_BLOB_XMIN;
-	win->blob_ymin = INITIAL_BLOB_YMIN;
-	win->blob_xmax = INITIAL_BLOB_XMIN + INITIAL_BLOB_WIDTH;
-	win->blob_ymax = INITIAL_BLOB_YMIN + INITIAL_BLOB_HEIGHT;
+	win->blob_xmin = cfg->blob_xmin;
+	win->blob_ymin = cfg->blob_ymin;
+	win->blob_xmax = cfg->blob_xmin + cfg->blob_w;
+	win->blob_ymax = cfg->blob_ymin + cfg->blob_h;
 
 	// center camera's ROI 0 around the blob's midpoint in the image's coordinate frame.  
 	// Note that in this implementation the initial placement of the ROI is dependent on 
@@ -126,7 +127,36 @@ void set_initial_positions(TrackingWindow *win)
 	//
 	//  1) SetTrackCamParameters(win, FRAME_TIME, EXPOSURE); <- buffer parameters internally
 	//  2) write_roi(fg, cur.roi, img_nr, !DO_INIT); <- writes buffered parameters to camera
-	SetTrackCamParameters(win, FRAME_TIME, EXPOSURE);
+	SetTrackCamParameters(win, cfg->frame_time, cfg->exposure);
+}
+
+/** Reads the parameters from CONFIG_FILE
+*
+*  load_config starts from the parameters defined at the top of this file, so the
+*  config file only has to list the ones that should change.  A missing file is not an
+*  error.
+*/
+
+int load_config(Config *cfg)
+{
+	int rc;
+
+	config_defaults(cfg);
+	cfg->exposure = EXPOSURE;
+	cfg->frame_time = FRAME_TIME;
+	cfg->img_w = IMG_WIDTH;
+	cfg->img_h = IMG_HEIGHT;
+	cfg->bounding_box = ROI_BOX;
+	cfg->blob_xmin = INITIAL_BLOB_XMIN;
+	cfg->blob_ymin = INITIAL_BLOB_YMIN;
+	cfg->blob_w = INITIAL_BLOB_WIDTH;
+	cfg->blob_h = INITIAL_BLOB_HEIGHT;
+	cfg->threshold = THRESHOLD;
+	cfg->seq[0] = ROI_0;
+	cfg->seq_len = SEQ_LEN;
+
+	rc = config_load(cfg, CONFIG_FILE);
+	return (rc == ENOENT) ? FG_OK : rc;
 }
 
 /** Draw ROI & blob windows and show image on screen (see OpenCV doc for info)
@@ -136,6 +166,11 @@ void set_initial_positions(TrackingWindow *win)
 
 void display_tracking(TrackingWindow *cur, IplImage *gui)
 {
+#if PREVIEW
+	// the viewer of preview.cpp draws the boxes, nothing is shown here
+	preview_publish(cur->img, cur->roi_w, cur->roi_xoff, cur->roi_yoff, cur->roi_w, cur->roi_h,
+		(int) cur->ts, cur, TRUE);
+#else
 	gui->imageData = (char *) cur->img;
 	gui->imageDataOrigin = (char *) cur->img;
 
@@ -150,6 +185,7 @@ void display_tracking(TrackingWindow *cur, IplImage *gui)
 
 	// add a small delay, so OpenCV has time to display to screen
 	cvWaitKey(1);
+#endif
 }
 
 /** Grabs an image from the camera and displays the image on screen
@@ -164,21 +200,38 @@ int main()
 	// important variables used in most applications
 	int rc;
 	Fg_Struct *fg = NULL;
-	int img_nr;
+	int img_nr, t;
+	double exposure;
 	TrackingWindow cur;
-	int seq[] = SEQ;
+	Config cfg;
 
 	// following lines are for displaying images only!  See OpenCV doc for more info.
 	// they can be left out, if speed is important.
 	IplImage *cvDisplay = NULL;
 
-	cvDisplay = cvCreateImageHeader(cvSize(ROI_BOX, ROI_BOX), 
+	// read the parameters and watch the file for a new threshold or exposure
+	rc = load_config(&cfg);
+	if(rc != FG_OK) {
+		return rc;
+	}
+	t = cfg.threshold;
+	exposure = cfg.exposure;
+	config_watch(&cfg, CONFIG_FILE);
+
+	cvDisplay = cvCreateImageHeader(cvSize(cfg.bounding_box, cfg.bounding_box), 
 		BITS_PER_PIXEL, NUM_CHANNELS);
+#if PREVIEW
+	rc = preview_start(IMG_WIDTH, IMG_HEIGHT);
+	if(rc != FG_OK) {
+		return rc;
+	}
+#else
 	cvNamedWindow(DISPLAY, CV_WINDOW_AUTOSIZE);
+#endif
 	
 	// initialize the tracking window (i.e. blob and ROI positions)
 	memset(&cur, 0, sizeof(TrackingWindow));
-	set_initial_positions(&cur);
+	set_initial_positions(&cur, &cfg);
 
 	// initialize the camera
 	rc = init_cam(&fg, MEMSIZE(cur.roi_w, cur.roi_h), NUM_BUFFERS, CAMLINK);
@@ -189,7 +242,7 @@ int main()
 	}
 
 	// start acquiring images (this function also writes any buffered ROIs to the camera)
-	rc = acquire_imgs(fg, (int *) &seq, SEQ_LEN);
+	rc = acquire_imgs(fg, cfg.seq, cfg.seq_len);
 	if(rc != FG_OK) {
 		printf("init: %s\n", Fg_getLastErrorDescription(fg));
 		Fg_FreeGrabber(fg);
@@ -202,8 +255,15 @@ int main()
 	// start image loop and don't stop until the user presses 'q'
 	printf("press 'q' at any time to quit this demo.");
 	while(!(_kbhit() && _getch() == 'q')) {
+#if PINNED_DMA
+		// the buffers are under the memory head of the camera, see cam_init
+		img_nr = Fg_getLastPicNumberBlockingEx(fg, img_nr, PORT_A, TIMEOUT, default_cam()->head);
+		cur.img = (unsigned char *) Fg_getImagePtrEx(fg, img_nr, PORT_A, default_cam()->head);
+#else
 		img_nr = Fg_getLastPicNumberBlocking(fg, img_nr, PORT_A, TIMEOUT);
 		cur.img = (unsigned char *) Fg_getImagePtr(fg, img_nr, PORT_A);
+#endif
+		cur.ts = img_nr;
 
 		// make sure that camera returned a valid image
 		if(cur.img != NULL) {
@@ -212,8 +272,13 @@ int main()
 			// frame (see Silicon Software FastConfig doc)
 			img_nr += NEXT_IMAGE;
 
+			// the config file changed, the new exposure is written with the next ROI
+			if(config_poll(&t, &exposure)) {
+				roi_exposure(cur.roi, exposure, cfg.frame_time);
+			}
+
 			// process image
-			threshold(&cur, THRESHOLD);
+			threshold(&cur, t);
 			erode(&cur);
 
 			// update ROI position
@@ -239,6 +304,10 @@ int main()
 
 	// free viewer resources
 	cvReleaseImageHeader(&cvDisplay);
+#if PREVIEW
+	preview_stop();
+#endif
+	config_unwatch();
 
 	// free camera resources
 	rc = deinit_cam(fg);
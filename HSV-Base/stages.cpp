@@ -0,0 +1,306 @@
+/**
+* @file stages.cpp runs the processing stages of a window as one pass over its rows.
+*
+* the built-in pass of a window is fixed: <code>threshold_blob</code>, or
+* <code>grow_blob</code> with GROW_BLOB, and <code>display_run</code> adds a separate
+* <code>erode</code> pass.  A StagePlan, read from the <code>[stages] plan</code> key of the
+* config file, picks the stages of its window instead from background, threshold, erode,
+* blob, moments and boundary.  Whatever order they are listed in, they run in that order:
+* threshold and blob are always part of a plan, since the blob is the result of the pass,
+* and background only runs on a window with a Background set.
+*
+* <code>stage_init</code> compiles the list into a plan that walks the blob window once,
+* row by row.  A stage that looks at its neighbors runs a row behind the stage before it,
+* so when row i has been subtracted, histogrammed and binarized, erode runs on row
+* i - 1, whose rows above and below are binarized by then, blob and moments sum row
+* i - 1, and boundary marks row i - 2, whose rows below are eroded and summed.  The rows
+* of the window are still in the cache when the later stages reach them, so every stage
+* adds its arithmetic but not another pass over memory.  The gray values of the rows
+* before they are binarized are kept in a ring of two rows for moments.  A plan of
+* the stages <code>threshold_blob</code> already fuses runs as that kernel, with its SSE2
+* loop.
+*
+* the pixels and results are the same as the separate passes in the same order:
+* erode only clears a pixel of which no neighbor is foreground, and boundary only turns
+* foreground into border, so neither changes what the rows after them see.
+*/
+
+#include "fcdynamic.h"
+
+#if GROW_BLOB
+#define BUILTIN_PASS(win, t) grow_blob(win, t)
+#else
+#define BUILTIN_PASS(win, t) threshold_blob(win, t)
+#endif
+
+/**
+* the name of each stage in the config file, in the order the stages run
+*/
+static const struct {
+	const char *name;
+	int stage;
+} stage_names[] = {
+	{"background", STAGE_BACKGROUND},
+	{"threshold", STAGE_THRESHOLD},
+	{"erode", STAGE_ERODE},
+	{"blob", STAGE_BLOB},
+	{"moments", STAGE_MOMENTS},
+	{"boundary", STAGE_BOUNDARY},
+};
+
+#define NUM_STAGES ((int) (sizeof(stage_names) / sizeof(stage_names[0])))
+
+/**
+* the stages of a list of stage names
+*
+* @return the STAGE_ bits, or -1 if a name is not a stage
+*/
+static int parse_stages(const char *spec)
+{
+	int k, n, stages;
+	const char *s;
+
+	stages = 0;
+	s = spec;
+	while(*s != '\0') {
+		while(*s == ' ' || *s == '\t' || *s == ',') {
+			s++;
+		}
+		for(n = 0; s[n] != '\0' && s[n] != ',' && s[n] != ' ' && s[n] != '\t'; n++);
+		if(n == 0) {
+			break;
+		}
+		for(k = 0; k < NUM_STAGES; k++) {
+			if((int) strlen(stage_names[k].name) == n && strncmp(s, stage_names[k].name, n) == 0) {
+				break;
+			}
+		}
+		if(k == NUM_STAGES) {
+			printf("stages: %.*s is no stage\n", n, s);
+			return -1;
+		}
+		stages |= stage_names[k].stage;
+		s += n;
+	}
+
+	return stages;
+}
+
+/**
+* compiles a list of stages into the plan of a window of up to <code>w</code> pixels wide.
+*
+* the row ring is only allocated again if it does not fit, so a plan can be set up again
+* for every run.
+*
+* @param p the StagePlan to set up
+* @param spec the stages, separated by commas or blanks, like "erode, moments"
+* @param w the largest ROI width of the window
+*
+* @return <code>FG_OK</code>, <code>EINVAL</code> if a name is not a stage or
+* <code>ENOMEM</code>
+*/
+
+int stage_init(StagePlan *p, const char *spec, int w)
+{
+	int stages;
+
+	stages = parse_stages(spec);
+	if(stages < 0) {
+		return EINVAL;
+	}
+	stages |= STAGE_THRESHOLD | STAGE_BLOB;
+
+	if((stages & STAGE_MOMENTS) && (p->gray == NULL || p->gray_w < w)) {
+		free(p->gray);
+		p->gray = (unsigned char *) malloc(2 * w);
+		if(p->gray == NULL) {
+			memset(p, 0, sizeof(StagePlan));
+			printf("stages: not enough memory for the rows of a %d pixel window\n", w);
+			return ENOMEM;
+		}
+		p->gray_w = w;
+	}
+
+	p->stages = stages;
+	p->erode_lag = (stages & STAGE_ERODE) ? 1 : 0;
+	p->lag = p->erode_lag + ((stages & STAGE_BOUNDARY) ? 1 : 0);
+	p->builtin = !(stages & (STAGE_ERODE | STAGE_BOUNDARY)) &&
+		((stages & STAGE_MOMENTS) != 0) == (BLOB_MOMENTS != 0);
+
+	return FG_OK;
+}
+
+/**
+* releases the row ring of a StagePlan
+*/
+
+void stage_free(StagePlan *p)
+{
+	free(p->gray);
+	memset(p, 0, sizeof(StagePlan));
+}
+
+/**
+* the pass of <code>stage_pass</code>
+*/
+static int run_pass(TrackingWindow *win, int t)
+{
+	int i, j, r, s, xmin, xmax, ymin, ymax, bg, hit;
+	int box_xmin, box_ymin, box_xmax, box_ymax;
+	int moments, area;
+	unsigned char *row, *gray;
+	unsigned int *hist, *ehist;
+	__int64 s0, s1, s2;
+	BlobMoments m;
+	StagePlan *p = win->stages;
+
+	if(p == NULL) {
+		return BUILTIN_PASS(win, t);
+	}
+	// threshold_blob subtracts the background of every window that has one
+	if(p->builtin && ((p->stages & STAGE_BACKGROUND) != 0) == (win->bg != NULL)) {
+		return threshold_blob(win, t);
+	}
+
+	xmin = win->blob_xmin;
+	xmax = win->blob_xmax;
+	ymin = win->blob_ymin;
+	ymax = win->blob_ymax;
+
+	box_xmin = xmax;
+	box_ymin = ymax;
+	box_xmax = -1;
+	box_ymax = -1;
+	hist = auto_threshold_begin(win, &t);
+	ehist = auto_exposure_begin(win);
+	bg = (p->stages & STAGE_BACKGROUND) ? background_begin(win) : BG_NONE;
+	moments = (p->stages & STAGE_MOMENTS) != 0;
+	area = 0;
+	memset(&m, 0, sizeof(m));
+
+	for(s = ymin; s < ymax + p->lag; s++) {
+		// background, histograms and threshold on the newest row
+		i = s;
+		if(i < ymax) {
+			row = &PIXEL(win, i, 0);
+			if(bg != BG_NONE) {
+				background_row(win, bg, i, xmin, xmax, t);
+			}
+			if(hist != NULL) {
+				histogram_row(hist, row, xmin, xmax);
+			}
+			if(ehist != NULL) {
+				histogram_row(ehist, row, xmin, xmax);
+			}
+			if(moments) {
+				memcpy(p->gray + (i & 1) * p->gray_w + xmin, row + xmin, xmax - xmin);
+			}
+			for(j = xmin; j < xmax; j++) {
+				row[j] = (row[j] < t) ? BACKGROUND : FOREGROUND;
+			}
+		}
+
+		// erode, blob and moments a row behind if there is an erode
+		r = s - p->erode_lag;
+		if(r >= ymin && r < ymax) {
+			if(p->stages & STAGE_ERODE) {
+				erode_row(win, r);
+			}
+			row = &PIXEL(win, r, 0);
+			gray = moments ? p->gray + (r & 1) * p->gray_w : NULL;
+			hit = FALSE;
+			s0 = 0;
+			s1 = 0;
+			s2 = 0;
+			for(j = xmin; j < xmax; j++) {
+				if(row[j] != FOREGROUND) {
+					continue;
+				}
+				hit = TRUE;
+				if(box_xmin > j) {
+					box_xmin = j;
+				}
+				if(box_xmax < j) {
+					box_xmax = j;
+				}
+				if(gray != NULL) {
+					s0 += gray[j];
+					s1 += (__int64) gray[j] * j;
+					s2 += (__int64) gray[j] * j * j;
+					area++;
+				}
+			}
+			if(hit) {
+				if(box_ymin > r) {
+					box_ymin = r;
+				}
+				box_ymax = r;
+			}
+			m.m00 += s0;
+			m.m10 += s1;
+			m.m20 += s2;
+			m.m01 += r * s0;
+			m.m11 += r * s1;
+			m.m02 += (__int64) r * r * s0;
+		}
+
+		// boundary behind the erode
+		r = s - p->lag;
+		if((p->stages & STAGE_BOUNDARY) && r >= ymin && r < ymax) {
+			boundary_row(win, r);
+		}
+	}
+
+	if(hist != NULL) {
+		auto_threshold_end(win->autot);
+	}
+	if(ehist != NULL) {
+		auto_exposure_end(win, t);
+	}
+
+	if(box_ymax < 0) {
+		if(moments) {
+			win->area = 0;
+		}
+		return !OBJECT_FOUND;
+	}
+
+	win->blob_xmin = box_xmin;
+	win->blob_ymin = box_ymin;
+	win->blob_xmax = box_xmax;
+	win->blob_ymax = box_ymax;
+	if(moments) {
+		blob_shape(win, &m, area);
+	}
+
+	return OBJECT_FOUND;
+}
+
+/**
+* runs the pass of a window: its StagePlan in <code>win->stages</code>, or the built-in
+* pass without one.
+*
+* @param win the TrackingWindow to process and update with the object's bounding box
+* @param t the threshold value
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else
+* <code>!OBJECT_FOUND</code>
+*
+* @note like <code>threshold_blob</code>, the blob parameters of <code>win</code> are only
+* updated when an object is found, except for <code>win->area</code>, which is set to 0
+* when the plan has moments.
+*
+* @see stages.cpp
+*/
+
+int stage_pass(TrackingWindow *win, int t)
+{
+	int rc;
+	PMC_SAMPLE(pmc);
+
+	PMC_BEGIN(pmc);
+	rc = run_pass(win, t);
+	PMC_END(PMC_STAGES, win->roi, pmc);
+
+	return rc;
+}
@@ -0,0 +1,239 @@
+/**
+* @file stream.cpp summarizes a timing run in constant memory.
+*
+* <code>time_run</code> keeps a FrameInfo per image, a whole TrackingWindow and eight
+* counters each, so the trace of a run has to fit in memory and a soak test is limited
+* to a few minutes at full rate.  With STREAM_STATS set it hands every image to
+* <code>stream_add</code> instead, which keeps the mean and variance of every timed stage
+* with Welford's update, the minimum and maximum with the image they were seen in and
+* the p50, p99 and p99.9 with the P-square estimator of Jain and Chlamtac, five markers
+* per percentile.  None of them need the values again, so a run can go on for days.
+*
+* <code>stream_print</code> prints the statistics in one block, which
+* <code>time_run</code> does every STREAM_CHECKPOINT images and at the end of the run.
+* The percentiles are estimates, close to the sorted ones of <code>bench_run</code> once
+* a few thousand images are in, the tail ones need the most.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* sets up the estimate of percentile <code>p</code>, a fraction
+*/
+static void p2_init(P2Quantile *e, double p)
+{
+	memset(e, 0, sizeof(P2Quantile));
+	e->p = p;
+}
+
+/**
+* moves the markers of a P-square estimate for one more value
+*/
+static void p2_add(P2Quantile *e, double x)
+{
+	int i, k, d;
+	double qp, t;
+	double dn[5] = {0, e->p / 2, e->p, (1 + e->p) / 2, 1};
+
+	// the first five values are the markers
+	if(e->count < 5) {
+		e->q[e->count++] = x;
+		if(e->count == 5) {
+			for(i = 1; i < 5; i++) {
+				for(k = i; k > 0 && e->q[k - 1] > e->q[k]; k--) {
+					t = e->q[k];
+					e->q[k] = e->q[k - 1];
+					e->q[k - 1] = t;
+				}
+			}
+			for(i = 0; i < 5; i++) {
+				e->pos[i] = i + 1;
+				e->want[i] = 1 + 4 * dn[i];
+			}
+		}
+		return;
+	}
+
+	// the cell of the value, the outer markers follow the extremes
+	if(x < e->q[0]) {
+		e->q[0] = x;
+		k = 0;
+	}
+	else if(x >= e->q[4]) {
+		e->q[4] = x;
+		k = 3;
+	}
+	else {
+		for(k = 0; k < 3 && x >= e->q[k + 1]; k++);
+	}
+
+	for(i = k + 1; i < 5; i++) {
+		e->pos[i]++;
+	}
+	for(i = 0; i < 5; i++) {
+		e->want[i] += dn[i];
+	}
+	e->count++;
+
+	// the middle markers move by one towards where they should be
+	for(i = 1; i < 4; i++) {
+		t = e->want[i] - e->pos[i];
+		if((t >= 1 && e->pos[i + 1] - e->pos[i] > 1) ||
+			(t <= -1 && e->pos[i - 1] - e->pos[i] < -1)) {
+			d = (t > 0) ? 1 : -1;
+
+			// piecewise parabolic, linear if that leaves the neighbors
+			qp = e->q[i] + d / (e->pos[i + 1] - e->pos[i - 1]) *
+				((e->pos[i] - e->pos[i - 1] + d) * (e->q[i + 1] - e->q[i]) /
+				(e->pos[i + 1] - e->pos[i]) +
+				(e->pos[i + 1] - e->pos[i] - d) * (e->q[i] - e->q[i - 1]) /
+				(e->pos[i] - e->pos[i - 1]));
+			if(qp <= e->q[i - 1] || qp >= e->q[i + 1]) {
+				qp = e->q[i] + d * (e->q[i + d] - e->q[i]) / (e->pos[i + d] - e->pos[i]);
+			}
+			e->q[i] = qp;
+			e->pos[i] += d;
+		}
+	}
+}
+
+/**
+* the current estimate, the nearest rank of the values while there are fewer than five
+*/
+static double p2_value(P2Quantile *e)
+{
+	int i, k;
+	double t, q[5];
+
+	if(e->count == 0) {
+		return 0;
+	}
+	if(e->count >= 5) {
+		return e->q[2];
+	}
+
+	memcpy(q, e->q, sizeof(q));
+	for(i = 1; i < e->count; i++) {
+		for(k = i; k > 0 && q[k - 1] > q[k]; k--) {
+			t = q[k];
+			q[k] = q[k - 1];
+			q[k - 1] = t;
+		}
+	}
+	k = (int) ceil(e->p * e->count) - 1;
+
+	return q[(k < 0) ? 0 : k];
+}
+
+static void stat_init(StreamStat *s)
+{
+	memset(s, 0, sizeof(StreamStat));
+	p2_init(&s->p50, 0.5);
+	p2_init(&s->p99, 0.99);
+	p2_init(&s->p999, 0.999);
+}
+
+static void stat_add(StreamStat *s, double x, int img)
+{
+	double delta;
+
+	s->n++;
+	delta = x - s->mean;
+	s->mean += delta / s->n;
+	s->m2 += delta * (x - s->mean);
+
+	if(s->n == 1 || x < s->min) {
+		s->min = x;
+		s->min_img = img;
+	}
+	if(s->n == 1 || x > s->max) {
+		s->max = x;
+		s->max_img = img;
+	}
+
+	p2_add(&s->p50, x);
+	p2_add(&s->p99, x);
+	p2_add(&s->p999, x);
+}
+
+static void stat_print(StreamStat *s, const char *name)
+{
+	double std = (s->n > 1) ? sqrt(s->m2 / (s->n - 1)) : 0;
+
+	printf("  %-8s mean %9.2f std %8.2f p50 %9.2f p99 %9.2f p999 %9.2f "
+		"min %9.2f (%d) max %9.2f (%d)\n", name, s->mean, std, p2_value(&s->p50),
+		p2_value(&s->p99), p2_value(&s->p999), s->min, s->min_img, s->max, s->max_img);
+}
+
+/**
+* starts the statistics of a run
+*
+* @param s the StreamStats to clear
+* @param freq the frequency of the performance counter
+*/
+
+void stream_init(StreamStats *s, LARGE_INTEGER freq)
+{
+	memset(s, 0, sizeof(StreamStats));
+	s->us = 1e6 / freq.QuadPart;
+	stat_init(&s->latency);
+	stat_init(&s->period);
+	stat_init(&s->grab);
+	stat_init(&s->thresh);
+	stat_init(&s->track);
+	QueryPerformanceCounter(&s->start);
+}
+
+/**
+* adds the times of an image to the statistics
+*
+* @param s the StreamStats of the run
+* @param frame the times of the image, filled in like <code>time_run</code> does,
+* which can be reused for the next image afterwards
+*/
+
+void stream_add(StreamStats *s, FrameInfo *frame)
+{
+	int img = frame->img;
+
+	stat_add(&s->latency, (frame->blob_stop.QuadPart - frame->grab_stop.QuadPart) * s->us, img);
+	stat_add(&s->grab, (frame->grab_stop.QuadPart - frame->grab_start.QuadPart) * s->us, img);
+	stat_add(&s->thresh, (frame->thresh_stop.QuadPart - frame->thresh_start.QuadPart) * s->us,
+		img);
+	stat_add(&s->track, (frame->blob_stop.QuadPart - frame->blob_start.QuadPart) * s->us, img);
+	if(s->last_ts.QuadPart != 0) {
+		stat_add(&s->period, (frame->pc_ts.QuadPart - s->last_ts.QuadPart) * s->us, img);
+	}
+	s->last_ts = frame->pc_ts;
+
+	s->imgs++;
+	if(frame->blob_found == OBJECT_FOUND) {
+		s->found++;
+	}
+}
+
+/**
+* prints the statistics of the images so far
+*
+* @param s the StreamStats of the run
+* @param label what the block is, like "checkpoint" or "run"
+*/
+
+void stream_print(StreamStats *s, const char *label)
+{
+	LARGE_INTEGER now;
+	double elapsed;
+
+	QueryPerformanceCounter(&now);
+	elapsed = (now.QuadPart - s->start.QuadPart) * s->us;
+
+	printf("stream: %s after %.0f s: %I64d images, %I64d found, %.1f fps\n", label,
+		elapsed / 1e6, s->imgs, s->found,
+		(s->period.mean > 0) ? 1e6 / s->period.mean : 0);
+	stat_print(&s->latency, "latency");
+	stat_print(&s->period, "period");
+	stat_print(&s->grab, "grab");
+	stat_print(&s->thresh, "thresh");
+	stat_print(&s->track, "track");
+	fflush(stdout);
+}
@@ -12,6 +12,10 @@
 * tight loop.  At the end of each run the results are printed to stdout, which can then
 * be piped to a file or another program for further processing.
 *
+* with STREAM_STATS set the images are summarized by a StreamStats as they come in and
+* only one FrameInfo is kept, so the run can be as long as a soak test needs.  A
+* <code>num_imgs</code> of 0 then runs until a key is pressed.
+*
 * @param tseq the TrackingSequence specifying the active ROIs and their initial positions
 * in the image prior to tracking an object
 * @param t the threshold value to be used with <code>threshold</code>
@@ -23,16 +27,19 @@
 int time_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double exposure)
 {
 	int rc;
-	int img_nr, prev_nr, total_imgs;
-	int cur_win;
+	int img_nr, prev_nr, total_imgs, n;
+	const int *rois;
 	TrackingWindow *cur;
 	TimingInfo timer;
+	FrameInfo *f;
+#if STREAM_STATS
+	StreamStats stats;
+#endif
 
+	FrameView view;
 #if ONLINE
 	Fg_Struct *fg = NULL;
-#else
-	IplImage *faux_fg = NULL;
-	unsigned char *data = NULL;
+	FrameRing ring;
 #endif
 
 	if(tseq->seq_len < MIN_SEQ_LEN) {
@@ -42,11 +49,10 @@ int time_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double e
 
 	// initialize parameters
 	rc = FG_OK;
-	cur_win = 0;
 	img_nr = 1;
 	prev_nr = 0;
 	total_imgs = 0;
-	cur = tseq->windows + tseq->seq[cur_win];
+	cur = tseq->windows + tseq->seq[0];
 
 	memset(&timer, 0, sizeof(TimingInfo));
 	timer.num_imgs = num_imgs;
@@ -54,7 +60,12 @@ int time_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double e
 	timer.roi_f = frame;
 	timer.roi_w = cur->roi_w;
 	timer.roi_h = cur->roi_h;
+#if STREAM_STATS
+	// every image is timed in the same record
+	timer.frame = (frame_info *) calloc(1, sizeof(FrameInfo));
+#else
 	timer.frame = (frame_info *) calloc(num_imgs, sizeof(FrameInfo));
+#endif
 	if(timer.frame == NULL) {
 		return ENOMEM;
 	}
@@ -62,65 +73,135 @@ int time_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double e
 		printf("main: no perfmance counter\n");
 		return ENODEV;
 	}
+	f = timer.frame;
+#if STREAM_STATS
+	stream_init(&stats, timer.freq);
+#endif
 
+	merge_start(tseq);
 #if ONLINE
 	rc = StartGrabbing(&fg, tseq, NULL);
 #else
-	rc = StartGrabbing(NULL, tseq, &data);
+	// the images were decoded into memory by replay_load at startup
+	rc = replay_start(tseq, frame);
 #endif
 	if(rc != FG_OK) {
 		return rc;
 	}
+#if ONLINE
+	rc = StartRing(&ring, fg, tseq);
+	if(rc != FG_OK) {
+		deinit_cam(fg);
+		return rc;
+	}
+#if APPLET_MOMENTS
+	rc = applet_threshold(default_cam(), t);
+	if(rc != FG_OK) {
+		deinit_cam(fg);
+		return rc;
+	}
+#endif
+#endif
 
 	// start image loop
 	QueryPerformanceCounter(&timer.loop_start);
-	while(total_imgs < num_imgs) {
-		cur = tseq->windows + tseq->seq[cur_win];
-		cur_win++;
-		cur_win %= tseq->seq_len;
+	while(total_imgs < num_imgs || (STREAM_STATS && num_imgs <= 0)) {
+		QueryPerformanceCounter(&(f->grab_start));
 #if ONLINE
-		QueryPerformanceCounter(&(timer.frame[total_imgs].grab_start));
-		img_nr = Fg_getLastPicNumberBlocking(fg, img_nr, PORT_A, TIMEOUT);
-		cur->img = (unsigned char *) Fg_getImagePtr(fg, img_nr, PORT_A);
-		QueryPerformanceCounter(&(timer.frame[total_imgs].grab_stop));
+		ring_next(&ring, &view, TIMEOUT);
 #else
-		GetNextImage(&faux_fg, img_nr, ANIMATION_NAME, ANIMATION_LENGTH, FALSE);
-		cur->img = data;
-		CopyImageToTrackingWindow(cur, faux_fg);
-		img_nr++;
+		replay_next(&view);
+#endif
+		// the image is tagged with its ROI, so skipped images keep the sequence;
+		// without an image the last window gets none and the loop stops
+		if(view.data != NULL) {
+			cur = tseq->windows + view.roi;
+		}
+		img_nr = view.img;
+		if(!merge_frame(tseq, cur, &view)) {
+			// the object of a guest is found in the image of its host
+#if ONLINE
+			ring_release(&ring, &view);
 #endif
+			continue;
+		}
+		QueryPerformanceCounter(&(f->grab_stop));
 
 		if(cur->img != NULL) {
+#if !APPLET_MOMENTS
+			// the pixels as they came, before the pass binarizes them
+			flight_put(cur, img_nr, t);
+#endif
 			// process image
-			QueryPerformanceCounter(&(timer.frame[total_imgs].thresh_start));
+#if FUSED_BLOB
+			// thresh times the fused pass, blob only times the ROI update
+			QueryPerformanceCounter(&(f->thresh_start));
+			// the same span as position() on the separate passes
+			TRACE_POINT(TRACE_POSITION_START);
+#if APPLET_MOMENTS
+			rc = applet_result(cur, (AppletResult *) view.data);
+#else
+			rc = change_blob(cur, t);
+#endif
+			QueryPerformanceCounter(&(f->thresh_stop));
+			
+			QueryPerformanceCounter(&(f->blob_start));
+			rc = update_position(cur, rc);
+			TRACE_POINT(TRACE_POSITION_STOP);
+			flight_result(cur, rc);
+			if(tseq->adapt) {
+				adapt_roi(cur, rc);
+			}
+			QueryPerformanceCounter(&(f->blob_stop));
+#if PUBLISH
+			write_comm(cur, rc);
+#endif
+#else
+			QueryPerformanceCounter(&(f->thresh_start));
 			threshold(cur, t);
-			QueryPerformanceCounter(&(timer.frame[total_imgs].thresh_stop));
+			QueryPerformanceCounter(&(f->thresh_stop));
 			
-			QueryPerformanceCounter(&(timer.frame[total_imgs].blob_start));
+			QueryPerformanceCounter(&(f->blob_start));
 			rc = position(cur);
-			QueryPerformanceCounter(&(timer.frame[total_imgs].blob_stop));
+			flight_result(cur, rc);
+			if(tseq->adapt) {
+				adapt_roi(cur, rc);
+			}
+			QueryPerformanceCounter(&(f->blob_stop));
+#if PUBLISH
+			write_comm(cur, rc);
+#endif
+#endif
 
+			// the guests of cur, and the ROIs of the frame grabber for the next images
+			merge_guests(tseq, cur, &view, t);
+			n = merge_plan(tseq, cur, &rois);
 #if ONLINE
-			write_roi(fg, cur->roi, img_nr, !DO_INIT);
+			write_rois(fg, rois, n, img_nr);
+			ring_release(&ring, &view);
 #endif
 
 			// record state
 			if(prev_nr != img_nr || img_nr < FG_OK) {
-				QueryPerformanceCounter(&(timer.frame[total_imgs].pc_ts));
-				timer.frame[total_imgs].img = img_nr;
-				timer.frame[total_imgs].blob_found = rc;
-				memcpy(&(timer.frame[total_imgs].win), cur, sizeof(TrackingWindow));
-#if ONLINE
-				// note: added after the fact, might cause delays (doubtful tho')
-				timer.frame[total_imgs].fg_ts = img_nr;
-				rc = Fg_getParameter(fg, FG_TIMESTAMP, 
-					&(timer.frame[total_imgs].fg_ts), PORT_A);
-				if(rc != FG_OK) {
-					timer.frame[total_imgs].fg_ts = rc;
-				}
-#endif
+				QueryPerformanceCounter(&(f->pc_ts));
+				f->img = img_nr;
+				f->blob_found = rc;
+				f->fg_ts = view.fg_ts;
 				prev_nr = img_nr;
 				total_imgs++;
+#if STREAM_STATS
+				stream_add(&stats, f);
+				if(total_imgs % STREAM_CHECKPOINT == 0) {
+					stream_print(&stats, "checkpoint");
+					if(num_imgs <= 0 && _kbhit()) {
+						_getch();
+						break;
+					}
+				}
+#else
+				memcpy(&(f->win), cur, sizeof(TrackingWindow));
+				f = timer.frame + total_imgs;
+#endif
 			}
 		}
 		else {
@@ -129,9 +210,37 @@ int time_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double e
 		}
 	}
 	QueryPerformanceCounter(&timer.loop_stop);
+#if ONLINE
+	if(ring.latest) {
+		printf("skipped %d images for newer ones of their ROI\n", ring.skipped);
+	}
+#endif
+	change_summary(tseq);
+	flight_summary(tseq);
+	merge_summary(tseq);
+#if STREAM_STATS
+	stream_print(&stats, "run");
+#if ONLINE
+	rc = deinit_cam(fg);
+	if(rc != FG_OK) {
+		printf("deinit: %s\n", Fg_getLastErrorDescription(fg));
+		return rc;
+	}
+#endif
+	free(timer.frame);
+
+	return (cur->img == NULL) ? !FG_OK : FG_OK;
+#endif
+	buffers_observe(&timer);
 
 #if ONLINE
+	bench_run(fg, &timer);
+	frametime_observe(&timer);
+#if BINARY_TRACE
+	WriteTimingTrace(fg, &timer);
+#else
 	PrintTimingData(fg, &timer);
+#endif
 
 	rc = deinit_cam(fg);
 	if(rc != FG_OK) {
@@ -142,11 +251,13 @@ int time_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double e
 	if(cur->img == NULL) {
 		return !FG_OK;
 	}
+#else
+	bench_run(NULL, &timer);
+#if BINARY_TRACE
+	WriteTimingTrace(NULL, &timer);
 #else
 	PrintTimingData(NULL, &timer);
-
-	cvReleaseImage(&faux_fg);
-	free(data);
+#endif
 #endif
 	free(timer.frame);
 
@@ -5,6 +5,8 @@
 
 from math import sqrt
 from sys import argv
+import mmap
+import struct
 
 # header info
 HEADER = '\t'.join([
@@ -78,7 +80,7 @@ def stats(x, n):
 	v = (ss - n * m * m) / (n - 1)
 	return (m, v)
 
-def data(params):
+def data(params, values):
 	"""Unpack data in table and store in params."""
 
 	(	img, 
@@ -100,7 +102,7 @@ def data(params):
 		blob_w, 
 		blob_h, 
 		blob_f
-	) = [long(i) for i in l.split()]
+	) = values
 
 	params['img_num'].append(img)
 	params['roi'].append(roi)
@@ -294,6 +296,51 @@ def output(params):
 
 	print '\t'.join([str(i) for i in s])
 
+# binary trace layout (see TraceHeader and TraceRecord in utils.cpp)
+TRACE_MAGIC = 'HSVT'
+TRACE_HEADER = struct.Struct('<4s5I6i5q2d2i')
+TRACE_RECORD = struct.Struct('<2i8q9i')
+
+def is_trace(name):
+	"""True if name is a binary trace written by WriteTimingTrace."""
+	f = open(name, 'rb')
+	magic = f.read(len(TRACE_MAGIC))
+	f.close()
+	return magic == TRACE_MAGIC
+
+def trace(name):
+	"""Read a binary trace written by WriteTimingTrace and print its results."""
+	f = open(name, 'rb')
+	m = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+	(	magic, version, header_size, record_size, run, num_imgs,
+		grabbed, lost, in_progress, act_img, last_img, next_img,
+		loop_s, loop_e, pc_freq, max_pc_ts, max_fg_ts,
+		frame, exposure, width, height
+	) = TRACE_HEADER.unpack_from(m, 0)
+	assert header_size == TRACE_HEADER.size, "trace header does not match parser."
+	assert record_size == TRACE_RECORD.size, "trace record does not match parser."
+
+	params = reset()
+	params['run'] = run
+	params['num_imgs'] = num_imgs
+	params['pc_freq'] = pc_freq
+	params['max_pc_ts'] = max_pc_ts
+	params['max_fg_ts'] = max_fg_ts
+	params['frame'] = frame
+	params['exposure'] = exposure
+	params['width'] = width
+	params['height'] = height
+	params['last_img'] = last_img
+	params['next_img'] = next_img
+
+	for i in xrange(num_imgs):
+		data(params, TRACE_RECORD.unpack_from(m, header_size + i * record_size))
+
+	m.close()
+	f.close()
+	output(params)
+
 # important lines in file
 IGNORE = 4
 RUN = 1
@@ -311,6 +358,12 @@ SOR = 19
 
 print HEADER
 
+# binary traces are one file per run
+if is_trace(argv[1]):
+	for name in argv[1:]:
+		trace(name)
+	raise SystemExit
+
 # parameters to parse out
 lnum = 0
 eor = 0
@@ -350,7 +403,7 @@ for l in f:
 
 	# parse data
 	elif lnum >= SOR and lnum < eor:
-		data(params)
+		data(params, [long(i) for i in l.split()])
 	
 	# output results
 	elif lnum == eor:
@@ -42,7 +42,10 @@
 * limitation in the Silicon Software API and the latter has been determined through 
 * observation.  If <code>win->roi_w</code> <= 8, then the camera hangs and does not 
 * send back any more images.  It has not been tested to see if this bug is only isolated
-* to the one desktop this code was developed on.
+* to the one desktop this code was developed on.  A <code>win->roi_w</code> that breaks
+* either is rounded down to a multiple of 4 and raised to ROI_MIN_W, and the ROI is
+* limited to the image.  Any height from 1 row up is kept, which is what the strips of
+* line.cpp need.
 *
 * @note it is important to reiterate that the updated ROI returned by this functions is 
 * NOT written to the frame grabber.  A call to <code>write_roi</code> is still required.
@@ -52,8 +55,22 @@ void set_roi_box(TrackingWindow *win, int x, int y)
 {
 	int rc, w, h;
 
-	w = win->roi_w;
+	w = win->roi_w & PIXEL_BOUNDARY;
+	if(w < ROI_MIN_W) {
+		w = ROI_MIN_W;
+	}
+	if(w > win->img_w) {
+		w = win->img_w & PIXEL_BOUNDARY;
+	}
 	h = win->roi_h;
+	if(h < 1) {
+		h = 1;
+	}
+	if(h > win->img_h) {
+		h = win->img_h;
+	}
+	win->roi_w = w;
+	win->roi_h = h;
 
 	x -= (w / 2);
 	y -= (h / 2);
@@ -81,7 +98,7 @@ void set_roi_box(TrackingWindow *win, int x, int y)
 
 	// x and width must be multples of 4 (see framegrabber doc)
 	// and width > 8 (observed limitation of camera)
-	rc = roi_window(win->roi, x, w, y, h);
+	rc = cam_roi_window(win->cam, win->roi, x, w, y, h);
 	assert(rc == FG_OK);
 }
 
@@ -285,19 +302,250 @@ int blob(TrackingWindow *win)
 	return OBJECT_FOUND;
 }
 
-int desperate(TrackingWindow *win)
+/**
+* updates the TrackingWindow's motion model with a new measurement and predicts how far
+* the object moves before the ROI being written is active.
+*
+* <code>predict_motion</code> runs one step of an alpha-beta filter, the fixed gain form
+* of a constant velocity Kalman filter, on the blob center measured in the image taken
+* at <code>win->ts</code>.  The ROI written now is used the next time the window comes
+* around in the ROI sequence, which is one sequence period after the image that was just
+* processed, so the prediction is made one period (the time since the last measurement)
+* ahead.
+*
+* @param win the TrackingWindow with the model to update and the image timestamp
+* @param x the measured x coordinate of the blob in the image reference frame
+* @param y the measured y coordinate of the blob in the image reference frame
+* @param lead_x set to how far the object is expected to move in x
+* @param lead_y set to how far the object is expected to move in y
+*
+* @note the lead is limited to half of the ROI, so a bad velocity estimate can not throw
+* the ROI further than the object could be found before the model had settled.
+*/
+
+static void predict_motion(TrackingWindow *win, int x, int y, int *lead_x, int *lead_y)
 {
-	return !OBJECT_FOUND;
+	double dt, rx, ry;
+	MotionModel *m = &win->motion;
+
+	*lead_x = 0;
+	*lead_y = 0;
+
+	// nothing to extrapolate from on the first sighting or without a usable timestamp
+	if(!m->valid || win->ts <= m->ts) {
+		m->valid = 1;
+		m->ts = win->ts;
+		m->x = x;
+		m->y = y;
+		m->vx = 0;
+		m->vy = 0;
+		return;
+	}
+
+	dt = (double) (win->ts - m->ts);
+	m->ts = win->ts;
+	m->dt = dt;
+
+	// predict to the time of the measurement and correct with the residual
+	m->x += m->vx * dt;
+	m->y += m->vy * dt;
+	rx = x - m->x;
+	ry = y - m->y;
+	m->x += PREDICT_ALPHA * rx;
+	m->y += PREDICT_ALPHA * ry;
+	m->vx += PREDICT_BETA * rx / dt;
+	m->vy += PREDICT_BETA * ry / dt;
+
+	*lead_x = cvRound(m->x + m->vx * dt) - x;
+	*lead_y = cvRound(m->y + m->vy * dt) - y;
+
+	if(*lead_x > win->roi_w / 2) {
+		*lead_x = win->roi_w / 2;
+	}
+	if(*lead_x < -win->roi_w / 2) {
+		*lead_x = -win->roi_w / 2;
+	}
+	if(*lead_y > win->roi_h / 2) {
+		*lead_y = win->roi_h / 2;
+	}
+	if(*lead_y < -win->roi_h / 2) {
+		*lead_y = -win->roi_h / 2;
+	}
 }
 
+/**
+* the first stage of the search for a lost object, searches the whole ROI.
+*
+* the object is most likely still in the ROI but has left the padded blob box (or the
+* box was set up wrong), so the blob box is widened to the whole ROI.
+*
+* @param win the TrackingWindow that lost its object
+*
+* @return <code>!OBJECT_FOUND</code>
+*/
+
 int panic(TrackingWindow *win)
 {
+	win->blob_xmin = 0;
+	win->blob_ymin = 0;
+	win->blob_xmax = win->roi_w;
+	win->blob_ymax = win->roi_h;
+
 	return !OBJECT_FOUND;
 }
 
-int reposition(TrackingWindow *ref, TrackingWindow *cur)
+/**
+* the second stage of the search for a lost object, grows the ROI.
+*
+* the ROI is grown to <code>roi_max_w</code> x <code>roi_max_h</code> around its current
+* center and given the frame time of that size, like <code>adapt_roi</code> does, and
+* the whole ROI is searched.  A ROI that already has the largest size is only widened.
+*
+* @param win the TrackingWindow that lost its object
+*
+* @return <code>!OBJECT_FOUND</code>
+*/
+
+int desperate(TrackingWindow *win)
 {
-	return !OBJECT_FOUND;
+	int cx, cy;
+
+	if(win->roi_max_w > win->roi_w || win->roi_max_h > win->roi_h) {
+		cx = win->roi_xoff + win->roi_w / 2;
+		cy = win->roi_yoff + win->roi_h / 2;
+		if(win->roi_max_w > win->roi_w) {
+			win->roi_w = win->roi_max_w;
+		}
+		if(win->roi_max_h > win->roi_h) {
+			win->roi_h = win->roi_max_h;
+		}
+		set_roi_box(win, cx, cy);
+		win->stable = 0;
+
+		if(win->max_frame > 0) {
+			cam_roi_exposure(win->cam, win->roi, win->exposure, win->max_frame);
+		}
+	}
+
+	return panic(win);
+}
+
+/**
+* the tiles of the image search
+*
+* the tiles are as large as the ROI and overlap by twice <code>ROI_PAD</code>, so an
+* object on the edge of one tile is whole in the next.
+*/
+static void scan_grid(TrackingWindow *win, int *step_x, int *step_y, int *cols, int *rows)
+{
+	*step_x = win->roi_w - 2 * ROI_PAD;
+	*step_y = win->roi_h - 2 * ROI_PAD;
+	if(*step_x < 4) {
+		*step_x = win->roi_w;
+	}
+	if(*step_y < 1) {
+		*step_y = win->roi_h;
+	}
+
+	*cols = 1;
+	*rows = 1;
+	if(win->img_w > win->roi_w) {
+		*cols = (win->img_w - win->roi_w + *step_x - 1) / *step_x + 1;
+	}
+	if(win->img_h > win->roi_h) {
+		*rows = (win->img_h - win->roi_h + *step_y - 1) / *step_y + 1;
+	}
+}
+
+/**
+* the last stage of the search for a lost object, moves the ROI to where the object
+* may be.
+*
+* the ROI is moved to the next tile of a search of the whole image, which starts at the
+* tile where the object was lost and goes on row by row, so every part of the image is
+* seen once every few sequence periods.  The whole ROI is searched.
+*
+* @param cur the TrackingWindow that lost its object
+*
+* @return <code>!OBJECT_FOUND</code>
+*
+* @note the search uses the ROI of the lost window instead of a spare ROI, so the ROI
+* sequence and the timing of the other ROIs are not changed while it runs.
+*/
+
+int reposition(TrackingWindow *cur)
+{
+	int k, step_x, step_y, cols, rows;
+
+	scan_grid(cur, &step_x, &step_y, &cols, &rows);
+	k = cur->scan % (cols * rows);
+	cur->scan = k + 1;
+
+	// set_roi_box keeps the tiles on the last row and column inside the image
+	set_roi_box(cur, (k % cols) * step_x + cur->roi_w / 2, (k / cols) * step_y + cur->roi_h / 2);
+
+	return panic(cur);
+}
+
+/**
+* advances the search for a lost object by one image
+*
+* @see RECOVER_LOST
+*/
+static int recover(TrackingWindow *cur)
+{
+	int x, y, step_x, step_y, cols, rows;
+	LONG hint;
+
+	// a search window saw the object, look there first
+	hint = InterlockedExchange(&cur->hint, 0);
+	if(hint != 0) {
+		set_roi_box(cur, SEARCH_HINT_X(hint), SEARCH_HINT_Y(hint));
+		cur->lost_imgs = 0;
+		cur->lost = RECOVER_WIDEN;
+		return panic(cur);
+	}
+
+	cur->lost_imgs++;
+	if(cur->lost_imgs <= RECOVER_WIDEN_IMGS) {
+		cur->lost = RECOVER_WIDEN;
+		return panic(cur);
+	}
+
+	if(cur->lost_imgs <= RECOVER_WIDEN_IMGS + RECOVER_GROW_IMGS) {
+		cur->lost = RECOVER_GROW;
+		return desperate(cur);
+	}
+
+	if(cur->lost != RECOVER_SCAN) {
+		// start looking where the object was lost
+		cur->lost = RECOVER_SCAN;
+		scan_grid(cur, &step_x, &step_y, &cols, &rows);
+		x = (cur->roi_xoff + cur->roi_w / 2) / step_x;
+		y = (cur->roi_yoff + cur->roi_h / 2) / step_y;
+		cur->scan = ((y < rows) ? y : rows - 1) * cols + ((x < cols) ? x : cols - 1);
+	}
+
+	return reposition(cur);
+}
+
+/**
+* hands the image of a FrameView to the TrackingWindow of its ROI.
+*
+* the frame grabber packs the pixels of a ROI, so the rows of a DMA buffer are
+* <code>roi_w</code> bytes apart.  A window that is a part of a larger image instead
+* sets <code>img</code> and <code>img_step</code> itself.
+*
+* @param win the TrackingWindow of the ROI that captured the image
+* @param view the image, its data is NULL if there is none
+*/
+
+void window_frame(TrackingWindow *win, FrameView *view)
+{
+	win->img = view->data;
+	win->img_step = win->roi_w;
+	win->ts = view->fg_ts;
+	win->exp_us = view->exp_us;
 }
 
 /**
@@ -316,14 +564,142 @@ int reposition(TrackingWindow *ref, TrackingWindow *cur)
 * blob's bounding box. Careful modification of these two functions may improve the 
 * tracking capabilities of the vision system with more complex algorithms that still 
 * meet the desired timing constraints.
+*
+* @note when <code>LABEL_BLOBS</code> is set the blob is the largest connected component
+* found by <code>position_blobs</code> instead.
 */
 
 int position(TrackingWindow *cur)
 {
-	int old_xoff, old_yoff, blob_cx, blob_cy;
+	int rc;
+#if LABEL_BLOBS
+	BlobList list;
+#endif
+	PMC_SAMPLE(pmc);
+
+	TRACE_POINT(TRACE_POSITION_START);
+	PMC_BEGIN(pmc);
+#if LABEL_BLOBS
+	rc = position_blobs(cur, &list);
+#elif PACKED_MORPH
+	rc = update_position(cur, packed_blob(cur));
+#else
+	rc = update_position(cur, blob(cur));
+#endif
+	PMC_END(PMC_POSITION, cur->roi, pmc);
+	TRACE_POINT(TRACE_POSITION_STOP);
+
+	return rc;
+}
 
-	if(blob(cur) != OBJECT_FOUND) {
-		return panic(cur);
+/**
+* a version of <code>position</code> that also returns every object in the ROI.
+*
+* <code>position_blobs</code> labels the connected components inside the blob rectangle
+* with <code>label_blobs</code> and centers the ROI on the largest one.  The rest of the
+* components are left in <code>list</code>, so several objects can be followed with one
+* ROI instead of using one of the <code>MAX_ROI</code> ROIs per object.
+*
+* @param cur the current TrackingWindow to update with new position information
+* @param list updated with the components found in the ROI, in the ROI reference frame
+* of the image that was searched
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else 
+* <code>!OBJECT_FOUND</code>
+*
+* @see label.cpp
+*/
+
+int position_blobs(TrackingWindow *cur, BlobList *list)
+{
+	int rc;
+
+	rc = label_blobs(cur, list);
+	if(rc == OBJECT_FOUND) {
+		rc = select_blob(cur, list, 0);
+	}
+
+	return update_position(cur, rc);
+}
+
+/**
+* keeps the bounding box of the blob as it was found in the image.
+*
+* <code>update_position</code> moves the box to where the object is expected the next
+* time and pads it, so what <code>write_comm</code> publishes is taken before that.
+*
+* @param win the TrackingWindow with a tight bounding box around the blob
+*/
+
+void seen_blob(TrackingWindow *win)
+{
+	win->seen_x = win->roi_xoff + (win->blob_xmin + win->blob_xmax) / 2;
+	win->seen_y = win->roi_yoff + (win->blob_ymin + win->blob_ymax) / 2;
+	win->seen_w = win->blob_xmax - win->blob_xmin;
+	win->seen_h = win->blob_ymax - win->blob_ymin;
+}
+
+/**
+* the second half of <code>position</code> for when the blob's bounding box is already
+* known.
+*
+* <code>update_position</code> centers the ROI around the blob's bounding box and pads
+* the box for the next time the TrackingWindow is active.  It is meant to be called
+* right after <code>threshold_blob</code>, which finds the bounding box while it 
+* binarizes the image, so that the pixels are not walked a second time by 
+* <code>blob</code>.
+*
+* @param cur the current TrackingWindow with a tight bounding box around the blob
+* @param found the result of the search for the blob, <code>OBJECT_FOUND</code> if the
+* bounding box in <code>cur</code> is valid
+*
+* @return if an object is found then <code>OBJECT_FOUND</code>, else 
+* <code>!OBJECT_FOUND</code>
+*
+* @note when <code>PREDICT_ROI</code> is set the ROI is centered on where the object is
+* predicted to be the next time the ROI is active rather than on the blob, which needs
+* <code>cur->ts</code> to be set to the timestamp of the image.
+*
+* @note when <code>RECOVER_LOST</code> is set and the object was not found, the ROI is
+* set up for the next stage of the search: <code>panic</code> for the first
+* <code>RECOVER_WIDEN_IMGS</code> images, then <code>desperate</code> for the next
+* <code>RECOVER_GROW_IMGS</code> images and <code>reposition</code> after that.  A
+* <code>hint</code> left by a search window moves the ROI to it first.
+*
+* @note the image of a search window, one with <code>tracks</code> set, goes to
+* <code>search_position</code> instead.
+*
+* @see threshold_blob
+* @see predict_motion
+* @see search.cpp
+*/
+
+int update_position(TrackingWindow *cur, int found)
+{
+	int old_xoff, old_yoff, blob_cx, blob_cy, lead_x, lead_y, rigid_x, rigid_y;
+
+	if(found == OBJECT_FOUND) {
+		seen_blob(cur);
+	}
+
+	if(cur->tracks != NULL) {
+		return search_position(cur, found);
+	}
+
+	if(found != OBJECT_FOUND) {
+		// the next sighting starts a new track
+		cur->motion.valid = 0;
+#if RECOVER_LOST
+		return recover(cur);
+#else
+		return !OBJECT_FOUND;
+#endif
+	}
+	cur->lost = RECOVER_NONE;
+	cur->lost_imgs = 0;
+	if(cur->hint != 0) {
+		// the object was found before the hint came
+		InterlockedExchange(&cur->hint, 0);
 	}
 
 	old_xoff = cur->roi_xoff;
@@ -332,14 +708,169 @@ int position(TrackingWindow *cur)
 	// center roi around blob "center"
 	blob_cx = old_xoff + (cur->blob_xmax + cur->blob_xmin) / 2;
 	blob_cy = old_yoff + (cur->blob_ymax + cur->blob_ymin) / 2;
-	set_roi_box(cur, blob_cx, blob_cy);
+
+	lead_x = 0;
+	lead_y = 0;
+#if PREDICT_ROI
+	predict_motion(cur, blob_cx, blob_cy, &lead_x, &lead_y);
+	// the pose of the object predicts a marker of a rigid body better than the marker
+	if(cur->body != NULL && rigid_predict(cur, blob_cx, blob_cy, &rigid_x, &rigid_y)) {
+		lead_x = rigid_x;
+		lead_y = rigid_y;
+	}
+#endif
+	set_roi_box(cur, blob_cx + lead_x, blob_cy + lead_y);
 	
-	// adjust coords of blob
+	// adjust coords of blob, it is expected to have moved by the lead as well
+	cur->blob_xmin -= (cur->roi_xoff - old_xoff - lead_x);
+	cur->blob_ymin -= (cur->roi_yoff - old_yoff - lead_y);
+	cur->blob_xmax -= (cur->roi_xoff - old_xoff - lead_x);
+	cur->blob_ymax -= (cur->roi_yoff - old_yoff - lead_y);
+	pad_blob_region(cur);
+
+	// the prediction was clamped at the image border and left the blob outside the roi
+	if(cur->blob_xmin >= cur->roi_w || cur->blob_ymin >= cur->roi_h ||
+		cur->blob_xmax <= 0 || cur->blob_ymax <= 0) {
+		cur->blob_xmin = 0;
+		cur->blob_ymin = 0;
+		cur->blob_xmax = cur->roi_w;
+		cur->blob_ymax = cur->roi_h;
+	}
+
+	return OBJECT_FOUND;
+}
+
+/**
+* rounds a ROI size up to a multiple of 4 and limits it to [ADAPT_MIN_SIZE, max]
+*/
+static int adapt_size(int size, int max)
+{
+	size = (size + 3) & PIXEL_BOUNDARY;
+
+	if(size < ADAPT_MIN_SIZE) {
+		size = ADAPT_MIN_SIZE;
+	}
+	if(size > max) {
+		size = max;
+	}
+
+	return size;
+}
+
+/**
+* resizes the TrackingWindow's ROI to fit the object and sets the frame time to match.
+*
+* <code>adapt_roi</code> is meant to be called right after <code>position</code> (or
+* <code>update_position</code>) when <code>TrackingSequence.adapt</code> is set.  The
+* ROI needs to fit the padded blob, the distance the object is predicted to move before
+* the ROI is active on either side and <code>ADAPT_MARGIN</code>.  A ROI that is too
+* small for that, or whose object was lost, grows at once up to
+* <code>roi_max_w</code> x <code>roi_max_h</code>.  A ROI that has been larger than
+* needed for <code>ADAPT_STABLE</code> images in a row shrinks by
+* <code>ADAPT_STEP</code>, so one noisy image does not shrink it.  A marker of a
+* RigidBody only needs the error of the pose around it instead of its motion, see
+* rigid.cpp.
+*
+* smaller ROIs transfer fewer pixels, so the frame time is scaled by the ROI's share of
+* the pixels in the largest ROI, but never below the exposure time.
+*
+* @param cur the TrackingWindow updated by <code>position</code>
+* @param found the result of <code>position</code>
+*
+* @return <code>FG_OK</code> if the ROI kept its size or was resized, otherwise the error
+* from <code>roi_exposure</code>
+*
+* @note the ROI is never grown past <code>roi_max_w</code> x <code>roi_max_h</code>,
+* which should be the size the frame grabber buffers were allocated for.  Like the
+* rest of the ROI parameters, the new size and frame time have to be sent with
+* <code>write_roi</code>.
+*/
+
+int adapt_roi(TrackingWindow *cur, int found)
+{
+	int w, h, cx, cy, old_xoff, old_yoff, margin;
+	double lead_x = 0, lead_y = 0, frame;
+
+	// a search window keeps its size
+	if(cur->tracks != NULL) {
+		return FG_OK;
+	}
+
+	if(found != OBJECT_FOUND) {
+		w = cur->roi_max_w;
+		h = cur->roi_max_h;
+	}
+	else if(cur->body != NULL && rigid_margin(cur, &margin)) {
+		// the ROI is centered on the marker to within the error of the model
+		w = adapt_size(cur->blob_xmax - cur->blob_xmin + 2 * margin, cur->roi_max_w);
+		h = adapt_size(cur->blob_ymax - cur->blob_ymin + 2 * margin, cur->roi_max_h);
+	}
+	else {
+		if(cur->motion.valid) {
+			lead_x = fabs(cur->motion.vx * cur->motion.dt);
+			lead_y = fabs(cur->motion.vy * cur->motion.dt);
+		}
+
+		w = cur->blob_xmax - cur->blob_xmin + (int) (2 * (lead_x + ADAPT_MARGIN));
+		h = cur->blob_ymax - cur->blob_ymin + (int) (2 * (lead_y + ADAPT_MARGIN));
+		w = adapt_size(w, cur->roi_max_w);
+		h = adapt_size(h, cur->roi_max_h);
+	}
+
+	if(w > cur->roi_w || h > cur->roi_h) {
+		// grow right away, the object is about to get away
+		w = w > cur->roi_w ? w : cur->roi_w;
+		h = h > cur->roi_h ? h : cur->roi_h;
+		cur->stable = 0;
+	}
+	else if(w + ADAPT_STEP <= cur->roi_w || h + ADAPT_STEP <= cur->roi_h) {
+		cur->stable++;
+		if(cur->stable < ADAPT_STABLE) {
+			return FG_OK;
+		}
+
+		w = (w + ADAPT_STEP <= cur->roi_w) ? cur->roi_w - ADAPT_STEP : cur->roi_w;
+		h = (h + ADAPT_STEP <= cur->roi_h) ? cur->roi_h - ADAPT_STEP : cur->roi_h;
+		cur->stable = 0;
+	}
+	else {
+		cur->stable = 0;
+		return FG_OK;
+	}
+
+	// resize around the current center and move the blob into the new ROI frame
+	old_xoff = cur->roi_xoff;
+	old_yoff = cur->roi_yoff;
+	cx = old_xoff + cur->roi_w / 2;
+	cy = old_yoff + cur->roi_h / 2;
+
+	cur->roi_w = w;
+	cur->roi_h = h;
+	set_roi_box(cur, cx, cy);
+
 	cur->blob_xmin -= (cur->roi_xoff - old_xoff);
 	cur->blob_ymin -= (cur->roi_yoff - old_yoff);
 	cur->blob_xmax -= (cur->roi_xoff - old_xoff);
 	cur->blob_ymax -= (cur->roi_yoff - old_yoff);
 	pad_blob_region(cur);
 
-	return OBJECT_FOUND;
+	if(found != OBJECT_FOUND || cur->blob_xmin >= cur->blob_xmax || 
+		cur->blob_ymin >= cur->blob_ymax) {
+		cur->blob_xmin = 0;
+		cur->blob_ymin = 0;
+		cur->blob_xmax = cur->roi_w;
+		cur->blob_ymax = cur->roi_h;
+	}
+
+	// no frame time to scale when the images come from disk
+	if(cur->max_frame <= 0) {
+		return FG_OK;
+	}
+
+	frame = cur->max_frame * ((double) (w * h) / (cur->roi_max_w * cur->roi_max_h));
+	if(frame < cur->exposure) {
+		frame = cur->exposure;
+	}
+
+	return cam_roi_exposure(cur->cam, cur->roi, cur->exposure, frame);
 }
\ No newline at end of file
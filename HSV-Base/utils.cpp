@@ -6,20 +6,20 @@
 #include <string.h>
 #include "fcdynamic.h"
 
-#define NUM_BUFFERS 16
-#define MEMSIZE(w, h) ((w) * (h) * NUM_BUFFERS)
-
 #define NO_LINLOG 0
 #define USELINLOG NO_LINLOG
 #define LINLOG1 0
 #define LINLOG2  0
 #define COMP 0
-#define CAMLINK FG_CL_DUALTAP_8_BIT
 
 #define NOT_APPLICABLE -1
 #define TABLE_ENTRIES 19
 #define BUFFER_LEN 100
 
+#define TRACE_MAGIC "HSVT"
+#define TRACE_VERSION 1
+#define TRACE_NAME "run%03d.trc"
+
 static char *table_format[] = {
 	"image number",
 	"region of interest number",
@@ -44,6 +44,76 @@ static char *table_format[] = {
 
 static char anim_buffer[BUFFER_LEN];
 
+#pragma pack(push, 1)
+
+/**
+* the fixed size header at the start of a binary timing trace
+*
+* trace_header holds the same run summary <code>PrintTimingData</code> prints.  All
+* fields are little-endian and there is no padding, so the layout matches the
+* <code>TRACE_HEADER</code> format in timing_parser.py.
+*
+* @see WriteTimingTrace
+*/
+
+struct trace_header {
+	char magic[4]; /**< always <code>TRACE_MAGIC</code> */
+	unsigned int version;
+	unsigned int header_size; /**< sizeof(trace_header) */
+	unsigned int record_size; /**< sizeof(trace_record) */
+	unsigned int run;
+	unsigned int num_imgs; /**< the number of records following the header */
+
+	int grabbed_imgs;
+	int lost_imgs;
+	int imgs_in_progress;
+	int act_img;
+	int last_img;
+	int next_img;
+
+	__int64 loop_start;
+	__int64 loop_stop;
+	__int64 freq;
+	__int64 max_pc_ts;
+	__int64 max_fg_ts;
+
+	double frame;
+	double exposure;
+	int width;
+	int height;
+};
+
+/**
+* one row of the timing table, in the same order as <code>table_format</code>
+*/
+
+struct trace_record {
+	int img;
+	int roi;
+	__int64 pc_ts;
+	__int64 fg_ts;
+	__int64 grab_start;
+	__int64 grab_stop;
+	__int64 thresh_start;
+	__int64 thresh_stop;
+	__int64 blob_start;
+	__int64 blob_stop;
+	int roi_x;
+	int roi_y;
+	int roi_w;
+	int roi_h;
+	int blob_x;
+	int blob_y;
+	int blob_w;
+	int blob_h;
+	int blob_found;
+};
+
+#pragma pack(pop)
+
+typedef struct trace_header TraceHeader;
+typedef struct trace_record TraceRecord;
+
 /**
 * Grabs the n-th image from file
 *
@@ -126,19 +196,19 @@ int SetTrackCamParameters(TrackingWindow *win, double frame, double exposure)
 {
 	int rc;
 
-	rc = roi_window(win->roi, win->roi_xoff, win->roi_w, win->roi_yoff, win->roi_h);
+	rc = cam_roi_window(win->cam, win->roi, win->roi_xoff, win->roi_w, win->roi_yoff, win->roi_h);
 	if(rc != FG_OK) {
 		printf("main: invalid window parameter(s).\n");
 		return rc;
 	}
 
-	rc = roi_exposure(win->roi, exposure, frame);
+	rc = cam_roi_exposure(win->cam, win->roi, exposure, frame);
 	if(rc != FG_OK) {
 		printf("main: invalid exposure parameter(s).\n");
 		return rc;
 	}
 
-	rc = roi_linlog(win->roi, USELINLOG, LINLOG1, LINLOG2, COMP);
+	rc = cam_roi_linlog(win->cam, win->roi, USELINLOG, LINLOG1, LINLOG2, COMP);
 	if(rc != FG_OK) {
 		printf("main: invalid linlog parameter(s).\n");
 		return rc;
@@ -249,17 +319,17 @@ void PrintTimingData(Fg_Struct *fg, TimingInfo *timer)
 	printf("number of images: %d\n", timer->num_imgs);
 	if(fg != NULL) {
 		printf("number of grabbed images: %d\n", 
-			Fg_getStatus(fg, NUMBER_OF_GRABBED_IMAGES, 0, PORT_A));
+			cam_status(fg, NUMBER_OF_GRABBED_IMAGES, PORT_A));
 		printf("number of lost images: %d\n", 
-			Fg_getStatus(fg, NUMBER_OF_LOST_IMAGES, 0, PORT_A));
+			cam_status(fg, NUMBER_OF_LOST_IMAGES, PORT_A));
 		printf("number of images in progress: %d\n", 
-			Fg_getStatus(fg, NUMBER_OF_IMAGES_IN_PROGRESS, 0, PORT_A));
+			cam_status(fg, NUMBER_OF_IMAGES_IN_PROGRESS, PORT_A));
 		printf("number of recently acquired image: %d\n",
-			Fg_getStatus(fg, NUMBER_OF_ACT_IMAGE, 0, PORT_A));
+			cam_status(fg, NUMBER_OF_ACT_IMAGE, PORT_A));
 		printf("number of last get image: %d\n", 
-			Fg_getStatus(fg, NUMBER_OF_LAST_IMAGE, 0, PORT_A));
+			cam_status(fg, NUMBER_OF_LAST_IMAGE, PORT_A));
 		printf("number of next get image: %d\n", 
-			Fg_getStatus(fg, NUMBER_OF_NEXT_IMAGE, 0, PORT_A));
+			cam_status(fg, NUMBER_OF_NEXT_IMAGE, PORT_A));
 	}
 	else {
 		// for compatibility with parsers
@@ -317,6 +387,127 @@ void PrintTimingData(Fg_Struct *fg, TimingInfo *timer)
 	printf("\n");
 }
 
+/**
+* writes the timing data of a run to a binary trace file
+*
+* WriteTimingTrace is a faster alternative to <code>PrintTimingData</code> for long runs.
+* Instead of formatting every frame with printf, the TimingInfo is copied into a
+* memory-mapped file as a <code>TraceHeader</code> followed by one
+* <code>TraceRecord</code> per frame.  Each run is written to its own file named after
+* <code>TRACE_NAME</code>, which timing_parser.py reads the same way it reads the
+* printed tables.  If images were not grabbed from the TrackCam camera set fg = NULL.
+*
+* @param fg the frame grabber structure (see Silicon Software SDK doc), which can be NULL
+* @param timer the data structure containing all of the relevant timing information
+*
+* @return <code>FG_OK</code> on success, <code>EIO</code> if the trace file could not
+* be created
+*
+* @see PrintTimingData
+* @see BINARY_TRACE
+*/
+
+int WriteTimingTrace(Fg_Struct *fg, TimingInfo *timer)
+{
+	static int run = 0;
+	int i;
+	DWORD size;
+	HANDLE file, map;
+	char name[BUFFER_LEN];
+	TraceHeader *hdr;
+	TraceRecord *rec;
+	FrameInfo *frame = timer->frame;
+
+	run++;
+	sprintf_s(name, BUFFER_LEN, TRACE_NAME, run);
+	size = sizeof(TraceHeader) + timer->num_imgs * sizeof(TraceRecord);
+
+	file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		printf("trace: could not create %s\n", name);
+		return EIO;
+	}
+
+	map = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, size, NULL);
+	if(map == NULL) {
+		printf("trace: could not map %s\n", name);
+		CloseHandle(file);
+		return EIO;
+	}
+
+	hdr = (TraceHeader *) MapViewOfFile(map, FILE_MAP_WRITE, 0, 0, size);
+	if(hdr == NULL) {
+		printf("trace: could not map %s\n", name);
+		CloseHandle(map);
+		CloseHandle(file);
+		return EIO;
+	}
+
+	// header
+	memcpy(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic));
+	hdr->version = TRACE_VERSION;
+	hdr->header_size = sizeof(TraceHeader);
+	hdr->record_size = sizeof(TraceRecord);
+	hdr->run = run;
+	hdr->num_imgs = timer->num_imgs;
+	if(fg != NULL) {
+		hdr->grabbed_imgs = cam_status(fg, NUMBER_OF_GRABBED_IMAGES, PORT_A);
+		hdr->lost_imgs = cam_status(fg, NUMBER_OF_LOST_IMAGES, PORT_A);
+		hdr->imgs_in_progress = cam_status(fg, NUMBER_OF_IMAGES_IN_PROGRESS, PORT_A);
+		hdr->act_img = cam_status(fg, NUMBER_OF_ACT_IMAGE, PORT_A);
+		hdr->last_img = cam_status(fg, NUMBER_OF_LAST_IMAGE, PORT_A);
+		hdr->next_img = cam_status(fg, NUMBER_OF_NEXT_IMAGE, PORT_A);
+	}
+	else {
+		hdr->grabbed_imgs = NOT_APPLICABLE;
+		hdr->lost_imgs = NOT_APPLICABLE;
+		hdr->imgs_in_progress = NOT_APPLICABLE;
+		hdr->act_img = NOT_APPLICABLE;
+		hdr->last_img = NOT_APPLICABLE;
+		hdr->next_img = NOT_APPLICABLE;
+	}
+	hdr->loop_start = timer->loop_start.QuadPart;
+	hdr->loop_stop = timer->loop_stop.QuadPart;
+	hdr->freq = timer->freq.QuadPart;
+	hdr->max_pc_ts = LLONG_MAX;
+	hdr->max_fg_ts = ULONG_MAX;
+	hdr->frame = timer->roi_f;
+	hdr->exposure = timer->roi_e;
+	hdr->width = timer->roi_w;
+	hdr->height = timer->roi_h;
+
+	// frame data
+	rec = (TraceRecord *) (hdr + 1);
+	for(i = 0; i < timer->num_imgs; i++, rec++) {
+		rec->img = frame[i].img;
+		rec->roi = frame[i].win.roi;
+		rec->pc_ts = frame[i].pc_ts.QuadPart;
+		rec->fg_ts = (fg != NULL) ? frame[i].fg_ts : NOT_APPLICABLE;
+		rec->grab_start = frame[i].grab_start.QuadPart;
+		rec->grab_stop = frame[i].grab_stop.QuadPart;
+		rec->thresh_start = frame[i].thresh_start.QuadPart;
+		rec->thresh_stop = frame[i].thresh_stop.QuadPart;
+		rec->blob_start = frame[i].blob_start.QuadPart;
+		rec->blob_stop = frame[i].blob_stop.QuadPart;
+		rec->roi_x = frame[i].win.roi_xoff;
+		rec->roi_y = frame[i].win.roi_yoff;
+		rec->roi_w = frame[i].win.roi_w;
+		rec->roi_h = frame[i].win.roi_h;
+		rec->blob_x = frame[i].win.blob_xmin;
+		rec->blob_y = frame[i].win.blob_ymin;
+		rec->blob_w = frame[i].win.blob_xmax - frame[i].win.blob_xmin;
+		rec->blob_h = frame[i].win.blob_ymax - frame[i].win.blob_ymin;
+		rec->blob_found = frame[i].blob_found == OBJECT_FOUND;
+	}
+
+	UnmapViewOfFile(hdr);
+	CloseHandle(map);
+	CloseHandle(file);
+
+	return FG_OK;
+}
+
 /**
 * initialization routines for initializing and grabbing camera (or disk) images
 *
@@ -328,29 +519,49 @@ void PrintTimingData(Fg_Struct *fg, TimingInfo *timer)
 * Software SDK doc) [if ONLINE = 1]
 * @param tseq the sequence in which the ROI are active (if ONLINE = 1)
 * @param data the buffer that will eventually hold the image data (if ONLINE = 0)
+*
+* @note the number and size of the buffers are chosen by <code>buffers_plan</code> and
+* left in <code>tseq</code> for <code>StartRing</code>.  While a session is open (see
+* cam.cpp) they are the buffers of the session.
 */
 
 int StartGrabbing(Fg_Struct **fg, TrackingSequence *tseq, unsigned char **data)
 {
 	int rc = FG_OK;
-	TrackingWindow *win = tseq->windows + tseq->seq[0];
+	int session;
 
 #if ONLINE
-	rc = init_cam(fg, MEMSIZE(win->roi_w, win->roi_h), NUM_BUFFERS, CAMLINK);
+	session = session_buffers_of(&tseq->buffers, &tseq->buf_size);
+	if(!session) {
+		buffers_plan(tseq);
+	}
+	else if(buffer_size(tseq) > tseq->buf_size) {
+		printf("init: the ROIs do not fit in the %d bytes of the session buffers\n",
+			tseq->buf_size);
+		return EINVAL;
+	}
+
+	rc = init_cam(fg, tseq->buf_size * tseq->buffers, tseq->buffers, CAMLINK);
 	if(rc != FG_OK) {
 		printf("init: %s\n", Fg_getLastErrorDescription(*fg));
-		Fg_FreeGrabber(*fg);
+		if(!session) {
+			Fg_FreeGrabber(*fg);
+		}
 		return rc;
 	}
 
 	rc = acquire_imgs(*fg, tseq->seq, tseq->seq_len);
 	if(rc != FG_OK) {
 		printf("init: %s\n", Fg_getLastErrorDescription(*fg));
-		Fg_FreeGrabber(*fg);
+		if(!session) {
+			Fg_FreeGrabber(*fg);
+		}
 		return rc;
 	}
 #else
-	*data = (unsigned char *) calloc(win->roi_w * win->roi_h, sizeof(unsigned char));
+	// the windows of a sequence with a search window are not all the same size, the
+	// buffer is aligned like the ones of the grabber; free it with pinned_free
+	*data = (unsigned char *) pinned_alloc(buffer_size(tseq));
 	if(*data == NULL) {
 		printf("main: not enough memory to allocate data.\n");
 		return ENOMEM;
@@ -359,3 +570,18 @@ int StartGrabbing(Fg_Struct **fg, TrackingSequence *tseq, unsigned char **data)
 
 	return FG_OK;
 }
+
+/**
+* sets up a FrameRing over the buffers allocated by <code>StartGrabbing</code>
+*
+* @param ring the FrameRing to initialize
+* @param fg the frame grabber returned by <code>StartGrabbing</code>
+* @param tseq the sequence passed to <code>StartGrabbing</code>
+*
+* @see ring.cpp
+*/
+
+int StartRing(FrameRing *ring, Fg_Struct *fg, TrackingSequence *tseq)
+{
+	return ring_init(ring, fg, tseq, tseq->buffers, tseq->buf_size);
+}
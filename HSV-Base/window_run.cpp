@@ -0,0 +1,410 @@
+/**
+* @file window_run.cpp a version of pipeline_run.cpp that processes the windows of the
+* sequence in parallel.
+*
+* the windows of a TrackingSequence share no pixels and no state, so instead of one
+* processing thread every window gets a worker of its own.  The acquisition thread
+* hands each image to the worker owning the ROI it was taken with, the workers run
+* <code>threshold_blob</code> and <code>update_position</code> on their windows at the
+* same time, and the write thread writes the ROIs back in the order the images came in.
+* With eight ROIs in the sequence the processing then scales with the processors
+* instead of taking eight times as long.
+*
+* the workers publish into a CycleResult, which has one slot per position of the
+* sequence and is never locked.  The epoch of a slot says which cycle of the sequence
+* it holds and whether it has been written, so a worker fills a slot once the write
+* thread is done with it, and the write thread takes the slots in sequence order as
+* their epochs come up.  <code>cycles</code> counts the cycles whose ROIs have all been
+* written.
+*
+* @note a worker starts on the next image of its window only once the write thread has
+* written the window's last ROI, because the parameter sets in roi.cpp are not locked.
+* LABEL_BLOBS and the packed images of bitimg.cpp keep their scratch memory per thread.
+*/
+
+#include "fcdynamic.h"
+
+/**
+* the processors the acquisition and write threads are pinned to, the workers are
+* pinned to the processors from FIRST_WORKER_CPU on
+*/
+#define ACQUIRE_CPU 1
+#define WRITE_CPU 2
+#define FIRST_WORKER_CPU 3
+
+/**
+* the result of the image at one position of the sequence
+*/
+struct window_slot {
+	volatile LONG epoch; /**< 2c + 1 once the job of cycle c is in, 2c + 2 once written */
+	PipelineJob job;
+};
+
+typedef struct window_slot WindowSlot;
+
+/**
+* the results of the windows of one cycle of the sequence
+*/
+struct cycle_result {
+	volatile LONG cycles; /**< the number of cycles whose ROIs have all been written */
+	int len; /**< the length of the sequence */
+	WindowSlot *slots; /**< one per position of the sequence */
+};
+
+typedef struct cycle_result CycleResult;
+
+struct windows;
+
+/**
+* the worker owning one window
+*/
+struct window_worker {
+	struct windows *p;
+	int roi; /**< the index of the window in <code>TrackingSequence.windows</code> */
+	JobQueue jobs; /**< acquisition -> worker */
+};
+
+typedef struct window_worker WindowWorker;
+
+/**
+* the state shared by the threads
+*/
+struct windows {
+	Fg_Struct *fg;
+	FrameRing ring;
+	TrackingSequence *tseq;
+	TimingInfo *timer;
+	int t;
+
+	WindowWorker workers[MAX_ROI];
+	int num_workers;
+	int owner[MAX_ROI]; /**< the worker of every ROI, -1 for ROIs not in the sequence */
+
+	CycleResult result; /**< workers -> write */
+	JobQueue written; /**< write -> acquisition, images to release */
+
+	volatile LONG acquired; /**< set once the acquisition thread is done */
+	volatile LONG failed; /**< set if the acquisition thread did not get an image */
+};
+
+typedef struct windows Windows;
+
+static void release_written(Windows *p)
+{
+	PipelineJob job;
+
+	while(job_pop(&p->written, &job) == FG_OK) {
+		ring_release(&p->ring, &job.view);
+	}
+}
+
+static DWORD WINAPI acquire_stage(LPVOID param)
+{
+	int i, w;
+	PipelineJob job;
+	Windows *p = (Windows *) param;
+	FrameInfo *frame;
+
+	for(i = 0; i < p->timer->num_imgs; i++) {
+		frame = p->timer->frame + i;
+
+		release_written(p);
+
+		QueryPerformanceCounter(&frame->grab_start);
+		if(ring_next(&p->ring, &job.view, TIMEOUT) != FG_OK) {
+			printf("img is null: %d\n", job.view.img);
+			InterlockedExchange(&p->failed, TRUE);
+			// only print the images that made it through
+			p->timer->num_imgs = i;
+			break;
+		}
+		QueryPerformanceCounter(&frame->grab_stop);
+
+		frame->img = job.view.img;
+		frame->fg_ts = job.view.fg_ts;
+		job.frame = i;
+		w = p->owner[job.view.roi];
+		while(job_push(&p->workers[w].jobs, &job) != FG_OK) {
+			release_written(p);
+			YieldProcessor();
+		}
+	}
+
+	InterlockedExchange(&p->acquired, TRUE);
+	return 0;
+}
+
+static DWORD WINAPI worker_stage(LPVOID param)
+{
+	PipelineJob job;
+	WindowWorker *w = (WindowWorker *) param;
+	Windows *p = w->p;
+	TrackingWindow *cur = p->tseq->windows + w->roi;
+	CycleResult *r = &p->result;
+	WindowSlot *slot, *last = NULL;
+	LONG cycle, last_cycle = 0;
+	FrameInfo *frame;
+
+	while(1) {
+		if(job_pop(&w->jobs, &job) != FG_OK) {
+			if(p->acquired && w->jobs.head == w->jobs.tail) {
+				break;
+			}
+			YieldProcessor();
+			continue;
+		}
+
+		// the write thread may still be writing the parameter set of the last image
+		while(last != NULL && last->epoch != 2 * last_cycle + 2) {
+			YieldProcessor();
+		}
+
+		frame = p->timer->frame + job.frame;
+		window_frame(cur, &job.view);
+
+		// the pixels as they came, before the pass binarizes them
+		flight_put(cur, job.view.img, p->t);
+
+		QueryPerformanceCounter(&frame->thresh_start);
+		job.found = change_blob(cur, p->t);
+		QueryPerformanceCounter(&frame->thresh_stop);
+
+		QueryPerformanceCounter(&frame->blob_start);
+		job.found = update_position(cur, job.found);
+		flight_result(cur, job.found);
+		if(p->tseq->adapt) {
+			adapt_roi(cur, job.found);
+		}
+		QueryPerformanceCounter(&frame->blob_stop);
+
+		frame->blob_found = job.found;
+		memcpy(&frame->win, cur, sizeof(TrackingWindow));
+
+		// wait for the write thread to be done with the slot's last cycle
+		slot = r->slots + job.frame % r->len;
+		cycle = job.frame / r->len;
+		while(slot->epoch != 2 * cycle) {
+			YieldProcessor();
+		}
+		slot->job = job;
+		MemoryBarrier();
+		slot->epoch = 2 * cycle + 1;
+
+		last = slot;
+		last_cycle = cycle;
+	}
+
+	return 0;
+}
+
+static DWORD WINAPI write_stage(LPVOID param)
+{
+	int i;
+	LONG cycle;
+	PipelineJob job;
+	Windows *p = (Windows *) param;
+	CycleResult *r = &p->result;
+	WindowSlot *slot;
+
+	for(i = 0; ; i++) {
+		slot = r->slots + i % r->len;
+		cycle = i / r->len;
+		while(slot->epoch != 2 * cycle + 1) {
+			if(p->acquired && i >= p->timer->num_imgs) {
+				return 0;
+			}
+			YieldProcessor();
+		}
+		MemoryBarrier();
+		job = slot->job;
+
+		write_rois(p->fg, &job.view.roi, 1, job.view.img);
+		QueryPerformanceCounter(&(p->timer->frame[job.frame].pc_ts));
+#if PUBLISH
+		// the window may already be on its next image, publish the copy of this one
+		write_comm(&(p->timer->frame[job.frame].win), job.found);
+#endif
+
+		MemoryBarrier();
+		slot->epoch = 2 * cycle + 2;
+		if(i % r->len == r->len - 1) {
+			r->cycles = cycle + 1;
+		}
+
+		while(job_push(&p->written, &job) != FG_OK) {
+			// nothing drains the queue once the acquisition thread is done
+			if(p->acquired) {
+				release_written(p);
+				continue;
+			}
+			YieldProcessor();
+		}
+	}
+}
+
+/**
+* times the tracking loop with every window of the sequence processed by its own
+* worker thread.
+*
+* <code>window_run</code> takes the same parameters and prints the same timing table
+* as <code>time_run</code> and <code>pipeline_run</code>, so the three can be compared
+* with timing_parser.py.  The threshold and blob columns are measured on the workers,
+* the grab columns on the acquisition thread and the performance counter timestamp is
+* taken once the ROI is written.
+*
+* @param tseq the TrackingSequence specifying the active ROIs and their initial positions
+* in the image prior to tracking an object
+* @param num_imgs the number of images to acquire
+* @param t the threshold value to be used with <code>threshold_blob</code>
+* @param frame the frame time (e.g. length of time between images) in microseconds
+* @param exposure the exposure time (e.g. length of time the shutter is kept open) in
+* microseconds
+*
+* @note the workers are pinned to the processors from <code>FIRST_WORKER_CPU</code> on,
+* so the machine needs three processors more than the sequence has windows for every
+* worker to have a processor of its own.  Workers beyond that share processors.
+*
+* @see pipeline_run
+*/
+
+int window_run(TrackingSequence *tseq, int num_imgs, int t, double frame, double exposure)
+{
+#if ONLINE
+	int i, rc, n, cpus;
+	Windows p;
+	TimingInfo timer;
+	SYSTEM_INFO sys;
+	HANDLE threads[MAX_ROI + 2];
+	TrackingWindow *cur;
+
+	if(tseq->seq_len < MIN_SEQ_LEN) {
+		printf("invalid sequence length...need at least %d windows\n", MIN_SEQ_LEN);
+		return EINVAL;
+	}
+
+	memset(&p, 0, sizeof(Windows));
+	cur = tseq->windows + tseq->seq[0];
+
+	// one worker per window in the sequence
+	for(i = 0; i < MAX_ROI; i++) {
+		p.owner[i] = -1;
+	}
+	for(i = 0; i < tseq->seq_len; i++) {
+		if(p.owner[tseq->seq[i]] < 0) {
+			p.owner[tseq->seq[i]] = p.num_workers;
+			p.workers[p.num_workers].p = &p;
+			p.workers[p.num_workers].roi = tseq->seq[i];
+			p.num_workers++;
+		}
+	}
+
+	p.result.len = tseq->seq_len;
+	p.result.slots = (WindowSlot *) calloc(tseq->seq_len, sizeof(WindowSlot));
+	if(p.result.slots == NULL) {
+		return ENOMEM;
+	}
+
+	memset(&timer, 0, sizeof(TimingInfo));
+	timer.num_imgs = num_imgs;
+	timer.roi_e = exposure;
+	timer.roi_f = frame;
+	timer.roi_w = cur->roi_w;
+	timer.roi_h = cur->roi_h;
+	timer.frame = (frame_info *) calloc(num_imgs, sizeof(FrameInfo));
+	if(timer.frame == NULL) {
+		free(p.result.slots);
+		return ENOMEM;
+	}
+	if(!QueryPerformanceFrequency(&timer.freq)) {
+		printf("main: no perfmance counter\n");
+		free(timer.frame);
+		free(p.result.slots);
+		return ENODEV;
+	}
+
+	rc = StartGrabbing(&p.fg, tseq, NULL);
+	if(rc != FG_OK) {
+		free(timer.frame);
+		free(p.result.slots);
+		return rc;
+	}
+
+	rc = StartRing(&p.ring, p.fg, tseq);
+	if(rc != FG_OK) {
+		deinit_cam(p.fg);
+		free(timer.frame);
+		free(p.result.slots);
+		return rc;
+	}
+
+	p.tseq = tseq;
+	p.timer = &timer;
+	p.t = t;
+
+	GetSystemInfo(&sys);
+	cpus = (int) sys.dwNumberOfProcessors - FIRST_WORKER_CPU;
+	if(cpus < p.num_workers) {
+		printf("window_run: %d windows share %d processors\n", p.num_workers,
+			(cpus > 0) ? cpus : 1);
+	}
+	if(cpus < 1) {
+		cpus = 1;
+	}
+
+	n = p.num_workers + 2;
+	threads[0] = start_stage(acquire_stage, &p, ACQUIRE_CPU);
+	threads[1] = start_stage(write_stage, &p, WRITE_CPU);
+	for(i = 0; i < p.num_workers; i++) {
+		threads[i + 2] = start_stage(worker_stage, p.workers + i, FIRST_WORKER_CPU + i % cpus);
+	}
+	for(i = 0; i < n; i++) {
+		if(threads[i] == NULL) {
+			break;
+		}
+	}
+	if(i < n) {
+		for(i = 0; i < n; i++) {
+			if(threads[i] != NULL) {
+				TerminateThread(threads[i], 0);
+				CloseHandle(threads[i]);
+			}
+		}
+		deinit_cam(p.fg);
+		free(timer.frame);
+		free(p.result.slots);
+		return ENOMEM;
+	}
+
+	QueryPerformanceCounter(&timer.loop_start);
+	for(i = 0; i < n; i++) {
+		ResumeThread(threads[i]);
+	}
+	WaitForMultipleObjects(n, threads, TRUE, INFINITE);
+	QueryPerformanceCounter(&timer.loop_stop);
+
+	for(i = 0; i < n; i++) {
+		CloseHandle(threads[i]);
+	}
+	release_written(&p);
+
+	bench_run(p.fg, &timer);
+#if BINARY_TRACE
+	WriteTimingTrace(p.fg, &timer);
+#else
+	PrintTimingData(p.fg, &timer);
+#endif
+
+	rc = deinit_cam(p.fg);
+	free(timer.frame);
+	free(p.result.slots);
+	if(rc != FG_OK) {
+		printf("deinit: %s\n", Fg_getLastErrorDescription(p.fg));
+		return rc;
+	}
+
+	return p.failed ? !FG_OK : FG_OK;
+#else
+	// there is no frame grabber to overlap with when reading images from disk
+	return time_run(tseq, num_imgs, t, frame, exposure);
+#endif
+}
@@ -0,0 +1,340 @@
+/**
+* @file world.cpp converts the centroids of the ROIs to world coordinates with a TDah
+* calibration.
+*
+* a TDah Camera gives the point on the z = 0 plane of the world that a pixel images:
+* it undistorts the pixel to the normalized camera frame with five fixed-point
+* iterations, the way cvUndistortPoints does, and intersects the ray through it with
+* the plane.  <code>world_load</code> reads the binary calibration Camera::save writes,
+* the camera matrix, distortion vector, rotation and translation and, if it has one, the
+* undistortion map of the sensor.  The Camera class itself can not be used here, its
+* name is taken by the cameras of the frame grabber.
+*
+* only the centroids of a few ROIs are ever converted, so instead of the whole sensor
+* <code>world_attach</code> fills a table per ROI of the sequence with the world
+* coordinates of every pixel the ROI can reach: the largest ROI the buffers hold around
+* where the ROI starts, plus a margin.  <code>world_point</code> then interpolates the
+* four pixels around a centroid in it, one lookup instead of the undistortion and the
+* projection.  The table of a ROI is only filled again if its rectangle changed, so
+* <code>reset</code> reusing the same ROIs costs nothing.  A centroid outside of the table,
+* of a ROI that followed its object further, is converted the slow way.
+*
+* the calibration is set in moments.ini:
+* <pre>
+* [world]
+* calibration = camera.tdc
+* margin = 32
+* </pre>
+*/
+
+#include "fcdynamic.h"
+
+/**
+* "TDCB" and the version of the binary calibration, see TDah/src/Camera.cpp
+*/
+#define WORLD_MAGIC 0x42434454
+#define WORLD_VERSION 1
+
+/**
+* the header of a binary calibration as Camera::save writes it
+*
+* it is followed by map_height rows of map_width normalized points, two floats each.
+*/
+
+struct world_blob {
+	unsigned int magic;
+	unsigned int version;
+	unsigned int header; /**< sizeof(WorldBlob) of the writer */
+	int map_width; /**< 0, if there is no map */
+	int map_height;
+	int reserved;
+	double A[9]; /**< the camera matrix, row by row */
+	double k[5]; /**< k1, k2, p1, p2, k3 */
+	double R[9]; /**< the rotation, row by row */
+	double t[3];
+};
+
+typedef struct world_blob WorldBlob;
+
+static int loaded = FALSE;
+static double fc[4]; /**< fx, fy, cx, cy */
+static double kc[5];
+static double wc[3][3]; /**< the world x, y and their denominator of a normalized point */
+static float *norm = NULL; /**< the undistortion map of the calibration, or NULL */
+static int norm_w = 0;
+static int norm_h = 0;
+
+static WorldMap maps[MAX_ROI];
+
+/**
+* the normalized location of a distorted pixel, as Camera::normalize finds it
+*/
+static void normalize(double px, double py, double *nx, double *ny)
+{
+	int i;
+	double x, y, x0, y0, r2, icdist, dx, dy;
+
+	x = x0 = (px - fc[2]) / fc[0];
+	y = y0 = (py - fc[3]) / fc[1];
+
+	for(i = 0; i < 5; i++) {
+		r2 = x*x + y*y;
+		icdist = 1 / (1 + ((kc[4]*r2 + kc[1])*r2 + kc[0])*r2);
+		dx = 2*kc[2]*x*y + kc[3]*(r2 + 2*x*x);
+		dy = kc[2]*(r2 + 2*y*y) + 2*kc[3]*x*y;
+		x = (x0 - dx)*icdist;
+		y = (y0 - dy)*icdist;
+	}
+
+	*nx = x;
+	*ny = y;
+}
+
+/**
+* the point on the z = 0 plane a normalized location images
+*/
+static void project(double x, double y, double *wx, double *wy)
+{
+	double den;
+
+	den = wc[2][0] + wc[2][1]*x + wc[2][2]*y;
+	*wx = -(wc[0][0] + wc[0][1]*x + wc[0][2]*y) / den;
+	*wy = (wc[1][0] + wc[1][1]*x + wc[1][2]*y) / den;
+}
+
+/**
+* the world point of pixel (x, y), read from the undistortion map of the calibration if
+* it has one
+*/
+static void pixel_world(int x, int y, double *wx, double *wy)
+{
+	double nx, ny;
+	const float *n;
+
+	if(x >= 0 && y >= 0 && x < norm_w && y < norm_h) {
+		n = norm + 2 * ((size_t) y * norm_w + x);
+		nx = n[0];
+		ny = n[1];
+	}
+	else {
+		normalize(x, y, &nx, &ny);
+	}
+
+	project(nx, ny, wx, wy);
+}
+
+/**
+* reads a binary calibration written by TDah's Camera::save.
+*
+* the tables of the ROIs are filled again by the next <code>world_attach</code>.
+*
+* @param name the file of the calibration
+*
+* @return <code>FG_OK</code>, <code>ENOENT</code> if it could not be opened,
+* <code>EINVAL</code> if it is no calibration of this version or <code>ENOMEM</code>
+*/
+
+int world_load(const char *name)
+{
+	int i;
+	size_t n;
+	FILE *fp;
+	WorldBlob b;
+	const double *A, *R, *t;
+
+	if(fopen_s(&fp, name, "rb") != 0) {
+		printf("world: could not open %s\n", name);
+		return ENOENT;
+	}
+
+	if(fread(&b, sizeof(WorldBlob), 1, fp) != 1 || b.magic != WORLD_MAGIC
+		|| b.version != WORLD_VERSION || b.header != sizeof(WorldBlob)
+		|| b.map_width < 0 || b.map_height < 0) {
+		printf("world: %s is no calibration of version %d\n", name, WORLD_VERSION);
+		fclose(fp);
+		return EINVAL;
+	}
+
+	world_free();
+
+	n = (size_t) b.map_width * b.map_height * 2;
+	if(n > 0) {
+		norm = (float *) malloc(n * sizeof(float));
+		if(norm == NULL) {
+			fclose(fp);
+			return ENOMEM;
+		}
+		if(fread(norm, sizeof(float), n, fp) != n) {
+			printf("world: the map of %s is cut short\n", name);
+			fclose(fp);
+			world_free();
+			return EINVAL;
+		}
+		norm_w = b.map_width;
+		norm_h = b.map_height;
+	}
+	fclose(fp);
+
+	A = b.A;
+	R = b.R;
+	t = b.t;
+	fc[0] = A[0];
+	fc[1] = A[4];
+	fc[2] = A[2];
+	fc[3] = A[5];
+	for(i = 0; i < 5; i++) {
+		kc[i] = b.k[i];
+	}
+
+	// the same solution for the normalized point (x, y) as Camera::cache
+	wc[0][0] = R[4]*t[0] - R[1]*t[1];
+	wc[0][1] = R[7]*t[1] - R[4]*t[2];
+	wc[0][2] = R[1]*t[2] - R[7]*t[0];
+
+	wc[1][0] = R[3]*t[0] - R[0]*t[1];
+	wc[1][1] = R[6]*t[1] - R[3]*t[2];
+	wc[1][2] = R[0]*t[2] - R[6]*t[0];
+
+	wc[2][0] = R[0]*R[4] - R[1]*R[3];
+	wc[2][1] = R[3]*R[7] - R[4]*R[6];
+	wc[2][2] = R[1]*R[6] - R[0]*R[7];
+
+	loaded = TRUE;
+	return FG_OK;
+}
+
+/**
+* frees the calibration and the tables of every ROI.
+*/
+
+void world_free()
+{
+	int i;
+
+	for(i = 0; i < MAX_ROI; i++) {
+		free(maps[i].xy);
+	}
+	memset(maps, 0, sizeof(maps));
+
+	free(norm);
+	norm = NULL;
+	norm_w = norm_h = 0;
+	loaded = FALSE;
+}
+
+/**
+* gives <code>win</code> the table of the world coordinates of the pixels its ROI can
+* reach.
+*
+* the table covers <code>win->roi_max_w</code> x <code>win->roi_max_h</code> pixels
+* centered on the ROI plus <code>margin</code> on every side, clipped to the image.  It
+* is meant to be called by <code>reset</code> for the ROIs of the sequence, after the
+* ROI was placed.
+*
+* @param win the window of the ROI
+* @param margin the pixels the table reaches past the largest ROI
+*
+* @return <code>FG_OK</code>, <code>EINVAL</code> if no calibration was loaded or
+* <code>ENOMEM</code>; <code>win->world</code> is NULL then
+*/
+
+int world_attach(TrackingWindow *win, int margin)
+{
+	int x, y, x0, y0, x1, y1;
+	double wx, wy;
+	float *xy;
+	WorldMap *m;
+
+	win->world = NULL;
+	if(!loaded || win->roi < 0 || win->roi >= MAX_ROI) {
+		return EINVAL;
+	}
+
+	x0 = win->roi_xoff + win->roi_w / 2 - win->roi_max_w / 2 - margin;
+	y0 = win->roi_yoff + win->roi_h / 2 - win->roi_max_h / 2 - margin;
+	x1 = x0 + win->roi_max_w + 2 * margin;
+	y1 = y0 + win->roi_max_h + 2 * margin;
+	x0 = (x0 < 0) ? 0 : x0;
+	y0 = (y0 < 0) ? 0 : y0;
+	x1 = (x1 > win->img_w) ? win->img_w : x1;
+	y1 = (y1 > win->img_h) ? win->img_h : y1;
+	if(x1 <= x0 || y1 <= y0) {
+		return EINVAL;
+	}
+
+	// the same rectangle as the last run
+	m = maps + win->roi;
+	if(m->xy != NULL && m->xoff == x0 && m->yoff == y0 && m->w == x1 - x0
+		&& m->h == y1 - y0) {
+		win->world = m;
+		return FG_OK;
+	}
+
+	free(m->xy);
+	memset(m, 0, sizeof(WorldMap));
+	m->xy = (float *) malloc((size_t) (x1 - x0) * (y1 - y0) * 2 * sizeof(float));
+	if(m->xy == NULL) {
+		return ENOMEM;
+	}
+	m->xoff = x0;
+	m->yoff = y0;
+	m->w = x1 - x0;
+	m->h = y1 - y0;
+
+	xy = m->xy;
+	for(y = y0; y < y1; y++) {
+		for(x = x0; x < x1; x++) {
+			pixel_world(x, y, &wx, &wy);
+			*xy++ = (float) wx;
+			*xy++ = (float) wy;
+		}
+	}
+
+	win->world = m;
+	return FG_OK;
+}
+
+/**
+* the world coordinates of a point in the image reference frame of <code>win</code>.
+*
+* inside the table of <code>win</code> the four pixels around the point are
+* interpolated, outside of it the point is undistorted and projected.
+*
+* @param win the window with a table from <code>world_attach</code>
+* @param x the x coordinate of the point, like <code>win->cx</code>
+* @param y the y coordinate of the point
+* @param wx the world x coordinate
+* @param wy the world y coordinate
+*
+* @return <code>FG_OK</code>, or <code>EINVAL</code> if no calibration was loaded
+*/
+
+int world_point(TrackingWindow *win, double x, double y, double *wx, double *wy)
+{
+	int x0, y0;
+	double fx, fy, nx, ny;
+	const float *a, *c;
+	const WorldMap *m = win->world;
+
+	if(!loaded) {
+		*wx = *wy = 0;
+		return EINVAL;
+	}
+
+	x0 = cvFloor(x);
+	y0 = cvFloor(y);
+	if(m != NULL && x0 >= m->xoff && y0 >= m->yoff && x0 + 1 < m->xoff + m->w
+		&& y0 + 1 < m->yoff + m->h) {
+		a = m->xy + 2 * ((size_t) (y0 - m->yoff) * m->w + (x0 - m->xoff));
+		c = a + 2 * m->w;
+		fx = x - x0;
+		fy = y - y0;
+		*wx = (1 - fy) * ((1 - fx) * a[0] + fx * a[2]) + fy * ((1 - fx) * c[0] + fx * c[2]);
+		*wy = (1 - fy) * ((1 - fx) * a[1] + fx * a[3]) + fy * ((1 - fx) * c[1] + fx * c[3]);
+		return FG_OK;
+	}
+
+	normalize(x, y, &nx, &ny);
+	project(nx, ny, wx, wy);
+	return FG_OK;
+}
@@ -6,9 +6,7 @@
 //== This sample brings up a connected camera and displays it's output frames.
 //=================================================================================-----
 
-#include "supportcode.h"       //== Boiler-plate code for application window init ===---
-#include "cameralibrary.h"     //== Camera Library header file ======================---
-#include "cameramanager.h"
+#include "opti_client.h"       //== Camera, window and transport, see opti.cfg ======---
 #include <windows.h>
 #include <stdio.h>
 #include <tchar.h>
@@ -19,9 +17,7 @@
 #include <fstream>
 #include <math.h>
 
-#include "calibration.h"
 #include "main.h"
-#include "vision_tcp.h"
 
 using namespace CameraLibrary; 
 using namespace std;
@@ -29,41 +25,23 @@ using namespace std;
 
 int main(int argc, char* argv[])
 {
-	VisionTCP IRvisionTCP;
+	//== Open the camera of opti.cfg, with the window for calibration ==--
+
+	OptiClient client;
+	Camera *camera = client.Open(OPTI_CONFIG_FILE, TESTMODE != 0);
+	if (camera == NULL) return 1;
+	const OptiConfig &cfg = client.Config();
+
+	VisionTCP &IRvisionTCP = client.Net();
 	//Initialize TCPIP
 	if (!TESTMODE){
 		
-		if (int init = IRvisionTCP.Init()) {
+		if (int init = IRvisionTCP.Init(cfg.udp, cfg.server_ip.c_str(), cfg.port, cfg.NetProfile())) {
 			OUTPUT("No TCPIP connection available!");
 			//return init;
 		}
 	}
 
-
-	//== For OptiTrack Ethernet cameras, it's important to enable development mode if you
-	//== want to stop execution for an extended time while debugging without disconnecting
-	//== the Ethernet devices.  Lets do that now:
-
-	CameraLibrary_EnableDevelopment();
-
-	//== Initialize connected cameras ==========----
-	
-    CameraManager::X().WaitForInitialization();
-
-    //== Get a connected camera ================----
-
-    Camera *camera = CameraManager::X().GetCamera();
-
-    //== If no device connected, pop a message box and exit ==--
-
-    if(camera==0)
-    {
-        MessageBox(0,"Please connect a camera","No Device Connected", MB_OK);
-        return 1;
-    }
-
-	//== Determine camera resolution to size application window ==----
-	
     int cameraWidth  = camera->Width();
     int cameraHeight = camera->Height();
 	int i, j ;
@@ -72,54 +50,6 @@ int main(int argc, char* argv[])
 	//double posbuff[framecnt][NUM_MARKERS*2+1];
 	double calibuff[CALIBRA_NUM][2];
 
- 	//== Open the application window =============================----
-		
-    if (TESTMODE)
-	{
-		if (!CreateAppWindow("Camera Library SDK - Sample",cameraWidth,cameraHeight,32,gFullscreen))  return 0;
-	
-
-    //== Create a texture to push the rasterized camera image ====----
-
-    //== We're using textures because it's an easy & cpu light 
-    //== way to utilize the 3D hardware to display camera
-    //== imagery at high frame rates
-		
-	}
-	Surface Texture(cameraWidth, cameraHeight);
-
-	//if (TESTMODE == 1){
-		
-		Bitmap * framebuffer = new Bitmap(cameraWidth, cameraHeight, Texture.PixelSpan()*4,
-								   Bitmap::ThirtyTwoBit, Texture.GetBuffer());
-	//}
-	
-    //== Set Video Mode ==--
-
-    //camera->SetVideoType(SegmentMode);
-	camera->SetVideoType(ObjectMode);
-    
-	//Set camera frame rate
-	camera->SetFrameRate(FRAMERATE);
-
-	//==Set camera exposure
-	camera->SetExposure(25);
-
-    //== Start camera output ==--
-
-    camera->Start();
-	Core::DistortionModel distortion;
-	distortion.Distort = true;
-	camera->GetDistortionModel(distortion);
-
-    //== Turn on some overlay text so it's clear things are     ===---
-    //== working even if there is nothing in the camera's view. ===---
-	if (TESTMODE == 1){
-		camera->SetTextOverlay(true);
-
-		camera->SetMarkerOverlay(true);
-	}
-
 	/*************************************************************************************************/
     //== Ok, start main loop.  This loop fetches and displays   ===---
     //== camera frames.                                         ===---
@@ -147,7 +77,7 @@ int main(int argc, char* argv[])
         //The for loop here is just for delay a little while.
 		for (i=1 ; i<100 ; i++) ;
 		//---=== Fetch a new frame from the camera ===---
-        Frame *frame = camera->GetFrame();
+        Frame *frame = client.WaitFrame();
 		
         if(frame)
         {
@@ -160,17 +90,13 @@ int main(int argc, char* argv[])
             //== with it.
 
             //== Lets have the Camera Library raster the camera's
-            //== image into our texture.
-		
-            frame->Rasterize(framebuffer);
+            //== image into our texture, every preview_every frames.
 
 			//camera->AttachModule(new cModuleLabeler());
 
             //== Display Camera Image ============--
 
-            if (TESTMODE){
-				if(!DrawGLScene(&Texture)) break;
-			}
+            if (!client.Preview(frame)) break;
 
             //== Escape key to exit application ==--
 
@@ -254,8 +180,7 @@ int main(int argc, char* argv[])
 							}
 						}
 
-						prew_X = a11*preX[index] + a12*preY[index] + a13;
-						prew_Y = a21*preX[index] + a22*preY[index] + a23;
+						cfg.World(preX[index], preY[index], &prew_X, &prew_Y);
 
 						preX[index] = object->X();  preY[index] = object->Y();
 
@@ -269,17 +194,16 @@ int main(int argc, char* argv[])
 					//object = frame->Object(i);
 
 					//Calculate the calibrated position in the world frame
-						w_X[index] = a11*object->X() + a12*object->Y() + a13;
-						w_Y[index] = a21*object->X() + a22*object->Y() + a23;
+						cfg.World(object->X(), object->Y(), &w_X[index], &w_Y[index]);
 
 						v = ((w_X[index] - prew_X)*(w_X[index] - prew_X) + (w_Y[index] - prew_Y)*(w_Y[index] - prew_Y));
 						//v = sqrt(v)/((frame->FrameID() - preFID)/FRAMERATE);
-						v = sqrt(v)*FRAMERATE/(frame->FrameID() - preFID);
+						v = sqrt(v)*cfg.frame_rate/(frame->FrameID() - preFID);
 											
-						if (index == 0) w[0] = v/r1;
-						else if (index == 1) w[1] = v/r2;
-						else if (index == 2) w[2] = v/r3;
-						else if (index == 3) w[3] = v/r4;
+						if (index == 0) w[0] = v/cfg.radius[0];
+						else if (index == 1) w[1] = v/cfg.radius[1];
+						else if (index == 2) w[2] = v/cfg.radius[2];
+						else if (index == 3) w[3] = v/cfg.radius[3];
 
 					//double w_Xtemp, w_Ytemp;
 					//w_X = a11*object->X() + a12*object->Y() + a13*(object->X())*(object->X()) + a14*(object->Y())*(object->Y()) + a15*(object->X())*(object->Y()) + a16;
@@ -289,8 +213,7 @@ int main(int argc, char* argv[])
 
 					if (TESTMODE){
 						object = frame->Object(i);
-						w_X[0] = a11*object->X() + a12*object->Y() + a13;
-						w_Y[0] = a21*object->X() + a22*object->Y() + a23;
+						cfg.World(object->X(), object->Y(), &w_X[0], &w_Y[0]);
 						//sprintf(buff, "frameRate:%d frame# %d (w:%d,h:%d), Object index:%d,m#:%d, f: %f %f w: %f %f",
 						//	camera->FrameRate(), frame->FrameID(),cameraWidth, cameraHeight, index ,i,object->X(), object->Y(), w_X, w_Y);
 						sprintf_s(buff, "frame# %d , f: %f %f w: %f %f",
@@ -378,8 +301,6 @@ int main(int argc, char* argv[])
 			}
 		}
 
-	    //Sleep(1);
-
         //== Service Windows Message System ==--
 
         if(!PumpMessages())
@@ -405,17 +326,9 @@ int main(int argc, char* argv[])
 		}
 		fclose(fp);
 	}
-    //== Close window ==--
-
-    if(TESTMODE) CloseWindow();
-
-    //== Release camera ==--
-
-    camera->Release();
-
-    //== Shutdown Camera Library ==--
+    //== Close window, release camera and shutdown Camera Library ==--
 
-    CameraManager::X().Shutdown();
+	client.Close();
 
     //== Exit the application.  Simple! ==--
 
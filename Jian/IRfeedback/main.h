@@ -4,7 +4,7 @@
 #define TESTMODE 0 // Testmode is for testing and calibration, "0" is for testing and "1" is for calibration
 #define OUTMODE 1  // Determine output data to text file or not, "1" means will write all data to file
 
-#define FRAMERATE 250
+// The frame rate, exposure, server and calibration are read from opti.cfg
 #define Time_to_record 20 //in second
 #define FILENAME "data4.txt" //The name for output file
 
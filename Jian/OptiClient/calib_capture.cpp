@@ -0,0 +1,337 @@
+#include "calib_capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#define HEADER "# Camera pixel to world (mm)" // the first line Write() puts, replaced by the next
+
+// sorts dot indices by one coordinate
+struct ByCoord {
+	const double *v;
+	bool operator()(int a, int b) const { return v[a] < v[b]; }
+};
+
+// solves m x = b for the n x n row major m by elimination with partial
+// pivoting, x in b; return: -1 if m is singular
+static int Solve(int n, double *m, double *b)
+{
+	int i, j, k, p;
+
+	for (k = 0; k < n; k++) {
+		p = k;
+		for (i = k + 1; i < n; i++) {
+			if (fabs(m[i*n + k]) > fabs(m[p*n + k])) p = i;
+		}
+		if (fabs(m[p*n + k]) < 1e-12) return -1;
+		if (p != k) {
+			for (j = 0; j < n; j++) std::swap(m[k*n + j], m[p*n + j]);
+			std::swap(b[k], b[p]);
+		}
+		for (i = k + 1; i < n; i++) {
+			double f = m[i*n + k]/m[k*n + k];
+			for (j = k; j < n; j++) m[i*n + j] -= f*m[k*n + j];
+			b[i] -= f*b[k];
+		}
+	}
+	for (k = n - 1; k >= 0; k--) {
+		for (j = k + 1; j < n; j++) b[k] -= m[k*n + j]*b[j];
+		b[k] /= m[k*n + k];
+	}
+	return 0;
+}
+
+// the centroid and the scale that makes the mean distance to it sqrt(2)
+static void Normalize(const double *x, const double *y, int n, double *cx, double *cy, double *s)
+{
+	double d = 0.;
+
+	*cx = *cy = 0.;
+	for (int i = 0; i < n; i++) {
+		*cx += x[i];
+		*cy += y[i];
+	}
+	*cx /= n;
+	*cy /= n;
+	for (int i = 0; i < n; i++) d += sqrt((x[i] - *cx)*(x[i] - *cx) + (y[i] - *cy)*(y[i] - *cy));
+	*s = d > 0. ? sqrt(2.)*n/d : 1.;
+}
+
+CalibCapture::CalibCapture()
+{
+	mFrames = 0;
+	mModel = CALIB_AFFINE;
+	memset(mA, 0, sizeof(mA));
+	mA[0][0] = mA[1][1] = mA[2][2] = 1.;
+}
+
+int CalibCapture::LoadWorld(const char *filename)
+{
+	FILE *fp = fopen(filename, "r");
+	double x, y, w;
+
+	if (fp == NULL) return -1;
+
+	mWX.clear();
+	mWY.clear();
+	mRows.clear();
+	while (fscanf(fp, "%lf %lf %lf", &x, &y, &w) == 3) {
+		if (mWY.empty() || y != mWY.back()) mRows.push_back(0);
+		mRows.back()++;
+		mWX.push_back(x);
+		mWY.push_back(y);
+	}
+	fclose(fp);
+
+	mFrames = 0;
+	mSumX.assign(mWX.size(), 0.);
+	mSumY.assign(mWX.size(), 0.);
+	return (int)mWX.size();
+}
+
+// mOrder[k] becomes the blob of dot k of the board, for the first frame. The
+// rows by y are only right while the board is about level, so the homography
+// of that order maps every blob to the board and it is taken for the dot it
+// lands nearest, a few times over, which puts the blobs of a tilted row right.
+// return: false if two blobs land on one dot
+bool CalibCapture::Sort(const double *x, const double *y)
+{
+	int i, k, start = 0, n = Dots();
+	ByCoord by;
+	std::vector<double> ox(n), oy(n);
+	std::vector<int> dot(n);
+
+	mOrder.resize(n);
+	for (i = 0; i < n; i++) mOrder[i] = i;
+
+	by.v = y;
+	std::sort(mOrder.begin(), mOrder.end(), by);
+	by.v = x;
+	for (i = 0; i < (int)mRows.size(); i++) {
+		std::sort(mOrder.begin() + start, mOrder.begin() + start + mRows[i], by);
+		start += mRows[i];
+	}
+
+	for (int pass = 0; pass < CAPTURE_PASSES; pass++) {
+		for (k = 0; k < n; k++) {
+			ox[k] = x[mOrder[k]];
+			oy[k] = y[mOrder[k]];
+		}
+		FitHomography(&ox[0], &oy[0]);
+
+		dot.assign(n, -1);
+		for (i = 0; i < n; i++) {
+			double w = mA[2][0]*x[i] + mA[2][1]*y[i] + mA[2][2];
+			double wx = (mA[0][0]*x[i] + mA[0][1]*y[i] + mA[0][2])/w;
+			double wy = (mA[1][0]*x[i] + mA[1][1]*y[i] + mA[1][2])/w;
+			int best = 0;
+			for (k = 1; k < n; k++) {
+				if ((mWX[k] - wx)*(mWX[k] - wx) + (mWY[k] - wy)*(mWY[k] - wy) <
+					(mWX[best] - wx)*(mWX[best] - wx) + (mWY[best] - wy)*(mWY[best] - wy)) best = k;
+			}
+			if (dot[best] >= 0) return false;
+			dot[best] = i;
+		}
+		mOrder = dot;
+	}
+	return true;
+}
+
+// mOrder[k] becomes the blob nearest the mean of dot k so far
+// return: false if a dot has none within CAPTURE_TOL, or two the same
+bool CalibCapture::Match(const double *x, const double *y)
+{
+	int i, k, n = Dots();
+	std::vector<char> used(n, 0);
+
+	mOrder.resize(n);
+	for (k = 0; k < n; k++) {
+		int best = -1;
+		double best_d = CAPTURE_TOL*CAPTURE_TOL;
+		for (i = 0; i < n; i++) {
+			double dx = x[i] - MeanX(k), dy = y[i] - MeanY(k);
+			if (dx*dx + dy*dy <= best_d) {
+				best_d = dx*dx + dy*dy;
+				best = i;
+			}
+		}
+		if (best < 0 || used[best]) return false;
+		used[best] = 1;
+		mOrder[k] = best;
+	}
+	return true;
+}
+
+bool CalibCapture::Add(const double *x, const double *y, int n)
+{
+	int k;
+
+	if (n != Dots() || n < 4) return false;
+	if (!(mFrames == 0 ? Sort(x, y) : Match(x, y))) return false;
+
+	for (k = 0; k < n; k++) {
+		mSumX[k] += x[mOrder[k]];
+		mSumY[k] += y[mOrder[k]];
+	}
+	mFrames++;
+	return true;
+}
+
+// wx = a11*x + a12*y + a13 and wy alike, from the normal equations; x, y
+// are the pixels of the dots in board order
+void CalibCapture::FitAffine(const double *x, const double *y)
+{
+	double m[9], bx[3], by[3];
+	int k, i, j, n = Dots();
+
+	memset(m, 0, sizeof(m));
+	memset(bx, 0, sizeof(bx));
+	memset(by, 0, sizeof(by));
+	for (k = 0; k < n; k++) {
+		double p[3] = {x[k], y[k], 1.};
+		for (i = 0; i < 3; i++) {
+			for (j = 0; j < 3; j++) m[i*3 + j] += p[i]*p[j];
+			bx[i] += p[i]*mWX[k];
+			by[i] += p[i]*mWY[k];
+		}
+	}
+
+	double m2[9];
+	memcpy(m2, m, sizeof(m));
+	if (Solve(3, m, bx) || Solve(3, m2, by)) return;
+
+	memset(mA, 0, sizeof(mA));
+	for (j = 0; j < 3; j++) {
+		mA[0][j] = bx[j];
+		mA[1][j] = by[j];
+	}
+	mA[2][2] = 1.;
+}
+
+// the linear fit with a33 = 1, on points normalized to about unit spread so
+// the products of pixels and millimeters do not ruin the normal equations
+void CalibCapture::FitHomography(const double *x, const double *y)
+{
+	double m[64], b[8], cx, cy, s, cwx, cwy, sw;
+	int k, i, j, n = Dots();
+
+	Normalize(x, y, n, &cx, &cy, &s);
+	Normalize(&mWX[0], &mWY[0], n, &cwx, &cwy, &sw);
+
+	memset(m, 0, sizeof(m));
+	memset(b, 0, sizeof(b));
+	for (k = 0; k < n; k++) {
+		double u = (x[k] - cx)*s, v = (y[k] - cy)*s;
+		double wu = (mWX[k] - cwx)*sw, wv = (mWY[k] - cwy)*sw;
+		double r[2][8] = {
+			{u, v, 1., 0., 0., 0., -wu*u, -wu*v},
+			{0., 0., 0., u, v, 1., -wv*u, -wv*v}};
+		double rhs[2] = {wu, wv};
+		for (int e = 0; e < 2; e++) {
+			for (i = 0; i < 8; i++) {
+				for (j = 0; j < 8; j++) m[i*8 + j] += r[e][i]*r[e][j];
+				b[i] += r[e][i]*rhs[e];
+			}
+		}
+	}
+	if (Solve(8, m, b)) return;
+
+	// undo the normalizations: A = Tw^-1 Hn Tc
+	double hn[3][3] = {{b[0], b[1], b[2]}, {b[3], b[4], b[5]}, {b[6], b[7], 1.}};
+	double tc[3][3] = {{s, 0., -s*cx}, {0., s, -s*cy}, {0., 0., 1.}};
+	double tw[3][3] = {{1./sw, 0., cwx}, {0., 1./sw, cwy}, {0., 0., 1.}};
+	double t[3][3];
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			t[i][j] = 0.;
+			for (k = 0; k < 3; k++) t[i][j] += hn[i][k]*tc[k][j];
+		}
+	}
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			mA[i][j] = 0.;
+			for (k = 0; k < 3; k++) mA[i][j] += tw[i][k]*t[k][j];
+		}
+	}
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			if (i != 2 || j != 2) mA[i][j] /= mA[2][2];
+		}
+	}
+	mA[2][2] = 1.;
+}
+
+double CalibCapture::Fit(int model)
+{
+	int k, n = Dots();
+	double e = 0.;
+
+	if (mFrames == 0 || n < 4) return -1.;
+
+	std::vector<double> x(n), y(n);
+	for (k = 0; k < n; k++) {
+		x[k] = MeanX(k);
+		y[k] = MeanY(k);
+	}
+
+	mModel = model == CALIB_HOMOGRAPHY ? CALIB_HOMOGRAPHY : CALIB_AFFINE;
+	if (mModel == CALIB_HOMOGRAPHY) FitHomography(&x[0], &y[0]);
+	else FitAffine(&x[0], &y[0]);
+
+	for (k = 0; k < n; k++) {
+		double w = mA[2][0]*x[k] + mA[2][1]*y[k] + mA[2][2];
+		double dx = (mA[0][0]*x[k] + mA[0][1]*y[k] + mA[0][2])/w - mWX[k];
+		double dy = (mA[1][0]*x[k] + mA[1][1]*y[k] + mA[1][2])/w - mWY[k];
+		e += dx*dx + dy*dy;
+	}
+	return sqrt(e/n);
+}
+
+// The lines of the old file that set the model or a coefficient are dropped,
+// the others follow the new coefficients as they were.
+int CalibCapture::Write(const char *filename) const
+{
+	std::vector<std::string> keep;
+	char line[1024], key[16];
+	FILE *fp = fopen(filename, "r");
+
+	if (fp != NULL) {
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			key[0] = 0;
+			sscanf(line, "%15s", key);
+			if (!strncmp(line, HEADER, strlen(HEADER))) continue;
+			if (!strcmp(key, "model")) continue;
+			if (strlen(key) == 3 && (key[0] == 'a' || key[0] == 'p') &&
+				key[1] >= '1' && key[1] <= '3' && key[2] >= '1' && key[2] <= '6') continue;
+			keep.push_back(line);
+		}
+		fclose(fp);
+	}
+
+	fp = fopen(filename, "w");
+	if (fp == NULL) return -1;
+
+	fprintf(fp, "%s, from %d frames of the board\n", HEADER, mFrames);
+	fprintf(fp, "model %s\n", mModel == CALIB_HOMOGRAPHY ? "homography" : "affine");
+	for (int r = 0; r < (mModel == CALIB_HOMOGRAPHY ? 3 : 2); r++) {
+		fprintf(fp, "a%d1 %.10g  a%d2 %.10g  a%d3 %.10g\n",
+			r + 1, mA[r][0], r + 1, mA[r][1], r + 1, mA[r][2]);
+	}
+	for (size_t i = 0; i < keep.size(); i++) fputs(keep[i].c_str(), fp);
+	fclose(fp);
+	return 0;
+}
+
+int CalibCapture::WriteFrame(const char *filename) const
+{
+	if (mFrames == 0) return -1;
+
+	FILE *fp = fopen(filename, "w");
+	if (fp == NULL) return -1;
+	for (int k = 0; k < Dots(); k++) fprintf(fp, "%f %f 1\n", MeanX(k), MeanY(k));
+	fclose(fp);
+	return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef CALIB_CAPTURE_H_
+#define CALIB_CAPTURE_H_
+
+#include <vector>
+
+#include "calib_transform.h"
+
+#define CAPTURE_TOL		3. // pixels a dot may be from its mean of the frames before
+#define CAPTURE_PASSES	3 // the times the order of the first frame is refined, see Sort()
+
+// Fits the calibration of calib_transform.h from frames of the calibration
+// board, in process instead of through camera_frame.txt and calibration.m.
+//
+// The world positions of the dots are read from a file of "x y 1" lines, row
+// by row as they lie on the board; a row is the dots of one y. The blobs of
+// the first frame are sorted by y and cut into rows of the sizes of the world
+// rows, each row sorted by x, and then refined by the homography of that
+// order, so the board only has to be about upright in the image, top row on
+// top, where calibration.m needed it exactly so. Every later frame takes the
+// blob nearest the mean of each dot so far; a frame with a dot without a blob
+// within CAPTURE_TOL is not taken.
+//
+// Fit() solves the affine or homography model by least squares from the mean
+// of each dot over the frames taken; Write() puts the coefficients into the
+// calibration file and keeps its other keys, like radius.
+class CalibCapture
+{
+    public:
+		CalibCapture();
+
+		// return: the number of dots, or -1 if the file cannot be read
+		int LoadWorld(const char *filename);
+		int Dots() const { return (int)mWX.size(); }
+
+		// x, y: the n blobs of a frame
+		// return: true if the frame was taken
+		bool Add(const double *x, const double *y, int n);
+		int Frames() const { return mFrames; }
+
+		// model: CALIB_AFFINE or CALIB_HOMOGRAPHY
+		// return: the RMS error of the dots in mm, or -1 without frames
+		double Fit(int model);
+
+		// writes the model and coefficients of the last Fit() into filename
+		int Write(const char *filename) const;
+		// the mean of every dot as "x y 1" lines, as calibration.m reads them
+		int WriteFrame(const char *filename) const;
+
+    private:
+		std::vector<double> mWX, mWY;
+		std::vector<int> mRows; // the dots of every row of the board
+
+		int mFrames;
+		std::vector<double> mSumX, mSumY;
+
+		// per frame, kept to not allocate every frame
+		std::vector<int> mOrder;
+
+		int mModel;
+		double mA[3][3];
+
+		bool Sort(const double *x, const double *y);
+		bool Match(const double *x, const double *y);
+		double MeanX(int k) const { return mSumX[k]/mFrames; }
+		double MeanY(int k) const { return mSumY[k]/mFrames; }
+		void FitAffine(const double *x, const double *y);
+		void FitHomography(const double *x, const double *y);
+};
+
+#endif /* CALIB_CAPTURE_H_ */
@@ -0,0 +1,131 @@
+#include "calib_transform.h"
+
+#include <string.h>
+
+CalibTransform::CalibTransform()
+{
+	mModel = CALIB_AFFINE;
+
+	// the identity until a calibration is loaded
+	memset(mA, 0, sizeof(mA));
+	memset(mP, 0, sizeof(mP));
+	mA[0][0] = mA[1][1] = mA[2][2] = 1.;
+	mP[0][0] = mP[1][1] = 1.;
+
+	mStep = 0;
+	mCols = mRows = 0;
+}
+
+// key: a11..a33, p11..p26, or grid, the step of the grid in pixels
+int CalibTransform::Set(const char *key, double value)
+{
+	if (!strcmp(key, "grid")) {
+		mStep = value > 0 ? int(value) : 0;
+		return 0;
+	}
+	if (strlen(key) != 3) return -1;
+
+	int r = key[1] - '1';
+	int c = key[2] - '1';
+	if (key[0] == 'a' && r >= 0 && r < 3 && c >= 0 && c < 3) {
+		mA[r][c] = value;
+		return 0;
+	}
+	if (key[0] == 'p' && r >= 0 && r < 2 && c >= 0 && c < 6) {
+		mP[r][c] = value;
+		return 0;
+	}
+	return -1;
+}
+
+int CalibTransform::SetModel(const char *name)
+{
+	if (!strcmp(name, "affine")) mModel = CALIB_AFFINE;
+	else if (!strcmp(name, "homography")) mModel = CALIB_HOMOGRAPHY;
+	else if (!strcmp(name, "poly")) mModel = CALIB_POLY;
+	else return -1;
+	return 0;
+}
+
+void CalibTransform::Precompute(int width, int height)
+{
+	mGridX.clear();
+	mGridY.clear();
+	if (mStep <= 0 || mModel == CALIB_AFFINE || width <= 0 || height <= 0) return;
+
+	// one more node past each edge, so every pixel has a full cell
+	mCols = width/mStep + 2;
+	mRows = height/mStep + 2;
+
+	std::vector<double> x(mCols*mRows), y(mCols*mRows);
+	for (int r = 0; r < mRows; r++) {
+		for (int c = 0; c < mCols; c++) {
+			x[r*mCols + c] = c*mStep;
+			y[r*mCols + c] = r*mStep;
+		}
+	}
+
+	mGridX.resize(mCols*mRows);
+	mGridY.resize(mCols*mRows);
+	Exact(&x[0], &y[0], mCols*mRows, &mGridX[0], &mGridY[0]);
+}
+
+void CalibTransform::Map(const double *x, const double *y, int n, double *wx, double *wy) const
+{
+	if (!mGridX.empty())
+		Lookup(x, y, n, wx, wy);
+	else
+		Exact(x, y, n, wx, wy);
+}
+
+// one loop per model, so the model is not tested per pixel
+void CalibTransform::Exact(const double *x, const double *y, int n, double *wx, double *wy) const
+{
+	int i;
+
+	switch (mModel) {
+	case CALIB_HOMOGRAPHY:
+		for (i = 0; i < n; i++) {
+			double s = 1./(mA[2][0]*x[i] + mA[2][1]*y[i] + mA[2][2]);
+			wx[i] = (mA[0][0]*x[i] + mA[0][1]*y[i] + mA[0][2])*s;
+			wy[i] = (mA[1][0]*x[i] + mA[1][1]*y[i] + mA[1][2])*s;
+		}
+		break;
+
+	case CALIB_POLY:
+		for (i = 0; i < n; i++) {
+			double xx = x[i]*x[i], yy = y[i]*y[i], xy = x[i]*y[i];
+			wx[i] = mP[0][0]*x[i] + mP[0][1]*y[i] + mP[0][2]*xx + mP[0][3]*yy + mP[0][4]*xy + mP[0][5];
+			wy[i] = mP[1][0]*x[i] + mP[1][1]*y[i] + mP[1][2]*xx + mP[1][3]*yy + mP[1][4]*xy + mP[1][5];
+		}
+		break;
+
+	default:
+		for (i = 0; i < n; i++) {
+			wx[i] = mA[0][0]*x[i] + mA[0][1]*y[i] + mA[0][2];
+			wy[i] = mA[1][0]*x[i] + mA[1][1]*y[i] + mA[1][2];
+		}
+		break;
+	}
+}
+
+// bilinear between the four nodes around each pixel; a pixel off the image
+// extrapolates from the nearest cell
+void CalibTransform::Lookup(const double *x, const double *y, int n, double *wx, double *wy) const
+{
+	for (int i = 0; i < n; i++) {
+		double gx = x[i]/mStep, gy = y[i]/mStep;
+		int c = int(gx), r = int(gy);
+		if (c < 0) c = 0;
+		else if (c > mCols - 2) c = mCols - 2;
+		if (r < 0) r = 0;
+		else if (r > mRows - 2) r = mRows - 2;
+		double fx = gx - c, fy = gy - r;
+
+		int k = r*mCols + c;
+		double w00 = (1. - fx)*(1. - fy), w01 = fx*(1. - fy);
+		double w10 = (1. - fx)*fy, w11 = fx*fy;
+		wx[i] = w00*mGridX[k] + w01*mGridX[k + 1] + w10*mGridX[k + mCols] + w11*mGridX[k + mCols + 1];
+		wy[i] = w00*mGridY[k] + w01*mGridY[k + 1] + w10*mGridY[k + mCols] + w11*mGridY[k + mCols + 1];
+	}
+}
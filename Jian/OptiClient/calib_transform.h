@@ -0,0 +1,51 @@
+#ifndef CALIB_TRANSFORM_H_
+#define CALIB_TRANSFORM_H_
+
+#include <vector>
+
+#define CALIB_AFFINE		0
+#define CALIB_HOMOGRAPHY	1
+#define CALIB_POLY			2
+
+// Maps camera pixels to the world, in mm, by the model of the calibration file.
+//
+//   affine      wx = a11*x + a12*y + a13
+//               wy = a21*x + a22*y + a23
+//   homography  as affine, both divided by a31*x + a32*y + a33
+//   poly        wx = p11*x + p12*y + p13*x*x + p14*y*y + p15*x*y + p16
+//               wy = p21*x + p22*y + p23*x*x + p24*y*y + p25*x*y + p26
+//
+// With a grid step, Precompute() evaluates the homography or poly model once
+// at the nodes of a grid over the image, and Map() then interpolates between
+// them, at about the cost of the affine model. The affine model is exact and
+// cheaper than the grid, so it never uses one.
+class CalibTransform
+{
+    public:
+		CalibTransform();
+
+		// return: 0, or -1 if the key or model is unknown
+		int Set(const char *key, double value);
+		int SetModel(const char *name);
+		int Model() const { return mModel; }
+
+		// builds the grid over a width x height image, if there is a step
+		void Precompute(int width, int height);
+
+		// the world positions of n pixels
+		void Map(const double *x, const double *y, int n, double *wx, double *wy) const;
+
+    private:
+		int mModel;
+		double mA[3][3];
+		double mP[2][6];
+
+		// nodes every mStep pixels, mCols x mRows of them; empty without a grid
+		int mStep, mCols, mRows;
+		std::vector<double> mGridX, mGridY;
+
+		void Exact(const double *x, const double *y, int n, double *wx, double *wy) const;
+		void Lookup(const double *x, const double *y, int n, double *wx, double *wy) const;
+};
+
+#endif /* CALIB_TRANSFORM_H_ */
@@ -0,0 +1,205 @@
+#include "camera_group.h"
+
+#include <math.h>
+
+using namespace CameraLibrary;
+
+#define WORKER_WAIT_MS	20 // a worker looks at the quit flag at least this often
+
+CameraGroup::CameraGroup()
+{
+	mAll = 0;
+	mGate = 0.;
+	mQuit = false;
+	mNewest = mLastOut = -1;
+	mPartial = mLate = 0;
+	InitializeCriticalSection(&mLock);
+	mSlotReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+	for (int k = 0; k < GROUP_SLOTS; k++) mSlots[k].id = -1;
+}
+
+CameraGroup::~CameraGroup()
+{
+	Stop();
+	CloseHandle(mSlotReady);
+	DeleteCriticalSection(&mLock);
+}
+
+int CameraGroup::Start(const std::vector<Camera *> &cameras, const std::vector<CalibTransform> &calib,
+					   const ObjectFilter &filter, double gate)
+{
+	Stop();
+	if (cameras.size() > GROUP_MAX_CAMERAS || cameras.size() != calib.size()) return -1;
+
+	mQuit = false;
+	mGate = gate;
+	mNewest = mLastOut = -1;
+	mPartial = mLate = 0;
+	for (int k = 0; k < GROUP_SLOTS; k++) mSlots[k].id = -1;
+
+	for (size_t i = 0; i < cameras.size(); i++) {
+		Worker *w = new Worker;
+		w->mGroup = this;
+		w->mIndex = (int)i;
+		w->mCamera = cameras[i];
+		w->mCalib = calib[i];
+		w->mSource.SetFilter(filter);
+		w->mFrameReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+		w->mCamera->AttachListener(w);
+		w->mThread = CreateThread(NULL, 0, Main, w, 0, NULL);
+		mWorkers.push_back(w);
+		if (w->mThread == NULL) {
+			Stop();
+			return -1;
+		}
+		// as the frame loop, a camera must not wait for the rest of the machine
+		SetThreadPriority(w->mThread, THREAD_PRIORITY_TIME_CRITICAL);
+		mAll |= 1u << i;
+	}
+	return 0;
+}
+
+void CameraGroup::Stop()
+{
+	mQuit = true;
+	for (size_t i = 0; i < mWorkers.size(); i++) {
+		Worker *w = mWorkers[i];
+		if (w->mThread != NULL) {
+			SetEvent(w->mFrameReady);
+			WaitForSingleObject(w->mThread, INFINITE);
+			CloseHandle(w->mThread);
+		}
+		w->mCamera->RemoveListener(w);
+		CloseHandle(w->mFrameReady);
+		delete w;
+	}
+	mWorkers.clear();
+	mAll = 0;
+}
+
+// The view of camera of frame id, n points in world mm.
+void CameraGroup::Put(int camera, int id, double stamp, const double *x, const double *y, int n)
+{
+	EnterCriticalSection(&mLock);
+
+	if (id <= mLastOut) {
+		// its frame went out without it
+		mLate++;
+		LeaveCriticalSection(&mLock);
+		return;
+	}
+
+	Slot &s = mSlots[id & (GROUP_SLOTS - 1)];
+	if (s.id != id) {
+		// a frame GROUP_SLOTS ids old was never handed out; Next() was not called
+		if (s.id >= 0) mLate++;
+		s.id = id;
+		s.cameras = 0;
+		s.stamp = stamp;
+		s.x.clear();
+		s.y.clear();
+		s.camera.clear();
+	}
+	s.cameras |= 1u << camera;
+	for (int i = 0; i < n; i++) {
+		s.x.push_back(x[i]);
+		s.y.push_back(y[i]);
+		s.camera.push_back(camera);
+	}
+	if (id > mNewest) mNewest = id;
+
+	LeaveCriticalSection(&mLock);
+	SetEvent(mSlotReady);
+}
+
+bool CameraGroup::Next(int wait_ms, GroupFrame *f)
+{
+	DWORD start = GetTickCount();
+
+	for (;;) {
+		EnterCriticalSection(&mLock);
+
+		// the oldest frame in the slots, and go only if it is done
+		Slot *oldest = NULL;
+		for (int k = 0; k < GROUP_SLOTS; k++) {
+			Slot &s = mSlots[k];
+			if (s.id >= 0 && (oldest == NULL || s.id < oldest->id)) oldest = &s;
+		}
+		if (oldest != NULL && (oldest->cameras == mAll || mNewest - oldest->id >= GROUP_LAG)) {
+			if (oldest->cameras != mAll) mPartial++;
+			Fuse(*oldest, f);
+			mLastOut = oldest->id;
+			oldest->id = -1;
+			LeaveCriticalSection(&mLock);
+			return true;
+		}
+
+		LeaveCriticalSection(&mLock);
+
+		DWORD waited = GetTickCount() - start;
+		if ((int)waited >= wait_ms) return false;
+		WaitForSingleObject(mSlotReady, wait_ms - waited);
+	}
+}
+
+// The points of different cameras within the gate are one marker: each point
+// joins the first marker so far that has no view of its camera yet.
+void CameraGroup::Fuse(const Slot &s, GroupFrame *f)
+{
+	std::vector<unsigned int> seen;
+	std::vector<int> views;
+	double gate2 = mGate*mGate;
+
+	f->id = s.id;
+	f->stamp = s.stamp;
+	f->cameras = s.cameras;
+	f->x.clear();
+	f->y.clear();
+
+	for (size_t i = 0; i < s.x.size(); i++) {
+		unsigned int bit = 1u << s.camera[i];
+		size_t m;
+		for (m = 0; m < f->x.size(); m++) {
+			double dx = f->x[m]/views[m] - s.x[i], dy = f->y[m]/views[m] - s.y[i];
+			if (!(seen[m] & bit) && dx*dx + dy*dy <= gate2) break;
+		}
+		if (m == f->x.size()) {
+			f->x.push_back(0.);
+			f->y.push_back(0.);
+			seen.push_back(0);
+			views.push_back(0);
+		}
+		f->x[m] += s.x[i];
+		f->y[m] += s.y[i];
+		seen[m] |= bit;
+		views[m]++;
+	}
+
+	for (size_t m = 0; m < f->x.size(); m++) {
+		f->x[m] /= views[m];
+		f->y[m] /= views[m];
+	}
+}
+
+DWORD WINAPI CameraGroup::Main(LPVOID param)
+{
+	Worker *w = (Worker *)param;
+	CameraGroup *g = w->mGroup;
+
+	while (!g->mQuit) {
+		Frame *frame = w->mCamera->GetFrame();
+		if (frame == NULL) {
+			WaitForSingleObject(w->mFrameReady, WORKER_WAIT_MS);
+			continue;
+		}
+
+		int n = w->mSource.Markers(frame, w->mX, w->mY);
+		w->mWX.resize(n);
+		w->mWY.resize(n);
+		if (n > 0) w->mCalib.Map(&w->mX[0], &w->mY[0], n, &w->mWX[0], &w->mWY[0]);
+		g->Put(w->mIndex, frame->FrameID(), frame->TimeStamp(), n > 0 ? &w->mWX[0] : NULL,
+			   n > 0 ? &w->mWY[0] : NULL, n);
+		frame->Release();
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef CAMERA_GROUP_H_
+#define CAMERA_GROUP_H_
+
+#include <windows.h>
+#include <vector>
+
+#include "cameralibrary.h"
+#include "calib_transform.h"
+#include "marker_source.h"
+
+#define GROUP_MAX_CAMERAS	8 // the bits of a GroupFrame's cameras
+#define GROUP_SLOTS			16 // frame ids in flight, a power of two
+#define GROUP_LAG			3 // frames a group waits for the view of a late camera
+
+// The fused markers of one frame id of a CameraGroup, in world mm.
+struct GroupFrame
+{
+	int id;
+	double stamp; // the time stamp of the first camera that saw the frame
+	unsigned int cameras; // bit k for a view of camera k
+	std::vector<double> x, y;
+};
+
+// Several cameras looking at the workspace from different sides, merged into
+// one set of markers per frame, so a marker one camera cannot see is still
+// found by another.
+//
+// Every camera has a worker thread of its own that waits for its frames,
+// takes their objects through an ObjectSource, with the ObjectFilter, maps
+// them to the world with the calibration of that camera and puts them into
+// the slot of the frame id. The cameras must run from one sync chain at one
+// frame rate, so their frame ids agree. A slot is done when every camera put
+// its view, or when a frame GROUP_LAG ids newer came in, so a camera that
+// dropped the frame only costs its markers, not the frame.
+//
+// Next() hands out the done slots in frame id order; a view that comes after
+// its frame was handed out is dropped. The views of a marker from different
+// cameras, within gate mm of each other, are averaged into one.
+class CameraGroup
+{
+    public:
+		CameraGroup();
+		~CameraGroup();
+
+		// cameras: started, in object mode; calib: the world map of each
+		// return: 0, or -1 if there are too many or a thread does not start
+		int Start(const std::vector<CameraLibrary::Camera *> &cameras, const std::vector<CalibTransform> &calib,
+				  const ObjectFilter &filter, double gate);
+		void Stop();
+
+		int Cameras() const { return (int)mWorkers.size(); }
+
+		// waits at most wait_ms for the next frame of the group
+		// return: false if none came
+		bool Next(int wait_ms, GroupFrame *f);
+
+		// frames handed out with a view missing, and views that came too late
+		long Partial() const { return mPartial; }
+		long Late() const { return mLate; }
+
+    private:
+		struct Slot {
+			int id; // -1 for free
+			unsigned int cameras;
+			double stamp;
+			std::vector<double> x, y;
+			std::vector<int> camera; // of every point
+		};
+
+		class Worker : public CameraLibrary::cCameraListener
+		{
+			public:
+				CameraGroup *mGroup;
+				int mIndex;
+				CameraLibrary::Camera *mCamera;
+				CalibTransform mCalib;
+				ObjectSource mSource;
+				HANDLE mFrameReady;
+				HANDLE mThread;
+				std::vector<double> mX, mY, mWX, mWY;
+
+				void FrameAvailable() { SetEvent(mFrameReady); }
+		};
+
+		std::vector<Worker *> mWorkers;
+		unsigned int mAll; // the bits of all cameras
+		double mGate;
+		volatile bool mQuit;
+
+		// the slots, of the workers and Next(), under mLock
+		CRITICAL_SECTION mLock;
+		HANDLE mSlotReady;
+		Slot mSlots[GROUP_SLOTS];
+		int mNewest; // the newest frame id put
+		int mLastOut; // the last frame id handed out
+		volatile long mPartial, mLate;
+
+		void Put(int camera, int id, double stamp, const double *x, const double *y, int n);
+		void Fuse(const Slot &s, GroupFrame *f);
+		static DWORD WINAPI Main(LPVOID param);
+};
+
+#endif /* CAMERA_GROUP_H_ */
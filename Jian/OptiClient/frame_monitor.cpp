@@ -0,0 +1,153 @@
+#include "cameralibrary.h" // OUTPUT
+#include "frame_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+FrameMonitor::FrameMonitor()
+{
+	mLastId = -1;
+	mFrames = mGaps = mLost = mDuplicates = mRejected = 0;
+	mSent = 0;
+	memset((void *)mBin, 0, sizeof(mBin));
+	mMaxUs = 0;
+
+	mLastFrames = mLastGaps = mLastLost = mLastDuplicates = mLastRejected = mLastSent = 0;
+	memset(mLastBin, 0, sizeof(mLastBin));
+
+	LARGE_INTEGER f;
+	QueryPerformanceFrequency(&f);
+	mTicksPerUs = f.QuadPart/1.0e6;
+	mPeriodMs = 0;
+	mThread = NULL;
+	mQuit = NULL;
+}
+
+FrameMonitor::~FrameMonitor()
+{
+	Stop();
+}
+
+int FrameMonitor::Start(double period)
+{
+	if (mThread != NULL || period <= 0.) return 0;
+
+	mPeriodMs = DWORD(period*1000.);
+	mQuit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	mThread = CreateThread(NULL, 0, Main, this, 0, NULL);
+	if (mThread == NULL) {
+		CloseHandle(mQuit);
+		mQuit = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+// Prints the last report before the thread ends.
+void FrameMonitor::Stop()
+{
+	if (mThread == NULL) return;
+
+	SetEvent(mQuit);
+	WaitForSingleObject(mThread, INFINITE);
+	CloseHandle(mThread);
+	CloseHandle(mQuit);
+	mThread = NULL;
+	mQuit = NULL;
+}
+
+LONGLONG FrameMonitor::Now()
+{
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return t.QuadPart;
+}
+
+bool FrameMonitor::Frame(int frame_id)
+{
+	if (frame_id == mLastId) {
+		InterlockedIncrement(&mDuplicates);
+		return false;
+	}
+
+	// a smaller id is a restarted camera, not a gap
+	if (mLastId >= 0 && frame_id > mLastId + 1) {
+		InterlockedIncrement(&mGaps);
+		InterlockedExchangeAdd(&mLost, frame_id - mLastId - 1);
+	}
+	mLastId = frame_id;
+	InterlockedIncrement(&mFrames);
+	return true;
+}
+
+// fetched: Now() when the frame of the sample was got
+void FrameMonitor::Sent(LONGLONG fetched)
+{
+	LONG us = LONG((Now() - fetched)/mTicksPerUs);
+	int k = 0;
+
+	if (us < 0) us = 0;
+	while (k < MONITOR_BINS - 1 && (us >> (k + 1)) != 0) k++;
+	InterlockedIncrement(&mBin[k]);
+	InterlockedIncrement(&mSent);
+
+	// the reporter takes the max back to 0
+	LONG max = mMaxUs;
+	while (us > max) {
+		LONG seen = InterlockedCompareExchange(&mMaxUs, us, max);
+		if (seen == max) break;
+		max = seen;
+	}
+}
+
+// Prints the counts since the last report; the percentiles are the upper
+// bounds of their bins.
+void FrameMonitor::Report()
+{
+	char buff[300];
+	LONG bin[MONITOR_BINS];
+	LONG n = 0;
+	int k;
+
+	for (k = 0; k < MONITOR_BINS; k++) {
+		LONG b = mBin[k];
+		bin[k] = b - mLastBin[k];
+		mLastBin[k] = b;
+		n += bin[k];
+	}
+
+	LONG p50 = 0, p99 = 0, seen = 0;
+	for (k = 0; k < MONITOR_BINS && n > 0; k++) {
+		seen += bin[k];
+		if (p50 == 0 && seen*2 >= n) p50 = 2L << k;
+		if (seen*100 >= n*99) { p99 = 2L << k; break; }
+	}
+
+	LONG frames = mFrames, gaps = mGaps, lost = mLost;
+	LONG duplicates = mDuplicates, rejected = mRejected, sent = mSent;
+
+	sprintf_s(buff, "frames %ld, gaps %ld (%ld lost), duplicates %ld, rejected %ld, sent %ld, latency us p50 <%ld p99 <%ld max %ld",
+			  frames - mLastFrames, gaps - mLastGaps, lost - mLastLost,
+			  duplicates - mLastDuplicates, rejected - mLastRejected, sent - mLastSent,
+			  p50, p99, InterlockedExchange(&mMaxUs, 0));
+	OUTPUT(buff);
+
+	mLastFrames = frames;
+	mLastGaps = gaps;
+	mLastLost = lost;
+	mLastDuplicates = duplicates;
+	mLastRejected = rejected;
+	mLastSent = sent;
+}
+
+DWORD WINAPI FrameMonitor::Main(LPVOID param)
+{
+	FrameMonitor *me = (FrameMonitor *)param;
+
+	while (WaitForSingleObject(me->mQuit, me->mPeriodMs) == WAIT_TIMEOUT) {
+		me->Report();
+	}
+
+	me->Report();
+	return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef FRAME_MONITOR_H_
+#define FRAME_MONITOR_H_
+
+#include <windows.h>
+
+#define MONITOR_BINS	24 // latency bin k counts [2^k, 2^(k+1)) microseconds
+
+// Counts what happens to the camera frames, and how long a sample takes from
+// GetFrame() to its send, so the frame rate and exposure can be tuned by data.
+//
+// The frame loop calls Frame() for every frame it gets and Reject() for every
+// frame it throws away; the sender thread calls Sent() after each send. All are
+// interlocked increments, nobody waits. A reporter thread prints the counts of
+// the last period and the latency percentiles from the log2 histogram.
+class FrameMonitor
+{
+    public:
+		FrameMonitor();
+		~FrameMonitor();
+
+		// period: seconds between the reports, 0 for none
+		int Start(double period);
+		void Stop();
+
+		// the clock of the latencies, in QueryPerformanceCounter ticks
+		static LONGLONG Now();
+
+		// return: false for a frame id that was already seen
+		bool Frame(int frame_id);
+		void Reject() { InterlockedIncrement(&mRejected); }
+		void Sent(LONGLONG fetched);
+
+		void Report();
+
+    private:
+		// written by the frame loop
+		int mLastId;
+		volatile LONG mFrames, mGaps, mLost, mDuplicates, mRejected;
+
+		// written by the sender thread
+		volatile LONG mSent;
+		volatile LONG mBin[MONITOR_BINS];
+		volatile LONG mMaxUs;
+
+		// the counts at the last report, of the reporter
+		LONG mLastFrames, mLastGaps, mLastLost, mLastDuplicates, mLastRejected, mLastSent;
+		LONG mLastBin[MONITOR_BINS];
+
+		double mTicksPerUs;
+		DWORD mPeriodMs;
+		HANDLE mThread;
+		HANDLE mQuit;
+
+		static DWORD WINAPI Main(LPVOID param);
+};
+
+#endif /* FRAME_MONITOR_H_ */
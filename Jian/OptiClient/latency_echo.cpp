@@ -0,0 +1,31 @@
+#include "latency_echo.h"
+
+LatencyEcho::LatencyEcho(double x, double y, double gate)
+	: mX(x), mY(y), mGate(gate), mLit(false), mTransitions(0)
+{
+}
+
+bool LatencyEcho::Take(std::vector<double> &x, std::vector<double> &y, int &n)
+{
+	int led = -1;
+	double best = mGate*mGate;
+
+	for (int i = 0; i < n; i++) {
+		double dx = x[i] - mX, dy = y[i] - mY;
+		if (dx*dx + dy*dy <= best) {
+			best = dx*dx + dy*dy;
+			led = i;
+		}
+	}
+
+	if (led >= 0) {
+		x.erase(x.begin() + led);
+		y.erase(y.begin() + led);
+		n--;
+	}
+
+	bool lit = led >= 0;
+	if (lit != mLit) mTransitions++;
+	mLit = lit;
+	return lit;
+}
@@ -0,0 +1,38 @@
+#ifndef LATENCY_ECHO_H_
+#define LATENCY_ECHO_H_
+
+#include <vector>
+
+#define VISION_ECHO_ROI	7 // LATENCY_PROBE_ROI of the qnx LatencyProbe.h
+
+// The vision half of the latency probe of the qnx server: the server lights
+// an LED in the view of the camera, and every frame tells it whether the LED
+// is lit, as the x of a sample of VISION_ECHO_ROI.
+//
+// The LED is the blob within gate pixels of the camera pixel (x, y) of the
+// config; it is taken out of the blobs of the frame, so the markers are
+// matched as if it were not there. The echo goes out right away, not through
+// the VisionSender, whose newest-sample mailbox would replace it with the
+// markers of the same frame.
+class LatencyEcho
+{
+    public:
+		// x < 0 for none
+		LatencyEcho(double x, double y, double gate);
+
+		bool Enabled() const { return mX >= 0; }
+
+		// removes the blob of the LED from the n blobs of x, y
+		// return: whether there was one; n is one less then
+		bool Take(std::vector<double> &x, std::vector<double> &y, int &n);
+
+		long Transitions() const { return mTransitions; }
+
+    private:
+		double mX, mY;
+		double mGate;
+		bool mLit;
+		long mTransitions;
+};
+
+#endif /* LATENCY_ECHO_H_ */
@@ -0,0 +1,208 @@
+#include "marker_match.h"
+
+#include <math.h>
+#include <algorithm>
+
+MarkerMatch::MarkerMatch(int markers, double gate)
+	: mN(markers), mGate(gate), mStarted(false),
+	mX(markers, 0.), mY(markers, 0.), mVX(markers, 0.), mVY(markers, 0.), mAge(markers, 1)
+{
+}
+
+void MarkerMatch::Reset(const double *x, const double *y)
+{
+	for (int j = 0; j < mN; j++) {
+		mX[j] = x[j];
+		mY[j] = y[j];
+		mVX[j] = mVY[j] = 0.;
+		mAge[j] = 0;
+	}
+	mStarted = true;
+}
+
+double MarkerMatch::Gate(int j) const
+{
+	int k = mAge[j] < 1 ? 1 : mAge[j];
+	return mGate * (k < MATCH_GATE_GROWTH ? k : MATCH_GATE_GROWTH);
+}
+
+// to the position of track j predicted for this frame
+double MarkerMatch::Distance2(int j, double x, double y) const
+{
+	double dx = x - (mX[j] + mVX[j]*mAge[j]);
+	double dy = y - (mY[j] + mVY[j]*mAge[j]);
+	return dx*dx + dy*dy;
+}
+
+// x, y: the n blobs of the frame
+// frames: the frame ids since the last call, 1 if none was skipped
+// return: the number of markers found
+int MarkerMatch::Match(const double *x, const double *y, int n, int frames, int *assign)
+{
+	int j, found = 0;
+
+	for (j = 0; j < mN; j++) assign[j] = -1;
+	if (!mStarted) return 0;
+
+	for (j = 0; j < mN; j++) mAge[j] += frames > 0 ? frames : 1;
+
+	if (n > 0) {
+		if (mN <= MATCH_HUNGARIAN_MAX && n <= MATCH_HUNGARIAN_MAX)
+			Hungarian(x, y, n, assign);
+		else
+			Grid(x, y, n, assign);
+	}
+
+	for (j = 0; j < mN; j++) {
+		int i = assign[j];
+		if (i < 0) continue;
+
+		mVX[j] = (x[i] - mX[j]) / mAge[j];
+		mVY[j] = (y[i] - mY[j]) / mAge[j];
+		mX[j] = x[i];
+		mY[j] = y[i];
+		mAge[j] = 0;
+		found++;
+	}
+	return found;
+}
+
+// The Hungarian method with potentials on the square matrix of tracks by blobs,
+// padded with dummy rows or columns. A pair outside its gate, or with a dummy,
+// costs more than all pairs within their gates together, so the most pairs are
+// matched first; those pairs are dropped afterwards.
+void MarkerMatch::Hungarian(const double *x, const double *y, int n, int *assign)
+{
+	int k = mN > n ? mN : n;
+	int i, j, i0, j0, j1;
+	double g = mGate * MATCH_GATE_GROWTH;
+	double big = (k + 1) * g * g;
+	double delta, cur;
+
+	mCost.resize(k * k);
+	for (j = 0; j < k; j++) {
+		double gate2 = j < mN ? Gate(j) * Gate(j) : 0.;
+		for (i = 0; i < k; i++) {
+			double d2 = j < mN && i < n ? Distance2(j, x[i], y[i]) : big;
+			mCost[j*k + i] = d2 <= gate2 ? d2 : big;
+		}
+	}
+
+	// rows and columns are 1 based, column 0 and p[0] are the free start
+	std::vector<double> u(k + 1, 0.), v(k + 1, 0.), minv(k + 1);
+	std::vector<int> p(k + 1, 0), way(k + 1, 0);
+	std::vector<char> used(k + 1);
+
+	for (int r = 1; r <= k; r++) {
+		p[0] = r;
+		j0 = 0;
+		std::fill(minv.begin(), minv.end(), HUGE_VAL);
+		std::fill(used.begin(), used.end(), 0);
+		do {
+			used[j0] = 1;
+			i0 = p[j0];
+			delta = HUGE_VAL;
+			j1 = 0;
+			for (j = 1; j <= k; j++) {
+				if (used[j]) continue;
+				cur = mCost[(i0 - 1)*k + (j - 1)] - u[i0] - v[j];
+				if (cur < minv[j]) {
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if (minv[j] < delta) {
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (j = 0; j <= k; j++) {
+				if (used[j]) {
+					u[p[j]] += delta;
+					v[j] -= delta;
+				}
+				else {
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (p[j0] != 0);
+
+		do {
+			j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0);
+	}
+
+	for (i = 1; i <= k; i++) {
+		j = p[i] - 1;
+		if (j < mN && i - 1 < n && mCost[j*k + i - 1] < big)
+			assign[j] = i - 1;
+	}
+}
+
+// Hashes the blobs into cells as large as the largest gate, so every track
+// only looks at the blobs of the 3 x 3 cells around its prediction, then
+// takes the closest pairs first. Not always the optimal assignment, but
+// linear in the markers for any number of them.
+void MarkerMatch::Grid(const double *x, const double *y, int n, int *assign)
+{
+	int i, j, c, cx, cy, dx, dy;
+	double cell = mGate * MATCH_GATE_GROWTH;
+	double minx = x[0], miny = y[0], maxx = x[0], maxy = y[0];
+
+	for (i = 1; i < n; i++) {
+		minx = x[i] < minx ? x[i] : minx;
+		miny = y[i] < miny ? y[i] : miny;
+		maxx = x[i] > maxx ? x[i] : maxx;
+		maxy = y[i] > maxy ? y[i] : maxy;
+	}
+	int cols = (int)((maxx - minx) / cell) + 1;
+	int rows = (int)((maxy - miny) / cell) + 1;
+
+	// counting sort: the blobs of cell c are mOrder[mCell[c] .. mCell[c + 1])
+	mCell.assign(cols * rows + 1, 0);
+	mOrder.resize(n);
+	mBlob.resize(n);
+	for (i = 0; i < n; i++) {
+		mBlob[i] = (int)((y[i] - miny) / cell) * cols + (int)((x[i] - minx) / cell);
+		mCell[mBlob[i] + 1]++;
+	}
+	for (c = 0; c < cols * rows; c++) mCell[c + 1] += mCell[c];
+	for (i = 0; i < n; i++) mOrder[mCell[mBlob[i]]++] = i;
+	for (c = cols * rows; c > 0; c--) mCell[c] = mCell[c - 1];
+	mCell[0] = 0;
+
+	mPairs.clear();
+	for (j = 0; j < mN; j++) {
+		double px = mX[j] + mVX[j]*mAge[j];
+		double py = mY[j] + mVY[j]*mAge[j];
+		double gate2 = Gate(j) * Gate(j);
+
+		cx = (int)floor((px - minx) / cell);
+		cy = (int)floor((py - miny) / cell);
+		for (dy = -1; dy <= 1; dy++) {
+			if (cy + dy < 0 || cy + dy >= rows) continue;
+			for (dx = -1; dx <= 1; dx++) {
+				if (cx + dx < 0 || cx + dx >= cols) continue;
+				c = (cy + dy) * cols + cx + dx;
+				for (int o = mCell[c]; o < mCell[c + 1]; o++) {
+					Pair pr;
+					pr.blob = mOrder[o];
+					pr.track = j;
+					pr.d2 = Distance2(j, x[pr.blob], y[pr.blob]);
+					if (pr.d2 <= gate2) mPairs.push_back(pr);
+				}
+			}
+		}
+	}
+
+	std::sort(mPairs.begin(), mPairs.end());
+	std::fill(mBlob.begin(), mBlob.end(), 0); // now 1 for a taken blob
+	for (size_t k = 0; k < mPairs.size(); k++) {
+		const Pair &pr = mPairs[k];
+		if (assign[pr.track] >= 0 || mBlob[pr.blob]) continue;
+		assign[pr.track] = pr.blob;
+		mBlob[pr.blob] = 1;
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef MARKER_MATCH_H_
+#define MARKER_MATCH_H_
+
+#include <vector>
+
+#define MATCH_HUNGARIAN_MAX	32 // more tracks or blobs than this are matched on a grid
+#define MATCH_GATE_GROWTH	4 // the gate of a lost marker grows up to this many times
+
+// Tells which blob of a frame is which marker.
+//
+// Every marker is a track with a position and a velocity in pixels per frame.
+// Its position in a new frame is predicted from them, and a blob is only taken
+// for the marker if it lies within the gate around the prediction; the gate of
+// a marker last seen k frames ago is k times as large, up to
+// MATCH_GATE_GROWTH times. Among all pairs within their gates the assignment
+// with the most pairs and then the smallest sum of squared distances is taken,
+// by the Hungarian method, so two markers passing each other are not swapped.
+// With more than MATCH_HUNGARIAN_MAX tracks or blobs, the blobs are hashed into
+// a grid of gate sized cells and the closest pairs are taken first instead.
+//
+// Extra blobs are ignored; a marker without a blob keeps its track and is
+// found again when it comes back within its gate.
+class MarkerMatch
+{
+    public:
+		MarkerMatch(int markers, double gate);
+
+		// starts the tracks at the given positions, with no velocity
+		void Reset(const double *x, const double *y);
+		bool Started() const { return mStarted; }
+
+		// assign[j] is the blob of marker j, or -1; frames have passed since the last call
+		int Match(const double *x, const double *y, int n, int frames, int *assign);
+
+		double Gate(int j) const;
+
+    private:
+		int mN;
+		double mGate;
+		bool mStarted;
+
+		// the last seen position and velocity of every track, and the frames since
+		std::vector<double> mX, mY, mVX, mVY;
+		std::vector<int> mAge;
+
+		// a blob within the gate of a track
+		struct Pair {
+			double d2;
+			int track, blob;
+			bool operator<(const Pair &o) const { return d2 < o.d2; }
+		};
+
+		// per call, kept to not allocate every frame
+		std::vector<double> mCost;
+		std::vector<int> mCell, mOrder, mBlob;
+		std::vector<Pair> mPairs;
+
+		void Hungarian(const double *x, const double *y, int n, int *assign);
+		void Grid(const double *x, const double *y, int n, int *assign);
+		double Distance2(int j, double x, double y) const;
+};
+
+#endif /* MARKER_MATCH_H_ */
@@ -0,0 +1,245 @@
+#include "marker_source.h"
+
+#include <string.h>
+
+using namespace CameraLibrary;
+
+ObjectFilter::ObjectFilter()
+{
+	min_area = max_area = 0.;
+	min_radius = max_radius = 0.;
+	min_roundness = 0.;
+	max_aspect = 0.;
+}
+
+bool ObjectFilter::Enabled() const
+{
+	return min_area > 0. || max_area > 0. || min_radius > 0. || max_radius > 0. ||
+		min_roundness > 0. || max_aspect > 0.;
+}
+
+ObjectSource::ObjectSource()
+{
+	mFiltered = false;
+	mSeen = mRejected = 0;
+}
+
+void ObjectSource::SetFilter(const ObjectFilter &filter)
+{
+	mFilter = filter;
+	mFiltered = filter.Enabled();
+}
+
+int ObjectSource::Markers(Frame *frame, std::vector<double> &x, std::vector<double> &y)
+{
+	int i, n = frame->ObjectCount();
+
+	x.resize(n);
+	y.resize(n);
+	mSeen += n;
+	if (!mFiltered) {
+		for (i = 0; i < n; i++) {
+			x[i] = frame->Object(i)->X();
+			y[i] = frame->Object(i)->Y();
+		}
+		return n;
+	}
+
+	mArea.resize(n);
+	mRadius.resize(n);
+	mRoundness.resize(n);
+	mAspect.resize(n);
+	for (i = 0; i < n; i++) {
+		cObject *o = frame->Object(i);
+		double w = o->Width(), h = o->Height();
+
+		x[i] = o->X();
+		y[i] = o->Y();
+		mArea[i] = o->Area();
+		mRadius[i] = o->Radius();
+		mRoundness[i] = o->Roundness();
+		mAspect[i] = w > h ? w/(h > 1. ? h : 1.) : h/(w > 1. ? w : 1.);
+	}
+
+	// the objects that pass move down over those that did not, in order
+	const ObjectFilter &f = mFilter;
+	int kept = 0;
+	for (i = 0; i < n; i++) {
+		if ((f.min_area > 0. && mArea[i] < f.min_area) || (f.max_area > 0. && mArea[i] > f.max_area) ||
+			(f.min_radius > 0. && mRadius[i] < f.min_radius) || (f.max_radius > 0. && mRadius[i] > f.max_radius) ||
+			(f.min_roundness > 0. && mRoundness[i] < f.min_roundness) ||
+			(f.max_aspect > 0. && mAspect[i] > f.max_aspect)) {
+			continue;
+		}
+		x[kept] = x[i];
+		y[kept] = y[i];
+		kept++;
+	}
+	mRejected += n - kept;
+	x.resize(kept);
+	y.resize(kept);
+	return kept;
+}
+
+void SegmentMerger::Begin()
+{
+	mPrev.clear();
+	mCur.clear();
+	mRow = -2;
+	mNext = 0;
+	mParent.clear();
+	mArea.clear();
+	mSumX.clear();
+	mSumY.clear();
+}
+
+int SegmentMerger::Find(int label)
+{
+	while (mParent[label] != label) {
+		mParent[label] = mParent[mParent[label]];
+		label = mParent[label];
+	}
+	return label;
+}
+
+// the root with the smaller label stays, so a blob keeps the label of its top run
+void SegmentMerger::Union(int a, int b)
+{
+	a = Find(a);
+	b = Find(b);
+	if (a < b) mParent[b] = a;
+	else if (b < a) mParent[a] = b;
+}
+
+void SegmentMerger::Run(int y, int x0, int x1)
+{
+	if (y != mRow) {
+		// only the row right above can touch
+		if (y == mRow + 1) mPrev.swap(mCur);
+		else mPrev.clear();
+		mCur.clear();
+		mNext = 0;
+		mRow = y;
+	}
+
+	// the runs above that end left of this one end left of the next ones too
+	while (mNext < mPrev.size() && mPrev[mNext].x1 < x0 - 1) mNext++;
+
+	int label = -1;
+	for (size_t k = mNext; k < mPrev.size() && mPrev[k].x0 <= x1 + 1; k++) {
+		if (label < 0) label = Find(mPrev[k].label);
+		else Union(label, mPrev[k].label);
+	}
+
+	if (label < 0) {
+		label = (int)mParent.size();
+		mParent.push_back(label);
+		mArea.push_back(0.);
+		mSumX.push_back(0.);
+		mSumY.push_back(0.);
+	}
+
+	double n = x1 - x0 + 1;
+	mArea[label] += n;
+	mSumX[label] += n*(x0 + x1)*0.5;
+	mSumY[label] += n*y;
+
+	Span s = {x0, x1, label};
+	mCur.push_back(s);
+}
+
+int SegmentMerger::End(int min_area, std::vector<double> &x, std::vector<double> &y)
+{
+	int l, r, n = (int)mParent.size();
+
+	// every label moves its moments to its root once, roots never move
+	for (l = 0; l < n; l++) {
+		r = Find(l);
+		if (r == l) continue;
+		mArea[r] += mArea[l];
+		mSumX[r] += mSumX[l];
+		mSumY[r] += mSumY[l];
+		mArea[l] = 0.;
+	}
+
+	x.clear();
+	y.clear();
+	for (l = 0; l < n; l++) {
+		if (mParent[l] != l || mArea[l] < min_area) continue;
+		x.push_back(mSumX[l]/mArea[l]);
+		y.push_back(mSumY[l]/mArea[l]);
+	}
+	return (int)x.size();
+}
+
+SegmentSource::SegmentSource(int width, int height)
+	: mWidth(width), mHeight(height), mPixels(width*height)
+{
+	mBitmap = new Bitmap(width, height, width, Bitmap::EightBit, &mPixels[0]);
+}
+
+SegmentSource::~SegmentSource()
+{
+	delete mBitmap;
+}
+
+int SegmentSource::Markers(Frame *frame, std::vector<double> &x, std::vector<double> &y)
+{
+	// the camera library draws the segments of the frame, everything else stays dark
+	memset(&mPixels[0], 0, mPixels.size());
+	frame->Rasterize(mBitmap);
+	return Markers(&mPixels[0], mWidth, x, y);
+}
+
+int SegmentSource::Markers(const unsigned char *pixels, int span, std::vector<double> &x, std::vector<double> &y)
+{
+	int i, j, x0;
+
+	mMerger.Begin();
+	for (j = 0; j < mHeight; j++) {
+		const unsigned char *row = pixels + j*span;
+		for (i = 0; i < mWidth; i++) {
+			if (row[i] < SOURCE_THRESHOLD) continue;
+			for (x0 = i; i + 1 < mWidth && row[i + 1] >= SOURCE_THRESHOLD; i++);
+			mMerger.Run(j, x0, i);
+		}
+	}
+	return mMerger.End(SOURCE_MIN_AREA, x, y);
+}
+
+SourceBench::SourceBench()
+{
+	mSeen = mFrames = 0;
+	mFirst = mLast = mCost = 0;
+	mMarkers = 0.;
+
+	LARGE_INTEGER f;
+	QueryPerformanceFrequency(&f);
+	mTicksPerUs = f.QuadPart/1.0e6;
+}
+
+bool SourceBench::Frame(int markers, LONGLONG now, LONGLONG cost)
+{
+	if (++mSeen <= SOURCE_BENCH_SKIP) return true;
+
+	if (mFrames == 0) mFirst = now;
+	mLast = now;
+	mCost += cost;
+	mMarkers += markers;
+	return ++mFrames < SOURCE_BENCH_FRAMES;
+}
+
+double SourceBench::Rate() const
+{
+	return mLast > mFirst ? (mFrames - 1)*1.0e6/((mLast - mFirst)/mTicksPerUs) : 0.;
+}
+
+double SourceBench::CostUs() const
+{
+	return mFrames > 0 ? mCost/mTicksPerUs/mFrames : 0.;
+}
+
+double SourceBench::MeanMarkers() const
+{
+	return mFrames > 0 ? mMarkers/mFrames : 0.;
+}
@@ -0,0 +1,149 @@
+#ifndef MARKER_SOURCE_H_
+#define MARKER_SOURCE_H_
+
+#include <windows.h>
+#include <vector>
+
+#include "cameralibrary.h"
+
+#define SOURCE_THRESHOLD	128 // the raster level a marker pixel has at least
+#define SOURCE_MIN_AREA		4 // pixels, smaller segment blobs are noise
+#define SOURCE_BENCH_FRAMES	200 // frames every video mode is timed for, see SourceBench
+#define SOURCE_BENCH_SKIP	10 // frames after a mode switch that may still be of the old mode
+
+// Where the frame loop gets the blob centers of a frame from.
+//
+// An ObjectSource takes the centroids the camera computed in object mode. A
+// SegmentSource rasterizes the run length segments of segment mode into a
+// buffer of its own and merges the runs of the rows into blobs on the host,
+// see SegmentMerger; with many markers the camera sends segments at a higher
+// rate than it can centroid them. Which one is faster for the markers in view
+// is measured by SourceBench, see video_mode auto in opti_config.h.
+class MarkerSource
+{
+    public:
+		virtual ~MarkerSource() {}
+
+		// x, y: resized to the blobs of the frame, in camera pixels
+		// return: the number of blobs
+		virtual int Markers(CameraLibrary::Frame *frame, std::vector<double> &x, std::vector<double> &y) = 0;
+};
+
+// The shape an object of the camera has to have to be a marker; a limit of 0
+// is no limit. Reflections off the rig and the hand come out as objects too,
+// larger, smaller or less round than the markers, and without the filter they
+// make the count of a frame wrong.
+struct ObjectFilter
+{
+	double min_area, max_area; // pixels
+	double min_radius, max_radius; // pixels
+	double min_roundness; // 0 to 1, of the camera
+	double max_aspect; // of the bounding box, the longer over the shorter side
+
+	ObjectFilter();
+
+	bool Enabled() const;
+};
+
+// Takes the objects of the frame as they are, or only those that pass the
+// shape of an ObjectFilter. With a filter the attributes of all objects are
+// copied into one array per attribute first, so the tests run over them in a
+// tight loop and the cObjects of the camera library are read only once.
+class ObjectSource : public MarkerSource
+{
+    public:
+		ObjectSource();
+
+		void SetFilter(const ObjectFilter &filter);
+		int Markers(CameraLibrary::Frame *frame, std::vector<double> &x, std::vector<double> &y);
+
+		// the objects seen and those the filter took out, since the start
+		unsigned int Seen() const { return mSeen; }
+		unsigned int Rejected() const { return mRejected; }
+
+    private:
+		ObjectFilter mFilter;
+		bool mFiltered;
+		unsigned int mSeen, mRejected;
+
+		// the attributes of the objects of the frame, by object
+		std::vector<double> mArea, mRadius, mRoundness, mAspect;
+};
+
+// Merges the runs of a binary image, row by row, into 8-connected blobs.
+//
+// Every run is labeled with the blob of the first run of the row above it
+// touches; a run that touches two blobs joins them in a union-find, and the
+// moments of a blob are only summed over its root at the end, so every run
+// is looked at once and the rows are never revisited.
+class SegmentMerger
+{
+    public:
+		void Begin();
+		// the pixels x0 to x1 of row y are on; rows come in increasing y, the
+		// runs of a row in increasing x
+		void Run(int y, int x0, int x1);
+		// x, y: the centers of the blobs of at least min_area pixels
+		// return: their number
+		int End(int min_area, std::vector<double> &x, std::vector<double> &y);
+
+    private:
+		struct Span {
+			int x0, x1, label;
+		};
+
+		// the runs of the last and of the current row
+		std::vector<Span> mPrev, mCur;
+		int mRow;
+		size_t mNext; // the first run of mPrev that can still touch a run of mCur
+
+		// per label: union-find parent, pixels and their x and y sums
+		std::vector<int> mParent;
+		std::vector<double> mArea, mSumX, mSumY;
+
+		int Find(int label);
+		void Union(int a, int b);
+};
+
+class SegmentSource : public MarkerSource
+{
+    public:
+		SegmentSource(int width, int height);
+		~SegmentSource();
+
+		int Markers(CameraLibrary::Frame *frame, std::vector<double> &x, std::vector<double> &y);
+
+		// merges the runs of an 8 bit image of width x height, span bytes a row
+		int Markers(const unsigned char *pixels, int span, std::vector<double> &x, std::vector<double> &y);
+
+    private:
+		int mWidth, mHeight;
+		std::vector<unsigned char> mPixels;
+		CameraLibrary::Bitmap *mBitmap;
+		SegmentMerger mMerger;
+};
+
+// Times the frames the camera delivers in a video mode and what the source of
+// the mode costs on the host, to choose the faster mode for the markers in view.
+class SourceBench
+{
+    public:
+		SourceBench();
+
+		// a frame of the mode, taken at now with Markers() lasting cost, in
+		// QueryPerformanceCounter ticks; return: false once enough were seen
+		bool Frame(int markers, LONGLONG now, LONGLONG cost);
+
+		// frames per second the mode delivered and the host microseconds a frame
+		double Rate() const;
+		double CostUs() const;
+		double MeanMarkers() const;
+
+    private:
+		int mSeen, mFrames;
+		LONGLONG mFirst, mLast, mCost;
+		double mMarkers;
+		double mTicksPerUs;
+};
+
+#endif /* MARKER_SOURCE_H_ */
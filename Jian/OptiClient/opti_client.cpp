@@ -0,0 +1,321 @@
+#include "opti_client.h"
+#include "cameramanager.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace CameraLibrary;
+
+OptiClient::OptiClient()
+	: mSender(&mNet)
+{
+	mCamera = NULL;
+	mTexture = NULL;
+	mFramebuffer = NULL;
+	mSegments = NULL;
+	mSource = &mObjects;
+	memset(&mRt, 0, sizeof(mRt));
+	mSender.SetMonitor(&mMonitor);
+	mListener.mFrameReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+OptiClient::~OptiClient()
+{
+	Close();
+	CloseHandle(mListener.mFrameReady);
+}
+
+// config: the settings file, see opti_config.h
+// window: open the preview window, as for calibration
+Camera *OptiClient::Open(const char *config, bool window)
+{
+	mCfg.Load(config);
+
+	//== The frame loop runs on this thread, give it the machine ==--
+
+	if (mCfg.realtime)
+	{
+		RtProfileConfig rtc;
+		rt_profile_defaults(&rtc);
+		rtc.cpu = mCfg.cpu;
+		rt_profile_apply(&mRt, &rtc);
+		rt_profile_report(&mRt, stdout);
+	}
+
+	//== For OptiTrack Ethernet cameras, it's important to enable development mode if you
+	//== want to stop execution for an extended time while debugging without disconnecting
+	//== the Ethernet devices.  Lets do that now:
+
+	CameraLibrary_EnableDevelopment();
+
+	//== Initialize connected cameras ==========----
+
+    CameraManager::X().WaitForInitialization();
+
+    //== Get the connected cameras, camera of the config first, cameras of them ==----
+
+	CameraList list;
+	int first = mCfg.camera < list.Count() ? mCfg.camera : 0;
+	int count = window ? 1 : (mCfg.cameras > 0 ? mCfg.cameras : list.Count() - first);
+	for (int k = first; k < list.Count() && (int)mCameras.size() < count; k++) {
+		Camera *camera = CameraManager::X().GetCamera(list[k].UID());
+		if (camera != NULL) mCameras.push_back(camera);
+	}
+	// a camera without a calibration would put its markers anywhere
+	if (mCameras.size() > mCfg.camera_calib.size()) {
+		printf("%d cameras, but calibrations for %d, see camera_calibration\n",
+			(int)mCameras.size(), (int)mCfg.camera_calib.size());
+		for (size_t k = mCfg.camera_calib.size(); k < mCameras.size(); k++) mCameras[k]->Release();
+		mCameras.resize(mCfg.camera_calib.size());
+	}
+	mCamera = mCameras.empty() ? NULL : mCameras[0];
+
+    //== If no device connected, pop a message box and exit ==--
+
+    if(mCamera==0)
+    {
+        MessageBox(0,"Please connect a camera","No Device Connected", MB_OK);
+        return NULL;
+    }
+
+	//== Determine camera resolution to size application window ==----
+
+    int cameraWidth  = mCamera->Width();
+    int cameraHeight = mCamera->Height();
+
+	//== A homography or poly calibration with a grid is sampled once here ==--
+
+	mCfg.calib.Precompute(cameraWidth, cameraHeight);
+	for (size_t k = 0; k < mCameras.size(); k++) {
+		mCfg.camera_calib[k].Precompute(mCameras[k]->Width(), mCameras[k]->Height());
+	}
+
+	//== Headless (no window): no texture, and frames are never rasterized
+
+	if (window)
+	{
+		if (!CreateAppWindow("Camera Library SDK - Sample",cameraWidth,cameraHeight,32,gFullscreen))
+		{
+			Close();
+			return NULL;
+		}
+
+    //== We're using textures because it's an easy & cpu light
+    //== way to utilize the 3D hardware to display camera
+    //== imagery at high frame rates
+
+		mTexture = new Surface(cameraWidth, cameraHeight);
+		mFramebuffer = new Bitmap(cameraWidth, cameraHeight, mTexture->PixelSpan()*4,
+								   Bitmap::ThirtyTwoBit, mTexture->GetBuffer());
+	}
+
+    //== Set Video Mode, auto is chosen once the camera runs ==--
+
+	// the workers of a group take the objects of the camera
+	if (mCameras.size() > 1 && mCfg.video_mode != OPTI_OBJECT_MODE) {
+		printf("a group of %d cameras runs in object mode\n", (int)mCameras.size());
+		mCfg.video_mode = OPTI_OBJECT_MODE;
+	}
+	mSegments = new SegmentSource(cameraWidth, cameraHeight);
+	mObjects.SetFilter(mCfg.filter);
+	VideoMode(mCfg.video_mode == OPTI_AUTO_MODE ? OPTI_OBJECT_MODE : mCfg.video_mode);
+
+	for (size_t k = 0; k < mCameras.size(); k++) {
+		if (k > 0) mCameras[k]->SetVideoType(ObjectMode);
+
+		//Set camera frame rate, the same on all, so the sync chain keeps the frame ids together
+		mCameras[k]->SetFrameRate(mCfg.frame_rate);
+
+		//==Set camera exposure
+		mCameras[k]->SetExposure(mCfg.exposure);
+	}
+
+    //== Start camera output ==--
+
+	if (mCameras.size() > 1) {
+		for (size_t k = 0; k < mCameras.size(); k++) mCameras[k]->Start();
+		if (mGroup.Start(mCameras, std::vector<CalibTransform>(mCfg.camera_calib.begin(),
+				mCfg.camera_calib.begin() + mCameras.size()), mCfg.filter, mCfg.merge_gate)) {
+			OUTPUT("The camera group is not started!");
+			Close();
+			return NULL;
+		}
+		printf("%d cameras in a group, merged within %.1f mm\n", mGroup.Cameras(), mCfg.merge_gate);
+	}
+	else {
+		mCamera->AttachListener(&mListener);
+		mCamera->Start();
+	}
+	if (mCfg.video_mode == OPTI_AUTO_MODE) mCfg.video_mode = ChooseMode();
+	Core::DistortionModel distortion;
+	distortion.Distort = true;
+	mCamera->GetDistortionModel(distortion);
+
+    //== Turn on some overlay text so it's clear things are     ===---
+    //== working even if there is nothing in the camera's view. ===---
+	if (window){
+		mCamera->SetTextOverlay(true);
+
+		mCamera->SetMarkerOverlay(true);
+	}
+
+	return mCamera;
+}
+
+// Connects to the qnx server and starts sending from the thread of Sender().
+int OptiClient::Connect()
+{
+	int init = mNet.Init(mCfg.udp, mCfg.server_ip.c_str(), mCfg.port, mCfg.NetProfile());
+	if (init) {
+		OUTPUT("No TCPIP connection available!");
+		return init;
+	}
+	if (!mCfg.udp && mNet.SendHello(mCfg.batch ? VISION_WIRE_BATCH : 0) == SOCKET_ERROR) {
+		OUTPUT("The qnx server does not take the hello!");
+		return -1;
+	}
+	if (mCfg.sync && mNet.StartEcho()) {
+		OUTPUT("The clock sync is not started!");
+	}
+	if (mSender.Start()) {
+		OUTPUT("The sender thread is not started!");
+		return -1;
+	}
+	if (mMonitor.Start(mCfg.report)) {
+		OUTPUT("The frame monitor is not started!");
+	}
+	if (!mCfg.analog_out.empty()) {
+		AnalogPublisher::Config analog = AnalogPublisher::defaults();
+		analog.channels = mCfg.analog_out.c_str();
+		analog.markers = mCfg.markers;
+		analog.mm_per_volt = mCfg.analog_mm_per_volt;
+		// the network still carries every marker, the outputs are on top
+		if (!mAnalog.open(analog)) {
+			OUTPUT("The analog outputs are not open!");
+		}
+	}
+	return 0;
+}
+
+// Stops the sender, closes the window and releases the camera.
+void OptiClient::Close()
+{
+	mSender.Stop();
+	mMonitor.Stop();
+	mAnalog.close();
+
+	if (mGroup.Cameras() > 0) {
+		printf("camera group: %ld frames short of a view, %ld views too late\n",
+			mGroup.Partial(), mGroup.Late());
+	}
+	mGroup.Stop();
+
+	if (mCfg.filter.Enabled() && mObjects.Seen() > 0) {
+		printf("object filter: %u of %u objects rejected\n", mObjects.Rejected(), mObjects.Seen());
+	}
+
+	if (mTexture != NULL) CloseWindow();
+	delete mFramebuffer;
+	delete mTexture;
+	mFramebuffer = NULL;
+	mTexture = NULL;
+	mSource = &mObjects;
+	delete mSegments;
+	mSegments = NULL;
+
+	if (mCamera != NULL) {
+		mCamera->RemoveListener(&mListener);
+		for (size_t k = 0; k < mCameras.size(); k++) mCameras[k]->Release();
+		mCameras.clear();
+
+    //== Shutdown Camera Library ==--
+
+		CameraManager::X().Shutdown();
+		mCamera = NULL;
+	}
+
+	rt_profile_revert(&mRt);
+}
+
+// The event is auto reset and set for every frame, so a frame that came while
+// the last one was handled wakes the wait at once; a wake without a frame, or
+// for a window message, returns NULL and the loop comes back after pumping.
+Frame *OptiClient::WaitFrame()
+{
+	Frame *frame = mCamera->GetFrame();
+	if (frame != NULL || mCfg.frame_wait <= 0) return frame;
+
+	MsgWaitForMultipleObjects(1, &mListener.mFrameReady, FALSE, mCfg.frame_wait, QS_ALLINPUT);
+	return mCamera->GetFrame();
+}
+
+void OptiClient::VideoMode(int mode)
+{
+	if (mode == OPTI_SEGMENT_MODE) {
+		mCamera->SetVideoType(SegmentMode);
+		mSource = mSegments;
+	}
+	else {
+		mCamera->SetVideoType(ObjectMode);
+		mSource = &mObjects;
+	}
+}
+
+// Runs the camera in object and then in segment mode for SOURCE_BENCH_FRAMES
+// frames each and keeps the mode that delivers more frames per second, or,
+// within 5 percent, the one that costs the host less per frame. The camera can
+// only centroid so many markers a frame, so what is faster depends on the
+// markers in view; they should be in view as they will be when tracking.
+// return: the mode chosen, the camera is left in it
+int OptiClient::ChooseMode()
+{
+	static const int modes[2] = {OPTI_OBJECT_MODE, OPTI_SEGMENT_MODE};
+	static const char *names[2] = {"object", "segment"};
+	SourceBench bench[2];
+	std::vector<double> x, y;
+	char buff[128];
+	int m, best;
+
+	for (m = 0; m < 2; m++) {
+		VideoMode(modes[m]);
+
+		// long enough for the frames, but not forever without any
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		LONGLONG deadline = FrameMonitor::Now() + 5*f.QuadPart;
+		while (FrameMonitor::Now() < deadline) {
+			Frame *frame = WaitFrame();
+			if (frame == NULL) { PumpMessages(); continue; }
+
+			LONGLONG start = FrameMonitor::Now();
+			int n = mSource->Markers(frame, x, y);
+			LONGLONG now = FrameMonitor::Now();
+			frame->Release();
+			if (!bench[m].Frame(n, start, now - start)) break;
+		}
+
+		sprintf_s(buff, "%s mode: %.1f frames/s, %.1f us/frame for %.1f markers",
+			names[m], bench[m].Rate(), bench[m].CostUs(), bench[m].MeanMarkers());
+		OUTPUT(buff);
+	}
+
+	if (bench[1].Rate() > 1.05*bench[0].Rate()) best = 1;
+	else if (bench[1].Rate() < 0.95*bench[0].Rate()) best = 0;
+	else best = bench[1].CostUs() < bench[0].CostUs() ? 1 : 0;
+
+	VideoMode(modes[best]);
+	sprintf_s(buff, "video mode %s chosen", names[best]);
+	OUTPUT(buff);
+	return modes[best];
+}
+
+bool OptiClient::Preview(Frame *frame)
+{
+	if (mFramebuffer == NULL || frame->FrameID() % mCfg.preview_every != 0) return true;
+
+    //== Lets have the Camera Library raster the camera's
+    //== image into our texture.
+
+	frame->Rasterize(mFramebuffer);
+	return DrawGLScene(mTexture) != 0;
+}
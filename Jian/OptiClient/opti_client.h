@@ -0,0 +1,109 @@
+#ifndef OPTI_CLIENT_H_
+#define OPTI_CLIENT_H_
+
+#include "supportcode.h"
+#include "cameralibrary.h"
+#include "opti_config.h"
+#include "vision_tcp.h"
+#include "vision_sender.h"
+#include "frame_monitor.h"
+#include "marker_source.h"
+#include "camera_group.h"
+#include "../../TDah/include/RtProfile.h"
+#include "../../TDah/include/AnalogPublisher.h"
+
+// The capture-and-publish core of the camera clients.
+//
+// Open() reads the OptiConfig, opens the first camera and starts it in the
+// configured video mode, frame rate and exposure; with a window it also opens
+// the preview window, see Preview(). Connect() opens the transport of the
+// config and starts its VisionSender, and the FrameMonitor reports every
+// report seconds of the config; with analog_out in the config it also opens
+// the AnalogPublisher the frame loop writes the positions to, next to the
+// network, see Analog(). Close() undoes both. With realtime in the
+// config, Open() also puts the process and the calling thread, which runs the
+// frame loop, on the RtProfile and prints which of its settings took.
+//
+// WaitFrame() is GetFrame() that sleeps until the camera library has a frame,
+// so the frame loop does not keep a core busy between frames. Markers() takes
+// the blobs of a frame from the MarkerSource of the video mode: the camera's
+// objects, without those the object_* shape of the config rejects, or the
+// segments merged on the host.
+//
+// With cameras in the config, and no window, Open() starts that many cameras
+// as a CameraGroup, each with the calibration of its camera_calibration, and
+// the frame loop takes their fused markers, in world mm, from WaitGroup()
+// instead of the frames of WaitFrame(); Open() returns the first of them.
+class OptiClient
+{
+    public:
+		OptiClient();
+		~OptiClient();
+
+		// return: the camera, or NULL if there is none
+		CameraLibrary::Camera *Open(const char *config, bool window);
+		int Connect();
+		void Close();
+
+		const OptiConfig &Config() const { return mCfg; }
+		VisionTCP &Net() { return mNet; }
+		VisionSender &Sender() { return mSender; }
+		FrameMonitor &Monitor() { return mMonitor; }
+		// isOpen() false without analog_out in the config or the DAQ
+		AnalogPublisher &Analog() { return mAnalog; }
+
+		// the next frame, waiting at most frame_wait ms of the config for it, but
+		// returning early for a window message, so PumpMessages() still runs
+		// return: the frame, or NULL if none came
+		CameraLibrary::Frame *WaitFrame();
+
+		// true with more than one camera, the frames then come from WaitGroup()
+		bool Grouped() const { return mGroup.Cameras() > 1; }
+		// the next fused frame of the group, waiting at most frame_wait ms for it
+		// return: false if none came
+		bool WaitGroup(GroupFrame *f) { return mGroup.Next(mCfg.frame_wait, f); }
+
+		// x, y: the blob centers of the frame in camera pixels
+		// return: their number
+		int Markers(CameraLibrary::Frame *frame, std::vector<double> &x, std::vector<double> &y)
+		{
+			return mSource->Markers(frame, x, y);
+		}
+
+		// rasterizes and draws every preview_every-th frame into the window
+		// return: false if the window should close
+		bool Preview(CameraLibrary::Frame *frame);
+
+    private:
+		// sets mFrameReady from the thread of the camera library for every frame
+		class FrameListener : public CameraLibrary::cCameraListener
+		{
+			public:
+				HANDLE mFrameReady;
+				void FrameAvailable() { SetEvent(mFrameReady); }
+		};
+
+		OptiConfig mCfg;
+		CameraLibrary::Camera *mCamera;
+		std::vector<CameraLibrary::Camera *> mCameras; // mCamera first
+		CameraGroup mGroup;
+		FrameListener mListener;
+		RtProfile mRt;
+
+		ObjectSource mObjects;
+		SegmentSource *mSegments;
+		MarkerSource *mSource;
+
+		void VideoMode(int mode);
+		int ChooseMode();
+		VisionTCP mNet;
+		VisionSender mSender;
+		FrameMonitor mMonitor;
+		AnalogPublisher mAnalog;
+
+		// the preview, NULL when headless
+		Surface *mTexture;
+		Bitmap *mFramebuffer;
+};
+
+#endif /* OPTI_CLIENT_H_ */
@@ -0,0 +1,197 @@
+#include "opti_config.h"
+#include "vision_tcp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_SIZE	512
+
+OptiConfig::OptiConfig()
+{
+	frame_rate = 250;
+	exposure = 25;
+	video_mode = OPTI_OBJECT_MODE;
+	cameras = 1;
+	camera = 0;
+	merge_gate = 10;
+	preview_every = 2;
+	frame_wait = 20;
+	realtime = true;
+	cpu = -1;
+
+	udp = false;
+	send_buffer = 0;
+	dscp = -1;
+	check_adapter = false;
+	batch = false;
+	sync = false;
+	analog_mm_per_volt = 300/9.0;
+	echo_x = echo_y = -1;
+	echo_gate = 10;
+	server_ip = SERVER_IP;
+	port = DEFAULT_PORT;
+	report = 5;
+
+	markers = 4;
+	gate = 20;
+	alpha = 0.5;
+	beta = 0.1;
+}
+
+// Splits the lines of a file into its "key value" pairs, several per line
+// allowed; a key for a list takes the rest of its line.
+static int ReadPairs(const char *filename, OptiConfig *cfg,
+					 void (*pair)(OptiConfig *cfg, const char *key, char *value, char **rest))
+{
+	char line[LINE_SIZE];
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL) return -1;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *hash = strchr(line, '#');
+		if (hash != NULL) *hash = '\0';
+
+		char *rest = NULL;
+		char *key = strtok_s(line, " \t\r\n", &rest);
+		while (key != NULL) {
+			char *value = strtok_s(NULL, " \t\r\n", &rest);
+			if (value == NULL) break;
+			pair(cfg, key, value, &rest);
+			key = strtok_s(NULL, " \t\r\n", &rest);
+		}
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+static void ConfigPair(OptiConfig *cfg, const char *key, char *value, char **rest)
+{
+	if (!strcmp(key, "frame_rate")) cfg->frame_rate = atoi(value);
+	else if (!strcmp(key, "exposure")) cfg->exposure = atoi(value);
+	else if (!strcmp(key, "video_mode")) cfg->video_mode = !strcmp(value, "segment") ? OPTI_SEGMENT_MODE :
+		(!strcmp(value, "auto") ? OPTI_AUTO_MODE : OPTI_OBJECT_MODE);
+	else if (!strcmp(key, "cameras")) cfg->cameras = atoi(value) > 0 ? atoi(value) : 0;
+	else if (!strcmp(key, "camera")) cfg->camera = atoi(value) > 0 ? atoi(value) : 0;
+	else if (!strcmp(key, "camera_calibration")) {
+		cfg->camera_calibration.clear();
+		for (char *v = value; v != NULL; v = strtok_s(NULL, " \t\r\n", rest)) {
+			cfg->camera_calibration.push_back(v);
+		}
+	}
+	else if (!strcmp(key, "merge_gate")) cfg->merge_gate = atof(value);
+	else if (!strcmp(key, "preview_every")) cfg->preview_every = atoi(value) > 0 ? atoi(value) : 1;
+	else if (!strcmp(key, "frame_wait")) cfg->frame_wait = atoi(value) > 0 ? atoi(value) : 0;
+	else if (!strcmp(key, "realtime")) cfg->realtime = atoi(value) != 0;
+	else if (!strcmp(key, "cpu")) cfg->cpu = atoi(value);
+	else if (!strcmp(key, "transport")) cfg->udp = !strcmp(value, "udp");
+	else if (!strcmp(key, "bind_ip")) cfg->bind_ip = strcmp(value, "off") ? value : "";
+	else if (!strcmp(key, "send_buffer")) cfg->send_buffer = atoi(value) > 0 ? atoi(value) : 0;
+	else if (!strcmp(key, "dscp")) cfg->dscp = (atoi(value) >= 0 && atoi(value) < 64) ? atoi(value) : -1;
+	else if (!strcmp(key, "check_adapter")) cfg->check_adapter = atoi(value) != 0;
+	else if (!strcmp(key, "batch")) cfg->batch = atoi(value) != 0;
+	else if (!strcmp(key, "sync")) cfg->sync = atoi(value) != 0;
+	else if (!strcmp(key, "analog_out")) cfg->analog_out = strcmp(value, "off") ? value : "";
+	else if (!strcmp(key, "analog_mm_per_volt")) cfg->analog_mm_per_volt = atof(value);
+	else if (!strcmp(key, "echo_x")) cfg->echo_x = atof(value);
+	else if (!strcmp(key, "echo_y")) cfg->echo_y = atof(value);
+	else if (!strcmp(key, "echo_gate")) cfg->echo_gate = atof(value);
+	else if (!strcmp(key, "server_ip")) cfg->server_ip = value;
+	else if (!strcmp(key, "port")) cfg->port = atoi(value);
+	else if (!strcmp(key, "report")) cfg->report = atof(value);
+	else if (!strcmp(key, "markers")) cfg->markers = atoi(value);
+	else if (!strcmp(key, "object_min_area")) cfg->filter.min_area = atof(value);
+	else if (!strcmp(key, "object_max_area")) cfg->filter.max_area = atof(value);
+	else if (!strcmp(key, "object_min_radius")) cfg->filter.min_radius = atof(value);
+	else if (!strcmp(key, "object_max_radius")) cfg->filter.max_radius = atof(value);
+	else if (!strcmp(key, "object_min_roundness")) cfg->filter.min_roundness = atof(value);
+	else if (!strcmp(key, "object_max_aspect")) cfg->filter.max_aspect = atof(value);
+	else if (!strcmp(key, "gate")) cfg->gate = atof(value);
+	else if (!strcmp(key, "alpha")) cfg->alpha = atof(value);
+	else if (!strcmp(key, "beta")) cfg->beta = atof(value);
+	else if (!strcmp(key, "calibration")) cfg->calibration = value;
+	else printf("opti.cfg: unknown key %s\n", key);
+}
+
+static void CalibrationPair(OptiConfig *cfg, const char *key, char *value, char **rest)
+{
+	if (!strcmp(key, "model")) {
+		if (cfg->calib.SetModel(value)) printf("calibration: unknown model %s\n", value);
+	}
+	else if (!strcmp(key, "radius")) {
+		cfg->radius.clear();
+		for (char *v = value; v != NULL; v = strtok_s(NULL, " \t\r\n", rest)) {
+			cfg->radius.push_back(atof(v));
+		}
+	}
+	else if (cfg->calib.Set(key, atof(value))) printf("calibration: unknown key %s\n", key);
+}
+
+// The socket settings of bind_ip, send_buffer, dscp and check_adapter; the
+// address points into bind_ip.
+VisionTCP::Profile OptiConfig::NetProfile() const
+{
+	VisionTCP::Profile p = VisionTCP::defaults();
+	p.bind_ip = bind_ip.empty() ? NULL : bind_ip.c_str();
+	p.send_buffer = send_buffer;
+	p.dscp = dscp;
+	p.check_adapter = check_adapter;
+	return p;
+}
+
+// Reads the settings and then their calibration files.
+// return: 0, or -1 if a file is missing; the settings not read keep their defaults
+int OptiConfig::Load(const char *filename)
+{
+	if (ReadPairs(filename, this, ConfigPair)) {
+		printf("The settings %s are missing, using the defaults.\n", filename);
+		PadRadius();
+		return -1;
+	}
+	int rc = 0;
+	if (!calibration.empty()) rc = LoadCalibration(calibration.c_str());
+	else PadRadius();
+	if (LoadCameraCalibrations()) rc = -1;
+	return rc;
+}
+
+// The calibrations of the cameras of a group after the first, each a file of
+// the calibration keys; their radius keys are left to the first.
+// return: 0, or -1 if a file is missing, its camera keeps the first calibration
+int OptiConfig::LoadCameraCalibrations()
+{
+	int rc = 0;
+
+	camera_calib.assign(1, calib);
+	for (size_t k = 0; k < camera_calibration.size(); k++) {
+		OptiConfig other;
+		if (ReadPairs(camera_calibration[k].c_str(), &other, CalibrationPair)) {
+			printf("The calibration %s is missing!\n", camera_calibration[k].c_str());
+			other.calib = calib;
+			rc = -1;
+		}
+		camera_calib.push_back(other.calib);
+	}
+	return rc;
+}
+
+int OptiConfig::LoadCalibration(const char *filename)
+{
+	if (ReadPairs(filename, this, CalibrationPair)) {
+		printf("The calibration %s is missing!\n", filename);
+		PadRadius();
+		return -1;
+	}
+
+	PadRadius();
+	return 0;
+}
+
+// a marker without a radius has the radius of the last one
+void OptiConfig::PadRadius()
+{
+	if (radius.empty()) radius.push_back(1.);
+	while ((int)radius.size() < markers) radius.push_back(radius.back());
+}
@@ -0,0 +1,121 @@
+#ifndef OPTI_CONFIG_H_
+#define OPTI_CONFIG_H_
+
+#include <string>
+#include <vector>
+
+#include "calib_transform.h"
+#include "marker_source.h"
+#include "vision_tcp.h"
+
+#define OPTI_CONFIG_FILE "opti.cfg" // read from the working directory
+
+#define OPTI_OBJECT_MODE	0
+#define OPTI_SEGMENT_MODE	1
+#define OPTI_AUTO_MODE		2 // the faster of the two for the markers in view, see OptiClient::Open()
+
+// The settings of a camera client, read at start up instead of compiled in.
+//
+// Both files are lines of "key value", # starts a comment, and a key that is
+// not given keeps its default:
+//
+//   frame_rate 250          camera frames per second
+//   exposure 25
+//   video_mode object       object, segment or auto
+//   cameras 1               of a CameraGroup, 0 for all connected; object mode, see camera_group.h
+//   camera 0                the first camera used, in the order of the camera library
+//   camera_calibration calib_b.txt calib_c.txt   of the second and further cameras of a group
+//   merge_gate 10           mm, the views of one marker by two cameras of a group
+//   preview_every 2         with a window, rasterize and show every Nth frame
+//   frame_wait 20           ms the loop sleeps for a frame at most, 0 to poll, see WaitFrame()
+//   realtime 1              1 for the real-time profile of TDah's RtProfile.h on the frame loop
+//   cpu -1                  the core of the frame loop, -1 for none, -2 for the last
+//   transport tcp           tcp or udp, see vision_tcp.h
+//   bind_ip off             the address of the adapter of the link, off for any, see VisionTCP::Profile
+//   send_buffer 0           bytes of the socket, 0 for the default of Windows
+//   dscp -1                 the DSCP of the packets, -1 for none, 46 for expedited forwarding
+//   check_adapter 0         1 to print the adapter of the link and its driver settings at start up
+//   batch 0                 1 to send all markers of a frame, see SendMarkers()
+//   sync 0                  1 to stamp the frames and answer the clock pings, tcp only
+//   analog_out off          NI-DAQ channels of the positions too, like Dev4/ao0:3, see AnalogPublisher.h
+//   analog_mm_per_volt 33.333
+//   echo_x -1               camera pixel of the LED of the qnx latency probe, -1 for none, see latency_echo.h
+//   echo_y -1
+//   echo_gate 10            pixels
+//   server_ip 192.168.1.65
+//   port 3490
+//   report 5                seconds between the frame reports, 0 for none
+//   markers 4               with a group, gate and the echo_* are in world mm too
+//   object_min_area 0       pixels, the shape of an object of the camera to be a
+//   object_max_area 0         marker, 0 for no limit, see ObjectFilter in
+//   object_min_radius 0       marker_source.h; object mode only
+//   object_max_radius 0
+//   object_min_roundness 0  0 to 1
+//   object_max_aspect 0     of the bounding box
+//   gate 20                 pixels, see marker_match.h
+//   alpha 0.5               position and velocity gains, see velocity_estimator.h
+//   beta 0.1
+//   calibration calibration.txt
+//
+// The calibration file maps the camera pixel (x, y) to the world, in mm, see
+// calib_transform.h for the models and their keys:
+//
+//   model affine            affine, homography or poly
+//   a11 0.69007  a12 0.05544  a13 -308.2908
+//   a21 0.043271 a22 -0.69786 a23 384.3358
+//   grid 4                  pixels, interpolate a homography or poly model
+//   radius 78.3244 66.4521 65.0153 70.3668  one per marker
+struct OptiConfig
+{
+	int frame_rate;
+	int exposure;
+	int video_mode;
+	int cameras;
+	int camera;
+	std::vector<std::string> camera_calibration;
+	std::vector<CalibTransform> camera_calib; // of every camera of a group, calib first
+	double merge_gate;
+	int preview_every;
+	int frame_wait;
+	bool realtime;
+	int cpu;
+
+	bool udp;
+	std::string bind_ip; // empty for any
+	int send_buffer;
+	int dscp;
+	bool check_adapter;
+	bool batch;
+	bool sync;
+	std::string analog_out; // empty for none
+	double analog_mm_per_volt;
+	double echo_x, echo_y, echo_gate;
+	std::string server_ip;
+	int port;
+	double report;
+
+	int markers;
+	ObjectFilter filter;
+	double gate;
+	double alpha, beta;
+
+	std::string calibration;
+	CalibTransform calib;
+	std::vector<double> radius;
+
+	OptiConfig();
+
+	int Load(const char *filename);
+	int LoadCalibration(const char *filename);
+	int LoadCameraCalibrations();
+	void PadRadius();
+	VisionTCP::Profile NetProfile() const;
+
+	// the calibrated world position of the camera pixel x, y; for many, use calib.Map()
+	void World(double x, double y, double *wx, double *wy) const
+	{
+		calib.Map(&x, &y, 1, wx, wy);
+	}
+};
+
+#endif /* OPTI_CONFIG_H_ */
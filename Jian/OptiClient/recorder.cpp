@@ -0,0 +1,170 @@
+#include "recorder.h"
+
+#include <string.h>
+
+#define WAIT_MS	100 // how often the thread looks at mQuit
+
+Recorder::Recorder()
+{
+	mFile = NULL;
+	mValues = 0;
+	mRing = NULL;
+	mRows = 0;
+	mHead = mTail = mLost = 0;
+	mThread = NULL;
+	mReady = NULL;
+	mQuit = false;
+}
+
+Recorder::~Recorder()
+{
+	Close();
+}
+
+// filename: the binary file, overwritten
+// values: the doubles of every row
+int Recorder::Open(const char *filename, int values)
+{
+	RecorderHeader h;
+
+	Close();
+
+	mFile = fopen(filename, "wb");
+	if (mFile == NULL) {
+		fprintf(stderr, "The recording %s is not created!\n", filename);
+		return -1;
+	}
+
+	h.magic = RECORDER_MAGIC;
+	h.version = RECORDER_VERSION;
+	h.values = values;
+	h.reserved = 0;
+	fwrite(&h, sizeof(h), 1, mFile);
+	fflush(mFile);
+
+	mValues = values;
+	mRing = new double[RECORDER_CHUNKS * RECORDER_CHUNK_ROWS * values];
+	mRows = 0;
+	mHead = mTail = mLost = 0;
+
+	mQuit = false;
+	mReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+	mThread = CreateThread(NULL, 0, Main, this, 0, NULL);
+	if (mThread == NULL) {
+		Close();
+		return -1;
+	}
+	return 0;
+}
+
+// Writes every row recorded, the last chunk too, and closes the file.
+void Recorder::Close()
+{
+	if (mThread != NULL) {
+		mQuit = true;
+		SetEvent(mReady);
+		WaitForSingleObject(mThread, INFINITE);
+		CloseHandle(mThread);
+		mThread = NULL;
+	}
+	if (mReady != NULL) {
+		CloseHandle(mReady);
+		mReady = NULL;
+	}
+
+	if (mFile != NULL) {
+		Write();
+		if (mRows > 0) fwrite(Chunk(mTail), sizeof(double) * mValues, mRows, mFile);
+		fclose(mFile);
+		mFile = NULL;
+	}
+
+	delete [] mRing;
+	mRing = NULL;
+	mRows = 0;
+}
+
+void Recorder::Record(const double *row)
+{
+	if (mRing == NULL) return;
+
+	// the chunk at mTail is the frame loop's until it is full
+	if (mTail - mHead >= RECORDER_CHUNKS) {
+		InterlockedIncrement(&mLost);
+		return;
+	}
+
+	memcpy(Chunk(mTail) + mRows * mValues, row, sizeof(double) * mValues);
+	if (++mRows < RECORDER_CHUNK_ROWS) return;
+
+	// the chunk must be complete before the thread can see it
+	MemoryBarrier();
+	mTail = mTail + 1;
+	mRows = 0;
+	SetEvent(mReady);
+}
+
+// Appends the full chunks to the file; a flushed chunk survives a crash.
+void Recorder::Write()
+{
+	while (mHead != mTail) {
+		// read the chunk only after seeing it full
+		MemoryBarrier();
+		fwrite(Chunk(mHead), sizeof(double) * mValues, RECORDER_CHUNK_ROWS, mFile);
+		fflush(mFile);
+
+		// hand the chunk back to the frame loop
+		MemoryBarrier();
+		mHead = mHead + 1;
+	}
+}
+
+DWORD WINAPI Recorder::Main(LPVOID param)
+{
+	Recorder *me = (Recorder *)param;
+
+	while (!me->mQuit) {
+		WaitForSingleObject(me->mReady, WAIT_MS);
+		me->Write();
+	}
+	return 0;
+}
+
+// binary: a file of Record()
+// text: the text file, overwritten
+// skip: the rows not exported, from the start
+// return: the rows exported, or -1
+int Recorder::Export(const char *binary, const char *text, int skip)
+{
+	RecorderHeader h;
+	FILE *in, *out;
+	int rows = 0;
+
+	in = fopen(binary, "rb");
+	if (in == NULL) return -1;
+	if (fread(&h, sizeof(h), 1, in) != 1 || h.magic != RECORDER_MAGIC
+		|| h.version != RECORDER_VERSION || h.values == 0) {
+		fclose(in);
+		return -1;
+	}
+
+	out = fopen(text, "w");
+	if (out == NULL) {
+		fclose(in);
+		return -1;
+	}
+
+	double *row = new double[h.values];
+	for (int i = 0; fread(row, sizeof(double), h.values, in) == h.values; i++) {
+		if (i < skip) continue;
+
+		for (unsigned int j = 0; j + 1 < h.values; j++) fprintf(out, "%f ", row[j]);
+		fprintf(out, "%d\n", int(row[h.values - 1]));
+		rows++;
+	}
+	delete [] row;
+
+	fclose(out);
+	fclose(in);
+	return rows;
+}
@@ -0,0 +1,67 @@
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <stdio.h>
+
+#define RECORDER_CHUNK_ROWS	256 // rows written to the file at once
+#define RECORDER_CHUNKS		64 // chunks the frame loop can fill before the file catches up
+#define RECORDER_MAGIC		0x43524A53 // "SJRC"
+#define RECORDER_VERSION	1
+
+// Streams rows of doubles to a binary file while the frame loop runs.
+//
+// Record() copies a row into a chunk of a ring allocated once by Open(); a full
+// chunk is handed to a thread that appends it to the file, so memory stays
+// bounded however long the recording is, and a crash loses at most the chunks
+// not yet written. Rows are dropped, and counted, while every chunk waits for
+// the file.
+//
+// The file is a RecorderHeader followed by the rows, values doubles each.
+// Export() writes it as the text of the old data files.
+class Recorder
+{
+    public:
+		Recorder();
+		~Recorder();
+
+		int Open(const char *filename, int values);
+		void Close();
+
+		// called by the frame loop, never blocks
+		void Record(const double *row);
+
+		long Lost() const { return mLost; }
+
+		// rows after the first skip: every value but the last as %f, the last as %d
+		static int Export(const char *binary, const char *text, int skip);
+
+    private:
+		struct RecorderHeader {
+			unsigned int magic;
+			unsigned int version;
+			unsigned int values;
+			unsigned int reserved;
+		};
+
+		FILE *mFile;
+		int mValues;
+		double *mRing; // RECORDER_CHUNKS chunks of RECORDER_CHUNK_ROWS rows
+		int mRows; // rows in the chunk at mTail
+
+		// full chunks are mHead .. mTail - 1, written by the thread
+		volatile LONG mHead;
+		volatile LONG mTail;
+		volatile LONG mLost;
+
+		HANDLE mThread;
+		HANDLE mReady;
+		volatile bool mQuit;
+
+		double *Chunk(LONG i) { return mRing + (i % RECORDER_CHUNKS) * RECORDER_CHUNK_ROWS * mValues; }
+		void Write();
+		static DWORD WINAPI Main(LPVOID param);
+};
+
+#endif /* RECORDER_H_ */
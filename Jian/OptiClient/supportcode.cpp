@@ -7,6 +7,8 @@
 
 #include <windows.h>		// Header File For Windows
 #include <stdio.h>			// Header File For Standard Input/Output
+#include <stddef.h>			// ptrdiff_t
+#include <string.h>			// memcpy
 #include <gl\gl.h>			// Header File For The OpenGL32 Library
 #include <gl\glu.h>			// Header File For The GLu32 Library
 #include "cameralibrary.h"
@@ -34,6 +36,48 @@ HWND		hWnd=NULL;		// Holds Our Window Handle
 HINSTANCE	hInstance;		// Holds The Instance Of The Application
 HGLRC		hRC=NULL;		// Permanent Rendering Context
 
+//== Pixel buffer objects and the swap interval are not in the OpenGL 1.1 headers
+//== of Windows, their functions are looked up once a context exists, see InitGL()
+
+#define GL_PIXEL_UNPACK_BUFFER_ARB  0x88EC
+#define GL_STREAM_DRAW_ARB          0x88E0
+#define GL_WRITE_ONLY_ARB           0x88B9
+
+typedef ptrdiff_t GLsizeiptrARB;
+typedef void   (APIENTRY *GenBuffersProc)   (GLsizei n, GLuint *buffers);
+typedef void   (APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void   (APIENTRY *BindBufferProc)   (GLenum target, GLuint buffer);
+typedef void   (APIENTRY *BufferDataProc)   (GLenum target, GLsizeiptrARB size, const GLvoid *data, GLenum usage);
+typedef GLvoid*(APIENTRY *MapBufferProc)    (GLenum target, GLenum access);
+typedef GLboolean (APIENTRY *UnmapBufferProc)(GLenum target);
+typedef BOOL   (APIENTRY *SwapIntervalProc) (int interval);
+
+static GenBuffersProc    pglGenBuffers    = NULL;
+static DeleteBuffersProc pglDeleteBuffers = NULL;
+static BindBufferProc    pglBindBuffer    = NULL;
+static BufferDataProc    pglBufferData    = NULL;
+static MapBufferProc     pglMapBuffer     = NULL;
+static UnmapBufferProc   pglUnmapBuffer   = NULL;
+
+static void LoadGLExtensions()
+{
+    pglGenBuffers    = (GenBuffersProc)   wglGetProcAddress("glGenBuffersARB");
+    pglDeleteBuffers = (DeleteBuffersProc)wglGetProcAddress("glDeleteBuffersARB");
+    pglBindBuffer    = (BindBufferProc)   wglGetProcAddress("glBindBufferARB");
+    pglBufferData    = (BufferDataProc)   wglGetProcAddress("glBufferDataARB");
+    pglMapBuffer     = (MapBufferProc)    wglGetProcAddress("glMapBufferARB");
+    pglUnmapBuffer   = (UnmapBufferProc)  wglGetProcAddress("glUnmapBufferARB");
+
+    //== All of them or none, Surface checks pglGenBuffers only
+    if (!pglDeleteBuffers || !pglBindBuffer || !pglBufferData || !pglMapBuffer || !pglUnmapBuffer)
+        pglGenBuffers = NULL;
+
+    //== SwapBuffers() must not wait for the monitor while the camera runs
+    SwapIntervalProc swapInterval = (SwapIntervalProc)wglGetProcAddress("wglSwapIntervalEXT");
+    if (swapInterval)
+        swapInterval(0);
+}
+
 int LoadGLTextures()									// Load Bitmaps And Convert To Textures
 {
 	return 0;										// Return The Status
@@ -70,6 +114,7 @@ int InitGL(GLvoid)										// All Setup For OpenGL Goes Here
     glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_BLEND);
 	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);	// Really Nice Perspective Calculations
+	LoadGLExtensions();
 	return TRUE;										// Initialization Went OK
 }
 
@@ -78,11 +123,14 @@ int DrawGLScene(Surface *surf)
     if(surf==NULL)
         return true;
 
-    static bool frameThrottler = true;
-    frameThrottler=!frameThrottler;
+    //== Drawing gets at most half of the time of the frame loop, otherwise the
+    //== application would get behind; a blocking SwapBuffers() counts as cost
+    static LONGLONG lastEnd = 0, lastCost = 0;
+    LARGE_INTEGER start, end;
 
-    if(frameThrottler)  //== Only display every other frame in case VSYNC is enabled.  Otherwise
-        return true;    //== application would get behind
+    QueryPerformanceCounter(&start);
+    if(start.QuadPart - lastEnd < lastCost)
+        return true;
 
     int pixelWidth = surf->Width();
     int pixelHeight= surf->Height();
@@ -111,6 +159,10 @@ int DrawGLScene(Surface *surf)
 
     SwapBuffers(hDC);					// Swap Buffers (Double Buffering)
 
+    QueryPerformanceCounter(&end);
+    lastCost = end.QuadPart - start.QuadPart;
+    lastEnd  = end.QuadPart;
+
 	return true;										// Keep Going
 }
 
@@ -449,11 +501,13 @@ Surface::Surface(int Width, int Height) : buffer(0), mDirty(true)
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mSurfaceWidth, mSurfaceHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+
+    CreatePbos();
 }
 
 Surface::~Surface()
 {
-
+    DeletePbos();
 }
 
 void Surface::RebindTexture()
@@ -467,8 +521,70 @@ void Surface::RebindTexture()
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mSurfaceWidth, mSurfaceHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+
+    //== The buffers of the old context are gone with it
+    CreatePbos();
+}
+
+void Surface::CreatePbos()
+{
+    mPbo[0] = mPbo[1] = 0;
+    mPboNext = 0;
+    mPboFilled = false;
+
+    if (pglGenBuffers)
+        pglGenBuffers(2, mPbo);
 }
 
+void Surface::DeletePbos()
+{
+    if (mPbo[0] != 0)
+        pglDeleteBuffers(2, mPbo);
+
+    mPbo[0] = mPbo[1] = 0;
+    mPboFilled = false;
+}
+
+void Surface::Upload()
+{
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+
+    if (mPbo[0] == 0)
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, mSpan);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        return;
+    }
+
+    int rowBytes = mWidth * BYTESPERPIXEL;
+
+    //== The frame of the last call goes to the texture from its PBO; the call
+    //== returns at once and the DMA runs while this frame is copied
+    if (mPboFilled)
+    {
+        pglBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, mPbo[1 - mPboNext]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    }
+
+    //== Giving the PBO new storage first lets the map not wait for a DMA that
+    //== still reads the old one
+    pglBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, mPbo[mPboNext]);
+    pglBufferData(GL_PIXEL_UNPACK_BUFFER_ARB, rowBytes * mHeight, NULL, GL_STREAM_DRAW_ARB);
+
+    unsigned char *dst = (unsigned char*) pglMapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+    if (dst != NULL)
+    {
+        for (int y = 0; y < mHeight; y++)
+            memcpy(dst + y * rowBytes, buffer + y * mSpan * BYTESPERPIXEL, rowBytes);
+
+        pglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+        mPboFilled = true;
+        mPboNext = 1 - mPboNext;
+    }
+
+    pglBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+}
 
 void Surface::Resize(int Width, int Height)
 {
@@ -494,6 +610,11 @@ void Surface::Resize(int Width, int Height)
         if(buffer==0)
             throw("Unable to allocate surface buffer");
 
+        //== Only the corner is uploaded from now on, the texture takes the new size once
+        glBindTexture(GL_TEXTURE_2D, mTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mSurfaceWidth, mSurfaceHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        mPboFilled = false;
+
         mDirty = true;
     }
 }
@@ -510,11 +631,10 @@ int  Surface::CalculateSize(int Width)
 
 GLuint Surface::GetTexture()
 {
-    //if(mDirty==true)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mSurfaceWidth, mSurfaceHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
-        mDirty = false;
-    }
+    //== The camera library rasterizes into the buffer without marking it, so
+    //== every drawn frame is uploaded
+    Upload();
+    mDirty = false;
     return mTexture; 
 }
 
@@ -21,6 +21,12 @@ extern bool	    keys[256];    // Array Used For Scanning Keyboard
 extern bool	    gActive;      // Window Active Flag Set To TRUE By Default
 extern bool	    gFullscreen;  // Fullscreen Flag Set To Fullscreen Mode By Default
 
+//== The camera image as a texture. GetTexture() uploads only the Width x Height
+//== corner of the power of two texture, through two pixel buffer objects when
+//== the driver has them: the frame rasterized now is copied into one while the
+//== other, filled one frame before, is DMAed into the texture, so the quad
+//== drawn is one preview frame behind but the upload never waits for the GPU.
+//== Without PBOs the corner is uploaded straight from the buffer.
 class Surface
 {
 public:
@@ -46,6 +52,17 @@ private:
     bool            mDirty;
     GLuint          mTexture;
     int             mSpan;
+
+    GLuint          mPbo[2];      // 0 without pixel buffer objects
+    int             mPboNext;     // the PBO GetTexture() fills
+    bool            mPboFilled;   // the other one holds a frame for the texture
+
+    void            CreatePbos();
+    void            DeletePbos();
+    void            Upload();
 };
 
+//== Draws surf, unless the last draw has not had its own duration of idle time
+//== since it ended: under load preview frames are dropped instead of the
+//== frame loop waiting on the display.
 int     DrawGLScene     (Surface *surf);
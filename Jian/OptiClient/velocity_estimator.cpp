@@ -0,0 +1,96 @@
+#include "velocity_estimator.h"
+
+#include <math.h>
+
+VelocityEstimator::VelocityEstimator(int markers, double alpha, double beta)
+	: mN(markers), mAlpha(alpha), mBeta(beta), mStarted(false), mT(0.),
+	mX(markers, 0.), mY(markers, 0.), mVX(markers, 0.), mVY(markers, 0.),
+	mLastX(markers, 0.), mLastY(markers, 0.), mLastFound(markers, false),
+	mAngle(0.), mPhase(0.), mOmega(0.)
+{
+}
+
+void VelocityEstimator::Reset(const double *x, const double *y, double t)
+{
+	for (int j = 0; j < mN; j++) {
+		mX[j] = mLastX[j] = x[j];
+		mY[j] = mLastY[j] = y[j];
+		mVX[j] = mVY[j] = 0.;
+		mLastFound[j] = true;
+	}
+	mAngle = mPhase = mOmega = 0.;
+	mT = t;
+	mStarted = true;
+}
+
+// the angle from the last measured positions to these, of the markers found in both
+// return: false with less than two of them
+bool VelocityEstimator::Rotation(const double *x, const double *y, const int *assign, double *angle) const
+{
+	double cx = 0., cy = 0., lx = 0., ly = 0.;
+	int j, n = 0;
+
+	for (j = 0; j < mN; j++) {
+		if (assign[j] < 0 || !mLastFound[j]) continue;
+		cx += x[j];  cy += y[j];
+		lx += mLastX[j];  ly += mLastY[j];
+		n++;
+	}
+	if (n < 2) return false;
+	cx /= n;  cy /= n;
+	lx /= n;  ly /= n;
+
+	double dot = 0., cross = 0.;
+	for (j = 0; j < mN; j++) {
+		if (assign[j] < 0 || !mLastFound[j]) continue;
+		double ax = mLastX[j] - lx, ay = mLastY[j] - ly;
+		double bx = x[j] - cx, by = y[j] - cy;
+		dot += ax*bx + ay*by;
+		cross += ax*by - ay*bx;
+	}
+	if (dot == 0. && cross == 0.) return false;
+
+	*angle = atan2(cross, dot);
+	return true;
+}
+
+void VelocityEstimator::Update(const double *x, const double *y, const int *assign, double t, double dt)
+{
+	int j;
+
+	if (t > mT) dt = t - mT;
+	mT = t > mT ? t : mT + dt;
+	if (dt <= 0.) return;
+
+	for (j = 0; j < mN; j++) {
+		mX[j] += mVX[j]*dt;
+		mY[j] += mVY[j]*dt;
+		if (assign[j] < 0) continue;
+
+		double rx = x[j] - mX[j], ry = y[j] - mY[j];
+		mX[j] += mAlpha*rx;
+		mY[j] += mAlpha*ry;
+		mVX[j] += mBeta*rx/dt;
+		mVY[j] += mBeta*ry/dt;
+	}
+
+	double angle;
+	mPhase += mOmega*dt;
+	if (Rotation(x, y, assign, &angle)) {
+		mAngle += angle;
+		double r = mAngle - mPhase;
+		mPhase += mAlpha*r;
+		mOmega += mBeta*r/dt;
+	}
+	else {
+		// nothing to measure the turn by, so it turned as predicted
+		mAngle = mPhase;
+	}
+
+	for (j = 0; j < mN; j++) {
+		mLastFound[j] = assign[j] >= 0;
+		if (assign[j] < 0) continue;
+		mLastX[j] = x[j];
+		mLastY[j] = y[j];
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef VELOCITY_ESTIMATOR_H_
+#define VELOCITY_ESTIMATOR_H_
+
+#include <vector>
+
+// Estimates the velocity of every marker, and the angular velocity of the
+// body they are on, from the camera time stamps instead of the nominal rate.
+//
+// Each marker has an alpha-beta filter on its world position: the position is
+// predicted with its velocity over the time since the last frame, and the
+// residual of the measurement corrects the position by alpha and the velocity
+// by beta/dt. The markers are on one rotating body, so the angle it turned
+// between two frames is the least squares rotation of the markers found in
+// both about their centroid; the sum of these angles goes through the same
+// filter to give omega, in rad/s, without needing the radius of any marker.
+class VelocityEstimator
+{
+    public:
+		VelocityEstimator(int markers, double alpha, double beta);
+
+		// starts at the given world positions, with no velocity, at time t in seconds
+		void Reset(const double *x, const double *y, double t);
+		bool Started() const { return mStarted; }
+
+		// assign[j] < 0 for a marker missing in this frame, which only predicts,
+		// as from MarkerMatch; dt: the time to use if t is not after the last frame
+		void Update(const double *x, const double *y, const int *assign, double t, double dt);
+
+		double X(int j) const { return mX[j]; }
+		double Y(int j) const { return mY[j]; }
+		double VX(int j) const { return mVX[j]; }
+		double VY(int j) const { return mVY[j]; }
+		double Omega() const { return mOmega; }
+
+    private:
+		int mN;
+		double mAlpha, mBeta;
+		bool mStarted;
+		double mT;
+
+		// the filtered tracks
+		std::vector<double> mX, mY, mVX, mVY;
+
+		// the last measured positions, for the rotation
+		std::vector<double> mLastX, mLastY;
+		std::vector<bool> mLastFound;
+
+		// the turned angle, as measured and as filtered
+		double mAngle, mPhase, mOmega;
+
+		bool Rotation(const double *x, const double *y, const int *assign, double *angle) const;
+};
+
+#endif /* VELOCITY_ESTIMATOR_H_ */
@@ -0,0 +1,181 @@
+#include "cameralibrary.h" // OUTPUT
+#include "vision_sender.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define FRESH	4 // set in mMiddle by Publish(), cleared by SendLatest()
+#define SLOT	3 // the slot index in mMiddle
+
+#define WAIT_MS	100 // how often the thread looks at mQuit
+
+VisionSender::VisionSender(VisionTCP *net)
+{
+	mNet = net;
+	mMonitor = NULL;
+	mBack = 0;
+	mMiddle = 1;
+	mFront = 2;
+	mLogHead = mLogTail = mLogLost = 0;
+	mThread = NULL;
+	mReady = NULL;
+	mQuit = false;
+}
+
+VisionSender::~VisionSender()
+{
+	Stop();
+}
+
+int VisionSender::Start()
+{
+	if (mThread != NULL) return 0;
+
+	mQuit = false;
+	mReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+	mThread = CreateThread(NULL, 0, Main, this, 0, NULL);
+	if (mThread == NULL) {
+		CloseHandle(mReady);
+		mReady = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+// Sends the last sample and prints the log before the thread ends.
+void VisionSender::Stop()
+{
+	if (mThread == NULL) return;
+
+	mQuit = true;
+	SetEvent(mReady);
+	WaitForSingleObject(mThread, INFINITE);
+	CloseHandle(mThread);
+	CloseHandle(mReady);
+	mThread = NULL;
+	mReady = NULL;
+}
+
+void VisionSender::Post(int ROI, double x, double y, double time_stamp, LONGLONG fetched, int frame_id)
+{
+	Sample &s = mSlot[mBack];
+
+	s.batch = 0;
+	s.id = ROI;
+	s.frame_id = frame_id;
+	s.x = x;
+	s.y = y;
+	s.time_stamp = time_stamp;
+	s.fetched = fetched;
+	Publish();
+}
+
+void VisionSender::PostMarkers(int frame_id, double time_stamp, int count, const VisionMarker *markers, LONGLONG fetched)
+{
+	Sample &s = mSlot[mBack];
+
+	if (count > VISION_NET_MAX_MARKERS) count = VISION_NET_MAX_MARKERS;
+	if (count < 0) count = 0;
+
+	s.batch = 1;
+	s.id = frame_id;
+	s.time_stamp = time_stamp;
+	s.fetched = fetched;
+	s.count = count;
+	memcpy(s.markers, markers, count*sizeof(VisionMarker));
+	Publish();
+}
+
+// Swaps the filled back slot into the middle; the exchange is a full barrier,
+// so the thread sees the whole sample.
+void VisionSender::Publish()
+{
+	LONG old = InterlockedExchange(&mMiddle, mBack | FRESH);
+	mBack = old & SLOT;
+	if (mReady != NULL) SetEvent(mReady);
+}
+
+void VisionSender::Log(double tt, int frame_id, double fx, double fy, int count, const double *x, const double *y)
+{
+	if (mLogTail - mLogHead >= VISION_LOG_SIZE) {
+		InterlockedIncrement(&mLogLost);
+		return;
+	}
+
+	if (count > VISION_NET_MAX_MARKERS) count = VISION_NET_MAX_MARKERS;
+
+	Line &l = mLog[mLogTail % VISION_LOG_SIZE];
+	l.tt = tt;
+	l.frame_id = frame_id;
+	l.fx = fx;
+	l.fy = fy;
+	l.count = count;
+	memcpy(l.x, x, count*sizeof(double));
+	memcpy(l.y, y, count*sizeof(double));
+
+	// the line must be complete before the thread can see it
+	MemoryBarrier();
+	mLogTail = mLogTail + 1;
+}
+
+void VisionSender::SendLatest()
+{
+	if (!(mMiddle & FRESH)) return;
+
+	LONG old = InterlockedExchange(&mMiddle, mFront);
+	mFront = old & SLOT;
+
+	Sample &s = mSlot[mFront];
+	if (s.batch) {
+		mNet->SendMarkers(s.id, s.time_stamp, s.count, s.markers);
+	}
+	else if (s.frame_id >= 0 && mNet->Echoing()) {
+		mNet->SendStamped(s.id, s.x, s.y, s.frame_id, s.fetched);
+	}
+	else {
+		mNet->Send(s.id, s.x, s.y, s.time_stamp);
+	}
+	if (mMonitor != NULL && s.fetched != 0) mMonitor->Sent(s.fetched);
+}
+
+// The sprintf_s of the frame loop, now done here.
+void VisionSender::PrintLog()
+{
+	char buff[3000];
+	char temp[300];
+
+	while (mLogHead != mLogTail) {
+		// read the line only after seeing it logged
+		MemoryBarrier();
+		const Line &l = mLog[mLogHead % VISION_LOG_SIZE];
+
+		sprintf_s(buff, "tt: %f frame# %d , f: %f %f w: #0 %f %f ;",
+				l.tt, l.frame_id, l.fx, l.fy, l.x[0], l.y[0]);
+		for (int i = 1; i < l.count; i++)
+		{
+			sprintf_s(temp, " #%d %f %f", i, l.x[i], l.y[i]);
+			strcat_s(buff, temp);
+		}
+
+		// hand the slot back to the frame loop
+		MemoryBarrier();
+		mLogHead = mLogHead + 1;
+
+		OUTPUT(buff);
+	}
+}
+
+DWORD WINAPI VisionSender::Main(LPVOID param)
+{
+	VisionSender *me = (VisionSender *)param;
+
+	while (!me->mQuit) {
+		WaitForSingleObject(me->mReady, WAIT_MS);
+		me->SendLatest();
+		me->PrintLog();
+	}
+
+	me->SendLatest();
+	me->PrintLog();
+	return 0;
+}
@@ -0,0 +1,86 @@
+#ifndef VISION_SENDER_H_
+#define VISION_SENDER_H_
+
+#include "vision_tcp.h"
+#include "frame_monitor.h"
+
+#define VISION_LOG_SIZE	256 // lines the frame loop can log before the thread prints them
+
+// Sends the samples of the frame loop to the qnx server on a thread of its own,
+// so a stalled network never delays frame->Release() and the camera library
+// never drops frames for it.
+//
+// The frame loop posts every sample into a single "latest value" mailbox: a
+// triple buffer swapped with InterlockedExchange, so neither side waits on the
+// other. A sample the thread had no time to send is replaced by the next one;
+// only the newest is ever sent.
+//
+// With a FrameMonitor, every send of a sample with its fetched time is timed.
+//
+// Log() takes the numbers of a debug line into a ring; the thread formats and
+// prints them after sending. Lines are dropped, and counted, while the ring is full.
+class VisionSender
+{
+    public:
+        VisionSender(VisionTCP *net);
+        ~VisionSender();
+
+		int Start();
+		void Stop();
+
+		// called by the frame loop, never block
+		// fetched: FrameMonitor::Now() when the frame was got, 0 to not time it
+		// frame_id: for the clock stamp when the VisionTCP echoes, -1 for none
+		void Post(int ROI, double x, double y, double time_stamp, LONGLONG fetched = 0, int frame_id = -1);
+		void PostMarkers(int frame_id, double time_stamp, int count, const VisionMarker *markers, LONGLONG fetched = 0);
+		void Log(double tt, int frame_id, double fx, double fy, int count, const double *x, const double *y);
+
+		long Lost() const { return mLogLost; }
+		void SetMonitor(FrameMonitor *monitor) { mMonitor = monitor; }
+
+    private:
+		struct Sample {
+			int batch; // 1 for PostMarkers()
+			int id;
+			int frame_id;
+			double x, y;
+			double time_stamp;
+			LONGLONG fetched;
+			int count;
+			VisionMarker markers[VISION_NET_MAX_MARKERS];
+		};
+
+		struct Line {
+			double tt;
+			int frame_id;
+			double fx, fy;
+			int count;
+			double x[VISION_NET_MAX_MARKERS], y[VISION_NET_MAX_MARKERS];
+		};
+
+		VisionTCP *mNet;
+		FrameMonitor *mMonitor;
+
+		// the triple buffer; mMiddle has FRESH set while it holds an unsent sample
+		Sample mSlot[3];
+		int mBack; // the frame loop's
+		int mFront; // the thread's
+		volatile LONG mMiddle;
+
+		// the log ring, written at mLogTail and printed from mLogHead
+		Line mLog[VISION_LOG_SIZE];
+		volatile LONG mLogHead;
+		volatile LONG mLogTail;
+		volatile LONG mLogLost;
+
+		HANDLE mThread;
+		HANDLE mReady;
+		volatile bool mQuit;
+
+		void Publish();
+		void SendLatest();
+		void PrintLog();
+		static DWORD WINAPI Main(LPVOID param);
+};
+
+#endif /* VISION_SENDER_H_ */
@@ -0,0 +1,483 @@
+#include "vision_tcp.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <qos2.h>
+#include <iphlpapi.h>
+#pragma comment(lib, "qwave.lib")
+#pragma comment(lib, "iphlpapi.lib")
+#pragma comment(lib, "advapi32.lib")
+
+// the drivers of the network adapters keep their settings under a key of this class
+#define NET_CLASS_KEY "SYSTEM\\CurrentControlSet\\Control\\Class\\{4D36E972-E325-11CE-BFC1-08002BE10318}"
+
+
+
+
+VisionTCP::VisionTCP() 
+{
+	mInitialized = false;
+	mUdp = false;
+	mSeq = 0;
+	mEcho = NULL;
+	mLastSend = 0;
+	mBeats = 0;
+	mQos = NULL;
+	InitializeCriticalSection(&mSendLock);
+}
+
+VisionTCP::Profile VisionTCP::defaults()
+{
+	Profile p;
+	p.bind_ip = NULL;
+	p.send_buffer = 0;
+	p.dscp = -1;
+	p.check_adapter = false;
+	return p;
+}
+
+VisionTCP::~VisionTCP()
+{
+	closesocket(mSessionSocket);
+
+	// the closed socket ends its recv()
+	if (mEcho != NULL) {
+		WaitForSingleObject(mEcho, 1000);
+		CloseHandle(mEcho);
+	}
+	if (mQos != NULL) QOSCloseHandle(mQos);
+	DeleteCriticalSection(&mSendLock);
+}
+
+// udp: send every sample as one VisionPacket datagram. A lost datagram is
+// not resent, so a late sample never holds back the newer ones.
+// profile: the adapter, buffer and DSCP of the socket, see Profile
+int VisionTCP::Init(bool udp, const char *ip, int port, const Profile &profile) 
+{
+	// 0. Initilize; Windows specific
+	WSADATA wsaData;
+	if( WSAStartup(MAKEWORD(2,2),&wsaData ) == SOCKET_ERROR ) {
+		fprintf(stderr,"WSAStartup failed with error %d\n",WSAGetLastError());
+		WSACleanup();
+		return -91;
+	}
+	
+	mUdp = udp;
+	mSeq = 0;
+
+	// Server Address
+	mServerAddr.sin_family = AF_INET;
+	mServerAddr.sin_port = htons(port); // Port MUST be in Network Byte Order
+	mServerAddr.sin_addr.s_addr = inet_addr(ip); // INADDR_ANY;
+
+	if (profile.check_adapter) CheckAdapter(profile.bind_ip);
+
+	if (mUdp) {
+		// no connection; every datagram is sent to mServerAddr
+		mSessionSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (mSessionSocket == SOCKET_ERROR) {
+			fprintf(stderr, "The socket is not created!\n");
+			WSACleanup();
+			return -92;
+		}
+		if (profile.send_buffer > 0 && setsockopt(mSessionSocket, SOL_SOCKET, SO_SNDBUF,
+			(char*)&profile.send_buffer, sizeof(int)) == SOCKET_ERROR) {
+			fprintf(stderr,"setsockopt failed with error %d\n",WSAGetLastError());
+			WSACleanup();
+			return -94;
+		}
+		if (Bind(profile.bind_ip)) return -96;
+		MarkDscp(profile.dscp);
+		printf("Sending UDP to the qnx server.\n");
+
+		mInitialized = true;
+		return 0;
+	}
+
+	//1. Socket Creation
+	mSessionSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (mSessionSocket == SOCKET_ERROR) {
+		fprintf(stderr, "The socket is not created!\n");
+		WSACleanup();
+		return -92;
+	}
+	//1.1 Socket Option	
+	BOOL opt = 1;
+    if (setsockopt(mSessionSocket, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(BOOL)) == SOCKET_ERROR) {
+		fprintf(stderr,"setsockopt failed with error %d\n",WSAGetLastError());
+		WSACleanup();
+		return -93;
+	}
+	// A small buffer keeps a sample from waiting behind older ones; not 0,
+	// by this setting, send() takes A LOT OF time. e.g., ~200 ms
+	if (profile.send_buffer > 0 && setsockopt(mSessionSocket, SOL_SOCKET, SO_SNDBUF,
+		(char*)&profile.send_buffer, sizeof(int)) == SOCKET_ERROR) {
+		fprintf(stderr,"setsockopt failed with error %d\n",WSAGetLastError());
+		WSACleanup();
+		return -94;
+	}
+	if (Bind(profile.bind_ip)) return -96;
+
+	//printf("Client: A socket is created.\n");
+
+	//2. Connect
+	if ( connect(mSessionSocket, (SOCKADDR *)&mServerAddr, sizeof(mServerAddr) ) == SOCKET_ERROR ) {
+		fprintf(stderr, "The connection failed!\n");
+		WSACleanup();
+		return -95;
+	}
+	printf("Connected to the qnx server.\n");
+	// a TCP socket joins its flow once it is connected
+	MarkDscp(profile.dscp);
+	
+	mInitialized = true;
+	return 0;
+}
+
+// Sends from the adapter of ip only, any port; NULL or "" for any adapter.
+int VisionTCP::Bind(const char *ip)
+{
+	if (ip == NULL || *ip == '\0') return 0;
+
+	SOCKADDR_IN local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = 0;
+	local.sin_addr.s_addr = inet_addr(ip);
+	if (bind(mSessionSocket, (SOCKADDR *)&local, sizeof(local)) == SOCKET_ERROR) {
+		fprintf(stderr, "The socket is not bound to %s, error %d!\n", ip, WSAGetLastError());
+		closesocket(mSessionSocket);
+		WSACleanup();
+		return -1;
+	}
+	printf("Sending from %s.\n", ip);
+	return 0;
+}
+
+// Marks the packets of the socket with dscp through qWAVE. Windows ignores
+// IP_TOS; the flow of the control traffic type is marked without rights, a
+// code point of its own only for an administrator. A link without the mark
+// still works, so a failure is only told.
+int VisionTCP::MarkDscp(int dscp)
+{
+	if (dscp < 0) return 0;
+
+	QOS_VERSION version = {1, 0};
+	if (mQos == NULL && !QOSCreateHandle(&version, &mQos)) {
+		printf("qWAVE is not available, error %d; the packets are not marked.\n", GetLastError());
+		mQos = NULL;
+		return -1;
+	}
+
+	QOS_FLOWID flow = 0;
+	if (!QOSAddSocketToFlow(mQos, mSessionSocket, mUdp ? (PSOCKADDR)&mServerAddr : NULL,
+		QOSTrafficTypeControl, QOS_NON_ADAPTIVE_FLOW, &flow)) {
+		printf("The socket does not join a qWAVE flow, error %d; the packets are not marked.\n", GetLastError());
+		return -1;
+	}
+	DWORD value = (DWORD)dscp;
+	if (!QOSSetFlow(mQos, flow, QOSSetOutgoingDSCPValue, sizeof(value), &value, 0, NULL)) {
+		printf("DSCP %d is not set, error %d; the packets have the one of the control traffic type.\n",
+			dscp, GetLastError());
+		return -1;
+	}
+	printf("The packets are marked with DSCP %d.\n", dscp);
+	return 0;
+}
+
+// One standardized keyword of the driver of an adapter, "-" if it has none.
+static void AdapterSetting(HKEY key, const char *name)
+{
+	char value[64];
+	DWORD size = sizeof(value) - 1, type;
+
+	if (RegQueryValueExA(key, name, NULL, &type, (LPBYTE)value, &size) != ERROR_SUCCESS || type != REG_SZ) {
+		strcpy_s(value, "-");
+	}
+	else {
+		value[size] = '\0';
+	}
+	printf("  %-24s %s\n", name, value);
+	if (!strcmp(name, "*InterruptModeration") && strcmp(value, "0")) {
+		printf("  the interrupt moderation may hold a packet back; turn it off in the advanced settings of the adapter\n");
+	}
+}
+
+// Prints the adapter of ip, or the one of the route to the qnx server, and
+// the settings of its driver that delay or batch packets.
+void VisionTCP::CheckAdapter(const char *ip)
+{
+	static const char *settings[] = {"*InterruptModeration", "*LsoV1IPv4", "*LsoV2IPv4",
+		"*TCPChecksumOffloadIPv4", "*UDPChecksumOffloadIPv4", "*RSS", "*FlowControl"};
+	bool bound = ip != NULL && *ip != '\0';
+	DWORD route = 0;
+
+	if (!bound && GetBestInterface(mServerAddr.sin_addr.s_addr, &route) != NO_ERROR) {
+		printf("No route to the qnx server, no adapter to check.\n");
+		return;
+	}
+
+	ULONG size = 16*1024;
+	IP_ADAPTER_ADDRESSES *list = (IP_ADAPTER_ADDRESSES *)malloc(size);
+	if (GetAdaptersAddresses(AF_INET, GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER,
+		NULL, list, &size) == ERROR_BUFFER_OVERFLOW) {
+		free(list);
+		list = (IP_ADAPTER_ADDRESSES *)malloc(size);
+		if (GetAdaptersAddresses(AF_INET, GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER,
+			NULL, list, &size) != NO_ERROR) {
+			free(list);
+			return;
+		}
+	}
+
+	IP_ADAPTER_ADDRESSES *a;
+	for (a = list; a != NULL; a = a->Next) {
+		if (!bound) {
+			if (a->IfIndex == route) break;
+			continue;
+		}
+		IP_ADAPTER_UNICAST_ADDRESS *u;
+		for (u = a->FirstUnicastAddress; u != NULL; u = u->Next) {
+			SOCKADDR_IN *in = (SOCKADDR_IN *)u->Address.lpSockaddr;
+			if (in->sin_addr.s_addr == inet_addr(ip)) break;
+		}
+		if (u != NULL) break;
+	}
+	if (a == NULL) {
+		printf("No adapter has %s.\n", bound ? ip : "the route to the qnx server");
+		free(list);
+		return;
+	}
+
+	printf("The link goes out of %S, %.0lf Mbit/s, MTU %u:\n", a->FriendlyName,
+		a->TransmitLinkSpeed/1.e6, a->Mtu);
+
+	// the key of the driver is the one of the GUID of the adapter
+	HKEY cls;
+	if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, NET_CLASS_KEY, 0, KEY_READ, &cls) == ERROR_SUCCESS) {
+		char sub[16];
+		for (DWORD i = 0, n = sizeof(sub); RegEnumKeyExA(cls, i, sub, &n, NULL, NULL, NULL, NULL) == ERROR_SUCCESS;
+			 i++, n = sizeof(sub)) {
+			HKEY drv;
+			if (RegOpenKeyExA(cls, sub, 0, KEY_READ, &drv) != ERROR_SUCCESS) continue;
+			char guid[64];
+			DWORD len = sizeof(guid) - 1, type;
+			if (RegQueryValueExA(drv, "NetCfgInstanceId", NULL, &type, (LPBYTE)guid, &len) == ERROR_SUCCESS &&
+				type == REG_SZ) {
+				guid[len] = '\0';
+				if (!_stricmp(guid, a->AdapterName)) {
+					for (int k = 0; k < sizeof(settings)/sizeof(settings[0]); k++) {
+						AdapterSetting(drv, settings[k]);
+					}
+				}
+			}
+			RegCloseKey(drv);
+		}
+		RegCloseKey(cls);
+	}
+	free(list);
+}
+
+int VisionTCP::Send(int ROI, double x, double y, double time_stamp) 
+{
+	if (!mInitialized) {
+		printf("The TCP/IP connection is not initialized!\n");
+		return -1;
+	}
+
+	if (mUdp) {
+		mPacket.seq = mSeq++;
+		mPacket.time_stamp = time_stamp;
+		mPacket.count = VISION_NET_NUM_CH;
+		mPacket.val[0] = (double)ROI;
+		mPacket.val[1] = x;
+		mPacket.val[2] = y;
+
+		// a failed datagram is only this sample; keep the socket for the next one
+		int n = sendto(mSessionSocket, (char*)&mPacket, sizeof(mPacket), 0,
+			(SOCKADDR *)&mServerAddr, sizeof(mServerAddr));
+		if (n == SOCKET_ERROR) {
+			printf("The function sendto() failed with error %d.\n", WSAGetLastError());
+			return n;
+		}
+
+		mROI = ROI; mx = x; my = y;
+		return 1;
+	}
+
+	VisionWireSample msg = vision_wire_make((double)ROI, x, y);
+
+	int n = SendAll((const char *)&msg, sizeof(msg));
+	if (n == SOCKET_ERROR) return n;
+
+	mROI = ROI; mx = x; my = y;
+	return 1;
+}
+
+// Tells the qnx server the layout of the messages that follow, and whether
+// the markers come in batches.
+int VisionTCP::SendHello(int flags)
+{
+	if (!mInitialized || mUdp) return -1;
+
+	VisionWireSample hello = vision_wire_make(VISION_NET_HELLO, VISION_WIRE_VERSION, flags);
+	int n = SendAll((const char *)&hello, sizeof(hello));
+	return n == SOCKET_ERROR ? n : 1;
+}
+
+// One whole message at a time, also against the pongs of the echo thread.
+int VisionTCP::SendAll(const char *buf, int len)
+{
+	LARGE_INTEGER t;
+
+	EnterCriticalSection(&mSendLock);
+	int n = send(mSessionSocket, buf, len, 0);
+	QueryPerformanceCounter(&t);
+	mLastSend = t.QuadPart;
+	LeaveCriticalSection(&mSendLock);
+
+	if (n == SOCKET_ERROR) { 
+		mInitialized = false;
+		closesocket(mSessionSocket);
+		WSACleanup();
+		
+		// It seems like when the connection from server is disconnected, WASGetLastError() gives 0.
+		printf("The function send() failed with error %d, so I'm closing the connection socket now.\n", WSAGetLastError());
+	}
+	return n;
+}
+
+double VisionTCP::Seconds(LONGLONG ticks)
+{
+	static double perSecond = 0;
+
+	if (perSecond == 0) {
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		perSecond = double(f.QuadPart);
+	}
+	return ticks/perSecond;
+}
+
+// The stamp and the sample in one send(), so the qnx side parses them together.
+int VisionTCP::SendStamped(int ROI, double x, double y, int frame_id, LONGLONG fetched)
+{
+	if (!mInitialized || mUdp) {
+		printf("The TCP/IP connection is not initialized!\n");
+		return -1;
+	}
+
+	if (fetched == 0) {
+		LARGE_INTEGER t;
+		QueryPerformanceCounter(&t);
+		fetched = t.QuadPart;
+	}
+
+	VisionWireSample msg[2] = {vision_wire_make(VISION_NET_STAMP, (double)frame_id, Seconds(fetched)),
+		vision_wire_make((double)ROI, x, y)};
+
+	int n = SendAll((const char *)msg, sizeof(msg));
+	if (n == SOCKET_ERROR) return n;
+
+	mROI = ROI; mx = x; my = y;
+	return 1;
+}
+
+// Starts the thread that answers the pings of the qnx server.
+int VisionTCP::StartEcho()
+{
+	if (!mInitialized || mUdp) return -1;
+	if (mEcho != NULL) return 0;
+
+	mEcho = CreateThread(NULL, 0, Echo, this, 0, NULL);
+	if (mEcho == NULL) return -1;
+
+	// the pong is the time of this PC as the ping came, so no wait for the CPU
+	SetThreadPriority(mEcho, THREAD_PRIORITY_TIME_CRITICAL);
+	return 0;
+}
+
+// A beat if nothing went out for VISION_NET_BEAT_SEC; of the echo thread.
+int VisionTCP::Beat(LONGLONG now)
+{
+	EnterCriticalSection(&mSendLock);
+	bool idle = Seconds(now - mLastSend) >= VISION_NET_BEAT_SEC;
+	LeaveCriticalSection(&mSendLock);
+	if (!idle) return 0;
+
+	VisionWireSample beat = vision_wire_make(VISION_NET_BEAT, (double)mBeats++, Seconds(now));
+	return SendAll((const char *)&beat, sizeof(beat));
+}
+
+DWORD WINAPI VisionTCP::Echo(LPVOID param)
+{
+	VisionTCP *me = (VisionTCP *)param;
+	char buf[sizeof(VisionWireSample)];
+	int fill = 0;
+
+	while (me->mInitialized) {
+		// wakes up every beat at least, to beat while no sample goes out
+		fd_set ready;
+		FD_ZERO(&ready);
+		FD_SET(me->mSessionSocket, &ready);
+		timeval tv = {0, (long)(VISION_NET_BEAT_SEC*1.e6)};
+		int r = select(0, &ready, NULL, NULL, &tv);
+		if (r == SOCKET_ERROR) break;
+
+		LARGE_INTEGER t;
+		QueryPerformanceCounter(&t);
+		if (me->Beat(t.QuadPart) == SOCKET_ERROR) break;
+		if (r == 0) continue;
+
+		int n = recv(me->mSessionSocket, buf + fill, sizeof(buf) - fill, 0);
+		if (n <= 0) break;
+
+		fill += n;
+		const VisionWireSample *ping = vision_wire_sample(buf, fill);
+		if (ping == NULL) continue;
+		fill = 0;
+		if (ping->val[0] != VISION_NET_PING) continue;
+
+		VisionWireSample pong = vision_wire_make(VISION_NET_PONG, ping->val[2], Seconds(t.QuadPart));
+		if (me->SendAll((const char *)&pong, sizeof(pong)) == SOCKET_ERROR) break;
+	}
+	return 0;
+}
+
+// Sends all markers of one frame in a single message, one send() instead of
+// one per marker. At most VISION_NET_MAX_MARKERS are sent.
+int VisionTCP::SendMarkers(int frame_id, double time_stamp, int count, const VisionMarker *markers) 
+{
+	if (!mInitialized) {
+		printf("The TCP/IP connection is not initialized!\n");
+		return -1;
+	}
+
+	if (count > VISION_NET_MAX_MARKERS) count = VISION_NET_MAX_MARKERS;
+	if (count < 0) count = 0;
+
+	VisionBatch *b = (VisionBatch *)mBatch;
+	b->magic = VISION_BATCH_MAGIC;
+	b->version = VISION_WIRE_VERSION;
+	b->seq = mSeq++;
+	b->frame_id = (unsigned int)frame_id;
+	b->time_stamp = time_stamp;
+	b->count = (unsigned short)count;
+	memcpy(&mBatch[sizeof(VisionBatch)], markers, count*sizeof(VisionMarker));
+
+	int len = sizeof(VisionBatch) + count*sizeof(VisionMarker);
+	int n;
+	if (mUdp) {
+		n = sendto(mSessionSocket, mBatch, len, 0, (SOCKADDR *)&mServerAddr, sizeof(mServerAddr));
+		if (n == SOCKET_ERROR) {
+			printf("The function sendto() failed with error %d.\n", WSAGetLastError());
+		}
+		return n == SOCKET_ERROR ? n : 1;
+	}
+
+	n = SendAll(mBatch, len);
+	if (n == SOCKET_ERROR) return n;
+	return 1;
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#ifndef VISION_TCP_H_
+#define VISION_TCP_H_
+
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib") // linking to the library. necessary!
+
+#include "../../TDah/include/VisionWire.h"
+
+class VisionTCP;
+
+#define DEFAULT_PORT  3490 // 3100 - qnx to matlab, 3490 - vision to qnx
+#define SERVER_IP "192.168.1.65" //qnx  192.168.1.65; host pc 192.168.1.111
+
+// The messages are those of TDah's VisionWire.h, shared with the VisionNet of
+// the qnx server. The transport and batch of opti.cfg choose between them;
+// SendHello() tells the qnx side the version and the mode, see VisionNet.h.
+//
+// The UDP mode sends every sample as a VisionPacket, numbered, so the
+// receiver can tell lost and late samples; the time stamp is the one of the
+// camera frame. SendMarkers() sends a VisionBatch in either mode.
+//
+// The clock sync of the TCP mode: with StartEcho(), SendStamped() puts a
+// stamp of the frame before its sample, and the pings of the qnx server are
+// answered with the time of this PC, in the seconds of QueryPerformanceCounter,
+// see Seconds(). The echo thread also sends a numbered beat whenever nothing
+// was sent for VISION_NET_BEAT_SEC, so the qnx side can tell a dead link from
+// a frame without markers within a control period or two.
+//
+// The Profile of Init() keeps the link off the queues of the rest of the PC:
+// the socket is bound to the address of a dedicated adapter, the send buffer
+// is kept small, so a sample does not wait behind older ones, and the packets
+// are marked with a DSCP through qWAVE, which a switch can queue ahead. TCP
+// always has TCP_NODELAY. With check_adapter, Init() prints the adapter the
+// link goes out of and its interrupt moderation and offloads, as the driver
+// keeps them in the registry; the moderation delays every packet.
+#define VISION_NET_BEAT_SEC	0.001
+
+class VisionTCP 
+{
+    public:
+        // Constuctor
+        VisionTCP();
+        // Destructor
+        ~VisionTCP();
+
+		// the socket settings of the link
+		struct Profile {
+			const char *bind_ip;	// the address of the adapter to send from, NULL for any
+			int send_buffer;		// bytes of SO_SNDBUF, 0 for the default; 0 bytes makes send() wait
+			int dscp;				// the DiffServ code point of the packets, -1 for none, 46 expedited
+			bool check_adapter;		// print the adapter and its driver settings
+		};
+		static Profile defaults();
+		
+		int Init(bool udp = false, const char *ip = SERVER_IP, int port = DEFAULT_PORT,
+				 const Profile &profile = defaults());
+		int Send(int ROI, double x, double y, double time_stamp = 0.0);
+		int SendMarkers(int frame_id, double time_stamp, int count, const VisionMarker *markers);
+		// the first message of a TCP session, flags: VISION_WIRE_BATCH or 0
+		int SendHello(int flags);
+
+		// the clock sync, TCP only; fetched: the QueryPerformanceCounter
+		// ticks when the frame was got, 0 for now
+		int StartEcho();
+		bool Echoing() const { return mEcho != NULL; }
+		int SendStamped(int ROI, double x, double y, int frame_id, LONGLONG fetched);
+		static double Seconds(LONGLONG ticks);
+
+    private:
+		int mROI; 
+		double mx;
+		double my;
+
+		bool mInitialized;
+		bool mUdp;
+		unsigned int mSeq;
+		VisionPacket mPacket;
+		char mBatch[sizeof(VisionBatch) + VISION_NET_MAX_MARKERS*sizeof(VisionMarker)];
+
+		// the echo thread sends the pongs between the samples
+		HANDLE mEcho;
+		CRITICAL_SECTION mSendLock;
+		LONGLONG mLastSend; // the ticks of the last message, under mSendLock
+		unsigned int mBeats;
+		int SendAll(const char *buf, int len);
+		int Beat(LONGLONG now);
+		static DWORD WINAPI Echo(LPVOID param);
+
+		// the Profile
+		HANDLE mQos;
+		int Bind(const char *ip);
+		int MarkDscp(int dscp);
+		void CheckAdapter(const char *ip);
+
+		// TCP/IP
+		int mSocket;
+		int mSessionSocket;
+		//struct sockaddr_in mServerAddr;
+		SOCKADDR_IN mServerAddr;
+
+};
+
+#endif /* VISION_TCP_H_ */
+
@@ -13,6 +13,44 @@ extern VisionNet 	*VNET;
 
 #define VISION_NET_NUM_CH	3
 
+// 1 to receive the samples as UDP datagrams instead of over a TCP connection.
+// The vision side must send in the same mode, the transport of its opti.cfg.
+#define VISION_NET_UDP	0
+
+// The datagram of one sample in the UDP mode; same layout in OptiClient/vision_tcp.h.
+#pragma pack(push, 1)
+struct VisionPacket {
+	unsigned int seq;
+	double time_stamp;
+	unsigned short count; // number of values that follow
+	double val[VISION_NET_NUM_CH];
+};
+
+// The batched message of one frame, in either mode; same layout in
+// OptiClient/vision_tcp.h. The header is followed by count VisionMarker.
+#define VISION_NET_MAX_MARKERS	16
+#define VISION_BATCH_MAGIC	0x424D4E56 // "VNMB"
+
+#define VISION_MARKER_FOUND		0x01 // x, y are valid
+#define VISION_MARKER_VELOCITY	0x02 // vx, vy are valid
+
+struct VisionBatch {
+	unsigned int magic;
+	unsigned int seq;
+	unsigned int frame_id;
+	double time_stamp;
+	unsigned short count;
+};
+
+struct VisionMarker {
+	float x, y; // world position, mm
+	float vx, vy; // world velocity, mm/s
+	unsigned char flags;
+};
+#pragma pack(pop)
+
+#define VISION_NET_BUF	(sizeof(VisionBatch) + VISION_NET_MAX_MARKERS*sizeof(VisionMarker))
+
 // This is a modification from MatlabNet.C/h 
 // Whereas MatlabNet is for sending data to display at a host computer,
 // This is for receiving data from the vision computer.
@@ -26,11 +64,24 @@ class VisionNet : public AperiodicTask{
         // Destructor
         ~VisionNet();
 		
-		int Init(double rate, int priority);
+		int Init(double rate, int priority, int udp = 0);
 		void Process();
 		void AddSignal(int ch, double *val);
 		int Recv(); // for direction data receoption.
 
+		// UDP mode: the camera time stamp and sequence number of the last sample,
+		// the samples lost in between, and the ones that came after a newer one.
+		double mTimeStamp;
+		unsigned int mSeq;
+		unsigned int mGaps;
+		unsigned int mStale;
+
+		// The markers of the last VisionBatch and its frame. The signals then
+		// hold the frame id and the position of marker 0.
+		VisionMarker mMarker[VISION_NET_MAX_MARKERS];
+		int mMarkerCount;
+		unsigned int mFrameId;
+
     private:
 		double mSampleRate;
 		//FifoQ *mpFifo;
@@ -38,7 +89,7 @@ class VisionNet : public AperiodicTask{
 		//char mBuf[VISION_NET_NUM_CH*8];
 		//when the program is in the camera mode, only [VISION_NET_NUM_CH*8] might be enough.
 		//However, when recv() is called on the thread, we may need a larger size of buffer.
-		char mBuf[128]; 
+		char mBuf[VISION_NET_BUF < 128 ? 128 : VISION_NET_BUF]; 
 
 		double *mpValPtrArr[VISION_NET_NUM_CH];
 		//double mpValBuf[VISION_NET_NUM_CH]; // not necessary for vision TCP/IP
@@ -53,6 +104,14 @@ class VisionNet : public AperiodicTask{
 		unsigned char validSession;
 
 		int TcpIpInit();
+
+		// UDP
+		int mUdp;
+		int mHaveSeq; // 0 until the first sample
+		int UdpInit();
+		int UdpRecv();
+		int Decode(int n);
+		int Sequence(const char *buf, int n, unsigned int *seq);
 		
 		// Task function
 		void Task();
@@ -12,17 +12,17 @@ b = f/w;
 % a_inv = inv(a'*a)*a';
 a_inv = inv(a);
 % a_inv*f
-str = ['#define a11 ', num2str(a_inv(1,1))];
+str = ['a11 ', num2str(a_inv(1,1))];
 disp(str);
-str = ['#define a12 ', num2str(a_inv(1,2))];
+str = ['a12 ', num2str(a_inv(1,2))];
 disp(str);
-str = ['#define a13 ', num2str(a_inv(1,3))];
+str = ['a13 ', num2str(a_inv(1,3))];
 disp(str);
-str = ['#define a21 ', num2str(a_inv(2,1))];
+str = ['a21 ', num2str(a_inv(2,1))];
 disp(str);
-str = ['#define a22 ', num2str(a_inv(2,2))];
+str = ['a22 ', num2str(a_inv(2,2))];
 disp(str);
-str = ['#define a23 ', num2str(a_inv(2,3))];
+str = ['a23 ', num2str(a_inv(2,3))];
 disp(str);disp(' ');
 
 % str = ['#define a11 ', num2str(aa(1,1))];
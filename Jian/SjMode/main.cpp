@@ -1,4 +1,3 @@
-
 //=================================================================================-----
 //== NaturalPoint 2010
 //== Camera Library SDK Sample
@@ -6,9 +5,7 @@
 //== This sample brings up a connected camera and displays it's output frames.
 //=================================================================================-----
 
-#include "supportcode.h"       //== Boiler-plate code for application window init ===---
-#include "cameralibrary.h"     //== Camera Library header file ======================---
-#include "cameramanager.h"
+#include "opti_client.h"       //== Camera, window and network, see OptiClient ======---
 #include <windows.h>
 #include <stdio.h>
 #include <tchar.h>
@@ -19,410 +16,306 @@
 #include <fstream>
 #include <math.h>
 
-#include "calibration.h"
 #include "main.h"
-#include "vision_tcp.h"
+#include "marker_match.h"
+#include "recorder.h"
+#include "velocity_estimator.h"
+#include "latency_echo.h"
+#include "calib_capture.h"
 
 using namespace CameraLibrary; 
 using namespace std;
 
-
-int main(int argc, char* argv[])
+// the positions of a camera group are in world mm already, see camera_group.h
+static void ToWorld(const OptiConfig &cfg, bool world, const double *x, const double *y, int n,
+					double *wx, double *wy)
 {
-	VisionTCP IRvisionTCP;
-	//Initialize TCPIP
-	if (!TESTMODE){
-		
-		if (int init = IRvisionTCP.Init()) {
-			OUTPUT("No TCPIP connection available!");
-			//return init;
-		}
+	if (world) {
+		memcpy(wx, x, n*sizeof(double));
+		memcpy(wy, y, n*sizeof(double));
 	}
+	else cfg.calib.Map(x, y, n, wx, wy);
+}
 
 
-	//== For OptiTrack Ethernet cameras, it's important to enable development mode if you
-	//== want to stop execution for an extended time while debugging without disconnecting
-	//== the Ethernet devices.  Lets do that now:
-
-	CameraLibrary_EnableDevelopment();
-
-	//== Initialize connected cameras ==========----
-	
-    CameraManager::X().WaitForInitialization();
+int main(int argc, char* argv[])
+{
+	OptiClient client;
 
-    //== Get a connected camera ================----
+	//== Open the camera, and the application window if calibrating ====----
 
-    Camera *camera = CameraManager::X().GetCamera();
+	Camera *camera = client.Open(OPTI_CONFIG_FILE, TESTMODE != 0);
+	if (camera == NULL) return 1;
 
-    //== If no device connected, pop a message box and exit ==--
+	const OptiConfig &cfg = client.Config();
+	const int markerCnt = cfg.markers;
+	const int framecnt = int(cfg.frame_rate*Time_to_record + rid);
 
-    if(camera==0)
-    {
-        MessageBox(0,"Please connect a camera","No Device Connected", MB_OK);
-        return 1;
-    }
+	//Initialize TCPIP; sends and prints off the frame loop, see vision_sender.h
+	if (!TESTMODE){
+		client.Connect();
+	}
+	VisionSender &sender = client.Sender();
+	// counts the gaps and rejected frames, and times fetch to send, see frame_monitor.h
+	FrameMonitor &monitor = client.Monitor();
 
-	//== Determine camera resolution to size application window ==----
-	
     int cameraWidth  = camera->Width();
-    int cameraHeight = camera->Height();
 	int i, j ;
 	char buff[3000];
 	// Define the data buffer:
-	double posbuff[framecnt][NUM_MARKERS*2+1];
-	double calibuff[CALIBRA_NUM][2];
-
- 	//== Open the application window =============================----
-		
-    if (TESTMODE)
-	{
-		if (!CreateAppWindow("Camera Library SDK - Sample",cameraWidth,cameraHeight,32,gFullscreen))  return 0;
-	
-
-    //== Create a texture to push the rasterized camera image ====----
-
-    //== We're using textures because it's an easy & cpu light 
-    //== way to utilize the 3D hardware to display camera
-    //== imagery at high frame rates
-		
+	vector<double> posrow(markerCnt*2+1);
+	Recorder rec; // streams the rows to RECFILE, see recorder.h
+	// averages the dots of the board and fits the calibration, see calib_capture.h
+	CalibCapture capture;
+	if (TESTMODE && capture.LoadWorld(WORLDFILE) != CALIBRA_NUM) {
+		OUTPUT("The world positions of the board are not " WORLDFILE "!");
+		return 1;
 	}
-	Surface Texture(cameraWidth, cameraHeight);
-
-	//if (TESTMODE == 1){
-		
-		Bitmap * framebuffer = new Bitmap(cameraWidth, cameraHeight, Texture.PixelSpan()*4,
-								   Bitmap::ThirtyTwoBit, Texture.GetBuffer());
-	//}
-	
-    //== Set Video Mode ==--
 
-    //camera->SetVideoType(SegmentMode);
-	camera->SetVideoType(ObjectMode);
-    
-	//Set camera frame rate
-	camera->SetFrameRate(FRAMERATE);
-
-	//==Set camera exposure
-	camera->SetExposure(25);
-
-    //== Start camera output ==--
-
-    camera->Start();
-	Core::DistortionModel distortion;
-	distortion.Distort = true;
-	camera->GetDistortionModel(distortion);
-
-    //== Turn on some overlay text so it's clear things are     ===---
-    //== working even if there is nothing in the camera's view. ===---
-	if (TESTMODE == 1){
-		camera->SetTextOverlay(true);
-
-		camera->SetMarkerOverlay(true);
+	/*************************************************************************************************/
+	if (!TESTMODE && rec.Open(RECFILE, markerCnt*2+1)) {
+		OUTPUT("The recording is not started!");
 	}
 
-	/*************************************************************************************************/
     //== Ok, start main loop.  This loop fetches and displays   ===---
     //== camera frames.                                         ===---
-	int flag = 0;
-	double preX[NUM_MARKERS], preY[NUM_MARKERS];
-	double prew_X, prew_Y;
+	vector<double> preX(markerCnt), preY(markerCnt);
 	int preFID = 0;
-	double min_interval;
-	double w_X[NUM_MARKERS], w_Y[NUM_MARKERS];
-	double tt, v, w[NUM_MARKERS], w_ave;
-	char index;
-	int y = 1;
+	vector<double> w_X(markerCnt), w_Y(markerCnt);
+	vector<double> nw_X(markerCnt), nw_Y(markerCnt);
+	double tt, w_ave;
+	vector<VisionMarker> markers(markerCnt);
+	memset(&markers[0], 0, markerCnt*sizeof(VisionMarker));
+	int index;
+	// tells which blob is which marker, gated at cfg.gate pixels
+	MarkerMatch match(markerCnt, cfg.gate);
+	vector<int> assign(markerCnt);
+	vector<double> blobX, blobY;
+	GroupFrame group; // of the cameras, with cameras in opti.cfg
+	// velocities from the camera time stamps, and omega of all markers
+	VelocityEstimator vel(markerCnt, cfg.alpha, cfg.beta);
+	// the LED of the latency probe of the qnx server, if it is in view
+	LatencyEcho echo(cfg.echo_x, cfg.echo_y, cfg.echo_gate);
 	
 	int runcnt = 0;
 
 	for (i = 0; i<5; i++){
-		IRvisionTCP.Send(0, 0.0 , 0.0);
+		client.Net().Send(0, 0.0 , 0.0);
 	}
 
     while(1)
 	{	  
-		//while (!keys[VK_SPACE]) { }
-          
-        //== Fetch a new frame from the camera ===---
-		
+        //== Fetch a new frame from the camera, or the fused frame of the cameras ===---
 		
-        Frame *frame = camera->GetFrame();
+        Frame *frame = NULL;
+		bool fetchedOne;
+		if (client.Grouped()) fetchedOne = client.WaitGroup(&group);
+		else fetchedOne = (frame = client.WaitFrame()) != NULL;
 		
-        if(frame)
+        if(fetchedOne)
         {
-		
-			
+			LONGLONG fetched = FrameMonitor::Now();
+			int frameId = frame ? frame->FrameID() : group.id;
+			double stamp = frame ? frame->TimeStamp() : group.stamp;
+			monitor.Frame(frameId);
 
-			//x = frame->TimeStamp();
-			if ((frame->FrameID() - preFID) == 0) continue;
+			// a frame thrown away is still released, or the camera library runs out of them
+			if ((frameId - preFID) == 0) { if (frame) frame->Release(); continue; }
 			
-			//QueryPerformanceCounter(&t2);
-            //== Ok, we've received a new frame, lets do something
-            //== with it.
-
-            //== Lets have the Camera Library raster the camera's
-            //== image into our texture.
-		
-            frame->Rasterize(framebuffer);
+            //== Display Camera Image, every preview_every frames ============--
 
-			//camera->AttachModule(new cModuleLabeler());
-
-            //== Display Camera Image ============--
-
-            if (TESTMODE){
-				if(!DrawGLScene(&Texture)) break;
-			}
+            if (frame && !client.Preview(frame)) break;
 
             //== Escape key to exit application ==--
 
             if (keys[VK_ESCAPE])
                 break;
 
-			//if (keys[VK_SPACE]) //Space key to reset the markers index number
-            //    flag = 0;
-			
-			if(frame->ObjectCount()>0)
+			// the camera's objects or the merged segments, see video_mode in opti.cfg;
+			// those of a group are in world mm already
+			int blobCnt;
+			if (frame) blobCnt = client.Markers(frame, blobX, blobY);
+			else {
+				blobX.swap(group.x);
+				blobY.swap(group.y);
+				blobCnt = (int)blobX.size();
+			}
+
+			// the LED is no marker; its echo goes out before anything else of the frame
+			if (echo.Enabled()) {
+				bool lit = echo.Take(blobX, blobY, blobCnt);
+				client.Net().Send(VISION_ECHO_ROI, lit ? 1.0 : 0.0, frameId, stamp);
+			}
+
+			if(blobCnt>0)
 			{
-				if (frame->ObjectCount() == NUM_MARKERS)
+				// missing and extra blobs are fine once the markers are tracked, see marker_match.h
+				if (blobCnt == markerCnt || !TESTMODE)
 				{
-					if (abs(frame->Object(0)->X()) > cameraWidth) 
+					if (frame && fabs(blobX[0]) > cameraWidth) {
+						monitor.Reject();
+						frame->Release();
 						continue;
+					}
+
+					if (!TESTMODE)
+					{
+						if (!match.Started()) { // Reset the markers previous index information
+							if (blobCnt != markerCnt)
+							{
+								OUTPUT("The # of markers is not what you want!");
+								monitor.Reject();
+								if (frame) frame->Release();
+								continue;
+							}
+							match.Reset(&blobX[0], &blobY[0]);
+							for (j = 0; j < markerCnt; j++){
+								preX[j] = blobX[j];
+								preY[j] = blobY[j];
+							}
+							ToWorld(cfg, frame == NULL, &preX[0], &preY[0], markerCnt, &w_X[0], &w_Y[0]);
+							vel.Reset(&w_X[0], &w_Y[0], stamp);
+							preFID = frameId;
+							if (frame) frame->Release();
+							continue;
+						}
+					}
 
 					runcnt++;  
 
 					if ((runcnt > framecnt) && (!TESTMODE) ) 
 						break;
 				}
-				else 
+
+				if (!TESTMODE)
 				{
-					if (!TESTMODE) 
+					match.Match(&blobX[0], &blobY[0], blobCnt, frameId - preFID, &assign[0]);
+
+					for (index = 0; index < markerCnt; index++)
 					{
-						OUTPUT("The # of markers is not what you want!");
-						continue;
+						if (assign[index] >= 0) {
+							preX[index] = blobX[assign[index]];  preY[index] = blobY[assign[index]];
+						}
 					}
-				}
 
-				cObject * object;
-				//cObject *object = (cObject *)malloc(frame->ObjectCount() * sizeof (cObject *));
-				//object = frame->Object(0);
-			    //camera->MarkerOverlay();
-				//elapsedTime = (t2.QuadPart - t1.QuadPart) * 1000.0 / frequency.QuadPart;
-				
+					//Calculate the calibrated positions in the world frame, of all markers in one call
+					ToWorld(cfg, frame == NULL, &preX[0], &preY[0], markerCnt, &nw_X[0], &nw_Y[0]);
 
-				for (i = 0; i < frame->ObjectCount(); i++)
-				{
-					/*if(!(NUM_MARKERS == frame->ObjectCount())) 
-					{
-						MessageBox(0,"The # of markers is not what you want!","Oh!", MB_OK);
-						return 1;
-					}*/
-					tt = frame->TimeStamp();
+					// the nominal interval is only used if the time stamp did not advance
+					vel.Update(&nw_X[0], &nw_Y[0], &assign[0], stamp,
+							   double(frameId - preFID)/cfg.frame_rate);
 
-					if(!TESTMODE)
+					for (index = 0; index < markerCnt; index++)
 					{
-						
-
-						if (flag == 0) { // Reset the markers previous index information
-						
-							for (j = 0; j < NUM_MARKERS; j++){
-								object = frame->Object(j);
-								preX[j] = object->X();
-								preY[j] = object->Y();																		
-							}
-							preFID = frame->FrameID();
-							flag = 1;
+						// a missing marker keeps its last position and speed
+						if (assign[index] < 0) {
+							markers[index].flags = 0;
 							continue;
 						}
-					
-						
-
-						object = frame->Object(i);
-
-						min_interval = abs(object->X() - preX[i]) + abs(object->Y() - preY[i]);
-						index = i;
-						
-
-						for (j = 0; j < frame->ObjectCount(); j++)
-						{
-							//if ( (abs(object->X() - preX[j]) < err) && (abs(object->Y() - preY[j]) < err) ) 
-							//{
-							//	index = j;
-								//preX[index] = object->X();  preY[index] = object->Y();
-							//	break;
-							//}
-							if ((abs(object->X() - preX[j]) + abs(object->Y() - preY[j])) < min_interval) 
-							{
-								min_interval = abs(object->X() - preX[j]) + abs(object->Y() - preY[j]);
-								index = j;
-								//preX[index] = object->X();	preY[index] = object->Y();
-							}
-						}
-
-						prew_X = a11*preX[index] + a12*preY[index] + a13;
-						prew_Y = a21*preX[index] + a22*preY[index] + a23;
 
-						preX[index] = object->X();  preY[index] = object->Y();
+						w_X[index] = nw_X[index];  w_Y[index] = nw_Y[index];
 
-						/*for (j = 0; j < NUM_MARKERS; j++){
-								object = frame->Object(j);
-								preX[j] = object->X();
-								preY[j] = object->Y();																		
-						}*/
-					
-					//}
-					//object = frame->Object(i);
-
-					//Calculate the calibrated position in the world frame
-						w_X[index] = a11*object->X() + a12*object->Y() + a13;
-						w_Y[index] = a21*object->X() + a22*object->Y() + a23;
-
-						v = ((w_X[index] - prew_X)*(w_X[index] - prew_X) + (w_Y[index] - prew_Y)*(w_Y[index] - prew_Y));
-						//v = sqrt(v)/((frame->FrameID() - preFID)/FRAMERATE);
-						v = sqrt(v)*FRAMERATE/(frame->FrameID() - preFID);
-											
-						if (index == 0) w[0] = v/r1;
-						else if (index == 1) w[1] = v/r2;
-						else if (index == 2) w[2] = v/r3;
-						else if (index == 3) w[3] = v/r4;
-
-					//double w_Xtemp, w_Ytemp;
-					//w_X = a11*object->X() + a12*object->Y() + a13*(object->X())*(object->X()) + a14*(object->Y())*(object->Y()) + a15*(object->X())*(object->Y()) + a16;
-					//w_Y = a21*object->X() + a22*object->Y() + a23*(object->X())*(object->X()) + a24*(object->Y())*(object->Y()) + a25*(object->X())*(object->Y()) + a26;
+						markers[index].x = (float)w_X[index];
+						markers[index].y = (float)w_Y[index];
+						markers[index].vx = (float)vel.VX(index);
+						markers[index].vy = (float)vel.VY(index);
+						markers[index].flags = VISION_MARKER_FOUND | VISION_MARKER_VELOCITY;
+					}
 
+					// first out, the sender thread and the network come after the DAQ write
+					if (client.Analog().isOpen()) {
+						client.Analog().publish(markerCnt, &w_X[0], &w_Y[0], &assign[0]);
 					}
+				}
 
-					if (TESTMODE){
-						object = frame->Object(i);
-						w_X[0] = a11*object->X() + a12*object->Y() + a13;
-						w_Y[0] = a21*object->X() + a22*object->Y() + a23;
-						//sprintf(buff, "frameRate:%d frame# %d (w:%d,h:%d), Object index:%d,m#:%d, f: %f %f w: %f %f",
-						//	camera->FrameRate(), frame->FrameID(),cameraWidth, cameraHeight, index ,i,object->X(), object->Y(), w_X, w_Y);
-						sprintf_s(buff, "frame# %d , f: %f %f w: %f %f",
-							frame->FrameID(), object->X(), object->Y(), w_X[0], w_Y[0]);
-						OUTPUT(buff);
-
-						/*FILE * fp;
-						fp = fopen("camera_frame.txt","a");
-						
-						fprintf(fp, "%f %f 1\n", object->X(), object->Y());
-						
-						fclose(fp);
-						*/
-						if (frame->ObjectCount() != CALIBRA_NUM) continue;
-						calibuff[i][0] = object->X();
-						calibuff[i][1] = object->Y();
 
-					}
-										
+				tt = stamp;
+
+				if (TESTMODE && capture.Add(&blobX[0], &blobY[0], blobCnt)) {
+					sprintf_s(buff, "frame# %d: %d of %d calibration frames",
+						frameId, capture.Frames(), CALIB_FRAMES);
+					OUTPUT(buff);
 				}
 
-				w_ave = 0.0;
-				for (i = 0; i < NUM_MARKERS; i++) w_ave += w[i];
-				w_ave = w_ave/NUM_MARKERS;
+				// the speed of the body, unsigned like the mean of v/r it replaces
+				w_ave = fabs(vel.Omega());
 
 				if (runcnt % 1 == 0 && runcnt > 0 && !TESTMODE){
-					IRvisionTCP.Send(frame->FrameID(), w_ave , tt);
-					//OUTPUT("send");
+					if (cfg.batch)
+						sender.PostMarkers(frameId, tt, markerCnt, &markers[0], fetched);
+					else
+						sender.Post(frameId, w_ave , tt, tt, fetched, frameId);
 				}
 				
-				preFID = frame->FrameID();
+				preFID = frameId;
 
 				//OUTPUT markers data to file
 				if (!TESTMODE)
 				{
-					char temp[300];
-
-					//This part is for output the data to the Output window
-					sprintf_s(buff, "tt: %f frame# %d , f: %f %f w: #0 %f %f ;",
-							tt, frame->FrameID(), preX[0], preX[0], w_X[0], w_Y[0]);
-					for (i = 1; i < NUM_MARKERS; i++)
-					{
-						sprintf_s(temp, " #%d %f %f",
-							i, w_X[i], w_Y[i]);
-						strcat_s(buff, temp);
-					}
-					OUTPUT(buff);
+					//This part is for output the data to the Output window, formatted by the sender thread
+					sender.Log(tt, frameId, preX[0], preX[0], markerCnt, &w_X[0], &w_Y[0]);
 					
-					//write the position data to the buffer which will be written into text file
-					for (i = 0; i < NUM_MARKERS; i++)
+					//write the position data to the recording which will be exported into text file
+					for (i = 0; i < markerCnt; i++)
 					{
-						posbuff[runcnt-1][i*2] = w_X[i];
-						posbuff[runcnt-1][i*2+1] = w_Y[i];
+						posrow[i*2] = w_X[i];
+						posrow[i*2+1] = w_Y[i];
 					}
-					posbuff[runcnt-1][NUM_MARKERS*2] = frame->FrameID();
+					posrow[markerCnt*2] = frameId;
+					rec.Record(&posrow[0]);
 					
 				}
-				else
-				{
-					FILE * fp;
-					fp = fopen("camera_frame.txt","w");
-						
-					for (i = 0; i < CALIBRA_NUM; i++)
-					{
-						fprintf(fp, "%f %f 1\n", calibuff[i][0], calibuff[i][1]);
-					}
-												
-					fclose(fp);
-				}
 				
 			}
 
-			//OUTPUT("sj");
             //== Release frame =========--
-            frame->Release();
-			if (TESTMODE) 
-			{
-				OUTPUT("---------------------------------------------------------------------------------------------");
-				/*FILE * fp;
-						fp = fopen("camera_frame.txt","w");
-						
-						fprintf(fp, "\n");
-						
-						fclose(fp);*/
-			}
-		}
+            if (frame) frame->Release();
 
-	    //Sleep(0);
+			if (TESTMODE && capture.Frames() >= CALIB_FRAMES) break;
+		}
 
         //== Service Windows Message System ==--
 
         if(!PumpMessages())
             break;
 
-		//free(frame);
-
     }//while
 
+	// the last samples go out after the thread, which owns the socket until then
+	sender.Stop();
 	for (i = 0; i<3; i++){
-		IRvisionTCP.Send(1, 1.0 , 1.0);
+		client.Net().Send(1, 1.0 , 1.0);
 	}
 
-	if (!TESTMODE)
+	if (TESTMODE && capture.Frames() > 0)
 	{
-		FILE * fp;
-		fp = fopen(FILENAME,"w");
+		// the mean frame still goes to camera_frame.txt for calibration.m
+		double rms = capture.Fit(CALIB_MODEL);
+		capture.WriteFrame("camera_frame.txt");
+		if (capture.Write(cfg.calibration.c_str())) {
+			OUTPUT("The calibration file is not written!");
+		}
+		sprintf_s(buff, "%s calibrated from %d frames, RMS %.3f mm",
+			cfg.calibration.c_str(), capture.Frames(), rms);
+		OUTPUT(buff);
+	}
 
-		for (i = rid; i < framecnt; i++)
+	if (!TESTMODE)
+	{
+		rec.Close();
+		if (rec.Lost() > 0)
 		{
-			for (j = 0; j < NUM_MARKERS*2; j++)	fprintf(fp,"%f ",posbuff[i][j]);			
-			fprintf(fp, "%d\n", int(posbuff[i][NUM_MARKERS*2]));
+			sprintf_s(buff, "%ld rows were not recorded!", rec.Lost());
+			OUTPUT(buff);
 		}
-		fclose(fp);
+		Recorder::Export(RECFILE, FILENAME, rid);
 	}
-    //== Close window ==--
-
-    if(TESTMODE) CloseWindow();
 
-    //== Release camera ==--
+    //== Close window, release camera and shutdown Camera Library ==--
 
-    camera->Release();
-
-    //== Shutdown Camera Library ==--
-
-    CameraManager::X().Shutdown();
+	client.Close();
 
     //== Exit the application.  Simple! ==--
 
 	return 1;
 }
-
@@ -1,14 +1,16 @@
-#define NUM_MARKERS 4  //# of the tracking markers
 #define CALIBRA_NUM 98  //This is the number of total dots on the calibration board
+#define CALIB_FRAMES 100 // TESTMODE averages the dots over this many frames, then fits and writes the calibration file
+#define CALIB_MODEL CALIB_AFFINE // or CALIB_HOMOGRAPHY, see calib_transform.h
+#define WORLDFILE "world_frame.txt" // the board's dots in mm, row by row, see calib_capture.h
 
 #define TESTMODE 0 // Testmode is for testing and calibration, "0" is for testing and "1" is for calibration
 #define OUTMODE 1  // Determine output data to text file or not, "1" means will write all data to file
 
-#define FRAMERATE 250
+// The frame rate, exposure, transport, markers and calibration are read from
+// opti.cfg at start up, see OptiClient/opti_config.h
+
 #define Time_to_record 10 //in second
 #define FILENAME "data4.txt" //The name for output file
+#define RECFILE "data4.bin" //The binary recording, streamed while running and exported to FILENAME at the end
 
-#define rid 100   //Since at the beginning the data seems to be a little unstable, so get 'rid' of the first # data.
-
-#define framecnt int(FRAMERATE*Time_to_record + rid)
-#define err 20
\ No newline at end of file
+#define rid 100   //Since at the beginning the data seems to be a little unstable, so get 'rid' of the first # data.
\ No newline at end of file
@@ -1,42 +0,0 @@
-/*#define a11 0.43945
-#define a12 0.56128
-#define a13 -2.6017e-005
-#define a14 -4.7836e-005
-#define a15 -1.1921e-007
-#define a16 -336.0291
-#define a21 0.53084
-#define a22 -0.41773
-#define a23 9.4511e-006
-#define a24 1.7017e-005
-#define a25 -1.9461e-005
-#define a26 -147.5652*/
-
-/*
-#define a11 0.68082
-#define a12 0.081764
-#define a13 -347.6572
-#define a21 0.080356
-#define a22 -0.6929
-#define a23 339.8594
-
-#define a11 0.67236
-#define a12 0.12686
-#define a13 -370.143
-#define a21 0.12589
-#define a22 -0.68342
-#define a23 314.1889
-
-
-#define a11 0.68445
-#define a12 0.075757
-#define a13 -346.6577
-#define a21 0.074817
-#define a22 -0.69577
-#define a23 367.5413
-*/
-#define a11 0.49302
-#define a12 0.011696
-#define a13 -217.6158
-#define a21 0.012369
-#define a22 -0.49432
-#define a23 172.5305
\ No newline at end of file
@@ -6,9 +6,7 @@
 //== This sample brings up a connected camera and displays it's output frames.
 //=================================================================================-----
 
-#include "supportcode.h"       //== Boiler-plate code for application window init ===---
-#include "cameralibrary.h"     //== Camera Library header file ======================---
-#include "cameramanager.h"
+#include "opti_client.h"       //== Camera, window and transport, see opti.cfg ======---
 #include <windows.h>
 #include <stdio.h>
 #include <tchar.h>
@@ -18,7 +16,6 @@
 #include <string>
 #include <fstream>
 
-#include "calibration.h"
 //#include <cv.h>
 //#include <cxcore.h>
 //#include <highgui.h>
@@ -30,7 +27,7 @@
 #define CALIBRA_NUM 98  //This is the number of total dots on the calibration board
 
 #define TESTMODE 1 // Testmode is for testing and calibration 
-#define FRAMERATE 250
+#define FRAMERATE 250 // sizes the recording only, the camera runs at the frame_rate of opti.cfg
 #define Time_to_record 20 //in second
 #define FILENAME "TOM3.txt" //The name for output file
 
@@ -64,37 +61,13 @@ using namespace std;
 int main(int argc, char* argv[])
 {
 	cout << "jiangediaoda";
-	//== For OptiTrack Ethernet cameras, it's important to enable development mode if you
-	//== want to stop execution for an extended time while debugging without disconnecting
-	//== the Ethernet devices.  Lets do that now:
+	//== Open the camera of opti.cfg, with the window for calibration ==--
 
-	/*ofstream myfile;
-	myfile.open ("example.txt");
-    myfile << "Writing this to a file.\n";
-    myfile.close();*/
+	OptiClient client;
+	Camera *camera = client.Open(OPTI_CONFIG_FILE, TESTMODE != 0);
+	if (camera == NULL) return 1;
+	const OptiConfig &cfg = client.Config();
 
-	CameraLibrary_EnableDevelopment();
-
-	//printf("sjja;sjf\n");
-
-	//== Initialize connected cameras ==========----
-	
-    CameraManager::X().WaitForInitialization();
-
-    //== Get a connected camera ================----
-
-    Camera *camera = CameraManager::X().GetCamera();
-
-    //== If no device connected, pop a message box and exit ==--
-
-    if(camera==0)
-    {
-        MessageBox(0,"Please connect a camera","No Device Connected", MB_OK);
-        return 1;
-    }
-
-	//== Determine camera resolution to size application window ==----
-	
     int cameraWidth  = camera->Width();
     int cameraHeight = camera->Height();
 	int i, j ;
@@ -114,54 +87,6 @@ int main(int argc, char* argv[])
     //QueryPerformanceFrequency(&frequency);
     //QueryPerformanceCounter(&t1);
 
- 	//== Open the application window =============================----
-		
-    if (TESTMODE)
-	{
-		if (!CreateAppWindow("Camera Library SDK - Sample",cameraWidth,cameraHeight,32,gFullscreen))  return 0;
-	
-
-    //== Create a texture to push the rasterized camera image ====----
-
-    //== We're using textures because it's an easy & cpu light 
-    //== way to utilize the 3D hardware to display camera
-    //== imagery at high frame rates
-		
-	}
-	Surface Texture(cameraWidth, cameraHeight);
-
-	//if (TESTMODE == 1){
-		
-		Bitmap * framebuffer = new Bitmap(cameraWidth, cameraHeight, Texture.PixelSpan()*4,
-								   Bitmap::ThirtyTwoBit, Texture.GetBuffer());
-	//}
-	
-    //== Set Video Mode ==--
-
-    //camera->SetVideoType(SegmentMode);
-	camera->SetVideoType(ObjectMode);
-    
-	//Set camera frame rate
-	camera->SetFrameRate(FRAMERATE);
-
-	//==Set camera exposure
-	camera->SetExposure(25);
-
-    //== Start camera output ==--
-
-    camera->Start();
-	Core::DistortionModel distortion;
-	distortion.Distort = true;
-	camera->GetDistortionModel(distortion);
-
-    //== Turn on some overlay text so it's clear things are     ===---
-    //== working even if there is nothing in the camera's view. ===---
-	if (TESTMODE == 1){
-		camera->SetTextOverlay(true);
-
-		camera->SetMarkerOverlay(true);
-	}
-
     //== Ok, start main loop.  This loop fetches and displays   ===---
     //== camera frames.                                         ===---
 	int flag = 0;
@@ -182,7 +107,7 @@ int main(int argc, char* argv[])
         //== Fetch a new frame from the camera ===---
 		
 		
-        Frame *frame = camera->GetFrame();
+        Frame *frame = client.WaitFrame();
 		
         if(frame)
         {
@@ -193,17 +118,13 @@ int main(int argc, char* argv[])
             //== with it.
 
             //== Lets have the Camera Library raster the camera's
-            //== image into our texture.
-		
-            frame->Rasterize(framebuffer);
+            //== image into our texture, every preview_every frames.
 
 			//camera->AttachModule(new cModuleLabeler());
 
             //== Display Camera Image ============--
 
-            if (TESTMODE){
-				if(!DrawGLScene(&Texture)) break;
-			}
+            if (!client.Preview(frame)) break;
 
             //== Escape key to exit application ==--
 
@@ -294,8 +215,7 @@ int main(int argc, char* argv[])
 					//object = frame->Object(i);
 
 					//Calculate the calibrated position in the world frame
-						w_X[index] = a11*object->X() + a12*object->Y() + a13;
-						w_Y[index] = a21*object->X() + a22*object->Y() + a23;
+						cfg.World(object->X(), object->Y(), &w_X[index], &w_Y[index]);
 					//double w_Xtemp, w_Ytemp;
 					//w_X = a11*object->X() + a12*object->Y() + a13*(object->X())*(object->X()) + a14*(object->Y())*(object->Y()) + a15*(object->X())*(object->Y()) + a16;
 					//w_Y = a21*object->X() + a22*object->Y() + a23*(object->X())*(object->X()) + a24*(object->Y())*(object->Y()) + a25*(object->X())*(object->Y()) + a26;
@@ -304,8 +224,7 @@ int main(int argc, char* argv[])
 
 					if (TESTMODE){
 						object = frame->Object(i);
-						w_X[0] = a11*object->X() + a12*object->Y() + a13;
-						w_Y[0] = a21*object->X() + a22*object->Y() + a23;
+						cfg.World(object->X(), object->Y(), &w_X[0], &w_Y[0]);
 						//sprintf(buff, "frameRate:%d frame# %d (w:%d,h:%d), Object index:%d,m#:%d, f: %f %f w: %f %f",
 						//	camera->FrameRate(), frame->FrameID(),cameraWidth, cameraHeight, index ,i,object->X(), object->Y(), w_X, w_Y);
 						sprintf_s(buff, "frame# %d , f: %f %f w: %f %f",
@@ -382,8 +301,6 @@ int main(int argc, char* argv[])
 			}
 		}
 
-	    //Sleep(0);
-
         //== Service Windows Message System ==--
 
         if(!PumpMessages())
@@ -404,17 +321,9 @@ int main(int argc, char* argv[])
 		}
 		fclose(fp);
 	}
-    //== Close window ==--
-
-    if(TESTMODE) CloseWindow();
-
-    //== Release camera ==--
-
-    camera->Release();
-
-    //== Shutdown Camera Library ==--
+    //== Close window, release camera and shutdown Camera Library ==--
 
-    CameraManager::X().Shutdown();
+	client.Close();
 
     //== Exit the application.  Simple! ==--
 
@@ -10,6 +10,13 @@
 // by calling the TriggerWait() function.  The value argument passed
 // to the Trigger() function is returned by the TriggerWait() function.
 //
+// TriggerPending() is the trigger of a producer that queues work for the
+// task: it sends a pulse only when none is pending since the last
+// TriggerWait(), so the task drains everything queued per wakeup and the
+// producer makes one kernel call per batch instead of one per item.  The
+// flag is cleared when the task wakes, before it drains, so work queued
+// while it drains triggers it again.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -28,12 +35,14 @@ class AperiodicTask{
 
 		void Init(char *name, int priority);
 		int Trigger(int value);
+		int TriggerPending(int value);
 
 
     private:
 		int mChannelId;
 		int mConnectId;
 		int mPriority;
+		volatile unsigned mPending;	// a pulse of TriggerPending() is on its way
 		char *mTaskName;
 		pthread_t mThreadId;
 		static void *TaskThread(void *arg);
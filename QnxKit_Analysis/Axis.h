@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// Axis Set Class Definition
+//
+// The joints the loop drives: of each axis the encoder channel, the amplifier
+// channel, the scale of a count to rad and of a current to volts, both with
+// the sign of the wiring, the current limit and the motor model of its
+// feedforward.  The loop keeps the state of all axes in an AxisState, an
+// array per quantity, so a pass over the axes runs on contiguous doubles
+// with no branch on the axis, and the compiler can unroll or vectorize it.
+//
+// All the encoder reads of a cycle are one batch, IoHardware::ReadEncoders(),
+// with one time stamp, and all the amplifier writes are one, loaded channel
+// by channel and updated by one strobe of the DAC, so the outputs of all
+// axes change at the same time and an axis more costs its port accesses
+// and not a call chain of its own.
+//
+// The axes are added before the loop starts and not changed after, so the
+// loop threads read the set without a lock.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef Axis_h
+#define Axis_h
+
+#include "IoHardware.h"
+
+class MotorModel;
+
+#define AXIS_MAX	NUM_ENCODER_CHANNELS
+
+// the state of every axis, index the axis
+typedef struct{
+	int count[AXIS_MAX];	// encoder counts
+	double pos[AXIS_MAX];	// rad
+	double vel[AXIS_MAX];	// rad/s
+}AxisState;
+
+class AxisSet{
+	public:
+		AxisSet();
+
+		// radPerCount, voltPerAmp: with the sign of the wiring
+		// maxCurrent: A, the limit of the current of the axis
+		// return: the axis, or -1 if there are AXIS_MAX already
+		int Add(IoHardware::EncoderInputCh enc, IoHardware::AnalogOutputCh amp,
+			double radPerCount, double voltPerAmp, double maxCurrent, MotorModel *motor);
+		int Count() const { return mAxes; }
+		MotorModel *Motor(int axis) const { return mMotor[axis]; }
+
+		// the encoders of all axes in the plan of HW->ProcessInput()
+		void Plan() const;
+
+		// s from the counts of the last HW->ProcessInput()
+		void Take(AxisState *s) const;
+		// s from a read of all encoders now
+		void Read(AxisState *s) const;
+
+		// current: A of every axis, limited and scaled in place
+		// volt: the amplifier command of every axis
+		// on: 0 to write 0 V instead
+		void Write(double *current, double scale, int on, double *volt) const;
+
+		// 0 V to every amplifier, out with the next HW->ProcessOutput()
+		void Stop() const;
+
+	private:
+		int mAxes;
+		IoHardware::EncoderInputCh mEnc[AXIS_MAX];
+		IoHardware::AnalogOutputCh mAmp[AXIS_MAX];
+		double mRadPerCount[AXIS_MAX];
+		double mVoltPerAmp[AXIS_MAX];
+		double mMaxCurrent[AXIS_MAX];
+		MotorModel *mMotor[AXIS_MAX];
+
+		void Convert(AxisState *s, const double *countVel) const;
+};
+
+#endif // Axis_h
@@ -0,0 +1,10 @@
+#ifndef BenchMain_h
+#define BenchMain_h
+
+// qnxkit_bench [runs] [rate] [label]: runs samples of every case of
+// IoBench.h, the share of the period of the SampleLoop at rate, appended to
+// IO_BENCH_FILE under label; on the CPU and at the priority of the loop
+#define BENCH_PRIORITY		60		// of SampleLoop->Init(), see main.C
+#define BENCH_LABEL			"default"
+
+#endif // BenchMain_h
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+// Control Math Kernels
+//
+// Inline math of the controllers, so a cycle evaluates each function once:
+// SinCos() gets sin and cos of an angle with one x87 fsincos, and Sinc()
+// gets sin(x)/x and its derivative from them, by a Taylor series near 0 where
+// the quotients lose their digits.  No special case of x == 0 is needed.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ControlMath_h
+#define ControlMath_h
+
+#include <math.h>
+
+// below, the series are exact to the last bits of a double
+#define CONTROL_MATH_SINC_TAYLOR	0.1
+
+inline void SinCos(double x, double *s, double *c){
+#if defined(__i386__) || defined(__x86_64__)
+	double sv, cv;
+	__asm__ ("fsincos" : "=t" (cv), "=u" (sv) : "0" (x));
+	*s = sv;
+	*c = cv;
+#else
+	*s = sin(x);
+	*c = cos(x);
+#endif
+}
+
+// sinc = sin(x)/x, dsinc = d(sin(x)/x)/dx = (x*cos(x) - sin(x))/x^2,
+// from s = sin(x) and c = cos(x)
+inline void Sinc(double x, double s, double c, double *sinc, double *dsinc){
+	if(fabs(x) < CONTROL_MATH_SINC_TAYLOR){
+		double x2 = x*x;
+		*sinc = 1. - x2/6.*(1. - x2/20.*(1. - x2/42.*(1. - x2/72.)));
+		*dsinc = -x/3.*(1. - x2/10.*(1. - x2/28.*(1. - x2/54.)));
+	}
+	else{
+		double inv = 1./x;
+		*sinc = s*inv;
+		*dsinc = (c - *sinc)*inv;
+	}
+}
+
+#endif // ControlMath_h
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// Controller Class Definitions
+//
+// A controller is defined by subclassing Controller and defining Update(),
+// which maps the state the sample loop measured in this cycle to the
+// acceleration command of the hand.  Its gains and the coefficients derived
+// from them are computed once in the constructor, not in every cycle.
+//
+// The ControllerTable holds the controllers of the experiment and the
+// schedule they run in: one controller, or several in turn for a time each.
+// The user interface asks for a change with Select() or Schedule() at any
+// time; the sample loop takes it at the start of its next Update() and
+// resets the controller it switches to, so nothing has to be restarted.
+//
+// Gain schedules are read at start-up by ControllerTable::Load(), so an
+// experiment changes its gains and targets in the file, not in the code:
+//
+//   schedule <name> <time|eta2> [repeat]
+//   <at> <k1> <k2> <c> <target hand velocity>
+//   ...
+//
+// each schedule one ScheduledController, the points in order of at: s since
+// the controller was switched to, from the start again after the last point
+// with repeat, or |eta2|.  The gains between two points are interpolated;
+// two points at the same at are a step.  '#' starts a comment.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef Controller_h
+#define Controller_h
+
+#define CONTROLLER_MAX		8
+#define CONTROLLER_SCHEDULE_MAX	8
+#define CONTROLLER_NAME_LEN	32
+#define GAIN_SCHEDULE_POINTS	32
+
+// what the sample loop measured in this cycle
+typedef struct{
+	double eta1;
+	double eta2;
+	double handTheta;
+	double handVel;
+	double objTheta;
+	double objAngVel;
+	double sec;	// since the last cycle
+	double ref;	// the target hand velocity the host streams, see TrajectoryNet.h
+}ControlState;
+
+class Controller{
+	public:
+		Controller(const char *name){ mName = name; }
+		virtual ~Controller(){}
+
+		// called when the controller is switched to
+		virtual void Reset(){}
+		// return: the acceleration command of the hand, rad/s^2
+		virtual double Update(const ControlState *s)=0;
+
+		const char *Name(){ return mName; }
+
+	private:
+		const char *mName;
+};
+
+// The coefficients of the hand/object dynamics the backstepping law uses
+typedef struct{
+	double sig1;	// M_O*GRAV*(RHO_H+RHO_O)/RHO_H
+	double sig2;	// 1/(RHO_H*M22)
+	double sig3;	// 1 - M12/(RHO_H*M22)
+	double m12;
+	double m22;
+	double rhoH;
+}PlantCoeff;
+
+// Backstepping control of the object on the hand: with a target hand
+// velocity of 0 it stabilizes the object, otherwise it keeps the hand at the
+// target velocity with the object balanced.
+class BacksteppingController : public Controller{
+	public:
+		BacksteppingController(const char *name, const PlantCoeff *p,
+			double k1, double k2, double c, double targetHandVel);
+
+		double Update(const ControlState *s);
+
+	protected:
+		// what Update() takes of the gains, each linear in them
+		typedef struct{
+			double c;
+			double k1Sig3;		// K1/sig3
+			double k2Sig3;		// K2/sig3
+			double eta1Star;
+			double target;
+		}Gains;
+
+		Gains mG;
+
+		void MakeGains(double k1, double k2, double c, double targetHandVel, Gains *g);
+		void Target(double targetHandVel){
+			mG.eta1Star = mEta1PerTarget*targetHandVel;
+			mG.target = targetHandVel;
+		}
+
+	private:
+		// precomputed from the plant
+		double mSig1, mSig2, mSig3;
+		double mSig2Sig3;	// sig2/sig3
+		double mEta1PerTarget;
+};
+
+// The backstepping law with the target hand velocity of the cycle, ref of
+// the ControlState, so it follows the trajectory the host streams.
+class TrajectoryController : public BacksteppingController{
+	public:
+		TrajectoryController(const char *name, const PlantCoeff *p, double k1, double k2, double c)
+			: BacksteppingController(name, p, k1, k2, c, 0.){}
+
+		double Update(const ControlState *s){
+			Target(s->ref);
+			return BacksteppingController::Update(s);
+		}
+};
+
+// The backstepping law with the gains and the target of a schedule, by the
+// time since it was switched to or by |eta2|, see the top of the file.  The
+// Gains of the points are made once; a cycle moves to the segment it is in
+// from the one before and blends the Gains of its ends.
+class ScheduledController : public BacksteppingController{
+	public:
+		enum By{ BY_TIME, BY_ETA2 };
+
+		ScheduledController(const char *name, const PlantCoeff *p, By by, int repeat);
+
+		// return: -1 if the schedule is full or at is before the last point
+		int Add(double at, double k1, double k2, double c, double targetHandVel);
+		int Points(){ return mN; }
+
+		void Reset();
+		double Update(const ControlState *s);
+
+	private:
+		char mNameBuf[CONTROLLER_NAME_LEN];
+		By mBy;
+		int mRepeat;
+
+		int mN;
+		double mAt[GAIN_SCHEDULE_POINTS];
+		Gains mPoint[GAIN_SCHEDULE_POINTS];
+
+		int mSeg;		// the segment of the last cycle, from point mSeg to mSeg + 1
+		double mTime;	// s since Reset()
+};
+
+class ControllerTable{
+	public:
+		ControllerTable();
+
+		// return: the index, or -1 if the table is full
+		int Add(Controller *c);
+		// adds a ScheduledController for each schedule of the file
+		// return: the number added, or -1 if there is no file
+		int Load(const char *path, const PlantCoeff *p);
+		int Count(){ return mCount; }
+		Controller *Get(int i){ return mTable[i]; }
+
+		// of the user interface
+		// return: -1 for a bad index
+		int Select(int i);
+		int Schedule(const int *index, const double *sec, int n);
+		void Print();
+
+		// of the sample loop
+		double Update(const ControlState *s);
+		int Current(){ return mCurrent; }
+
+	private:
+		Controller *mTable[CONTROLLER_MAX];
+		int mCount;
+
+		// the schedule asked for, written under mRequest, odd while written
+		volatile unsigned int mRequest;
+		unsigned int mTaken;
+		int mReqN;
+		int mReqIndex[CONTROLLER_SCHEDULE_MAX];
+		double mReqSec[CONTROLLER_SCHEDULE_MAX];
+
+		// the schedule running
+		int mN;
+		int mIndex[CONTROLLER_SCHEDULE_MAX];
+		double mSec[CONTROLLER_SCHEDULE_MAX];
+		int mStep;
+		double mElapsed;
+		int mCurrent;
+
+		void Switch(int step);
+};
+
+#endif // Controller_h
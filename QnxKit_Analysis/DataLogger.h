@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// Data Logger Class Definition
+//
+// Records the signals of the sample loop every cycle, at the full rate, into
+// a ring of records allocated, faulted in and locked by Init(), and writes
+// them to a binary file from a task of low priority, so an experiment sends
+// nothing over the network for them.  The loop calls Process() every cycle;
+// it only copies into the ring.
+//
+// DATA_LOG_ONCE records until the ring is full and then stops; with
+// background the task writes the records out while the loop goes on, so it
+// only fills if the disk falls behind.  DATA_LOG_RING keeps overwriting the
+// oldest record and is written out once it is stopped, the last seconds
+// before the stop.  Start() and Stop() are of the loop; the file is written
+// once a log stops, DATA_LOG_FILE with the number of the log, or the file
+// given to the constructor.  CAPTURE is a second one, of the inputs of the
+// loop, for SimIo::Replay() to play again, see Simulation.h.
+//
+// The file is a DataLogHeader, then the records: the cycle of the loop as a
+// uint32_t, 4 bytes of padding, and numCh doubles in the order of the
+// channels, little endian (x86).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef DataLogger_h
+#define DataLogger_h
+
+#include <inttypes.h>
+
+#include "AperiodicTask.h"
+
+class DataLogger;
+
+extern DataLogger	*DLOG;
+extern DataLogger	*CAPTURE;
+
+#define DATA_LOG_MAX_CH		16
+#define DATA_LOG_NAME_LEN	16
+#define DATA_LOG_MAGIC		0x31474c51	// "QLG1"
+#define DATA_LOG_CHUNK		1024	// records of one write in the background
+#define DATA_LOG_FILE		"/tmp/qnxkit_%03d.qlg"
+
+struct DataLogHeader{
+	uint32_t magic;
+	uint16_t numCh;
+	uint16_t mode;		// DATA_LOG_ONCE or DATA_LOG_RING
+	uint32_t records;	// in the file
+	uint32_t dropped;	// by a full ring
+	double period;		// s
+	char name[DATA_LOG_MAX_CH][DATA_LOG_NAME_LEN];
+};
+
+class DataLogger : public AperiodicTask{
+	public:
+		// file: a printf format of the number of the log
+		DataLogger(const char *file = DATA_LOG_FILE);
+		~DataLogger();
+
+		enum Mode{
+			DATA_LOG_OFF,
+			DATA_LOG_ONCE,
+			DATA_LOG_RING
+		};
+
+		// called in SampleLoopTask::Init()
+		void AddSignal(int ch, double *val, const char *name);
+		// after every AddSignal(); the ring holds seconds of the loop at rate
+		int Init(double rate, int priority, double seconds);
+
+		// of the loop
+		// return: 1, or -1 if not initialized or the last log is still being written
+		int Start(int mode, int background = 0);
+		void Stop();
+		void Process();
+
+		// of the user interface
+		int Recording() const { return mRecording; }
+		int Busy() const { return mRecording || mFlushing; }
+		void PrintStats();
+
+	private:
+		double *mpValPtrArr[DATA_LOG_MAX_CH];
+		const char *mName[DATA_LOG_MAX_CH];
+		int mNumCh;
+		double mPeriod;
+
+		// the ring of records, mRecordSize bytes each
+		char *mBuf;
+		int mRecordSize;
+		unsigned int mMask;
+		volatile unsigned int mHead;	// of the task, but of the loop in DATA_LOG_RING
+		volatile unsigned int mTail;	// of the loop
+		volatile unsigned int mDropped;
+
+		int mMode;
+		int mBackground;
+		uint32_t mN;	// cycles since Start()
+		volatile int mRecording;
+		volatile int mFlushing;	// stopped, the task has not closed the file yet
+
+		// of the task
+		int mFile;
+		const char *mFormat;
+		int mLogs;
+		uint32_t mWritten;
+		char mPath[64];
+
+		int WriteRecords(unsigned int head, unsigned int tail);
+		void Close();
+		void Task();
+};
+
+#endif // DataLogger_h
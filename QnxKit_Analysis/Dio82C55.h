@@ -3,6 +3,10 @@
 
 //#define Dio82C55_NUM_BITS	48
 
+// WriteAll() only writes the output ports whose Output changed since they
+// were last written: every write goes through a shadow of the port, and a
+// port configuration, which clears the outputs of the chip, invalidates it.
+
 class Dio82C55{
     public:
         // Constuctor
@@ -19,6 +23,8 @@ class Dio82C55{
 		int ReadPort(int port);
 		int WriteAll();
 		int WritePort(int port);
+		// high, then low, back to back; Output[port] is left at low
+		int PulsePort(int port, unsigned char high, unsigned char low);
 		
 		unsigned char *Input;
 		unsigned char *Output;
@@ -33,6 +39,9 @@ class Dio82C55{
 		unsigned int controlRegState;
 		
 		unsigned char mInitialized;
+
+		unsigned char mShadow[3];	// the values last written to the ports
+		unsigned char mShadowValid;	// a bit per port with mShadow written
 };
 
 #endif // Dio82C55_h
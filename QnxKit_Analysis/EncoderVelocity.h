@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////
+// Encoder Velocity Class Definition
+//
+// The velocity of an encoder from time stamped counts, instead of the count
+// difference of one sample period.  Every read gives Update() the count and
+// the ClockCycles() it was read at.  When the count has changed, the edge is
+// taken to be halfway between this read and the last one, and the velocity
+// is the counts since the anchor, the last edge used, over the time between
+// the two edges, once that is at least the window.  At speed this is the
+// finite difference over the exact read times; slowly it is the 1/T method,
+// one count over the time between edges, without the lag of a low pass.
+//
+// While the count stands still the speed can only be less than one more
+// count over the time since the anchor, so the velocity is bounded by that
+// and set to 0 after the timeout.  One division per read at most.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef EncoderVelocity_h
+#define EncoderVelocity_h
+
+#include <inttypes.h>
+
+class EncoderVelocity{
+	public:
+		EncoderVelocity();
+
+		// cps: ClockCycles() per second, window and timeout in s
+		void Init(uint64_t cps, double window, double timeout);
+
+		void Update(long count, uint64_t now);
+
+		// counts/s
+		double Velocity() const { return mVel; }
+
+	private:
+		uint64_t mCps;
+		uint64_t mWindow;
+		uint64_t mTimeout;
+
+		int mStarted;
+		long mLastCount;
+		uint64_t mLastRead;
+
+		long mAnchorCount;
+		uint64_t mAnchorTime;
+
+		double mVel;
+};
+
+#endif // EncoderVelocity_h
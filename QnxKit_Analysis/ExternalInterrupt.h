@@ -1,8 +1,27 @@
 #ifndef ExternalInterrupt_h
 #define ExternalInterrupt_h
 
+#include <semaphore.h>
+#include <inttypes.h>
+#include <pthread.h>
+
 #include "InterruptTask.h"
 
+class ExternalInterrupt;
+class SpscRing;
+
+extern ExternalInterrupt	*ExtInt;
+
+#define EXT_INT_RING_LEN		256	// time stamps, a power of two
+#define EXT_INT_REPORT_PRIORITY	10
+#define EXT_INT_REPORT_MS		100	// between two takes of the reporter
+
+// The interrupt thread does no more than stamp the interrupt with
+// ClockCycles(), clear it, put the stamp into a wait-free ring and wake the
+// consumers: in frame mode the thread in WaitEdge(), and the one given to
+// SetConsumer().  A reporter thread at EXT_INT_REPORT_PRIORITY takes the
+// stamps every EXT_INT_REPORT_MS for the intervals of PrintStats(); without
+// frame mode it also prints each interrupt, as the interrupt thread used to.
 class ExternalInterrupt : public InterruptTask{
     public:
         // Constuctor
@@ -10,12 +29,42 @@ class ExternalInterrupt : public InterruptTask{
         // Destructor
         ~ExternalInterrupt();
 
-		int Init(char *name, int priority, int intNum);
+		int Init(char *name, int priority, int intNum, int frameMode = 0);
+
+		// the interrupts so far; read before triggering the camera
+		unsigned int Edges(){ return mEdges; }
+		// sleeps until there was an interrupt after seen, at most timeout seconds
+		int WaitEdge(unsigned int seen, double timeout);
+
+		// func(arg) is called by the interrupt thread after every interrupt,
+		// so it must not block, e.g. a sem_post(); before Init()
+		void SetConsumer(void (*func)(void *), void *arg){ mConsumer = func; mConsumerArg = arg; }
+
+		// of the user interface
+		void PrintStats();
 
     private:
+		int mFrameMode;
+		volatile unsigned int mEdges;
+		sem_t mEdgeSem;
+
+		void (*mConsumer)(void *);
+		void *mConsumerArg;
+
+		// the interrupt thread puts, the reporter takes
+		SpscRing *mStamps;
+
+		// of the reporter only
+		uint64_t mCps;
+		uint64_t mLast;		// the stamp before
+		unsigned int mTaken;
+		uint64_t mMin, mMax, mSum;	// of the intervals, in cycles
+
+		pthread_t mReportThreadId;
+		static void *ReportThread(void *arg);
+		void Report();
+
 		void IntTask();
 };
 
 #endif // ExternalInterrupt_h
-
-
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// Frequency Sweep Class Definition
+//
+// Identifies the frequency response of the plant in the loop, one frequency
+// at a time, instead of from the logged data in MATLAB after the run.  Every
+// sample Update() takes the response y and returns the excitation, a sine of
+// the amplitude of the plan.  The frequency is rounded to a whole number of
+// samples per period, so the single bin DFT of the response over whole
+// periods has no leakage from its offset or the other harmonics; the
+// oscillator is rotated once per sample and restarts each period, so a
+// sample costs the same few multiplications whatever the frequency.
+//
+// The first FREQ_SWEEP_SETTLE periods of a frequency are not taken.  After
+// each period the gain and phase so far are compared with those of the
+// period before; when they changed by less than FREQ_SWEEP_TOL for
+// FREQ_SWEEP_STABLE periods in a row, or after FREQ_SWEEP_MAX_PERIODS, the
+// point is kept and the sweep goes to the next frequency.
+//
+// The loop is the only writer; a point is complete before Points() counts
+// it, so Print() can be called from the user interface at any time.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FreqSweep_h
+#define FreqSweep_h
+
+#define FREQ_SWEEP_MAX_POINTS	128
+#define FREQ_SWEEP_SETTLE		4
+#define FREQ_SWEEP_MIN_PERIODS	4
+#define FREQ_SWEEP_MAX_PERIODS	200
+#define FREQ_SWEEP_STABLE		3
+#define FREQ_SWEEP_TOL			0.005	// of the gain, the change of the estimate
+
+class FreqSweep{
+	public:
+		typedef struct{
+			double f0;		// Hz, the first frequency
+			double f1;		// Hz, the last
+			double step;	// Hz
+			double amp;		// of the excitation
+		}Plan;
+
+		typedef struct{
+			double freq;	// Hz, as rounded
+			double gain;	// of y to the excitation
+			double phase;	// rad
+			int periods;	// taken
+		}Point;
+
+		FreqSweep();
+
+		// rate: of the calls to Update(), in Hz
+		// return: 1, or -1 if the plan has no frequency below rate/2
+		int Start(const Plan &plan, double rate);
+		void Stop(){ mActive = 0; }
+		int Active() const { return mActive; }
+
+		// of the loop, every sample
+		// return: the excitation for this sample, 0 when not active
+		double Update(double y);
+
+		// the estimate so far of the frequency being identified
+		double Freq() const { return mFreq; }
+		double Gain() const { return mGain; }
+		double Phase() const { return mPhase; }
+
+		int Points() const { return mPoints; }
+		const Point &Result(int i) const { return mResult[i]; }
+		void Print() const;
+
+	private:
+		Plan mPlan;
+		double mRate;
+		volatile int mActive;
+		double mNext;		// Hz, the frequency of the plan after this one
+
+		// the frequency being identified
+		int mN;				// samples per period
+		double mCw, mSw;	// the rotation of one sample
+		double mC, mS;		// the oscillator, cos and sin of the sample
+		int mK;				// the sample of the period
+		int mPeriods;		// since the frequency started
+		int mStable;
+		double mSumS, mSumC;	// of y times the oscillator, over the periods taken
+		double mFreq, mGain, mPhase;
+
+		Point mResult[FREQ_SWEEP_MAX_POINTS];
+		volatile int mPoints;
+
+		int Begin(double freq);
+		void EndPeriod();
+};
+
+#endif // FreqSweep_h
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// I/O Benchmark Class Definition
+//
+// The cost of every access to the boards, which sets how short the period of
+// the SampleLoop can be.  PrintInputTiming() only gives the last, mean and
+// longest read of a device within ProcessInput(); IoBench times each driver
+// call on its own, an encoder read of the Msi_P402, a conversion of the
+// Msi_P41x, a DAC write of the Ruby_MM_x12 and a port access of a Dio82C55,
+// and each IoHardware call the SampleLoop makes in a cycle, with the input
+// plan of its axes, up to the I/O of a whole cycle.  Every case is run n
+// times back to back with ClockCycles() around it; the samples are sorted
+// for the percentiles, so the tail is exact, not the top of a bin.
+//
+// The cases only write what the loop would with the motor off: the motor
+// enable stays off, the amplifier signal 0 V, and the camera trigger and the
+// LED of LatencyProbe.h pulse as they would.  Write() appends the results to
+// a file under a label, one block per build of the drivers, to compare them.
+// Built with make bench, see BenchMain.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef IoBench_h
+#define IoBench_h
+
+#include <inttypes.h>
+
+#include "IoHardware.h"
+
+#define IO_BENCH_CASES			24
+#define IO_BENCH_RUNS			10000	// samples of every case, unless given
+#define IO_BENCH_WARMUP			100		// runs of every case not counted
+#define IO_BENCH_FILE			"io_bench.txt"
+
+class IoBench{
+	public:
+		IoBench();
+		~IoBench();
+
+		// hw: initialized; rate: of the SampleLoop, for the share of its period
+		void Init(IoHardware *hw, double rate);
+
+		// n samples of every case; return: -1 if they cannot be kept
+		int Run(int n);
+
+		void Print(const char *label);
+		// return: -1 if the file cannot be written
+		int Write(const char *path, const char *label);
+
+	private:
+		typedef uint64_t (IoBench::*Case)();
+
+		struct Result{
+			const char *name;
+			const char *group;	// "driver" or "loop"
+			Case run;
+			int planned;		// 1: run with the input plan of the loop
+			uint64_t *cycles;	// of every sample, sorted after Run()
+			int n;
+			uint64_t sum;
+		};
+
+		IoHardware *mHw;
+		uint64_t mCps;
+		double mRate;
+		uint64_t mOverhead;	// of ClockCycles() itself, taken off every sample
+		Result mCase[IO_BENCH_CASES];
+		int mCases;
+
+		void Add(const char *group, const char *name, Case run, int planned);
+		void Sample(Result *r, int n);
+		void Plan();
+		double Us(uint64_t cycles){ return cycles * 1.e6 / mCps; }
+		double Percentile(const Result *r, double p);
+		static int Compare(const void *a, const void *b);
+
+		// the driver calls
+		uint64_t ClockOnly();
+		uint64_t EncoderCh();
+		uint64_t EncoderAll();
+		uint64_t AnalogStart();
+		uint64_t AnalogRead();
+		uint64_t DacCh();
+		uint64_t DacChs();
+		uint64_t DioReadPort();
+		uint64_t DioWritePort();
+		uint64_t DioPulsePort();
+
+		// the IoHardware calls of SampleLoopTask::Cycle()
+		uint64_t InputAll();
+		uint64_t InputPlanned();
+		uint64_t FrameStatus();
+		uint64_t Trigger();
+		uint64_t Encoders();
+		uint64_t Markers();
+		uint64_t Amplifier();
+		uint64_t Led();
+		uint64_t Output();
+		uint64_t CycleIo();
+};
+
+#endif // IoBench_h
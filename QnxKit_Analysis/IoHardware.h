@@ -10,8 +10,43 @@
 * you can define meaningful pin names. There are also functions		*
 * that process all inputs/outputs in bulk and store the readings	*
 * in arrays.														*
+*																	*
+* ProcessInput() follows an input plan: once any input has been		*
+* added with the Plan...() functions, only the planned digital		*
+* ports, encoders and analog channels are read, and only the		*
+* planned ports are debounced.  With nothing planned everything is	*
+* read, as before.  The digital and encoder reads are done while	*
+* the analog conversions run, and the read time of every device is	*
+* measured.															*
+*																	*
+* The debounce runs on all the ports at once: their bits are packed	*
+* into 64 bit words, bit b of DigitalInputBit b, and a 3 bit		*
+* vertical counter per bit takes a few logic operations per word,	*
+* however many ports there are.  A bit takes the input after it		*
+* differed 8 reads in a row; the edges of the last debounce are		*
+* kept as masks, see GetDebouncedEdges().							*
+*																	*
+* Every encoder read also goes to the velocity estimator of its		*
+* channel, see EncoderVelocity.h and GetEncoderVelocity().			*
+*																	*
+* An analog channel given to OversampleAnalogInput() is converted	*
+* n times back to back at every read, of ProcessInput() and of		*
+* ReadAnalogCh(s)(), and its value is the mean: the counts are		*
+* summed in integers and the sum is scaled once, an integrate and	*
+* dump decimator.  The samples are of the read itself, so the lag	*
+* is half the burst, n conversion times, not the periods of a		*
+* filter across cycles; the noise drops by sqrt(n).  The bank		*
+* channel is oversampled, so the channel 8 apart is as well.		*
+*																	*
+* The functions the SampleLoop uses are virtual, and Cycles() is	*
+* its clock, so the plant model of Simulation.h can stand in for	*
+* the boards.														*
 ********************************************************************/
 
+#include <inttypes.h>
+
+#include "EncoderVelocity.h"
+
 class Dio82C55;
 class Msi_P41x;
 class Msi_P402;
@@ -22,6 +57,12 @@ extern IoHardware *HW;
 
 #define NUM_DIGITAL_PORTS 9 // Number of digial IO ports.  6 ch on the DIO borad. 3 ch on the Analog OUT board.
 #define NUM_DIGITAL_BITS (NUM_DIGITAL_PORTS * 8) // Each channel (port) is 8 bits.
+#define DEBOUNCE_WORDS ((NUM_DIGITAL_BITS + 63) / 64) // the debounce packs 8 ports a word
+#define NUM_ENCODER_CHANNELS 8
+#define NUM_BANK_CHANNELS 8 // analog channels per bank, the banks convert in parallel
+#define ANALOG_OVERSAMPLE_MAX 16 // conversions of one read of an oversampled channel
+#define ENC_VEL_WINDOW	0.004 // s, the shortest time an encoder velocity is measured over
+#define ENC_VEL_TIMEOUT	0.1 // s, an encoder without an edge for this long stands still
 
 
 class IoHardware{
@@ -29,7 +70,7 @@ class IoHardware{
 		// Constuctor
 		IoHardware();
 		// Destructor
-		~IoHardware();
+		virtual ~IoHardware();
 		
 		// Digital Output pin names
 		enum DigitalOutputBit{
@@ -51,8 +92,9 @@ class IoHardware{
 			//DOUT_48 = 48,
 			//DOUT_49 = 49 // added by Ji-Chul 
 			MOTOR_ENABLE = 48, // enables motor (IN1 of amp)
-			CAMERA_TRIGGER = 49 // triggers camera to take a picture
+			CAMERA_TRIGGER = 49, // triggers camera to take a picture
 								 // changed by Ji-Chul because the DIO board is not working. 4/1/2013
+			LATENCY_LED = 50 // the LED in the view of the camera, see LatencyProbe.h
 		};
 
 		// Digital Input pin names
@@ -106,7 +148,16 @@ class IoHardware{
 			AIN_4 = 4,
 			AIN_5 = 5,
 			AIN_6 = 6,
-			AIN_7 = 7
+			AIN_7 = 7,
+			// the second bank, converted with the channel 8 below
+			AIN_8 = 8,
+			AIN_9 = 9,
+			AIN_10 = 10,
+			AIN_11 = 11,
+			AIN_12 = 12,
+			AIN_13 = 13,
+			AIN_14 = 14,
+			AIN_15 = 15
 		};
 
 		// Encoder Inputs
@@ -122,19 +173,45 @@ class IoHardware{
 		};
 
 		int Init();
-		int ProcessInput();
-		int ProcessOutput();
+		virtual int ProcessInput();
+		virtual int ProcessOutput();
+
+		// the clock of the SampleLoop: ClockCycles()
+		virtual uint64_t Cycles();
+
+		// the input plan of ProcessInput()
+		void PlanDigitalInput(DigitalInputBit bit); // the whole port of bit
+		void PlanEncoder(EncoderInputCh ch);
+		void PlanAnalogInput(AnalogInputCh ch);
+		// n conversions averaged at every read of ch, 1 for one
+		void OversampleAnalogInput(AnalogInputCh ch, int n);
+
+		// the read time of every input device in ProcessInput()
+		enum InputDevice{
+			DEV_DIO_1 = 0,
+			DEV_DIO_2,
+			DEV_DIO_3,
+			DEV_ENCODER,
+			DEV_ANALOG_IN,
+			NUM_INPUT_DEVICES
+		};
+		void PrintInputTiming();
 		
 		typedef enum{RISING_EDGE, FALLING_EDGE}edgeType;
 
-		void SetAnalogOut(AnalogOutputCh ch, double val);
+		virtual void SetAnalogOut(AnalogOutputCh ch, double val);
 		int IsDigitalInputBit(DigitalInputBit bit);
 		int GetDigitalInBit(DigitalInputBit bit);
 		int GetDebouncedDigitalInBit(DigitalInputBit bit);
 		int GetDebouncedDigitalInBit(DigitalInputBit bit, edgeType edge);
+		unsigned char GetDebouncedEdges(int port, edgeType edge); // a bit per bit of the port
 		void SetDigitalOutBit(DigitalOutputBit bit, int state);
-		int GetEncoderCount(EncoderInputCh ch);
+		virtual int GetEncoderCount(EncoderInputCh ch);
+		virtual double GetEncoderVelocity(EncoderInputCh ch); // counts/s, as of the last read
 		double GetAnalogIn(AnalogInputCh ch);
+		// GetAnalogIn() as zeroUnits + volts * unitsPerVolt, 1 and 0 until calibrated
+		void CalibrateAnalogIn(AnalogInputCh ch, double unitsPerVolt, double zeroUnits);
+		double GetCalibratedAnalogIn(AnalogInputCh ch);
 		void AnalogInAvgStart(AnalogInputCh ch);
 		double AnalogInAvgGet();
 
@@ -149,11 +226,18 @@ class IoHardware{
 		void ClearExternalInterrupt();
 		
 		// Philip's I/O functions
-		int WriteDigitalBit(DigitalOutputBit bit, int state);
-		int ReadDigitalBit(DigitalInputBit bit);
-		void WriteAnalogCh(AnalogOutputCh ch, double val);
+		virtual int WriteDigitalBit(DigitalOutputBit bit, int state);
+		virtual int PulseDigitalBit(DigitalOutputBit bit); // high and low again, two port writes
+		virtual int ReadDigitalBit(DigitalInputBit bit);
+		virtual void WriteAnalogCh(AnalogOutputCh ch, double val);
 		double ReadAnalogCh(AnalogInputCh ch);
-		int ReadEncoder(EncoderInputCh ch);
+		// ReadAnalogCh() of n channels, one conversion per bank channel of them,
+		// for the values of GetAnalogIn()
+		void ReadAnalogChs(const AnalogInputCh *ch, int n);
+		virtual int ReadEncoder(EncoderInputCh ch);
+		// a batch: n encoders read at one time stamp, n outputs updated at once
+		virtual void ReadEncoders(const EncoderInputCh *ch, int n, int *count);
+		virtual void WriteAnalogChs(const AnalogOutputCh *ch, const double *val, int n);
 
 		int motorStatus;
 
@@ -168,15 +252,45 @@ class IoHardware{
 
 		Msi_P41x		*AnalogInBoard;   // P414 (16 ch board with input buffers)
 
-		void Debounce(int port);
+		void Debounce(const uint64_t *mask);
+		static void PortMask(uint64_t *mask, int port);
 		void AnalogInAvgProcess();
 
+		int mPlanned;
+		unsigned char mPlanPort[NUM_DIGITAL_PORTS];
+		unsigned char mPlanEncoder[NUM_ENCODER_CHANNELS];
+		EncoderVelocity mEncoderVel[NUM_ENCODER_CHANNELS];
+		unsigned char mPlanBankCh[NUM_BANK_CHANNELS];
+		unsigned char mOversample[NUM_BANK_CHANNELS]; // conversions per read
+		int Oversample(int bankCh);
+		double mAnalogScale[NUM_ANALOG_CHANNELS];
+		double mAnalogZero[NUM_ANALOG_CHANNELS];
+
+		int ReadInputDevice(int dev);
+
+		// times the boards one driver call at a time
+		friend class IoBench;
+
+		// in ClockCycles()
+		typedef struct{
+			uint64_t last;
+			uint64_t max;
+			uint64_t sum;
+			unsigned int n;
+		}inputTiming;
+		inputTiming mTiming[NUM_INPUT_DEVICES];
+		uint64_t mCps;
+		void AddTiming(int dev, uint64_t cycles);
+
 		int port;
 		int portBit;
 		int ch;
-		unsigned char debouncedDigitalIn[NUM_DIGITAL_PORTS];
-		unsigned char debouncedDigitalInPrev[NUM_DIGITAL_PORTS];
-		unsigned char debouncedDigitalInDiff[NUM_DIGITAL_PORTS];
+		// the debounce, bit b of DigitalInputBit b
+		uint64_t debounceA[DEBOUNCE_WORDS], debounceB[DEBOUNCE_WORDS], debounceC[DEBOUNCE_WORDS];
+		uint64_t debouncedDigitalIn[DEBOUNCE_WORDS];
+		uint64_t debouncedRising[DEBOUNCE_WORDS];
+		uint64_t debouncedFalling[DEBOUNCE_WORDS];
+		int DebouncedBit(const uint64_t *words, int bit){ return (int)((words[bit / 64] >> (bit % 64)) & 0x1); }
 		unsigned int avgCnt;
 		double avgVal;
 		AnalogInputCh avgCh;
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// Latency Probe Class Definition
+//
+// The latency of the whole chain, from the light of the scene to the output
+// of the amplifier.  The loop lights an LED in the view of the camera with
+// LATENCY_LED, a spare output of the digital boards, and the vision PC
+// echoes every frame whether it sees it, as the x of ROI LATENCY_PROBE_ROI
+// (echo_x and echo_y of its opti.cfg).  The round trip runs through all of
+// it: the rest of the exposure, the readout and the blob search of the
+// camera, the frame loop, the network, VisionNet and the loop up to the
+// first amplifier write after the echo.
+//
+// Each trial waits for LATENCY_PROBE_SETTLE echoes of the LED off, then
+// lights it after the frame of the cycle, so the next trigger exposes it
+// and the wait for that trigger, up to a period, is in every trial alike.
+// The time from then to the Recv() that has the echo, and to the amplifier
+// write of that cycle, go into histograms of LATENCY_PROBE_BIN_US bins; a
+// trial without an echo in LATENCY_PROBE_TIMEOUT_SEC is counted and the LED
+// goes off.
+//
+// The loop writes the probe, but Actuated() of the inner loop when it runs
+// on a thread of its own, which only takes the time of the write the loop
+// asked for; the histograms have a single writer, and Print() and Write()
+// of the user interface only read.  Write() appends the histograms to a file
+// under a label, one block per configuration, to compare them.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LatencyProbe_h
+#define LatencyProbe_h
+
+#include <inttypes.h>
+
+#include "VisionNet.h"
+
+#define LATENCY_PROBE_ROI			(VISION_NET_NUM_ROI - 1)	// the echo of the vision PC
+#define LATENCY_PROBE_BIN_US		250
+#define LATENCY_PROBE_BINS			200		// up to 50 ms, the rest in the last bin
+#define LATENCY_PROBE_SETTLE		4		// echoes of the LED off before the next trial
+#define LATENCY_PROBE_TIMEOUT_SEC	0.5
+#define LATENCY_PROBE_FILE			"latency.txt"
+
+class LatencyProbe{
+	public:
+		LatencyProbe();
+
+		// cps: ClockCycles() per second
+		void Init(uint64_t cps);
+
+		// of the loop: n trials from now on, the histograms cleared; 0 stops
+		// return: the LED state to write, 0
+		int Start(int n);
+		int Active(){ return mState != PROBE_IDLE; }
+
+		// of the loop, every cycle after VNET->Recv(); fresh, echo: of
+		// LATENCY_PROBE_ROI, cycle: of the setpoint the cycle writes
+		// return: the LED state to write, -1 to leave it
+		int Cycle(int fresh, double echo, unsigned int cycle, uint64_t now);
+
+		// of the inner loop, at the amplifier write of the setpoint of cycle
+		void Actuated(unsigned int cycle, uint64_t now);
+
+		void Print(const char *label);
+		// return: -1 if the file cannot be written
+		int Write(const char *path, const char *label);
+
+	private:
+		enum{PROBE_IDLE, PROBE_OFF, PROBE_ON, PROBE_SEEN};
+
+		struct Hist{
+			unsigned int bin[LATENCY_PROBE_BINS];
+			unsigned int n;
+			uint64_t minUs, maxUs, sumUs;
+		};
+
+		uint64_t mCps;
+		int mState;
+		int mLeft;			// trials to start
+		unsigned int mTrials;
+		unsigned int mTimeouts;
+		int mOffEchoes;		// of the LED off, in a row
+		uint64_t mSince;	// when the LED went on or off
+		unsigned int mSeenCycle;
+		volatile int mArmed;	// of the loop, cleared by Actuated()
+		volatile uint64_t mActuatedAt;
+		Hist mRx, mAct;
+
+		void Add(Hist *h, uint64_t cycles);
+		static void Clear(Hist *h);
+		static unsigned int Percentile(const Hist *h, double p);
+		uint64_t Us(uint64_t cycles){ return cycles * 1000000 / mCps; }
+};
+
+#endif // LatencyProbe_h
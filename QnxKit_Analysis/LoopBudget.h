@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// Loop Budget Class Definition
+//
+// The time each stage of a periodic loop takes, against a budget given as a
+// share of the period.  The loop calls Start() when it is released, Mark()
+// at the end of every stage and End() when the cycle is done; Print() shows
+// the mean and worst time of each stage, how often it went over its budget,
+// and the rate the worst cycle would still allow, so it can be seen which
+// stage keeps the loop from running faster.
+//
+// The loop is the only writer and commits a cycle under mSeq, so Print()
+// can be called from the user interface at any time.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LoopBudget_h
+#define LoopBudget_h
+
+#include <inttypes.h>
+
+#define LOOP_BUDGET_STAGES	8
+
+class LoopBudget{
+	public:
+		LoopBudget();
+
+		// cps: ClockCycles() per second, rate: of the loop, in Hz
+		void Init(uint64_t cps, double rate);
+
+		// budget: the share of the period the stage may take
+		// return: the stage, or -1 if there are LOOP_BUDGET_STAGES already
+		int AddStage(const char *name, double budget);
+
+		// of the loop, with ClockCycles()
+		void Start(uint64_t now);
+		void Mark(int stage, uint64_t now);
+		void End();
+
+		void Print(const char *name);
+
+	private:
+		struct Stage{
+			const char *name;
+			uint64_t budget;
+			uint64_t sum;
+			uint64_t max;
+			unsigned int over;
+		};
+
+		uint64_t mCps;
+		uint64_t mPeriod;
+		int mNumStages;
+		Stage mStage[LOOP_BUDGET_STAGES];
+
+		// of the cycle running
+		uint64_t mStart, mLast;
+		uint64_t mCycle[LOOP_BUDGET_STAGES];
+
+		// committed under mSeq
+		volatile unsigned int mSeq;	// odd while a cycle is committed
+		unsigned int mCycles;
+		uint64_t mCycleSum, mCycleMax;
+
+		double Us(uint64_t cycles){ return cycles * 1.e6 / mCps; }
+};
+
+#endif // LoopBudget_h
@@ -3,15 +3,45 @@
 
 #include <sys/types.h>
 #include <netinet/in.h>
+#include <inttypes.h>
 #include "AperiodicTask.h"
 
-class FifoQ;
+class SpscRing;
 class MatlabNet;
 
 extern MatlabNet 	*MNET;
 
-#define MATLAB_NET_NUM_CH	4
+#define MATLAB_NET_MAX_CH	16
+#define MATLAB_NET_NUM_CH	4	// the channels of the older SampleLoopTask variants
+#define MATLAB_NET_RING_LEN	256	// samples queued for the task, a power of two
+#define MATLAB_NET_FRAME	64	// samples per frame, one send each
+#define MATLAB_NET_MAGIC	0x31544b51	// "QKT1"
+#define MATLAB_NET_MAX_CLIENTS	4	// subscribers at a time
+#define MATLAB_NET_BACKLOG	16	// frames kept for the subscribers, a power of two
+
+// The samples are streamed in binary frames, little endian (x86):
+// a MatlabNetHeader, then numSamples samples of numCh float32 each, in the
+// order of the channels.  The samples of a frame are evenly spaced by period;
+// first counts the samples at the decimated rate, so a gap from the last
+// frame is samples dropped because the task was behind.
+struct MatlabNetHeader{
+	uint32_t magic;
+	uint16_t numCh;
+	uint16_t numSamples;
+	uint32_t first;
+	float period;	// s
+};
 
+// Several subscribers, a live plotter, a logger and a tuning GUI, may be
+// connected at once and all get the same frames.  The task takes the
+// samples from the ring of the loop and builds each frame once, into a
+// backlog of the last MATLAB_NET_BACKLOG frames, and each subscriber has a
+// cursor into it: the frame it is sending and how much of it is sent.  The
+// sockets are non-blocking, so a subscriber that stalls only falls behind;
+// once the frame at its cursor is overwritten it is closed, and the others
+// and the loop never wait for it.  A new subscriber starts at the next
+// frame.  The loop only queues samples while a subscriber is connected; it
+// triggers the task every frame either way, for the task to accept.
 class MatlabNet : public AperiodicTask{
     public:
         // Constuctor
@@ -19,28 +49,61 @@ class MatlabNet : public AperiodicTask{
         // Destructor
         ~MatlabNet();
 		
-		int Init(double rate, int priority);
+		// after every AddSignal(); every decimation-th control cycle is sent
+		int Init(double rate, int priority, int decimation = 1);
 		void Process();
 		void AddSignal(int ch, double *val);
 
+		void PrintStats();
+
     private:
 		double mSampleRate;
-		FifoQ *mpFifo;
-
-		unsigned char mBuf[MATLAB_NET_NUM_CH*8];
-
-		double *mpValPtrArr[MATLAB_NET_NUM_CH];
-		double mpValBuf[MATLAB_NET_NUM_CH];
+		int mDecimation;
+		int mNumCh;
+
+		// the control loop puts, the task takes; neither waits
+		SpscRing *mpRing;
+		uint32_t mIndex;	// of the next sample put
+
+		double *mpValPtrArr[MATLAB_NET_MAX_CH];
+
+		// a ring object: the index, then the channels
+		struct Sample{
+			uint32_t index;
+			float val[MATLAB_NET_MAX_CH];
+		};
+		Sample mSample;
+		int mSampleSize;
+
+		// of the task: the frames built, frame k at k % MATLAB_NET_BACKLOG
+		struct Frame{
+			unsigned char data[sizeof(MatlabNetHeader) + MATLAB_NET_FRAME*MATLAB_NET_MAX_CH*4];
+			int bytes;
+		} mBacklog[MATLAB_NET_BACKLOG];
+		uint32_t mFrames;	// built, the one being filled is mFrames
+		int mFrameN;		// samples in it
+
+		// of the task
+		struct Client{
+			int socket;			// -1 for a free one
+			struct sockaddr_in addr;
+			uint32_t frame;		// the frame being sent
+			int sent;			// bytes of it
+		} mClient[MATLAB_NET_MAX_CLIENTS];
+		unsigned int mAccepted, mSlow;
 
 		int mInitialized;
 
 		// TCP/IP
 		int mSocket;
-		int mSessionSocket;
 		struct sockaddr_in mServerAddr;
-		unsigned char validSession;
+		volatile int mSubscribers;	// of the task, read by the loop
 
 		int TcpIpInit();
+		void EndFrame();
+		void Accept();
+		int Send(Client *c);
+		void Close(Client *c, const char *why);
 
 		// Task function
 		void Task();
@@ -52,5 +115,3 @@ class MatlabNet : public AperiodicTask{
 };
 
 #endif // MatlabNet_h
-
-
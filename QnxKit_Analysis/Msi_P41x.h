@@ -2,6 +2,7 @@
 #define Msi_P41x_h
 
 //#define MSI_P412_CH	16
+#define MSI_P41X_MAX_CH	32 // the channels of a P412, four banks
 
 class Msi_P41x{
     public:
@@ -17,10 +18,13 @@ class Msi_P41x{
 		int ConfigChannel(int ch, ChannelRange range);
 		int StartConv(int bankChannel);
 		int ReadBankChannel(int bankChannel);
+		// counts of channel ch in volts in its range, for a sum of counts too
+		double Volts(int ch, double counts);
 
 		unsigned char *ChannelConfig;
 
 		double *Input;
+		int RawInput[MSI_P41X_MAX_CH]; // of the last conversion, counts, signed in a bipolar range
 
     private:
 		int Initialized;
@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// Object Pose Class Definition
+//
+// The position and orientation of the object from the markers (ROIs) the
+// vision PC tracks on it.  The layout of the markers on the object is learned
+// from the first frames where all of them are fresh: the body frame has its
+// origin at their centroid and its x axis from marker 0 to marker 1, so with
+// two markers the pose is their midpoint and the angle of the line between
+// them, as the loop always had it.
+//
+// Each cycle Fit() takes the least squares rotation and translation of the
+// layout onto the markers found, weighted 1/(1 + age) by the cycles since
+// each sample; a marker older than maxAge is left out, and two markers are
+// enough.  More markers average out the noise of each at the same rate.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ObjectPose_h
+#define ObjectPose_h
+
+#define OBJECT_MAX_MARKERS	8
+
+class ObjectPose{
+	public:
+		// the newest sample of a marker; age: Recv() cycles since it, or
+		// more than maxAge if it was never seen
+		typedef struct {
+			double x, y;
+			int age;
+		}Sample;
+
+		ObjectPose();
+
+		// layoutFrames: the frames with all markers fresh the layout is the mean of
+		// return: -1 if markers is not 2 to OBJECT_MAX_MARKERS
+		int Init(int markers, int layoutFrames, int maxAge);
+
+		// theta: within -pi to pi, in the units of the samples for x, y
+		// return: the markers used, or -1 if too few or no layout yet
+		int Fit(const Sample *marker, double *x, double *y, double *theta);
+
+		int Learned() const { return mLayoutN >= mLayoutFrames; }
+		void Print();
+
+	private:
+		int mMarkers;
+		int mLayoutFrames;
+		int mMaxAge;
+
+		// the markers in the body frame, the mean of mLayoutN frames
+		double mBodyX[OBJECT_MAX_MARKERS];
+		double mBodyY[OBJECT_MAX_MARKERS];
+		int mLayoutN;
+
+		// since Init()
+		unsigned int mFits;
+		unsigned int mPartial;	// fits with a marker left out
+		unsigned int mFailed;
+		double mResidual;		// rms of the last fit
+		double mResidualMax;
+
+		void Learn(const Sample *marker);
+};
+
+#endif // ObjectPose_h
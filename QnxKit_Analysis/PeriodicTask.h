@@ -10,7 +10,17 @@
 // thread.  The control thread is triggered by the timer and controls the
 // execution of the task thread through a semaphore.  The mOverRun counter
 // is incremented every time the task thread is not ready to run
-// when the timer pulse comes in.
+// when the timer pulse comes in.  mMonitor keeps the timing statistics of
+// every release, see TaskMonitor.h; PrintTiming() prints them.
+//
+// The ThreadOptions given to Init() are those of the task thread; the timer
+// control thread only takes the same runmask, so both stay on one CPU.
+//
+// With direct, Init() starts the task thread only, at priority, and TimerWait()
+// receives the timer pulses itself: one wakeup a period instead of two and a
+// semaphore handoff.  The kernel queues every pulse, so the pulses still
+// pending once one is received are the periods the task missed; each counts
+// as an overrun and is dropped, as the control thread drops them.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -21,6 +31,9 @@
 #include <semaphore.h>
 #include <pthread.h>
 
+#include "TaskMonitor.h"
+#include "Qnx.h"
+
 class PeriodicTask{
     public:
         // Constuctor
@@ -28,12 +41,16 @@ class PeriodicTask{
         // Destructor
         ~PeriodicTask();
 
-		  int Init(char *name, double rate, double *actual_rate, int priority);
+		  int Init(char *name, double rate, double *actual_rate, int priority, const ThreadOptions *opt = NULL, int direct = 0);
 
 		  int mOverRun;
+		  TaskMonitor mMonitor;
+
+		  void PrintTiming(){ mMonitor.Print(mTaskName); }
 
     private:
 		unsigned char mRunning;
+		int mDirect;
 
 		sem_t mTimerSemaphore;
 
@@ -48,6 +65,7 @@ class PeriodicTask{
 		int InitTimer(int priority, double rate, double *actual_rate);
 		static void *TimerControlThread(void *arg);
 		static void *TimerThread(void *arg);
+		int PulseWait();
 
 		virtual void Task()=0;
 
@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+// Plant Constants
+//
+// The hand, the object on it and where the camera sees them; of both the
+// SampleLoop and the plant model of the simulation, see Simulation.h.  In the
+// coordinates (handTheta, sh) the inertia of the hand and the object is
+// [M11 M12; M12 M22], with no velocity terms, and the gravity of the tilted
+// table pulls on sh with COEFF_sig1*sin(eta2).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef Plant_h
+#define Plant_h
+
+#include <math.h>
+
+#include "motor.h" // INERTIA_MOTOR
+
+const double M_H = 0.4745; // mass of the hand
+const double M_O = 0.142; //0.1503; //0.142; // mass of the object
+const double RHO_H = 0.15; //0.15; // radius of the hand disk
+const double RHO_HI = 0.0095; // inner radius of the hand
+const double RHO_O = 0.081; //0.08// radius of the object disk
+const double GRAV = 9.8 * sin(3.142592/180*77.6); //85.2 //81.9); //45.8); // gravitational acceleration
+const double K_R = (1.0/RHO_H + 1.0/RHO_O);
+const double I_H = 0.5 * M_H * (RHO_H*RHO_H + RHO_HI*RHO_HI) + INERTIA_MOTOR;
+const double I_O = 0.5 * M_O * RHO_O*RHO_O;
+const double M11 = I_H + M_O*(RHO_H+RHO_O)*(RHO_H+RHO_O) + I_O;
+const double M12 = M_O*(RHO_H+RHO_O)*(RHO_H+RHO_O)/RHO_H + I_O*K_R;
+const double M22 = K_R*K_R*(M_O*RHO_O*RHO_O + I_O);
+// naming changes according to the notation used in my paper.
+const double COEFF_sig1 = M_O*GRAV*(RHO_H+RHO_O)/RHO_H;
+const double COEFF_sig2 = 1/(RHO_H*M22);
+const double COEFF_sig3 = 1 - M12/(RHO_H*M22);
+const double INV_K_R = 1.0/K_R;
+const double INV_RHO_HO = 1.0/(RHO_H+RHO_O);
+
+// hard-coding for eq. point
+//const double OBJ_X_OFFSET = 0.0827712; // + (RHO_H+RHO_O)*0.00354; //0.00262; //*0.00301 //0.0848480; // in m
+//const double OBJ_Y_OFFSET = -0.0894877;  // in m. currently not use this.
+const double OBJ_X_OFFSET = 0.0783; // in m. It may be better to get this value from constant speed control
+const double OBJ_Y_OFFSET = 0.03346; // in m. currently not use this.
+
+#endif // Plant_h
@@ -1,7 +1,36 @@
+#ifndef Qnx_h
+#define Qnx_h
+
 #include <stdio.h>
 #include <errno.h>
+#include <stddef.h>
 #include <pthread.h>
 #include <sys/neutrino.h>
 
+// What a real-time thread needs beyond its priority; a 0 field is the default.
+// The runmask and the pre-faulting are done by the new thread itself before
+// func runs, so with LockMemory() the stack it touched stays resident.
+typedef struct{
+	size_t stackSize;		// bytes
+	size_t prefault;		// bytes of the stack touched, less than stackSize
+	unsigned int runmask;	// the CPUs it may run on, bit 0 for CPU 0
+}ThreadOptions;
+
 int InitThread(pthread_t *threadId, int prio, void *(*func)(void *), void *param);
+int InitThread(pthread_t *threadId, int prio, void *(*func)(void *), void *param, const ThreadOptions *opt);
+
+// the options of the threads created without any, e.g. keeping them off the
+// CPU of the control loop
+void SetThreadDefaults(const ThreadOptions *opt);
+
+// of the calling thread
+int PinThread(unsigned int runmask);
+
+// locks all the present and future pages of the process
+int LockMemory();
+
+// the runmask of one CPU, or 0 if there is no such CPU
+unsigned int CpuMask(int cpu);
+unsigned int AllCpus();
 
+#endif // Qnx_h
@@ -0,0 +1,7 @@
+#ifndef RtLog_h
+#define RtLog_h
+
+// the console messages of the loops are shared with TDah and HSV-Base
+#include "../TDah/include/RtLog.h"
+
+#endif // RtLog_h
@@ -3,6 +3,11 @@
 
 #define DACBOARD_CH	8
 
+// WriteAll() only loads the channels whose count changed since they were
+// last written, and strobes the update only if it loaded any.  WriteChs()
+// loads the channels of a mask and updates them with one strobe, so they
+// change together.
+
 class Ruby_MM_x12{
     public:
         // Constuctor
@@ -13,6 +18,7 @@ class Ruby_MM_x12{
 		int Init(int base);
 		int WriteAll();
 		int WriteCh(int ch);
+		int WriteChs(unsigned int mask); // bit ch for channel ch
 		void Reset();
 
 		double Output[DACBOARD_CH];
@@ -23,7 +29,11 @@ class Ruby_MM_x12{
 		int mCount;
 		unsigned int mInitialized;
 
+		int mWritten[DACBOARD_CH];	// the count last loaded, -1 for none
+
 		void Limit(int);
+		int Count(int ch);
+		void Load(int ch, int count);
 };
 
 #endif // Ruby_MM_x12_h
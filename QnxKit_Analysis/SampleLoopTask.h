@@ -6,8 +6,21 @@
 #include <sys/syspage.h>
 
 #include "PeriodicTask.h"
+#include "Controller.h"
+#include "LoopBudget.h"
+#include "ObjectPose.h"
+#include "VisionNet.h"
+#include "SpscRing.h"
+#include "SeqBox.h"
+#include "FreqSweep.h"
+#include "Axis.h"
+#include "LatencyProbe.h"
+#include "StatePredictor.h"
+#include "TrajectoryNet.h"
 #include <semaphore.h>
 
+#define LOOP_CACHE_LINE	64
+#define AXIS_HAND		0	// the axis of the object controller, see axes
 
 
 class SampleLoopTask : public PeriodicTask{
@@ -17,14 +30,53 @@ class SampleLoopTask : public PeriodicTask{
 		// Destructor
 		~SampleLoopTask();
 
-		int Init(char *name, double rate, double *actual_sample_rate, int priority);
+		// rate is that of the vision loop, Cycle(); with innerDivisor > 1 the
+		// timer runs innerDivisor times as fast and its thread only runs the
+		// inner loop, Inner(), while Cycle() runs every innerDivisor-th tick
+		// in a thread of its own at outerPriority, below priority.  The inner
+		// loop takes its setpoint from the last Cycle() through mSetpoint, so
+		// an outer cycle that runs long never holds up the current command;
+		// it is counted in mOuterOverRun instead.
+		int Init(char *name, double rate, double *actual_sample_rate, int priority, const ThreadOptions *opt = NULL, int direct = 0, int innerDivisor = 1, int outerPriority = 0);
+
+		// the loop without the timer and its thread, for the simulation:
+		// HW and VNET are the models there, see Simulation.h
+		int InitSimulation(double rate);
+		void Cycle();
 		
-		// feedback gains
-		double Kp;
-		double Kd;
-		double Ki;
+		// The user interface changes the loop only by Command(): the commands
+		// go through a wait-free mailbox and the loop applies them all at
+		// the start of a cycle, so no cycle sees half a change.  The fields
+		// they set are written by the loop only; the other threads read them.
+		// The senders take turns on a mutex, the loop never waits.
+		enum CommandType{
+			CMD_GAINS,		// Kp, Kd, Ki
+			CMD_CAMERA,		// 1 on, 0 off
+			CMD_MOTOR,		// MOTOR_ON or MOTOR_OFF
+			CMD_CURRENT_I,	// A
+			CMD_TIMING,		// s, see TimingStart()
+			CMD_DONE,		// the amplifier to 0 and the motor off for good
+			CMD_SWEEP,		// f0, f1, step in Hz, see sweep; f0 0 stops it
+			CMD_LOG,		// a DataLogger mode, and 1 to write in the background; DATA_LOG_OFF stops it
+			CMD_PROBE,		// trials of the latency probe, 0 stops it
+			CMD_CAPTURE		// 1 records the inputs to CAPTURE, 0 stops it
+		};
+		typedef struct{
+			int type;
+			double val[3];
+		}loopCommand;
+
+		// return: 1, or -1 if the mailbox is full
+		int Command(int type, double v0 = 0., double v1 = 0., double v2 = 0.);
+
+		// feedback gains, double buffered for the readers
+		typedef struct{
+			double Kp;
+			double Kd;
+			double Ki;
+		}loopGains;
+		loopGains Gains(){ return mGains[mGainsActive]; }
 		
-		double pCmd;
 		double currentI; // test for checking static friction
 		
 		// camera commands
@@ -33,6 +85,51 @@ class SampleLoopTask : public PeriodicTask{
 		int camera;
 		
 		double SampleRate;
+
+		// how the loop goes on without the object
+		enum VisionState{
+			VISION_OK,
+			VISION_COAST,	// predicting the object from its last velocity
+			VISION_RAMP,	// the current ramping to 0
+			VISION_STOPPED	// the motor disabled until it is enabled again
+		};
+		volatile int visionState;
+		int mOuterOverRun;	// ticks the outer loop was still running at, see Init()
+		int visionMiss;	// cycles in a row without the object
+
+		// the controllers of the experiment, switched at run time
+		ControllerTable controllers;
+
+		// eta1 and eta2 of the frame taken forward to the cycle for the
+		// controllers, with VISION_STATE_PREDICTOR, see StatePredictor.h
+		StatePredictor predictor;
+
+		// The joints of the hand.  Setup() adds the one the object turns on,
+		// AXIS_HAND; more joints are added after it.  The acceleration inner
+		// loop runs on every axis in one pass, the ones but AXIS_HAND to an
+		// acceleration of 0, to hold their speed.
+		AxisSet axes;
+
+		// While a sweep runs the inner loop drives the current with its sine
+		// of FREQ_SWEEP_AMP instead of the acceleration loop, and identifies
+		// the velocity of the encoder to the current.  The estimate goes out
+		// with the other signals as frFreq, frGain and frPhase; the points
+		// are in sweep.  The motor has to be on.
+		FreqSweep sweep;
+
+		// The round trip from the LED lit in view to the amplifier, see
+		// LatencyProbe.h; it runs while the camera is on.
+		LatencyProbe probe;
+
+		// the time of each stage of a cycle, against BUDGET_* of main.h
+		enum Stage{
+			STAGE_INPUT,	// ProcessInput()
+			STAGE_CAMERA,	// the trigger and the wait for the frame
+			STAGE_NETWORK,	// the vision samples
+			STAGE_COMPUTE,	// the object, the controller and the current command
+			STAGE_OUTPUT	// the amplifier, ProcessOutput() and the telemetry
+		};
+		LoopBudget budget;
 			
 		typedef struct {
 			int numSamples;
@@ -59,11 +156,11 @@ class SampleLoopTask : public PeriodicTask{
 			ROI_1 = 5
 		};
 		  
+		// the markers of the object are ROI 0 to OBJ_MARKERS - 1 of VNET
+		ObjectPose pose;
+
 		typedef struct {
-			double x0; // location of region 0
-			double y0;
-			double x1; // location of region 1
-			double y1;
+			int markers; // used in the last fit of pose
 			
 			double x; // location and orientation of centroid
 			double y;
@@ -76,54 +173,171 @@ class SampleLoopTask : public PeriodicTask{
 
 		}objectInfo;
 			
+		// The data of a cycle is one block of cache lines of its own, mL, so
+		// nothing the other threads write (the mailbox, its mutex, the fields
+		// of the user interface) shares a line with it.  A cycle copies what
+		// it reads from HW and VNET into the input snapshot, computes from it
+		// and the state it carries, and fills the output snapshot, which is
+		// all that MNET, SHM and VNET see: their signals point only into it.
+		typedef struct{
+			int frameStatus;	// FRAME_STATUS before the trigger
+			AxisState axes;		// of ProcessInput()
+			int packets;		// of VNET->Recv()
+			double vision[VISION_NET_NUM_CH];	// the newest vision packet
+			ObjectPose::Sample marker[OBJECT_MAX_MARKERS];
+		}loopInput;
+
+		// the inputs as CAPTURE records them, those SimIo::Replay() plays
+		// again: HW->Cycles() in s, the count of ENC_0 and the markers of
+		// the frame in mm, nan for one not in it
+		typedef struct{
+			double t;
+			double enc;
+			double x[OBJECT_MAX_MARKERS], y[OBJECT_MAX_MARKERS];
+		}loopCapture;
+
+		typedef struct{
+			double vInp;
+			double eta1;
+			double pos;		// encoder, rad
+			double eta2;
+			double handTheta;
+			double handVel;
+			double objTheta;
+			double objAngVel;
+			double iCmd;	// current command
+			double ampVCmd;
+			double frFreq;	// of sweep, 0 when it is not running
+			double frGain;
+			double frPhase;
+		}loopOutput;
+
+		typedef struct{
+			uint64_t ncycles;
+			uint64_t ncycles_prev;
+			double sec;		// since the last cycle
+
+			objectInfo obj;
+			int obj_ang_index; // to keep continuous angle value when acrossing pi(or -pi).
+
+			// for controller implementation
+			double handTheta;
+			double handTheta_prev;
+			double handVel;
+			double handVel_prev;
+			double sh;  
+			double shD;
+			double eta1;
+			double eta2;
+			double eta2_prev; // to use eta2D in calculation of shD
+			double eta2D;
+			double eta2D_prev;
+			double vInp; 
+			ControlState ctl; // for acceleration calculation
+
+			double aCmd;
+			double currentScale; // of the current command, ramped to 0 without the object
+			int attempt;
+			// TRIGGER_AT_END: of the pulse at the end of the last cycle
+			int triggered;
+			int trigStatus;		// FRAME_STATUS before it
+			unsigned int trigEdges;	// ExtInt->Edges() before it
+		}loopState;
+
+		// what Cycle() gives the inner loop
+		typedef struct{
+			double aCmd[AXIS_MAX];
+			double currentScale;
+			double Ki;
+			int run;		// the motor is on
+			int done;
+			unsigned int cycle;	// of Cycle(), for VNET->Actuated()
+			FreqSweep::Plan sweep;	// of the last CMD_SWEEP
+			unsigned int sweepSeq;	// counts the CMD_SWEEP
+		}innerSetpoint;
+
+		// what the inner loop gives back to Snapshot()
+		typedef struct{
+			double pos;
+			double iCmd;
+			double ampVCmd;
+			double frFreq;
+			double frGain;
+			double frPhase;
+		}innerFeedback;
+
+		// the acceleration inner loop, of Inner() only
+		typedef struct{
+			AxisState axes;		// the encoders again, read for the inner loop
+			double pCmd[AXIS_MAX];
+			double vCmd[AXIS_MAX];
+			double iCmd[AXIS_MAX];
+			double ampVCmd[AXIS_MAX];
+			double pCmd_prev[AXIS_MAX];
+			double vCmd_prev[AXIS_MAX];
+			double error[AXIS_MAX];
+			int cnt;
+			unsigned int cycle; // of the last setpoint
+			unsigned int sweepSeq;
+		}loopInner;
+
+		typedef struct{
+			loopInput in		__attribute__((aligned(LOOP_CACHE_LINE)));
+			loopState s			__attribute__((aligned(LOOP_CACHE_LINE)));
+			loopOutput out		__attribute__((aligned(LOOP_CACHE_LINE)));
+			loopInner inner		__attribute__((aligned(LOOP_CACHE_LINE)));
+			loopCapture cap		__attribute__((aligned(LOOP_CACHE_LINE)));
+		}loopData;
 		  
 		uint64_t cps;
-		
-		uint64_t ncycles;
-		uint64_t ncycles_prev;
-		double sec;
 	  
 		loopTiming lp;
 	  
 		int TimingStart(double sec);
 		int TimingProcess();
-		
-		objectInfo obj;
 
     private:
 		void Task();
-	  
-		double enc;
-		double pos;
-		double vel;
-		
-		double vCmd;
-		double aCmd;
-		double iCmd;
-		double ampVCmd;
-
-		// for controller implementation
-		double handTheta;
-		double handTheta_prev;
-		double handVel;
-		double handVel_prev;
-		double sh;  
-		double shD;
-		double eta1;
-		double eta2;
-		//double xi;
-		double alpha_eta; 
-		double DalphaDeta1;
-		double DalphaDeta2;
-		double vInp; 
-		// for some reason, I cannot have more variables - just one more double now - maybe because a memory problem?
-		// double eta1D; 
-		// double eta2D;
-		
-		
-		
+		void InnerTask();
+		void Inner(const innerSetpoint &sp, double rate);
+		void Feedback(innerFeedback *fb);
+		void Setup();
+		void Prepare(double rate);
+		void ApplyCommands();
+		void TimingBegin(double sec);
+
+		SpscRing *mMailbox;
+		pthread_mutex_t mCommandLock;	// of the producers of mMailbox
+		loopGains mGains[2];
+		volatile int mGainsActive;
+		void VisionMissed(const char *why);
+		void VisionFound();
+		void Trigger(int *status, unsigned int *edges);
+		// VISION_ANALOG of main.h
+		static IoHardware::AnalogInputCh AnalogX(int r);
+		static IoHardware::AnalogInputCh AnalogY(int r);
+		int ReadAnalogMarkers(ObjectPose::Sample *marker);
 
+		loopData *mL;	// on cache lines of its own, see loopData
+		void Snapshot(const innerFeedback &fb);
 
+		// the multi-rate loop, see Init()
+		int mDivisor;			// inner ticks per Cycle(), 1 for one loop
+		double mInnerRate;
+		unsigned int mCycle;	// of Cycle(), counts the setpoints
+		FreqSweep::Plan mSweepPlan;	// of ApplyCommands()
+		unsigned int mSweepSeq;
+		SeqBox *mSetpoint;		// innerSetpoint, of Cycle() to Inner()
+		SeqBox *mFeedback;		// innerFeedback, of Inner() to Snapshot()
+		pthread_t mOuterThreadId;
+		sem_t mOuterRelease;
+		volatile int mOuterRunning;
+		static void *OuterThread(void *param);
+		// HW is shared by the two loops; the mutex inherits the priority of
+		// the inner loop, so a short HW call of Cycle() is all it waits for
+		pthread_mutex_t mIoLock;
+		void IoLock(){ if(mDivisor > 1) pthread_mutex_lock(&mIoLock); }
+		void IoUnlock(){ if(mDivisor > 1) pthread_mutex_unlock(&mIoLock); }
 };
 
 #endif // SampleLoopTask_h
@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+// Sequence Lock Box Class Definition
+//
+// The newest copy of a fixed size object, from exactly one writer thread,
+// calling Put(), to any reader, calling Get().  The writer never waits; a
+// reader retries while a Put() is in progress, as VisionNet does with the
+// packets it publishes to the loop.  Unlike SpscRing only the last object
+// is kept: a reader that is late gets the newest one and misses those before.
+//
+// mSeq is odd while Put() copies; a read is good if mSeq was even before it
+// and did not change after it.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SeqBox_h
+#define SeqBox_h
+
+#define SEQ_BOX_CACHE_LINE	64
+#define SEQ_BOX_READ_TRIES	4
+
+class SeqBox{
+	public:
+		SeqBox(int objSize);
+		~SeqBox();
+
+		// writer
+		void Put(const void *obj);
+
+		// readers
+		// return: 1, or -1 if nothing was put yet or every try met a Put()
+		int Get(void *obj) const;
+
+		// the Put() calls so far
+		unsigned int Count() const { return mSeq >> 1; }
+
+	private:
+		volatile unsigned int mSeq;
+		char mPad[SEQ_BOX_CACHE_LINE - sizeof(unsigned int)];
+
+		int mObjSize;
+		char *mBuf;
+};
+
+#endif // SeqBox_h
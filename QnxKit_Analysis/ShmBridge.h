@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// Shared Memory Bridge Class Definition
+//
+// Publishes the signals of the sample loop in a POSIX shared memory region,
+// SHM_BRIDGE_NAME, for local tools such as a logger or a supervisor.  The
+// loop calls Process() every cycle; it only writes memory, no system call,
+// no lock, and it never waits for a reader.
+//
+// The region holds the latest sample under a sequence count (a seqlock: odd
+// while it is written, a copy is good if the count was even and did not
+// change) and a history ring of SHM_BRIDGE_HISTORY samples.  The ring slot
+// of sample n is n % SHM_BRIDGE_HISTORY; a slot is good if head stayed below
+// n + SHM_BRIDGE_HISTORY while it was copied.  Readers open the region read
+// only with Attach() and use ReadLatest() and ReadHistory(), at any rate.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ShmBridge_h
+#define ShmBridge_h
+
+#include <inttypes.h>
+
+class ShmBridge;
+
+extern ShmBridge	*SHM;
+
+#define SHM_BRIDGE_NAME		"/qnxkit"
+#define SHM_BRIDGE_MAGIC	0x314d4853	// "SHM1"
+#define SHM_BRIDGE_MAX_CH	16
+#define SHM_BRIDGE_HISTORY	1024	// samples, a power of two
+#define SHM_BRIDGE_NAME_LEN	16
+
+typedef struct{
+	uint32_t n;	// the sample count
+	double t;	// s since the start of the loop
+	double val[SHM_BRIDGE_MAX_CH];
+}ShmSample;
+
+typedef struct{
+	uint32_t magic;
+	uint32_t numCh;
+	double rate;	// samples per second
+	char name[SHM_BRIDGE_MAX_CH][SHM_BRIDGE_NAME_LEN];
+
+	volatile uint32_t seq;
+	ShmSample latest;
+
+	volatile uint32_t head;	// samples written to the history
+	ShmSample history[SHM_BRIDGE_HISTORY];
+}ShmRegion;
+
+class ShmBridge{
+	public:
+		ShmBridge();
+		~ShmBridge();
+
+		// called in SampleLoopTask::Init()
+		void AddSignal(int ch, double *val, const char *name);
+		// after every AddSignal()
+		int Init(double rate);
+		// of the sample loop, every cycle
+		void Process();
+
+		// of the readers
+		// return: the region, or 0 if the loop has not made it
+		static const ShmRegion *Attach();
+		// return: 1, or -1 if every try met a write in progress
+		static int ReadLatest(const ShmRegion *r, ShmSample *s);
+		// Copies the samples from *n on, at most max, oldest first.
+		// return: the number copied; *n is moved past them, or on to the
+		// oldest sample kept if the reader fell behind the ring
+		static int ReadHistory(const ShmRegion *r, uint32_t *n, ShmSample *s, int max);
+
+	private:
+		ShmRegion * volatile mRegion;
+		double *mpValPtrArr[SHM_BRIDGE_MAX_CH];
+		const char *mName[SHM_BRIDGE_MAX_CH];
+		int mNumCh;
+		double mPeriod;
+		uint32_t mN;
+};
+
+#endif // ShmBridge_h
@@ -0,0 +1,11 @@
+#ifndef SimMain_h
+#define SimMain_h
+
+// qnxkit_sim [rate] [seconds] [replay log] [speed], see Simulation.h; a
+// replay at speed times the recorded time, 0 as fast as it runs
+#define SIM_SECONDS			10.0
+#define SIM_ETA2_START		0.02	// rad, the object off the top to start with
+#define SIM_INPUT_LOG		"sim_in.log"	// the inputs, to replay
+#define SIM_OUTPUT_LOG		"sim.log"	// t handTheta handVel eta2 current, of the model
+
+#endif // SimMain_h
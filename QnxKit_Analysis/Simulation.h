@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+// Simulation Class Definitions
+//
+// The SampleLoop off the rig: SimIo stands in for HW and SimVision for VNET,
+// and SimMain.C calls SampleLoopTask::Cycle() back to back, so the loop runs
+// as fast as it computes.  Its clock is the model time of SimIo::Cycles(),
+// which moves one period per Advance(); its budget still takes ClockCycles(),
+// the real cost of each stage.
+//
+// The plant model is the hand with the object rolling on it, in the
+// coordinates (handTheta, sh) of Plant.h:
+//
+//   M11*handAcc + M12*shAcc = torque + RHO_H*COEFF_sig1*sin(eta2)
+//   M12*handAcc + M22*shAcc = COEFF_sig1*sin(eta2)
+//
+// with eta2 = handTheta + sh/RHO_H.  The torque is the current the loop wrote
+// to AMP_SIGNAL through the built-in motor parameters of motor.h, less their
+// friction, so a motor.cfg set other than the built-in one is a model error
+// the feedforward has to live with.  SIM_SUBSTEPS semi-implicit Euler steps
+// a period.  The encoder is quantized and goes through an EncoderVelocity as
+// on the rig.  The camera takes the markers when the trigger goes up and
+// raises FRAME_STATUS at once; SimVision adds noise and drops markers.
+//
+// Replay instead reads the inputs from a log, one line a cycle:
+//
+//   t enc x0 y0 x1 y1 ...
+//
+// the time in s, the encoder count and the OBJ_MARKERS markers in mm, nan for
+// a marker not in the frame.  SimMain.C writes the inputs of every run in the
+// same format, so a run can be played again against a changed controller.
+//
+// Or from a capture of the rig, 'r' of the user interface: a DataLogger file
+// of CAPTURE_FILE with the same inputs as the channels t, enc, x0, y0, ...
+// of every cycle, the time of HW->Cycles().  Replay() tells it by its magic
+// and looks the channels up by name, so a capture of fewer markers replays
+// the rest as never seen.  The cycles of a capture play one by one with the
+// time they had, through the same HW and VNET as the rig, so a stall of the
+// rig comes again at the same cycle; SimMain.C runs them as fast as it can,
+// or paced to the recorded time.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef Simulation_h
+#define Simulation_h
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "IoHardware.h"
+#include "VisionNet.h"
+#include "ObjectPose.h"
+#include "EncoderVelocity.h"
+#include "Plant.h"
+#include "DataLogger.h"
+
+#define SIM_SUBSTEPS		10		// model steps a period
+#define SIM_FALL_ETA2		0.6		// rad, the object is off the hand past this
+#define SIM_MARKER_RADIUS	50.0	// mm, of the markers about the object centre
+#define SIM_VISION_NOISE	0.1		// mm, uniform, of every marker
+#define SIM_VISION_DROP		0.01	// the share of the markers missing in a frame
+#define SIM_LINE_LEN		512
+
+class SimIo : public IoHardware{
+	public:
+		SimIo(double rate);
+		~SimIo();
+
+		// the model from rest, the object at eta2 rad
+		void Start(double eta2);
+		// a text log or a capture; return: -1 if it cannot be read
+		int Replay(const char *path);
+		int Replaying(){ return mLog != NULL; }
+
+		// one period on; return: -1 at the end of the replay
+		int Advance();
+
+		// the object: return 0 if the marker is not seen, x and y in mm
+		int Marker(int j, double *x, double *y);
+		int Fell();
+
+		// the model state
+		double Time(){ return mT; }
+		double HandTheta(){ return mHandTheta; }
+		double HandVel(){ return mHandVel; }
+		double Eta2(){ return mHandTheta + mSh/RHO_H; }
+		double Current(){ return mCurrent; }
+		long Count(){ return mCount; }
+
+		// of the SampleLoop
+		int ProcessInput();
+		int ProcessOutput(){ return 1; }
+		uint64_t Cycles(){ return mNow; }
+		int WriteDigitalBit(DigitalOutputBit bit, int state);
+		int PulseDigitalBit(DigitalOutputBit bit);
+		int ReadDigitalBit(DigitalInputBit bit);
+		void SetAnalogOut(AnalogOutputCh ch, double val);
+		void WriteAnalogCh(AnalogOutputCh ch, double val){ SetAnalogOut(ch, val); }
+		int ReadEncoder(EncoderInputCh ch);
+		void ReadEncoders(const EncoderInputCh *ch, int n, int *count){ for(int i=0; i < n; i++) count[i] = ReadEncoder(ch[i]); }
+		void WriteAnalogChs(const AnalogOutputCh *ch, const double *val, int n){ for(int i=0; i < n; i++) SetAnalogOut(ch[i], val[i]); }
+		int GetEncoderCount(EncoderInputCh ch){ return ch == ENC_0 ? (int)mCount : 0; }
+		double GetEncoderVelocity(EncoderInputCh ch){ return ch == ENC_0 ? mEncVel.Velocity() : 0.; }
+
+	private:
+		uint64_t mCps;
+		uint64_t mPeriod;	// ClockCycles() of a period
+		uint64_t mNow;
+		double mT;
+
+		double mHandTheta, mHandVel;
+		double mSh, mShVel;
+		double mCurrent;	// A
+		int mEnabled;
+		int mFrameStatus;
+		int mTrigger;
+
+		long mCount;
+		EncoderVelocity mEncVel;
+
+		// of the replay
+		FILE *mLog;
+		double mLogX[OBJECT_MAX_MARKERS], mLogY[OBJECT_MAX_MARKERS];
+
+		// of a capture: the record and where the inputs are in it, -1 for a
+		// marker it does not have
+		char *mRecord;
+		int mRecordSize;
+		int mChT, mChEnc;
+		int mChX[OBJECT_MAX_MARKERS], mChY[OBJECT_MAX_MARKERS];
+		int ReadCapture(const DataLogHeader &h);
+		int AdvanceCapture();
+
+		void Step(double dt);
+		void Sample();
+};
+
+class SimVision : public VisionNet{
+	public:
+		SimVision(SimIo *plant, int markers);
+
+		// of the SampleLoop
+		void Process(){}
+		int Recv();
+		int Fresh(int roi){ return mMarker[roi].fresh; }
+		int Seen(int roi){ return mMarker[roi].seen; }
+		int Age(int roi){ return mMarker[roi].age; }
+		double X(int roi){ return mMarker[roi].x; }
+		double Y(int roi){ return mMarker[roi].y; }
+		void Triggered(uint64_t now);
+		void Actuated(uint64_t now){}
+		double FrameAge(uint64_t now);
+		int LinkLost(uint64_t now){ return 0; }
+
+		void PrintStats();
+
+	private:
+		SimIo *mPlant;
+		int mMarkers;
+
+		// the frame of the last trigger, taken by the next Recv()
+		int mPending;
+		uint64_t mTriggerTime;
+		struct{
+			double x, y;
+			int found;
+		}mFrame[OBJECT_MAX_MARKERS];
+
+		struct{
+			double x, y;
+			int age, fresh, seen;
+		}mMarker[OBJECT_MAX_MARKERS];
+
+		unsigned int mFrames;
+		unsigned int mMissing;
+};
+
+#endif // Simulation_h
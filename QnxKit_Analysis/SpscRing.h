@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// Single Producer Single Consumer Ring Class Definition
+//
+// A wait-free queue of fixed size objects between exactly one producer
+// thread, calling Put(), and one consumer thread, calling Get(), GetBatch()
+// and Reset().  Neither side ever blocks or takes a lock, so the control loop
+// can put into it without waiting on a lower priority network task.
+//
+// The capacity is rounded up to a power of two and the head and tail count up
+// freely, masked on access.  Only the producer writes mTail and only the
+// consumer writes mHead; each sits on a cache line of its own.  A Put() into
+// a full ring is dropped and counted.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef SpscRing_h
+#define SpscRing_h
+
+#define SPSC_CACHE_LINE	64
+
+class SpscRing{
+	public:
+		SpscRing(int objSize, int len);
+		~SpscRing();
+
+		// producer
+		int Put(const void *obj);
+
+		// consumer
+		int Get(void *obj);
+		int GetBatch(void *objs, int max);
+		void Reset(){ mHead = mTail; }
+
+		int Length() const { return (int)(mTail - mHead); }
+		int Capacity() const { return (int)(mMask + 1); }
+		unsigned int Dropped() const { return mDropped; }
+
+	private:
+		volatile unsigned int mHead;
+		char mPadHead[SPSC_CACHE_LINE - sizeof(unsigned int)];
+		volatile unsigned int mTail;
+		volatile unsigned int mDropped;
+		char mPadTail[SPSC_CACHE_LINE - 2*sizeof(unsigned int)];
+
+		unsigned int mMask;
+		int mObjSize;
+		char *mBuf;
+};
+
+#endif // SpscRing_h
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// State Predictor Class Definition
+//
+// eta1 and eta2 come from the markers of a frame that is already some ms old
+// when the loop has it, while the hand velocity is of the encoders of this
+// cycle.  A StatePredictor takes the state of the object forward over the
+// age of the frame through the model the controllers are built on,
+//
+//   eta1' = sig1*sin(eta2),  eta2' = sig2*eta1 + sig3*handVel,
+//
+// with the hand velocities the loop measured in the cycles since the frame,
+// so the controller acts on the state of the cycle rather than of the frame
+// and its gains need not make up for the delay.
+//
+// The loop gives Hand() the hand velocity and period of every cycle; the
+// last STATE_PREDICTOR_CYCLES are kept.  Predict() takes eta2 and its
+// derivative of the frame, forms eta1 of the frame with the hand velocity
+// of that time, and integrates both to now by the midpoint rule, a step per
+// cycle; an older frame is only taken forward over the cycles kept.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef StatePredictor_h
+#define StatePredictor_h
+
+#include "Controller.h" // PlantCoeff
+
+#define STATE_PREDICTOR_CYCLES	32	// the most cycles a frame is taken forward over
+
+class StatePredictor{
+	public:
+		StatePredictor();
+
+		void Init(const PlantCoeff *p);
+
+		// of the loop, every cycle: its hand velocity, and s since the last one
+		void Hand(double handVel, double sec);
+
+		// age: s from the frame of eta2 and eta2D to now
+		// return: the s they were taken forward
+		double Predict(double age, double eta2, double eta2D, double *eta1Now, double *eta2Now);
+
+		void Print();
+
+	private:
+		PlantCoeff mP;
+
+		// of the cycles, the newest at (mCount - 1) % STATE_PREDICTOR_CYCLES
+		double mVel[STATE_PREDICTOR_CYCLES];
+		double mSec[STATE_PREDICTOR_CYCLES];
+		unsigned int mCount;
+
+		unsigned int mPredictions, mClamped;
+		double mAgeSum, mAgeMax;
+
+		double Vel(int back){ return mVel[(mCount - 1 - back) % STATE_PREDICTOR_CYCLES]; }
+		double Sec(int back){ return mSec[(mCount - 1 - back) % STATE_PREDICTOR_CYCLES]; }
+		void Step(double h, double handVel, double *eta1, double *eta2);
+};
+
+#endif // StatePredictor_h
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// Task Monitor Class Definition
+//
+// Always-on timing statistics of a PeriodicTask.  The task thread calls
+// Start() when it is released by the timer and End() when it waits again;
+// the timer control thread calls OverRun() for every pulse the task missed.
+//
+// The jitter of the period (its distance from the nominal period) and the
+// execution time go into log-scale histograms of microseconds, with
+// TASK_MONITOR_SUB bins per octave.  The worst cases keep the time they
+// happened at, and the last TASK_MONITOR_LOG overruns are logged, as are the
+// incidents the task reports and survives, like a lost camera frame.  Every
+// field has a single writer, so nothing is locked; Print() can be called
+// from the user interface at any time and only reads.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TaskMonitor_h
+#define TaskMonitor_h
+
+#include <inttypes.h>
+
+#define TASK_MONITOR_SUB	4	// bins per octave
+#define TASK_MONITOR_BINS	80	// up to 2^(80/4) TASK_MONITOR_SUB us, about 4 s
+#define TASK_MONITOR_LOG	16	// overruns and incidents kept
+
+class TaskMonitor{
+	public:
+		TaskMonitor();
+
+		// cps: ClockCycles() per second, period: the nominal period in cycles
+		void Init(uint64_t cps, uint64_t period);
+
+		// of the task thread, with ClockCycles()
+		void Start(uint64_t now);
+		void End(uint64_t now);
+
+		// of the timer control thread
+		void OverRun(uint64_t now);
+
+		// of the task thread, what: a static string
+		void Incident(const char *what, uint64_t now);
+
+		void Print(const char *name);
+
+	private:
+		struct Hist{
+			volatile unsigned int bin[TASK_MONITOR_BINS];
+		};
+
+		// a worst case, written under mSeq
+		struct Worst{
+			uint64_t cycles;
+			uint64_t when;
+			unsigned int n;	// which release
+		};
+
+		uint64_t mCps;
+		uint64_t mPeriod;
+		uint64_t mT0;
+
+		// written by the task thread
+		uint64_t mLastStart;
+		volatile unsigned int mReleases;
+		volatile unsigned int mSeq;	// odd while a worst case is written
+		uint64_t mMinPeriod, mMaxPeriod;
+		Worst mWorstJitter, mWorstExec;
+		Hist mJitter, mExec;
+		volatile unsigned int mIncidents;
+		const char *mIncidentWhat[TASK_MONITOR_LOG];
+		uint64_t mIncidentLog[TASK_MONITOR_LOG];
+
+		// written by the timer control thread
+		volatile unsigned int mOverRuns;
+		uint64_t mOverRunLog[TASK_MONITOR_LOG];
+
+		static int Bin(uint64_t us);
+		static uint64_t BinTop(int k);
+		uint64_t Us(uint64_t cycles){ return cycles * 1000000 / mCps; }
+		double Sec(uint64_t when){ return (double)(when - mT0) / mCps; }
+		void Percentiles(const Hist *h, unsigned int *p50, unsigned int *p99, unsigned int *p999);
+};
+
+#endif // TaskMonitor_h
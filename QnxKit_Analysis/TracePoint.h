@@ -0,0 +1,7 @@
+#ifndef TracePoint_h
+#define TracePoint_h
+
+// the trace points are shared with TDah and HSV-Base
+#include "../TDah/include/TracePoint.h"
+
+#endif // TracePoint_h
@@ -0,0 +1,99 @@
+#ifndef TrajectoryNet_h
+#define TrajectoryNet_h
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <inttypes.h>
+#include "AperiodicTask.h"
+
+class SpscRing;
+class TrajectoryNet;
+
+extern TrajectoryNet	*TNET;
+
+#define TRAJECTORY_NET_MAX_CH	4
+#define TRAJECTORY_NET_RING_LEN	4096	// setpoints queued ahead of the loop, a power of two
+#define TRAJECTORY_NET_PREFILL	256		// queued before the loop starts on a trajectory
+#define TRAJECTORY_NET_MAGIC	0x31524b51	// "QKR1"
+#define TRAJECTORY_NET_END		1		// flags: the last frame of the trajectory
+
+// The host streams a trajectory in binary frames, little endian (x86), as
+// MatlabNet streams the other way: a TrajectoryNetHeader, then numSamples
+// setpoints of numCh float32 each, period s apart.  Channel 0 is the target
+// hand velocity of the "trajectory" controller (see Controller.h); the
+// others are for the loop variants that need more.
+struct TrajectoryNetHeader{
+	uint32_t magic;
+	uint16_t numCh;
+	uint16_t numSamples;
+	float period;	// s
+	uint32_t flags;
+};
+
+// The setpoints of a trajectory precomputed on the host.  The task reads the
+// frames into a lock-free ring ahead of the loop; when the ring is full it
+// stops reading, so TCP holds the host back instead of the setpoints being
+// dropped.  The loop takes one step of Next() per cycle: once
+// TRAJECTORY_NET_PREFILL setpoints, or the whole of a shorter trajectory,
+// are queued it plays them, interpolated at its own period, which need not
+// be that of the host.  When the ring runs dry it holds the last setpoint
+// and counts an underrun; after the end of the trajectory it holds the last
+// one until the next.  A new connection starts a new trajectory, and what
+// is left of the old one is dropped.
+class TrajectoryNet : public AperiodicTask{
+    public:
+        TrajectoryNet();
+        ~TrajectoryNet();
+
+		int Init(int priority);
+
+		// of the loop, every cycle: the setpoints sec after the last call
+		// return: 1 while a trajectory plays, else 0 and the held setpoints
+		int Next(double sec, double *ref);
+
+		void PrintStats();
+
+    private:
+		// a ring object
+		struct Sample{
+			uint32_t session;
+			float period;
+			uint32_t end;	// the last setpoint of the trajectory
+			float val[TRAJECTORY_NET_MAX_CH];
+		};
+
+		// the task puts, the loop takes; neither waits
+		SpscRing *mpRing;
+		volatile uint32_t mSession;	// of the task, one per connection
+		volatile uint32_t mEnds;	// trajectories the task has queued to the end
+		volatile uint32_t mSessionEnds;	// mEnds when mSession started
+
+		// of the loop
+		enum{ TRAJ_IDLE, TRAJ_PLAYING, TRAJ_HELD } mState;
+		uint32_t mPlaying;	// the session played
+		uint32_t mEndsPlayed;	// mEnds the loop has played to, of mPlaying
+		Sample mA, mB;		// the setpoints the loop is between
+		double mPhase;		// s since mA
+		unsigned int mUnderruns, mPlayed, mTrajectories;
+
+		// of the task
+		unsigned int mFrames, mBad;
+
+		int mInitialized;
+
+		// TCP/IP
+		int mSocket;
+		struct sockaddr_in mServerAddr;
+
+		int TcpIpInit();
+		int RecvAll(int s, void *buf, int len);
+		void Start();
+		int Advance();
+
+		// Task function
+		void Task();
+
+		static void sig_handler(int signo){};
+};
+
+#endif // TrajectoryNet_h
@@ -3,7 +3,10 @@
 
 #include <sys/types.h>
 #include <netinet/in.h>
+#include <inttypes.h>
 #include "AperiodicTask.h"
+// the messages, shared with the vision PCs
+#include "../TDah/include/VisionWire.h"
 
 //class FifoQ;
 class VisionNet;
@@ -11,7 +14,21 @@ class VisionNet;
 extern VisionNet 	*VNET;
 
 
-#define VISION_NET_NUM_CH	3
+#define VISION_NET_NUM_ROI	8	// OBJECT_MAX_MARKERS
+#define VISION_NET_RX_BUF	(VISION_NET_PACKET*32)
+#define VISION_NET_MAX_AGE	4	// Recv() calls without a sample of a ROI before it is lost
+#define VISION_NET_READ_TRIES	3	// seqlock reads in Recv() before it gives up for the cycle
+
+// The clock sync messages have the 24 bytes of a sample and a negative tag in
+// place of the ROI, the VISION_NET_* tags of VisionWire.h.
+#define VISION_NET_PING_SEC		0.1	// between the pings, once the vision PC has sent a stamp
+#define VISION_NET_SYNC_WINDOW	16	// pongs the clock offset is taken from
+#define VISION_NET_TRIGGERS		64	// camera triggers kept to match the frames to
+#define VISION_NET_LINK_PERIODS	2	// loop periods of silence before LinkLost() of a beating vision PC
+#define VISION_NET_DEAD_SEC		0.5	// of silence before the connection is closed and a new one accepted
+#define VISION_NET_MAX_CLIENTS	4	// vision PCs connected at a time
+#define VISION_NET_HISTORY		8	// time aligned samples of each ROI kept for Predict()
+#define VISION_NET_HORIZON_SEC	0.05	// Predict() goes no further past the newest sample, nor back over a gap
 
 // This is a modification from MatlabNet.C/h 
 // Whereas MatlabNet is for sending data to display at a host computer,
@@ -19,26 +36,218 @@ extern VisionNet 	*VNET;
 //
 // Basically, we don't have to create another "server" socket because MatlabNet already has one.
 // However, creating another one is not also a problem at all and this is easier in coding than using MatlabNet's.
+//
+// The packets split across recv() calls are put back together and only the
+// newest sample of each ROI is kept, so the vision data is never older than
+// the last packet.  Samples superseded before a Recv() are counted as drops.
+//
+// Synchronous mode: Recv() drains the non-blocking sockets each control cycle.
+// Receiver thread mode: Task() blocks in select() at a priority just below the
+// control loop and publishes the samples under a sequence count (a seqlock).
+// Recv() then only copies them, with no system call and no lock.  If it keeps
+// catching the receiver in the middle of a publish it gives up for the cycle
+// rather than spin, which on one CPU would never let the receiver finish.
+//
+// Clock sync: a vision PC that sends a stamp of its clock with every frame is
+// pinged every VISION_NET_PING_SEC, and its pong gives the offset of its clock
+// as t_vision - (t_ping + t_pong)/2; of the last VISION_NET_SYNC_WINDOW pongs
+// the one of the least round trip, the least asymmetric, is used.  The loop
+// tells Triggered() every trigger pulse and Actuated() every output; a frame
+// is the one of the last trigger before its stamp, which gives the trigger to
+// frame and the camera to actuation latencies, and FrameAge() for the loop
+// to compensate.  The camera counts the triggers too: a change of the
+// difference between the trigger count and the frame id is a slip, a trigger
+// without a frame.  In the synchronous mode a pong is only parsed in Recv(),
+// up to a period late, so the receiver thread mode syncs better.
+//
+// Link health: a vision PC that sends beats, whenever it has sent nothing
+// for about a millisecond, is never silent while it is up.  Every parse of
+// the receiver stamps the time, so LinkLost() tells the loop within
+// VISION_NET_LINK_PERIODS that the link is down, before it waits for a frame.
+// After VISION_NET_DEAD_SEC of silence the connection is closed and the task
+// accepts the next one, so a half-open connection, a pulled cable, does not
+// hold up a vision PC that connects again.  The beats and the frame ids of
+// the stamps are numbered; their gaps are counted.  A vision PC without
+// beats is never taken for lost.
+//
+// Several vision PCs: up to VISION_NET_MAX_CLIENTS connect at a time, each
+// into a client of its own with its own buffer, clock sync, beats and map
+// of its ROIs to the ROIs of the loop (MapRoi(), the same ROI by default).
+// Recv() fuses them: of the new samples of a ROI of the loop it takes the
+// newest, by the time of its frame on the qnx clock once that client has a
+// pong, else by the time it arrived, so two cameras on the same markers
+// give the loop a sample whenever either has one.  The link is lost only
+// when every client is, and a camera that goes away leaves the others.
+// The triggers are matched to the frames of client 0, the first to
+// connect, which should be the camera the loop triggers.  The receiver
+// thread waits on all the sockets and the listening one with select(); in
+// the synchronous mode Recv() drains every client and the task accepts new
+// ones between the cycles.
+//
+// Prediction: the samples of a ROI of a client with a pong are of the time
+// of their frame on the qnx clock, so the last VISION_NET_HISTORY of them are
+// kept with it.  Predict() fits a line or a parabola to the last few by least
+// squares and takes it on to the time the loop asks for: the state of the
+// markers now, to differentiate over the loop period, however old the frame
+// and however late it came.  The fit is of a fixed number of samples, so it
+// costs the same every cycle.  A sample that is not newer than the last is
+// not kept, nor are the samples before a gap of VISION_NET_HORIZON_SEC.
+//
+// Versions: a vision PC says hello with the version of VisionWire.h it was
+// built with, and whether it sends batches, which this VisionNet does not
+// parse yet.  A session of another version is closed, rather than taken
+// apart as the layout of this one.
+//
+// The functions of the control loop are virtual, so the vision model of
+// Simulation.h can stand in for the network.
 class VisionNet : public AperiodicTask{
     public:
         // Constuctor
         VisionNet();
         // Destructor
-        ~VisionNet();
+        virtual ~VisionNet();
 		
-		int Init(double rate, int priority);
-		void Process();
+		// rxThread: 1 for the receiver thread mode
+		int Init(double rate, int priority, int rxThread = 0);
+		virtual void Process();
 		void AddSignal(int ch, double *val);
-		int Recv(); // for direction data receoption.
+		// before Init(): the samples of ROI roi of client to ROI loopRoi, -1 to drop them
+		void MapRoi(int client, int roi, int loopRoi);
+		virtual int Recv(); // for direction data receoption.
+
+		// the sample of a ROI, as of the last Recv()
+		virtual int Fresh(int roi){ return mRoi[roi].fresh; }
+		virtual int Seen(int roi){ return mRoi[roi].seen; }
+		virtual int Age(int roi){ return mRoi[roi].age; }
+		virtual double X(int roi){ return mRoi[roi].x; }
+		virtual double Y(int roi){ return mRoi[roi].y; }
+
+		// where ROI roi is at now, with HW->Cycles(), from the polynomial of
+		// order 0 to 2 fit to its last n time aligned samples; order 0 holds the newest
+		// return: the order fit, less for fewer samples, or -1 if the ROI has no
+		// time aligned sample, and x, y are left as they are
+		int Predict(int roi, uint64_t now, int order, int n, double *x, double *y);
+
+		virtual void PrintStats();
+
+		// of the control loop, with HW->Cycles()
+		virtual void Triggered(uint64_t now);
+		virtual void Actuated(uint64_t now);
+		virtual double FrameAge(uint64_t now);	// s since the trigger of the newest frame, 0 if not synced
+		// 1 if every vision PC that beats has been silent too long, and no other is connected
+		virtual int LinkLost(uint64_t now);
+
+		// since the start
+		unsigned int mPackets;
+		unsigned int mDropped;
+		unsigned int mBadRoi;
+		unsigned int mTorn;	// Recv() calls that gave up on a publish in progress
+		unsigned int mFused;	// samples of a ROI that came from two clients in one Recv()
+		int mMaxAge;
+		unsigned int mPredicted, mClamped;	// Predict() calls, and those beyond VISION_NET_HORIZON_SEC
+		unsigned int mUnordered;	// time aligned samples not newer than the last of their ROI
+
+    protected:
+		double Sec(uint64_t cycles){ return (double)cycles / mCps; }
+		// of Recv(): a sample of ROI roi of the loop at t s on the qnx clock
+		void Aligned(int roi, double t, double x, double y);
 
     private:
 		double mSampleRate;
 		//FifoQ *mpFifo;
 
-		//char mBuf[VISION_NET_NUM_CH*8];
-		//when the program is in the camera mode, only [VISION_NET_NUM_CH*8] might be enough.
-		//However, when recv() is called on the thread, we may need a larger size of buffer.
-		char mBuf[128]; 
+		int mRxThread;
+
+		// what the receiver has parsed of one client; the counts only go up
+		struct VisionRx{
+			double val[VISION_NET_NUM_CH];	// the newest packet
+			double x[VISION_NET_NUM_ROI], y[VISION_NET_NUM_ROI];
+			double t[VISION_NET_NUM_ROI];	// s on the qnx clock, of the frame or of the arrival, see above
+			int aligned[VISION_NET_NUM_ROI];	// t is of the frame
+			unsigned int count[VISION_NET_NUM_ROI];	// samples of each ROI
+			unsigned int packets, bad, sessions;
+			int connected;
+			// of the hello of the session, 1 and 0 for a vision PC without one
+			int version, flags;
+
+			// the clock of the vision PC
+			double offset;	// s, vision - qnx time
+			double rtt;		// s, the round trip of the pong of offset
+			unsigned int pongs, stamps;
+			int stamping;	// the session had a stamp, so it is pinged
+			unsigned int frame;	// the id of the newest stamp
+			double frameTime;	// s, its time on the qnx clock, if there was a pong
+			unsigned int frameGaps;	// frame ids skipped
+
+			// the health of the link
+			uint64_t lastRx;	// ClockCycles() of the last parse
+			int beating;		// the session had a beat
+			unsigned int beats, beatGaps;
+			double beatNext;	// the number of the next beat
+		};
+
+		// a connection, of the receiver but for the map
+		struct Client{
+			volatile int valid;	// the socket is open; set last by the task, cleared by whoever closes it
+			int open;			// of the task: valid when it last looked
+			int socket;
+			struct sockaddr_in addr;
+			VisionRx rx;
+
+			// the received bytes not parsed yet, a partial packet at most after Parse()
+			char buf[VISION_NET_RX_BUF];
+			int fill;
+
+			// of the parser: the pongs the offset is chosen from
+			double pongOffset[VISION_NET_SYNC_WINDOW];
+			double pongRtt[VISION_NET_SYNC_WINDOW];
+
+			// of the ping sender
+			uint64_t lastPing;
+			unsigned int pings;
+
+			int map[VISION_NET_NUM_ROI];	// the ROI of the loop of each ROI, -1 for none
+		} mClient[VISION_NET_MAX_CLIENTS];
+
+		// the VisionRx of the clients as published by the receiver thread; mSeq is odd while it is written
+		volatile unsigned int mSeq;
+		VisionRx mPub[VISION_NET_MAX_CLIENTS];
+
+		// of the control loop: the VisionRx last taken, and the samples as of then
+		VisionRx mSeen[VISION_NET_MAX_CLIENTS];
+		struct RoiSample{
+			double x, y;
+			int age;	// Recv() calls since the sample
+			double t;	// of the sample, see VisionRx::t
+			int fresh;	// got in the last Recv()
+			int seen;	// ever got one
+		} mRoi[VISION_NET_NUM_ROI];
+		struct RoiHistory{
+			double t[VISION_NET_HISTORY], x[VISION_NET_HISTORY], y[VISION_NET_HISTORY];
+			unsigned int n;	// since the start, the newest at (n - 1) % VISION_NET_HISTORY
+		} mHistory[VISION_NET_NUM_ROI];
+
+		// of the control loop
+		uint64_t mCps;
+		uint64_t mTrigger[VISION_NET_TRIGGERS];
+		unsigned int mTriggers;
+		uint64_t mFrameTrigger;	// the trigger of the newest frame, 0 for none
+		int mFrameNew;			// a frame not actuated yet
+		int mSeqDiff;
+		unsigned int mSlips;
+		struct Latency{
+			double last, sum, max;	// s
+			unsigned int n;
+		} mTrigToFrame, mCamToAct;
+
+		void Pong(Client *c, double pingTime, double visionTime);
+		void Stamp(Client *c, double frame, double visionTime);
+		void Ping(Client *c);
+		void Beat(Client *c, double number);
+		int Hello(Client *c, double version, double flags);
+		int Silent(const VisionRx *rx, uint64_t now, double sec);
+		void Matched(const VisionRx *rx);
+		static void AddLatency(Latency *l, double sec);
 
 		double *mpValPtrArr[VISION_NET_NUM_CH];
 		//double mpValBuf[VISION_NET_NUM_CH]; // not necessary for vision TCP/IP
@@ -48,11 +257,19 @@ class VisionNet : public AperiodicTask{
 
 		// TCP/IP
 		int mSocket;
-		int mSessionSocket;
 		struct sockaddr_in mServerAddr;
-		unsigned char validSession;
 
 		int TcpIpInit();
+		int Parse(Client *c);
+		int Read(Client *c);
+		void Reset();
+		void Publish();
+		int ReadPublished(VisionRx *rx);
+		int Take(const VisionRx *const *rx);
+		void Closed();
+		int Accept();
+		void Close(Client *c);
+		void RxLoop();
 		
 		// Task function
 		void Task();
@@ -64,5 +281,3 @@ class VisionNet : public AperiodicTask{
 };
 
 #endif // VisionNet_h
-
-
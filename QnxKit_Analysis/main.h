@@ -7,7 +7,121 @@
 #include "VisionNet.h"
 #include "ExternalInterrupt.h"
 
-#define SAMPLE_RATE		800.0 //550.0 //1000.0 //1000.0		// rate at which sample loop will run at (Hz)
+#define SAMPLE_RATE		800.0 //550.0 //1000.0 //1000.0		// rate at which sample loop will run at (Hz), unless given as qnxkit [rate]
+#define MAX_SAMPLE_RATE	2000.0
+
+// the share of the period each stage of the SampleLoop may take, see 'b'
+#define BUDGET_INPUT	0.15
+#define BUDGET_CAMERA	0.45
+#define BUDGET_NETWORK	0.10
+#define BUDGET_COMPUTE	0.10
+#define BUDGET_OUTPUT	0.10
+
+// The SampleLoop owns SAMPLE_LOOP_CPU, -1 for any CPU; every other thread of
+// qnxkit runs on the rest.  The network stack is a process of its own, so
+// start io-pkt off that CPU as well, e.g. with on -R.  All the memory is
+// locked, and the stack of the loop is faulted in before it starts.
+#define SAMPLE_LOOP_CPU			1
+#define SAMPLE_LOOP_STACK		(256*1024)	// bytes
+#define SAMPLE_LOOP_PREFAULT	(128*1024)	// bytes
+// 1: the SampleLoop receives the timer pulses itself, without the timer control
+// thread and its semaphore in between (see PeriodicTask.h)
+#define SAMPLE_LOOP_DIRECT		1
+// The current command may run INNER_LOOP_DIVISOR times as often as the vision
+// loop, e.g. 5 for a 4 kHz inner loop at 800 Hz; the vision loop then runs in
+// a thread of its own at OUTER_LOOP_PRIORITY, on SAMPLE_LOOP_CPU as well.  1
+// runs both in one cycle, as before.  The simulation always runs one.
+#define INNER_LOOP_DIVISOR		1
+#define OUTER_LOOP_PRIORITY		58
+
+// the current of the frequency sweep, 'w', in A
+#define FREQ_SWEEP_AMP			0.2
+#define LOCK_MEMORY				1
+
+// 1: the control loop sleeps until the frame status interrupts, on IRQ 10
+// (port C, bit 3 of group 1, once per frame), instead of polling FRAME_STATUS
+#define FRAME_WAIT_INTERRUPT	0
+#define FRAME_TIMEOUT_PERIODS	0.8 // a frame later than this share of the period is lost
+
+// when in the period the camera is triggered, see SampleLoopTask::Cycle()
+#define TRIGGER_AT_START		0 // at the start of a cycle, which then waits for its frame
+#define TRIGGER_AT_END			1 // after the outputs of a cycle, for the next one
+// TRIGGER_AT_END: the exposure, transfer and blob pass of the frame run while
+// the loop waits for its next tick, so the frame is there or close when the
+// next cycle starts, one period of latency for the wait of the cycle.  The
+// timeout is still FRAME_TIMEOUT_PERIODS from the start of the cycle.
+#define TRIGGER_SCHEDULE		TRIGGER_AT_START
+
+// without the object, the loop coasts on its last angular velocity for
+// VISION_COAST_CYCLES cycles, then ramps the current to 0 over VISION_RAMP_SEC
+// and disables the motor; the motor is enabled again from the menu
+#define VISION_COAST_CYCLES		8
+#define VISION_RAMP_SEC			0.2
+
+// 1: VisionNet receives in a thread of its own, just below the SampleLoop
+// priority, and the control loop only reads the newest samples it published
+#define VISION_RX_THREAD		0
+#define VISION_RX_PRIORITY		59
+
+// the ROIs of the object, 0 to OBJ_MARKERS - 1, and the frames with all of
+// them the layout of the markers is learned from (see ObjectPose.h)
+#define OBJ_MARKERS				2
+#define OBJ_LAYOUT_FRAMES		100
+
+// 1: the positions of the markers are read from the analog inputs the vision
+// PC writes right before it toggles the frame status (see TDah's
+// AnalogPublisher.h), x of ROI r on VISION_ANALOG_AIN + r and y 8 above it,
+// on the other bank, so a marker is one conversion; a marker below
+// VISION_ANALOG_LOST_V was not found.  The network still carries the rest.
+#define VISION_ANALOG			0
+#define VISION_ANALOG_AIN		4
+#define VISION_ANALOG_MM_PER_VOLT	(300/9.0)
+#define VISION_ANALOG_LOST_V	(-7.5)
+// conversions averaged per read of a marker, see IoHardware::OversampleAnalogInput()
+#define VISION_ANALOG_OVERSAMPLE	4
+
+// 1: the object angle is moved on by its velocity over the age of its frame,
+// from the clock sync with the vision PC (see VisionNet.h)
+#define VISION_LATENCY_COMPENSATION	0
+
+// 1 or 2: the markers are taken where the line or parabola of order
+// VISION_EXTRAPOLATION through the last VISION_EXTRAPOLATION_SAMPLES of
+// their time aligned samples puts them at the cycle, so the angle and its
+// velocity are of the cycle times (see VisionNet::Predict()); it takes the
+// place of VISION_LATENCY_COMPENSATION.  A marker without a clock sync is
+// used as it came.
+#define VISION_EXTRAPOLATION		0
+#define VISION_EXTRAPOLATION_SAMPLES	4
+
+// 1: the controllers get eta1 and eta2 taken forward from the trigger of
+// their frame to the cycle through the model of the hand and the object,
+// with the hand velocities of the cycles between (see StatePredictor.h);
+// it needs the clock sync, FrameAge() is 0 without it.  With
+// VISION_EXTRAPOLATION the markers are of the cycle already, and it is off.
+#define VISION_STATE_PREDICTOR		0
+
+// the motor parameter sets, and the one the feedforward starts with
+#define MOTOR_PARAM_FILE		"motor.cfg"
+#define MOTOR_PARAM_SET			"inertia"
+
+// the gain schedules added to the controllers at start-up (see Controller.h)
+#define CONTROLLER_GAIN_FILE	"gains.cfg"
+
+// commands of the user interface waiting for the SampleLoop
+#define LOOP_MAILBOX_LEN		16
+
+// every TELEMETRY_DECIMATION-th sample loop cycle is streamed to MATLAB
+#define TELEMETRY_DECIMATION	1
+
+// every cycle goes to the RAM of the data logger, 'l', DATA_LOG_SEC of them
+// at most, and from there to the disk at DATA_LOG_PRIORITY
+#define DATA_LOG_SEC			60.0
+#define DATA_LOG_PRIORITY		10
+
+// the inputs of every cycle, 'r', to the disk as they come, for qnxkit_sim
+// to replay: CAPTURE_SEC of them in RAM for the disk to fall behind by
+#define CAPTURE_FILE			"/tmp/qnxkit_in_%03d.qlg"
+#define CAPTURE_SEC				10.0
 
 extern SampleLoopTask	*SampleLoop; 
 
@@ -23,16 +23,9 @@
 #define INERTIA				(0.00906)	// (MOTOR + HAND)
 
 
-// new motor modeling
-/*#define KM_POS				(1.933)		// Nm/A for positive torques
-#define DYN_FRIC_POS		(0.04092)	// dynamic friction
-#define STAT_FRIC_POS		(0.1590)	// static friction
-
-#define KM_NEG				(2.084)		// Nm/A for negative torques
-#define DYN_FRIC_NEG		(0.05094)	// dynamic friction
-#define STAT_FRIC_NEG		(0.1062)	// static friction
-*/
-// new values 
+// The friction model of the feedforward, from the identification experiments.
+// These are the built-in set; the others are in motor.cfg and are read at
+// start-up, see MotorModel.
 // considered the motor's inertia with Phillip's data
 #define KM_POS				(1.959)		// Nm/A for positive torques
 #define DYN_FRIC_POS		(0.0361)	// dynamic friction
@@ -42,46 +35,70 @@
 #define DYN_FRIC_NEG		(0.03928)	// dynamic friction
 #define STAT_FRIC_NEG		(0.1927)	// static friction
 
-
-// New values from a simple experiment
-// These values are compatible with the direction used in the code
-/*#define KM_POS				(0.6253)		// Nm/A for positive torques
-#define DYN_FRIC_POS		(0.03765)	// dynamic friction
-#define STAT_FRIC_POS		(0.01711)	// static friction
-
-#define KM_NEG				(1.0945)		// Nm/A for negative torques
-#define DYN_FRIC_NEG		(0.03845)	// dynamic friction
-#define STAT_FRIC_NEG		(0.01429)	// static friction
-*/
-
-// original
-/*#define KM_POS				(0.460)		// Nm/A for positive torques
-#define DYN_FRIC_POS		(0.00550)	// dynamic friction
-#define STAT_FRIC_POS		(0.0484)	// static friction
-
-#define KM_NEG				(0.437)		// Nm/A for negative torques
-#define DYN_FRIC_NEG		(0.00610)	// dynamic friction
-#define STAT_FRIC_NEG		(0.0466)	// static friction
-*/
-
-// determined only for Philip's 150mA data
-/*#define KM_POS			    (0.45708)		// Nm/A for positive torques
-#define DYN_FRIC_POS		(0.008066)	// dynamic friction
-#define STAT_FRIC_POS		(0.038047)	// static friction
-
-#define KM_NEG				(0.44814)		// Nm/A for negative torques
-#define DYN_FRIC_NEG		(0.008127)	// dynamic friction
-#define STAT_FRIC_NEG		(0.038229)	// static friction
-*/
-
-/*#define KM_POS			(0.2427989)//(0.39) //(0.2427989)		// Nm/A for positive torques
-#define DYN_FRIC_POS		(0.0100528)//(0.011) //(0.0100528)	// dynamic friction
-#define STAT_FRIC_POS		(0.014614349)//(0.015) //(0.014614349)	// static friction
-
-#define KM_NEG				(0.2427989)//(0.39) //(0.2427989)		// Nm/A for negative torques
-#define DYN_FRIC_NEG		(0.0100528)//(0.011)	// dynamic friction
-#define STAT_FRIC_NEG		(0.014614349)//(0.015)	// static friction
-*/
+#define MOTOR_MAX_SETS		16
+#define MOTOR_NAME_LEN		32
+#define MOTOR_FRIC_LUT		256			// intervals of the static friction table
+#define MOTOR_FRIC_RANGE	4.0			// the table covers +-MOTOR_FRIC_RANGE smoothing velocities
+#define MOTOR_FRIC_SMOOTH	(0.05)		// rad/s, the static friction is tanh(vel/MOTOR_FRIC_SMOOTH)
+
+// One identified parameter set; [0] for positive torques, [1] for negative
+typedef struct{
+	char name[MOTOR_NAME_LEN];
+	double km[2];			// Nm/A
+	double dynFric[2];		// dynamic friction
+	double statFric[2];		// static friction
+}MotorParams;
+
+///////////////////////////////////////////////////////////////////////////////
+// The motor model of the feedforward current.  The parameter sets are read
+// from a file at start-up, one per line:
+//
+//   name km_pos dyn_fric_pos stat_fric_pos km_neg dyn_fric_neg stat_fric_neg
+//
+// and one of them is selected at run time.  The static friction goes through
+// tanh(vel/MOTOR_FRIC_SMOOTH), looked up in a table made once and
+// interpolated, instead of sign(vel): no chatter around vel = 0 and no branch
+// on the sign.  The coefficients of the loop are double buffered: Select()
+// fills the idle buffer and then switches mActive, so it can be called from
+// the user interface while Current() runs, and Current() never waits.
+///////////////////////////////////////////////////////////////////////////////
+class MotorModel{
+	public:
+		MotorModel();
+
+		// return: the number of sets read, or -1 if the file cannot be read
+		int Load(const char *path);
+
+		// return: 1, or -1 for no such set
+		int Select(int set);
+		int Select(const char *name);
+		int Selected(){ return mSelected; }
+		int Count(){ return mCount; }
+		void Print();
+
+		// of the control loop
+		double Current(double vel, double accel);
+		double Friction(double vel);
+
+	private:
+		MotorParams mSet[MOTOR_MAX_SETS];
+		int mCount;
+		int mSelected;
+
+		// of the selected set, divided by km
+		struct Coeff{
+			double inertia[2];
+			double dyn[2];
+			double stat[2];
+		};
+		Coeff mCoeff[2];
+		volatile int mActive;
+
+		double mLut[MOTOR_FRIC_LUT + 2];
+		double mLutScale;
+};
+
+extern MotorModel *MOTOR;
 
 double calcI(double vel, double accel);
 double sign(double vel);
@@ -45,6 +45,7 @@ Calibration::Calibration(Size grid, int nimgs, bool prompt, bool save_views)
 * This functions will set the following members to these default values:
 *
 *	views.save_views = false;
+*	views.spread = 0.05;
 *
 *	find_chessboard.flags = 0;
 *	find_chessboard.grid = Size(0, 0);
@@ -67,6 +68,7 @@ void Calibration::setDefaults()
 	views.n = 0;
 	views.prompt = false;
 	views.save_views = false;
+	views.spread = 0.05;
 
 	find_chessboard.flags = 0;
 	find_chessboard.grid = Size(0, 0);
@@ -86,6 +88,9 @@ void Calibration::setDefaults()
 
 	intrinsic_params.file = "";
 	extrinsic_params.file = "";
+
+	residuals.sum = 0;
+	residuals.n = 0;
 }
 
 void Calibration::setGridSize(Size grid)
@@ -105,6 +110,10 @@ void Calibration::clearVectors()
 	views.world.clear();
 	calib_cam.rvecs.clear();
 	calib_cam.tvecs.clear();
+	residuals.point.clear();
+	residuals.view.clear();
+	residuals.sum = 0;
+	residuals.n = 0;
 }
 
 /**
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cmath>
+#include "Calibration.h"
+
+using std::vector;
+using cv::Point2f;
+using cv::Size;
+
+/** @brief the dots the spacing of the grid is estimated from */
+#define SEEDS 9
+/** @brief how far from where the lattice predicts it a dot may be, in steps */
+#define STEP_TOL 0.3f
+/** @brief the sine of the smallest angle between the two axes of the lattice */
+#define MIN_SIN 0.7f
+
+namespace {
+
+/**
+* @brief The dots in square cells as large as the spacing of the grid, so
+* the dots near a point are found by looking at the cells around it instead
+* of at every dot.  The dots of a cell are stored one after the other, cell
+* by cell, so the hash is two arrays.
+*/
+struct CellHash {
+	float x0, y0, side;
+	int cols, rows;
+	vector<int> start; /**< the first dot of every cell in dots, and one past the last */
+	vector<int> dots; /**< the indices of the dots, cell by cell */
+
+	int cell(const Point2f& p) const
+	{
+		int c = static_cast<int> ((p.x - x0) / side);
+		int r = static_cast<int> ((p.y - y0) / side);
+		return (c < 0 || r < 0 || c >= cols || r >= rows) ? -1 : r * cols + c;
+	}
+
+	/** @brief false if the dots are spread too far for cells of side */
+	bool build(const vector<Point2f>& pts, float s)
+	{
+		size_t i;
+		float x1, y1;
+		vector<int> fill;
+
+		x0 = x1 = pts[0].x;
+		y0 = y1 = pts[0].y;
+		for(i = 1; i < pts.size(); ++i) {
+			x0 = std::min(x0, pts[i].x);
+			x1 = std::max(x1, pts[i].x);
+			y0 = std::min(y0, pts[i].y);
+			y1 = std::max(y1, pts[i].y);
+		}
+
+		side = s;
+		cols = static_cast<int> ((x1 - x0) / s) + 1;
+		rows = static_cast<int> ((y1 - y0) / s) + 1;
+		if(static_cast<double> (cols) * rows > 64.0 * pts.size() + 64) {
+			// a far outlier, not a grid
+			return false;
+		}
+
+		start.assign(cols * rows + 1, 0);
+		for(i = 0; i < pts.size(); ++i) {
+			++start[cell(pts[i]) + 1];
+		}
+		for(i = 1; i < start.size(); ++i) {
+			start[i] += start[i - 1];
+		}
+
+		fill.assign(start.begin(), start.end() - 1);
+		dots.resize(pts.size());
+		for(i = 0; i < pts.size(); ++i) {
+			dots[fill[cell(pts[i])]++] = static_cast<int> (i);
+		}
+
+		return true;
+	}
+
+	/** @brief the dot nearest p within radius, or -1 */
+	int nearest(const vector<Point2f>& pts, const Point2f& p, float radius, int skip = -1) const
+	{
+		int c0, c1, r0, r1, c, r, k, best = -1;
+		float d, dx, dy, best_d = radius * radius;
+
+		c0 = std::max(static_cast<int> ((p.x - radius - x0) / side), 0);
+		c1 = std::min(static_cast<int> ((p.x + radius - x0) / side), cols - 1);
+		r0 = std::max(static_cast<int> ((p.y - radius - y0) / side), 0);
+		r1 = std::min(static_cast<int> ((p.y + radius - y0) / side), rows - 1);
+
+		for(r = r0; r <= r1; ++r) {
+			for(c = c0; c <= c1; ++c) {
+				for(k = start[r * cols + c]; k < start[r * cols + c + 1]; ++k) {
+					if(dots[k] == skip) {
+						continue;
+					}
+					dx = pts[dots[k]].x - p.x;
+					dy = pts[dots[k]].y - p.y;
+					d = dx * dx + dy * dy;
+					if(d < best_d) {
+						best_d = d;
+						best = dots[k];
+					}
+				}
+			}
+		}
+
+		return best;
+	}
+};
+
+float length(const Point2f& p)
+{
+	return std::sqrt(p.x * p.x + p.y * p.y);
+}
+
+/** @brief the median distance from SEEDS dots spread over pts to their nearest dot */
+float spacing(const vector<Point2f>& pts)
+{
+	size_t i, j, s, n = std::min<size_t> (pts.size(), SEEDS);
+	float d, best;
+	vector<float> dist;
+
+	for(i = 0; i < n; ++i) {
+		s = i * pts.size() / n;
+		best = -1;
+		for(j = 0; j < pts.size(); ++j) {
+			d = length(pts[j] - pts[s]);
+			if(j != s && (best < 0 || d < best)) {
+				best = d;
+			}
+		}
+		dist.push_back(best);
+	}
+
+	std::nth_element(dist.begin(), dist.begin() + n / 2, dist.end());
+	return dist[n / 2];
+}
+
+}
+
+/**
+* Puts the dot centers of a grid pattern in the order findChessboardCorners
+* gives the corners of a chessboard, row by row with grid.width dots each,
+* so a polka dot view is used like a chessboard view.  The centers can be in
+* any order.
+*
+* The spacing of the grid is the median distance from a few dots to their
+* nearest dot, and the two axes of the lattice are the steps from the dot
+* nearest the middle to its nearest neighbor and to the neighbor most
+* across from it.  The lattice is then walked from that dot: every dot
+* predicts its four neighbors with the steps it was reached by, and the dot
+* nearest a prediction, within STEP_TOL of a step, is the neighbor.  The
+* steps follow the perspective of the board from dot to dot.  The dots near
+* a prediction are looked up in a hash of cells as large as the spacing,
+* so ordering n dots takes about O(n) instead of sorting them by distance.
+*
+* The axis with grid.width dots becomes the rows, the one more along x if
+* the grid is square, and the first dot of a row is the one farthest left
+* and the first row the one on top, as far as the axes point that way.
+*
+* @param[in] centers the dot centers, grid.area() of them
+* @param[in] grid the columns and rows of dots
+* @param[out] ordered the centers in grid order, untouched on failure
+* @return false, if the centers are not a grid of that size
+*/
+
+bool Calibration::orderGrid(const vector<Point2f>& centers, Size grid,
+	vector<Point2f>& ordered)
+{
+	size_t i, n = centers.size();
+	int j, k, seed, cur, c, r, minc, maxc, minr, maxr;
+	float s, best, d, len_u, len_v;
+	Point2f mid(0, 0), u, v, w, step, pred;
+	CellHash hash;
+	vector<int> col, row, queue, slot;
+	vector<Point2f> su, sv;
+	static const int dc[4] = {1, -1, 0, 0};
+	static const int dr[4] = {0, 0, 1, -1};
+
+	if(grid.width < 2 || grid.height < 2 || n != static_cast<size_t> (grid.area())) {
+		return false;
+	}
+
+	s = spacing(centers);
+	if(s <= 0 || !hash.build(centers, s)) {
+		return false;
+	}
+
+	// the dot nearest the middle has neighbors on every side
+	for(i = 0; i < n; ++i) {
+		mid += centers[i];
+	}
+	mid *= 1.0f / n;
+	seed = 0;
+	for(i = 1; i < n; ++i) {
+		if(length(centers[i] - mid) < length(centers[seed] - mid)) {
+			seed = static_cast<int> (i);
+		}
+	}
+
+	// the axes, its nearest dot and the one most across from that
+	j = hash.nearest(centers, centers[seed], 1.5f * s, seed);
+	if(j < 0) {
+		return false;
+	}
+	u = centers[j] - centers[seed];
+	len_u = length(u);
+	best = MIN_SIN;
+	v = Point2f(0, 0);
+	for(k = 0; k < static_cast<int> (n); ++k) {
+		w = centers[k] - centers[seed];
+		d = length(w);
+		if(k == seed || d > 1.5f * len_u || d < len_u / 1.5f) {
+			continue;
+		}
+		if(std::abs(u.x * w.y - u.y * w.x) / (len_u * d) > best) {
+			best = std::abs(u.x * w.y - u.y * w.x) / (len_u * d);
+			v = w;
+		}
+	}
+	if(v.x == 0 && v.y == 0) {
+		return false;
+	}
+
+	// walk the lattice
+	col.assign(n, 0);
+	row.assign(n, 0);
+	su.assign(n, u);
+	sv.assign(n, v);
+	slot.assign(n, 0);
+	slot[seed] = 1;
+	queue.push_back(seed);
+	for(i = 0; i < queue.size(); ++i) {
+		cur = queue[i];
+		for(k = 0; k < 4; ++k) {
+			step = su[cur] * static_cast<float> (dc[k]) + sv[cur] * static_cast<float> (dr[k]);
+			pred = centers[cur] + step;
+			j = hash.nearest(centers, pred, STEP_TOL * length(step), cur);
+			if(j < 0) {
+				continue;
+			}
+
+			c = col[cur] + dc[k];
+			r = row[cur] + dr[k];
+			if(slot[j]) {
+				// reached again, it has to be where it was reached first
+				if(col[j] != c || row[j] != r) {
+					return false;
+				}
+				continue;
+			}
+
+			slot[j] = 1;
+			col[j] = c;
+			row[j] = r;
+			su[j] = dc[k] ? (centers[j] - centers[cur]) * static_cast<float> (dc[k]) : su[cur];
+			sv[j] = dr[k] ? (centers[j] - centers[cur]) * static_cast<float> (dr[k]) : sv[cur];
+			queue.push_back(j);
+		}
+	}
+	if(queue.size() != n) {
+		return false;
+	}
+
+	minc = maxc = col[seed];
+	minr = maxr = row[seed];
+	for(i = 0; i < n; ++i) {
+		minc = std::min(minc, col[i]);
+		maxc = std::max(maxc, col[i]);
+		minr = std::min(minr, row[i]);
+		maxr = std::max(maxr, row[i]);
+	}
+
+	// u runs along the rows unless the extents or, for a square grid, x say otherwise
+	len_v = length(v);
+	if(maxc - minc + 1 == grid.height && maxr - minr + 1 == grid.width &&
+		(grid.width != grid.height || std::abs(v.x) / len_v > std::abs(u.x) / len_u)) {
+		col.swap(row);
+		std::swap(minc, minr);
+		std::swap(maxc, maxr);
+		std::swap(u, v);
+	}
+	if(maxc - minc + 1 != grid.width || maxr - minr + 1 != grid.height) {
+		return false;
+	}
+
+	// left to right and top to bottom
+	slot.assign(n, -1);
+	for(i = 0; i < n; ++i) {
+		c = (u.x >= 0) ? col[i] - minc : maxc - col[i];
+		r = (v.y >= 0) ? row[i] - minr : maxr - row[i];
+		if(slot[r * grid.width + c] >= 0) {
+			return false;
+		}
+		slot[r * grid.width + c] = static_cast<int> (i);
+	}
+
+	ordered.resize(n);
+	for(i = 0; i < n; ++i) {
+		ordered[i] = centers[slot[i]];
+	}
+
+	return true;
+}
@@ -0,0 +1,226 @@
+#include "Calibration.h"
+#include "WorkerPool.h"
+
+using std::vector;
+using cv::Mat;
+using cv::Point2f;
+
+namespace {
+
+/** @brief shared by the parts of one evaluate(...) */
+struct Evaluation {
+	Calibration* calib;
+	Mat rvec; /**< the pose of the views without one of their own */
+	Mat tvec;
+};
+
+/**
+* The pose of view i: its own from getIntrinsics(...) or addView(...), or
+* the pose of the extrinsic parameters, which reproject(...) uses for every
+* view.
+*/
+
+void pose(const Calibration& calib, const Evaluation& e, size_t i,
+	const Mat*& rvec, const Mat*& tvec)
+{
+	const vector<Mat>& rvecs = calib.calib_cam.rvecs;
+	const vector<Mat>& tvecs = calib.calib_cam.tvecs;
+
+	if(i < rvecs.size() && i < tvecs.size() && !rvecs[i].empty() && !tvecs[i].empty()) {
+		rvec = &rvecs[i];
+		tvec = &tvecs[i];
+	}
+	else {
+		rvec = &e.rvec;
+		tvec = &e.tvec;
+	}
+}
+
+/** @brief the errors of view i, written to its own entries of residuals only */
+void residual(Calibration& calib, const Evaluation& e, size_t i)
+{
+	const Mat* rvec;
+	const Mat* tvec;
+	vector<Point2f> projected;
+	vector<Point2f>& err = calib.residuals.point[i];
+	const vector<Point2f>& p = calib.views.pixel[i];
+	double sum = 0;
+
+	err.clear();
+	pose(calib, e, i, rvec, tvec);
+	if(!calib.views.world[i].empty()) {
+		cv::projectPoints(Mat(calib.views.world[i]), *rvec, *tvec,
+			calib.intrinsic_params.A, calib.intrinsic_params.k, projected);
+	}
+
+	err.resize(p.size());
+	for(size_t j = 0; j < p.size() && j < projected.size(); ++j) {
+		err[j] = projected[j] - p[j];
+		sum += err[j].x * err[j].x + err[j].y * err[j].y;
+	}
+	calib.residuals.view[i] = sum;
+}
+
+/** @brief part p evaluates the views p, p + parts, ... */
+void job(void* ctx, int part, int parts)
+{
+	Evaluation* e = static_cast<Evaluation*> (ctx);
+	size_t n = e->calib->views.pixel.size();
+
+	for(size_t i = part; i < n; i += parts) {
+		residual(*e->calib, *e, i);
+	}
+}
+
+/** @brief the pose of the extrinsic parameters, or none */
+void extrinsicPose(const Calibration& calib, Evaluation& e)
+{
+	if(!calib.extrinsic_params.R.empty() && !calib.extrinsic_params.t.empty()) {
+		cv::Rodrigues(calib.extrinsic_params.R, e.rvec);
+		e.tvec = calib.extrinsic_params.t;
+	}
+	else {
+		e.rvec = Mat::zeros(3, 1, CV_64FC1);
+		e.tvec = Mat::zeros(3, 1, CV_64FC1);
+	}
+}
+
+}
+
+/**
+* Reprojects the world points of every view with the intrinsic parameters
+* and the pose of the view and keeps the error of every point in
+* residuals, like reproject(...) but without drawing or printing, on a
+* WorkerPool of threads threads.  Every thread evaluates whole views, so
+* hundreds of views take about the time of one per core.  After a tweak of
+* intrinsic_params the views are evaluated again with this; after a view
+* was added or removed, see addView(...) and removeView(...).
+*
+* The pose of view i is calib_cam.rvecs[i] and calib_cam.tvecs[i] as
+* getIntrinsics(...) leaves them, or the extrinsic parameters for the
+* views without one.
+*
+* @param[in] threads the number of threads, or 0 for one per core
+* @return the RMS reprojection error of all points, see rms(...)
+*/
+
+double Calibration::evaluate(int threads)
+{
+	size_t i, n = views.pixel.size();
+	Evaluation e;
+
+	CV_Assert(views.world.size() == n);
+	residuals.point.resize(n);
+	residuals.view.assign(n, 0);
+	e.calib = this;
+	extrinsicPose(*this, e);
+
+	if(threads <= 0) {
+		threads = WorkerPool::cores();
+	}
+	if(threads > 1 && n > 1) {
+		WorkerPool pool(threads);
+		pool.run(job, &e);
+	}
+	else {
+		job(&e, 0, 1);
+	}
+
+	residuals.sum = 0;
+	residuals.n = 0;
+	for(i = 0; i < n; ++i) {
+		residuals.sum += residuals.view[i];
+		residuals.n += residuals.point[i].size();
+	}
+
+	return rms();
+}
+
+/**
+* Finds the pose of view i with the current intrinsic parameters and puts
+* its errors into residuals, without evaluating the other views again.  A
+* view is usually added by appending its points to views.world and
+* views.pixel and calling this with the index of the new view; a view that
+* was evaluated before is replaced.
+*
+* @param[in] i the view
+* @return the RMS reprojection error of all points
+*/
+
+double Calibration::addView(size_t i)
+{
+	size_t n = views.pixel.size();
+	Evaluation e;
+
+	CV_Assert(i < n && views.world.size() == n);
+	if(residuals.view.size() != n) {
+		residuals.point.resize(n);
+		residuals.view.resize(n, 0);
+	}
+	if(calib_cam.rvecs.size() < n) {
+		calib_cam.rvecs.resize(n);
+		calib_cam.tvecs.resize(n);
+	}
+
+	// take the old errors of the view out
+	residuals.sum -= residuals.view[i];
+	residuals.n -= residuals.point[i].size();
+
+	cv::solvePnP(Mat(views.world[i]), Mat(views.pixel[i]), intrinsic_params.A,
+		intrinsic_params.k, calib_cam.rvecs[i], calib_cam.tvecs[i], false);
+	e.calib = this;
+	residual(*this, e, i);
+
+	residuals.sum += residuals.view[i];
+	residuals.n += residuals.point[i].size();
+	return rms();
+}
+
+/**
+* Removes view i from views, its pose from calib_cam and its errors from
+* residuals.  The views after it move down by one.
+*
+* @param[in] i the view
+* @return the RMS reprojection error of the points left
+*/
+
+double Calibration::removeView(size_t i)
+{
+	CV_Assert(i < views.pixel.size() && views.world.size() == views.pixel.size());
+
+	if(i < residuals.view.size()) {
+		residuals.sum -= residuals.view[i];
+		residuals.n -= residuals.point[i].size();
+		residuals.view.erase(residuals.view.begin() + i);
+		residuals.point.erase(residuals.point.begin() + i);
+	}
+	if(i < calib_cam.rvecs.size() && i < calib_cam.tvecs.size()) {
+		calib_cam.rvecs.erase(calib_cam.rvecs.begin() + i);
+		calib_cam.tvecs.erase(calib_cam.tvecs.begin() + i);
+	}
+	if(views.imgs.size() == views.pixel.size()) {
+		views.imgs.erase(views.imgs.begin() + i);
+	}
+	views.world.erase(views.world.begin() + i);
+	views.pixel.erase(views.pixel.begin() + i);
+
+	return rms();
+}
+
+/**
+* The RMS reprojection error in pixels of view, or of all views for a
+* negative view, as evaluate(...), addView(...) and removeView(...) left
+* residuals.
+*/
+
+double Calibration::rms(int view) const
+{
+	if(view < 0) {
+		return residuals.n > 0 ? sqrt(std::max(residuals.sum, 0.0) / residuals.n) : 0;
+	}
+
+	if(static_cast<size_t> (view) >= residuals.view.size() || residuals.point[view].empty()) {
+		return 0;
+	}
+	return sqrt(residuals.view[view] / residuals.point[view].size());
+}
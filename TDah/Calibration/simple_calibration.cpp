@@ -26,6 +26,7 @@ bool simple_intrinsic(Calibration& calib, VideoCapture* cap)
 
 	// get chessboard views
 	//n = calib.getClickViews(cap, "intrinsic");
+	//n = calib.getChessboardViewsParallel(cap, 0, "intrinsic");
 	n = calib.getClickViewsAuto(cap, "intrinsic");
 	//n = calib.getPolkaDotViews(cap, "intrinsic");
 	if( n != calib.views.n ) {
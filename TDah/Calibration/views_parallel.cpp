@@ -0,0 +1,243 @@
+#include "Calibration.h"
+#include "WorkerPool.h"
+
+using std::vector;
+using std::string;
+using cv::Mat;
+using cv::Point2f;
+using cv::Size;
+using cv::VideoCapture;
+
+extern void cvt(Mat& src, Mat& dst);
+
+/** @brief the number of values describing where a chessboard is in a view */
+#define POSE_SIZE 5
+
+namespace {
+
+/** @brief frames captured together and what was detected in them */
+struct Batch {
+	vector<Mat> imgs;
+	vector<vector<Point2f>> corners;
+	vector<char> found;
+	int n; /**< the number of frames captured */
+};
+
+/** @brief shared by the parts of one run of the pool */
+struct Pipeline {
+	Calibration* calib;
+	VideoCapture* cam;
+	Batch* front; /**< the batch being detected */
+	Batch* back; /**< the batch being captured */
+	bool capture; /**< if true, part 0 captures the back batch */
+};
+
+/** @brief captures up to b.imgs.size() frames into b */
+void capture(VideoCapture* cam, Batch& b)
+{
+	Mat img;
+
+	for(b.n = 0; b.n < static_cast<int> (b.imgs.size()); ++b.n) {
+		*cam >> img;
+		if(img.empty()) {
+			break;
+		}
+
+		// the camera may reuse the buffer of img for the next frame
+		img.copyTo(b.imgs[b.n]);
+	}
+}
+
+/** @brief finds the chessboard of one frame with subpixel accuracy */
+void detect(const Calibration& calib, Batch& b, int i)
+{
+	Mat& img = b.imgs[i];
+	Mat gray;
+
+	if(img.type() == CV_8UC3) {
+		cvt(img, gray);
+	}
+	else {
+		gray = img;
+	}
+
+	b.found[i] = cv::findChessboardCorners(gray, calib.find_chessboard.grid,
+		b.corners[i]);
+	if(b.found[i]) {
+		cv::cornerSubPix(gray, b.corners[i], calib.sub_pixel.win,
+			calib.sub_pixel.zz, calib.sub_pixel.crit);
+	}
+}
+
+/**
+* Part 0 captures the next batch while all parts detect the frames of the
+* current one, part p the frames p, p + parts, ...  Capturing holds part 0
+* for about the time the camera takes to deliver the batch, so it detects
+* its frames last.
+*/
+
+void job(void* ctx, int part, int parts)
+{
+	Pipeline* p = static_cast<Pipeline*> (ctx);
+
+	if(part == 0 && p->capture) {
+		capture(p->cam, *p->back);
+	}
+
+	for(int i = part; i < p->front->n; i += parts) {
+		detect(*p->calib, *p->front, i);
+	}
+}
+
+/**
+* Describes where a chessboard is in a view: the center of its corners and
+* its size as fractions of the image, and how much nearer the camera one
+* side of it is than the opposite side, horizontally and vertically.
+*/
+
+void pose(const vector<Point2f>& c, Size grid, Size img, double d[POSE_SIZE])
+{
+	int cols = grid.width;
+	int n = grid.area();
+	Point2f tl = c[0], tr = c[cols - 1], bl = c[n - cols], br = c[n - 1];
+	double top, bottom, left, right, area;
+
+	Point2f center(0, 0);
+	for(int i = 0; i < n; ++i) {
+		center += c[i];
+	}
+
+	top = cv::norm(tr - tl);
+	bottom = cv::norm(br - bl);
+	left = cv::norm(bl - tl);
+	right = cv::norm(br - tr);
+
+	// the shoelace formula for the outer corners
+	area = 0.5 * fabs((tl.x - br.x) * (tr.y - bl.y) - (tr.x - bl.x) * (tl.y - br.y));
+
+	d[0] = center.x / n / img.width;
+	d[1] = center.y / n / img.height;
+	d[2] = sqrt(area / img.area());
+	d[3] = (left - right) / (left + right);
+	d[4] = (top - bottom) / (top + bottom);
+}
+
+}
+
+/**
+* Collects the same views as getChessboardViews(...), but detects the
+* chessboards on a WorkerPool of threads threads while the calling thread
+* keeps capturing frames, so the camera is read at close to its full frame
+* rate instead of once per detection.  Frames are captured in batches of
+* one frame per thread; while the pool detects the chessboards of a batch,
+* the next batch is captured.
+*
+* Consecutive frames of a camera mostly show the chessboard where it just
+* was, and such views add little to a calibration.  A view is only kept if
+* its chessboard differs from the chessboard of every kept view by at least
+* views.spread in position, size, or tilt, see pose(...), all measured as
+* fractions of the image.  Collecting stops as soon as views.n views were
+* kept, so getIntrinsics(...) can be called right away.
+*
+* views.prompt is ignored, because the frames are detected long after the
+* user saw them.
+*
+* @param[in] cam the camera to take the pictures from
+* @param[in] threads the number of detecting threads, or 0 for one per core
+* @param[in] title appended to the title of the window
+* @return the number of views kept
+*
+* @note to quit the grabbing process at anytime press the 'q' key.
+*/
+
+int Calibration::getChessboardViewsParallel(VideoCapture* cam, int threads,
+											string title)
+{
+	int good_imgs, last;
+	size_t i, j, k;
+	double d, step, spread;
+	bool quit;
+	Mat img, draw_corners;
+	vector<vector<double>> kept;
+	vector<double> desc(POSE_SIZE);
+	Batch batches[2];
+	Pipeline p;
+
+	if(threads <= 0) {
+		threads = WorkerPool::cores();
+	}
+	WorkerPool pool(threads);
+
+	for(i = 0; i < 2; ++i) {
+		batches[i].imgs.resize(pool.size());
+		batches[i].corners.resize(pool.size());
+		batches[i].found.assign(pool.size(), 0);
+		batches[i].n = 0;
+	}
+
+	p.calib = this;
+	p.cam = cam;
+	p.front = &batches[0];
+	p.back = &batches[1];
+	p.capture = true;
+
+	// initialize parameters and create window
+	good_imgs = 0;
+	quit = false;
+	spread = views.spread;
+	cv::namedWindow("calibration" + title, CV_WINDOW_AUTOSIZE);
+
+	capture(cam, *p.front);
+	while(good_imgs < views.n && p.front->n > 0 && !quit) {
+		pool.run(job, &p);
+
+		// keep the found views that are far enough from all kept ones
+		for(j = 0; j < static_cast<size_t> (p.front->n) && good_imgs < views.n; ++j) {
+			if(!p.front->found[j]) {
+				continue;
+			}
+
+			pose(p.front->corners[j], find_chessboard.grid,
+				p.front->imgs[j].size(), &desc[0]);
+			d = spread;
+			for(i = 0; i < kept.size() && d >= spread; ++i) {
+				d = 0;
+				for(k = 0; k < POSE_SIZE; ++k) {
+					step = fabs(desc[k] - kept[i][k]);
+					d = step > d ? step : d;
+				}
+			}
+			if(d < spread) {
+				continue;
+			}
+
+			kept.push_back(desc);
+			views.pixel.push_back(p.front->corners[j]);
+			if(views.save_views) views.imgs.push_back(p.front->imgs[j].clone());
+			good_imgs++;
+		}
+
+		// show the last frame of the batch and, if found, its chessboard
+		last = p.front->n - 1;
+		if(p.front->imgs[last].type() == CV_8UC1) {
+			cvt(p.front->imgs[last], img);
+		}
+		else {
+			img = p.front->imgs[last];
+		}
+		if(!p.front->corners[last].empty()) {
+			draw_corners = Mat(p.front->corners[last]);
+			cv::drawChessboardCorners(img, find_chessboard.grid, draw_corners,
+				p.front->found[last] != 0);
+		}
+		cv::imshow("calibration" + title, img);
+		quit = cv::waitKey(1) == 'q';
+
+		std::swap(p.front, p.back);
+	}
+
+	// can't find cv:: equivalent, so using C version
+	string s = "calibration" + title;
+	cvDestroyWindow(s.c_str());
+	return good_imgs;
+}
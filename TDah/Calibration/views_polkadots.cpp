@@ -55,24 +55,6 @@ static void create_ui( Calibration& calib )
 	cv::createTrackbar("Canny threshold 2", param_win, thr2, WHITE);
 }
 
-/**
-* Sorts the points using a specified origin and the L1 norm
-*/
-
-static void distanceSort(const vector<Point2f>& points, const Point2f& origin, 
-							   vector<int>& index)
-{
-	Point2f d;
-	vector<double> distances;
-	for(size_t j = 0; j < points.size(); j++) {
-		d = points[j] - origin;
-		distances.push_back(std::abs(d.x) + std::abs(d.y));
-	}
-
-	cv::sortIdx(Mat(distances), Mat(index), CV_SORT_EVERY_COLUMN);
-}
-
-
 static void process_image(const Calibration& calib, const Mat& src, Mat& edges)
 {
 	Mat gr;
@@ -103,133 +85,31 @@ static bool is_grid(int ndots, const vector<Vec4i>& hier, int i)
 	return true;
 }
 
-static void draw_points(const vector<int>& indices, 
-						const vector<Point2f>& positions, 
-						const vector<Point2f>& pixels,
-						Mat& dst, 
-						Point2f& shift_x, Point2f& shift_y, Point2f& shift_i)
-{
-	vector<int> labels;
-	stringstream ss;
-	CV_Assert(indices.size() == pixels.size() && 
-		pixels.size() == positions.size());
-
-	labels.assign(indices.size(), 0);
-	for(size_t i = 0; i < labels.size(); ++i) {
-		labels[indices[i]] = i;
-	}
-
-	ss << std::setprecision(3);
-	for(size_t i = 0; i < pixels.size(); ++i) {
-		ss.str("");
-		ss << labels[i];
-		cv::putText(dst, ss.str(), pixels[i], 
-			cv::FONT_HERSHEY_SIMPLEX, 0.30, Scalar(0, 0, 255), 1, CV_AA);
-
-		ss.str("");
-		ss << positions[i].x;
-		cv::putText(dst, ss.str(), pixels[i] + shift_x, 
-			cv::FONT_HERSHEY_SIMPLEX, 0.25, color1, 1, CV_AA);
-
-		ss.str("");
-		ss << positions[i].y;
-		cv::putText(dst, ss.str(), pixels[i] + shift_y, 
-			cv::FONT_HERSHEY_SIMPLEX, 0.25, color2, 1, CV_AA);
-
-		ss.str("");
-		ss << i;
-		cv::putText(dst, ss.str(), pixels[i] + shift_i, 
-			cv::FONT_HERSHEY_SIMPLEX, 0.25, color3, 1, CV_AA);
-	}
-
-	cv::line(dst, pixels[indices[0]], pixels[indices[1]], color2, 1, CV_AA);
-	cv::line(dst, pixels[indices[0]], pixels[indices[2]], color1, 1, CV_AA);
-}
-
-static void draw_coords(Mat& src, vector<Point2f>& centers, Mat& dst, 
-						const Size& grid)
-{
-	Mat sortIdx;
-	vector<double> indx;
-
-	double w = std::abs(src.at<Point2f>(0, 0).x) + 1;
-	for(size_t i = 0; i < centers.size(); ++i) {
-		double x = std::abs(src.at<Point2f>(i, 0).x);
-		double y = std::abs(src.at<Point2f>(i, 0).y);
-		indx.push_back(x + y * w);//grid.width);
-	}
-	cv::sortIdx(Mat(indx), sortIdx, CV_SORT_EVERY_COLUMN | CV_SORT_ASCENDING );
-
-	for(size_t i = 0; i < indx.size(); ++i) {
-		indx[i] = sortIdx.at<int>(i, 0);
-	}
-
-	stringstream *ss;
-	int k = 0;
-	for(int i = 0; i < src.rows; ++i) {
-		for(int j = 0; j < src.cols; ++j) {
-			float x = src.at<Point2f>(i, j).x;
-			float y = src.at<Point2f>(i, j).y;
-			int m = sortIdx.at<int>(k, 0);
-
-			ss = new stringstream;
-			*ss << k;
-			cv::putText(dst, ss->str(), centers[m], 
-				cv::FONT_HERSHEY_SIMPLEX, 0.30, color3, 1, CV_AA);
-			k++;
-			delete ss;
-
-			ss = new stringstream;
-			*ss << std::setprecision(2) << x;
-			cv::putText(dst, ss->str(), centers[m] + Point2f(-10, -10), 
-				cv::FONT_HERSHEY_SIMPLEX, 0.20, color3, 1, CV_AA);
-			delete ss;
-
-			ss = new stringstream;
-			*ss << std::setprecision(2) << y;
-			cv::putText(dst, ss->str(), centers[m] + Point2f(10, 10), 
-				cv::FONT_HERSHEY_SIMPLEX, 0.20, color3, 1, CV_AA);
-			delete ss;
-
-			ss = new stringstream;
-			*ss << m;
-			cv::putText(dst, ss->str(), centers[m] + Point2f(10, 0), 
-				cv::FONT_HERSHEY_SIMPLEX, 0.20, color2, 1, CV_AA);
-			delete ss;
-		}
-	}
-}
-
 int Calibration::getPolkaDotViews(VideoCapture* cam, string title)
 {
-	// NOTE DOES NOT WORK
-	//CV_Assert(false);
-
-	find_chessboard.grid = Size(4, 3); // TODO DELETE
-
 	Mat bgr, edges;
 	vector<vector<Point>> contours;
 	vector<float> radii;
-	vector<Point2f> centers;
+	vector<Point2f> centers, ordered;
 	vector<Vec4i> hierarchy;
-	int ndots, input, n;
-	bool prompt;
+	int ndots, input, n, good_imgs;
+	bool prompt, found;
 
 	// initialize values
 	main_win = "Calibrating: " + title;
 	n = views.n;
 	prompt = views.prompt;
-	input = 0;
+	good_imgs = 0;
 	ndots = find_chessboard.grid.area();
 	radii.assign(ndots, 0);
 	centers.assign(ndots, Point2f());
-	polka_dots.dilate = DILATE;
+	polka_dots.dilate = DILATE;
 	polka_dots.erode = ERODE;
-	polka_dots.thr1 = THR1;
+	polka_dots.thr1 = THR1;
 	polka_dots.thr2 = THR2;
 	create_ui(*this);
 
-	while(1) {
+	while(good_imgs < n) {
 		*cam >> bgr;
 		if(bgr.empty()) {
 			continue;
@@ -241,7 +121,8 @@ int Calibration::getPolkaDotViews(VideoCapture* cam, string title)
 		cv::findContours(edges, contours, hierarchy, 
 			CV_RETR_TREE, CV_CHAIN_APPROX_NONE);
 
-		for(size_t i = 0; i < hierarchy.size(); ++i) {
+		found = false;
+		for(size_t i = 0; i < hierarchy.size() && !found; ++i) {
 			if(!is_grid(ndots, hierarchy, i)) {
 				continue;
 			}
@@ -259,191 +140,34 @@ int Calibration::getPolkaDotViews(VideoCapture* cam, string title)
 			if(mean[0] < MIN_RAD && stddev[0] > STD_ERR) {
 				continue;
 			}
-			// should also do a check for distance between two points
-
-			// everything appears to check out, save view
-			if(views.pixel.empty())
-				views.pixel.push_back(centers);
-			else
-				views.pixel[0] = centers;
-
-			vector<int> sorted_indices(ndots, 0);
-
-			// sort the points according to distance using any reference point
-			size_t ref = 0;
-			Mat(centers) -= Scalar(centers[ref].x, centers[ref].y);
-			distanceSort(centers, Point2f(0, 0), sorted_indices);
-			
-			// now sort using a corner point
-			ref = sorted_indices.back();
-			Mat(centers) -= Scalar(centers[ref].x, centers[ref].y);
-			distanceSort(centers, Point2f(0, 0), sorted_indices);
-
-			// rotate image frame to polka dot frame
-			double scale;
-			double angle;
-			Point2f dir1;
-			Point2f dir2;
-			Range col1(0, 1);
-			Range col2(1, 2);
-			Range rows12 = Range::all();
-			Mat_<double> rot =  Mat_<double>::zeros(2, 2);
-
-			dir1 = centers[sorted_indices[1]];
-			dir2 = centers[sorted_indices[2]];
-			scale = 0.5*(std::sqrt(dir1.x*dir1.x + dir1.y*dir1.y) +
-				std::sqrt(dir2.x*dir2.x + dir2.y*dir2.y));
-			angle = atan2(dir1.x, dir1.y);
-
-			rot(0, 0) = cos(angle);
-			rot(1, 0) = -sin(angle);
-			rot(0, 1) = sin(angle);
-			rot(1, 1) = cos(angle);
-
-
-			cv::normalize(rot(rows12, col1), rot(rows12, col1));
-			cv::normalize(rot(rows12, col2), rot(rows12, col2));
-			cv::transform(Mat(centers), Mat(centers), rot);
-
-			std::cout << "Rot"  << std::endl;
-			for(int i = 0; i < rot.rows; i++) {
-				for(int j = 0; j < rot.cols; j++) {
-					//std::cout << rot(i, j) << "\t";
-				}
-				//std::cout << std::endl;
-			}
-			std::cout << std::endl;
-
-			Mat(centers) /= scale;
-			double lastx = std::abs(centers[sorted_indices.back()].x);
-			double lasty = std::abs(centers[sorted_indices.back()].y);
-			double expectedx = find_chessboard.grid.width - 1;
-			double expectedy = find_chessboard.grid.height - 1;
-
-			std::cout << "expected: " << expectedx << "\t" << expectedy << std::endl;
-			std::cout << "x: " << 
-				(std::abs(centers[sorted_indices.back()].x)) << "\t"
-				<< 	std::abs(lastx - expectedx)
-				<< std::endl;
-
-			std::cout << "y: " << 
-				(std::abs(centers[sorted_indices.back()].y)) << "\t"
-				<< std::abs(lasty - expectedy)
-				<< std::endl;
-
-			// show image
-			vector<double> order1;
-			for(size_t k = 0; k < centers.size(); ++k) {
-				order1.push_back(std::abs(centers[k].x) + std::abs(centers[k].y) * 
-					(lastx+1));
-			}
-
-			cv::sortIdx(Mat(order1), Mat(sorted_indices), 
-				CV_SORT_EVERY_COLUMN | CV_SORT_ASCENDING );
-			Mat temp1 = bgr.clone();
-			draw_points(sorted_indices, centers, views.pixel.back(), temp1,
-				Point2f(0, -10), Point2f(0, 10), Point2f(15, 0));
-			std::cout << "before" << std::endl;
-			cv::imshow(main_win, temp1);
-
-			cv::waitKey(0);
-
-			if(std::abs(lastx - expectedx) > 0.5 &&
-				std::abs(lasty - expectedy) > 0.5 ) {
-					// rotate if not in grid layout
-					rot(0, 0) = cos(CV_PI / 2);
-					rot(1, 0) = -sin(CV_PI / 2);
-					rot(0, 1) = sin(CV_PI / 2);
-					rot(1, 1) = cos(CV_PI / 2);
-					cv::transform(Mat(centers), Mat(centers), rot);
-					std::cout << "rotate by 90" << std::endl;
-			}
-
-			distanceSort(centers, Point2f(0, 0), sorted_indices);
 
-			vector<double> order;
-			for(size_t k = 0; k < centers.size(); ++k) {
-				order.push_back(std::abs(centers[k].x) + std::abs(centers[k].y) * 
-					find_chessboard.grid.width);
-			}
+			// the dots in the order of the corners of a chessboard view
+			found = orderGrid(centers, find_chessboard.grid, ordered);
+		}
 
-			cv::sortIdx(Mat(order), Mat(sorted_indices), 
-				CV_SORT_EVERY_COLUMN | CV_SORT_ASCENDING );
+		if(found) {
+			// store pixel locations, like a chessboard view
+			views.pixel.push_back(ordered);
+			if(views.save_views) views.imgs.push_back(bgr.clone());
+			good_imgs++;
 
-			// show image
-			Mat temp = bgr.clone();
-			draw_points(sorted_indices, centers, views.pixel.back(), temp,
-				Point2f(0, -10), Point2f(0, 10), Point2f(15, 0));
-			cv::imshow(main_win, temp);
+			cv::drawChessboardCorners(bgr, find_chessboard.grid, Mat(ordered), true);
+		}
+		cv::imshow(main_win, bgr);
 
-			std::cout << "afters" << std::endl;
+		// prompt user for next step
+		if(found && prompt) {
 			input = cv::waitKey(0);
-			if(input == 'q') break;
-
-
-
-/*
-
-			// the farthest dot is always a corner dot in the grid pattern
-			Point2f corner1 = centers[sorted_indices.back()];
-
-			// sort the points from closest to farthest using a corner point
-			distanceSort(centers, corner1, sorted_indices);
-
-			// the two closest points (not including the origin) will tell us
-			// the direction & orientation of the pattern's reference frame
-			double dist;
-			Range col1(0, 1);
-			Range col2(1, 2);
-			Range rows12 = Range::all();
-			Mat_<double> rot =  Mat_<double>::zeros(2, 2);
-
-			Point2f dir1 = centers[sorted_indices[1]] - corner1;
-			Point2f dir2 = centers[sorted_indices[2]] - corner1;
-
-			rot(0, 0) = dir1.x;
-			rot(1, 0) = dir1.y;
-			rot(0, 1) = dir2.x;
-			rot(1, 1) = dir2.y;
-
-			dist = 0.5 * (cv::norm(rot(rows12, col1)) + 
-				cv::norm(rot(rows12, col2)));
-
-			cv::normalize(rot(rows12, col1), rot(rows12, col1));
-			cv::normalize(rot(rows12, col2), rot(rows12, col2));
-
-			Mat dst;
-			cv::transform(Mat(centers) - Scalar(corner1.x, corner1.y), dst, rot);
-			dst *= 1/dist;
-
-
-			if(std::abs(dst.at<Point2f>(ndots - 1, 0).x) 
-				!= find_chessboard.grid.width - 1 &&
-				std::abs(dst.at<Point2f>(ndots - 1, 0).y) 
-				!= find_chessboard.grid.height - 1) {
-					rot(0, 0) = cos(CV_PI / 2);
-					rot(1, 0) = sin(CV_PI / 2);
-					rot(0, 1) = -sin(CV_PI / 2);
-					rot(1, 1) = cos(CV_PI / 2);
-					//cv::transform(dst, dst, rot);
-			}
-
-  			draw_coords(dst, centers, bgr, find_chessboard.grid);
-
-			cv::drawContours( bgr, contours, i, color2, 1, 8, hierarchy, 0 );
-			cv::imshow(main_win, bgr);
-
-			input = cv::waitKey(10);
-			if(input == 'q') break;
-			cv::waitKey(0);
-*/
+			if(input == 'i') 
+				good_imgs--; // ignore image
+			else if(input == 'q') 
+				break; // quit
 		}
+		else if(cv::waitKey(10) == 'q') 
+			break;
 
-		if(input == 'q' || cv::waitKey(10) == 'q') break;
-
-		//cv::imshow(main_win, bgr);
 		contours.clear();
 	}
 
-	return 0;
+	return good_imgs;
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "Dots.h"
 #include "Camera.h"
 #include "Tracker.h"
+#include "OverlayRenderer.h"
 #include "TrackingAlgs/TrackDot.h"
 #include "Calibration.h"
 
@@ -18,8 +19,9 @@ static bool calibrate(VideoCapture& cap, Camera& cam);
 
 int main()
 {
-	// all images are Mat objects in OpenCV's C++ documentation
-	Mat img;
+	// the overlay is drawn and shown on a thread of its own, at most 30 times a
+	// second, so showing the dots does not slow down tracking them
+	OverlayRenderer overlay;
 
 	// choose a video source and tracking algorithm
 	VideoCapture webcam(0); // use the default OpenCV camera source, e.g. webcam
@@ -45,6 +47,9 @@ int main()
 	}
 
 	// track dots across NIMGS images and quit demo
+	if(!overlay.start(OverlayRenderer::defaults())) {
+		return -4;
+	}
 	for(int i = 1; i <= NIMGS; ++i) {
 		// grab the next image and add the dots to the active set
 		// note that the parameters are handled internally by the camera 
@@ -56,9 +61,7 @@ int main()
 
 		// track and show the dots
 		tracker.track(cam, dots);
-		tracker.draw(cam, dots, img);
-		imshow("Dots", img);
-		waitKey(1);
+		overlay.post(cam, dots);
 
 		// print out location information of active dots
 		std::cout << tracker.str(dots);
@@ -4,9 +4,12 @@
 #include "Dots.h"
 #include "Camera.h"
 #include "Tracker.h"
+#include "OverlayRenderer.h"
 #include "TrackingAlgs/TrackDot.h"
 #include "Cameras/VideoCaptureMe3.h"
 #include "Calibration.h"
+#include "TracePoint.h"
+#include "RtProfile.h"
 
 #define NDOTS 2
 #define ROIW 40
@@ -19,15 +22,21 @@
 using namespace cv;
 
 static bool calibrate(VideoCaptureMe3& cap, Camera& cam);
-static int increase_priority();
 
 int main()
 {
-	// make sure thread/process gets a lot of attention from the OS
-	increase_priority();
-
-	// all images are Mat objects in OpenCV's C++ documentation
-	Mat img;
+	// make sure thread/process gets a lot of attention from the OS;
+	// main is the acquisition thread, put it on the last core
+	RtProfileConfig rtc;
+	rt_profile_defaults(&rtc);
+	rtc.cpu = RT_LAST_CPU;
+	RtProfile rt;
+	rt_profile_apply(&rt, &rtc);
+	rt_profile_report(&rt, stdout);
+
+	// the overlay is drawn and shown on a thread of its own, at most 30 times a
+	// second, so showing the dots does not slow down tracking them
+	OverlayRenderer overlay;
 
 	// ** choose a video source and tracking algorithm **
 	// use the Silicon Software MicroEnable 3 frame grabber's 
@@ -66,36 +75,32 @@ int main()
 	}
 
 	// ** initialize the camera's ROIs to the position of the active dots **
-	// The first two dots are written to the camera and the rest of the dots
-	// are placed in a queue and written to the camera in FIFO order.
-	if(NDOTS == 2) {
-		// for tracking only two dots (ever) a special case in the
-		// queueing order is hit where the sequence of tracking becomes
-		// first dot, second dot, first dot, first dot, as oppose to the
-		// two dots alternating (i.e., first dot, second dot, first dot,...),
-		// this function setup avoids that problem.  Note that if new dots are
-		// added they are currently not active until the fifth image
-		if(!me3.set2Rois(dots, Size(ROIW, ROIH), EXPOSURE, FRAME)) {
-			// couldn't write ROIs to the camera
-			return -4;
-		}
-	}
-	else {
-		if(!me3.setRois(dots, Size(ROIW, ROIH), EXPOSURE, FRAME)) {
-			return -4;
-		}
+	// setRois sets the ROI size and timing and writes the first two dots to
+	// the camera.  schedule then gives each of (up to eight) dots its own ROI,
+	// imaged in turn, so the dots alternate without the queue deciding the
+	// order.  A dot that moves fast can be imaged more often, e.g., with
+	// me3.priority(tag, 2) it gets two images for every image of the others,
+	// which takes effect without restarting the camera.
+	if(!me3.setRois(dots, Size(ROIW, ROIH), EXPOSURE, FRAME) ||
+		!me3.schedule(dots)) {
+		// couldn't write ROIs to the camera
+		return -4;
 	}
-	// calling setRois or set2Rois stops the camera from taking pictures,
-	// so need to manually restart the image acquisition process again.
-	// In fact, anytime the buffer size, image width, or image height is 
-	// changed the image, the image acquisition has to be stopped and the 
-	// user must restart the camera.
+	// the buffers hold the largest image, so setRois only has to stop the
+	// camera when the number of buffers changes.  start does nothing while
+	// the camera is still taking pictures, so always call it after changing
+	// the buffer size, image width, or image height.
 	if(!me3.start()) {
 		// couldn't start image acquisition
 		return -5;
 	}
+	if(!overlay.start(OverlayRenderer::defaults())) {
+		return -6;
+	}
 
 	// ** track dots across NIMGS images and quit demo **
+	// with TRACE_POINTS defined the grab and track latencies are saved to me3.trc
+	TRACE_START("me3.trc");
 	bool toggle = true;
 	for(int i = 1; i <= NIMGS; ++i) {
 		// output digital signal, useful for measuring cycle time on a 'scope.
@@ -118,28 +123,23 @@ int main()
 		}
 
 		// add dots to the ROI queue to eventually be written to the camera
-		// This is * very * important.  Dots are removed from the queue, but 
-		// the user must add the dots back onto the queue in order for a dot(s)
-		// to be tracked in the future.  If the queue is ever empty the last two 
-		// dot locations will be where the images will be transferred from, but 
-		// not necessary in an alternating order.
+		// This is * very * important.  With the dots scheduled every dot's ROI
+		// only moves when the dot is added, so a dot that is not added back
+		// is imaged at its old position.
 		me3.add(dots);
 
 		// ** show the dots **
 		// at this point the positions of the active dots are available and the
 		// user can send this data through their communication layer
-		tracker.draw(cam, dots, img);
-		if(img.empty()) {
-			return -6;
-		}
-
-		imshow("Dots", img);
-		waitKey(1);
+		overlay.post(cam, dots);
 
 		// print out location information of active dots
 		std::cout << tracker.str(dots) << std::endl;
 	}
+	TRACE_STOP();
+	overlay.stop();
 
+	rt_profile_revert(&rt);
 	return 0;
 }
 
@@ -197,19 +197,3 @@ bool calibrate(VideoCaptureMe3& cap, Camera& cam)
 
 	return false;
 }
-
-int increase_priority()
-{
-	// change priority and thread class  -- WINDOWS only --
-	int rc = SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS );
-	if(rc == FALSE) {
-      return GetLastError();
-	}
-
-	rc = SetThreadPriority(GetCurrentThread(), HIGH_PRIORITY_CLASS);
-	if(rc == FALSE) {
-      return GetLastError();
-	}
-
-	return 0;
-}
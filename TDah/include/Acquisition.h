@@ -0,0 +1,90 @@
+#ifndef _ACQUISITION_H_
+#define _ACQUISITION_H_
+
+#include <vector>
+#include "_common.h"
+#include "Dots.h"
+
+/**
+* @brief Grabs and tracks one camera on a thread of its own.
+*
+* The usual loop grabs an image, tracks the dots in it, sends or logs them
+* and only then grabs the next image, so the camera waits for every send.
+* An Acquisition runs the grab and track half of the loop on its own thread
+* and hands every tracked frame to next(...), which returns a copy of the
+* dots.  The thread grabs the next image as soon as it published a frame, so
+* whatever the caller does with the dots overlaps with acquiring and
+* tracking the next one:
+*
+* @code
+* Acquisition acq(cam, tracker, dots, addToQueue, &me3);
+* acq.start();
+* while(acq.next(update)) {
+*     send(update); // the next image is already being tracked
+* }
+* @endcode
+*
+* The frames are kept in a ring that only the thread writes and only next()
+* reads, like the rings of a CameraGroup, so neither side takes a lock.  A
+* frame that finds the ring full is dropped and counted by lost().
+*/
+
+class Acquisition
+{
+public:
+	/** @brief called on the thread after it tracked a frame */
+	typedef void (*Tracked)(void* ctx, Camera& cam, Dots& dots);
+
+	/** @brief grabs cam and tracks dots with tracker, which the thread owns */
+	Acquisition(Camera& cam, Tracker& tracker, Dots& dots, Tracked tracked = NULL,
+		void* ctx = NULL);
+	/** @brief stops the thread */
+	~Acquisition();
+
+	/** @brief starts grabbing and tracking from image first_img */
+	bool start(int first_img = 1);
+	/** @brief stops and joins the thread */
+	void stop();
+	/** @brief true between start() and stop() */
+	bool running() const;
+
+	/** @brief waits for the next tracked frame and copies its dots */
+	bool next(Dots& dots, int timeout_ms = 1000);
+	/** @brief waits for the next tracked frame, also returning if every dot was found */
+	bool next(Dots& dots, bool& found, int timeout_ms = 1000);
+	/** @brief the frames dropped because next() did not keep up */
+	long lost() const;
+
+private:
+	/** @brief the dots of one tracked frame */
+	struct Frame {
+		Dots dots;
+		bool found; /**< @brief what Tracker::track(...) returned */
+	};
+
+	Camera* _cam;
+	Tracker* _tracker;
+	Dots* _dots;
+	Tracked _tracked;
+	void* _ctx;
+
+	std::vector<Frame> _frames; /**< @brief a ring of FRAMES frames */
+	volatile long _head; /**< @brief the next frame next() reads */
+	volatile long _tail; /**< @brief the next frame the thread writes */
+	volatile long _lost;
+	volatile bool _quit;
+	int _first_img;
+	void* _thread;
+	void* _ready; /**< @brief signaled when a frame was published */
+
+	/** @brief the loop run by the thread */
+	static unsigned long __stdcall main(void* param);
+	/** @brief copies the dots of the last frame into the ring */
+	void publish(bool found);
+
+	// the thread holds a pointer to the acquisition
+	Acquisition(const Acquisition&);
+	Acquisition& operator=(const Acquisition&);
+};
+
+#endif /* _ACQUISITION_H_ */
@@ -0,0 +1,91 @@
+#ifndef _ANALOGPUBLISHER_H_
+#define _ANALOGPUBLISHER_H_
+
+/**
+* @file AnalogPublisher.h the marker positions as voltages of the analog outputs of an
+* NI-DAQ, shared by TDah and the Jian clients.
+*
+* The positions go over TCP to the qnx controller, which takes a few milliseconds
+* through the two network stacks.  An AnalogPublisher writes them to analog outputs
+* wired to the analog inputs of the controller instead, which reads them right after
+* the frame status (VISION_ANALOG of QnxKit_Analysis/main.h), so the transport is the
+* software-timed write of the DAQ and one conversion of the input board, well under
+* 100 us and the same every frame.
+*
+* The channels are x then y of each marker, like "Dev4/ao0:3" for two markers.  A
+* position is (mm - zero_mm) / mm_per_volt, limited to +-range volts; a marker that
+* was not found is sent as lost_volts, out of that range, so the controller keeps its
+* last position.  The 12 bit inputs of the controller resolve 20 V / 4096, 0.16 mm at
+* the default scale, so the analog path is for the few coordinates the controller
+* cannot wait for, the rest stays on the network.
+*
+* NI-DAQmx is looked up in nicaiu.dll at run time, like the system dlls of
+* RtProfile.h, so the binaries link and run without it; open() fails then.
+*/
+
+typedef void* TaskHandle;
+
+class AnalogPublisher
+{
+public:
+	/** @brief what open() sets up */
+	struct Config {
+		const char* channels; /**< @brief x then y of each marker, like "Dev4/ao0:3" */
+		int markers; /**< @brief channels / 2 */
+		double mm_per_volt;
+		double zero_mm; /**< @brief the position sent as 0 V */
+		double range; /**< @brief V, the limit of a position */
+		double lost_volts; /**< @brief of a marker not found, beyond range */
+	};
+
+	/** @brief Dev4/ao0:3, two markers, 300 mm over 9 V like MM_PER_VOLT of the controller */
+	static Config defaults();
+
+	AnalogPublisher();
+	/** @brief sends every marker lost and clears the task */
+	~AnalogPublisher();
+
+	/** @brief creates and starts the task, returns false if the DAQ or NI-DAQmx is not there */
+	bool open(const Config& cfg);
+	/** @brief sends every marker lost and clears the task */
+	void close();
+	bool isOpen() const { return _task != 0; }
+
+	/** @brief writes the markers of a frame, assign[i] < 0 for the lost ones, like the blob
+	* assignment of a marker matcher */
+	bool publish(int count, const double* x, const double* y, const int* assign);
+
+	/** @brief the writes so far and their time, in us */
+	unsigned int writes() const { return _writes; }
+	unsigned int failures() const { return _failures; }
+	double lastUs() const { return _lastUs; }
+	double maxUs() const { return _maxUs; }
+	void resetTiming() { _maxUs = 0.; }
+
+	/** @brief the extended error information of the last call that failed */
+	const char* error() const;
+
+private:
+	/** @brief the outputs of a task at most, 4 markers */
+	static const int MAX_CHANNELS = 8;
+
+	Config _cfg;
+	TaskHandle _task;
+	double _volts[MAX_CHANNELS];
+	double _ticksPerUs;
+
+	unsigned int _writes;
+	unsigned int _failures;
+	double _lastUs;
+	double _maxUs;
+
+	char _err[2048];
+
+	bool check(int rc, const char* what);
+	bool write();
+
+	AnalogPublisher(const AnalogPublisher&);
+	AnalogPublisher& operator=(const AnalogPublisher&);
+};
+
+#endif /* _ANALOGPUBLISHER_H_ */
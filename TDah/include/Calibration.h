@@ -55,6 +55,7 @@ public:
 		VVP2f pixel; /**< a vector of vectors containing pixel locations */
 		bool save_views; /**< if true, images of the pattern are saved */
 		std::vector<cv::Mat> imgs; /**< a vector of images */
+		double spread; /**< how different kept views must be, see getChessboardViewsParallel */
 	} views; /**< parameters for getChessboardViews */
 
 	struct {
@@ -85,6 +86,13 @@ public:
 		bool useExtGuess; /**< passed to useExtrinsicGuess parameter */
 	} solve_pnp; /**< parameters for solvePnP */
 
+	struct {
+		VVP2f point; /**< the reprojected minus the found pixel of every point, by view */
+		std::vector<double> view; /**< the sum of squared errors of every view */
+		double sum; /**< the sum of squared errors of all views */
+		size_t n; /**< the number of points of all views */
+	} residuals; /**< the reprojection errors, see evaluate */
+
 	/** @brief the constructor */
 	Calibration();
 	Calibration(cv::Size grid, int nimgs = 15, 
@@ -104,8 +112,14 @@ public:
 	bool loadWorldPoints(std::string filename);
 	/** @brief maps world and image points using a chessboard pattern */
 	int getChessboardViews(cv::VideoCapture* cam, std::string title = "");
+	/** @brief maps world and image points using a chessboard pattern, detected in parallel */
+	int getChessboardViewsParallel(cv::VideoCapture* cam, int threads = 0,
+		std::string title = "");
 	/** @brief maps world and image points using a grid pattern */
 	int getPolkaDotViews(cv::VideoCapture* cam, std::string title = "");
+	/** @brief puts the centers of a grid of dots in chessboard corner order */
+	static bool orderGrid(const std::vector<cv::Point2f>& centers, cv::Size grid,
+		std::vector<cv::Point2f>& ordered);
 	/** @brief maps world and image points using an arbitrary grid pattern */
 	int getClickViews(cv::VideoCapture* cam, std::string title = "");
 	/** @brief maps world and image points using an arbitrary grid pattern Automatically*/
@@ -116,6 +130,14 @@ public:
 	double getExtrinsics(const cv::Mat& Tr = cv::Mat());
 	/** @brief reprojects the world points back to the image plane */
 	void reproject(cv::Scalar pixel_color, cv::Scalar reproj_color);
+	/** @brief the reprojection error of every point of every view, in parallel */
+	double evaluate(int threads = 0);
+	/** @brief finds the pose of view i and puts its errors into residuals */
+	double addView(size_t i);
+	/** @brief removes view i along with its pose and errors */
+	double removeView(size_t i);
+	/** @brief the RMS reprojection error of a view, or of all views if view < 0 */
+	double rms(int view = -1) const;
 
 	/** save and load camera parameters **/
 	bool writeExtrinsics();
@@ -1,10 +1,12 @@
 #ifndef _CAMERA_H_
 #define _CAMERA_H_
 
+#include <string>
 #include <vector>
 #include <cv.h>
 #include <highgui.h>
 #include "_common.h"
+#include "ImageView.h"
 
 /**
 * @brief A class for retrieving images and performing camera calibration.
@@ -47,8 +49,19 @@ public:
 	/**@brief sets pixel and world frame equal to each other */
 	void noWorldFrame();
 
+	/** @brief writes the parameters and undistortion map as a binary calibration */
+	bool save(const std::string& file) const;
+	/** @brief maps a binary calibration written by save(...) */
+	bool load(const std::string& file);
+
 	/** @brief converts from pixel to world points */
 	cv::Point3d pixelToWorld(const cv::Point2d& pixel) const;
+	/** @brief converts n pixel points to world points */
+	void pixelToWorld(const cv::Point2d* pixels, cv::Point3d* worlds, size_t n) const;
+	/** @brief looks up the undistortion of a size sensor, an empty size stops it */
+	void undistortMap(const cv::Size& size);
+	/** @brief the world frame ray of the points a pixel sees */
+	void ray(const cv::Point2d& pixel, cv::Point3d& origin, cv::Point3d& dir) const;
 	/** @brief converts from world to pixel points */
 	cv::Point2d worldToPixel(const cv::Point3d& world) const;
 
@@ -61,9 +74,13 @@ public:
 	bool grab();
 	/** @brief calls the underlying camera's retrieve function */
 	bool retrieve(cv::Mat& img, int channel=0);
+	/** @brief the view of an image retrieve(...) returned, placed on the sensor */
+	ImageView view(const cv::Mat& img);
 
 	/** @brief undistorts an image */
 	void undistort(cv::Mat& img);
+	/** @brief undistorts the roi of a whole sensor image, all of it if roi is empty */
+	void undistort(const cv::Mat& src, cv::Mat& dst, const cv::Rect& roi = cv::Rect());
 cv::VideoCapture* _vc; // TODO DELETE
 private:
 	/** @brief the actual camera */
@@ -77,8 +94,30 @@ private:
 	/** @brief world to camera frame translation vector */
 	cv::Mat_<double> _t;
 
+	/** @brief fx, fy, cx and cy of the camera matrix */
+	double _f[4];
+	/** @brief k1, k2, p1, p2 and k3 of the distortion vector */
+	double _d[5];
+	/** @brief world x, world y and their denominator as c0 + c1 x + c2 y of a normalized point */
+	double _w[3][3];
+	/** @brief the normalized point of every pixel, empty when not looked up */
+	cv::Mat_<cv::Vec2f> _map;
+	/** @brief the fixed-point remap tables of undistort(...), empty until an image needs them */
+	cv::Mat _undist_xy;
+	cv::Mat _undist_a;
+
 	/** @brief maps dots to an image */
 	void mapDots(Dots& dots);
+	/** @brief precomputes the parameters used by pixelToWorld */
+	void cache();
+	/** @brief fills the undistortion map for the current parameters */
+	void fillMap(const cv::Size& size);
+	/** @brief builds the remap tables of undistort(...) for a size image */
+	void undistortTables(const cv::Size& size);
+	/** @brief converts a distorted pixel to the normalized camera frame */
+	cv::Point2d normalize(const cv::Point2d& pixel) const;
+	/** @brief sets the parameters and map from the bytes of a binary calibration */
+	bool fromBlob(const char* data, int64 size);
 };
 
 #endif /* _CAMERA_H_ */
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef _CAMERA_GROUP_H_
+#define _CAMERA_GROUP_H_
+
+#include <vector>
+#include <cv.h>
+#include "_common.h"
+
+/**
+* @brief Tracks dots with several synchronized cameras and fuses their views.
+*
+* Every camera of a group grabs and tracks its own Dots on a thread of its
+* own, with a Tracker of its own, and publishes what it found in a ring that
+* only it writes and only grab() reads, so the cameras never wait for each
+* other or for a lock.  grab() matches the frames of all cameras by time
+* stamp and triangulates every dot found by at least two cameras from the
+* rays of its pixels, see Camera::ray(...), into one update of the fused
+* Dots.
+*
+* The Dots of every camera and the fused Dots must have the same dots, a
+* tag is the same dot in all of them.
+*/
+
+class CameraGroup
+{
+public:
+	/** @brief called on a camera's thread after it tracked its dots */
+	typedef void (*Tracked)(void* ctx, Camera& cam, Dots& dots);
+
+	CameraGroup();
+	/** @brief stops the threads of the cameras */
+	~CameraGroup();
+
+	/** @brief adds a camera that tracks dots with tracker, before start() */
+	void add(Camera& cam, Tracker& tracker, Dots& dots, Tracked tracked = NULL,
+		void* ctx = NULL);
+	/** @brief frames whose time stamps differ by at most tol are one update */
+	void tolerance(double tol);
+	/** @brief the number of cameras */
+	int size() const;
+
+	/** @brief starts a grabbing and tracking thread for every camera */
+	bool start();
+	/** @brief stops and joins the threads of the cameras */
+	void stop();
+
+	/** @brief waits for one matched frame of every camera and fuses their dots */
+	bool grab(Dots& dots, int timeout_ms = 1000);
+
+private:
+	/** @brief what a camera found in one frame, by tag */
+	struct Frame {
+		double time_stamp;
+		int image_nbr;
+		std::vector<cv::Point2d> pixel;
+		std::vector<char> found;
+	};
+
+	/** @brief a camera of the group and its thread */
+	struct Member {
+		CameraGroup* group;
+		Camera* cam;
+		Tracker* tracker;
+		Dots* dots;
+		Tracked tracked;
+		void* ctx;
+		void* thread;
+		void* ready; /**< @brief signaled when a frame was published */
+		std::vector<Frame> frames; /**< @brief a ring of FRAMES frames */
+		volatile long head; /**< @brief the next frame grab() reads */
+		volatile long tail; /**< @brief the next frame the thread writes */
+		volatile long lost; /**< @brief frames dropped while the ring was full */
+	};
+
+	std::vector<Member> _members;
+	double _tol;
+	volatile bool _quit;
+	bool _running;
+
+	/** @brief the loop run by the thread of every camera */
+	static unsigned long __stdcall main(void* param);
+	/** @brief publishes what a camera found in its last frame */
+	void publish(Member& m);
+	/** @brief waits until the camera has published a frame grab() has not read */
+	bool wait(Member& m, int timeout_ms);
+	/** @brief fuses the frames at the heads of the rings into dots */
+	void fuse(Dots& dots);
+
+	// the threads hold a pointer to the group
+	CameraGroup(const CameraGroup&);
+	CameraGroup& operator=(const CameraGroup&);
+};
+
+#endif /* _CAMERA_GROUP_H_ */
@@ -2,7 +2,6 @@
 #define _VIDEOCAPTUREME3_H_
 
 #include <vector>
-#include <deque>
 #include <string>
 #include <utility>
 #include <cv.h>
@@ -11,11 +10,15 @@
 #include <FastConfig.h>
 
 #include "_common.h"
+#include "FgMonitor.h"
+#include "FrameTiming.h"
 
 class VideoCaptureMe3 : public cv::VideoCapture
 {
 public:
 	static const int REMOVE_ALL = -1;
+	/** @brief the ports of a board, open(int) takes board * PORTS + port */
+	static const int PORTS = 2;
 	enum slots {ROI0 = 0, ROI1, ROI2, ROI3, ROI4, ROI5, ROI6, ROI7};
 
     VideoCaptureMe3();
@@ -29,6 +32,7 @@ public:
     void release();
     
     bool grab();
+	bool poll();
 	bool retrieve(cv::Mat& image, int channel=0);
 	//virtual VideoCaptureMe3& operator >> (cv::Mat& image);
     
@@ -45,9 +49,8 @@ public:
 		double exposure, double frame_time);
 	bool setRois(const Dots& dots, const cv::Size& roi, 
 		double exposure, double frame_time);
-
-	static void makeSafeMat(cv::Mat& mat);
-	static void makeUnsafeMat(cv::Mat& mat, cv::Point& offset);
+	void priority(int tag, int weight);
+	bool schedule(const Dots& dots);
     
 private:
 
@@ -61,30 +64,149 @@ private:
 		Roi(int tag, int img_nbr, T& roi);
 	};
 
+	/**
+	* @brief a bounded, lock-free queue of ROIs with many producers and one consumer
+	*
+	* Any thread may push, but only one thread at a time may pop.  Every cell
+	* carries a sequence number telling whether it is free for the push at
+	* position pos (seq == pos) or holds the entry pushed there (seq == pos + 1),
+	* so a push only has to claim a position and a pop never waits for one.
+	*/
+	class RoiRing {
+	public:
+		/** @brief a queue entry, pos is the position it was pushed at */
+		struct Entry {
+			unsigned long pos;
+			int tag;
+			int img_nbr;
+			cv::Rect roi;
+		};
+
+		/** @brief a ring of len entries, len must be a power of two */
+		RoiRing(int len);
+		/** @brief adds an entry, false if the ring is full */
+		bool push(int tag, int img_nbr, const cv::Rect& roi);
+		/** @brief takes the oldest entry, false if the ring is empty */
+		bool pop(Entry& e);
+		/** @brief the position the next push will get */
+		unsigned long tail() const;
+		/** @brief empties the ring, no other thread may use it meanwhile */
+		void clear();
+
+	private:
+		struct Cell {
+			volatile long seq;
+			Entry e;
+		};
+
+		std::vector<Cell> _cells;
+		unsigned long _mask;
+		volatile long _head; /**< @brief only written by the consumer */
+		volatile long _tail; /**< @brief claimed by the producers */
+	};
+
 	int _img_nbr;
 	int _buffers;
 	int _tap;
+	/** @brief the shortest frame time of a ROI in the _tap mode, see FrameTiming.h */
+	FrameTiming _timing;
 	int _trigger;
 	void* _mem;
+	/** @brief the bytes allocated for every buffer, the largest image that fits */
+	int _buffer_size;
+	/** @brief start() succeeded and nothing has stopped the acquisition since */
+	bool _acquiring;
 	Fg_Struct* _fg;
+	/** @brief the board and port open(int) was given */
+	int _board;
+	int _port;
 	/** @brief contains the dots/ROIs that will be written to the camera */
-	std::deque< Roi<cv::Rect> > _q;
+	RoiRing _q;
+	/** @brief remove() requests: the tag and the _q position they apply before */
+	RoiRing _removals;
+	/** @brief the remove() requests taken from _removals that may still apply */
+	std::vector<RoiRing::Entry> _removed;
+	/** @brief the oldest ROI, taken from _q but not yet written to the camera */
+	RoiRing::Entry _front;
+	bool _has_front;
+	/** @brief how many tags nextDot() returned for the current image */
+	int _next_dot;
+
+	/** @brief images are published by the driver callback apc() instead of grab() */
+	bool _apc;
+	/** @brief the images apc() published that grab() has not taken yet, the tag
+	* is BAD_TAG when the image does not belong to the ROI in its buffer */
+	RoiRing _frames;
+	/** @brief the image taken by the last grab() in the APC mode */
+	RoiRing::Entry _frame;
+	/** @brief the smallest image number grab() takes in the APC mode */
+	int _wanted_img;
+	/** @brief signaled when apc() publishes an image */
+	void* _frame_ready;
+	/** @brief the images apc() could not publish, because _frames was full */
+	volatile long _frames_lost;
+	/** @brief samples the buffers while _monitoring, see set(TDAH_PROP_MONITOR, ...) */
+	FgMonitor _monitor;
+	bool _monitoring;
 	/** @brief local copy of ROIs that have been written to the camera */
 	std::vector< Roi<FC_ParameterSet> > _roi;
+	/** @brief the ROIs set(...) changed but did not write, by slot, see writeDirtyRois() */
+	std::vector<char> _dirty;
+	/** @brief the time stamp of image _ts_nbr, see get(CV_CAP_PROP_POS_MSEC) */
+	double _ts;
+	int _ts_nbr;
+	/** @brief the last value set(FG_DIGIO_OUTPUT, ...) wrote, -1 if unknown */
+	double _digio;
+	/** @brief frame_timing_min(...) of a _min_width x _min_height ROI exposed
+	* for _min_exposure, _min_width is -1 when it has to be computed again */
+	double _min_frame_time;
+	int _min_width;
+	int _min_height;
+	double _min_exposure;
+	/** @brief the FastConfig sequence, the slot of every image in turn */
+	std::vector<int> _seq;
+	/** @brief every dot has a slot of its own and _seq is built from _weights */
+	bool _scheduled;
+	/** @brief the scheduling weight of every dot, by tag */
+	std::vector<int> _weights;
 	/** @brief keeps track of which ROI is in which buffer */
 	std::vector< Roi<cv::Rect> > _roi_in_buffer;
+	/** @brief the header retrieve() returns for image _image_nbr */
+	cv::Mat _image;
+	/** @brief the image _image and _image_in_sync were set up for */
+	int _image_nbr;
+	/** @brief if the FG_IMAGE_TAG of _image_nbr matched its ROI */
+	bool _image_in_sync;
+	/** @brief the place on the sensor of the image retrieve() returned last */
+	cv::Point _image_offset;
 
 	int slotIndex();
 	int bufferIndex();
 	void fastConfigDefaults();
-	void me3Err(std::string msg);
+	void me3Err(const char* msg);
+	bool writeDirtyRois();
 	bool roiSequence();
+	int slotOfTag(int tag) const;
+	int weight(int tag) const;
+	void scheduleSlots(int n);
+	static void buildSequence(const std::vector<int>& slots,
+		const std::vector<int>& weights, std::vector<int>& sequence);
 	cv::Rect calcRoi(const cv::Point2d& pixel) const;
 	double nextDot();
 	bool writeRoi(int slot);
+	bool resize(int width, int height);
 	void updateRoiBuffer();
 	bool updateRoiSlot();
+	bool frontRoi();
+	void popRoi();
+	bool isRemoved(const RoiRing::Entry& e);
+	int grabbedImage() const;
+	bool takeFrame(unsigned long ms);
+	bool monitor(int period_ms);
+	int apcImage(int img_nbr);
+	static int apc(int img_nbr, void* data);
 	bool isRoiInBuffer();
+	void cacheImage();
 	static int getRoiTag(int img_tag);
 	static int getFgImgTag(int img_tag);
 };
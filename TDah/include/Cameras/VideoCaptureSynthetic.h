@@ -0,0 +1,119 @@
+#ifndef _VIDEOCAPTURESYNTHETIC_H_
+#define _VIDEOCAPTURESYNTHETIC_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <cv.h>
+#include <highgui.h>
+
+#include "_common.h"
+
+/**
+* @brief A camera that renders moving dots, so TDah runs without a frame grabber.
+*
+* The camera images the ROIs of a sensor the way VideoCaptureMe3 does: the
+* ROIs of dots queued by add(...) or setRois(...) are taken one per grab(),
+* every image is rendered into the next buffer of a pool allocated once by
+* buffers(...), retrieve(...) returns the ROI as a header into its buffer,
+* whose place on the sensor locateROI and TDAH_PROP_IMAGE_X and _Y give,
+* and TDAH_PROP_NEXT_DOT tells which dot an image was taken for.  An ROI
+* as large as the sensor gives full frames, TDAH_PROP_IS_ROI is then false.
+* Unlike the microEnable III, an ROI is imaged by the grab() that takes it
+* from the queue.
+*
+* Every dot circles its rest position, see motion(...), on a background with
+* gaussian noise, see noise(...).  The clock of the camera advances one frame
+* time, 1 / CV_CAP_PROP_FPS, per image, so the dots move the same whatever
+* rate the images are grabbed at; grab() runs as fast as the images can be
+* rendered unless realTime(true) makes it wait for the frame time.
+*/
+
+class VideoCaptureSynthetic : public cv::VideoCapture
+{
+public:
+	static const int REMOVE_ALL = -1;
+
+	VideoCaptureSynthetic();
+	VideoCaptureSynthetic(const cv::Size& sensor, int dots);
+
+	~VideoCaptureSynthetic();
+	bool open(const std::string& filename);
+	bool open(int device);
+	bool isOpened() const;
+	void release();
+
+	bool grab();
+	bool retrieve(cv::Mat& image, int channel=0);
+
+	bool set(int prop, double value);
+	double get(int prop);
+
+	// functions of VideoCaptureMe3
+	bool buffers(int n, int width, int height);
+	void add(const Dots& dots);
+	void remove(int tag = REMOVE_ALL);
+	bool setRois(const Dots& dots, const cv::Size& roi,
+		double exposure, double frame_time);
+
+	// the synthetic scene
+	/** @brief renders n dots of radius radius, spread over the sensor */
+	void dots(int n, double radius);
+	/** @brief every dot circles with radius amplitude once per period seconds */
+	void motion(double amplitude, double period);
+	/** @brief the standard deviation of the noise of the background */
+	void noise(double sigma);
+	/** @brief if true, grab() waits until a frame time passed since the last one */
+	void realTime(bool paced);
+	/** @brief where the dot tag is in the last grabbed image */
+	cv::Point2d truth(int tag) const;
+
+private:
+	/** @brief the ROI of an image and the dot it was taken for */
+	struct Roi {
+		int tag;
+		cv::Rect roi;
+	};
+
+	cv::Size _sensor;
+	/** @brief the rest position of every dot, by tag */
+	std::vector<cv::Point2d> _rest;
+	double _radius;
+	double _amplitude;
+	double _period;
+	double _sigma;
+	/** @brief the frame time and exposure in microseconds */
+	double _frame_time;
+	double _exposure;
+	bool _paced;
+	int64 _last_tick;
+	bool _opened;
+	/** @brief the last grabbed image, 0 before the first grab() */
+	int _img_nbr;
+	/** @brief the image number set by CV_CAP_PROP_POS_FRAMES */
+	int _wanted_img;
+	/** @brief the size of every ROI */
+	cv::Size _roi_size;
+	/** @brief the buffers, every one the size of the sensor */
+	std::vector<cv::Mat> _buffers;
+	/** @brief the ROI of the image in every buffer */
+	std::vector<Roi> _in_buffer;
+	/** @brief twice as high as the sensor, every image is cut from another row */
+	cv::Mat _background;
+	/** @brief the ROIs waiting to be imaged */
+	std::deque<Roi> _q;
+	/** @brief the ROI of the last image, imaged again while the queue is empty */
+	Roi _current;
+	/** @brief how many tags nextDot() returned for the current image */
+	int _next_dot;
+
+	bool isRoi() const;
+	cv::Rect calcRoi(const cv::Point2d& pixel) const;
+	cv::Point2d position(int tag, int img_nbr) const;
+	double nextDot();
+	void fillBackground();
+	void render(const Roi& r, cv::Mat& buffer);
+	void pace();
+};
+
+#endif /* _VIDEOCAPTURESYNTHETIC_H_ */
@@ -11,6 +11,9 @@
 * about the dot it is related to.  Users are expected to only READ its members
 * and not modify it.
 *
+* A Dot is a view of one dot of a Dots, whose fields are kept in one array per
+* field, so it always reads the current values of its dot.  A default
+* constructed Dot belongs to no Dots and reads the initial values.
 */
 
 class Dot {
@@ -46,17 +49,31 @@ public:
 
 	double area() const;
 
+	/** @brief the number of past locations, at most Dots::HISTORY */
+	int historySize() const;
+	/** @brief the pixel location age found locations ago, 0 is the newest */
+	cv::Point2d pixelAt(int age) const;
+	/** @brief the world location age found locations ago, 0 is the newest */
+	cv::Point3d worldAt(int age) const;
+	/** @brief the time stamp age found locations ago, 0 is the newest */
+	double timeStampAt(int age) const;
+	/** @brief the filtered pixel velocity, in pixels per time stamp unit */
+	cv::Point2d pixelVelocity() const;
+	/** @brief the filtered world velocity, in world units per time stamp unit */
+	cv::Point3d velocity() const;
+	/** @brief the filtered world acceleration */
+	cv::Point3d acceleration() const;
+	/** @brief the pixel location the dot is expected at time time */
+	cv::Point2d predictPixel(double time) const;
+
 private:
-	bool _found; /**< denotes whether a dot was found in the image */
-	bool _active; /**< denotes whether a dot is active in the image */
+	const Dots* _owner; /**< the Dots holding the fields of the dot */
 	int _tag; /**< a unique number that is associated with the dot */
-	int _image_nbr; /**< the most recent image number the dot was searched in */
-	double _time_stamp; /**< the image time stamp */
-	
-	double _area; // added for checking the number of detected pixels.  may not be necessary later.		
 
-	cv::Point2d _pixel_loc; /**< the pixel coordinates of the dot's centroid */
-	cv::Point3d _world_loc; /**< the world coordinates of the dot's centroid */
+	/** @brief a view of dot tag of owner */
+	Dot(const Dots* owner, int tag);
+	/** @brief the index of the location age found locations ago, -1 if none */
+	int historyIndex(int age) const;
 };
 
 #endif /* _DOT_H_ */
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define _DOTS_H_
 
 #include <vector>
+#include <valarray>
 #include "_common.h"
 #include "Dot.h"
 
@@ -13,38 +14,124 @@
 * giving each Dot a unique tag.  When passed to a Tracker, Trackers are 
 * expected to only modify dots that are "active" as defined by either the 
 * user or a Camera.
-* 
+*
+* The fields of the dots are stored as one array per field, indexed by tag,
+* and each Dot is a view into them.  A loop over many dots only pulls the
+* fields it uses through the cache, and pixels() and worlds() can be handed
+* to batch code like Camera::pixelToWorld(const cv::Point2d*, cv::Point3d*, size_t).
+*
+* The active set is a bit per dot and a dense list of the active dots, each
+* of which knows its index in the list.  Testing, adding and removing a dot
+* take constant time and clearing the set takes time in the number of
+* active dots, not of all dots, which is what a Camera does every grab.
+*
+* makeDots(n, capacity) allocates capacity dots, of which the first n are
+* used and the rest wait in a free list.  acquireDot(...) takes a tag off the
+* list for a marker that came into view and releaseDot(...) puts the tag of
+* one that is gone back, both in constant time without allocating, so a
+* running tracker can start and retire dots: the fields and views of the
+* other dots stay where they are, and so do their tags and the active set.
+*
+* The world location of a dot is worked out when it is read, not when the
+* dot is tracked: Tracker::track() only notes the Camera of the new pixel
+* location, and Dot::world(), worlds(), Dot::worldAt(...) and the world
+* velocity and acceleration call Camera::pixelToWorld(...) for the
+* locations that were not read since.  A dot whose world location is never
+* read costs no undistortion at all.  The Camera must outlive the dots it
+* tracked, and since a read may fill in the locations, one Dots must not be
+* read from two threads at the same time.
 */
 
 class Dots
 {
 	friend Camera;
+	friend CameraGroup;
+	friend DotsCodec;
 	friend Tracker;
+	friend Dot;
+	/** @brief records tracks without a Tracker */
+	friend class TestDotsSuite;
 
 public:
+	/** @brief the number of past locations kept for every dot */
+	static const int HISTORY = 16;
+
 	/** @brief constructor that does nothing */
 	Dots();
 
-	/** @brief constructor that creates n dots */
-	Dots(int n);
+	/** @brief constructor that creates n dots, with room for capacity */
+	Dots(int n, int capacity = 0);
+	/** @brief copies the dots and points the copies' views at the copy */
+	Dots(const Dots& dots);
+	/** @brief copies the dots and points the copies' views at this */
+	Dots& operator=(const Dots& dots);
 
-	/** @brief deletes all previous dots and creates n new dots */
-	void makeDots(int n);
+	/** @brief deletes all previous dots and creates n new dots, with room for capacity */
+	void makeDots(int n, int capacity = 0);
+	/** @brief takes a free tag, starts its dot at pixel and makes it active, BAD_TAG if none */
+	int acquireDot(const cv::Point2d& pixel);
+	/** @brief makes a dot inactive and puts its tag back on the free list */
+	void releaseDot(int tag);
+	/** @brief true, if the tag was not released */
+	bool isDotUsed(int tag) const;
+	/** @brief the number of tags acquireDot(...) can still hand out */
+	int freeDots() const;
 	/** @brief true, if a dot is in the active set */
 	bool isDotActive(int tag) const;
 	/** @brief adds the dot with tag to the active set */
 	void makeDotActive(int tag);
+	/** @brief removes the dot with tag from the active set */
+	void makeDotInactive(int tag);
 	/** @brief adds all dots to the active set */
 	void makeAllDotsActive();
 	/** @brief removes all dots in the active set */
 	void clearActiveDots();
 	/** @brief returns the current set of active dots */
 	ActiveDots& activeDots() const;
+	/** @brief the number of dots, used or free */
+	int size() const;
+	/** @brief the pixel locations of all dots, by tag */
+	const cv::Point2d* pixels() const;
+	/** @brief the world locations of all dots, by tag */
+	const cv::Point3d* worlds() const;
+	/** @brief sets the low-pass filter of the velocity and acceleration estimates */
+	void filter(double alpha);
 
 private:
-	std::vector<Dot> _dots; /**< the collection of dots */
+	std::vector<Dot> _dots; /**< a view of every dot, by tag */
 	std::vector<Dot*> _active_dots; /**< the collection of active dots */
 
+	/** @name the fields of every dot, by tag */
+	//@{
+	std::vector<cv::Point2d> _pixel; /**< the pixel coordinates of the dot's centroid */
+	mutable std::vector<cv::Point3d> _world; /**< the world coordinates of the dot's centroid */
+	mutable std::vector<const Camera*> _world_cam; /**< the camera _world is still to be worked out with, NULL if it is current */
+	std::valarray<bool> _found; /**< denotes whether a dot was found in the image */
+	std::vector<double> _area; // added for checking the number of detected pixels.  may not be necessary later.
+	std::vector<int> _image_nbr; /**< the most recent image number the dot was searched in */
+	std::vector<double> _time_stamp; /**< the image time stamp */
+	std::vector<bool> _active; /**< a bit per dot, set when it is in the active set */
+	std::vector<int> _active_pos; /**< the index of an active dot in _active_dots */
+	std::vector<bool> _used; /**< a bit per dot, clear while its tag is free */
+	//@}
+	std::vector<int> _free; /**< the free tags, acquireDot(...) takes the last one */
+
+	/** @name the track of every dot, the last HISTORY found locations */
+	//@{
+	std::vector<cv::Point2d> _hist_pixel; /**< the pixel locations, HISTORY per dot */
+	mutable std::vector<cv::Point3d> _hist_world; /**< the world locations, HISTORY per dot */
+	mutable std::vector<const Camera*> _hist_cam; /**< like _world_cam, HISTORY per dot */
+	std::vector<double> _hist_time; /**< the time stamps, HISTORY per dot */
+	std::vector<int> _hist_len; /**< the number of locations of the dot */
+	std::vector<int> _hist_head; /**< the slot of the dot's newest location */
+	std::vector<cv::Point2d> _pixel_vel; /**< the filtered pixel velocity */
+	mutable std::vector<cv::Point3d> _world_vel; /**< the filtered world velocity */
+	mutable std::vector<cv::Point3d> _world_acc; /**< the filtered world acceleration */
+	mutable std::vector<int> _world_new; /**< the newest locations of the track not in _world_vel yet */
+	mutable std::vector<int> _world_steps; /**< the locations in _world_vel, at most HISTORY */
+	double _alpha; /**< the weight of the newest velocity and acceleration */
+	//@}
+
 	/** @brief returns a reference to the image number */
 	int& imageNbr(int tag);
 	/** @brief returns a reference to the time stamp */
@@ -53,10 +140,24 @@ private:
 	bool& found(int tag);
 	/** @brief returns a reference to the pixel location */
 	cv::Point2d& pixel(int tag);
-	/** @brief returns a reference to the world location */
+	/** @brief returns a reference to the world location, worked out if it is not yet */
 	cv::Point3d& world(int tag);
+	/** @brief sets the world location, dropping one that was still to be worked out */
+	void world(int tag, const cv::Point3d& w);
+	/** @brief sets the world location to be worked out from the pixel location with cam */
+	void worldFrom(int tag, const Camera& cam);
+	/** @brief the world location, worked out if it is not yet */
+	const cv::Point3d& currentWorld(int tag) const;
+	/** @brief the world location of slot i of the track, worked out if it is not yet */
+	const cv::Point3d& historyWorld(int i) const;
+	/** @brief adds the locations recorded since the last call to the world velocity */
+	void updateWorldVelocity(int tag) const;
 	/** @brief returns a reference to the active dot */
 	Dot& operator[] (int tag);
+	/** @brief adds the current location of a found dot to its track */
+	void record(int tag);
+	/** @brief sets the fields and track of a dot to the initial values */
+	void resetDot(int tag);
 
 	// added for checking the number of detected pixels.  may not be necessary later.
 	double& area(int tag);
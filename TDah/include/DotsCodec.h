@@ -0,0 +1,97 @@
+#ifndef _DOTSCODEC_H_
+#define _DOTSCODEC_H_
+
+#include <string>
+#include <vector>
+#include <cv.h>
+#include "_common.h"
+
+/**
+* @brief Packs the active dots of a Dots into a binary snapshot.
+*
+* Tracker::str(...) formats every field of every active dot into a string,
+* which costs more than tracking the dots when it is done in the loop.  A
+* snapshot is a copy of the same fields into a buffer of the caller: the
+* tag, image number, time stamp, pixel and world location, area and found
+* flag of every active dot, in the byte order of the machine, so logging
+* or sending the dots costs about a memcpy.  print(...) turns snapshots
+* back into the lines of Tracker::str(...) offline.
+*
+* A delta snapshot only holds the fields that changed since the last
+* snapshot encode(...) wrote, which is most of a snapshot while the dots
+* stand still.  Every snapshot has a sequence number, and a delta is only
+* decoded on top of the snapshot before it, so a lost delta is noticed
+* instead of decoded on the wrong fields; the next full snapshot starts
+* over.
+*
+* A snapshot is a header and one record per active dot:
+*
+* @verbatim
+  header: uint magic, ushort version, ushort flags, uint dots, uint bytes,
+          uint seq
+  record: ushort tag, uchar fields, then the fields that are set in order
+          int image_nbr, double time_stamp, double pixel[2],
+          double world[3], double area
+ @endverbatim
+*
+* The found flag is a bit of fields, so an unchanged dot of a delta is a
+* tag and one byte.
+*/
+
+class DotsCodec
+{
+public:
+	DotsCodec();
+
+	/** @brief the bytes of a snapshot of n dots with every field */
+	static size_t maxSize(int n);
+
+	/** @brief writes a snapshot of the active dots, returns its bytes or 0 */
+	size_t encode(const Dots& dots, void* buf, size_t size, bool delta = false);
+	/** @brief reads a snapshot into the fields and active set of dots */
+	bool decode(const void* buf, size_t size, Dots& dots);
+	/** @brief the bytes of the snapshot at buf, 0 if there is none */
+	static size_t snapshotSize(const void* buf, size_t size);
+	/** @brief decodes a snapshot into dots and formats it like Tracker::str(...) */
+	std::string print(const void* buf, size_t size, Dots& dots);
+
+	/** @brief forgets the last snapshot, so the next ones start with a full one */
+	void reset();
+
+	/** @brief the magic number of a snapshot */
+	static const unsigned int MAGIC = 0x48414454; // "TDAH"
+	/** @brief the version of the layout */
+	static const unsigned short VERSION = 1;
+	/** @brief the flag of a delta snapshot */
+	static const unsigned short DELTA = 1;
+
+	/** @name the bits of the fields of a record */
+	//@{
+	static const unsigned char IMAGE_NBR = 0x01;
+	static const unsigned char TIME_STAMP = 0x02;
+	static const unsigned char PIXEL = 0x04;
+	static const unsigned char WORLD = 0x08;
+	static const unsigned char AREA = 0x10;
+	static const unsigned char ALL = 0x1f;
+	static const unsigned char FOUND = 0x80;
+	//@}
+
+private:
+	/** @brief the fields of the last snapshot encode(...) wrote, by tag */
+	std::vector<int> _image_nbr;
+	std::vector<double> _time_stamp;
+	std::vector<cv::Point2d> _pixel;
+	std::vector<cv::Point3d> _world;
+	std::vector<double> _area;
+	/** @brief true for the dots of the last snapshot */
+	std::vector<char> _sent;
+	/** @brief the fields of the record of every dot of the snapshot being written */
+	std::vector<unsigned char> _fields;
+	/** @brief the sequence number of the next snapshot encode(...) writes */
+	unsigned int _seq;
+	/** @brief the sequence number of the last snapshot decode(...) read, valid if _decoded */
+	unsigned int _last;
+	bool _decoded;
+};
+
+#endif /* _DOTSCODEC_H_ */
@@ -0,0 +1,117 @@
+#ifndef _DOTSPUBLISHER_H_
+#define _DOTSPUBLISHER_H_
+
+#include <vector>
+#include "_common.h"
+#include "DotsCodec.h"
+
+/**
+* @brief Sends the active dots of every tracked image over the network.
+*
+* Tracker::track(...) leaves the pixel and world location of the dots in a
+* Dots, and getting them to the qnx controller took a sender of its own, like
+* the VisionTCP of the Jian clients.  A DotsPublisher given to
+* Tracker::publisher(...) takes the dots at the end of every track(): the
+* active dots, with their image number and the time stamp of their image, are
+* written by a DotsCodec into the next frame of a ring, and a thread of the
+* publisher sends the frames from there, so the tracking loop never waits for
+* the network:
+*
+* @code
+* DotsPublisher pub;
+* DotsPublisher::Config cfg = DotsPublisher::defaults();
+* cfg.host = "192.168.1.65";
+* if(pub.open(cfg)) {
+*     tracker.publisher(&pub);
+* }
+* @endcode
+*
+* Every frame is one full DotsCodec snapshot, so a datagram that is lost costs
+* its frame and nothing after it; DotsCodec::decode(...) reads a frame back and
+* DotsCodec::snapshotSize(...) splits the TCP stream into its frames.  The ring
+* is written only by publish() and read only by the thread, like the ring of
+* an Acquisition, so neither side takes a lock.  A frame that finds the ring
+* full, or more dots than Config::max_dots, is dropped and counted by
+* dropped().  A TCP link that fails is connected again by the thread every
+* RECONNECT_MS, the frames in between are dropped.
+*/
+
+class DotsPublisher
+{
+public:
+	/** @brief what open() sets up */
+	struct Config {
+		const char* host; /**< @brief the IPv4 address of the receiver */
+		int port;
+		bool tcp; /**< @brief a stream instead of a datagram per frame */
+		int frames; /**< @brief the frames of the ring */
+		int max_dots; /**< @brief the active dots of a frame at most */
+	};
+
+	/** @brief UDP to 192.168.1.65:3491, next to the port of VisionTCP, 8 frames of 64 dots */
+	static Config defaults();
+
+	DotsPublisher();
+	/** @brief sends the frames left and closes the socket */
+	~DotsPublisher();
+
+	/** @brief opens the socket and starts the thread, returns false if it could not */
+	bool open(const Config& cfg);
+	/** @brief sends the frames left, stops the thread and closes the socket */
+	void close();
+	bool isOpen() const { return _thread != NULL; }
+
+	/** @brief copies the active dots into the next frame, never waits */
+	bool publish(const Dots& dots);
+
+	/** @brief the frames sent, dropped by publish() and lost to a failed send */
+	unsigned long sent() const { return _sent; }
+	unsigned long dropped() const { return _dropped; }
+	unsigned long failures() const { return _failures; }
+
+	/** @brief why the last call failed */
+	const char* error() const { return _err; }
+
+	/** @brief how often the thread tries to connect a TCP link again */
+	static const int RECONNECT_MS = 1000;
+
+private:
+	Config _cfg;
+	/** @brief writes the frames, used by publish() only */
+	DotsCodec _codec;
+
+	std::vector<char> _buf; /**< @brief the frames of the ring, _frame_size bytes each */
+	std::vector<size_t> _bytes; /**< @brief the bytes of every frame */
+	size_t _frame_size;
+	volatile long _head; /**< @brief the next frame the thread sends */
+	volatile long _tail; /**< @brief the next frame publish() writes */
+
+	size_t _socket; /**< @brief a SOCKET, INVALID_SOCKET while a TCP link is down */
+	unsigned long _addr; /**< @brief of the receiver, in network order */
+	unsigned long _last_try; /**< @brief GetTickCount() of the last connect */
+	bool _wsa; /**< @brief WSAStartup was called */
+
+	volatile long _sent;
+	volatile long _dropped;
+	volatile long _failures;
+
+	volatile bool _quit;
+	void* _thread;
+	void* _ready; /**< @brief signaled when a frame was published */
+
+	char _err[256];
+
+	/** @brief opens and connects the socket, returns false with the reason in _err */
+	bool connectSocket();
+	void closeSocket();
+	/** @brief sends the frames between _head and _tail */
+	void sendFrames();
+	/** @brief the loop run by the thread */
+	static unsigned long __stdcall main(void* param);
+
+	// the thread holds a pointer to the publisher
+	DotsPublisher(const DotsPublisher&);
+	DotsPublisher& operator=(const DotsPublisher&);
+};
+
+#endif /* _DOTSPUBLISHER_H_ */
@@ -0,0 +1,80 @@
+#ifndef _FGMONITOR_H_
+#define _FGMONITOR_H_
+
+/**
+* @file FgMonitor.h a live view of the frame grabber's buffers shared by TDah and
+* HSV-Base.
+*
+* A monitor thread samples the transferred, fetched and lost image counters of one
+* port every period and publishes them as an FgMonitorSnapshot.  The snapshot is a
+* sequence lock: the monitor thread is the only writer, and a reader copies it and
+* retries if the writer was in the middle of an update, so neither side ever waits
+* on the other and reading costs a few loads on the hot path.
+*
+* The backlog is how many completed images the consumer has not fetched yet.  The
+* driver only counts the images fetched through Fg_getLastPicNumber*, so consumers
+* that read the buffers directly report their position with fg_monitor_consumed.
+* When the backlog reaches FG_MONITOR_HIGH percent of the buffers, or images are
+* being lost, the pressure goes up and the action passed to fg_monitor_start is
+* called with the snapshot, so the consumer can decimate its display, grow its
+* buffers or lower the frame rate before (more) images are overwritten.
+*/
+
+#include <fgrab_struct.h>
+
+/** @brief the backlog in percent of the buffers that is FG_PRESSURE_HIGH */
+#define FG_MONITOR_HIGH 50
+
+/** @brief how close the consumer is to losing images */
+enum fg_pressure {
+	FG_PRESSURE_OK = 0,
+	FG_PRESSURE_HIGH, /**< @brief the backlog is at least FG_MONITOR_HIGH percent */
+	FG_PRESSURE_LOSING /**< @brief images were lost since the last sample */
+};
+
+/** @brief the counters of one sample */
+struct FgMonitorSnapshot {
+	int transferred; /**< @brief the newest completed image, NUMBER_OF_ACT_IMAGE */
+	int fetched; /**< @brief the newest image the consumer took */
+	int backlog; /**< @brief transferred - fetched */
+	int lost; /**< @brief the images lost since the acquisition started */
+	int buffers;
+	int pressure; /**< @brief one of fg_pressure */
+	unsigned int samples; /**< @brief the number of samples taken so far */
+};
+
+/**
+* @brief called on the monitor thread when the pressure changes
+*
+* The frame grabber and FastConfig belong to the acquisition thread, so an action
+* should only leave a note for it rather than change the acquisition itself.
+*/
+typedef void (*fg_monitor_action)(const FgMonitorSnapshot* s, void* ctx);
+
+/** @brief the state of one monitor, set up by fg_monitor_start */
+struct FgMonitor {
+	Fg_Struct* fg;
+	int port;
+	dma_mem* mem; /**< @brief the memory head of port, NULL for Fg_AllocMem */
+	int buffers;
+	int period_ms;
+	fg_monitor_action action;
+	void* ctx;
+	volatile long consumed; /**< @brief written by fg_monitor_consumed */
+	volatile long seq; /**< @brief odd while the monitor thread writes snap */
+	FgMonitorSnapshot snap;
+	volatile long running;
+	void* thread;
+};
+
+/** @brief starts sampling port of fg every period_ms, returns 0 on success */
+int fg_monitor_start(FgMonitor* m, Fg_Struct* fg, int port, dma_mem* mem, int buffers,
+	int period_ms, fg_monitor_action action, void* ctx);
+/** @brief tells the monitor the consumer is done with image img_nbr */
+void fg_monitor_consumed(FgMonitor* m, int img_nbr);
+/** @brief copies the newest snapshot of m */
+void fg_monitor_read(FgMonitor* m, FgMonitorSnapshot* s);
+/** @brief stops sampling, the last snapshot can still be read */
+void fg_monitor_stop(FgMonitor* m);
+
+#endif /* _FGMONITOR_H_ */
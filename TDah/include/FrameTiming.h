@@ -0,0 +1,49 @@
+#ifndef _FRAMETIMING_H_
+#define _FRAMETIMING_H_
+
+/**
+* @file FrameTiming.h the shortest frame time the TrackCam can run a ROI at, shared by
+* TDah and HSV-Base.
+*
+* The camera exposes an image and then clocks it out over the camera link before it
+* can start the next one, so FRAME >= EXPOSURE + TRANSFER TIME.  The transfer time is
+* modelled the way the timing signals looked on the oscilloscope: every line takes
+* a fixed gap plus its pixels at the pixel clock times the taps of the camera link
+* mode, and a frame takes one more gap:
+*
+*	frame >= exposure + lines * (line_us + width * pixel_us) + gap_us
+*
+* where lines is the height, plus one for widths below short_width where an extra
+* line pulse appears.  frame_timing_init fills in the oscilloscope values for a camera
+* link mode; they can be calibrated once from a timing sweep by handing every run the
+* camera could not keep up with to frame_timing_observe and solving with
+* frame_timing_fit.
+*/
+
+/** @brief the parameters of the model, all times in microseconds */
+struct FrameTiming {
+	double line_us; /**< @brief the gap after every line */
+	double pixel_us; /**< @brief the time of one pixel, 1 / (pixel clock * taps) */
+	double gap_us; /**< @brief the gap after every frame */
+	int short_width; /**< @brief ROIs narrower than this take an extra line */
+
+	/** @brief the normal equations of the runs given to frame_timing_observe */
+	double ata[3][3];
+	double atb[3];
+	int runs;
+};
+
+/** @brief the oscilloscope values for a camera link mode, like FG_CL_DUALTAP_8_BIT */
+void frame_timing_init(FrameTiming* t, int camlink);
+/** @brief the shortest frame time of a width x height ROI exposed for exposure */
+double frame_timing_min(const FrameTiming* t, int width, int height, double exposure);
+/** @brief frame, or the shortest frame time if frame is shorter */
+double frame_timing_clamp(const FrameTiming* t, int width, int height, double exposure,
+	double frame);
+/** @brief adds a run whose images came every period microseconds to the calibration */
+void frame_timing_observe(FrameTiming* t, int width, int height, double exposure,
+	double period);
+/** @brief fits the model to the observed runs, returns 0 on success */
+int frame_timing_fit(FrameTiming* t);
+
+#endif /* _FRAMETIMING_H_ */
@@ -0,0 +1,52 @@
+#ifndef _IMAGEVIEW_H_
+#define _IMAGEVIEW_H_
+
+#include <cv.h>
+
+/**
+* @brief A rectangle of pixels that belongs to someone else.
+*
+* An ImageView is the first pixel of a rectangle, the bytes from one of its
+* rows to the next, its size and where it is in the image frame, the frame
+* of the whole sensor.  It does not own or count references to the pixels,
+* so it is only valid while the Mat or DMA buffer it was made from is.
+*
+* A camera that hands out ROIs, like VideoCaptureMe3, knows where a tightly
+* packed buffer is on the sensor and says so with TDAH_PROP_IMAGE_X and
+* TDAH_PROP_IMAGE_Y, see Camera::view(...); a header into a larger Mat, like
+* the ones of VideoCaptureSynthetic, is placed with locateROI.  A view of
+* a rectangle of a view, see operator()(...), keeps the stride, so kernels
+* can walk the rows of a tracking rectangle straight out of the buffer.
+*/
+
+class ImageView {
+public:
+	/** @brief an empty view */
+	ImageView() : data(NULL), step(0), width(0), height(0), type(CV_8UC1), offset() {}
+	/** @brief the pixels of img at offset in the image frame */
+	ImageView(const cv::Mat& img, const cv::Point& offset) :
+		data(img.data), step(static_cast<int> (img.step)), width(img.cols),
+		height(img.rows), type(img.type()), offset(offset) {}
+	/** @brief the pixels of img, placed in the Mat it is a region of */
+	explicit ImageView(const cv::Mat& img);
+
+	/** @brief the first pixel of row y */
+	const uchar* row(int y) const { return data + y * step; }
+	/** @brief the size of the view */
+	cv::Size size() const { return cv::Size(width, height); }
+	/** @brief true if the view has no pixels */
+	bool empty() const { return data == NULL; }
+	/** @brief the view of the rectangle r of the view, r relative to the view */
+	ImageView operator()(const cv::Rect& r) const;
+	/** @brief a Mat header of the pixels for the OpenCV functions, at offset (0, 0) */
+	cv::Mat mat() const;
+
+	const uchar* data; /**< @brief the first pixel */
+	int step; /**< @brief the bytes from one row to the next */
+	int width; /**< @brief the number of pixels of a row */
+	int height; /**< @brief the number of rows */
+	int type; /**< @brief the type of the pixels, CV_8UC1 or CV_8UC3 */
+	cv::Point offset; /**< @brief the position of the first pixel in the image frame */
+};
+
+#endif /* _IMAGEVIEW_H_ */
@@ -0,0 +1,124 @@
+#ifndef _OVERLAYRENDERER_H_
+#define _OVERLAYRENDERER_H_
+
+#include <vector>
+#include <cv.h>
+#include "_common.h"
+
+/**
+* @brief Draws the active dots over their image on a thread of its own.
+*
+* Tracker::draw(...) converts the whole image to BGR and calls the draw of
+* the TrackingAlg of every dot, which binarizes its tracking rectangle again,
+* all on the thread that tracks, every image, although a screen shows a frame
+* every 15 ms at best.  An OverlayRenderer takes a snapshot of an image and
+* its dots at most max_fps times a second: post() copies every decimate-th
+* pixel of every decimate-th row of the image and the tag, pixel location and
+* found flag of the active dots, and returns.  The thread of the renderer
+* turns the snapshot into BGR and draws the marks of every dot in one pass,
+* into buffers it allocates once and keeps, and shows it in a window of its
+* own if one is given:
+*
+* @code
+* OverlayRenderer overlay;
+* OverlayRenderer::Config cfg = OverlayRenderer::defaults();
+* overlay.start(cfg);
+* while(cam.grab(dots)) {
+*     tracker.track(cam, dots);
+*     overlay.post(cam, dots);
+* }
+* @endcode
+*
+* The snapshots and the rendered images are handed over in "latest value"
+* mailboxes, like the one of the VisionSender of the Jian clients: three
+* buffers swapped with InterlockedExchange, so neither side waits for the
+* other, and a snapshot the thread had no time for is replaced by the next
+* one.  The marks are the same for every TrackingAlg, a circle and the tag of
+* a found dot, a cross of a lost one; Tracker::draw(...) still draws what an
+* algorithm sees.
+*/
+
+class OverlayRenderer
+{
+public:
+	/** @brief what start() sets up */
+	struct Config {
+		double max_fps; /**< @brief the snapshots post() takes a second at most, 0 for every */
+		int decimate; /**< @brief the pixels of the image per pixel of the overlay, each way */
+		const char* window; /**< @brief the window the thread shows the overlay in, NULL for none */
+	};
+
+	/** @brief 30 frames a second of half the image in the window "Dots" */
+	static Config defaults();
+
+	OverlayRenderer();
+	/** @brief stops the thread */
+	~OverlayRenderer();
+
+	/** @brief starts the thread, returns false if it could not */
+	bool start(const Config& cfg);
+	/** @brief stops and joins the thread, closing its window */
+	void stop();
+	bool running() const { return _thread != NULL; }
+
+	/** @brief takes a snapshot of the image and active dots unless one was taken too recently */
+	bool post(Camera& cam, Dots& dots);
+	/** @brief copies the last overlay the thread drew, false if there is none yet */
+	bool latest(cv::Mat& dst);
+
+	/** @brief the snapshots post() took and the ones the thread drew */
+	unsigned long posted() const { return _posted; }
+	unsigned long rendered() const { return _rendered; }
+
+private:
+	/** @brief the state of one active dot */
+	struct Mark {
+		int tag;
+		cv::Point2d pixel;
+		bool found;
+	};
+
+	/** @brief what post() takes */
+	struct Snapshot {
+		cv::Mat img; /**< @brief the decimated image */
+		cv::Point offset; /**< @brief where the image is in the image frame, like ImageView */
+		int image_nbr;
+		std::vector<Mark> marks;
+	};
+
+	Config _cfg;
+
+	/** @brief the snapshots; _snap_middle has FRESH set while it holds one not drawn yet */
+	Snapshot _snaps[3];
+	int _snap_back; /**< @brief post()'s */
+	int _snap_front; /**< @brief the thread's */
+	volatile long _snap_middle;
+
+	/** @brief the overlays, the same way from the thread to latest() */
+	cv::Mat _overlays[3];
+	int _overlay_back; /**< @brief the thread's */
+	int _overlay_front; /**< @brief latest()'s */
+	volatile long _overlay_middle;
+
+	/** @brief the counter of the last snapshot and the counts between two */
+	long long _last_post;
+	long long _min_ticks;
+
+	volatile long _posted;
+	volatile long _rendered;
+
+	volatile bool _quit;
+	void* _thread;
+	void* _ready; /**< @brief signaled when a snapshot was posted */
+
+	/** @brief draws the snapshot of _snap_front into the overlay of _overlay_back */
+	void render();
+	/** @brief the loop run by the thread */
+	static unsigned long __stdcall main(void* param);
+
+	// the thread holds a pointer to the renderer
+	OverlayRenderer(const OverlayRenderer&);
+	OverlayRenderer& operator=(const OverlayRenderer&);
+};
+
+#endif /* _OVERLAYRENDERER_H_ */
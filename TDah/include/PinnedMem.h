@@ -0,0 +1,49 @@
+#ifndef _PINNEDMEM_H_
+#define _PINNEDMEM_H_
+
+/**
+* @file PinnedMem.h aligned, locked memory for the DMA buffers of the frame grabbers
+* and the image buffers of the frame loops, shared by TDah and HSV-Base.
+*
+* pinned_alloc hands out memory that starts on a page, so on a PINNED_ALIGN boundary
+* for the aligned loads of the SSE and AVX kernels, and that is held in physical
+* memory.  A block of at least one large page is first asked for in large pages: one
+* TLB entry then covers 2 MB instead of 4 kB, so a loop stepping through a ring of
+* image buffers does not miss the TLB on every image, and large pages are never paged
+* out.  They need the "Lock pages in memory" right (SeLockMemoryPrivilege) of the
+* user.  Without it, and for smaller blocks, the memory is 4 kB pages locked with
+* VirtualLock after the working set of the process was grown to hold them.  If that
+* fails too the block is still aligned but pageable, and pinned_kind says so.
+*
+* Blocks are allocated and freed from one thread at a time, like the cameras that
+* use them.
+*/
+
+#include <stddef.h>
+
+/** @brief the alignment of every block and of PINNED_STRIDE rows, a cache line */
+#define PINNED_ALIGN 64
+
+/** @brief n bytes rounded up to a multiple of PINNED_ALIGN */
+#define PINNED_STRIDE(n) (((n) + PINNED_ALIGN - 1) & ~(PINNED_ALIGN - 1))
+
+/** @brief how a block of pinned_alloc is held in memory */
+enum PinnedKind {
+	PINNED_LARGE = 0, /**< @brief large pages, never paged */
+	PINNED_LOCKED, /**< @brief 4 kB pages held with VirtualLock */
+	PINNED_PAGEABLE /**< @brief aligned only */
+};
+
+/** @brief the most blocks allocated at one time */
+#define PINNED_MAX_BLOCKS 32
+
+/** @brief allocates size zeroed bytes, aligned and pinned, NULL if there is no memory */
+void* pinned_alloc(size_t size);
+/** @brief frees a block of pinned_alloc, NULL is ignored */
+void pinned_free(void* p);
+/** @brief how the block at p is held, PINNED_PAGEABLE if p is no block */
+PinnedKind pinned_kind(const void* p);
+/** @brief prints the blocks and how each of them is held */
+void pinned_report();
+
+#endif /* _PINNEDMEM_H_ */
@@ -0,0 +1,98 @@
+#ifndef _PMCPROFILE_H_
+#define _PMCPROFILE_H_
+
+/**
+* @file PmcProfile.h hardware performance counters around the vision kernels, shared by
+* TDah and HSV-Base.
+*
+* TimingInfo, the trace points of TracePoint.h and the QueryPerformanceCounter spans
+* only give the wall time of a kernel, which does not say whether threshold(), blob()
+* or TrackDot::find waits on memory, on mispredicted branches or on neither.  With
+* PMC_PROFILE set, PMC_BEGIN and PMC_END read the counters of the core before and after
+* a kernel with rdpmc: the unhalted core cycles and the instructions retired of the
+* fixed counters, and the last level cache misses and mispredicted branches, which have
+* to be programmed into general purpose counters 0 and 1.  PMC_END writes the
+* differences into a ring of the calling thread like trace_point does, and the thread
+* pmc_start starts adds them up per kernel and ROI, so a kernel only pays for the
+* reads and a few stores.  pmc_report prints the counts per call, the instructions per
+* cycle and the misses per thousand instructions of every kernel and ROI, PMC_STOP
+* stops the thread and prints them.
+*
+* Windows does not let user code read the counters by itself: a PMU driver, like the
+* one of Intel PCM, has to program the events and set CR4.PCE on every core.
+* pmc_start tries rdpmc once and, if it faults, counts only the TSC cycles of
+* __rdtsc, so the wall time is still split by kernel and ROI.  The counters are those
+* of one core, so the thread of the kernels should be pinned, see RtProfileConfig::cpu.
+* Everything compiles to nothing unless PMC_PROFILE is non-zero.
+*/
+
+#include <stdio.h>
+
+#ifndef PMC_PROFILE
+	/** @brief set to non-zero to compile the counters in */
+	#define PMC_PROFILE 0
+#endif
+
+/** @brief the counters read around a kernel */
+enum pmc_counter {
+	PMC_CYCLES = 0, /**< @brief core cycles, or TSC cycles without rdpmc */
+	PMC_INSTRUCTIONS,
+	PMC_LLC_MISSES, /**< @brief of general purpose counter 0 */
+	PMC_BRANCH_MISSES, /**< @brief of general purpose counter 1 */
+	PMC_COUNTERS
+};
+
+/** @brief the kernels counted across the system, user kernels start at PMC_USER */
+enum pmc_kernel {
+	PMC_THRESHOLD = 0,
+	PMC_ERODE,
+	PMC_POSITION, /**< @brief the blob search and update of position() */
+	PMC_STAGES, /**< @brief the fused pass of stage_pass() */
+	PMC_FIND, /**< @brief TrackingAlg::find of one dot, by dot tag */
+	PMC_USER = 8,
+	PMC_KERNELS = 16
+};
+
+/** @brief the ROIs, or dot tags, counted apart, the rest are counted with the last */
+#define PMC_ROIS 64
+
+/** @brief what pmc_start could set up */
+enum pmc_mode {
+	PMC_OFF = 0,
+	PMC_TSC, /**< @brief rdpmc faulted, only the TSC is read */
+	PMC_RDPMC
+};
+
+/** @brief the counters at one point of a thread */
+struct PmcSample {
+	unsigned __int64 v[PMC_COUNTERS];
+};
+
+/** @brief clears the sums and starts the thread adding them up, returns a pmc_mode */
+int pmc_start();
+/** @brief reads the counters of the calling thread's core */
+void pmc_read(PmcSample* s);
+/** @brief reads the counters again and adds what kernel took for roi since begin */
+void pmc_end(unsigned int kernel, unsigned int roi, const PmcSample* begin);
+/** @brief prints a line per kernel and ROI that was counted */
+void pmc_report(FILE* out);
+/** @brief stops the thread after adding up every ring */
+void pmc_stop();
+/** @brief the kernels not counted because a ring was full */
+unsigned int pmc_dropped();
+
+#if PMC_PROFILE
+	#define PMC_START() pmc_start()
+	#define PMC_STOP(out) (pmc_stop(), pmc_report(out))
+	#define PMC_SAMPLE(s) PmcSample s
+	#define PMC_BEGIN(s) pmc_read(&(s))
+	#define PMC_END(kernel, roi, s) pmc_end(kernel, roi, &(s))
+#else
+	#define PMC_START() (0)
+	#define PMC_STOP(out) ((void) 0)
+	#define PMC_SAMPLE(s)
+	#define PMC_BEGIN(s) ((void) 0)
+	#define PMC_END(kernel, roi, s) ((void) 0)
+#endif
+
+#endif /* _PMCPROFILE_H_ */
@@ -0,0 +1,175 @@
+#ifndef _RESULTBUS_H_
+#define _RESULTBUS_H_
+
+#include <vector>
+#include "_common.h"
+#include "DotsCodec.h"
+
+/**
+* @brief The memory a ResultBus and its readers share, in a process or in a
+* named file mapping.
+*
+* The header is followed by the slots, every one a ResultSlot header and
+* slot_size bytes of snapshot.  The fields only ever grow, so a reader can
+* tell from seq alone whether a slot held the frame it wanted the whole
+* time it copied it.
+*/
+struct ResultBusHeader {
+	unsigned int magic; /**< @brief ResultBus::MAGIC once the bus is set up */
+	unsigned int slots;
+	unsigned int slot_size; /**< @brief the snapshot bytes of a slot */
+	/** @brief the frames published, the newest is frame latest - 1 */
+	volatile unsigned long latest;
+};
+
+/** @brief the header of one slot of a bus */
+struct ResultSlot {
+	/** @brief 2 f + 1 while frame f is written into the slot, 2 f + 2 once it is complete */
+	volatile unsigned long seq;
+	unsigned int bytes; /**< @brief of the snapshot of the slot */
+};
+
+/**
+* @brief Hands the active dots of every tracked image to any number of readers.
+*
+* The thread that owns a Tracker, its Camera and its Dots is the only one
+* that can look at the dots, so a display, a logger, a sender or an
+* experiment script had to run in the tracking loop or copy the dots under a
+* lock of its own.  A ResultBus given to Tracker::bus(...) takes the dots at
+* the end of every track(): a DotsCodec writes a full snapshot of the active
+* dots into the next slot of a ring, and that is all the tracking loop does,
+* however many readers there are.  A ResultBusReader copies snapshots out of
+* the ring at its own pace, the newest with latest(...) or one after the
+* other with next(...):
+*
+* @code
+* ResultBus bus;
+* ResultBus::Config cfg = ResultBus::defaults();
+* cfg.name = "TDahResults";
+* if(bus.open(cfg)) {
+*     tracker.bus(&bus);
+* }
+* ...
+* ResultBusReader reader;     // in the same process or another one
+* Dots seen = makeDots(64);
+* reader.open("TDahResults");
+* while(reader.latest(seen)) { ... }
+* @endcode
+*
+* Every slot is a seqlock: the bus makes its sequence number odd, writes
+* the snapshot and makes it even again, and a reader keeps a copy only if
+* the number was the even one of its frame before and after the copy.  The
+* bus never waits for a reader and readers write nothing to the ring, so a
+* slow reader only misses frames, which next(...) counts, and the bus can be
+* mapped read-only into other processes.  With Config::name set the ring is
+* a named file mapping of the page file, which readers of other processes
+* open by the name; without it the ring is on the heap and readers attach to
+* the bus itself.
+*/
+
+class ResultBus
+{
+public:
+	/** @brief what open() sets up */
+	struct Config {
+		const char* name; /**< @brief the file mapping for other processes, NULL for none */
+		int slots; /**< @brief the frames of the ring */
+		int max_dots; /**< @brief the active dots of a frame at most */
+	};
+
+	/** @brief a ring of 16 frames of 64 dots on the heap */
+	static Config defaults();
+
+	ResultBus();
+	/** @brief unmaps the ring */
+	~ResultBus();
+
+	/** @brief sets up the ring, returns false if it could not */
+	bool open(const Config& cfg);
+	/** @brief unmaps the ring; readers of other processes keep theirs until they close */
+	void close();
+	bool isOpen() const { return _header != NULL; }
+
+	/** @brief copies the active dots into the next slot, never waits */
+	bool publish(const Dots& dots);
+
+	/** @brief the frames published and the ones too large for a slot */
+	unsigned long published() const { return _next; }
+	unsigned long dropped() const { return _dropped; }
+
+	/** @brief the magic number of a ring */
+	static const unsigned int MAGIC = 0x42534552; // "RESB"
+
+private:
+	Config _cfg;
+	/** @brief writes the snapshots, used by publish() only */
+	DotsCodec _codec;
+
+	ResultBusHeader* _header;
+	void* _mapping; /**< @brief the HANDLE of the file mapping, NULL on the heap */
+	unsigned long _next; /**< @brief the frame publish() writes next */
+	unsigned long _dropped;
+
+	friend class ResultBusReader;
+
+	// readers hold a pointer to the ring
+	ResultBus(const ResultBus&);
+	ResultBus& operator=(const ResultBus&);
+};
+
+/**
+* @brief Reads the frames of a ResultBus, see ResultBus.
+*
+* A reader belongs to one thread; every reader has its own place in the
+* ring, so the readers of a bus never see each other.
+*/
+
+class ResultBusReader
+{
+public:
+	ResultBusReader();
+	/** @brief unmaps the ring */
+	~ResultBusReader();
+
+	/** @brief reads the bus of this process */
+	bool open(const ResultBus& bus);
+	/** @brief maps the ring of the bus named name, read-only */
+	bool open(const char* name);
+	void close();
+	bool isOpen() const { return _header != NULL; }
+
+	/** @brief decodes the newest frame into dots, false if there is no new one */
+	bool latest(Dots& dots);
+	/** @brief decodes the frame after the last one read, or the oldest one kept */
+	bool next(Dots& dots);
+
+	/** @brief the snapshot of the last frame read, for a logger or a sender */
+	const std::vector<char>& snapshot() const { return _copy; }
+	/** @brief the frame number of the last frame read */
+	unsigned long frame() const { return _last - 1; }
+	/** @brief the frames next(...) skipped, because the bus had overwritten them */
+	unsigned long missed() const { return _missed; }
+
+	/** @brief how often a copy is tried again before giving up */
+	static const int RETRIES = 8;
+
+private:
+	const ResultBusHeader* _header;
+	void* _mapping; /**< @brief the HANDLE of the file mapping, NULL for a bus of this process */
+	/** @brief the frames read up to, frame _last - 1 was read last */
+	unsigned long _last;
+	unsigned long _missed;
+	std::vector<char> _copy;
+	DotsCodec _codec;
+
+	/** @brief copies frame f into _copy, false if it is not in the ring anymore */
+	bool copy(unsigned long f);
+	/** @brief the slot header of slot i */
+	const ResultSlot* slot(unsigned int i) const;
+
+	// a reader keeps the mapping of its ring
+	ResultBusReader(const ResultBusReader&);
+	ResultBusReader& operator=(const ResultBusReader&);
+};
+
+#endif /* _RESULTBUS_H_ */
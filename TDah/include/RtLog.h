@@ -0,0 +1,117 @@
+#ifndef _RTLOG_H_
+#define _RTLOG_H_
+
+/**
+* @file RtLog.h console messages of the hot paths, shared by TDah, HSV-Base and the
+* QNX controller.
+*
+* A printf to the console of Windows or of a QNX photon terminal can take
+* milliseconds, which the frame loops and the control loop cannot spare.  RTLOG_INFO
+* and the other macros take a printf format and up to RTLOG_MAX_ARGS numbers or
+* strings, and only copy the pointer to the format, the arguments and the cycle
+* counter into a ring owned by the calling thread, as TracePoint.h does for its
+* points: nothing is allocated, formatted or locked.  The thread started by
+* RTLOG_START formats the messages of every ring, in the order of their time, and
+* writes them to the console and to a file if one is given.  Before RTLOG_START and
+* after RTLOG_STOP a message is printed at once, like the printf it replaces.
+*
+* The format and every string argument are kept as pointers until the message is
+* written, so they must be literals or otherwise outlive it; a string in a buffer
+* the caller reuses has to be formatted by the caller.  A conversion may have flags,
+* a width, a precision and the length modifiers h, l, ll and I64; "*" is not taken.
+*
+* Messages above RTLOG_LEVEL compile to nothing, arguments and all.
+*/
+
+#ifndef RTLOG_LEVEL
+	/** @brief the most verbose level compiled in */
+	#define RTLOG_LEVEL RTLOG_LEVEL_INFO
+#endif
+
+#define RTLOG_LEVEL_ERROR 1
+#define RTLOG_LEVEL_WARN 2
+#define RTLOG_LEVEL_INFO 3
+#define RTLOG_LEVEL_DEBUG 4
+
+/** @brief the arguments of one message at most */
+#define RTLOG_MAX_ARGS 6
+
+#if defined(__QNX__)
+	typedef long long rtlog_int_t;
+	typedef unsigned long long rtlog_uint_t;
+#else
+	typedef __int64 rtlog_int_t;
+	typedef unsigned __int64 rtlog_uint_t;
+#endif
+
+/** @brief one argument of a message, as passed; the format tells how to print it */
+struct RtLogArg {
+	union {
+		rtlog_int_t i;
+		double d;
+		const void* p;
+	} v;
+
+	RtLogArg() { v.i = 0; }
+	RtLogArg(int x) { v.i = x; }
+	RtLogArg(unsigned int x) { v.i = x; }
+	RtLogArg(long x) { v.i = x; }
+	RtLogArg(unsigned long x) { v.i = x; }
+	RtLogArg(rtlog_int_t x) { v.i = x; }
+	RtLogArg(rtlog_uint_t x) { v.i = (rtlog_int_t) x; }
+	RtLogArg(double x) { v.d = x; }
+	RtLogArg(const char* x) { v.p = x; }
+	RtLogArg(const void* x) { v.p = x; }
+};
+
+/** @brief starts the thread writing the messages, to file as well unless it is NULL */
+int rtlog_start(const char* file);
+/** @brief stops the thread after writing every message */
+void rtlog_stop();
+/** @brief the number of messages dropped because a ring was full */
+unsigned int rtlog_dropped();
+
+/** @brief records a message of level for the calling thread */
+void rtlog_write(int level, const char* fmt);
+void rtlog_write(int level, const char* fmt, RtLogArg a1);
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2);
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3);
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3,
+	RtLogArg a4);
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3,
+	RtLogArg a4, RtLogArg a5);
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3,
+	RtLogArg a4, RtLogArg a5, RtLogArg a6);
+
+/**
+* @brief formats a message as snprintf would, from its recorded arguments
+*
+* @return the length of the message in buf, cut at size - 1
+*/
+int rtlog_format(char* buf, int size, const char* fmt, const RtLogArg* args, int nargs);
+
+#define RTLOG_START(file) rtlog_start(file)
+#define RTLOG_STOP() rtlog_stop()
+
+#if RTLOG_LEVEL >= RTLOG_LEVEL_ERROR
+	#define RTLOG_ERROR(...) rtlog_write(RTLOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+	#define RTLOG_ERROR(...) ((void) 0)
+#endif
+#if RTLOG_LEVEL >= RTLOG_LEVEL_WARN
+	#define RTLOG_WARN(...) rtlog_write(RTLOG_LEVEL_WARN, __VA_ARGS__)
+#else
+	#define RTLOG_WARN(...) ((void) 0)
+#endif
+#if RTLOG_LEVEL >= RTLOG_LEVEL_INFO
+	#define RTLOG_INFO(...) rtlog_write(RTLOG_LEVEL_INFO, __VA_ARGS__)
+#else
+	#define RTLOG_INFO(...) ((void) 0)
+#endif
+#if RTLOG_LEVEL >= RTLOG_LEVEL_DEBUG
+	#define RTLOG_DEBUG(...) rtlog_write(RTLOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+	#define RTLOG_DEBUG(...) ((void) 0)
+#endif
+
+#endif /* _RTLOG_H_ */
@@ -0,0 +1,74 @@
+#ifndef _RTPROFILE_H_
+#define _RTPROFILE_H_
+
+/**
+* @file RtProfile.h the real-time start up of the Windows vision binaries, shared by
+* TDah, HSV-Base and the Jian clients.
+*
+* By default a process runs at normal priority with the 15.6 ms timer of Windows, so
+* how long a frame takes depends on what else the PC does.  rt_profile_apply raises
+* the priority class of the process and the priority of the calling thread, which
+* should be the acquisition thread, registers that thread with the multimedia class
+* scheduler (MMCSS) as a task like "Capture" or "Pro Audio", sets the timer to 1 ms
+* with timeBeginPeriod and pins the thread to a core of its own.  Every setting is
+* tried even if one before it failed, and the outcome of each is kept in the
+* RtProfile for rt_profile_report, since most of them need rights or a Windows
+* version the process may not have.
+*
+* MMCSS and timeBeginPeriod are looked up in avrt.dll and winmm.dll at run time, so
+* the binaries link and run on Windows versions without MMCSS.
+*/
+
+#include <stdio.h>
+#include <windows.h>
+
+/** @brief the settings of a profile, in the order they are applied */
+enum rt_setting {
+	RT_PRIORITY_CLASS = 0, /**< @brief SetPriorityClass of the process */
+	RT_THREAD_PRIORITY, /**< @brief SetThreadPriority of the calling thread */
+	RT_MMCSS, /**< @brief AvSetMmThreadCharacteristics of the calling thread */
+	RT_TIMER, /**< @brief timeBeginPeriod */
+	RT_AFFINITY, /**< @brief SetThreadAffinityMask of the calling thread */
+	RT_SETTINGS
+};
+
+/** @brief what rt_profile_apply does, see rt_profile_defaults */
+struct RtProfileConfig {
+	DWORD priority_class; /**< @brief like HIGH_PRIORITY_CLASS, 0 to leave it */
+	int thread_priority; /**< @brief like THREAD_PRIORITY_TIME_CRITICAL */
+	int set_thread_priority; /**< @brief 0 to leave the thread priority */
+	const char* mmcss_task; /**< @brief "Capture", "Pro Audio", ..., NULL for none */
+	UINT timer_ms; /**< @brief the timer resolution, 0 to leave it */
+	int cpu; /**< @brief the core of the thread, -1 for none, RT_LAST_CPU for the last */
+};
+
+/** @brief RtProfileConfig::cpu for the last core, which the OS uses the least */
+#define RT_LAST_CPU (-2)
+
+/** @brief the state one rt_profile_apply leaves for rt_profile_revert */
+struct RtProfile {
+	/** @brief 1 if the setting was applied, 0 if it was not asked for, -1 if it failed */
+	int ok[RT_SETTINGS];
+	/** @brief the GetLastError of a failed setting */
+	DWORD error[RT_SETTINGS];
+
+	DWORD old_priority_class;
+	int old_thread_priority;
+	HANDLE thread; /**< @brief the thread the profile was applied to */
+	HANDLE mmcss; /**< @brief the handle of AvSetMmThreadCharacteristics */
+	DWORD mmcss_index;
+	UINT timer_ms;
+	int cpu;
+	DWORD_PTR old_affinity;
+};
+
+/** @brief high priority, a time critical thread, MMCSS "Capture", 1 ms timer, no pinning */
+void rt_profile_defaults(RtProfileConfig* c);
+/** @brief applies c to the process and calling thread, returns the settings that failed */
+int rt_profile_apply(RtProfile* p, const RtProfileConfig* c);
+/** @brief prints one line per setting */
+void rt_profile_report(const RtProfile* p, FILE* out);
+/** @brief undoes what rt_profile_apply did, on the thread it was applied on */
+void rt_profile_revert(RtProfile* p);
+
+#endif /* _RTPROFILE_H_ */
@@ -0,0 +1,82 @@
+#ifndef _TRACEPOINT_H_
+#define _TRACEPOINT_H_
+
+/**
+* @file TracePoint.h hot-path instrumentation shared by TDah, HSV-Base and the QNX
+* controller.
+*
+* A trace point records an (id, cycle counter) pair into a ring buffer owned by the
+* calling thread.  Nothing is allocated and no lock is taken on the hot path; a flush
+* thread started by TRACE_START drains every thread's ring into one binary file.  All
+* of the macros compile to nothing unless TRACE_POINTS is non-zero, so the calls can
+* stay in the code.
+*
+* The file is a TraceFileHeader followed by TraceRecords, both little-endian and
+* packed.  The TSC of each record can be converted to seconds with
+* TraceFileHeader::cycles_per_sec.
+*/
+
+#ifndef TRACE_POINTS
+	/** @brief set to non-zero to compile the trace points in */
+	#define TRACE_POINTS 0
+#endif
+
+#if defined(__QNX__)
+	#include <stdint.h>
+	typedef uint64_t trace_tsc_t;
+#else
+	typedef unsigned __int64 trace_tsc_t;
+#endif
+
+/** @brief the trace point ids used across the system, user ids start at TRACE_USER */
+enum trace_id {
+	TRACE_POSITION_START = 1,
+	TRACE_POSITION_STOP,
+	TRACE_TRACK_START,
+	TRACE_TRACK_STOP,
+	TRACE_GRAB_START,
+	TRACE_GRAB_STOP,
+	TRACE_SAMPLE_LOOP_START,
+	TRACE_SAMPLE_LOOP_STOP,
+	TRACE_USER = 100
+};
+
+#pragma pack(push, 1)
+
+/** @brief the header at the start of a trace file */
+struct TraceFileHeader {
+	char magic[4];
+	unsigned int version;
+	unsigned int record_size;
+	trace_tsc_t cycles_per_sec;
+};
+
+/** @brief one trace point as written to the trace file */
+struct TraceRecord {
+	unsigned int thread; /**< @brief index of the ring the point came from */
+	unsigned int id;
+	trace_tsc_t tsc;
+};
+
+#pragma pack(pop)
+
+/** @brief starts the flush thread writing to file, returns 0 on success */
+int trace_start(const char* file);
+/** @brief records trace point id for the calling thread */
+void trace_point(unsigned int id);
+/** @brief stops the flush thread after draining every ring */
+void trace_stop();
+/** @brief the number of trace points dropped because a ring was full */
+unsigned int trace_dropped();
+
+#if TRACE_POINTS
+	#define TRACE_START(file) trace_start(file)
+	#define TRACE_POINT(id) trace_point(id)
+	#define TRACE_STOP() trace_stop()
+#else
+	#define TRACE_START(file) (0)
+	#define TRACE_POINT(id) ((void) 0)
+	#define TRACE_STOP() ((void) 0)
+#endif
+
+#endif /* _TRACEPOINT_H_ */
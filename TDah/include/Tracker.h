@@ -4,6 +4,11 @@
 #include <string>
 #include <cv.h>
 #include "_common.h"
+#include "ImageView.h"
+
+class DotsPublisher;
+class ResultBus;
+class WorkerPool;
 
 
 /**
@@ -19,17 +24,34 @@ class Tracker
 public:
 	Tracker();
 	Tracker(TrackingAlg& alg);
+	~Tracker();
 
 	/** @brief sets the new tracking algorithm */
 	void algorithm(TrackingAlg& alg);
+	/** @brief tracks the dot tag with its own algorithm */
+	void algorithm(TrackingAlg& alg, int tag);
+	/** @brief tracks the dot tag with the algorithm of every dot again */
+	void defaultAlgorithm(int tag);
+
+	/** @brief tracks the active dots on threads threads, 1 tracks them serially */
+	void parallel(int threads);
+	/** @brief sets how location() finds the blobs of a whole image */
+	void detection(double thresh, int type = CV_THRESH_BINARY, int min_area = 4,
+		int max_size = 64);
+	/** @brief sends the active dots after every track() with pub, NULL for none */
+	void publisher(DotsPublisher* pub);
+	/** @brief hands the active dots to the readers of bus after every track(), NULL for none */
+	void bus(ResultBus* bus);
 
 	/** @brief the tracking function*/
 	bool track(Camera& cam, Dots& dots);
+	/** @brief tracks the active dots from the blobs of one pass over the whole image */
+	bool trackFrame(Camera& cam, Dots& dots);
 	/** @brief initialize dots based on where the user clicks on screen */
 	int click(Camera& cam, Dots& dots);
 	/** @brief initialize dots based on information found in a file */
 	int load(Camera& cam, Dots& dots, const std::string& file_name);
-	/** @brief initialize dots based on their pixel location */
+	/** @brief initialize dots by finding their blobs near their pixel location */
 	int location(Camera& cam, Dots& dots);
 	/** @brief draws the location of the active dots */
 	void draw(Camera& cam, Dots& dots, cv::Mat& dst = cv::Mat());
@@ -63,6 +85,72 @@ private:
 
 	/** @brief the tracking algorithm */
 	TrackingAlg* _alg;
+	/** @brief the algorithms of dots that have their own, NULL uses _alg, by tag */
+	std::vector<TrackingAlg*> _dot_algs;
+	/** @brief the threads tracking the dots, NULL when tracking serially */
+	WorkerPool* _pool;
+	/** @brief takes the dots of every track(), NULL for none */
+	DotsPublisher* _publisher;
+	/** @brief the bus track() publishes to, NULL for none */
+	ResultBus* _bus;
+
+	/** @name how location() finds blobs, see detection(...) */
+	//@{
+	double _det_thresh;
+	int _det_type;
+	int _det_min_area;
+	int _det_max_size;
+	//@}
+
+	/** @brief the image and dots of the track() call the pool is running */
+	struct TrackJob {
+		Tracker* tracker;
+		const ImageView* img;
+		Camera* cam;
+		Dots* dots;
+		ActiveDots* active;
+		std::vector<char> found; /**< @brief if every dot of a part was found */
+	};
+
+	/** @brief a blob location() found */
+	struct Blob {
+		cv::Point2d center;
+		int area;
+	};
+
+	/** @brief the image and the blobs of every band of the location() call */
+	struct DetectJob {
+		const cv::Mat* gray;
+		double thresh;
+		int type;
+		int min_area;
+		int max_size;
+		std::vector<std::vector<Blob> > blobs; /**< @brief the blobs, by band */
+	};
+
+	/** @brief finds the blobs that start in one band of rows, a WorkerPool::Job */
+	static void detectPart(void* ctx, int part, int parts);
+	/** @brief finds the blobs of a whole image on pool, serially if it is NULL */
+	void findBlobs(const cv::Mat& img, const ImageView& view, WorkerPool* pool,
+		std::vector<Blob>& blobs) const;
+	/** @brief blobs from top to bottom */
+	static bool blobOrder(const Blob& a, const Blob& b);
+	/** @brief true for a blob above row y */
+	static bool blobAbove(const Blob& a, double y);
+	/** @brief the offset of the layout that lines up most of its dots with blobs */
+	static cv::Point2d alignLayout(const std::vector<Blob>& blobs,
+		const std::vector<cv::Point2d>& layout, double tol);
+
+	/** @brief the algorithm tracking the dot tag */
+	TrackingAlg& algorithmOf(int tag) const;
+	/** @brief tracks one dot and updates its world location */
+	bool trackDot(const ImageView& img, Camera& cam, Dots& dots, int tag);
+	/** @brief tracks one part of the active dots, a WorkerPool::Job */
+	static void trackPart(void* ctx, int part, int parts);
+
+	// the pool belongs to exactly one tracker
+	Tracker(const Tracker&);
+	Tracker& operator=(const Tracker&);
 };
 
 #endif /* _TRACKER_H_ */
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <string>
 #include <cv.h>
 #include "_common.h"
+#include "ImageView.h"
 
 /**
 * A class for passing to a Tracker object.
@@ -18,8 +19,13 @@ public:
 	/** @brief the destructor for this class */
 	virtual ~TrackingAlg();
 
+	/** @brief sets up any per-dot state for dots dots before they are tracked */
+	virtual void reserve(int dots);
+
 	/** @brief finds a dot in an image */
 	virtual bool find(const cv::Mat& img, const Dot& dot, cv::Point2d& new_loc, double& area);
+	/** @brief finds a dot in a view of an image, placed in the image frame */
+	virtual bool find(const ImageView& img, const Dot& dot, cv::Point2d& new_loc, double& area);
 	/** @brief finds a dot in an image */
 	virtual bool find_pbu(const cv::Mat& img, const Dot& dot, cv::Point2d& new_loc, double& area);
 
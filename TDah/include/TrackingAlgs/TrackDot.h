@@ -14,6 +14,27 @@
 class TrackDot : public TrackingAlg
 {
 public:
+	/** @brief the ways of fitting a circle to the boundary of a dot */
+	enum fits {
+		ENCLOSING = 0, /**< OpenCV's minEnclosingCircle */
+		WELZL, /**< Welzl's minimum enclosing circle, rejecting too large dots early */
+		KASA /**< Kasa's least squares circle, robust to single outlying pixels */
+	};
+
+	/** @brief the ways of locating a dot, see method(...) */
+	enum methods {
+		CIRCLE = 0, /**< the center of the circle fit to the dot's boundary */
+		CENTROID, /**< the centroid of the dot's pixels, see find_pbu(...) */
+		MOMENTS /**< the first moments of the thresholded rectangle */
+	};
+
+	/** @brief what tells the identity classes of coded dots apart, see code(...) */
+	enum codes {
+		NO_CODE = 0, /**< the dots are told apart by their positions only */
+		SIZE_CODE, /**< the radius find(...) reports in area */
+		INTENSITY_CODE /**< the mean gray level of the pixels that pass the threshold */
+	};
+
 	TrackDot(int roi_width, int roi_height, int threshold_type);
 	TrackDot(int roi_width, int roi_height, int threshold_type, int threshold,
 		double min_radius, double max_radius);
@@ -21,8 +42,13 @@ public:
 	/** @brief the destructor for this class */
 	virtual ~TrackDot();
 
+	/** @brief sets up the scratch buffers of dots dots */
+	virtual void reserve(int dots);
+
 	/** @brief finds a dot in an image */
 	virtual bool find(const cv::Mat& img, const Dot& dot, cv::Point2d& new_loc, double& area);
+	/** @brief finds a dot in a view of an image, placed in the image frame */
+	virtual bool find(const ImageView& img, const Dot& dot, cv::Point2d& new_loc, double& area);
 	/** @brief finds a dot in an image */
 	virtual bool find_pbu(const cv::Mat& img, const Dot& dot, cv::Point2d& new_loc, double& area);
 	/** @brief finds a dot in an image */
@@ -36,12 +62,60 @@ public:
 
 	/** @brief sets all dot tracking parameters */
 	void set(int roi_width, int roi_height, int threshold, int threshold_type, 
-		double min_radius, double max_radius);
+		double min_radius, double max_radius, int fit = ENCLOSING, int step = 1);
+
+	/** @brief sets how find(...) locates a dot, one of methods */
+	void method(int m);
+	/** @brief returns how find(...) locates a dot */
+	int method() const;
+	/** @brief sets the channel color images are thresholded on, GRAY converts them */
+	void channel(int c);
+	/** @brief returns the channel color images are thresholded on */
+	int channel() const;
+	/** @brief moves the boundary to the sub-pixel edge before a CIRCLE fit, see refineCircle(...) */
+	void refine(bool on);
+	/** @brief true, if the boundary is refined before a CIRCLE fit */
+	bool refine() const;
+
+	/** @brief sets what the class of a dot is measured by and the bounds between the classes */
+	void code(int c, const std::vector<double>& bounds);
+	/** @brief returns what the class of a dot is measured by, one of codes */
+	int code() const;
+	/** @brief gives dot tag the identity class cls, -1 for none */
+	void identity(int tag, int cls);
+	/** @brief the identity class of dot tag, -1 if it has none */
+	int identity(int tag) const;
+	/** @brief the class find(...) measured for dot tag, -1 if none was */
+	int measuredClass(int tag) const;
+	/** @brief the tag whose identity is class cls, BAD_TAG if there is none */
+	int tagOfClass(int cls) const;
+
+	/** @brief channel(...) converts color images to gray scale */
+	static const int GRAY = -1;
 
 	/** @brief a wrapper function that accepts 1-channel or 3-channel images */
 	void threshold(const cv::Mat& src, const cv::Rect roi, cv::Mat& dst) const;
 
 private:
+	/** @brief the buffers find() reuses for one dot, so tracking allocates nothing */
+	struct Scratch {
+		/** @brief the binarized tracking rectangle */
+		cv::Mat_<uchar> pixel;
+		/** @brief the boundary pixels, with room for every pixel of the rectangle */
+		std::vector<cv::Point> boundary;
+		/** @brief the sub-pixel edge points of refineCircle(...) */
+		std::vector<cv::Point2f> edge;
+		/** @brief the distances of the edge points from the circle */
+		std::vector<float> residual;
+		/** @brief the class find(...) measured last, -1 for none */
+		int measured;
+		/** @brief the identity class of the dot, -1 for none */
+		int identity;
+	};
+
+	/** @brief the scratch buffers by dot tag */
+	std::vector<Scratch> _scratch;
+
 	/** @brief the threshold value to use */
 	int _thr;
 	/** @brief the threshold type (see OpenCV's threshold documentation) */
@@ -54,11 +128,62 @@ private:
 	double _minr;
 	/** @brief the maximum size radius to track */
 	double _maxr;
+	/** @brief the circle fit, one of fits */
+	int _fit;
+	/** @brief only every _step-th boundary pixel is fitted */
+	int _step;
+	/** @brief how find(...) locates a dot, one of methods */
+	int _method;
+	/** @brief the channel of color images to threshold, or GRAY */
+	int _channel;
+	/** @brief true, if the boundary is refined to the sub-pixel edge */
+	bool _refine;
+	/** @brief what the class of a dot is measured by, one of codes */
+	int _code;
+	/** @brief the upper bounds of the classes but the last, ascending */
+	std::vector<double> _bounds;
+	/** @brief the tag of every identity class, BAD_TAG for a class no dot has */
+	std::vector<int> _class_tag;
 	/** @brief the name of the trackbar window */
 	std::string _trackbar_window;
+	/** @brief the index of the rectangle in FIXED_SIDES, -1 if no kernel is compiled for it */
+	int _fixed;
 
 	/** @brief calculates a valid tracking rectangle inside the image */
 	cv::Rect calcRoi(const cv::Point2d& pixel, const cv::Size& img_size) const;
+	/** @brief the view of the tracking rectangle around an image frame pixel */
+	ImageView trackingRect(const ImageView& img, const cv::Point2d& pixel) const;
+	/** @brief fits a circle to the boundary, false if it cannot pass the size filter */
+	bool fitCircle(std::vector<cv::Point>& boundary, cv::Point2f& center, float& radius) const;
+	/** @brief fits a circle to the sub-pixel edge around the boundary of a dot */
+	bool refineCircle(const ImageView& rect, Scratch& s, cv::Point2f& center, float& radius) const;
+	/** @brief finds a dot by fitting a circle to its boundary */
+	bool findCircle(const ImageView& img, const Dot& dot, cv::Point2d& new_loc, double& area);
+	/** @brief finds a dot from the moments of its thresholded rectangle */
+	bool findMoments(const ImageView& img, const Dot& dot, cv::Point2d& new_loc, double& area);
+	/** @brief finds a dot at the centroid of its thresholded pixels */
+	bool findCentroid(const ImageView& img, const Dot& dot, cv::Point2d& new_loc, double& area);
+	/** @brief finds the boundary of a dot in a CN-channel rectangle, thresholded with TYPE */
+	template<int TYPE, int CN, int SIDE>
+	void findBoundary(const ImageView& rect, Scratch& s) const;
+	/** @brief thresholds a gray scale rectangle with TYPE and finds its boundary in one pass */
+	template<int TYPE, int SIDE>
+	void thresholdBoundary(const ImageView& rect, std::vector<cv::Point>& boundary) const;
+	/** @brief converts a color rectangle to gray scale, or takes its channel(...) */
+	void gray(const cv::Mat& src, const cv::Rect roi, cv::Mat& dst) const;
+	/** @brief converts a color rectangle and thresholds it with TYPE in one pass */
+	template<int TYPE>
+	void colorThreshold(const cv::Mat& src, const cv::Rect roi, cv::Mat& dst) const;
+	/** @brief the pixel sums of a rectangle thresholded with TYPE, in one pass */
+	template<int TYPE, bool WEIGHTED, int SIDE>
+	void centroidSums(const ImageView& rect, int t, int64 sums[4]) const;
+	/** @brief the pixel sums of the tracking rectangle of a dot */
+	void centroid(const ImageView& rect, Scratch& s, bool weighted, int64 sums[4]) const;
+	/** @brief the class of a dot found with radius area at new_loc, -1 if it cannot be measured */
+	int measureClass(const ImageView& img, Scratch& s, const cv::Point2d& new_loc,
+		double area) const;
+	/** @brief the image position of a point of the tracking rectangle */
+	static cv::Point2d imagePoint(const ImageView& rect, const cv::Point2f& p);
 };
 
 #endif /* _TRACKDOT_H_ */
\ No newline at end of file
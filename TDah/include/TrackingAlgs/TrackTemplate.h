@@ -0,0 +1,126 @@
+#ifndef _TRACKTEMPLATE_H_
+#define _TRACKTEMPLATE_H_
+
+#include "TrackingAlg.h"
+
+/**
+* @brief Tracks a textured target by normalized cross-correlation
+*
+* TrackDot needs a bright or dark dot to threshold, a TrackTemplate finds
+* any patch that is textured enough, so low-contrast targets need no
+* painted markers.  The first time a dot is searched for, the patch of
+* templ_width x templ_height pixels around its location is taken as its
+* template, see learn(...).  Afterwards the template is searched for in the
+* tracking rectangle around the last location, the same rectangle TrackDot
+* uses, and the dot is where the normalized cross-correlation is largest.
+*
+* The search runs coarse to fine over a pyramid of levels() levels, each
+* half the size of the one below: every position of the coarsest level is
+* tried, every finer level only tries the positions around the best one of
+* the level above.  The sums and squares of the pixels under the template
+* come from running-sum integral images and the correlations are SSE2 dot
+* products, so a 64x64 rectangle with a 32x32 template is searched well
+* inside the time of a frame at kHz rates.
+*/
+
+class TrackTemplate : public TrackingAlg
+{
+public:
+	TrackTemplate(int roi_width, int roi_height, int templ_width, int templ_height,
+		double min_score = 0.7, int levels = 2);
+
+	/** @brief the destructor for this class */
+	virtual ~TrackTemplate();
+
+	/** @brief sets up the templates and scratch buffers of dots dots */
+	virtual void reserve(int dots);
+
+	/** @brief finds a dot in an image */
+	virtual bool find(const cv::Mat& img, const Dot& dot, cv::Point2d& new_loc, double& area);
+	/** @brief finds a dot in a view of an image, placed in the image frame */
+	virtual bool find(const ImageView& img, const Dot& dot, cv::Point2d& new_loc, double& area);
+
+	/** @brief draws the tracking rectangle and the template of a dot */
+	virtual void draw(const cv::Mat& src, const Dot& dot, cv::Mat& dst);
+
+	/** @brief sets all template tracking parameters */
+	void set(int roi_width, int roi_height, int templ_width, int templ_height,
+		double min_score, int levels);
+
+	/** @brief takes the template of a dot from the image around its location */
+	bool learn(const ImageView& img, const Dot& dot);
+	/** @brief forgets the template of a dot, so find(...) takes a new one */
+	void forget(int tag);
+	/** @brief true if the dot has a template */
+	bool learned(int tag) const;
+
+	/** @brief returns the number of pyramid levels that are searched */
+	int levels() const;
+
+	/** @brief the most pyramid levels */
+	static const int MAX_LEVELS = 3;
+
+private:
+	/** @brief a template at one level of the pyramid */
+	struct Level {
+		/** @brief the pixels, row by row */
+		std::vector<short> t;
+		/** @brief the size of the template */
+		int w, h;
+		/** @brief the sum of the pixels */
+		int sum;
+		/** @brief n times the sum of the squares less the square of the sum */
+		double var;
+	};
+
+	/** @brief the template and the buffers find() reuses for one dot */
+	struct State {
+		/** @brief the template at every level */
+		Level level[MAX_LEVELS];
+		/** @brief the location of the dot in the template */
+		cv::Point2d anchor;
+		/** @brief true if the dot has a template */
+		bool learned;
+		/** @brief the gray tracking rectangle of a color image */
+		cv::Mat_<uchar> gray;
+		/** @brief the tracking rectangle at the levels above the first */
+		cv::Mat_<uchar> pyr[MAX_LEVELS];
+		/** @brief the integral images of the pixels and their squares */
+		std::vector<int> sum;
+		std::vector<int64> sqsum;
+		/** @brief the scores of the positions of the last search */
+		std::vector<float> scores;
+	};
+
+	/** @brief the templates by dot tag */
+	std::vector<State> _state;
+
+	/** @brief the width of the tracking rectangle */
+	int _rw;
+	/** @brief the height of the tracking rectangle */
+	int _rh;
+	/** @brief the width of the template */
+	int _tw;
+	/** @brief the height of the template */
+	int _th;
+	/** @brief the least score of a match */
+	double _min_score;
+	/** @brief the number of pyramid levels */
+	int _levels;
+
+	/** @brief calculates a valid tracking rectangle inside the image */
+	cv::Rect calcRoi(const cv::Point2d& pixel, const cv::Size& img_size) const;
+	/** @brief the state of a dot, made if it has none */
+	State& state(const Dot& dot);
+	/** @brief a gray view of a rectangle, converted into buf if it is color */
+	static ImageView grayView(const ImageView& rect, cv::Mat_<uchar>& buf);
+	/** @brief halves a view with 2x2 averages */
+	static void halve(const ImageView& src, cv::Mat_<uchar>& dst);
+	/** @brief the score of the template at every position of r, returns the best */
+	cv::Point search(State& s, const Level& t, const ImageView& v, const cv::Rect& r,
+		float& score) const;
+	/** @brief the sum of the products of the template and the pixels below it */
+	static int correlate(const Level& t, const ImageView& v, int x, int y);
+};
+
+#endif /* _TRACKTEMPLATE_H_ */
@@ -0,0 +1,118 @@
+#ifndef _TRIGGERSOURCE_H_
+#define _TRIGGERSOURCE_H_
+
+#include <vector>
+
+/**
+* @file TriggerSource.h the camera trigger of an NI-DAQ counter, shared by TDah and
+* HSV-Base.
+*
+* A TriggerSource drives the trigger input of the frame grabber (ASYNC_TRIGGER, see
+* FG_TRIGGERINSRC of VideoCaptureMe3) with a pulse train of a counter output, either
+* continuous or a finite number of pulses, and its frequency can be changed while it
+* runs.
+*
+* With a stamp counter the period of every pulse is measured by a second counter on
+* the timebase of the board, so the time of each pulse is known exactly even across
+* frequency changes.  Pairing those times with the timestamps the frame grabber gives
+* its images (frame()) measures the trigger-to-frame delay; the clocks of the board
+* and of the grabber are not the same, so jitter() fits the delay as a line over time
+* and reports the spread about it.
+*
+* NI-DAQmx is looked up in nicaiu.dll at run time, like in AnalogPublisher.h, so the
+* library builds and runs without it; open() fails then.
+*/
+
+typedef void* TaskHandle;
+
+class TriggerSource
+{
+public:
+	/** @brief how the pulses are made */
+	struct Config {
+		const char* counter; /**< @brief the counter of the pulse train, like "Dev4/ctr0" */
+		const char* stampCounter; /**< @brief the counter measuring its periods, NULL for none */
+		const char* stampTerm; /**< @brief where the train is seen by stampCounter, like "/Dev4/Ctr0InternalOutput" */
+		double freq; /**< @brief Hz */
+		double duty; /**< @brief the high time over the period */
+		double delay; /**< @brief s from start() to the first pulse */
+		unsigned int pulses; /**< @brief 0 for a continuous train */
+	};
+
+	/** @brief the trigger-to-frame delay of the pairs since resetJitter(), in us */
+	struct Jitter {
+		int n;
+		double offset; /**< @brief of the fit at the first pulse, includes the clock offset */
+		double drift; /**< @brief of the fit, us/s, the clocks running apart */
+		double std; /**< @brief of the delay about the fit */
+		double min, max; /**< @brief of the delay about the fit */
+	};
+
+	/** @brief the config of the fchwt.cpp test: Dev4/ctr0, no stamps */
+	static Config defaults();
+
+	TriggerSource();
+	/** @brief stops and clears the tasks */
+	~TriggerSource();
+
+	/** @brief creates the tasks, does not start them */
+	bool open(const Config& cfg);
+	/** @brief stops and clears the tasks */
+	void close();
+
+	/** @brief starts the stamp counter and then the pulses */
+	bool start();
+	/** @brief stops the pulses, the stamps so far can still be read */
+	bool stop();
+	/** @brief true once a finite train has made all of its pulses */
+	bool done();
+
+	/** @brief changes the frequency and duty of a running train from its next pulse */
+	bool setFrequency(double freq, double duty);
+	double frequency() const;
+
+	/** @brief reads the periods measured since the last poll, returns how many or -1 */
+	int poll();
+	/** @brief the pulses known, stamped or not */
+	unsigned int pulses() const;
+	/** @brief the time of the pulse-th pulse (1 is the first) after the first, in s */
+	bool stamp(unsigned int pulse, double& sec) const;
+
+	/** @brief pairs the grabber timestamp of the image of the pulse-th pulse with it */
+	bool frame(unsigned int pulse, double fg_us);
+	/** @brief the delay of the pairs so far */
+	Jitter jitter() const;
+	void resetJitter();
+
+	/** @brief the extended error information of the last call that failed */
+	const char* error() const;
+
+private:
+	/** @brief the stamps kept, older pulses can no longer be paired */
+	static const int STAMPS = 8192;
+
+	Config _cfg;
+	TaskHandle _pulse;
+	TaskHandle _stamp;
+	double _freq;
+	double _duty;
+	bool _changed; /**< @brief the frequency changed, without stamps the times are unknown */
+
+	/** @brief the time of pulse p at _times[(p - 1) % STAMPS] */
+	std::vector<double> _times;
+	unsigned int _stamped;
+	std::vector<double> _periods; /**< @brief read buffer of poll() */
+
+	/** @brief the (pulse time s, grabber us) pairs */
+	std::vector<double> _pairT;
+	std::vector<double> _pairD;
+
+	char _err[2048];
+
+	bool check(int rc, const char* what);
+
+	TriggerSource(const TriggerSource&);
+	TriggerSource& operator=(const TriggerSource&);
+};
+
+#endif /* _TRIGGERSOURCE_H_ */
@@ -0,0 +1,129 @@
+#ifndef _VISIONWIRE_H_
+#define _VISIONWIRE_H_
+
+/**
+* @file VisionWire.h the messages between the vision PCs and the QNX controller,
+* shared by the VisionTCP of the Jian clients and the VisionNet of QnxKit_Analysis.
+*
+* Every message is a packed struct in the byte order of x86, little-endian, which
+* both ends are; a build for a big-endian target stops below instead of sending
+* swapped doubles.  The sizes are checked at compile time, so a field added in one
+* place breaks the build of both sides and not the link between them.
+*
+* The TCP stream is VisionWireSample after VisionWireSample: a ROI and its x, y, or
+* one of the negative VISION_NET_* tags in place of the ROI.  The first message of a
+* session is a VISION_NET_HELLO with the VISION_WIRE_VERSION of the sender; a
+* sender without one is of version 1.  A new message is a new tag, or a new magic
+* like VisionBatch, and a new layout of an old one a new version: the structs
+* below are never changed in place.
+*
+* The receiver decodes in place: vision_wire_sample() and vision_wire_batch() check
+* the length, and the magic and version of a batch, and return the message where it
+* is in the receive buffer, no copy; packed structs are read unaligned, which x86
+* does.
+*/
+
+/** @brief of the layout of the messages below, sent in the VISION_NET_HELLO */
+#define VISION_WIRE_VERSION	2
+
+#define VISION_NET_NUM_CH	3 /**< @brief the doubles of a VisionWireSample */
+#define VISION_NET_PACKET	(VISION_NET_NUM_CH*8)
+#define VISION_NET_MAX_MARKERS	16 /**< @brief of a VisionBatch */
+
+/** @brief the tags of a VisionWireSample, in place of its ROI */
+#define VISION_NET_STAMP	(-1001.0) /**< @brief vision: tag, frame id, vision time of the frame [s], before its samples */
+#define VISION_NET_PING		(-1002.0) /**< @brief qnx: tag, ping number, qnx time [s] */
+#define VISION_NET_PONG		(-1003.0) /**< @brief vision: tag, the qnx time of the ping [s], vision time of the reply [s] */
+#define VISION_NET_BEAT		(-1004.0) /**< @brief vision: tag, beat number, vision time [s], whenever it sent nothing for a while */
+#define VISION_NET_HELLO	(-1005.0) /**< @brief vision: tag, VISION_WIRE_VERSION, VISION_WIRE_* flags, first of a session */
+
+/** @brief the flags of a VISION_NET_HELLO */
+#define VISION_WIRE_BATCH	0x01 /**< @brief the markers come in VisionBatch, not in samples */
+#define VISION_WIRE_UDP		0x02 /**< @brief the samples come in VisionPacket datagrams */
+
+/** @brief the magic of a VisionBatch; a whole ROI or tag sent as the first double of a
+* sample never has these low bytes */
+#define VISION_BATCH_MAGIC	0x424D4E56 /* "VNMB" */
+
+#define VISION_MARKER_FOUND		0x01 /**< @brief x, y are valid */
+#define VISION_MARKER_VELOCITY	0x02 /**< @brief vx, vy are valid */
+
+#if defined(__BIG_ENDIAN__) || (defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	#error "VisionWire.h: the messages are little-endian, this target is not"
+#endif
+
+/** @brief fails to compile, with name in the error, unless cond */
+#define VISION_WIRE_CHECK(cond, name) typedef char vision_wire_check_##name[(cond) ? 1 : -1]
+
+#pragma pack(push, 1)
+
+/** @brief a message of the TCP stream: ROI, x, y, or a tag and its two values */
+struct VisionWireSample {
+	double val[VISION_NET_NUM_CH];
+};
+
+/** @brief the datagram of one sample in the UDP mode; seq counts every datagram */
+struct VisionPacket {
+	unsigned int seq;
+	double time_stamp; /**< @brief of the camera frame */
+	unsigned short count; /**< @brief of val, VISION_NET_NUM_CH */
+	double val[VISION_NET_NUM_CH];
+};
+
+/** @brief the message of all markers of a frame, followed by count VisionMarker */
+struct VisionBatch {
+	unsigned int magic; /**< @brief VISION_BATCH_MAGIC */
+	unsigned short version; /**< @brief VISION_WIRE_VERSION */
+	unsigned short count;
+	unsigned int seq;
+	unsigned int frame_id;
+	double time_stamp;
+};
+
+struct VisionMarker {
+	float x, y; /**< @brief world position, mm */
+	float vx, vy; /**< @brief world velocity, mm/s */
+	unsigned char flags; /**< @brief VISION_MARKER_* */
+};
+
+#pragma pack(pop)
+
+VISION_WIRE_CHECK(sizeof(VisionWireSample) == VISION_NET_PACKET, sample_size);
+VISION_WIRE_CHECK(sizeof(VisionPacket) == 38, packet_size);
+VISION_WIRE_CHECK(sizeof(VisionBatch) == 24, batch_size);
+VISION_WIRE_CHECK(sizeof(VisionMarker) == 17, marker_size);
+
+/** @brief the sample at buf if len bytes hold one, else 0 */
+inline const VisionWireSample* vision_wire_sample(const void* buf, int len)
+{
+	return len >= (int)sizeof(VisionWireSample) ? (const VisionWireSample*)buf : 0;
+}
+
+/** @brief the batch at buf if len bytes hold all of it and it is of this version, else 0 */
+inline const VisionBatch* vision_wire_batch(const void* buf, int len)
+{
+	const VisionBatch* b = (const VisionBatch*)buf;
+	if(len < (int)sizeof(VisionBatch) || b->magic != VISION_BATCH_MAGIC || b->version != VISION_WIRE_VERSION ||
+		b->count > VISION_NET_MAX_MARKERS || len < (int)(sizeof(VisionBatch) + b->count*sizeof(VisionMarker))) {
+		return 0;
+	}
+	return b;
+}
+
+/** @brief the markers that follow a batch */
+inline const VisionMarker* vision_wire_markers(const VisionBatch* b)
+{
+	return (const VisionMarker*)(b + 1);
+}
+
+/** @brief a sample or a tag and its two values */
+inline VisionWireSample vision_wire_make(double roi_or_tag, double a, double b)
+{
+	VisionWireSample s;
+	s.val[0] = roi_or_tag;
+	s.val[1] = a;
+	s.val[2] = b;
+	return s;
+}
+
+#endif /* _VISIONWIRE_H_ */
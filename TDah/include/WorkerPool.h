@@ -0,0 +1,60 @@
+#ifndef _WORKERPOOL_H_
+#define _WORKERPOOL_H_
+
+#include <vector>
+
+/**
+* @brief A fixed set of threads that run one job split into parts.
+*
+* The threads are created once and sleep between jobs, so handing out a job
+* costs a few event signals instead of a thread start.  A job is split into
+* size() parts; the calling thread runs part 0 and every worker thread one of
+* the other parts.  run() returns once every part is done, so the caller can
+* read the results of all parts without any further synchronization.
+*
+* Which part runs on which thread never changes, so a job that only writes
+* data belonging to its part gives the same results on every run.
+*/
+
+class WorkerPool
+{
+public:
+	/** @brief a part of a job, called with the part number in [0, parts) */
+	typedef void (*Job)(void* ctx, int part, int parts);
+
+	/** @brief creates a pool of threads threads, including the calling thread */
+	WorkerPool(int threads);
+	/** @brief stops and joins the worker threads */
+	~WorkerPool();
+
+	/** @brief the number of parts a job is split into */
+	int size() const;
+	/** @brief runs every part of job and waits for all of them */
+	void run(Job job, void* ctx);
+
+	/** @brief the number of processors of the machine */
+	static int cores();
+
+private:
+	struct Worker {
+		WorkerPool* pool;
+		int part;
+		void* thread;
+		void* go; /**< @brief signaled when the worker has a part to run */
+	};
+
+	std::vector<Worker> _workers;
+	void* _done; /**< @brief signaled when the last worker finished its part */
+	volatile long _pending;
+	volatile bool _quit;
+	Job _job;
+	void* _ctx;
+
+	static unsigned long __stdcall main(void* param);
+
+	// the threads hold a pointer to the pool
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+};
+
+#endif /* _WORKERPOOL_H_ */
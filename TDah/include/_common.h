@@ -12,11 +12,20 @@ enum {
 	TDAH_PROP_LAST_GRABBED_IMAGE,
 	TDAP_PROP_LAST_TRANSFERRED_IMAGE,
 	TDAH_PROP_MIN_FRAME_TIME,
+	TDAH_PROP_ASYNC,
+	TDAH_PROP_MONITOR,
+	TDAH_PROP_BACKLOG,
+	TDAH_PROP_LOST_IMAGES,
+	TDAH_PROP_PRESSURE,
+	TDAH_PROP_IMAGE_X,
+	TDAH_PROP_IMAGE_Y,
 };
 
 class Dot;
 class Dots;
+class DotsCodec;
 class Camera;
+class CameraGroup;
 class Tracker;
 class TrackingAlg;
 
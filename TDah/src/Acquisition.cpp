@@ -0,0 +1,198 @@
+/**
+* @file Acquisition.cpp
+*/
+
+// keeps the min and max macros of windows.h off std::min and std::max
+#define NOMINMAX
+#include <windows.h>
+#include "Dots.h"
+#include "Camera.h"
+#include "Tracker.h"
+#include "Acquisition.h"
+
+/** @brief the frames the thread can publish before next() reads them */
+#define FRAMES 8
+
+/**
+* Sets up the acquisition of a camera.  The tracker and its TrackingAlg are
+* used on the thread, so they must not be used by anyone else while it
+* runs, and neither must dots.  tracked, if not NULL, is called on the
+* thread after every frame was tracked, before the frame is published, e.g.,
+* to add the dots back to the ROI queue of a VideoCaptureMe3.
+*
+* @param[in] cam the camera, grabbed with Camera::grab(int, Dots&)
+* @param[in] tracker the tracker of the camera
+* @param[in] dots the dots the thread grabs and tracks
+* @param[in] tracked called after every tracked frame, may be NULL
+* @param[in] ctx passed to tracked
+*/
+
+Acquisition::Acquisition(Camera& cam, Tracker& tracker, Dots& dots, Tracked tracked,
+	void* ctx)
+	: _cam(&cam), _tracker(&tracker), _dots(&dots), _tracked(tracked), _ctx(ctx),
+	_head(0), _tail(0), _lost(0), _quit(false), _first_img(1), _thread(NULL),
+	_ready(NULL)
+{
+
+}
+
+Acquisition::~Acquisition()
+{
+	stop();
+}
+
+/**
+* Starts the thread.  The frames are allocated here, as large as dots, so
+* tracking allocates nothing.
+*
+* @param[in] first_img the image number of the first grab
+* @return false, if the thread could not be started
+*/
+
+bool Acquisition::start(int first_img)
+{
+	Frame f;
+
+	if(_thread != NULL) {
+		return true;
+	}
+
+	f.dots = *_dots;
+	f.found = false;
+	_frames.assign(FRAMES, f);
+	_head = _tail = _lost = 0;
+	_first_img = first_img;
+	_quit = false;
+
+	_ready = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if(_ready == NULL) {
+		return false;
+	}
+
+	_thread = CreateThread(NULL, 0, main, this, 0, NULL);
+	if(_thread == NULL) {
+		CloseHandle(_ready);
+		_ready = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void Acquisition::stop()
+{
+	if(_thread == NULL) {
+		return;
+	}
+
+	_quit = true;
+	WaitForSingleObject(_thread, INFINITE);
+	CloseHandle(_thread);
+	_thread = NULL;
+	CloseHandle(_ready);
+	_ready = NULL;
+}
+
+bool Acquisition::running() const
+{
+	return _thread != NULL;
+}
+
+/** @brief grabs, tracks and publishes frames until stop() */
+unsigned long __stdcall Acquisition::main(void* param)
+{
+	Acquisition* a = static_cast<Acquisition*> (param);
+	int img_nbr = a->_first_img - 1;
+	bool found;
+
+	while(!a->_quit) {
+		if(!a->_cam->grab(img_nbr + 1, *a->_dots)) {
+			continue;
+		}
+
+		ActiveDots& active = a->_dots->activeDots();
+		if(!active.empty()) {
+			img_nbr = active[0]->imageNbr();
+		}
+
+		found = a->_tracker->track(*a->_cam, *a->_dots);
+		if(a->_tracked != NULL) {
+			a->_tracked(a->_ctx, *a->_cam, *a->_dots);
+		}
+
+		a->publish(found);
+	}
+
+	return 0;
+}
+
+/**
+* Copies the dots into the next frame of the ring, unless the ring is full.
+* The dots have the size the frames were allocated with, so the copy
+* allocates nothing.
+*/
+
+void Acquisition::publish(bool found)
+{
+	if(_tail - _head >= FRAMES) {
+		InterlockedIncrement(&_lost);
+		return;
+	}
+
+	Frame& f = _frames[_tail % FRAMES];
+	f.dots = *_dots;
+	f.found = found;
+
+	// the frame must be complete before next() can see it
+	MemoryBarrier();
+	_tail = _tail + 1;
+	SetEvent(_ready);
+}
+
+bool Acquisition::next(Dots& dots, int timeout_ms)
+{
+	bool found;
+
+	return next(dots, found, timeout_ms);
+}
+
+/**
+* Waits until the thread published a frame next() has not returned yet and
+* copies its dots.  The frames are returned in the order they were tracked;
+* the thread is already grabbing the frame after it.
+*
+* @param[out] dots the dots of the frame
+* @param[out] found true, if every active dot of the frame was found
+* @param[in] timeout_ms how long to wait for a frame
+* @return false, if the thread is not running or published no frame in time
+*/
+
+bool Acquisition::next(Dots& dots, bool& found, int timeout_ms)
+{
+	if(_thread == NULL) {
+		return false;
+	}
+
+	while(_tail == _head) {
+		if(WaitForSingleObject(_ready, timeout_ms) != WAIT_OBJECT_0) {
+			return false;
+		}
+	}
+
+	// read the frame only after seeing it published
+	MemoryBarrier();
+	const Frame& f = _frames[_head % FRAMES];
+	dots = f.dots;
+	found = f.found;
+
+	// hand the frame back to the thread
+	MemoryBarrier();
+	_head = _head + 1;
+
+	return true;
+}
+
+long Acquisition::lost() const
+{
+	return _lost;
+}
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include "AnalogPublisher.h"
+
+/** @brief the values of NIDAQmx.h, which the binaries do not need to build */
+#define DAQMX_VAL_VOLTS 10348
+#define DAQMX_VAL_GROUP_BY_CHANNEL 0
+#define TIMEOUT 0.01
+
+typedef int (__stdcall *CreateTaskFn)(const char*, TaskHandle*);
+typedef int (__stdcall *CreateAOVoltageChanFn)(TaskHandle, const char*, const char*, double, double, int, const char*);
+typedef int (__stdcall *TaskFn)(TaskHandle);
+typedef int (__stdcall *WriteAnalogF64Fn)(TaskHandle, int, unsigned long, double, unsigned long, const double*, int*, unsigned long*);
+typedef int (__stdcall *GetExtendedErrorInfoFn)(char*, unsigned long);
+
+/** @brief the functions of nicaiu.dll, all NULL if it or one of them is not there */
+static struct {
+	CreateTaskFn createTask;
+	CreateAOVoltageChanFn createAOVoltageChan;
+	TaskFn startTask;
+	TaskFn stopTask;
+	TaskFn clearTask;
+	WriteAnalogF64Fn writeAnalogF64;
+	GetExtendedErrorInfoFn getExtendedErrorInfo;
+} daqmx;
+
+static bool load_daqmx()
+{
+	if(daqmx.createTask) {
+		return true;
+	}
+
+	HMODULE h = LoadLibraryA("nicaiu.dll");
+	if(!h) {
+		return false;
+	}
+	daqmx.createAOVoltageChan = (CreateAOVoltageChanFn)GetProcAddress(h, "DAQmxCreateAOVoltageChan");
+	daqmx.startTask = (TaskFn)GetProcAddress(h, "DAQmxStartTask");
+	daqmx.stopTask = (TaskFn)GetProcAddress(h, "DAQmxStopTask");
+	daqmx.clearTask = (TaskFn)GetProcAddress(h, "DAQmxClearTask");
+	daqmx.writeAnalogF64 = (WriteAnalogF64Fn)GetProcAddress(h, "DAQmxWriteAnalogF64");
+	daqmx.getExtendedErrorInfo = (GetExtendedErrorInfoFn)GetProcAddress(h, "DAQmxGetExtendedErrorInfo");
+	if(!daqmx.createAOVoltageChan || !daqmx.startTask || !daqmx.stopTask || !daqmx.clearTask ||
+		!daqmx.writeAnalogF64 || !daqmx.getExtendedErrorInfo) {
+		return false;
+	}
+	// last, it tells the others are there
+	daqmx.createTask = (CreateTaskFn)GetProcAddress(h, "DAQmxCreateTask");
+	return daqmx.createTask != NULL;
+}
+
+AnalogPublisher::Config AnalogPublisher::defaults()
+{
+	Config cfg;
+
+	cfg.channels = "Dev4/ao0:3";
+	cfg.markers = 2;
+	cfg.mm_per_volt = 300/9.0;
+	cfg.zero_mm = 0.;
+	cfg.range = 5.;
+	cfg.lost_volts = -10.;
+
+	return cfg;
+}
+
+AnalogPublisher::AnalogPublisher() :
+	_task(0), _writes(0), _failures(0), _lastUs(0.), _maxUs(0.)
+{
+	LARGE_INTEGER f;
+	QueryPerformanceFrequency(&f);
+	_ticksPerUs = f.QuadPart/1.0e6;
+
+	memset(&_cfg, 0, sizeof(_cfg));
+	memset(_volts, 0, sizeof(_volts));
+	_err[0] = '\0';
+}
+
+AnalogPublisher::~AnalogPublisher()
+{
+	close();
+}
+
+/** @brief keeps the error information of a failed call, returns true on success */
+bool AnalogPublisher::check(int rc, const char* what)
+{
+	if(rc >= 0) {
+		return true;
+	}
+
+	daqmx.getExtendedErrorInfo(_err, sizeof(_err));
+	printf("AnalogPublisher %s: %s\n", what, _err);
+	return false;
+}
+
+bool AnalogPublisher::open(const Config& cfg)
+{
+	close();
+	_cfg = cfg;
+
+	if(!load_daqmx()) {
+		strcpy_s(_err, sizeof(_err), "NI-DAQmx, nicaiu.dll, is not there");
+		printf("AnalogPublisher: %s\n", _err);
+		return false;
+	}
+	if(cfg.markers < 1 || 2*cfg.markers > MAX_CHANNELS) {
+		sprintf_s(_err, sizeof(_err), "1 to %d markers, not %d", MAX_CHANNELS/2, cfg.markers);
+		printf("AnalogPublisher: %s\n", _err);
+		return false;
+	}
+
+	// no sample clock: every write goes out on its own, right away
+	double limit = cfg.range > -cfg.lost_volts ? cfg.range : -cfg.lost_volts;
+	if(!check(daqmx.createTask("", &_task), "create task") ||
+		!check(daqmx.createAOVoltageChan(_task, cfg.channels, "", -limit, limit, DAQMX_VAL_VOLTS, NULL), "create channels") ||
+		!check(daqmx.startTask(_task), "start")) {
+		close();
+		return false;
+	}
+
+	// nothing found yet
+	for(int i = 0; i < 2*cfg.markers; i++) {
+		_volts[i] = cfg.lost_volts;
+	}
+	return write();
+}
+
+void AnalogPublisher::close()
+{
+	if(!_task) {
+		return;
+	}
+	// the controller must not take the last position for a live one
+	for(int i = 0; i < 2*_cfg.markers; i++) {
+		_volts[i] = _cfg.lost_volts;
+	}
+	write();
+	daqmx.stopTask(_task);
+	daqmx.clearTask(_task);
+	_task = 0;
+}
+
+bool AnalogPublisher::publish(int count, const double* x, const double* y, const int* assign)
+{
+	if(!_task) {
+		return false;
+	}
+
+	for(int i = 0; i < _cfg.markers; i++) {
+		if(i >= count || assign[i] < 0) {
+			_volts[2*i] = _volts[2*i + 1] = _cfg.lost_volts;
+			continue;
+		}
+		for(int k = 0; k < 2; k++) {
+			double v = ((k ? y[i] : x[i]) - _cfg.zero_mm) / _cfg.mm_per_volt;
+			_volts[2*i + k] = v > _cfg.range ? _cfg.range : (v < -_cfg.range ? -_cfg.range : v);
+		}
+	}
+	return write();
+}
+
+/** @brief _volts to the outputs, one sample of every channel, timed */
+bool AnalogPublisher::write()
+{
+	LARGE_INTEGER t0, t1;
+	int written = 0;
+
+	QueryPerformanceCounter(&t0);
+	bool ok = check(daqmx.writeAnalogF64(_task, 1, 0, TIMEOUT, DAQMX_VAL_GROUP_BY_CHANNEL, _volts, &written, NULL), "write");
+	QueryPerformanceCounter(&t1);
+
+	_lastUs = (t1.QuadPart - t0.QuadPart)/_ticksPerUs;
+	if(_lastUs > _maxUs) {
+		_maxUs = _lastUs;
+	}
+	if(ok) {
+		_writes++;
+	}
+	else {
+		_failures++;
+	}
+	return ok;
+}
+
+const char* AnalogPublisher::error() const
+{
+	return _err;
+}
@@ -1,13 +1,45 @@
+// keeps the min and max macros of windows.h off std::min and std::max
+#define NOMINMAX
+#include <windows.h>
+#include <fstream>
 #include "Camera.h"
 #include "Dots.h"
 
+/** @brief "TDCB", the first bytes of a binary calibration */
+#define BLOB_MAGIC 0x42434454
+/** @brief the version of the binary calibration written by Camera::save */
+#define BLOB_VERSION 1
+
 using cv::Mat;
 using cv::Mat_;
 using cv::Size;
+using cv::Vec2f;
+using cv::Point;
 using cv::Point2d;
 using cv::Point3d;
 using cv::VideoCapture;
 
+/**
+* @brief the header of a binary calibration
+*
+* The header is followed by map_height rows of map_width normalized points,
+* two floats each, the undistortion map of Camera::undistortMap.  All values
+* are stored as the machine that wrote them lays them out in memory.
+*/
+
+struct Blob {
+	unsigned int magic; /**< BLOB_MAGIC */
+	unsigned int version; /**< BLOB_VERSION */
+	unsigned int header; /**< sizeof(Blob) of the writer */
+	int map_width; /**< 0, if there is no map */
+	int map_height; /**< 0, if there is no map */
+	int reserved;
+	double A[Camera::A_ROWS * Camera::A_COLS];
+	double k[Camera::K_ROWS * Camera::K_COLS];
+	double R[Camera::R_ROWS * Camera::R_COLS];
+	double t[Camera::T_ROWS * Camera::T_COLS];
+};
+
 /**
 * The constructor initializes the camera's intrinsic and
 * extrinsic parameters so that the world and image frame
@@ -39,6 +71,7 @@ void Camera::noWorldFrame()
 
 	_R = Mat_<double>::eye(R_ROWS, R_COLS);
 	_t = Mat_<double>::zeros(T_ROWS, T_COLS);
+	cache();
 }
 
 /**
@@ -51,6 +84,7 @@ void Camera::setA(const Mat& A)
 {
 	if(!A.empty() && A.rows == A_ROWS && A.cols == A_COLS) {
 		A.convertTo(_A, TYPE);
+		cache();
 	}
 }
 
@@ -64,6 +98,7 @@ void Camera::setK(const Mat& k)
 {
 	if(!k.empty() && k.rows == K_ROWS && k.cols == K_COLS) {
 		k.convertTo(_k, TYPE);
+		cache();
 	}
 }
 
@@ -77,6 +112,7 @@ void Camera::setR(const Mat& R)
 {
 	if(!R.empty() && R.rows == R_ROWS && R.cols == R_COLS) {
 		R.convertTo(_R, TYPE);
+		cache();
 	}
 }
 
@@ -90,7 +126,232 @@ void Camera::setT(const Mat& t)
 {
 	if(!t.empty() && t.rows == T_ROWS && t.cols == T_COLS) {
 		t.convertTo(_t, TYPE);
+		cache();
+	}
+}
+
+/**
+* Copies the camera parameters into plain arrays, so pixelToWorld does not
+* have to touch a Mat, and refills the undistortion map if there is one.
+*/
+
+void Camera::cache()
+{
+	int i;
+
+	_f[0] = _A(0, 0);
+	_f[1] = _A(1, 1);
+	_f[2] = _A(0, 2);
+	_f[3] = _A(1, 2);
+
+	// k1, k2, p1, p2, k3 in the order cvUndistortPoints reads them
+	for(i = 0; i < K_COLS; ++i) {
+		_d[i] = _k(0, i);
+	}
+
+	// the world point on the z = 0 plane, solved for the normalized point (x, y)
+	_w[0][0] = _R(1,1) * _t(0,0) - _R(0,1) * _t(1,0);
+	_w[0][1] = _R(2,1) * _t(1,0) - _R(1,1) * _t(2,0);
+	_w[0][2] = _R(0,1) * _t(2,0) - _R(2,1) * _t(0,0);
+
+	_w[1][0] = _R(1,0) * _t(0,0) - _R(0,0) * _t(1,0);
+	_w[1][1] = _R(2,0) * _t(1,0) - _R(1,0) * _t(2,0);
+	_w[1][2] = _R(0,0) * _t(2,0) - _R(2,0) * _t(0,0);
+
+	_w[2][0] = _R(0,0) * _R(1,1) - _R(0,1) * _R(1,0);
+	_w[2][1] = _R(1,0) * _R(2,1) - _R(1,1) * _R(2,0);
+	_w[2][2] = _R(0,1) * _R(2,0) - _R(0,0) * _R(2,1);
+
+	if(!_map.empty()) {
+		fillMap(_map.size());
+	}
+
+	// the next undistort(...) builds the tables again, not shared with copies
+	_undist_xy.release();
+	_undist_a.release();
+}
+
+/**
+* Converts a distorted pixel to the normalized camera frame the same way
+* cvUndistortPoints does, with five fixed-point iterations.
+*
+* @param[in] pixel the pixel location
+* @return the undistorted, normalized location
+*/
+
+Point2d Camera::normalize(const Point2d& pixel) const
+{
+	int i;
+	double x, y, x0, y0, r2, icdist, dx, dy;
+
+	x = x0 = (pixel.x - _f[2]) / _f[0];
+	y = y0 = (pixel.y - _f[3]) / _f[1];
+
+	for(i = 0; i < 5; ++i) {
+		r2 = x*x + y*y;
+		icdist = 1 / (1 + ((_d[4]*r2 + _d[1])*r2 + _d[0])*r2);
+		dx = 2*_d[2]*x*y + _d[3]*(r2 + 2*x*x);
+		dy = _d[2]*(r2 + 2*y*y) + 2*_d[3]*x*y;
+		x = (x0 - dx)*icdist;
+		y = (y0 - dy)*icdist;
+	}
+
+	return Point2d(x, y);
+}
+
+/**
+* Precomputes the normalized location of every pixel of a size sensor, so
+* pixelToWorld only interpolates between the four pixels around a point
+* instead of undistorting it.  Points outside of the map are undistorted as
+* before.  The map is refilled whenever the camera matrix or distortion
+* vector change.
+*
+* @param[in] size the sensor size, an empty size frees the map
+*/
+
+void Camera::undistortMap(const Size& size)
+{
+	if(size.width <= 0 || size.height <= 0) {
+		_map.release();
+		return;
+	}
+
+	fillMap(size);
+}
+
+void Camera::fillMap(const Size& size)
+{
+	int x, y;
+	Point2d n;
+
+	// other Cameras copied from this one keep the old map
+	_map = Mat_<Vec2f>(size.height, size.width);
+	for(y = 0; y < size.height; ++y) {
+		for(x = 0; x < size.width; ++x) {
+			n = normalize(Point2d(x, y));
+			_map(y, x) = Vec2f(static_cast<float> (n.x), static_cast<float> (n.y));
+		}
+	}
+}
+
+/**
+* Writes the camera matrix, distortion vector, rotation matrix, translation
+* vector and, if there is one, the undistortion map to file, see load(...).
+*
+* @param[in] file the name of the binary calibration
+* @return false, if the file could not be written
+*/
+
+bool Camera::save(const std::string& file) const
+{
+	int i, y;
+	Blob b;
+
+	memset(&b, 0, sizeof(b));
+	b.magic = BLOB_MAGIC;
+	b.version = BLOB_VERSION;
+	b.header = sizeof(Blob);
+	b.map_width = _map.cols;
+	b.map_height = _map.rows;
+
+	for(i = 0; i < A_ROWS * A_COLS; ++i) {
+		b.A[i] = _A(i / A_COLS, i % A_COLS);
+	}
+	for(i = 0; i < K_ROWS * K_COLS; ++i) {
+		b.k[i] = _k(i / K_COLS, i % K_COLS);
+	}
+	for(i = 0; i < R_ROWS * R_COLS; ++i) {
+		b.R[i] = _R(i / R_COLS, i % R_COLS);
+	}
+	for(i = 0; i < T_ROWS * T_COLS; ++i) {
+		b.t[i] = _t(i / T_COLS, i % T_COLS);
+	}
+
+	std::ofstream out(file.c_str(), std::ios::out | std::ios::binary);
+	out.write(reinterpret_cast<const char*> (&b), sizeof(b));
+	for(y = 0; y < _map.rows; ++y) {
+		out.write(reinterpret_cast<const char*> (_map[y]), _map.cols * sizeof(Vec2f));
+	}
+
+	return out.good();
+}
+
+/**
+* Sets the parameters of the camera from a binary calibration written by
+* save(...).  Reading it needs no parsing and, if the calibration has an
+* undistortion map, does not fill the map again, which takes most of the
+* time of setting up a camera.  The file is memory mapped, so cameras
+* loading the same calibration read it from the system's file cache.
+*
+* @param[in] file the name of the binary calibration
+* @return false, and the camera is unchanged, if the file could not be read
+* or is not a binary calibration of this version
+*/
+
+bool Camera::load(const std::string& file)
+{
+	HANDLE f, m;
+	LARGE_INTEGER size;
+	const char* data;
+	bool ok;
+
+	f = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(f == INVALID_HANDLE_VALUE) {
+		return false;
 	}
+
+	// an empty file cannot be mapped
+	ok = false;
+	m = CreateFileMapping(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m != NULL) {
+		data = static_cast<const char*> (MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0));
+		if(data != NULL) {
+			ok = GetFileSizeEx(f, &size) && fromBlob(data, size.QuadPart);
+			UnmapViewOfFile(data);
+		}
+		CloseHandle(m);
+	}
+	CloseHandle(f);
+
+	return ok;
+}
+
+bool Camera::fromBlob(const char* data, int64 size)
+{
+	int64 map_bytes;
+	Blob b;
+
+	if(size < static_cast<int64> (sizeof(Blob))) {
+		return false;
+	}
+
+	// the mapped bytes may not be aligned for doubles
+	memcpy(&b, data, sizeof(b));
+	if(b.magic != BLOB_MAGIC || b.version != BLOB_VERSION || b.header != sizeof(Blob)
+		|| b.map_width < 0 || b.map_height < 0) {
+		return false;
+	}
+
+	map_bytes = static_cast<int64> (b.map_width) * b.map_height * sizeof(Vec2f);
+	if(size < static_cast<int64> (sizeof(Blob)) + map_bytes) {
+		return false;
+	}
+
+	// cache() must not fill the map the file already has
+	_map.release();
+	Mat(A_ROWS, A_COLS, TYPE, b.A).copyTo(_A);
+	Mat(K_ROWS, K_COLS, TYPE, b.k).copyTo(_k);
+	Mat(R_ROWS, R_COLS, TYPE, b.R).copyTo(_R);
+	Mat(T_ROWS, T_COLS, TYPE, b.t).copyTo(_t);
+	cache();
+
+	if(map_bytes > 0) {
+		_map = Mat_<Vec2f>(b.map_height, b.map_width);
+		memcpy(_map.data, data + sizeof(Blob), static_cast<size_t> (map_bytes));
+	}
+
+	return true;
 }
 
 /** 
@@ -104,34 +365,83 @@ void Camera::setT(const Mat& t)
 
 Point3d Camera::pixelToWorld(const Point2d& pixel) const
 {
-	double im[2] = {pixel.x, pixel.y};
-	double wl[3];
-	double z;
+	Point3d world;
 
-	// setup intrinsic and extrinsic parameters
-	CvMat img_frm = cvMat(1, 1, CV_64FC2, im);
-	Mat world_frm = Mat(T_ROWS, T_COLS, TYPE, wl);
-
-	// convert from distorted pixels to normalized camera frame
-	// cv:: version does not allow doubles for some odd reason,
-	// so use the C version
-	CvMat A = _A;
-	CvMat k = _k;
-	cvUndistortPoints(&img_frm, &img_frm, &A, &k);
-	
-		// convert from camera frame to world frame
-	/*z = _t(2, 0) ? _t(2, 0) : 1; // Wrong z != t3. z = r31 X + r32 Y + t3
-	wl[0] = z*im[0] - _t(0, 0);
-	wl[1] = z*im[1] - _t(1, 0);
-	wl[2] = 0;
-	world_frm = _R.t() * world_frm;
-    */
-
-	wl[0] = (_R(1,1) * _t(0,0)-_R(0,1) * _t(1,0)+_R(2,1) * _t(1,0) * im[0]- _R(1,1)* _t(2,0) * im[0]-_R(2,1)* _t(0,0)* im[1]+_R(0,1) * _t(2,0) * im[1])/(_R(0,1) * _R(1,0)-_R(0,0)* _R(1,1)+_R(1,1)* _R(2,0) *im[0]-_R(1,0) *_R(2,1) *im[0]-_R(0,1) *_R(2,0) * im[1]+_R(0,0) *_R(2,1) *im[1]);
-	wl[1] = (-_R(0,0) * _t(1,0)+_R(2,0)* _t(1,0)*im[0]+_R(1,0) *(_t(0,0)-_t(2,0)*im[0])-_R(2,0) * _t(0,0)*im[1]+_R(0,0) * _t(2,0) * im[1])/(-_R(0,1) * _R(1,0)+_R(0,0) * _R(1,1)-_R(1,1)*_R(2,0) *im[0]+_R(1,0) * _R(2,1) * im[0]+_R(0,1) * _R(2,0) * im[1]-_R(0,0) * _R(2,1) *im[1]);
-	wl[2] = 0;
-
-	return Point3d(wl[0], wl[1], wl[2]);
+	pixelToWorld(&pixel, &world, 1);
+	return world;
+}
+
+/** 
+* Converts n points from the pixel to the world coordinate frame, see
+* pixelToWorld(const cv::Point2d&).
+*
+* @param[in] pixels the pixel locations
+* @param[out] worlds the world locations, may not be pixels
+* @param[in] n the number of points
+*/
+
+void Camera::pixelToWorld(const Point2d* pixels, Point3d* worlds, size_t n) const
+{
+	size_t i;
+	int x0, y0;
+	double x, y, fx, fy, den;
+	Point2d im;
+
+	for(i = 0; i < n; ++i) {
+		x0 = cvFloor(pixels[i].x);
+		y0 = cvFloor(pixels[i].y);
+
+		// convert from distorted pixels to normalized camera frame
+		if(x0 >= 0 && y0 >= 0 && x0 + 1 < _map.cols && y0 + 1 < _map.rows) {
+			const Vec2f& a = _map(y0, x0);
+			const Vec2f& b = _map(y0, x0 + 1);
+			const Vec2f& c = _map(y0 + 1, x0);
+			const Vec2f& d = _map(y0 + 1, x0 + 1);
+
+			fx = pixels[i].x - x0;
+			fy = pixels[i].y - y0;
+			im.x = (1 - fy) * ((1 - fx) * a[0] + fx * b[0]) + fy * ((1 - fx) * c[0] + fx * d[0]);
+			im.y = (1 - fy) * ((1 - fx) * a[1] + fx * b[1]) + fy * ((1 - fx) * c[1] + fx * d[1]);
+		}
+		else {
+			im = normalize(pixels[i]);
+		}
+
+		// convert from camera frame to world frame
+		x = im.x;
+		y = im.y;
+		den = _w[2][0] + _w[2][1] * x + _w[2][2] * y;
+		worlds[i] = Point3d(-(_w[0][0] + _w[0][1] * x + _w[0][2] * y) / den,
+			(_w[1][0] + _w[1][1] * x + _w[1][2] * y) / den, 0);
+	}
+}
+
+/**
+* Returns the ray in the world frame of every point that is imaged on the
+* pixel, origin + s * dir for s > 0.  The ray meets the z = 0 plane at
+* pixelToWorld(pixel), but rays of several cameras also locate dots off it,
+* see CameraGroup.
+*
+* @param[in] pixel the pixel location
+* @param[out] origin the center of the camera in the world frame
+* @param[out] dir the unit direction of the ray in the world frame
+*/
+
+void Camera::ray(const Point2d& pixel, Point3d& origin, Point3d& dir) const
+{
+	double n;
+	Point2d im = normalize(pixel);
+
+	// the world frame is R^T (camera - t)
+	origin = Point3d(-(_R(0,0) * _t(0,0) + _R(1,0) * _t(1,0) + _R(2,0) * _t(2,0)),
+		-(_R(0,1) * _t(0,0) + _R(1,1) * _t(1,0) + _R(2,1) * _t(2,0)),
+		-(_R(0,2) * _t(0,0) + _R(1,2) * _t(1,0) + _R(2,2) * _t(2,0)));
+	dir = Point3d(_R(0,0) * im.x + _R(1,0) * im.y + _R(2,0),
+		_R(0,1) * im.x + _R(1,1) * im.y + _R(2,1),
+		_R(0,2) * im.x + _R(1,2) * im.y + _R(2,2));
+
+	n = sqrt(dir.dot(dir));
+	dir = Point3d(dir.x / n, dir.y / n, dir.z / n);
 }
 
 /** 
@@ -286,6 +596,26 @@ bool Camera::retrieve(Mat& img, int channel)
 	return _vc->retrieve(img, channel);
 }
 
+/**
+* Returns a view of the image the last retrieve(...) gave.  The buffer of
+* a camera that images ROIs only holds the ROI, so its place on the sensor
+* is asked for with TDAH_PROP_IMAGE_X and TDAH_PROP_IMAGE_Y; an image that is
+* a region of a larger Mat is placed with locateROI.
+*
+* @param[in] img the image of the last retrieve(...)
+* @return the view, only valid as long as img is
+*/
+
+ImageView Camera::view(const Mat& img)
+{
+	if(_vc->get(TDAH_PROP_IS_ROI)) {
+		return ImageView(img, Point(static_cast<int> (_vc->get(TDAH_PROP_IMAGE_X)),
+			static_cast<int> (_vc->get(TDAH_PROP_IMAGE_Y))));
+	}
+
+	return ImageView(img);
+}
+
 /**
 * Undistorts the image
 */
@@ -294,6 +624,47 @@ void Camera::undistort(Mat& img)
 	Mat tmp;
 	(*_vc) >> tmp;
 	if(!tmp.empty()) {
-		cv::undistort(tmp, img, _A, _k);
+		undistort(tmp, img);
 	}
+}
+
+/**
+* Undistorts a whole sensor image with remap tables instead of
+* cv::undistort, which works the distortion of every pixel out again on
+* every call.  The tables are built the first time an image of a size
+* comes along and again when the camera matrix or distortion vector
+* change, in fixed point, so an image takes one pass that looks up two
+* shorts and a weight per pixel.
+*
+* With a roi only that rectangle of the undistorted image is made, e.g.,
+* the part of the image that is shown, and dst is the size of roi.
+*
+* @param[in] src the image, as large as the sensor
+* @param[out] dst the undistorted image, or its roi; must not be src
+* @param[in] roi the rectangle of the undistorted image, empty for all of it
+*/
+void Camera::undistort(const Mat& src, Mat& dst, const cv::Rect& roi)
+{
+	cv::Rect all(0, 0, src.cols, src.rows), r = roi & all;
+
+	if(src.empty()) {
+		dst.release();
+		return;
+	}
+	if(r.width <= 0 || r.height <= 0) {
+		r = all;
+	}
+
+	undistortTables(src.size());
+	cv::remap(src, dst, _undist_xy(r), _undist_a(r), cv::INTER_LINEAR);
+}
+
+void Camera::undistortTables(const Size& size)
+{
+	if(_undist_xy.rows == size.height && _undist_xy.cols == size.width) {
+		return;
+	}
+
+	// no rectification, the undistorted image keeps the camera matrix
+	cv::initUndistortRectifyMap(_A, _k, Mat(), _A, size, CV_16SC2, _undist_xy, _undist_a);
 }
\ No newline at end of file
@@ -0,0 +1,364 @@
+/**
+* @file CameraGroup.cpp
+*/
+
+// keeps the min and max macros of windows.h off std::min and std::max
+#define NOMINMAX
+#include <windows.h>
+#include "Dots.h"
+#include "Camera.h"
+#include "Tracker.h"
+#include "CameraGroup.h"
+
+/** @brief the frames a camera can publish before grab() reads them */
+#define FRAMES 8
+
+using cv::Point2d;
+using cv::Point3d;
+
+CameraGroup::CameraGroup()
+	: _tol(0), _quit(false), _running(false)
+{
+
+}
+
+CameraGroup::~CameraGroup()
+{
+	stop();
+}
+
+/**
+* Adds a camera to the group.  The camera tracks dots with tracker on its
+* own thread, so the tracker and its TrackingAlg must not be shared with
+* another camera.  tracked, if not NULL, is called on that thread after
+* every frame was tracked, e.g., to add the dots back to the ROI queue of a
+* VideoCaptureMe3.  Cameras can only be added while the group is stopped.
+*
+* @param[in] cam the camera, grabbed with Camera::grab(int, Dots&)
+* @param[in] tracker the tracker of the camera
+* @param[in] dots the dots of the camera
+* @param[in] tracked called after every tracked frame, may be NULL
+* @param[in] ctx passed to tracked
+*/
+
+void CameraGroup::add(Camera& cam, Tracker& tracker, Dots& dots, Tracked tracked, void* ctx)
+{
+	Member m;
+
+	if(_running) {
+		return;
+	}
+
+	m.group = this;
+	m.cam = &cam;
+	m.tracker = &tracker;
+	m.dots = &dots;
+	m.tracked = tracked;
+	m.ctx = ctx;
+	m.thread = NULL;
+	m.ready = NULL;
+	m.head = m.tail = m.lost = 0;
+	_members.push_back(m);
+}
+
+/**
+* Sets how far apart the time stamps of the frames of one update may be, in
+* the unit of the cameras' time stamps (microseconds for VideoCaptureMe3).
+* Hardware triggered cameras take their frames at the same time, so the
+* tolerance only has to cover the jitter of the time stamps.
+*
+* @param[in] tol the largest difference between two time stamps
+*/
+
+void CameraGroup::tolerance(double tol)
+{
+	_tol = tol;
+}
+
+int CameraGroup::size() const
+{
+	return static_cast<int> (_members.size());
+}
+
+/**
+* Starts the thread of every camera.  The frames of every camera are
+* allocated here, so tracking allocates nothing.
+*
+* @return false, if a thread could not be started
+*/
+
+bool CameraGroup::start()
+{
+	size_t i;
+	Frame f;
+
+	if(_running) {
+		return true;
+	}
+
+	_quit = false;
+	for(i = 0; i < _members.size(); ++i) {
+		Member& m = _members[i];
+
+		f.time_stamp = 0;
+		f.image_nbr = 0;
+		f.pixel.assign(m.dots->size(), Point2d(0, 0));
+		f.found.assign(m.dots->size(), 0);
+		m.frames.assign(FRAMES, f);
+		m.head = m.tail = m.lost = 0;
+		m.ready = CreateEvent(NULL, FALSE, FALSE, NULL);
+	}
+
+	// the threads point into _members, so it must not grow while running
+	_running = true;
+	for(i = 0; i < _members.size(); ++i) {
+		_members[i].thread = CreateThread(NULL, 0, main, &_members[i], 0, NULL);
+		if(_members[i].thread == NULL) {
+			stop();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CameraGroup::stop()
+{
+	size_t i;
+
+	if(!_running) {
+		return;
+	}
+
+	_quit = true;
+	for(i = 0; i < _members.size(); ++i) {
+		if(_members[i].thread != NULL) {
+			WaitForSingleObject(_members[i].thread, INFINITE);
+			CloseHandle(_members[i].thread);
+			_members[i].thread = NULL;
+		}
+		CloseHandle(_members[i].ready);
+		_members[i].ready = NULL;
+	}
+
+	_running = false;
+}
+
+/** @brief grabs, tracks and publishes frames of one camera until stop() */
+unsigned long __stdcall CameraGroup::main(void* param)
+{
+	Member* m = static_cast<Member*> (param);
+	int img_nbr = 0;
+
+	while(!m->group->_quit) {
+		if(!m->cam->grab(img_nbr + 1, *m->dots)) {
+			continue;
+		}
+
+		ActiveDots& a = m->dots->activeDots();
+		if(!a.empty()) {
+			img_nbr = a[0]->imageNbr();
+		}
+
+		m->tracker->track(*m->cam, *m->dots);
+		if(m->tracked != NULL) {
+			m->tracked(m->ctx, *m->cam, *m->dots);
+		}
+
+		m->group->publish(*m);
+	}
+
+	return 0;
+}
+
+/**
+* Copies the found dots of the camera's last frame into the next frame of its
+* ring.  A frame without active dots has no time stamp and is not published,
+* nor is a frame while the ring is full.
+*/
+
+void CameraGroup::publish(Member& m)
+{
+	int tag;
+	size_t i;
+	ActiveDots& a = m.dots->activeDots();
+
+	if(a.empty()) {
+		return;
+	}
+	if(m.tail - m.head >= FRAMES) {
+		InterlockedIncrement(&m.lost);
+		return;
+	}
+
+	Frame& f = m.frames[m.tail % FRAMES];
+	f.time_stamp = a[0]->timeStamp();
+	f.image_nbr = a[0]->imageNbr();
+	std::fill(f.found.begin(), f.found.end(), 0);
+	for(i = 0; i < a.size(); ++i) {
+		tag = a[i]->tag();
+		if(static_cast<size_t> (tag) < f.found.size()) {
+			f.found[tag] = a[i]->isFound();
+			f.pixel[tag] = a[i]->pixel();
+		}
+	}
+
+	// the frame must be complete before grab() can see it
+	MemoryBarrier();
+	m.tail = m.tail + 1;
+	SetEvent(m.ready);
+}
+
+bool CameraGroup::wait(Member& m, int timeout_ms)
+{
+	while(m.tail == m.head) {
+		if(WaitForSingleObject(m.ready, timeout_ms) != WAIT_OBJECT_0) {
+			return false;
+		}
+	}
+
+	// read the frame only after seeing it published
+	MemoryBarrier();
+	return true;
+}
+
+/**
+* Waits for a frame of every camera whose time stamps are at most
+* tolerance(...) apart and fuses them into dots.  Frames that are older
+* than the frames of the other cameras by more than the tolerance cannot
+* match any more and are dropped.  The dots found in at least two frames are
+* triangulated and found, the dots seen in a frame are active, and every
+* active dot gets the mean time stamp of the frames.
+*
+* @param[out] dots the fused dots
+* @param[in] timeout_ms how long to wait for a frame of a camera
+* @return false, if the group is stopped or a camera published no frame in time
+*/
+
+bool CameraGroup::grab(Dots& dots, int timeout_ms)
+{
+	size_t i, lo;
+	double t, tmin, tmax;
+
+	if(!_running || _members.empty()) {
+		return false;
+	}
+
+	while(1) {
+		lo = 0;
+		tmin = tmax = 0;
+		for(i = 0; i < _members.size(); ++i) {
+			if(!wait(_members[i], timeout_ms)) {
+				return false;
+			}
+
+			t = _members[i].frames[_members[i].head % FRAMES].time_stamp;
+			if(i == 0 || t < tmin) {
+				tmin = t;
+				lo = i;
+			}
+			if(i == 0 || t > tmax) {
+				tmax = t;
+			}
+		}
+
+		if(tmax - tmin <= _tol) {
+			break;
+		}
+
+		// the oldest frame only gets farther from the newer frames of the others
+		MemoryBarrier();
+		_members[lo].head = _members[lo].head + 1;
+	}
+
+	fuse(dots);
+
+	// hand the frames back to the threads of the cameras
+	MemoryBarrier();
+	for(i = 0; i < _members.size(); ++i) {
+		_members[i].head = _members[i].head + 1;
+	}
+
+	return true;
+}
+
+/**
+* Locates every dot at the point closest to the rays of all frames it was
+* found in, the least squares solution of
+* sum (I - d d^T) x = sum (I - d d^T) o over the rays o + s d.
+*/
+
+void CameraGroup::fuse(Dots& dots)
+{
+	int tag, views, first;
+	size_t i;
+	double a[3][3], b[3], p[3], det, ts;
+	Point3d o, d;
+
+	ts = 0;
+	for(i = 0; i < _members.size(); ++i) {
+		ts += _members[i].frames[_members[i].head % FRAMES].time_stamp;
+	}
+	ts /= _members.size();
+
+	dots.clearActiveDots();
+	for(tag = 0; tag < dots.size(); ++tag) {
+		memset(a, 0, sizeof(a));
+		memset(b, 0, sizeof(b));
+		views = 0;
+		first = -1;
+
+		for(i = 0; i < _members.size(); ++i) {
+			const Frame& f = _members[i].frames[_members[i].head % FRAMES];
+			if(static_cast<size_t> (tag) >= f.found.size() || !f.found[tag]) {
+				continue;
+			}
+
+			_members[i].cam->ray(f.pixel[tag], o, d);
+			double u[3] = {d.x, d.y, d.z}, q[3] = {o.x, o.y, o.z};
+			for(int r = 0; r < 3; ++r) {
+				for(int c = 0; c < 3; ++c) {
+					double m = (r == c) - u[r] * u[c];
+					a[r][c] += m;
+					b[r] += m * q[c];
+				}
+			}
+
+			if(first < 0) {
+				first = static_cast<int> (i);
+			}
+			++views;
+		}
+
+		if(views == 0) {
+			continue;
+		}
+
+		const Frame& f = _members[first].frames[_members[first].head % FRAMES];
+		dots.makeDotActive(tag);
+		dots.pixel(tag) = f.pixel[tag];
+		dots.imageNbr(tag) = f.image_nbr;
+		dots.timeStamp(tag) = ts;
+
+		// Cramer's rule, parallel rays do not meet
+		det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+			- a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+			+ a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+		dots.found(tag) = views >= 2 && fabs(det) > 1e-12;
+		if(!dots.found(tag)) {
+			continue;
+		}
+
+		for(i = 0; i < 3; ++i) {
+			double c[3][3];
+			memcpy(c, a, sizeof(c));
+			c[0][i] = b[0];
+			c[1][i] = b[1];
+			c[2][i] = b[2];
+			p[i] = (c[0][0] * (c[1][1] * c[2][2] - c[1][2] * c[2][1])
+				- c[0][1] * (c[1][0] * c[2][2] - c[1][2] * c[2][0])
+				+ c[0][2] * (c[1][0] * c[2][1] - c[1][1] * c[2][0])) / det;
+		}
+		dots.world(tag, Point3d(p[0], p[1], p[2]));
+	}
+}
@@ -1,9 +1,15 @@
 #include <limits>
 #include <iostream>
+#include <cstring>
+// keeps the min and max macros of windows.h off std::min and std::max
+#define NOMINMAX
+#include <windows.h>
 
 #include "Dots.h"
 #include "Cameras/VideoCaptureMe3.h"
 #include "TrackingAlgs/TrackDot.h"
+#include "TracePoint.h"
+#include "RtLog.h"
 
 #if defined(WIN32) && defined(_WIN32)
 	#define FC_APPLET "FastConfig.dll"
@@ -17,7 +23,64 @@
 #define NROI 2
 static int seq[NROI] = {VideoCaptureMe3::ROI1, VideoCaptureMe3::ROI0};
 
-using std::deque;
+/** @brief the number of FastConfig ROI slots */
+#define FC_SLOTS 8
+/** @brief the longest FastConfig sequence */
+#define FC_MAX_SEQUENCE 4096
+/** @brief the largest scheduling weight, so FC_SLOTS dots fit the sequence */
+#define MAX_WEIGHT (FC_MAX_SEQUENCE / FC_SLOTS)
+
+/**
+* @brief 1 allocates every buffer for a FC_MAX_WIDTH x FC_MAX_HEIGHT image, so
+* changing the ROI size never stops the acquisition, 0 allocates what is asked
+*/
+#if !defined(ME3_MAX_BUFFERS)
+	#define ME3_MAX_BUFFERS 1
+#endif
+
+/** @brief the boards a process can open */
+#define ME3_MAX_BOARDS 16
+
+/**
+* @brief the instances that have FastConfig open on every port of every board
+*
+* FastConfigInit(...) and FastConfigFree(...) are process wide per port, so
+* only the first instance that opens a port initializes it and only the last
+* one that releases it frees it.  The count is guarded by fc_lock.
+*/
+static int fc_users[VideoCaptureMe3::PORTS];
+/**
+* @brief held around the FastConfig calls of a port, whose state the library
+* shares between the boards, so instances on separate threads take turns
+*/
+static volatile long fc_lock[VideoCaptureMe3::PORTS];
+
+static void fcLock(int port)
+{
+	while(InterlockedCompareExchange(&fc_lock[port], 1, 0) != 0) {
+		SwitchToThread();
+	}
+}
+
+static void fcUnlock(int port)
+{
+	InterlockedExchange(&fc_lock[port], 0);
+}
+
+/** @brief the most ROIs that can wait to be written, must be a power of two */
+#define ROI_RING_LEN 1024
+
+/**
+* @brief 1 checks FG_IMAGE_TAG on every retrieve(), 0 only once per grabbed image
+*/
+#if !defined(ME3_STRICT_TAGS)
+	#if defined(_DEBUG)
+		#define ME3_STRICT_TAGS 1
+	#else
+		#define ME3_STRICT_TAGS 0
+	#endif
+#endif
+
 using std::string;
 
 using cv::Mat;
@@ -26,18 +89,24 @@ using cv::Point;
 using cv::Point2d;
 
 VideoCaptureMe3::VideoCaptureMe3()
+	: _q(ROI_RING_LEN), _removals(ROI_RING_LEN), _apc(false), _frames(ROI_RING_LEN)
 {
+	_frame_ready = CreateEvent(NULL, FALSE, FALSE, NULL);
 	fastConfigDefaults();
 }
 
 VideoCaptureMe3::VideoCaptureMe3(const std::string& filename)
+	: _q(ROI_RING_LEN), _removals(ROI_RING_LEN), _apc(false), _frames(ROI_RING_LEN)
 {
+	_frame_ready = CreateEvent(NULL, FALSE, FALSE, NULL);
 	fastConfigDefaults();
 	open(filename);
 }
 
 VideoCaptureMe3::VideoCaptureMe3(int device)
+	: _q(ROI_RING_LEN), _removals(ROI_RING_LEN), _apc(false), _frames(ROI_RING_LEN)
 {
+	_frame_ready = CreateEvent(NULL, FALSE, FALSE, NULL);
 	fastConfigDefaults();
 	open(device);
 }
@@ -50,14 +119,135 @@ VideoCaptureMe3::Roi<T>::Roi(int tag, int img_nbr, T &roi)
 	this->roi = roi;
 }
 
+VideoCaptureMe3::RoiRing::RoiRing(int len)
+{
+	Cell c;
+
+	CV_Assert(len > 0 && (len & (len - 1)) == 0);
+	c.seq = 0;
+	_cells.assign(len, c);
+	_mask = len - 1;
+	clear();
+}
+
+void VideoCaptureMe3::RoiRing::clear()
+{
+	for(size_t i = 0; i < _cells.size(); ++i) {
+		_cells[i].seq = static_cast<long> (i);
+	}
+	_head = 0;
+	_tail = 0;
+}
+
+unsigned long VideoCaptureMe3::RoiRing::tail() const
+{
+	return static_cast<unsigned long> (_tail);
+}
+
+/**
+* Claims the next free position with a compare-and-swap on the tail and
+* publishes the entry by advancing the sequence number of its cell.
+* Safe to call from any number of threads.
+*/
+
+bool VideoCaptureMe3::RoiRing::push(int tag, int img_nbr, const Rect& roi)
+{
+	unsigned long pos = static_cast<unsigned long> (_tail);
+	Cell* cell;
+	long dif;
+
+	while(1) {
+		cell = &_cells[pos & _mask];
+		dif = static_cast<long> (static_cast<unsigned long> (cell->seq) - pos);
+
+		if(dif == 0) {
+			// the cell is free, try to claim its position
+			if(InterlockedCompareExchange(&_tail, static_cast<long> (pos + 1),
+				static_cast<long> (pos)) == static_cast<long> (pos)) {
+				break;
+			}
+		}
+		else if(dif < 0) {
+			// the cell still holds the entry from one lap ago
+			return false;
+		}
+		pos = static_cast<unsigned long> (_tail);
+	}
+
+	cell->e.pos = pos;
+	cell->e.tag = tag;
+	cell->e.img_nbr = img_nbr;
+	cell->e.roi = roi;
+	MemoryBarrier();
+	cell->seq = static_cast<long> (pos + 1);
+
+	return true;
+}
+
+/**
+* Takes the oldest published entry and frees its cell for the push one lap
+* later.  Only one thread may pop.
+*/
+
+bool VideoCaptureMe3::RoiRing::pop(Entry& e)
+{
+	unsigned long pos = static_cast<unsigned long> (_head);
+	Cell* cell = &_cells[pos & _mask];
+
+	if(static_cast<unsigned long> (cell->seq) != pos + 1) {
+		return false;
+	}
+	MemoryBarrier();
+
+	e = cell->e;
+	MemoryBarrier();
+	cell->seq = static_cast<long> (pos + _mask + 1);
+	_head = static_cast<long> (pos + 1);
+
+	return true;
+}
+
 VideoCaptureMe3::~VideoCaptureMe3()
 {
 	release();
+	CloseHandle(_frame_ready);
 }
 
+/**
+* Returns the slot the current image was taken with.  The images follow the
+* sequence, except when the sequence is scheduled: then it may have changed
+* while acquiring, but every dot has its own slot and the image tag tells
+* which dot the image shows.
+*/
+
 int VideoCaptureMe3::slotIndex()
 {
-	return _img_nbr % NROI;
+	if(_scheduled) {
+		unsigned long int tag = _img_nbr;
+		int slot;
+
+		if(Fg_getParameter(_fg, FG_IMAGE_TAG, &tag, _port) == FG_OK) {
+			slot = slotOfTag(getRoiTag(tag));
+			if(slot >= 0) {
+				return slot;
+			}
+		}
+	}
+
+	// image 1 was taken with the first slot of the sequence
+	return _seq[(_img_nbr + _seq.size() - 1) % _seq.size()];
+}
+
+/** @brief the slot of the dot tag, -1 if it has none */
+int VideoCaptureMe3::slotOfTag(int tag) const
+{
+	for(size_t i = 0; i < _roi.size(); ++i) {
+		if(_roi[i].tag == tag) {
+			return static_cast<int> (i);
+		}
+	}
+
+	return -1;
 }
 
 int VideoCaptureMe3::bufferIndex()
@@ -67,14 +257,19 @@ int VideoCaptureMe3::bufferIndex()
 
 double VideoCaptureMe3::nextDot()
 {
-	static double next_dot = 0;
-
-	if(_img_nbr > 0 && next_dot < NROI) {
-		++next_dot;
+	if(_apc) {
+		// the buffers belong to the driver callback, use the published image
+		if(_frame.img_nbr > 0 && _next_dot < NROI) {
+			++_next_dot;
+			return _frame.tag;
+		}
+	}
+	else if(_img_nbr > 0 && _next_dot < NROI) {
+		++_next_dot;
 		return _roi_in_buffer[bufferIndex()].tag;
 	}
 
-	next_dot = 0;
+	_next_dot = 0;
 	return  BAD_TAG;
 }
 
@@ -111,23 +306,16 @@ int VideoCaptureMe3::getFgImgTag(int img_tag)
 	return img_tag & 0xffff;
 }
 
-void VideoCaptureMe3::makeSafeMat(Mat& mat)
-{
-	mat = Mat(mat.rows, mat.cols, mat.type(), mat.data);
-}
-
-void VideoCaptureMe3::makeUnsafeMat(Mat& mat, Point& offset)
-{
-	mat.step = FC_MAX_WIDTH;
-	mat.datastart = mat.data - FC_MAX_WIDTH * offset.y - offset.x;
-	mat.dataend = mat.datastart + FC_MAX_WIDTH * FC_MAX_HEIGHT;
-}
+/**
+* Prints the last error of the frame grabber after msg, which must be a literal:
+* grab() and retrieve() fail from the frame loop, so the message goes through
+* RtLog.h.  The descriptions are static strings of the Silicon Software SDK.
+*/
 
-void VideoCaptureMe3::me3Err(string msg)
+void VideoCaptureMe3::me3Err(const char* msg)
 {
-	std::cout << "me3::" << msg << ": (" << 
-		Fg_getLastErrorNumber(_fg) << ") " <<
-		Fg_getLastErrorDescription(_fg) << std::endl;
+	RTLOG_ERROR("me3::%s: (%d) %s\n", msg, Fg_getLastErrorNumber(_fg),
+		Fg_getLastErrorDescription(_fg));
 }
 
 void VideoCaptureMe3::fastConfigDefaults()
@@ -137,8 +325,13 @@ void VideoCaptureMe3::fastConfigDefaults()
 	_buffers = 16;
 	_trigger = GRABBER_CONTROLLED;
 	_tap = FG_CL_DUALTAP_8_BIT;
+	frame_timing_init(&_timing, _tap);
 	_mem = NULL;
+	_buffer_size = 0;
+	_acquiring = false;
 	_fg = NULL;
+	_board = 0;
+	_port = PORT_A;
 
 	// allocate data structures
 	FC_ParameterSet roi;
@@ -152,40 +345,112 @@ void VideoCaptureMe3::fastConfigDefaults()
 	roi.dLinlog1 = 0; // never used
 	roi.dLinlog2 = 0; // never used
 	_roi.assign(NROI, Roi<FC_ParameterSet>(0, 0, roi));
+	_dirty.assign(NROI, 0);
+	_ts = 0;
+	_ts_nbr = -1;
+	_digio = -1;
+	_min_width = -1;
+	_seq.assign(seq, seq + NROI);
+	_scheduled = false;
 
 	_roi_in_buffer.assign(_buffers, 
 		Roi<Rect>(BAD_TAG, 0, Rect(0, 0, 0, 0)));
+	_image = Mat();
+	_image_nbr = 0;
+	_image_in_sync = false;
+	_image_offset = Point();
 	_q.clear();
+	_removals.clear();
+	_removed.clear();
+	_has_front = false;
+	_next_dot = 0;
+
+	_frames.clear();
+	_frame.img_nbr = 0;
+	_frame.tag = BAD_TAG;
+	_wanted_img = 0;
+	_frames_lost = 0;
+	memset(&_monitor, 0, sizeof(_monitor));
+	_monitoring = false;
 }
 
+/**
+* Sets the number of buffers and the size of the ROIs.  If the number of
+* buffers stays the same and the new size fits the buffers, only the ROIs are
+* rewritten and the acquisition keeps running, the new size is used from the
+* next image the camera takes.  Otherwise the memory is reallocated, which
+* stops the acquisition, and the user must restart it with start(...).  With
+* ME3_MAX_BUFFERS every buffer holds the largest image, so only changing the
+* number of buffers reallocates.
+*
+* @param[in] n the number of buffers
+* @param[in] width the width of the ROIs, rounded down to a multiple of four
+* @param[in] height the height of the ROIs
+*/
+
 bool VideoCaptureMe3::buffers(int n, int width, int height)
 {
 	int memsize;
+	int size;
+
+	// width must be multiple of 4 (see Silicon Software FastConfig doc)
+	width &= MULT_OF_FOUR_MASK;
+	if(_mem && n == _buffers && width * height <= _buffer_size) {
+		return resize(width, height);
+	}
 
 	// free memory, note that image acquisition is stopped by Fg_FreeMem(...)
-	if(_mem && Fg_FreeMem(_fg, PORT_A) != FG_OK) {
+	if(_mem && (_apc ? Fg_FreeMemEx(_fg, (dma_mem*) _mem) : Fg_FreeMem(_fg, _port)) != FG_OK) {
 		me3Err("buffers");
 		return false;
 	}
 
-	// (re)allocate memory
-	memsize = n * width * height;
-	_mem = (uchar*) Fg_AllocMem(_fg, memsize, n, PORT_A);
+	_acquiring = false;
+
+	// (re)allocate memory, the APC mode needs the memory of the Ex functions
+	size = width * height;
+#if ME3_MAX_BUFFERS
+	size = std::max(size, FC_MAX_WIDTH * FC_MAX_HEIGHT);
+#endif
+	memsize = n * size;
+	if(_apc) {
+		_mem = Fg_AllocMemEx(_fg, memsize, n);
+	}
+	else {
+		_mem = (uchar*) Fg_AllocMem(_fg, memsize, n, _port);
+	}
 	if(_mem == NULL) {
+		_buffer_size = 0;
 		me3Err("buffers");
 		return false;
 	}
 
 	// set new parameters
 	_buffers = n;
+	_buffer_size = size;
 	_roi_in_buffer.assign(_buffers, 
 		Roi<Rect>(BAD_TAG, 0, Rect(0, 0, 0, 0)));
+	_image = Mat();
+	_image_nbr = 0;
+
+	return resize(width, height);
+}
+
+/**
+* Writes the new ROI size to every slot, moving ROIs that would no longer
+* fit the image frame back inside it.  The buffers must hold an image of
+* the new size.
+*/
 
+bool VideoCaptureMe3::resize(int width, int height)
+{
 	bool all_written = true;
+
 	for(size_t i = 0; i < _roi.size(); ++i) {
-		// width must be multiple of 4 (see Silicon Software FastConfig doc)
-		_roi[i].roi.RoiWidth = width & MULT_OF_FOUR_MASK;
+		_roi[i].roi.RoiWidth = width;
 		_roi[i].roi.RoiHeight = height;
+		_roi[i].roi.RoiPosX = std::min(_roi[i].roi.RoiPosX, FC_MAX_WIDTH - width);
+		_roi[i].roi.RoiPosY = std::min(_roi[i].roi.RoiPosY, FC_MAX_HEIGHT - height);
 
 		if(!writeRoi(i)) {
 			// memory was successfully allocated, but an ROI
@@ -206,19 +471,145 @@ bool VideoCaptureMe3::buffers(int n, int width, int height)
 * GRAB_INFINITE, will grab images until the image acquisition is
 * stopped.  Functions that stop the acquisition are stop(...), 
 * release(...), setRois(...), and buffers(...).
+*
+* In the APC mode (see set(TDAH_PROP_ASYNC, ...)) the driver calls apc(...)
+* for every new image.  It publishes the image for grab() and writes the next
+* queued ROI to the camera right away.
 */
 
 bool VideoCaptureMe3::start(int n)
 {
+	int rc;
+
+	// buffers(...) and setRois(...) may have kept the acquisition running
+	if(_acquiring) {
+		return true;
+	}
+
 	// start acquiring
-	if(Fg_Acquire(_fg, PORT_A, n) != FG_OK) {
+	if(_apc) {
+		rc = Fg_AcquireAPCEx(_fg, _port, n, ACQ_STANDARD, (dma_mem*) _mem, apc, this);
+	}
+	else {
+		rc = Fg_Acquire(_fg, _port, n);
+	}
+
+	if(rc != FG_OK) {
 		me3Err("acquire");
 		return false;
 	}
 
+	// the image numbers start over
+	_ts_nbr = -1;
+	_acquiring = true;
+	return true;
+}
+
+/**
+* The driver callback of the APC mode, data is the VideoCaptureMe3.
+*/
+
+int VideoCaptureMe3::apc(int img_nbr, void* data)
+{
+	return static_cast<VideoCaptureMe3*> (data)->apcImage(img_nbr);
+}
+
+/**
+* Runs on the driver's thread for every image of the APC mode.  It does what
+* grab() does in the blocking mode: the image's ROI is recorded (and checked
+* against FG_IMAGE_TAG), the image is published in _frames and the next ROI
+* in the queue is written to the free slot.  The ROI buffer and slots belong
+* to this thread while acquiring.
+*/
+
+int VideoCaptureMe3::apcImage(int img_nbr)
+{
+	int buf;
+	unsigned long int tag = img_nbr;
+
+	TRACE_POINT(TRACE_GRAB_START);
+
+	_img_nbr = img_nbr;
+	updateRoiBuffer();
+	buf = bufferIndex();
+
+	// the image only belongs to the ROI in its buffer if the tags agree
+	if(Fg_getParameterEx(_fg, FG_IMAGE_TAG, &tag, _port, (dma_mem*) _mem, img_nbr) != FG_OK ||
+		getRoiTag(tag) != _roi_in_buffer[buf].tag) {
+		tag = BAD_TAG;
+	}
+	else {
+		tag = _roi_in_buffer[buf].tag;
+	}
+
+	if(_frames.push(static_cast<int> (tag), img_nbr, _roi_in_buffer[buf].roi)) {
+		SetEvent(_frame_ready);
+	}
+	else {
+		InterlockedIncrement(&_frames_lost);
+	}
+
+	updateRoiSlot();
+
+	TRACE_POINT(TRACE_GRAB_STOP);
+	return 0;
+}
+
+/**
+* Takes the oldest image apc(...) published that is at least _wanted_img,
+* waiting at most ms milliseconds for one.
+*/
+
+bool VideoCaptureMe3::takeFrame(unsigned long ms)
+{
+	while(1) {
+		while(_frames.pop(_frame)) {
+			if(_frame.img_nbr >= _wanted_img) {
+				_next_dot = 0;
+				return true;
+			}
+		}
+
+		if(ms == 0 || WaitForSingleObject(_frame_ready, ms) != WAIT_OBJECT_0) {
+			return false;
+		}
+	}
+}
+
+/**
+* Starts sampling the buffers every period_ms milliseconds on a thread of its
+* own, or stops it if period_ms is 0.  The backlog, the lost images and the
+* pressure are then read with get(...) without touching the driver, so they
+* can be checked after every grab() to decimate, add buffers or lower the frame
+* rate before images are lost.  The monitor is stopped by stop() and release().
+*/
+
+bool VideoCaptureMe3::monitor(int period_ms)
+{
+	if(_monitoring) {
+		fg_monitor_stop(&_monitor);
+		_monitoring = false;
+	}
+
+	if(period_ms <= 0) {
+		return true;
+	}
+
+	if(_fg == NULL || fg_monitor_start(&_monitor, _fg, _port, _apc ? (dma_mem*) _mem : NULL,
+		_buffers, period_ms, NULL, NULL) != 0) {
+		return false;
+	}
+
+	_monitoring = true;
 	return true;
 }
 
+/** @brief the number of the image the user grabbed */
+int VideoCaptureMe3::grabbedImage() const
+{
+	return _apc ? _frame.img_nbr : _img_nbr;
+}
+
 /**
 * Stops the image acquisition process, so no more new images 
 * are taken.
@@ -226,12 +617,14 @@ bool VideoCaptureMe3::start(int n)
 
 bool VideoCaptureMe3::stop()
 {
-	if(Fg_stopAcquireEx(_fg, PORT_A, _mem, STOP_SYNC) != FG_OK) {
-	//if(Fg_stopAcquire(_fg, PORT_A) != FG_OK) {
+	monitor(0);
+	if(Fg_stopAcquireEx(_fg, _port, _mem, STOP_SYNC) != FG_OK) {
+	//if(Fg_stopAcquire(_fg, _port) != FG_OK) {
 		me3Err("stop");
 		return false;
 	}
 
+	_acquiring = false;
 	_img_nbr = 1;
 	return true;
 }
@@ -245,10 +638,10 @@ bool VideoCaptureMe3::roiSequence()
 {
 	FastConfigSequence fcs;
 
-	// write the ROI sequence, which is hard-coded at the top of this file
-	fcs.mLengthOfSequence = NROI;
-	fcs.mRoiPagePointer = seq;
-	if(Fg_setParameter(_fg, FG_FASTCONFIG_SEQUENCE, &fcs, PORT_A) != FG_OK) {
+	// write the ROI sequence, hard-coded at the top of this file unless scheduled
+	fcs.mLengthOfSequence = static_cast<int> (_seq.size());
+	fcs.mRoiPagePointer = &_seq[0];
+	if(Fg_setParameter(_fg, FG_FASTCONFIG_SEQUENCE, &fcs, _port) != FG_OK) {
 		me3Err("roiSequence");
 		return false;
 	}
@@ -297,6 +690,10 @@ Rect VideoCaptureMe3::calcRoi(const Point2d& pixel) const
 * track more than eight (8) dots at a time, since the FastConfig interface
 * only has eight ROI slots that can be used.
 *
+* The queue is lock-free, so dots can be added from a tracking thread while
+* another thread grabs.  It holds ROI_RING_LEN dots, dots added to a full
+* queue are dropped.
+*
 * @param[in] dots the object containing the active dots to add to the end
 * of the queue.
 */
@@ -312,13 +709,19 @@ void VideoCaptureMe3::add(const Dots& dots)
 	for(dot = a.begin(); dot < a.end(); ++dot) {		
 		tag = (*dot)->tag();
 		pixel = (*dot)->pixel();
-		_q.push_back( Roi<Rect>( tag, _img_nbr, calcRoi( pixel ) ) );
+		if(!_q.push( tag, _img_nbr, calcRoi( pixel ) )) {
+			std::cout << "me3::add: ROI queue full, dropped dot " << tag << std::endl;
+		}
 	}
 }
 
 /**
 * Removes the dot associated with tag from the queue
 *
+* A lock-free queue cannot remove from its middle, so the request is queued
+* itself and the grabbing thread drops the oldest ROI of the dot that was
+* added before the call, or every ROI added before the call.
+*
 * @param[in] tag the tag value to remove, if this parameters has
 * the special value, VideoCaptureMe3::REMOVE_ALL, then all dots 
 * are removed from the queue.
@@ -326,15 +729,79 @@ void VideoCaptureMe3::add(const Dots& dots)
 
 void VideoCaptureMe3::remove(int tag)
 {
-	if(tag == REMOVE_ALL) {
-		_q.clear();
+	// the request applies to the ROIs pushed before the current tail
+	if(!_removals.push(tag, static_cast<int> (_q.tail()), Rect())) {
+		std::cout << "me3::remove: removal queue full, dot " << tag << " kept" << std::endl;
 	}
-	else {
-		std::deque< Roi<Rect> >::const_iterator it;
-		for(it = _q.begin(); it < _q.end() && (*it).tag != tag; ++it);
-		if(it != _q.end())
-			_q.erase(it);
+}
+
+/**
+* Tells whether a remove() request applies to the ROI e and forgets the
+* requests that cannot apply to any later ROI.  The ROIs come in the order
+* they were pushed, so a request for the ROIs before position p is done once
+* an ROI at or after p comes along.
+*/
+
+bool VideoCaptureMe3::isRemoved(const RoiRing::Entry& e)
+{
+	std::vector<RoiRing::Entry>::iterator r = _removed.begin();
+	unsigned long before;
+
+	while(r != _removed.end()) {
+		before = static_cast<unsigned long> (r->img_nbr);
+		if(static_cast<long> (e.pos - before) >= 0) {
+			r = _removed.erase(r);
+		}
+		else if(r->tag == REMOVE_ALL) {
+			return true;
+		}
+		else if(r->tag == e.tag) {
+			// a request removes a single ROI
+			_removed.erase(r);
+			return true;
+		}
+		else {
+			++r;
+		}
 	}
+
+	return false;
+}
+
+/**
+* Makes _front the oldest ROI in the queue that has not been removed.
+* Only the grabbing thread may call this.
+*
+* @return false, if the queue is empty
+*/
+
+bool VideoCaptureMe3::frontRoi()
+{
+	RoiRing::Entry r;
+
+	while(_removals.pop(r)) {
+		_removed.push_back(r);
+	}
+
+	while(1) {
+		if(!_has_front) {
+			if(!_q.pop(_front)) {
+				return false;
+			}
+			_has_front = true;
+		}
+
+		if(!isRemoved(_front)) {
+			return true;
+		}
+		_has_front = false;
+	}
+}
+
+/** @brief drops _front once it has been written to the camera */
+void VideoCaptureMe3::popRoi()
+{
+	_has_front = false;
 }
 
 /**
@@ -358,18 +825,47 @@ bool VideoCaptureMe3::writeRoi(int slot)
 	// write the ROI to the camera
 	tag = _roi[slot].tag;
 	roi = &_roi[slot].roi;
-	//if(writeParameterSet(_fg, roi, slot, tag, do_init, PORT_A)) { TODO RESTORE
-	if(writeParameterSet(_fg, roi, slot, tag, do_init, PORT_A)) {
+	//if(writeParameterSet(_fg, roi, slot, tag, do_init, _port)) { TODO RESTORE
+	fcLock(_port);
+	if(writeParameterSet(_fg, roi, slot, tag, do_init, _port)) {
+		fcUnlock(_port);
 		me3Err("writeRoi");
 		return false;
 	}
+	fcUnlock(_port);
 
 	// record when the ROI was written to the camera
 	_roi[slot].img_nbr = _img_nbr;
+	if(slot < static_cast<int> (_dirty.size())) {
+		_dirty[slot] = 0;
+	}
 
 	return true;
 }
 
+/**
+* Writes the ROIs set(...) changed to their slots.  While acquiring, set(...)
+* only changes the local copies and grab() calls this once before taking the
+* next image, so setting the exposure and the frame rate between two images
+* writes every slot once instead of once per property.  A slot that could not
+* be written stays dirty and is tried again by the next grab().
+*
+* @return false, if a slot could not be written
+*/
+
+bool VideoCaptureMe3::writeDirtyRois()
+{
+	bool rc = true;
+
+	for(size_t i = 0; i < _dirty.size() && i < _roi.size(); ++i) {
+		if(_dirty[i] && !writeRoi(static_cast<int> (i))) {
+			rc = false;
+		}
+	}
+
+	return rc;
+}
+
 bool VideoCaptureMe3::set2Rois(const Dots& dots, const cv::Size& roi, 
 							  double exposure, double frame_time)
 {
@@ -382,11 +878,12 @@ bool VideoCaptureMe3::set2Rois(const Dots& dots, const cv::Size& roi,
 }
 
 /**
-* Stops all image acquisition and sets the ROIs to match the pixel 
-* positions specified in the active dots, as well as the ROI window size, 
-* exposure time, and frame rate.  The dots will be written to the camera 
-* in the order that they appear in the active set.  The user must restart
-* the image acquisition by calling start(...) after this function returns.
+* Sets the ROIs to match the pixel positions specified in the active dots,
+* as well as the ROI window size, exposure time, and frame rate.  The dots 
+* will be written to the camera in the order that they appear in the active
+* set.  The acquisition keeps running unless the ROI size does not fit the
+* buffers (see buffers(...)), so calling start(...) after this function 
+* returns restarts it if necessary.
 *
 * @param[in] dots the (active) dots to write to the camera
 * @param[in] roi the size of the region-of-interest window
@@ -403,41 +900,188 @@ bool VideoCaptureMe3::set2Rois(const Dots& dots, const cv::Size& roi,
 bool VideoCaptureMe3::setRois(const Dots& dots, const cv::Size& roi, 
 							  double exposure, double frame_time)
 {
-	if(!stop() && Fg_getLastErrorNumber(_fg) != FG_TRANSFER_NOT_ACTIVE) {
-		me3Err("setRois");
-		return false;
+	// go back to the hard-coded sequence and two slots
+	if(_scheduled) {
+		_scheduled = false;
+		_seq.assign(seq, seq + NROI);
+		_roi.resize(NROI);
+		if(!roiSequence()) {
+			return false;
+		}
 	}
 
 	// set parameters
 	set(CV_CAP_PROP_EXPOSURE, exposure);
 	set(CV_CAP_PROP_FPS, 1e6 / frame_time);
-	buffers(_buffers, roi.width, roi.height);
+	if(!buffers(_buffers, roi.width, roi.height)) {
+		return false;
+	}
 
 	// add active dots to the end of the queue
 	add(dots);
 
-	if(!_q.empty()) {
-		// write at most the first NROIs elements to the camera
-		for(size_t i = 0; i < NROI; ++i) {
-			// get next ROI in sequence
-			int slot = seq[i];
+	// take at most the first NROIs elements from the queue
+	RoiRing::Entry first[NROI];
+	size_t n;
+	for(n = 0; n < NROI && frontRoi(); ++n) {
+		first[n] = _front;
+		popRoi();
+	}
 
-			// write element from queue and repeat sequence if _q.size() < NROI
-			_roi[slot].tag = _q[i % _q.size()].tag;
-			_roi[slot].roi.RoiPosX = _q[i % _q.size()].roi.x;
-			_roi[slot].roi.RoiPosY = _q[i % _q.size()].roi.y;
+	// write them to the camera and repeat sequence if there are less than NROI
+	for(size_t i = 0; n > 0 && i < NROI; ++i) {
+		// get next ROI in sequence
+		int slot = seq[i];
 
-			if(!writeRoi(slot)) {
-				me3Err("setRois");
-				return false;
+		_roi[slot].tag = first[i % n].tag;
+		_roi[slot].roi.RoiPosX = first[i % n].roi.x;
+		_roi[slot].roi.RoiPosY = first[i % n].roi.y;
+
+		if(!writeRoi(slot)) {
+			me3Err("setRois");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+* Sets how often the dot tag is imaged relative to the other scheduled
+* dots.  A dot with weight 3 gets three images for every image of a dot with
+* weight 1, so fast dots can be given more images.  Dots have weight 1 until
+* this is called.  If the dots are scheduled, the sequence is rebuilt and
+* takes effect without stopping the acquisition.
+*
+* @param[in] tag the dot
+* @param[in] weight the relative update rate, between 1 and MAX_WEIGHT
+*/
+
+void VideoCaptureMe3::priority(int tag, int weight)
+{
+	if(tag < 0) {
+		return;
+	}
+	if(static_cast<size_t> (tag) >= _weights.size()) {
+		_weights.resize(tag + 1, 1);
+	}
+	_weights[tag] = std::min(std::max(weight, 1), MAX_WEIGHT);
+
+	if(_scheduled) {
+		scheduleSlots(static_cast<int> (_roi.size()));
+		if(!roiSequence()) {
+			me3Err("priority");
+		}
+	}
+}
+
+int VideoCaptureMe3::weight(int tag) const
+{
+	if(tag < 0 || static_cast<size_t> (tag) >= _weights.size()) {
+		return 1;
+	}
+
+	return _weights[tag];
+}
+
+/** @brief builds _seq from the weights of the dots in the first n slots */
+void VideoCaptureMe3::scheduleSlots(int n)
+{
+	std::vector<int> slots, weights;
+
+	for(int i = 0; i < n; ++i) {
+		slots.push_back(i);
+		weights.push_back(weight(_roi[i].tag));
+	}
+
+	buildSequence(slots, weights, _seq);
+}
+
+/**
+* Builds a sequence in which every slot appears as often as its weight,
+* spread out as evenly as possible (smooth weighted round robin): every
+* step each slot earns its weight, the slot with the most earned is imaged
+* and pays back the total weight.  Weights 2 and 1 give 0, 1, 0 and weights
+* 1 and 1 alternate.
+*
+* @param[in] slots the slots to schedule
+* @param[in] weights the weight of every slot
+* @param[out] sequence the sequence, as long as the sum of the weights
+*/
+
+void VideoCaptureMe3::buildSequence(const std::vector<int>& slots,
+	const std::vector<int>& weights, std::vector<int>& sequence)
+{
+	size_t i, best;
+	int k, total = 0;
+	std::vector<int> earned(slots.size(), 0);
+
+	for(i = 0; i < weights.size(); ++i) {
+		total += weights[i];
+	}
+
+	sequence.clear();
+	for(k = 0; k < total; ++k) {
+		for(i = 0; i < slots.size(); ++i) {
+			earned[i] += weights[i];
+		}
+
+		best = 0;
+		for(i = 1; i < slots.size(); ++i) {
+			if(earned[i] > earned[best]) {
+				best = i;
 			}
 		}
 
-		// remove all elements added to the camera
-		for(size_t i = 0; !_q.empty() && i < NROI; ++i, _q.pop_front());
+		earned[best] -= total;
+		sequence.push_back(slots[best]);
 	}
+}
 
-	return true;
+/**
+* Gives each of the first eight (8) active dots its own ROI slot, writes
+* their ROIs and a sequence built from their weights (see priority(...))
+* to the camera.  Unlike setRois(...), the acquisition keeps running: the
+* ROI size, exposure and frame time stay as they are and the new sequence
+* takes effect on the camera's next turn through it, so new dots are imaged
+* right away.  Afterwards add(...) moves a dot's own slot, so the queue no
+* longer decides which dot is imaged next.  setRois(...) ends the schedule.
+*
+* @param[in] dots the (active) dots to schedule
+* @return false, if there is no active dot or a slot or the sequence could
+* not be written
+*/
+
+bool VideoCaptureMe3::schedule(const Dots& dots)
+{
+	ActiveDots& a = dots.activeDots();
+	int i, n = static_cast<int> (std::min(a.size(), static_cast<size_t> (FC_SLOTS)));
+	Rect r;
+
+	if(n == 0) {
+		return false;
+	}
+	if(a.size() > FC_SLOTS) {
+		std::cout << "me3::schedule: only the first " << FC_SLOTS << " dots are scheduled" << std::endl;
+	}
+
+	// new slots share the size and timing of the first one
+	_roi.resize(n, _roi[0]);
+	for(i = 0; i < n; ++i) {
+		r = calcRoi(a[i]->pixel());
+		_roi[i].tag = a[i]->tag();
+		_roi[i].roi.RoiPosX = r.x;
+		_roi[i].roi.RoiPosY = r.y;
+
+		if(!writeRoi(i)) {
+			me3Err("schedule");
+			return false;
+		}
+	}
+
+	scheduleSlots(n);
+	_scheduled = true;
+	return roiSequence();
 }
 
 void VideoCaptureMe3::updateRoiBuffer()
@@ -460,13 +1104,18 @@ void VideoCaptureMe3::updateRoiBuffer()
 bool VideoCaptureMe3::updateRoiSlot()
 {
 	// write new ROI to camera
-	if(!_q.empty() && _img_nbr > 0) {
-		int slot = slotIndex();
+	if(_img_nbr > 0 && frontRoi()) {
+		// a scheduled dot moves its own slot, unscheduled dots have none
+		int slot = _scheduled ? slotOfTag(_front.tag) : slotIndex();
+		if(slot < 0) {
+			popRoi();
+			return true;
+		}
 
 		// prepare to write the oldest roi in the queue to the camera
-		_roi[slot].tag = _q.front().tag;
-		_roi[slot].roi.RoiPosX = _q.front().roi.x;
-		_roi[slot].roi.RoiPosY = _q.front().roi.y;
+		_roi[slot].tag = _front.tag;
+		_roi[slot].roi.RoiPosX = _front.roi.x;
+		_roi[slot].roi.RoiPosY = _front.roi.y;
 
 		// write the roi to the camera
 		if(!writeRoi(slot)) {
@@ -475,7 +1124,7 @@ bool VideoCaptureMe3::updateRoiSlot()
 		}
 
 		// the ROI has been written, remove it from the queue
-		_q.pop_front();
+		popRoi();
 	}
 
 	return true;
@@ -504,7 +1153,7 @@ bool VideoCaptureMe3::isRoiInBuffer()
 
 	// get the tag stored with the image number
 	unsigned long int tag = _img_nbr; 
-	if(Fg_getParameter(_fg, FG_IMAGE_TAG, &tag, PORT_A) != FG_OK) {
+	if(Fg_getParameter(_fg, FG_IMAGE_TAG, &tag, _port) != FG_OK) {
 		me3Err("isRoiInBuffer");
 		return false;
 	}
@@ -518,35 +1167,81 @@ bool VideoCaptureMe3::isRoiInBuffer()
 	return _img_nbr == buf_img && buf_tag == fg_tag;
 }
 
+/**
+* Checks the tag of the current image once and sets up the header that
+* retrieve() hands out for it, so retrieving the same image again (say for
+* tracking and for display) neither asks the frame grabber nor builds a Mat.
+*/
+
+void VideoCaptureMe3::cacheImage()
+{
+	Rect& r = _roi_in_buffer[bufferIndex()].roi;
+	uchar* data = (uchar*) Fg_getImagePtr(_fg, _img_nbr, _port);
+
+	_image_nbr = _img_nbr;
+	_image_in_sync = isRoiInBuffer();
+	_image = Mat(r.height, r.width, CV_8UC1, data);
+
+	// the buffer only holds the ROI, TDAH_PROP_IMAGE_X and _Y say where it is
+	_image_offset = _image_in_sync ? r.tl() : Point();
+}
+
 /**
 * Initializes the Silicon Software frame grabber and FastConfig interface
 * using either the default parameters, if this is a new instance of the object,
 * or resuses previously set parameters for multiple calls to this function.  If
 * the camera has previously been opened, it is closed before reinitializing.
 *
-* @param[in] device the port to read from
+* Every instance keeps its own ROIs, sequence and buffers, so instances on
+* different boards run side by side, each on a thread of its own.  The
+* FastConfig library itself is shared by the boards: the first instance on a
+* port initializes it, the last one frees it, and the writes of the ROIs take
+* turns.
+*
+* @param[in] device board * PORTS + port, 0 is PORT_A of the first board
 *
-* @note The device parameter is ignored.  In order to use FastConfig, PORTA, 
-* must be used.  See the Silicon Software FastConfig documentation for more 
-* information.
+* @note The FastConfig applet answers on PORT_A, so usually every camera is
+* on a board of its own.  See the Silicon Software FastConfig documentation
+* for more information.
 *
 * @attention this function assumes all ROIs use the same width and height
 */
 
 bool VideoCaptureMe3::open(int device)
 {
+	bool fc;
+
 	if(_fg) {
 		// camera has been allocated before, free the resources
 		release();
 	}
+
+	if(device < 0) {
+		device = 0;
+	}
+	if(device >= ME3_MAX_BOARDS * PORTS) {
+		return false;
+	}
+	_board = device / PORTS;
+	_port = device % PORTS;
 	
 	// initialize the camera and FastConfig interface
-	_fg = Fg_Init(FC_APPLET, PORT_A);
+	_fg = Fg_Init(FC_APPLET, _board);
 	if(_fg == NULL)
 		goto _err;
 
-	if(FastConfigInit(PORT_A) != FG_OK)
+	fcLock(_port);
+	fc = fc_users[_port] > 0 || FastConfigInit(_port) == FG_OK;
+	if(fc) {
+		++fc_users[_port];
+	}
+	fcUnlock(_port);
+	if(!fc) {
+		// release() must not free what the other instances use
+		Fg_FreeGrabber(_fg);
+		_fg = NULL;
 		goto _err;
+	}
 
 	// set camera to current settings
 	if(!set(FG_CAMERA_LINK_CAMTYP, _tap))
@@ -607,15 +1302,23 @@ void VideoCaptureMe3::release()
 		return;
 	}
 
+	// the driver must not call apc(...) on a freed grabber
+	if(_apc) {
+		stop();
+	}
+	monitor(0);
+
 	// turn off external sync signal
-	if(Fg_setExsync(_fg, FG_OFF, PORT_A) != FG_OK) {
+	if(Fg_setExsync(_fg, FG_OFF, _port) != FG_OK) {
 		me3Err("release");
 	}
 
-	// release fastconfig communication channel
-	if(FastConfigFree(PORT_A) != FG_OK) {
+	// release fastconfig communication channel, if this was its last user
+	fcLock(_port);
+	if(--fc_users[_port] == 0 && FastConfigFree(_port) != FG_OK) {
 		me3Err("release");
 	}
+	fcUnlock(_port);
 
 	// stop acquiring and free memory
 	if(Fg_FreeGrabber(_fg) != FG_OK) {
@@ -635,26 +1338,45 @@ void VideoCaptureMe3::release()
 * value.  The user should call the corresponding get function to see which
 * image number was actually transferred.
 *
+* In the APC mode the driver callback has already written the ROI, so grab()
+* only waits for the next published image.
+*
 * @return true, if an image has been successfully transferred and a new ROI
 * has been written to the camera, if there are any ROIs pending to be written.
 * False, otherwise.
 * 
-* @see set, get
+* @see set, get, poll
 */
 
 bool VideoCaptureMe3::grab()
 {
+	bool rc;
+
+	TRACE_POINT(TRACE_GRAB_START);
+
+	// the ROIs set(...) changed since the last image, see writeDirtyRois()
+	writeDirtyRois();
+
 	// send software trigger, if necessary
 	if(_trigger == ASYNC_SOFTWARE_TRIGGER && 
-		!Fg_sendSoftwareTrigger(_fg, PORT_A)) {
+		!Fg_sendSoftwareTrigger(_fg, _port)) {
 		me3Err("grab");
+		TRACE_POINT(TRACE_GRAB_STOP);
 		return false;
 	}
 
+	if(_apc) {
+		rc = takeFrame(TIMEOUT * 1000);
+		fg_monitor_consumed(&_monitor, _frame.img_nbr);
+		TRACE_POINT(TRACE_GRAB_STOP);
+		return rc;
+	}
+
 	// grab the desired image and update what image number the camera is at
-	_img_nbr = Fg_getLastPicNumberBlocking(_fg, _img_nbr, PORT_A, TIMEOUT);
+	_img_nbr = Fg_getLastPicNumberBlocking(_fg, _img_nbr, _port, TIMEOUT);
 	if(_img_nbr < FG_OK) {
 		me3Err("grab");
+		TRACE_POINT(TRACE_GRAB_STOP);
 		return false;
 	}
 
@@ -666,45 +1388,106 @@ bool VideoCaptureMe3::grab()
 	// new image grabbed, so update ROI buffer 
 	// and write next ROI in queue to free slot
 	updateRoiBuffer();
-	return updateRoiSlot();
+	cacheImage();
+	rc = updateRoiSlot();
+	fg_monitor_consumed(&_monitor, _img_nbr);
+
+	TRACE_POINT(TRACE_GRAB_STOP);
+	return rc;
+}
+
+/**
+* Grabs the next image of the APC mode if the driver has already published
+* one, without waiting.
+*
+* @return true, if an image was grabbed
+*/
+
+bool VideoCaptureMe3::poll()
+{
+	return _apc && takeFrame(0);
 }
 
 bool VideoCaptureMe3::retrieve(Mat& image, int channel)
 {
+	if(_apc) {
+		if(_frame.img_nbr <= 0) {
+			image = Mat();
+			return false;
+		}
+
+		// the ROI was recorded with the image, the buffer may hold a newer one
+		Rect& r = _frame.roi;
+		uchar* data = (uchar*) Fg_getImagePtrEx(_fg, _frame.img_nbr, _port, (dma_mem*) _mem);
+		image = Mat(r.height, r.width, CV_8UC1, data);
+		if(_frame.tag == BAD_TAG) {
+			_image_offset = Point();
+			return false;
+		}
+
+		_image_offset = r.tl();
+		return true;
+	}
+
 	if(_img_nbr <= 0) {
 		image = Mat();
 		return false;
 	}
 
-	// get corresponding ROI and copy data
-	Rect& r = _roi_in_buffer[bufferIndex()].roi;
-	uchar* data = (uchar*) Fg_getImagePtr(_fg, _img_nbr, PORT_A);
-	image = Mat(r.height, r.width, CV_8UC1, data);
-
-	if(!isRoiInBuffer()) {
-		// ROI does not match up with image, but send back
-		// image just in case the user does not care
-		return false;
+	// grab() sets up the image, unless the image number was set since
+	if(_image_nbr != _img_nbr) {
+		cacheImage();
+	}
+#if ME3_STRICT_TAGS
+	else if(isRoiInBuffer() != _image_in_sync) {
+		me3Err("retrieve: image tag changed since grab");
+		cacheImage();
 	}
+#endif
 
-	// modify the matrix and set it up so locateROI works correctly
-	// warning: this matrix must only be accessed within the data field
-	// i.e., image.data
-	makeUnsafeMat(image, r.tl());
-	return true;
+	// if the ROI does not match up with the image, send back
+	// the image just in case the user does not care
+	image = _image;
+	return _image_in_sync;
 }
 
+/**
+* Sets a property.  The exposure and the frame rate only change the local
+* copies of the ROIs whose value differs, so setting the same value every
+* image costs nothing; while acquiring the changed ROIs are written by the
+* next grab(), otherwise right away.  FG_DIGIO_OUTPUT is remembered, so
+* get(...) answers it without the driver.
+*/
+
 bool VideoCaptureMe3::set(int prop, double value)
 {
 	int rc;
 	unsigned long int rc2;
+	double t;
 
 	switch(prop) {
 		case CV_CAP_PROP_POS_FRAMES:
 			// set the next desired image number
-			_img_nbr = static_cast<int> (value);
+			if(_apc) {
+				_wanted_img = static_cast<int> (value);
+			}
+			else {
+				_img_nbr = static_cast<int> (value);
+			}
+			return true;
+
+		case TDAH_PROP_ASYNC:
+			// the memory is allocated differently, so only switch when closed
+			if(_fg != NULL) {
+				return false;
+			}
+			_apc = value != 0;
 			return true;
 
+		case TDAH_PROP_MONITOR:
+			// the period of the buffer monitor in milliseconds, 0 to stop it
+			return monitor(static_cast<int> (value));
+
 		case CV_CAP_PROP_FRAME_WIDTH: // assumes all heights are the same
 			// update width and resize memory
 			return buffers(_buffers, static_cast<int> (value), 
@@ -721,50 +1504,53 @@ bool VideoCaptureMe3::set(int prop, double value)
 				_roi[0].roi.RoiWidth, _roi[0].roi.RoiHeight);
 
 		case CV_CAP_PROP_FPS:
-			// set the frame time
+			// set the frame time, or the shortest one a ROI can run at
+			_dirty.resize(_roi.size(), 0);
 			for(size_t i = 0; i < _roi.size(); ++i) {
-				_roi[i].roi.FrameTimeInMicroSec = 1e6 / value;
-			}
-
-			for(size_t i = 0; i < _roi.size(); ++i) {
-				if(!writeRoi(i))
-					return false;
+				t = frame_timing_clamp(&_timing,
+					_roi[i].roi.RoiWidth, _roi[i].roi.RoiHeight,
+					_roi[i].roi.ExposureInMicroSec, 1e6 / value);
+				if(t != _roi[i].roi.FrameTimeInMicroSec) {
+					_roi[i].roi.FrameTimeInMicroSec = t;
+					_dirty[i] = 1;
+				}
 			}
-			return true;
+			return _acquiring || writeDirtyRois();
 
 		case CV_CAP_PROP_EXPOSURE:
 			// set the exposure time
+			_dirty.resize(_roi.size(), 0);
 			for(size_t i = 0; i < _roi.size(); ++i) {
-				_roi[i].roi.ExposureInMicroSec = value;
-			}
-
-			for(size_t i = 0; i < _roi.size(); ++i) {
-				if(!writeRoi(i))
-					return false;
+				if(value != _roi[i].roi.ExposureInMicroSec) {
+					_roi[i].roi.ExposureInMicroSec = value;
+					_dirty[i] = 1;
+				}
 			}
-			return true;
+			return _acquiring || writeDirtyRois();
 
 		case FG_DIGIO_OUTPUT:
 			// set the Digital output bit, pin 4 on the TTL trigger board
 			// if bit 0 of rc2 = 1 then pin 4 is high, low otherwise
 			rc2 = static_cast<unsigned long int> (value);
-			if(Fg_setParameter(_fg, FG_DIGIO_OUTPUT, &rc2, PORT_A) != FG_OK) {
+			if(Fg_setParameter(_fg, FG_DIGIO_OUTPUT, &rc2, _port) != FG_OK) {
 				me3Err("set");
+				_digio = -1;
 				return false;
 			}
+			_digio = static_cast<double> (rc2);
 			return true;
 
 		case FG_TRIGGERMODE:
 			// set the trigger mode (see Silicon Software documentation)
 			_trigger = static_cast<int> (value);
-			if(Fg_setParameter(_fg, FG_TRIGGERMODE, &_trigger, PORT_A)) {
+			if(Fg_setParameter(_fg, FG_TRIGGERMODE, &_trigger, _port)) {
 				me3Err("set");
 				return false;
 			}
 
 			if(_trigger != FREE_RUN) {
 				// enable the exsync pin for non-free running modes
-				if(Fg_setExsync(_fg, FG_ON, PORT_A) != FG_OK) {
+				if(Fg_setExsync(_fg, FG_ON, _port) != FG_OK) {
 					me3Err("set");
 					return false;
 				}
@@ -774,7 +1560,7 @@ bool VideoCaptureMe3::set(int prop, double value)
 		case FG_TRIGGERINSRC:
 			// enable the TTL Trigger pin 12 for external triggering
 			rc = static_cast<int> (value);
-			if(Fg_setParameter(_fg, FG_TRIGGERINSRC, &rc, PORT_A) != FG_OK) {
+			if(Fg_setParameter(_fg, FG_TRIGGERINSRC, &rc, _port) != FG_OK) {
 				me3Err("set");
 				return false;
 			}
@@ -784,7 +1570,9 @@ bool VideoCaptureMe3::set(int prop, double value)
 		case FG_CAMERA_LINK_CAMTYP:
 			// set either dual or single tap data transfers
 			_tap = static_cast<int> (value);
-			if(Fg_setParameter(_fg, FG_CAMERA_LINK_CAMTYP, &_tap, PORT_A)) {
+			frame_timing_init(&_timing, _tap);
+			_min_width = -1;
+			if(Fg_setParameter(_fg, FG_CAMERA_LINK_CAMTYP, &_tap, _port)) {
 				me3Err("set");
 				return false;
 			}
@@ -811,22 +1599,56 @@ double VideoCaptureMe3::get(int prop)
 				_roi[0].roi.RoiWidth != FC_MAX_WIDTH);
 			break;
 
+		case TDAH_PROP_IMAGE_X:
+			rc = static_cast<double> (_image_offset.x);
+			break;
+
+		case TDAH_PROP_IMAGE_Y:
+			rc = static_cast<double> (_image_offset.y);
+			break;
+
 		case CV_CAP_PROP_POS_MSEC: // returns timestamp in microseconds
-			ts = _img_nbr;
-			if(Fg_getParameter(_fg, FG_TIMESTAMP_LONG, &ts, PORT_A) != FG_OK) {
+			// the driver is only asked once per image
+			if(grabbedImage() == _ts_nbr) {
+				rc = _ts;
+				break;
+			}
+			ts = grabbedImage();
+			if(Fg_getParameter(_fg, FG_TIMESTAMP_LONG, &ts, _port) != FG_OK) {
 				me3Err("get");
 				rc = 0;
 			}
 			else {
 				rc = static_cast<double> (ts);
+				_ts = rc;
+				_ts_nbr = grabbedImage();
 			}
 			break;
 
 		case CV_CAP_PROP_POS_FRAMES:
 			// get the current image number
-			rc = static_cast<double> (_img_nbr);
+			rc = static_cast<double> (grabbedImage());
 			break;
 
+		case TDAH_PROP_ASYNC:
+			rc = static_cast<double> (_apc);
+			break;
+
+		case TDAH_PROP_MONITOR:
+			rc = _monitoring ? static_cast<double> (_monitor.period_ms) : 0;
+			break;
+
+		case TDAH_PROP_BACKLOG:
+		case TDAH_PROP_LOST_IMAGES:
+		case TDAH_PROP_PRESSURE: {
+			// the last sample of the monitor, 0 if it was never started
+			FgMonitorSnapshot s;
+			fg_monitor_read(&_monitor, &s);
+			rc = (prop == TDAH_PROP_BACKLOG) ? s.backlog :
+				(prop == TDAH_PROP_LOST_IMAGES) ? s.lost : s.pressure;
+			break;
+		}
+
 		case CV_CAP_PROP_FRAME_WIDTH:
 			// get the current width (assumes all ROIs use the same width)
 			rc = static_cast<double> (_roi[0].roi.RoiWidth);
@@ -853,9 +1675,13 @@ double VideoCaptureMe3::get(int prop)
 			break;
 
 		case FG_DIGIO_OUTPUT:
-			// read the status of the output pins
+			// read the status of the output pins, unless set(...) wrote them
+			if(_digio >= 0) {
+				rc = _digio;
+				break;
+			}
 			ts = 0;
-			if(Fg_getParameter(_fg, FG_DIGIO_OUTPUT, &ts, PORT_A) != FG_OK) {
+			if(Fg_getParameter(_fg, FG_DIGIO_OUTPUT, &ts, _port) != FG_OK) {
 				me3Err("get");
 				return false;
 			}
@@ -878,29 +1704,29 @@ double VideoCaptureMe3::get(int prop)
 			break;
 
 		case TDAH_PROP_LAST_GRABBED_IMAGE:
-			rc = Fg_getStatus(_fg, NUMBER_OF_LAST_IMAGE, 0, PORT_A);
+			// only grab() fetches images in the blocking mode
+			if(!_apc && _acquiring) {
+				rc = static_cast<double> (_img_nbr);
+				break;
+			}
+			rc = Fg_getStatus(_fg, NUMBER_OF_LAST_IMAGE, 0, _port);
 			break;
 
 		case TDAP_PROP_LAST_TRANSFERRED_IMAGE:
-			rc = Fg_getStatus(_fg, NUMBER_OF_ACT_IMAGE, 0, PORT_A);
+			rc = Fg_getStatus(_fg, NUMBER_OF_ACT_IMAGE, 0, _port);
 			break;
 
 		case TDAH_PROP_MIN_FRAME_TIME: // assumes same ROI size/exposure
-			// timing signals on the oscilloscope showed each pixel being
-			// clocked out at 40 Mhz two at a time with a .2 ns delay after
-			// a line has been transferred
-			if(_roi[0].roi.RoiWidth < 528) {
-				// an extra line pulse appears for these widths, don't know why
-				rc = _roi[0].roi.ExposureInMicroSec 
-					+ (_roi[0].roi.RoiHeight+1)
-					* (.2+_roi[0].roi.RoiWidth/40/2)
-					+ .2;
-			}
-			else {
-				rc = _roi[0].roi.ExposureInMicroSec + 
-					_roi[0].roi.RoiHeight * (.2+_roi[0].roi.RoiWidth/40/2) 
-					+ .2;
+			// the exposure plus the transfer time, see FrameTiming.h
+			if(_min_width != _roi[0].roi.RoiWidth || _min_height != _roi[0].roi.RoiHeight ||
+				_min_exposure != _roi[0].roi.ExposureInMicroSec) {
+				_min_width = _roi[0].roi.RoiWidth;
+				_min_height = _roi[0].roi.RoiHeight;
+				_min_exposure = _roi[0].roi.ExposureInMicroSec;
+				_min_frame_time = frame_timing_min(&_timing, _min_width,
+					_min_height, _min_exposure);
 			}
+			rc = _min_frame_time;
 			break;
 	}
 
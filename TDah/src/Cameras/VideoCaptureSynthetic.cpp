@@ -0,0 +1,507 @@
+#include <algorithm>
+#include "Dots.h"
+#include "Cameras/VideoCaptureSynthetic.h"
+
+/** @brief the sensor of the default camera, the size of the microEnable III's */
+#define SYN_WIDTH 1024
+#define SYN_HEIGHT 1024
+/** @brief the dots of the default camera */
+#define SYN_DOTS 16
+#define SYN_BUFFERS 16
+/** @brief the gray levels of the background and of the dots */
+#define BACKGROUND 220
+#define FOREGROUND 30
+/** @brief the drawing of the dots is accurate to 1 / (1 << SHIFT) pixel */
+#define SHIFT 4
+#define MULT_OF_FOUR_MASK (-4)
+
+using std::string;
+using cv::Mat;
+using cv::Point;
+using cv::Point2d;
+using cv::Rect;
+using cv::Scalar;
+using cv::Size;
+
+VideoCaptureSynthetic::VideoCaptureSynthetic()
+	: _sensor(SYN_WIDTH, SYN_HEIGHT), _amplitude(20), _period(1), _sigma(8),
+	_frame_time(1000), _exposure(100), _paced(false), _last_tick(0),
+	_opened(false), _img_nbr(0), _wanted_img(0), _roi_size(_sensor), _next_dot(0)
+{
+	dots(SYN_DOTS, 4);
+}
+
+/**
+* Opens a camera with a sensor of size sensor and n dots of radius 4, the
+* other settings are the defaults of VideoCaptureSynthetic().
+*/
+
+VideoCaptureSynthetic::VideoCaptureSynthetic(const Size& sensor, int n)
+	: _sensor(sensor), _amplitude(20), _period(1), _sigma(8),
+	_frame_time(1000), _exposure(100), _paced(false), _last_tick(0),
+	_opened(false), _img_nbr(0), _wanted_img(0), _roi_size(_sensor), _next_dot(0)
+{
+	dots(n, 4);
+	open(0);
+}
+
+VideoCaptureSynthetic::~VideoCaptureSynthetic()
+{
+	release();
+}
+
+/** @brief there is nothing to play back, so a file cannot be opened */
+bool VideoCaptureSynthetic::open(const string& filename)
+{
+	return false;
+}
+
+/**
+* Allocates the buffers and renders the noise of the background.  Opening
+* an open camera starts it over at image 1 with an empty ROI queue.
+*
+* @param[in] device ignored
+*/
+
+bool VideoCaptureSynthetic::open(int device)
+{
+	_opened = false;
+	if(_sensor.width <= 0 || _sensor.height <= 0) {
+		return false;
+	}
+
+	fillBackground();
+	if(!buffers(_buffers.empty() ? SYN_BUFFERS : static_cast<int> (_buffers.size()),
+		_roi_size.width, _roi_size.height)) {
+		return false;
+	}
+
+	_img_nbr = 0;
+	_wanted_img = 0;
+	_next_dot = 0;
+	_q.clear();
+	_current.tag = BAD_TAG;
+	_current.roi = Rect(Point(0, 0), _roi_size);
+	_last_tick = cv::getTickCount();
+	_opened = true;
+	return true;
+}
+
+bool VideoCaptureSynthetic::isOpened() const
+{
+	return _opened;
+}
+
+void VideoCaptureSynthetic::release()
+{
+	_opened = false;
+	_buffers.clear();
+	_in_buffer.clear();
+	_background.release();
+	_q.clear();
+}
+
+/**
+* Allocates n buffers, each holding a whole sensor image, so the ROI size
+* can change without allocating again.  The buffers are only allocated again
+* when n changes.
+*
+* @param[in] n the number of buffers
+* @param[in] width the width of every ROI, a multiple of 4
+* @param[in] height the height of every ROI
+* @return false, if the ROI does not fit on the sensor
+*/
+
+bool VideoCaptureSynthetic::buffers(int n, int width, int height)
+{
+	if(n <= 0 || width <= 0 || height <= 0 ||
+		width > _sensor.width || height > _sensor.height) {
+		return false;
+	}
+
+	if(static_cast<int> (_buffers.size()) != n) {
+		_buffers.resize(n);
+		for(int i = 0; i < n; ++i) {
+			_buffers[i].create(_sensor, CV_8UC1);
+		}
+
+		Roi none;
+		none.tag = BAD_TAG;
+		_in_buffer.assign(n, none);
+	}
+
+	_roi_size = Size(width, height);
+	if(!isRoi()) {
+		_current.tag = BAD_TAG;
+		_current.roi = Rect(Point(0, 0), _sensor);
+	}
+	return true;
+}
+
+/**
+* Adds the ROI of every active dot to the end of the ROI queue, one is
+* imaged by every grab().
+*
+* @param[in] dots the object containing the active dots to add to the end
+* of the queue.
+*/
+
+void VideoCaptureSynthetic::add(const Dots& dots)
+{
+	Roi r;
+	ActiveDots::const_iterator dot;
+
+	ActiveDots& a = dots.activeDots();
+	for(dot = a.begin(); dot < a.end(); ++dot) {
+		r.tag = (*dot)->tag();
+		r.roi = calcRoi((*dot)->pixel());
+		_q.push_back(r);
+	}
+}
+
+/**
+* Removes the oldest ROI of the dot tag from the queue.
+*
+* @param[in] tag the tag value to remove, if this parameters has
+* the special value, VideoCaptureSynthetic::REMOVE_ALL, then all dots
+* are removed from the queue.
+*/
+
+void VideoCaptureSynthetic::remove(int tag)
+{
+	std::deque<Roi>::iterator r;
+
+	if(tag == REMOVE_ALL) {
+		_q.clear();
+		return;
+	}
+
+	for(r = _q.begin(); r != _q.end(); ++r) {
+		if(r->tag == tag) {
+			_q.erase(r);
+			return;
+		}
+	}
+}
+
+/**
+* Sets the ROI size, exposure time and frame time, and adds the ROIs of
+* the active dots to the queue, see VideoCaptureMe3::setRois(...).
+*
+* @param[in] dots the (active) dots to image
+* @param[in] roi the size of the region-of-interest window
+* @param[in] exposure the exposure time in microseconds
+* @param[in] frame_time the frame time in microseconds
+* @return false, if the ROI does not fit on the sensor
+*/
+
+bool VideoCaptureSynthetic::setRois(const Dots& dots, const Size& roi,
+									double exposure, double frame_time)
+{
+	set(CV_CAP_PROP_EXPOSURE, exposure);
+	set(CV_CAP_PROP_FPS, 1e6 / frame_time);
+	if(!buffers(static_cast<int> (_buffers.size()), roi.width, roi.height)) {
+		return false;
+	}
+
+	add(dots);
+	return true;
+}
+
+/**
+* Renders n dots of radius radius, the dot with tag i at the i-th cell of a
+* grid spread evenly over the sensor.
+*/
+
+void VideoCaptureSynthetic::dots(int n, double radius)
+{
+	int cols, rows;
+	double w, h;
+
+	_radius = radius;
+	_rest.clear();
+	if(n <= 0) {
+		return;
+	}
+
+	// about square cells
+	cols = cvCeil(sqrt(n * static_cast<double> (_sensor.width) / _sensor.height));
+	rows = (n + cols - 1) / cols;
+	w = static_cast<double> (_sensor.width) / cols;
+	h = static_cast<double> (_sensor.height) / rows;
+	for(int i = 0; i < n; ++i) {
+		_rest.push_back(Point2d((i % cols + 0.5) * w, (i / cols + 0.5) * h));
+	}
+}
+
+void VideoCaptureSynthetic::motion(double amplitude, double period)
+{
+	_amplitude = amplitude;
+	_period = period;
+}
+
+void VideoCaptureSynthetic::noise(double sigma)
+{
+	_sigma = sigma;
+	if(_opened) {
+		fillBackground();
+	}
+}
+
+void VideoCaptureSynthetic::realTime(bool paced)
+{
+	_paced = paced;
+	_last_tick = cv::getTickCount();
+}
+
+Point2d VideoCaptureSynthetic::truth(int tag) const
+{
+	return position(tag, _img_nbr);
+}
+
+/**
+* Renders the next image, or image CV_CAP_PROP_POS_FRAMES if it was set to
+* a later one, into the next buffer.  The image is of the oldest ROI of the
+* queue, or of the ROI of the last image if the queue is empty.
+*/
+
+bool VideoCaptureSynthetic::grab()
+{
+	if(!_opened) {
+		return false;
+	}
+
+	pace();
+	_img_nbr = std::max(_img_nbr + 1, _wanted_img);
+	_wanted_img = 0;
+	_next_dot = 0;
+
+	if(!isRoi()) {
+		_current.tag = BAD_TAG;
+		_current.roi = Rect(Point(0, 0), _sensor);
+	}
+	else if(!_q.empty()) {
+		_current = _q.front();
+		_q.pop_front();
+	}
+
+	int b = (_img_nbr - 1) % static_cast<int> (_buffers.size());
+	_in_buffer[b] = _current;
+	render(_current, _buffers[b]);
+	return true;
+}
+
+/**
+* Returns the last grabbed image as a header into its buffer.
+*
+* @return false, if nothing was grabbed yet or the image is of an ROI that
+* was not taken for a dot
+*/
+
+bool VideoCaptureSynthetic::retrieve(Mat& image, int channel)
+{
+	if(!_opened || _img_nbr <= 0) {
+		image = Mat();
+		return false;
+	}
+
+	int b = (_img_nbr - 1) % static_cast<int> (_buffers.size());
+	image = _buffers[b](_in_buffer[b].roi);
+	return !isRoi() || _in_buffer[b].tag != BAD_TAG;
+}
+
+bool VideoCaptureSynthetic::set(int prop, double value)
+{
+	switch(prop) {
+		case CV_CAP_PROP_POS_FRAMES:
+			// set the next desired image number
+			_wanted_img = static_cast<int> (value);
+			return true;
+
+		case CV_CAP_PROP_FRAME_WIDTH:
+			return buffers(static_cast<int> (_buffers.size()),
+				static_cast<int> (value), _roi_size.height);
+
+		case CV_CAP_PROP_FRAME_HEIGHT:
+			return buffers(static_cast<int> (_buffers.size()),
+				_roi_size.width, static_cast<int> (value));
+
+		case CV_CAP_PROP_FRAME_COUNT:
+			return buffers(static_cast<int> (value),
+				_roi_size.width, _roi_size.height);
+
+		case CV_CAP_PROP_FPS:
+			if(value <= 0) {
+				return false;
+			}
+			_frame_time = 1e6 / value;
+			return true;
+
+		case CV_CAP_PROP_EXPOSURE:
+			_exposure = value;
+			return true;
+	}
+
+	return false;
+}
+
+double VideoCaptureSynthetic::get(int prop)
+{
+	int b;
+
+	switch(prop) {
+		case TDAH_PROP_NEXT_DOT:
+			return nextDot();
+
+		case TDAH_PROP_IS_ROI:
+			return static_cast<double> (isRoi());
+
+		case TDAH_PROP_IMAGE_X:
+		case TDAH_PROP_IMAGE_Y:
+			if(!_opened || _img_nbr <= 0) {
+				return 0;
+			}
+			b = (_img_nbr - 1) % static_cast<int> (_buffers.size());
+			return static_cast<double> (prop == TDAH_PROP_IMAGE_X ?
+				_in_buffer[b].roi.x : _in_buffer[b].roi.y);
+
+		case CV_CAP_PROP_POS_MSEC: // returns timestamp in microseconds
+			return _img_nbr * _frame_time;
+
+		case CV_CAP_PROP_POS_FRAMES:
+		case TDAH_PROP_LAST_GRABBED_IMAGE:
+		case TDAP_PROP_LAST_TRANSFERRED_IMAGE:
+			// images are rendered when they are grabbed
+			return static_cast<double> (_img_nbr);
+
+		case TDAH_PROP_ASYNC:
+			return 0;
+
+		case CV_CAP_PROP_FRAME_WIDTH:
+			return static_cast<double> (_roi_size.width);
+
+		case CV_CAP_PROP_FRAME_HEIGHT:
+			return static_cast<double> (_roi_size.height);
+
+		case CV_CAP_PROP_FRAME_COUNT:
+			return static_cast<double> (_buffers.size());
+
+		case CV_CAP_PROP_FPS:
+			return 1e6 / _frame_time;
+
+		case CV_CAP_PROP_EXPOSURE:
+		case TDAH_PROP_MIN_FRAME_TIME:
+			// nothing has to be read out
+			return _exposure;
+	}
+
+	return 0;
+}
+
+bool VideoCaptureSynthetic::isRoi() const
+{
+	return _roi_size != _sensor;
+}
+
+/** @brief the ROI centered on pixel, placed as VideoCaptureMe3 places it */
+Rect VideoCaptureSynthetic::calcRoi(const Point2d& pixel) const
+{
+	int x = cv::saturate_cast<int> (pixel.x);
+	int y = cv::saturate_cast<int> (pixel.y);
+
+	x = std::min(std::max(0, x - _roi_size.width / 2), _sensor.width - _roi_size.width);
+	x &= MULT_OF_FOUR_MASK;
+	y = std::min(std::max(0, y - _roi_size.height / 2), _sensor.height - _roi_size.height);
+
+	return Rect(x, y, _roi_size.width, _roi_size.height);
+}
+
+/** @brief where the dot tag is in image img_nbr */
+Point2d VideoCaptureSynthetic::position(int tag, int img_nbr) const
+{
+	double a;
+
+	if(tag < 0 || static_cast<size_t> (tag) >= _rest.size()) {
+		return Point2d(-1, -1);
+	}
+	if(_period <= 0) {
+		return _rest[tag];
+	}
+
+	// the dots start evenly spaced around their circles
+	a = 2 * CV_PI * (img_nbr * _frame_time * 1e-6 / _period
+		+ static_cast<double> (tag) / _rest.size());
+	return Point2d(_rest[tag].x + _amplitude * cos(a), _rest[tag].y + _amplitude * sin(a));
+}
+
+double VideoCaptureSynthetic::nextDot()
+{
+	int b;
+
+	if(_img_nbr > 0 && isRoi() && _next_dot == 0) {
+		++_next_dot;
+		b = (_img_nbr - 1) % static_cast<int> (_buffers.size());
+		return _in_buffer[b].tag;
+	}
+
+	_next_dot = 0;
+	return BAD_TAG;
+}
+
+void VideoCaptureSynthetic::fillBackground()
+{
+	Mat n, bg;
+
+	_background.create(2 * _sensor.height, _sensor.width, CV_8UC1);
+	if(_sigma <= 0) {
+		_background.setTo(Scalar(BACKGROUND));
+		return;
+	}
+
+	n.create(_background.size(), CV_16SC1);
+	cv::randn(n, Scalar(BACKGROUND), Scalar(_sigma));
+	n.convertTo(_background, CV_8UC1);
+}
+
+/**
+* Copies the ROI r from the background, at a row that changes with every
+* image, and draws the dots that reach into it.
+*/
+
+void VideoCaptureSynthetic::render(const Roi& r, Mat& buffer)
+{
+	int row;
+	Point2d p;
+	Mat img = buffer(r.roi);
+
+	row = static_cast<int> ((_img_nbr * 7919LL) % _sensor.height);
+	_background(Rect(r.roi.x, r.roi.y + row, r.roi.width, r.roi.height)).copyTo(img);
+
+	for(int tag = 0; tag < static_cast<int> (_rest.size()); ++tag) {
+		p = position(tag, _img_nbr) - Point2d(r.roi.x, r.roi.y);
+		if(p.x + _radius < 0 || p.y + _radius < 0 ||
+			p.x - _radius >= r.roi.width || p.y - _radius >= r.roi.height) {
+			continue;
+		}
+
+		cv::circle(img, Point(cvRound(p.x * (1 << SHIFT)), cvRound(p.y * (1 << SHIFT))),
+			cvRound(_radius * (1 << SHIFT)), Scalar(FOREGROUND), -1, CV_AA, SHIFT);
+	}
+}
+
+/** @brief waits until a frame time passed since the last image, if paced */
+void VideoCaptureSynthetic::pace()
+{
+	int64 ticks, now;
+
+	if(!_paced) {
+		return;
+	}
+
+	ticks = static_cast<int64> (_frame_time * 1e-6 * cv::getTickFrequency());
+	do {
+		now = cv::getTickCount();
+	} while(now - _last_tick < ticks);
+
+	_last_tick = now;
+}
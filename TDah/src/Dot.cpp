@@ -3,6 +3,7 @@
 */
 
 #include "Dot.h"
+#include "Dots.h"
 
 #define INITIAL_VAL -1
 
@@ -11,25 +12,24 @@ using cv::Point3d;
 
 Dot::Dot()
 {
-	_found = false;
-	_active = false;
+	_owner = NULL;
 	_tag = BAD_TAG;
-	_image_nbr = INITIAL_VAL;
-	_time_stamp = INITIAL_VAL;
-	_area = INITIAL_VAL;
+}
 
-	_pixel_loc = Point2d(INITIAL_VAL, INITIAL_VAL);
-	_world_loc = Point3d(INITIAL_VAL, INITIAL_VAL, INITIAL_VAL);
+Dot::Dot(const Dots* owner, int tag)
+{
+	_owner = owner;
+	_tag = tag;
 }
 
 bool Dot::isFound() const
 {
-	return _found;
+	return _owner ? _owner->_found[_tag] : false;
 }
 
 bool Dot::isActive() const
 {
-	return _active;
+	return _owner ? _owner->_active[_tag] : false;
 }
 
 int Dot::tag() const
@@ -39,49 +39,133 @@ int Dot::tag() const
 
 int Dot::imageNbr() const
 {
-	return _image_nbr;
+	return _owner ? _owner->_image_nbr[_tag] : INITIAL_VAL;
 }
 
 double Dot::timeStamp() const
 {
-	return _time_stamp;
+	return _owner ? _owner->_time_stamp[_tag] : INITIAL_VAL;
 }
 
 double Dot::pixelX() const
 {
-	return _pixel_loc.x;
+	return pixel().x;
 }
 
 double Dot::pixelY() const
 {
-	return _pixel_loc.y;
+	return pixel().y;
 }
 
 double Dot::worldX() const
 {
-	return _world_loc.x;
+	return world().x;
 }
 double Dot::worldY() const
 {
-	return _world_loc.y;
+	return world().y;
 }
 
 double Dot::worldZ() const
 {
-	return _world_loc.z;
+	return world().z;
 }
 
 Point2d Dot::pixel() const
 {
-	return _pixel_loc;
+	return _owner ? _owner->_pixel[_tag] : Point2d(INITIAL_VAL, INITIAL_VAL);
 }
 
 Point3d Dot::world() const
 {
-	return _world_loc;
+	return _owner ? _owner->currentWorld(_tag) : Point3d(INITIAL_VAL, INITIAL_VAL, INITIAL_VAL);
 }
 
 double Dot::area() const
 {
-	return _area;
+	return _owner ? _owner->_area[_tag] : INITIAL_VAL;
+}
+
+int Dot::historySize() const
+{
+	return _owner ? _owner->_hist_len[_tag] : 0;
+}
+
+int Dot::historyIndex(int age) const
+{
+	if(age < 0 || age >= historySize()) {
+		return -1;
+	}
+
+	return _tag * Dots::HISTORY + (_owner->_hist_head[_tag] - age + Dots::HISTORY) % Dots::HISTORY;
+}
+
+/**
+* Returns where the dot was found age locations ago.  Only found locations
+* are kept, so the ages of a dot that was lost count past the images it was
+* lost in.  An age of historySize() or more returns the initial value.
+*/
+
+Point2d Dot::pixelAt(int age) const
+{
+	int i = historyIndex(age);
+	return i < 0 ? Point2d(INITIAL_VAL, INITIAL_VAL) : _owner->_hist_pixel[i];
+}
+
+Point3d Dot::worldAt(int age) const
+{
+	int i = historyIndex(age);
+	return i < 0 ? Point3d(INITIAL_VAL, INITIAL_VAL, INITIAL_VAL) : _owner->historyWorld(i);
+}
+
+double Dot::timeStampAt(int age) const
+{
+	int i = historyIndex(age);
+	return i < 0 ? INITIAL_VAL : _owner->_hist_time[i];
+}
+
+/**
+* Returns the velocities and acceleration Tracker::track() estimates from
+* the track of the dot, filtered with Dots::filter(...).  They are zero
+* until the dot has been found twice (three times for the acceleration).
+*/
+
+Point2d Dot::pixelVelocity() const
+{
+	return _owner ? _owner->_pixel_vel[_tag] : Point2d(0, 0);
+}
+
+Point3d Dot::velocity() const
+{
+	if(!_owner) {
+		return Point3d(0, 0, 0);
+	}
+	_owner->updateWorldVelocity(_tag);
+	return _owner->_world_vel[_tag];
+}
+
+Point3d Dot::acceleration() const
+{
+	if(!_owner) {
+		return Point3d(0, 0, 0);
+	}
+	_owner->updateWorldVelocity(_tag);
+	return _owner->_world_acc[_tag];
+}
+
+/**
+* Extrapolates the newest found pixel location with the pixel velocity, e.g.,
+* to place the region-of-interest of the next image of a fast dot.  A dot
+* that was never found is expected at its current pixel location.
+*
+* @param[in] time the time stamp of the image, in the unit of timeStamp()
+*/
+
+Point2d Dot::predictPixel(double time) const
+{
+	if(historySize() == 0) {
+		return pixel();
+	}
+
+	return pixelAt(0) + pixelVelocity() * (time - timeStampAt(0));
 }
\ No newline at end of file
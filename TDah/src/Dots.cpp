@@ -3,8 +3,11 @@
 */
 
 #include <algorithm>
+#include "Camera.h"
 #include "Dots.h"
 
+#define INITIAL_VAL -1
+
 using std::vector;
 using cv::Point2d;
 using cv::Point3d;
@@ -13,46 +16,137 @@ using cv::Point3d;
 * This constructor doesn't do anything, its just there for convenience
 */
 
-Dots::Dots() {}
+Dots::Dots()
+	: _alpha(1)
+{
+
+}
 
 /**
 * This constructor creates n dots
 */
 
-Dots::Dots(int n)
+Dots::Dots(int n, int capacity)
+	: _alpha(1)
 {
-	makeDots(n);
+	makeDots(n, capacity);
 }
 
 /** 
 * This function deletes all previous dots and creates n new inactive dots.  
 * It also tags each dot with a unique tag value in the range of 0 to n - 1, 
-* inclusive of both numbers.
+* inclusive of both numbers.  The dots n to capacity - 1 are allocated as
+* well but free, for acquireDot(...).
 *
 * @param[in] n the number of dots to create
+* @param[in] capacity the number of dots there is room for, n if it is less
 */
-void Dots::makeDots(int n)
+void Dots::makeDots(int n, int capacity)
 {
+	int used = n;
+
+	n = std::max(n, capacity);
+
 	// reserve space
-	_dots.assign(n, Dot());
+	_pixel.assign(n, Point2d(INITIAL_VAL, INITIAL_VAL));
+	_world.assign(n, Point3d(INITIAL_VAL, INITIAL_VAL, INITIAL_VAL));
+	_world_cam.assign(n, NULL);
+	_found.resize(n, false);
+	_area.assign(n, INITIAL_VAL);
+	_image_nbr.assign(n, INITIAL_VAL);
+	_time_stamp.assign(n, INITIAL_VAL);
+	_active.assign(n, false);
+	_active_pos.assign(n, INITIAL_VAL);
+	_active_dots.clear();
 	_active_dots.reserve(n);
+	_used.assign(n, true);
+	_free.clear();
+	_free.reserve(n);
+	for(int i = n - 1; i >= used; --i) {
+		_used[i] = false;
+		_free.push_back(i);
+	}
+
+	// the tracks are allocated once, record() only writes them
+	_hist_pixel.assign(n * HISTORY, Point2d(INITIAL_VAL, INITIAL_VAL));
+	_hist_world.assign(n * HISTORY, Point3d(INITIAL_VAL, INITIAL_VAL, INITIAL_VAL));
+	_hist_cam.assign(n * HISTORY, NULL);
+	_hist_time.assign(n * HISTORY, INITIAL_VAL);
+	_hist_len.assign(n, 0);
+	_hist_head.assign(n, 0);
+	_pixel_vel.assign(n, Point2d(0, 0));
+	_world_vel.assign(n, Point3d(0, 0, 0));
+	_world_acc.assign(n, Point3d(0, 0, 0));
+	_world_new.assign(n, 0);
+	_world_steps.assign(n, 0);
 
 	// tag each dot (we're a friend class)
-	for(int i = 0; i < n; ++i) _dots[i]._tag = i;
+	_dots.clear();
+	_dots.reserve(n);
+	for(int i = 0; i < n; ++i) _dots.push_back(Dot(this, i));
 
-	// erase active dots
-	clearActiveDots();
 }
 
-bool Dots::isDotActive(int tag) const
+Dots::Dots(const Dots& dots)
 {
-	for(size_t i = 0; i < _active_dots.size(); ++i) {
-		if(_active_dots[i]->tag() == tag) {
-			return true;
-		}
+	*this = dots;
+}
+
+/**
+* Copies the fields of every dot.  The views and the active set of this
+* refer to this, not to dots.
+*/
+
+Dots& Dots::operator=(const Dots& dots)
+{
+	size_t i;
+
+	if(this == &dots) {
+		return *this;
 	}
 
-	return false;
+	_pixel = dots._pixel;
+	_world = dots._world;
+	_world_cam = dots._world_cam;
+	_found.resize(dots._found.size());
+	_found = dots._found;
+	_area = dots._area;
+	_image_nbr = dots._image_nbr;
+	_time_stamp = dots._time_stamp;
+	_active = dots._active;
+	_active_pos = dots._active_pos;
+	_used = dots._used;
+	_free.reserve(dots._free.capacity());
+	_free = dots._free;
+	_hist_pixel = dots._hist_pixel;
+	_hist_world = dots._hist_world;
+	_hist_cam = dots._hist_cam;
+	_hist_time = dots._hist_time;
+	_hist_len = dots._hist_len;
+	_hist_head = dots._hist_head;
+	_pixel_vel = dots._pixel_vel;
+	_world_vel = dots._world_vel;
+	_world_acc = dots._world_acc;
+	_world_new = dots._world_new;
+	_world_steps = dots._world_steps;
+	_alpha = dots._alpha;
+
+	_dots.clear();
+	_dots.reserve(dots._dots.size());
+	for(i = 0; i < dots._dots.size(); ++i) _dots.push_back(Dot(this, static_cast<int> (i)));
+
+	_active_dots.clear();
+	_active_dots.reserve(dots._dots.size());
+	for(i = 0; i < dots._active_dots.size(); ++i) {
+		_active_dots.push_back(&_dots[dots._active_dots[i]->tag()]);
+	}
+
+	return *this;
+}
+
+bool Dots::isDotActive(int tag) const
+{
+	return tag >= 0 && static_cast<size_t> (tag) < _active.size() && _active[tag];
 }
 
 /**
@@ -60,22 +154,51 @@ bool Dots::isDotActive(int tag) const
 * of active dots.  If the tag does not exist, then an error is
 * thrown.  All valid tags are between 0 (inclusive) and the total
 * number of dots, n (exclusive), which was passed to the most 
-* recent call to makeDots().
+* recent call to makeDots().  A free tag, see releaseDot(...), is not
+* added.
 *
 * @param[in] tag a unique value that identifies a dot
 */
 
 void Dots::makeDotActive(int tag)
 {
-	if(_dots.at(tag).isActive()) {
-		// return if tag is already active
+	if(_dots.at(tag).isActive() || !_used[tag]) {
+		// return if tag is already active or free
 		return;
 	}
 
-	_dots[tag]._active = true;
+	_active[tag] = true;
+	_active_pos[tag] = static_cast<int> (_active_dots.size());
 	_active_dots.push_back(&_dots[tag]);
 }
 
+/**
+* Removes the dot associated with the tag from the active set, if it is
+* in it.  The last dot of the active set takes its place, so the order
+* of the other active dots may change.
+*
+* @param[in] tag a unique value that identifies a dot
+*/
+
+void Dots::makeDotInactive(int tag)
+{
+	int pos;
+	Dot* last;
+
+	if(!isDotActive(tag)) {
+		return;
+	}
+
+	pos = _active_pos[tag];
+	last = _active_dots.back();
+	_active_dots[pos] = last;
+	_active_pos[last->tag()] = pos;
+	_active_dots.pop_back();
+
+	_active[tag] = false;
+	_active_pos[tag] = INITIAL_VAL;
+}
+
 /**
 * This function makes all n dots (as defined by the most recent call
 * to makeDots()) active.  It can also be used to indirectly obtain information 
@@ -89,16 +212,80 @@ void Dots::makeAllDotsActive()
 	}
 }
 
+/**
+* Starts a dot for a marker that came into view: takes the tag released
+* last, or the lowest one that was never used, sets the dot's fields and
+* track to the initial values, places it at pixel and adds it to the active
+* set, so the next track() looks for it there.  The free list was allocated
+* by makeDots(...), so nothing is allocated.
+*
+* @param[in] pixel where the marker is in the image frame
+* @return the tag of the dot, or BAD_TAG if every dot is used
+*/
+
+int Dots::acquireDot(const Point2d& pixel)
+{
+	int tag;
+
+	if(_free.empty()) {
+		return BAD_TAG;
+	}
+
+	tag = _free.back();
+	_free.pop_back();
+	resetDot(tag);
+	_used[tag] = true;
+	_pixel[tag] = pixel;
+	makeDotActive(tag);
+
+	return tag;
+}
+
+/**
+* Retires a dot whose marker is gone: removes it from the active set and
+* puts its tag on the free list, where acquireDot(...) finds it again.  The
+* tags of the other dots do not change, so neither do their ROIs; an
+* algorithm that Tracker::algorithm(alg, tag) set for the tag stays with it.
+*
+* @param[in] tag the dot, nothing happens if it is free already
+*/
+
+void Dots::releaseDot(int tag)
+{
+	if(tag < 0 || static_cast<size_t> (tag) >= _used.size() || !_used[tag]) {
+		return;
+	}
+
+	makeDotInactive(tag);
+	resetDot(tag);
+	_used[tag] = false;
+	_free.push_back(tag);
+}
+
+bool Dots::isDotUsed(int tag) const
+{
+	return tag >= 0 && static_cast<size_t> (tag) < _used.size() && _used[tag];
+}
+
+int Dots::freeDots() const
+{
+	return static_cast<int> (_free.size());
+}
+
 /**
 * Makes all dots inactive, resulting in an empty active set.
 */
 void Dots::clearActiveDots()
 {
-	_active_dots.clear();
+	int tag;
 
-	for(size_t i = 0, n = _dots.size(); i < n; ++i) {
-		_dots[i]._active = false;
+	// only the bits of the active dots are set
+	for(size_t i = 0; i < _active_dots.size(); ++i) {
+		tag = _active_dots[i]->tag();
+		_active[tag] = false;
+		_active_pos[tag] = INITIAL_VAL;
 	}
+	_active_dots.clear();
 }
 
 /**
@@ -118,46 +305,268 @@ ActiveDots& Dots::activeDots() const
 	return _active_dots;
 }
 
+int Dots::size() const
+{
+	return static_cast<int> (_dots.size());
+}
+
+/**
+* Returns the pixel locations of all size() dots, the location of the dot
+* with tag i is pixels()[i].  Only the locations of active dots are current.
+*/
+
+const Point2d* Dots::pixels() const
+{
+	return _pixel.empty() ? NULL : &_pixel[0];
+}
+
+/**
+* Returns the world locations of all size() dots, see pixels().  The ones
+* that were not read since their dot was tracked are worked out first.
+*/
+
+const Point3d* Dots::worlds() const
+{
+	for(size_t i = 0; i < _world_cam.size(); ++i) {
+		currentWorld(static_cast<int> (i));
+	}
+
+	return _world.empty() ? NULL : &_world[0];
+}
+
+/**
+* Sets how the velocity and acceleration estimates of every dot are
+* filtered.  Every new finite difference d moves an estimate e to
+* e + alpha * (d - e), so 1 gives the plain finite differences and small
+* values smooth the estimates the way the controllers' low-pass filters do,
+* e.g., 0.038.
+*
+* @param[in] alpha the weight of the newest difference, in (0, 1]
+*/
+
+void Dots::filter(double alpha)
+{
+	_alpha = std::min(std::max(alpha, 1e-6), 1.0);
+}
+
 //************ Private Member Functions (for friends) ************//
 
 int& Dots::imageNbr(int tag)
 {
-	CV_Assert(_dots[tag].isActive());
-	return _dots[tag]._image_nbr;
+	CV_Assert(_active[tag]);
+	return _image_nbr[tag];
 }
 
 double& Dots::timeStamp(int tag)
 {
-	CV_Assert(_dots[tag].isActive());
-	return _dots[tag]._time_stamp;
+	CV_Assert(_active[tag]);
+	return _time_stamp[tag];
 }
 
 bool& Dots::found(int tag)
 {
-	CV_Assert(_dots[tag].isActive());
-	return _dots[tag]._found;
+	CV_Assert(_active[tag]);
+	return _found[tag];
 }
 
 Point2d& Dots::pixel(int tag)
 {
-	CV_Assert(_dots[tag].isActive());
-	return _dots[tag]._pixel_loc;
+	CV_Assert(_active[tag]);
+	return _pixel[tag];
 }
 
-Point3d& Dots::world(int tag)
-{
-	CV_Assert(_dots[tag].isActive());
-	return _dots[tag]._world_loc;
+Point3d& Dots::world(int tag)
+{
+	CV_Assert(_active[tag]);
+	currentWorld(tag);
+	return _world[tag];
+}
+
+void Dots::world(int tag, const Point3d& w)
+{
+	CV_Assert(_active[tag]);
+	_world[tag] = w;
+	_world_cam[tag] = NULL;
+}
+
+/**
+* Notes that the world location of a dot is where cam sees its pixel
+* location, without working it out: the tracker sets the pixel location of
+* every dot of every image, but few callers read every world location.
+* currentWorld(...) calls cam.pixelToWorld(...) when it is read.
+*
+* @param[in] tag the dot
+* @param[in] cam the camera the pixel location is in, kept by pointer
+*/
+
+void Dots::worldFrom(int tag, const Camera& cam)
+{
+	CV_Assert(_active[tag]);
+	_world_cam[tag] = &cam;
+}
+
+const Point3d& Dots::currentWorld(int tag) const
+{
+	int head;
+
+	if(_world_cam[tag] != NULL) {
+		_world[tag] = _world_cam[tag]->pixelToWorld(_pixel[tag]);
+
+		// the newest location of the track is mostly the same one
+		head = tag * HISTORY + _hist_head[tag];
+		if(_hist_len[tag] > 0 && _hist_cam[head] == _world_cam[tag] &&
+			_hist_pixel[head] == _pixel[tag]) {
+			_hist_world[head] = _world[tag];
+			_hist_cam[head] = NULL;
+		}
+		_world_cam[tag] = NULL;
+	}
+
+	return _world[tag];
+}
+
+const Point3d& Dots::historyWorld(int i) const
+{
+	int tag = i / HISTORY;
+
+	if(_hist_cam[i] != NULL) {
+		if(_world_cam[tag] == _hist_cam[i] && _pixel[tag] == _hist_pixel[i]) {
+			_hist_world[i] = currentWorld(tag);
+		}
+		else {
+			_hist_world[i] = _hist_cam[i]->pixelToWorld(_hist_pixel[i]);
+		}
+		_hist_cam[i] = NULL;
+	}
+
+	return _hist_world[i];
+}
+
+/**
+* Runs the filters of the world velocity and acceleration over the
+* locations record(...) added to the track since they were last read, the
+* way record(...) runs the filter of the pixel velocity over every location.
+* With reads at least every HISTORY locations the estimates are the ones of
+* a filter run on every location; otherwise the filters start over on the
+* oldest location of the track, which with alpha 1 gives the same estimates.
+*
+* @param[in] tag the dot
+*/
+
+void Dots::updateWorldVelocity(int tag) const
+{
+	int age, n, cur, prev, len = _hist_len[tag];
+	double dt;
+	Point3d wv, wa;
+
+	for(age = std::min(_world_new[tag], len) - 1; age >= 0; --age) {
+		cur = tag * HISTORY + (_hist_head[tag] - age + HISTORY) % HISTORY;
+		n = _world_steps[tag];
+		if(age + 1 >= len) {
+			// the first location, or the locations before it were overwritten
+			_world_steps[tag] = 1;
+			continue;
+		}
+
+		prev = tag * HISTORY + (_hist_head[tag] - age - 1 + HISTORY) % HISTORY;
+		dt = _hist_time[cur] - _hist_time[prev];
+		wv = (historyWorld(cur) - historyWorld(prev)) * (1 / dt);
+		if(n == 1) {
+			// the first difference starts the filters
+			_world_vel[tag] = wv;
+		}
+		else {
+			wa = (wv - _world_vel[tag]) * (1 / dt);
+			_world_acc[tag] += (wa - _world_acc[tag]) * (n == 2 ? 1 : _alpha);
+			_world_vel[tag] += (wv - _world_vel[tag]) * _alpha;
+		}
+		_world_steps[tag] = std::min(n + 1, static_cast<int> (HISTORY));
+	}
+	_world_new[tag] = 0;
 }
 
 Dot& Dots::operator[] (int tag)
 {
-	CV_Assert(_dots[tag].isActive());
+	CV_Assert(_active[tag]);
 	return _dots[tag];
 }
 
+/**
+* Adds the current pixel and world location and time stamp of a dot to its
+* track, replacing the oldest of HISTORY locations, and updates the filtered
+* pixel velocity from the difference to the previous location.  A world
+* location that was not worked out yet is kept that way, and the world
+* velocity and acceleration are only updated when they are read, see
+* updateWorldVelocity(...).
+* A location with a time stamp that is not newer than the last one is not
+* added.  Only the fields of the dot are written, so dots can be recorded
+* from several threads at the same time.
+*
+* @param[in] tag the dot
+*/
+
+void Dots::record(int tag)
+{
+	int n, prev, head;
+	double dt;
+	Point2d pv;
+
+	CV_Assert(_active[tag]);
+	n = _hist_len[tag];
+	prev = tag * HISTORY + _hist_head[tag];
+
+	if(n > 0) {
+		dt = _time_stamp[tag] - _hist_time[prev];
+		if(dt <= 0) {
+			return;
+		}
+
+		pv = (_pixel[tag] - _hist_pixel[prev]) * (1 / dt);
+		if(n == 1) {
+			// the first difference starts the filter
+			_pixel_vel[tag] = pv;
+		}
+		else {
+			_pixel_vel[tag] += (pv - _pixel_vel[tag]) * _alpha;
+		}
+	}
+
+	head = (_hist_head[tag] + 1) % HISTORY;
+	_hist_head[tag] = head;
+	_hist_pixel[tag * HISTORY + head] = _pixel[tag];
+	_hist_world[tag * HISTORY + head] = _world[tag];
+	_hist_cam[tag * HISTORY + head] = _world_cam[tag];
+	_hist_time[tag * HISTORY + head] = _time_stamp[tag];
+	_hist_len[tag] = (n < HISTORY) ? n + 1 : HISTORY;
+	_world_new[tag] = std::min(_world_new[tag] + 1, static_cast<int> (HISTORY));
+}
+
+void Dots::resetDot(int tag)
+{
+	int i;
+
+	_pixel[tag] = Point2d(INITIAL_VAL, INITIAL_VAL);
+	_world[tag] = Point3d(INITIAL_VAL, INITIAL_VAL, INITIAL_VAL);
+	_world_cam[tag] = NULL;
+	_found[tag] = false;
+	_area[tag] = INITIAL_VAL;
+	_image_nbr[tag] = INITIAL_VAL;
+	_time_stamp[tag] = INITIAL_VAL;
+
+	for(i = tag * HISTORY; i < (tag + 1) * HISTORY; ++i) {
+		_hist_cam[i] = NULL;
+	}
+	_hist_len[tag] = 0;
+	_hist_head[tag] = 0;
+	_pixel_vel[tag] = Point2d(0, 0);
+	_world_vel[tag] = Point3d(0, 0, 0);
+	_world_acc[tag] = Point3d(0, 0, 0);
+	_world_new[tag] = 0;
+	_world_steps[tag] = 0;
+}
+
 double& Dots::area(int tag)
 {
-	CV_Assert(_dots[tag].isActive());
-	return _dots[tag]._area;
+	CV_Assert(_active[tag]);
+	return _area[tag];
 }
\ No newline at end of file
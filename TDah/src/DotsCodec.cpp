@@ -0,0 +1,345 @@
+/**
+* @file DotsCodec.cpp
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "Dot.h"
+#include "Dots.h"
+#include "DotsCodec.h"
+
+/** @brief the bytes of the header */
+#define HEADER_SIZE (4 * sizeof(unsigned int) + 2 * sizeof(unsigned short))
+/** @brief the bytes of a record without its fields */
+#define RECORD_SIZE (sizeof(unsigned short) + sizeof(unsigned char))
+/** @brief the bytes of every field of a record */
+#define FIELDS_SIZE (sizeof(int) + 9 * sizeof(double))
+
+/** @brief the largest tag a record can hold */
+#define MAX_TAG 0xffff
+
+/** @brief copies a value to the byte p points at and moves p past it */
+template <typename T> static inline void put(unsigned char*& p, const T& v)
+{
+	memcpy(p, &v, sizeof(T));
+	p += sizeof(T);
+}
+
+/** @brief copies the value p points at and moves p past it */
+template <typename T> static inline void get(const unsigned char*& p, T& v)
+{
+	memcpy(&v, p, sizeof(T));
+	p += sizeof(T);
+}
+
+/** @brief the bytes of the fields that are set in a record */
+static size_t fieldsSize(unsigned char fields)
+{
+	return ((fields & DotsCodec::IMAGE_NBR) ? sizeof(int) : 0)
+		+ ((fields & DotsCodec::TIME_STAMP) ? sizeof(double) : 0)
+		+ ((fields & DotsCodec::PIXEL) ? 2 * sizeof(double) : 0)
+		+ ((fields & DotsCodec::WORLD) ? 3 * sizeof(double) : 0)
+		+ ((fields & DotsCodec::AREA) ? sizeof(double) : 0);
+}
+
+DotsCodec::DotsCodec()
+	: _seq(0), _last(0), _decoded(false)
+{
+
+}
+
+/**
+* The bytes a snapshot of n active dots takes at most, the size of a buffer
+* that holds any snapshot of them.
+*/
+
+size_t DotsCodec::maxSize(int n)
+{
+	return HEADER_SIZE + n * (RECORD_SIZE + FIELDS_SIZE);
+}
+
+/**
+* Writes a snapshot of the active dots of dots into buf.  A delta snapshot
+* leaves out the fields that have the value of the last snapshot; the
+* first snapshot, and the first one after reset(), is always full, as are
+* the records of dots that were not in the last snapshot.  Dots whose tag
+* is larger than a record holds, 65535, are left out.
+*
+* @param[in] dots the dots, only the active ones are written
+* @param[out] buf the buffer
+* @param[in] size the bytes of buf, see maxSize(...)
+* @param[in] delta true for a delta snapshot
+* @return the bytes written, or 0 if the snapshot does not fit into buf, in
+*	which case the last snapshot stays what it was
+*/
+
+size_t DotsCodec::encode(const Dots& dots, void* buf, size_t size, bool delta)
+{
+	int tag, n = dots.size();
+	unsigned int magic = MAGIC, count = 0, bytes;
+	unsigned short version = VERSION, flags;
+	unsigned char fields;
+	unsigned char* out = static_cast<unsigned char*> (buf);
+	unsigned char* p;
+	size_t i, need;
+	ActiveDots& a = dots.activeDots();
+
+	if(static_cast<int> (_sent.size()) != n) {
+		_image_nbr.assign(n, 0);
+		_time_stamp.assign(n, 0);
+		_pixel.assign(n, cv::Point2d(0, 0));
+		_world.assign(n, cv::Point3d(0, 0, 0));
+		_area.assign(n, 0);
+		_sent.assign(n, 0);
+		_fields.assign(n, 0);
+		delta = false;
+	}
+	flags = delta ? DELTA : 0;
+
+	// the fields and size first, so a snapshot that does not fit changes nothing
+	need = HEADER_SIZE;
+	for(i = 0; i < a.size(); ++i) {
+		tag = a[i]->tag();
+		if(tag > MAX_TAG) {
+			continue;
+		}
+
+		fields = ALL;
+		if(delta && _sent[tag]) {
+			const cv::Point2d& px = dots._pixel[tag];
+			const cv::Point3d& w = dots.currentWorld(tag);
+
+			fields = 0;
+			if(dots._image_nbr[tag] != _image_nbr[tag]) {
+				fields |= IMAGE_NBR;
+			}
+			if(dots._time_stamp[tag] != _time_stamp[tag]) {
+				fields |= TIME_STAMP;
+			}
+			if(px.x != _pixel[tag].x || px.y != _pixel[tag].y) {
+				fields |= PIXEL;
+			}
+			if(w.x != _world[tag].x || w.y != _world[tag].y || w.z != _world[tag].z) {
+				fields |= WORLD;
+			}
+			if(dots._area[tag] != _area[tag]) {
+				fields |= AREA;
+			}
+		}
+		_fields[tag] = fields;
+		need += RECORD_SIZE + fieldsSize(fields);
+		++count;
+	}
+	if(need > size) {
+		return 0;
+	}
+
+	bytes = static_cast<unsigned int> (need);
+	p = out;
+	put(p, magic);
+	put(p, version);
+	put(p, flags);
+	put(p, count);
+	put(p, bytes);
+	put(p, _seq);
+
+	std::fill(_sent.begin(), _sent.end(), 0);
+	for(i = 0; i < a.size(); ++i) {
+		tag = a[i]->tag();
+		if(tag > MAX_TAG) {
+			continue;
+		}
+
+		fields = _fields[tag];
+		if(dots._found[tag]) {
+			fields |= FOUND;
+		}
+
+		put(p, static_cast<unsigned short> (tag));
+		put(p, fields);
+		if(fields & IMAGE_NBR) {
+			put(p, dots._image_nbr[tag]);
+		}
+		if(fields & TIME_STAMP) {
+			put(p, dots._time_stamp[tag]);
+		}
+		if(fields & PIXEL) {
+			put(p, dots._pixel[tag].x);
+			put(p, dots._pixel[tag].y);
+		}
+		if(fields & WORLD) {
+			const cv::Point3d& w = dots.currentWorld(tag);
+			put(p, w.x);
+			put(p, w.y);
+			put(p, w.z);
+		}
+		if(fields & AREA) {
+			put(p, dots._area[tag]);
+		}
+
+		_image_nbr[tag] = dots._image_nbr[tag];
+		_time_stamp[tag] = dots._time_stamp[tag];
+		_pixel[tag] = dots._pixel[tag];
+		_world[tag] = dots.currentWorld(tag);
+		_area[tag] = dots._area[tag];
+		_sent[tag] = 1;
+	}
+
+	++_seq;
+	return need;
+}
+
+/**
+* The bytes of the snapshot at the start of buf, so a log of snapshots can
+* be walked one by one.
+*
+* @return the bytes, or 0 if buf does not start with a whole snapshot
+*/
+
+size_t DotsCodec::snapshotSize(const void* buf, size_t size)
+{
+	unsigned int magic, count, bytes;
+	unsigned short version, flags;
+	const unsigned char* p = static_cast<const unsigned char*> (buf);
+
+	if(size < HEADER_SIZE) {
+		return 0;
+	}
+
+	get(p, magic);
+	get(p, version);
+	get(p, flags);
+	get(p, count);
+	get(p, bytes);
+	if(magic != MAGIC || version != VERSION || bytes < HEADER_SIZE || bytes > size) {
+		return 0;
+	}
+
+	return bytes;
+}
+
+/**
+* Reads a snapshot into dots: the dots of the snapshot become the active set
+* and get the fields it holds, the fields a delta left out keep the values
+* of the snapshot before it.  A record of a tag dots does not have is
+* skipped.
+*
+* @param[in] buf the snapshot
+* @param[in] size the bytes of buf
+* @param[out] dots the dots, the same ones for every snapshot of a stream
+* @return false, if buf holds no snapshot or a delta that does not follow
+*	the last snapshot that was read; dots is unchanged then
+*/
+
+bool DotsCodec::decode(const void* buf, size_t size, Dots& dots)
+{
+	int tag;
+	unsigned int magic, count, bytes, seq, i;
+	unsigned short version, flags, t;
+	unsigned char fields;
+	const unsigned char* p = static_cast<const unsigned char*> (buf);
+	const unsigned char* end;
+
+	size = snapshotSize(buf, size);
+	if(size == 0) {
+		return false;
+	}
+
+	get(p, magic);
+	get(p, version);
+	get(p, flags);
+	get(p, count);
+	get(p, bytes);
+	get(p, seq);
+	end = static_cast<const unsigned char*> (buf) + bytes;
+
+	if((flags & DELTA) && (!_decoded || seq != _last + 1)) {
+		return false;
+	}
+
+	// check the records before touching the dots
+	const unsigned char* q = p;
+	for(i = 0; i < count; ++i) {
+		if(q + RECORD_SIZE > end) {
+			return false;
+		}
+		q += sizeof(unsigned short);
+		get(q, fields);
+		q += fieldsSize(fields);
+		if(q > end) {
+			return false;
+		}
+	}
+
+	dots.clearActiveDots();
+	for(i = 0; i < count; ++i) {
+		get(p, t);
+		get(p, fields);
+		tag = t;
+		if(tag >= dots.size()) {
+			p += fieldsSize(fields);
+			continue;
+		}
+
+		if(fields & IMAGE_NBR) {
+			get(p, dots._image_nbr[tag]);
+		}
+		if(fields & TIME_STAMP) {
+			get(p, dots._time_stamp[tag]);
+		}
+		if(fields & PIXEL) {
+			get(p, dots._pixel[tag].x);
+			get(p, dots._pixel[tag].y);
+		}
+		if(fields & WORLD) {
+			get(p, dots._world[tag].x);
+			get(p, dots._world[tag].y);
+			get(p, dots._world[tag].z);
+			dots._world_cam[tag] = NULL;
+		}
+		if(fields & AREA) {
+			get(p, dots._area[tag]);
+		}
+		dots._found[tag] = (fields & FOUND) != 0;
+		dots.makeDotActive(tag);
+	}
+
+	_last = seq;
+	_decoded = true;
+	return true;
+}
+
+/**
+* Decodes a snapshot into dots and formats the active dots one line each,
+* "tag image_nbr found pixel_x pixel_y world_x world_y world_z time_stamp",
+* like Tracker::str(...) does in the loop.
+*
+* @return the lines, empty if the snapshot could not be decoded
+*/
+
+std::string DotsCodec::print(const void* buf, size_t size, Dots& dots)
+{
+	std::stringstream ss;
+
+	if(!decode(buf, size, dots)) {
+		return "";
+	}
+
+	ActiveDots& a = dots.activeDots();
+	for(size_t i = 0; i < a.size(); ++i) {
+		ss << a[i]->tag() << " " << a[i]->imageNbr() << " " << a[i]->isFound() <<
+			" " << a[i]->pixelX() << " " << a[i]->pixelY() <<
+			" " << a[i]->worldX() << " " << a[i]->worldY() <<
+			" " << a[i]->worldZ() << " " << a[i]->timeStamp()
+			<< std::endl;
+	}
+
+	return ss.str();
+}
+
+void DotsCodec::reset()
+{
+	_sent.clear();
+	_decoded = false;
+}
@@ -0,0 +1,266 @@
+/**
+* @file DotsPublisher.cpp
+*/
+
+// keeps the min and max macros of windows.h off std::min and std::max
+#define NOMINMAX
+// winsock2.h has to come before windows.h
+#include <winsock2.h>
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include "Dots.h"
+#include "DotsPublisher.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+/** @brief how often the thread looks at _quit */
+#define WAIT_MS 100
+
+DotsPublisher::Config DotsPublisher::defaults()
+{
+	Config cfg;
+
+	cfg.host = "192.168.1.65";
+	cfg.port = 3491;
+	cfg.tcp = false;
+	cfg.frames = 8;
+	cfg.max_dots = 64;
+
+	return cfg;
+}
+
+DotsPublisher::DotsPublisher()
+	: _frame_size(0), _head(0), _tail(0), _socket(INVALID_SOCKET), _addr(0), _last_try(0),
+	_wsa(false), _sent(0), _dropped(0), _failures(0), _quit(false), _thread(NULL),
+	_ready(NULL)
+{
+	_cfg = defaults();
+	_err[0] = '\0';
+}
+
+DotsPublisher::~DotsPublisher()
+{
+	close();
+}
+
+/**
+* Starts winsock, connects the socket to the receiver and starts the
+* thread.  The frames are allocated here, as large as a snapshot of
+* cfg.max_dots dots, so publish() allocates nothing.  A TCP receiver must be
+* listening already; if it goes away later the thread connects again.
+*
+* @param[in] cfg the receiver and the ring
+* @return false, with the reason in error(), if the socket could not be
+*	connected or the thread not started
+*/
+
+bool DotsPublisher::open(const Config& cfg)
+{
+	WSADATA wsa;
+
+	close();
+	_cfg = cfg;
+
+	if(cfg.frames < 1 || cfg.max_dots < 1) {
+		sprintf_s(_err, sizeof(_err), "%d frames of %d dots", cfg.frames, cfg.max_dots);
+		printf("DotsPublisher: %s\n", _err);
+		return false;
+	}
+	_addr = inet_addr(cfg.host);
+	if(_addr == INADDR_NONE) {
+		sprintf_s(_err, sizeof(_err), "%s is no IPv4 address", cfg.host);
+		printf("DotsPublisher: %s\n", _err);
+		return false;
+	}
+
+	if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		sprintf_s(_err, sizeof(_err), "winsock does not start");
+		printf("DotsPublisher: %s\n", _err);
+		return false;
+	}
+	_wsa = true;
+	if(!connectSocket()) {
+		printf("DotsPublisher: %s\n", _err);
+		close();
+		return false;
+	}
+
+	_frame_size = DotsCodec::maxSize(cfg.max_dots);
+	_buf.assign(cfg.frames*_frame_size, 0);
+	_bytes.assign(cfg.frames, 0);
+	_codec.reset();
+	_head = _tail = 0;
+	_sent = _dropped = _failures = 0;
+	_quit = false;
+
+	_ready = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if(_ready != NULL) {
+		_thread = CreateThread(NULL, 0, main, this, 0, NULL);
+	}
+	if(_thread == NULL) {
+		sprintf_s(_err, sizeof(_err), "the thread does not start");
+		printf("DotsPublisher: %s\n", _err);
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void DotsPublisher::close()
+{
+	if(_thread != NULL) {
+		_quit = true;
+		SetEvent(_ready);
+		WaitForSingleObject(_thread, INFINITE);
+		CloseHandle(_thread);
+		_thread = NULL;
+	}
+	if(_ready != NULL) {
+		CloseHandle(_ready);
+		_ready = NULL;
+	}
+
+	closeSocket();
+	if(_wsa) {
+		WSACleanup();
+		_wsa = false;
+	}
+}
+
+bool DotsPublisher::connectSocket()
+{
+	SOCKET s;
+	sockaddr_in to;
+	BOOL on = TRUE;
+
+	_last_try = GetTickCount();
+	s = socket(AF_INET, _cfg.tcp ? SOCK_STREAM : SOCK_DGRAM, _cfg.tcp ? IPPROTO_TCP : IPPROTO_UDP);
+	if(s == INVALID_SOCKET) {
+		sprintf_s(_err, sizeof(_err), "no socket, error %d", WSAGetLastError());
+		return false;
+	}
+
+	// a frame must not wait for the next one to fill a segment
+	if(_cfg.tcp) {
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*) &on, sizeof(on));
+	}
+
+	// for a datagram socket this only sets where send() goes
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_port = htons((u_short) _cfg.port);
+	to.sin_addr.s_addr = _addr;
+	if(connect(s, (const sockaddr*) &to, sizeof(to)) == SOCKET_ERROR) {
+		sprintf_s(_err, sizeof(_err), "%s:%d does not connect, error %d", _cfg.host, _cfg.port,
+			WSAGetLastError());
+		closesocket(s);
+		return false;
+	}
+
+	_socket = s;
+	return true;
+}
+
+void DotsPublisher::closeSocket()
+{
+	if(_socket != INVALID_SOCKET) {
+		closesocket((SOCKET) _socket);
+		_socket = INVALID_SOCKET;
+	}
+}
+
+/**
+* Writes a snapshot of the active dots into the next frame of the ring,
+* unless the ring is full; called by Tracker::track(...) after the dots were
+* tracked.  The snapshot has the image number and time stamp every dot got
+* from its image, so the receiver times the dots by the camera, not by the
+* network.
+*
+* @param[in] dots the dots of the image that was just tracked
+* @return false, if the publisher is not open or the frame was dropped
+*/
+
+bool DotsPublisher::publish(const Dots& dots)
+{
+	size_t bytes;
+
+	if(_thread == NULL) {
+		return false;
+	}
+	if(_tail - _head >= _cfg.frames) {
+		InterlockedIncrement(&_dropped);
+		return false;
+	}
+
+	long slot = _tail % _cfg.frames;
+	bytes = _codec.encode(dots, &_buf[slot*_frame_size], _frame_size);
+	if(bytes == 0) {
+		InterlockedIncrement(&_dropped);
+		return false;
+	}
+	_bytes[slot] = bytes;
+
+	// the frame must be complete before the thread can see it
+	MemoryBarrier();
+	_tail = _tail + 1;
+	SetEvent(_ready);
+
+	return true;
+}
+
+/**
+* Sends every frame publish() wrote since the last call, in order.  A TCP
+* link whose send fails is closed, and the frames are dropped until it is
+* connected again; a datagram that does not go out only costs its frame.
+*/
+
+void DotsPublisher::sendFrames()
+{
+	while(_head != _tail) {
+		// read the frame only after seeing it published
+		MemoryBarrier();
+		long slot = _head % _cfg.frames;
+
+		if(_socket == INVALID_SOCKET && _cfg.tcp &&
+			GetTickCount() - _last_try >= RECONNECT_MS && connectSocket()) {
+			printf("DotsPublisher: %s:%d connected again\n", _cfg.host, _cfg.port);
+		}
+
+		if(_socket == INVALID_SOCKET) {
+			InterlockedIncrement(&_failures);
+		}
+		else if(send((SOCKET) _socket, &_buf[slot*_frame_size], (int) _bytes[slot], 0) ==
+			(int) _bytes[slot]) {
+			InterlockedIncrement(&_sent);
+		}
+		else {
+			InterlockedIncrement(&_failures);
+			if(_cfg.tcp) {
+				// a partly sent frame would break every frame after it
+				sprintf_s(_err, sizeof(_err), "send failed, error %d", WSAGetLastError());
+				printf("DotsPublisher: %s\n", _err);
+				closeSocket();
+			}
+		}
+
+		// hand the frame back to publish()
+		MemoryBarrier();
+		_head = _head + 1;
+	}
+}
+
+/** @brief sends the frames of the ring until close(), and the last ones then */
+unsigned long __stdcall DotsPublisher::main(void* param)
+{
+	DotsPublisher* p = static_cast<DotsPublisher*> (param);
+
+	while(!p->_quit) {
+		WaitForSingleObject(p->_ready, WAIT_MS);
+		p->sendFrames();
+	}
+	p->sendFrames();
+
+	return 0;
+}
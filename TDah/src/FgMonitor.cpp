@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <intrin.h>
+#include <fgrab_prototyp.h>
+#include <fgrab_define.h>
+
+#include "FgMonitor.h"
+
+#define MONITOR_BARRIER() _ReadWriteBarrier()
+
+/** @brief a counter of the port, of its memory head if it has one */
+static int status(FgMonitor* m, int param)
+{
+	if(m->mem != NULL) {
+		return Fg_getStatusEx(m->fg, param, 0, m->port, m->mem);
+	}
+
+	return Fg_getStatus(m->fg, param, 0, m->port);
+}
+
+/** @brief samples the counters and publishes them, only called by the monitor thread */
+static void sample(FgMonitor* m)
+{
+	FgMonitorSnapshot s;
+	int last, consumed;
+
+	s.transferred = status(m, NUMBER_OF_ACT_IMAGE);
+	last = status(m, NUMBER_OF_LAST_IMAGE);
+	s.lost = status(m, NUMBER_OF_LOST_IMAGES);
+	consumed = m->consumed;
+
+	s.fetched = (last > consumed) ? last : consumed;
+	s.backlog = (s.transferred > s.fetched) ? s.transferred - s.fetched : 0;
+	s.buffers = m->buffers;
+	s.samples = m->snap.samples + 1;
+
+	// a backlog of a whole ring means the grabber is writing over unread images
+	if(s.lost > m->snap.lost || s.backlog >= s.buffers) {
+		s.pressure = FG_PRESSURE_LOSING;
+	}
+	else if(s.backlog * 100 >= s.buffers * FG_MONITOR_HIGH) {
+		s.pressure = FG_PRESSURE_HIGH;
+	}
+	else {
+		s.pressure = FG_PRESSURE_OK;
+	}
+
+	InterlockedIncrement(&m->seq);
+	MONITOR_BARRIER();
+	m->snap = s;
+	MONITOR_BARRIER();
+	InterlockedIncrement(&m->seq);
+}
+
+static DWORD WINAPI monitor(LPVOID param)
+{
+	FgMonitor* m = (FgMonitor*) param;
+	int pressure = FG_PRESSURE_OK;
+
+	while(m->running) {
+		sample(m);
+		if(m->snap.pressure != pressure) {
+			pressure = m->snap.pressure;
+			if(m->action != NULL) {
+				m->action(&m->snap, m->ctx);
+			}
+		}
+		Sleep(m->period_ms);
+	}
+
+	return 0;
+}
+
+/**
+* @brief starts sampling port of fg every period_ms
+*
+* The acquisition should already have been started, the counters are only
+* sampled from the first image on.
+*
+* @param m the monitor, owned by the caller until fg_monitor_stop
+* @param fg the frame grabber
+* @param port the port of fg, PORT_A or PORT_B
+* @param mem the memory head of port for Fg_AllocMemEx or user memory, NULL for
+* Fg_AllocMem
+* @param buffers the number of buffers allocated for port
+* @param period_ms the time between two samples in milliseconds
+* @param action called when the pressure changes, may be NULL
+* @param ctx passed to action
+*
+* @return 0 on success, -1 if the thread could not be created
+*/
+
+int fg_monitor_start(FgMonitor* m, Fg_Struct* fg, int port, dma_mem* mem, int buffers,
+	int period_ms, fg_monitor_action action, void* ctx)
+{
+	memset(m, 0, sizeof(FgMonitor));
+	m->fg = fg;
+	m->port = port;
+	m->mem = mem;
+	m->buffers = buffers;
+	m->period_ms = (period_ms > 0) ? period_ms : 1;
+	m->action = action;
+	m->ctx = ctx;
+	m->snap.buffers = buffers;
+
+	m->running = 1;
+	m->thread = CreateThread(NULL, 0, monitor, m, 0, NULL);
+	if(m->thread == NULL) {
+		printf("fg_monitor_start: could not create the monitor thread\n");
+		m->running = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+* @brief tells the monitor the consumer is done with image img_nbr
+*
+* Only needed by consumers that do not fetch their images with
+* Fg_getLastPicNumber*, it is a single store.
+*/
+
+void fg_monitor_consumed(FgMonitor* m, int img_nbr)
+{
+	m->consumed = img_nbr;
+}
+
+/** @brief copies the newest snapshot of m, never waits for the monitor thread */
+void fg_monitor_read(FgMonitor* m, FgMonitorSnapshot* s)
+{
+	long seq;
+
+	do {
+		seq = m->seq;
+		MONITOR_BARRIER();
+		*s = m->snap;
+		MONITOR_BARRIER();
+	} while((seq & 1) || seq != m->seq);
+}
+
+/** @brief stops sampling, the last snapshot can still be read */
+void fg_monitor_stop(FgMonitor* m)
+{
+	if(!m->running) {
+		return;
+	}
+
+	m->running = 0;
+	WaitForSingleObject((HANDLE) m->thread, INFINITE);
+	CloseHandle((HANDLE) m->thread);
+	m->thread = NULL;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fgrab_define.h>
+
+#include "FrameTiming.h"
+
+/** @brief the pixel clock of the TrackCam in MHz */
+#define FRAME_TIMING_CLOCK 40.0
+
+/** @brief the number of lines a width x height ROI takes to transfer */
+static int lines(const FrameTiming* t, int width, int height)
+{
+	return (width < t->short_width) ? height + 1 : height;
+}
+
+/** @brief the determinant of a 3 x 3 matrix */
+static double det3(double m[3][3])
+{
+	return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+		- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+		+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+/**
+* @brief sets the model to the oscilloscope values for a camera link mode
+*
+* Each pixel was clocked out at 40 MHz two at a time in FG_CL_DUALTAP_8_BIT with a
+* .2 us gap after every line and after the frame.  The other modes are assumed to
+* clock out one pixel at a time.  The calibration is emptied.
+*
+* @param t the model
+* @param camlink the camera link mode of the port, FG_CAMERA_LINK_CAMTYP
+*/
+
+void frame_timing_init(FrameTiming* t, int camlink)
+{
+	memset(t, 0, sizeof(FrameTiming));
+	t->line_us = .2;
+	t->pixel_us = 1 / (FRAME_TIMING_CLOCK * ((camlink == FG_CL_DUALTAP_8_BIT) ? 2 : 1));
+	t->gap_us = .2;
+	t->short_width = 528;
+}
+
+/**
+* @brief the shortest frame time of a ROI
+*
+* @param t the model
+* @param width the width of the ROI in pixels
+* @param height the height of the ROI in pixels
+* @param exposure the exposure time in microseconds
+*
+* @return the frame time in microseconds
+*/
+
+double frame_timing_min(const FrameTiming* t, int width, int height, double exposure)
+{
+	return exposure + lines(t, width, height) * (t->line_us + width * t->pixel_us)
+		+ t->gap_us;
+}
+
+/** @brief frame, or the shortest frame time of the ROI if frame is shorter */
+double frame_timing_clamp(const FrameTiming* t, int width, int height, double exposure,
+	double frame)
+{
+	double least = frame_timing_min(t, width, height, exposure);
+
+	return (frame < least) ? least : frame;
+}
+
+/**
+* @brief adds a run to the calibration
+*
+* Only runs at the shortest frame time tell the model anything, so a run should only
+* be observed when the camera could not keep up with the frame time it was asked
+* for, its images then come as fast as the camera can make them.
+*
+* @param t the model
+* @param width the width of the ROI in pixels
+* @param height the height of the ROI in pixels
+* @param exposure the exposure time in microseconds
+* @param period the time between two images of the run in microseconds
+*/
+
+void frame_timing_observe(FrameTiming* t, int width, int height, double exposure,
+	double period)
+{
+	int i, j;
+	double a[3], b;
+
+	// period - exposure = lines * line_us + lines * width * pixel_us + gap_us
+	a[0] = lines(t, width, height);
+	a[1] = a[0] * width;
+	a[2] = 1;
+	b = period - exposure;
+
+	for(i = 0; i < 3; i++) {
+		for(j = 0; j < 3; j++) {
+			t->ata[i][j] += a[i] * a[j];
+		}
+		t->atb[i] += a[i] * b;
+	}
+	t->runs++;
+}
+
+/**
+* @brief fits line_us, pixel_us and gap_us to the observed runs
+*
+* The runs have to differ in both their width and their height, otherwise the gaps
+* can not be told apart from the pixels and the model is left as it was.
+*
+* @return 0 on success, -1 if there were too few or too similar runs
+*/
+
+int frame_timing_fit(FrameTiming* t)
+{
+	int i, j;
+	double d, m[3][3], x[3];
+
+	if(t->runs < 3) {
+		return -1;
+	}
+
+	d = det3(t->ata);
+	if(fabs(d) < 1e-9 * fabs(t->ata[0][0] * t->ata[1][1] * t->ata[2][2])) {
+		return -1;
+	}
+
+	// Cramer's rule
+	for(i = 0; i < 3; i++) {
+		memcpy(m, t->ata, sizeof(m));
+		for(j = 0; j < 3; j++) {
+			m[j][i] = t->atb[j];
+		}
+		x[i] = det3(m) / d;
+	}
+
+	if(x[1] <= 0) {
+		printf("frame_timing_fit: the fitted pixel time %g us is not positive\n", x[1]);
+		return -1;
+	}
+
+	t->line_us = x[0];
+	t->pixel_us = x[1];
+	t->gap_us = x[2];
+
+	return 0;
+}
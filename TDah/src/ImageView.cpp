@@ -0,0 +1,55 @@
+#include "ImageView.h"
+
+using cv::Mat;
+using cv::Point;
+using cv::Rect;
+using cv::Size;
+
+/**
+* Makes a view of the pixels of img.  If img is a region of a larger Mat,
+* its offset is its position in that Mat, otherwise (0, 0).
+*/
+
+ImageView::ImageView(const Mat& img)
+{
+	Size whole;
+
+	data = img.data;
+	step = static_cast<int> (img.step);
+	width = img.cols;
+	height = img.rows;
+	type = img.type();
+	if(img.empty()) {
+		offset = Point();
+	}
+	else {
+		img.locateROI(whole, offset);
+	}
+}
+
+/**
+* Makes a view of the rectangle r of the view.  The rectangle is relative
+* to the view and must be inside it, the view of it has the same stride and
+* its offset is its position in the image frame.
+*/
+
+ImageView ImageView::operator()(const Rect& r) const
+{
+	ImageView v = *this;
+
+	CV_DbgAssert(r.x >= 0 && r.y >= 0 && r.x + r.width <= width && r.y + r.height <= height);
+	v.data = data + r.y * step + r.x * CV_ELEM_SIZE(type);
+	v.width = r.width;
+	v.height = r.height;
+	v.offset = Point(offset.x + r.x, offset.y + r.y);
+	return v;
+}
+
+Mat ImageView::mat() const
+{
+	if(data == NULL) {
+		return Mat();
+	}
+
+	return Mat(height, width, type, const_cast<uchar*> (data), step);
+}
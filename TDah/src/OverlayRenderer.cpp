@@ -0,0 +1,279 @@
+/**
+* @file OverlayRenderer.cpp
+*/
+
+// keeps the min and max macros of windows.h off std::min and std::max
+#define NOMINMAX
+#include <windows.h>
+#include <sstream>
+#include <highgui.h>
+#include "Dot.h"
+#include "Dots.h"
+#include "Camera.h"
+#include "OverlayRenderer.h"
+
+/** @brief set in a middle slot by the side that filled it, cleared by the side that takes it */
+#define FRESH 4
+/** @brief the slot index in a middle slot */
+#define SLOT 3
+
+/** @brief how often the thread looks at _quit */
+#define WAIT_MS 100
+
+/** @brief the colors of the marks, like LOC_COLOR and TAG_COLOR of the algorithms */
+static const cv::Scalar FOUND_COLOR(0, 255, 0);
+static const cv::Scalar LOST_COLOR(0, 0, 255);
+static const cv::Scalar TAG_COLOR(255, 255, 0);
+
+/** @brief the radius of a mark, in overlay pixels */
+#define MARK_RADIUS 6
+
+OverlayRenderer::Config OverlayRenderer::defaults()
+{
+	Config cfg;
+
+	cfg.max_fps = 30.;
+	cfg.decimate = 2;
+	cfg.window = "Dots";
+
+	return cfg;
+}
+
+OverlayRenderer::OverlayRenderer()
+	: _snap_back(0), _snap_front(2), _snap_middle(1), _overlay_back(0), _overlay_front(2),
+	_overlay_middle(1), _last_post(0), _min_ticks(0), _posted(0), _rendered(0), _quit(false),
+	_thread(NULL), _ready(NULL)
+{
+	_cfg = defaults();
+}
+
+OverlayRenderer::~OverlayRenderer()
+{
+	stop();
+}
+
+/**
+* Starts the thread.  Its buffers are allocated by the first snapshot and
+* kept as long as the images have the same size.
+*
+* @param[in] cfg the rate, decimation and window of the overlay
+* @return false, if the thread could not be started
+*/
+
+bool OverlayRenderer::start(const Config& cfg)
+{
+	LARGE_INTEGER f;
+
+	if(_thread != NULL) {
+		return true;
+	}
+
+	_cfg = cfg;
+	if(_cfg.decimate < 1) {
+		_cfg.decimate = 1;
+	}
+	QueryPerformanceFrequency(&f);
+	_min_ticks = cfg.max_fps > 0 ? static_cast<long long> (f.QuadPart/cfg.max_fps) : 0;
+	_last_post = 0;
+
+	_snap_back = 0;
+	_snap_middle = 1;
+	_snap_front = 2;
+	_overlay_back = 0;
+	_overlay_middle = 1;
+	_overlay_front = 2;
+	_posted = _rendered = 0;
+	_quit = false;
+
+	_ready = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if(_ready == NULL) {
+		return false;
+	}
+
+	_thread = CreateThread(NULL, 0, main, this, 0, NULL);
+	if(_thread == NULL) {
+		CloseHandle(_ready);
+		_ready = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void OverlayRenderer::stop()
+{
+	if(_thread == NULL) {
+		return;
+	}
+
+	_quit = true;
+	SetEvent(_ready);
+	WaitForSingleObject(_thread, INFINITE);
+	CloseHandle(_thread);
+	_thread = NULL;
+	CloseHandle(_ready);
+	_ready = NULL;
+}
+
+/**
+* Copies the image cam retrieves and the state of the active dots into the
+* next snapshot, and hands it to the thread; called after the dots of the
+* image were tracked.  Within 1 / max_fps of the last snapshot nothing is
+* copied at all, so most images cost a counter read.
+*
+* @param[in] cam the camera the dots were just tracked in
+* @param[in] dots the tracked dots
+* @return false, if the renderer is not running, the snapshot was not due or
+*	the camera had no image
+*/
+
+bool OverlayRenderer::post(Camera& cam, Dots& dots)
+{
+	LARGE_INTEGER now;
+	cv::Mat src;
+	Mark m;
+
+	if(_thread == NULL) {
+		return false;
+	}
+
+	QueryPerformanceCounter(&now);
+	if(_last_post != 0 && now.QuadPart - _last_post < _min_ticks) {
+		return false;
+	}
+	if(!cam.retrieve(src) || src.empty()) {
+		return false;
+	}
+	_last_post = now.QuadPart;
+
+	// the dots are in the image frame, a ROI of a VideoCaptureMe3 is not
+	Snapshot& s = _snaps[_snap_back];
+	s.offset = cam.view(src).offset;
+
+	// the slot keeps its pixels, so only a new image size allocates
+	if(_cfg.decimate == 1) {
+		src.copyTo(s.img);
+	}
+	else {
+		cv::resize(src, s.img, cv::Size(src.cols/_cfg.decimate, src.rows/_cfg.decimate), 0, 0,
+			cv::INTER_NEAREST);
+	}
+
+	ActiveDots& a = dots.activeDots();
+	s.marks.clear();
+	s.image_nbr = a.empty() ? 0 : a[0]->imageNbr();
+	for(ActiveDots::const_iterator dot = a.begin(); dot < a.end(); ++dot) {
+		m.tag = (*dot)->tag();
+		m.pixel = (*dot)->pixel();
+		m.found = (*dot)->isFound();
+		s.marks.push_back(m);
+	}
+
+	// the exchange is a full barrier, so the thread sees the whole snapshot
+	_snap_back = InterlockedExchange(&_snap_middle, _snap_back | FRESH) & SLOT;
+	InterlockedIncrement(&_posted);
+	SetEvent(_ready);
+
+	return true;
+}
+
+/**
+* Copies the overlay the thread drew last, for a caller that shows or saves
+* it itself; with a window the thread shows it as well.
+*
+* @param[out] dst the overlay, BGR, 1 / decimate of the image each way
+* @return false, if nothing was drawn yet
+*/
+
+bool OverlayRenderer::latest(cv::Mat& dst)
+{
+	if(_overlay_middle & FRESH) {
+		_overlay_front = InterlockedExchange(&_overlay_middle, _overlay_front) & SLOT;
+	}
+
+	const cv::Mat& o = _overlays[_overlay_front];
+	if(o.empty()) {
+		return false;
+	}
+	o.copyTo(dst);
+
+	return true;
+}
+
+/**
+* Converts the snapshot to BGR and draws the marks of all of its dots.  The
+* pixel locations are moved to the image and divided by the decimation, the
+* marks keep their size.
+*/
+
+void OverlayRenderer::render()
+{
+	std::stringstream ss;
+	const Snapshot& s = _snaps[_snap_front];
+	cv::Mat& dst = _overlays[_overlay_back];
+	double scale = 1.0/_cfg.decimate;
+
+	if(s.img.type() == CV_8UC1) {
+		cv::cvtColor(s.img, dst, CV_GRAY2BGR);
+	}
+	else {
+		s.img.copyTo(dst);
+	}
+
+	for(size_t i = 0; i < s.marks.size(); ++i) {
+		const Mark& m = s.marks[i];
+		cv::Point p(cvRound((m.pixel.x - s.offset.x)*scale),
+			cvRound((m.pixel.y - s.offset.y)*scale));
+
+		if(m.found) {
+			cv::circle(dst, p, MARK_RADIUS, FOUND_COLOR);
+		}
+		else {
+			cv::line(dst, p - cv::Point(MARK_RADIUS, MARK_RADIUS),
+				p + cv::Point(MARK_RADIUS, MARK_RADIUS), LOST_COLOR);
+			cv::line(dst, p - cv::Point(MARK_RADIUS, -MARK_RADIUS),
+				p + cv::Point(MARK_RADIUS, -MARK_RADIUS), LOST_COLOR);
+		}
+
+		ss.str("");
+		ss << m.tag;
+		cv::putText(dst, ss.str(), p + cv::Point(MARK_RADIUS, -MARK_RADIUS),
+			CV_FONT_HERSHEY_PLAIN, 1, TAG_COLOR);
+	}
+
+	ss.str("");
+	ss << "img " << s.image_nbr;
+	cv::putText(dst, ss.str(), cv::Point(4, 14), CV_FONT_HERSHEY_PLAIN, 1, TAG_COLOR);
+}
+
+/** @brief draws, and shows, the snapshots until stop() */
+unsigned long __stdcall OverlayRenderer::main(void* param)
+{
+	OverlayRenderer* r = static_cast<OverlayRenderer*> (param);
+
+	while(!r->_quit) {
+		WaitForSingleObject(r->_ready, WAIT_MS);
+		if(r->_cfg.window != NULL) {
+			// the window of the thread only handles its messages in here
+			cv::waitKey(1);
+		}
+		if(!(r->_snap_middle & FRESH)) {
+			continue;
+		}
+
+		r->_snap_front = InterlockedExchange(&r->_snap_middle, r->_snap_front) & SLOT;
+		r->render();
+		if(r->_cfg.window != NULL) {
+			cv::imshow(r->_cfg.window, r->_overlays[r->_overlay_back]);
+		}
+		r->_overlay_back = InterlockedExchange(&r->_overlay_middle,
+			r->_overlay_back | FRESH) & SLOT;
+		InterlockedIncrement(&r->_rendered);
+	}
+
+	if(r->_cfg.window != NULL) {
+		cv::destroyWindow(r->_cfg.window);
+	}
+
+	return 0;
+}
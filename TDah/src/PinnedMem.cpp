@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <windows.h>
+
+#include "PinnedMem.h"
+
+/** @brief the 4 kB pages a locked block may be short of the working set by */
+#define WORKING_SET_SLACK (64 * 4096)
+
+struct PinnedBlock {
+	void* p;
+	size_t size; /**< @brief the bytes allocated, rounded up to the page */
+	PinnedKind kind;
+};
+
+static PinnedBlock blocks[PINNED_MAX_BLOCKS];
+static int nblocks = 0;
+/** @brief 1 once the lock pages right was enabled, -1 once it failed */
+static int large_right = 0;
+
+static const char* kind_names[] = { "large pages", "locked", "pageable" };
+
+/**
+* @brief enables SeLockMemoryPrivilege in the token of the process
+*
+* The right has to be granted to the user by the local security policy, a token
+* only carries it disabled.
+*/
+
+static int enableLargePages()
+{
+	HANDLE token;
+	TOKEN_PRIVILEGES tp;
+	BOOL ok;
+
+	if(large_right != 0) {
+		return large_right > 0;
+	}
+
+	large_right = -1;
+	if(GetLargePageMinimum() == 0 ||
+		!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+		return 0;
+	}
+
+	tp.PrivilegeCount = 1;
+	tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	ok = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid) &&
+		AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL) &&
+		GetLastError() == ERROR_SUCCESS;
+	CloseHandle(token);
+
+	if(ok) {
+		large_right = 1;
+	}
+
+	return ok;
+}
+
+/** @brief locks the pages of p, growing the working set of the process to hold them */
+static int lockPages(void* p, size_t size)
+{
+	SIZE_T lo, hi;
+
+	if(!GetProcessWorkingSetSize(GetCurrentProcess(), &lo, &hi)) {
+		return 0;
+	}
+	if(!SetProcessWorkingSetSize(GetCurrentProcess(), lo + size + WORKING_SET_SLACK,
+		hi + size + WORKING_SET_SLACK)) {
+		return 0;
+	}
+
+	if(!VirtualLock(p, size)) {
+		SetProcessWorkingSetSize(GetCurrentProcess(), lo, hi);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+* @brief allocates size zeroed bytes, aligned and pinned, NULL if there is no memory
+*
+* The memory of VirtualAlloc starts on a page and is zeroed, in large pages it is
+* rounded up to a whole number of them.
+*/
+
+void* pinned_alloc(size_t size)
+{
+	SIZE_T large, page;
+	SYSTEM_INFO si;
+	PinnedBlock* b;
+
+	if(size == 0 || nblocks == PINNED_MAX_BLOCKS) {
+		return NULL;
+	}
+	b = blocks + nblocks;
+
+	large = GetLargePageMinimum();
+	if(large > 0 && size >= large && enableLargePages()) {
+		b->size = (size + large - 1) / large * large;
+		b->p = VirtualAlloc(NULL, b->size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES,
+			PAGE_READWRITE);
+		if(b->p != NULL) {
+			b->kind = PINNED_LARGE;
+			nblocks++;
+			return b->p;
+		}
+	}
+
+	GetSystemInfo(&si);
+	page = si.dwPageSize;
+	b->size = (size + page - 1) / page * page;
+	b->p = VirtualAlloc(NULL, b->size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if(b->p == NULL) {
+		return NULL;
+	}
+	b->kind = lockPages(b->p, b->size) ? PINNED_LOCKED : PINNED_PAGEABLE;
+	nblocks++;
+
+	return b->p;
+}
+
+/** @brief frees a block of pinned_alloc, NULL is ignored */
+void pinned_free(void* p)
+{
+	int i;
+	SIZE_T lo, hi;
+
+	if(p == NULL) {
+		return;
+	}
+
+	for(i = 0; i < nblocks && blocks[i].p != p; i++);
+	if(i == nblocks) {
+		return;
+	}
+
+	if(blocks[i].kind == PINNED_LOCKED) {
+		VirtualUnlock(p, blocks[i].size);
+		if(GetProcessWorkingSetSize(GetCurrentProcess(), &lo, &hi) &&
+			lo > blocks[i].size + WORKING_SET_SLACK) {
+			SetProcessWorkingSetSize(GetCurrentProcess(),
+				lo - blocks[i].size - WORKING_SET_SLACK, hi - blocks[i].size - WORKING_SET_SLACK);
+		}
+	}
+	VirtualFree(p, 0, MEM_RELEASE);
+
+	blocks[i] = blocks[--nblocks];
+}
+
+/** @brief how the block at p is held, PINNED_PAGEABLE if p is no block */
+PinnedKind pinned_kind(const void* p)
+{
+	int i;
+
+	for(i = 0; i < nblocks; i++) {
+		if(blocks[i].p == p) {
+			return blocks[i].kind;
+		}
+	}
+
+	return PINNED_PAGEABLE;
+}
+
+/** @brief prints the blocks and how each of them is held */
+void pinned_report()
+{
+	int i;
+
+	for(i = 0; i < nblocks; i++) {
+		printf("pinned: %u kB %s\n", (unsigned int) (blocks[i].size / 1024),
+			kind_names[blocks[i].kind]);
+	}
+	if(large_right < 0) {
+		printf("pinned: no large pages, see the lock pages in memory right of the user\n");
+	}
+}
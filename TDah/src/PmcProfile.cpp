@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+#include <intrin.h>
+
+#include "PmcProfile.h"
+
+#define PMC_BARRIER() _ReadWriteBarrier()
+/** @brief the most threads that can count kernels */
+#define PMC_RINGS 16
+/** @brief kernels per thread between two sums, must be a power of two */
+#define PMC_RING_LEN 1024
+#define PMC_RING_MASK (PMC_RING_LEN - 1)
+#define PMC_SUM_MS 10
+#define NO_RING ((PmcRing*) -1)
+
+/** @brief rdpmc reads fixed counter i with this bit set, 0 the instructions, 1 the cycles */
+#define PMC_FIXED (1 << 30)
+/** @brief the counters are 48 bits wide at least, a difference is taken modulo that */
+#define PMC_WIDTH_MASK 0xffffffffffffULL
+
+/** @brief what one kernel took */
+struct PmcEvent {
+	unsigned short kernel;
+	unsigned short roi;
+	unsigned __int64 d[PMC_COUNTERS];
+};
+
+/**
+* @brief a single-producer/single-consumer ring of counted kernels, like a TraceRing
+*
+* only the owning thread writes tail and only the sum thread writes head.
+*/
+struct PmcRing {
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	volatile unsigned int dropped;
+	PmcEvent events[PMC_RING_LEN];
+};
+
+/** @brief the sums of one kernel and ROI */
+struct PmcTotal {
+	unsigned __int64 calls;
+	unsigned __int64 sum[PMC_COUNTERS];
+};
+
+static const char* kernel_names[PMC_USER] = {
+	"threshold", "erode", "position", "stages", "find", NULL, NULL, NULL
+};
+
+static PmcRing rings[PMC_RINGS];
+static volatile unsigned int nrings = 0;
+static PmcTotal totals[PMC_KERNELS][PMC_ROIS];
+static volatile int mode = PMC_OFF;
+static volatile int running = 0;
+static HANDLE summer = NULL;
+static __declspec(thread) PmcRing* thread_ring = NULL;
+
+/** @brief returns the calling thread's ring, claiming one on the first call */
+static inline PmcRing* threadRing()
+{
+	unsigned int slot;
+
+	if(thread_ring == NULL) {
+		slot = InterlockedIncrement((volatile LONG*) &nrings) - 1;
+		thread_ring = (slot < PMC_RINGS) ? rings + slot : NO_RING;
+	}
+
+	return thread_ring;
+}
+
+/** @brief true, if rdpmc of the counters works on this core */
+static int probe()
+{
+	__try {
+		__readpmc(PMC_FIXED | 0);
+		__readpmc(PMC_FIXED | 1);
+		__readpmc(0);
+		__readpmc(1);
+	}
+	__except(EXCEPTION_EXECUTE_HANDLER) {
+		return 0;
+	}
+
+	return 1;
+}
+
+/** @brief adds the kernels in every ring to the totals */
+static void sum()
+{
+	unsigned int i, n, head, tail;
+	int c;
+	const PmcEvent* e;
+	PmcTotal* t;
+
+	n = (nrings < PMC_RINGS) ? nrings : PMC_RINGS;
+	for(i = 0; i < n; i++) {
+		head = rings[i].head;
+		tail = rings[i].tail;
+		PMC_BARRIER();
+
+		for(; head != tail; head++) {
+			e = rings[i].events + (head & PMC_RING_MASK);
+			t = &totals[e->kernel][e->roi];
+			t->calls++;
+			for(c = 0; c < PMC_COUNTERS; c++) {
+				t->sum[c] += e->d[c];
+			}
+		}
+
+		PMC_BARRIER();
+		rings[i].head = head;
+	}
+}
+
+static DWORD WINAPI sumThread(LPVOID)
+{
+	while(running) {
+		sum();
+		Sleep(PMC_SUM_MS);
+	}
+
+	return 0;
+}
+
+/**
+* @brief clears the sums and starts the thread adding them up
+*
+* The counters are probed on the calling thread's core, which should be the one the
+* kernels run on.
+*
+* @return PMC_RDPMC if all four counters can be read, PMC_TSC if only the TSC can,
+*	PMC_OFF if the thread could not be created
+*/
+
+int pmc_start()
+{
+	if(running) {
+		return mode;
+	}
+
+	memset(totals, 0, sizeof(totals));
+	mode = probe() ? PMC_RDPMC : PMC_TSC;
+	if(mode == PMC_TSC) {
+		printf("pmc_start: rdpmc is not enabled, counting TSC cycles only\n");
+	}
+
+	running = 1;
+	summer = CreateThread(NULL, 0, sumThread, NULL, 0, NULL);
+	if(summer == NULL) {
+		printf("pmc_start: could not create the sum thread\n");
+		running = 0;
+		mode = PMC_OFF;
+		return PMC_OFF;
+	}
+
+	return mode;
+}
+
+/**
+* @brief reads the counters of the calling thread's core
+*
+* Before pmc_start, and after pmc_stop, the sample is all zeros.
+*/
+
+void pmc_read(PmcSample* s)
+{
+	switch(mode) {
+		case PMC_RDPMC:
+			s->v[PMC_CYCLES] = __readpmc(PMC_FIXED | 1);
+			s->v[PMC_INSTRUCTIONS] = __readpmc(PMC_FIXED | 0);
+			s->v[PMC_LLC_MISSES] = __readpmc(0);
+			s->v[PMC_BRANCH_MISSES] = __readpmc(1);
+			break;
+
+		case PMC_TSC:
+			s->v[PMC_CYCLES] = __rdtsc();
+			s->v[PMC_INSTRUCTIONS] = s->v[PMC_LLC_MISSES] = s->v[PMC_BRANCH_MISSES] = 0;
+			break;
+
+		default:
+			memset(s, 0, sizeof(PmcSample));
+			break;
+	}
+}
+
+/**
+* @brief reads the counters again and counts the differences for kernel and roi
+*
+* If the calling thread's ring is full the kernel is dropped and counted, the hot
+* path never waits on the sum thread.
+*
+* @param[in] kernel one of pmc_kernel, PMC_USER and up for others below PMC_KERNELS
+* @param[in] roi the ROI, or dot tag, the kernel ran on
+* @param[in] begin the sample of PMC_BEGIN
+*/
+
+void pmc_end(unsigned int kernel, unsigned int roi, const PmcSample* begin)
+{
+	int c;
+	unsigned int tail;
+	PmcSample end;
+	PmcRing* ring;
+	PmcEvent* e;
+
+	if(!running || kernel >= PMC_KERNELS) {
+		return;
+	}
+	pmc_read(&end);
+
+	ring = threadRing();
+	if(ring == NO_RING) {
+		return;
+	}
+	tail = ring->tail;
+	if(tail - ring->head >= PMC_RING_LEN) {
+		ring->dropped++;
+		return;
+	}
+
+	e = ring->events + (tail & PMC_RING_MASK);
+	e->kernel = (unsigned short) kernel;
+	e->roi = (unsigned short) (roi < PMC_ROIS ? roi : PMC_ROIS - 1);
+	for(c = 0; c < PMC_COUNTERS; c++) {
+		e->d[c] = (end.v[c] - begin->v[c]) & PMC_WIDTH_MASK;
+	}
+	PMC_BARRIER();
+	ring->tail = tail + 1;
+}
+
+/**
+* @brief prints a line per kernel and ROI that was counted
+*
+* The sums are only complete after pmc_stop; while the thread runs the last few
+* milliseconds of kernels are still in the rings.
+*/
+
+void pmc_report(FILE* out)
+{
+	int k, r;
+	double calls, cycles, inst;
+	const PmcTotal* t;
+
+	fprintf(out, "%-10s %4s %10s %12s %12s %6s %10s %10s\n", "kernel", "roi", "calls",
+		"cycles/call", "inst/call", "ipc", "llc/kinst", "br/kinst");
+	for(k = 0; k < PMC_KERNELS; k++) {
+		for(r = 0; r < PMC_ROIS; r++) {
+			t = &totals[k][r];
+			if(t->calls == 0) {
+				continue;
+			}
+
+			calls = (double) t->calls;
+			cycles = (double) t->sum[PMC_CYCLES];
+			inst = (double) t->sum[PMC_INSTRUCTIONS];
+			if(k < PMC_USER && kernel_names[k] != NULL) {
+				fprintf(out, "%-10s ", kernel_names[k]);
+			}
+			else {
+				fprintf(out, "user %-5d ", k);
+			}
+			fprintf(out, "%4d %10.0f %12.0f ", r, calls, cycles / calls);
+
+			// without rdpmc there are only the cycles
+			if(inst > 0) {
+				fprintf(out, "%12.0f %6.2f %10.2f %10.2f\n", inst / calls, inst / cycles,
+					1000.0 * t->sum[PMC_LLC_MISSES] / inst,
+					1000.0 * t->sum[PMC_BRANCH_MISSES] / inst);
+			}
+			else {
+				fprintf(out, "%12s %6s %10s %10s\n", "-", "-", "-", "-");
+			}
+		}
+	}
+	if(pmc_dropped() > 0) {
+		fprintf(out, "%u kernels not counted, a ring was full\n", pmc_dropped());
+	}
+}
+
+/** @brief stops the sum thread after adding up every ring */
+void pmc_stop()
+{
+	if(!running) {
+		return;
+	}
+
+	running = 0;
+	WaitForSingleObject(summer, INFINITE);
+	CloseHandle(summer);
+	summer = NULL;
+
+	sum();
+	mode = PMC_OFF;
+}
+
+unsigned int pmc_dropped()
+{
+	unsigned int i, n, dropped = 0;
+
+	n = (nrings < PMC_RINGS) ? nrings : PMC_RINGS;
+	for(i = 0; i < n; i++) {
+		dropped += rings[i].dropped;
+	}
+
+	return dropped;
+}
@@ -0,0 +1,354 @@
+/**
+* @file ResultBus.cpp
+*/
+
+// keeps the min and max macros of windows.h off std::min and std::max
+#define NOMINMAX
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include "Dots.h"
+#include "ResultBus.h"
+
+/** @brief the bytes before the first slot, a cache line of its own for the header */
+#define HEADER_BYTES 64
+/** @brief the slots start on multiples of this */
+#define SLOT_ALIGN 64
+
+/** @brief the bytes from one slot to the next */
+static size_t slotStride(size_t slot_size)
+{
+	return (sizeof(ResultSlot) + slot_size + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+}
+
+/** @brief the header of slot i of the ring at h */
+static ResultSlot* slotAt(const ResultBusHeader* h, unsigned int i)
+{
+	char* base = (char*) h + HEADER_BYTES;
+
+	return (ResultSlot*) (base + i * slotStride(h->slot_size));
+}
+
+ResultBus::Config ResultBus::defaults()
+{
+	Config cfg;
+
+	cfg.name = NULL;
+	cfg.slots = 16;
+	cfg.max_dots = 64;
+
+	return cfg;
+}
+
+ResultBus::ResultBus()
+	: _header(NULL), _mapping(NULL), _next(0), _dropped(0)
+{
+	_cfg = defaults();
+}
+
+ResultBus::~ResultBus()
+{
+	close();
+}
+
+/**
+* Sets up a ring of cfg.slots slots, each as large as a snapshot of
+* cfg.max_dots dots, so publish() allocates nothing.  With cfg.name the ring
+* is a file mapping of that name, which must not exist yet.
+*
+* @param[in] cfg the name and size of the ring
+* @return false, if the ring could not be allocated or mapped
+*/
+
+bool ResultBus::open(const Config& cfg)
+{
+	size_t size, slot_size;
+	void* mem;
+
+	close();
+	_cfg = cfg;
+
+	if(cfg.slots < 2 || cfg.max_dots < 1) {
+		printf("ResultBus: %d slots of %d dots\n", cfg.slots, cfg.max_dots);
+		return false;
+	}
+	slot_size = DotsCodec::maxSize(cfg.max_dots);
+	size = HEADER_BYTES + cfg.slots*slotStride(slot_size);
+
+	// both come zeroed, so every slot starts at seq 0, no frame
+	if(cfg.name != NULL) {
+		_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+			(DWORD) size, cfg.name);
+		if(_mapping == NULL || GetLastError() == ERROR_ALREADY_EXISTS) {
+			// a ring of another bus, or of readers of one that is gone
+			printf("ResultBus: %s cannot be created, error %lu\n", cfg.name, GetLastError());
+			close();
+			return false;
+		}
+		mem = MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, size);
+	}
+	else {
+		mem = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	}
+	if(mem == NULL) {
+		printf("ResultBus: no ring of %u bytes, error %lu\n", (unsigned int) size,
+			GetLastError());
+		close();
+		return false;
+	}
+
+	_header = static_cast<ResultBusHeader*> (mem);
+	_header->slots = cfg.slots;
+	_header->slot_size = (unsigned int) slot_size;
+	_header->latest = 0;
+	_next = _dropped = 0;
+	_codec.reset();
+
+	// a reader checks the magic before it reads the sizes
+	MemoryBarrier();
+	_header->magic = MAGIC;
+
+	return true;
+}
+
+void ResultBus::close()
+{
+	if(_header != NULL) {
+		if(_mapping != NULL) {
+			UnmapViewOfFile(_header);
+		}
+		else {
+			VirtualFree(_header, 0, MEM_RELEASE);
+		}
+		_header = NULL;
+	}
+	if(_mapping != NULL) {
+		CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+}
+
+/**
+* Writes a full snapshot of the active dots into the slot of the next frame;
+* called by Tracker::track(...) after the dots were tracked.  A reader that
+* is copying the frame the slot held sees the sequence number change and
+* lets it go, the bus does not wait for it.
+*
+* @param[in] dots the dots of the image that was just tracked
+* @return false, if the bus is not open or the dots do not fit a slot; the
+*	frame is published empty then, so the readers see the gap
+*/
+
+bool ResultBus::publish(const Dots& dots)
+{
+	size_t bytes;
+
+	if(_header == NULL) {
+		return false;
+	}
+
+	unsigned long f = _next;
+	ResultSlot* s = slotAt(_header, f % _header->slots);
+
+	s->seq = 2*f + 1;
+	MemoryBarrier();
+	bytes = _codec.encode(dots, s + 1, _header->slot_size);
+	s->bytes = (unsigned int) bytes;
+	MemoryBarrier();
+	s->seq = 2*f + 2;
+	_header->latest = f + 1;
+	_next = f + 1;
+
+	if(bytes == 0) {
+		_dropped++;
+		return false;
+	}
+
+	return true;
+}
+
+ResultBusReader::ResultBusReader()
+	: _header(NULL), _mapping(NULL), _last(0), _missed(0)
+{
+
+}
+
+ResultBusReader::~ResultBusReader()
+{
+	close();
+}
+
+/**
+* Reads the ring of a bus of this process, from the next frame it publishes
+* on.  The reader has to be closed before the bus.
+*
+* @param[in] bus an open bus
+* @return false, if the bus is not open
+*/
+
+bool ResultBusReader::open(const ResultBus& bus)
+{
+	close();
+	if(bus._header == NULL) {
+		return false;
+	}
+
+	_header = bus._header;
+	_last = _header->latest;
+	_missed = 0;
+	_copy.reserve(_header->slot_size);
+
+	return true;
+}
+
+/**
+* Maps the ring of the bus opened with Config::name name, from the next
+* frame it publishes on.  The mapping stays valid after the bus closes,
+* there are just no new frames.
+*
+* @param[in] name the name of the ring
+* @return false, if there is no ring of that name
+*/
+
+bool ResultBusReader::open(const char* name)
+{
+	close();
+
+	_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if(_mapping == NULL) {
+		return false;
+	}
+	_header = static_cast<const ResultBusHeader*> (MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	if(_header == NULL || _header->magic != ResultBus::MAGIC) {
+		close();
+		return false;
+	}
+
+	MemoryBarrier();
+	_last = _header->latest;
+	_missed = 0;
+	_copy.reserve(_header->slot_size);
+
+	return true;
+}
+
+void ResultBusReader::close()
+{
+	if(_mapping != NULL) {
+		if(_header != NULL) {
+			UnmapViewOfFile(_header);
+		}
+		CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+	_header = NULL;
+}
+
+const ResultSlot* ResultBusReader::slot(unsigned int i) const
+{
+	return slotAt(_header, i);
+}
+
+/**
+* Copies the snapshot of frame f out of its slot.  The copy is kept only if
+* the slot held frame f, complete, before and after it.
+*/
+
+bool ResultBusReader::copy(unsigned long f)
+{
+	unsigned long seq;
+	unsigned int bytes;
+	const ResultSlot* s = slot(f % _header->slots);
+
+	seq = s->seq;
+	if(seq != 2*f + 2) {
+		return false;
+	}
+	MemoryBarrier();
+
+	// a torn size is caught by seq below, it only must not overrun the slot
+	bytes = s->bytes;
+	if(bytes > _header->slot_size) {
+		bytes = 0;
+	}
+	_copy.resize(bytes);
+	if(bytes > 0) {
+		memcpy(&_copy[0], s + 1, bytes);
+	}
+
+	MemoryBarrier();
+	return s->seq == seq;
+}
+
+/**
+* Decodes the newest frame into dots, skipping the ones before it.  A
+* display or a sender that only wants the dots as they are now reads this
+* way.
+*
+* @param[out] dots the dots of the frame, large enough for its tags
+* @return false, if no frame was published since the last one read, the
+*	bus kept overwriting it or it was published empty
+*/
+
+bool ResultBusReader::latest(Dots& dots)
+{
+	unsigned long l;
+
+	if(_header == NULL) {
+		return false;
+	}
+
+	for(int i = 0; i < RETRIES; ++i) {
+		l = _header->latest;
+		if(l == _last) {
+			return false;
+		}
+		if(copy(l - 1)) {
+			_last = l;
+			return !_copy.empty() && _codec.decode(&_copy[0], _copy.size(), dots);
+		}
+	}
+
+	return false;
+}
+
+/**
+* Decodes the frame after the last one read into dots, for a logger that
+* wants every frame.  A reader that fell more than a ring behind goes on
+* with the oldest frame the bus is not about to overwrite, and counts the
+* ones in between in missed().
+*
+* @param[out] dots the dots of the frame, large enough for its tags
+* @return false, if there is no new frame, the frame was published empty or
+*	the bus kept overwriting it
+*/
+
+bool ResultBusReader::next(Dots& dots)
+{
+	unsigned long l, oldest;
+
+	if(_header == NULL) {
+		return false;
+	}
+
+	for(int i = 0; i < RETRIES; ++i) {
+		l = _header->latest;
+		if(l == _last) {
+			return false;
+		}
+
+		// the slot of frame l - slots may be taken by frame l already
+		oldest = l - (_header->slots - 1);
+		if(l - _last > _header->slots - 1) {
+			_missed += oldest - _last;
+			_last = oldest;
+		}
+
+		if(copy(_last)) {
+			++_last;
+			return !_copy.empty() && _codec.decode(&_copy[0], _copy.size(), dots);
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,498 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "RtLog.h"
+
+#if defined(__QNX__)
+	#include <errno.h>
+	#include <pthread.h>
+	#include <unistd.h>
+	#include <atomic.h>
+	#include <sys/neutrino.h>
+	#define RTLOG_BARRIER() __asm__ __volatile__("" ::: "memory")
+	#define RTLOG_LL "ll"
+	#define rtlog_snprintf snprintf
+#else
+	#include <windows.h>
+	#include <intrin.h>
+	#define RTLOG_BARRIER() _ReadWriteBarrier()
+	#define RTLOG_LL "I64"
+	#define rtlog_snprintf _snprintf
+#endif
+
+/** @brief the most threads that can write messages */
+#define RTLOG_RINGS 16
+/** @brief messages per thread between two passes of the writer, must be a power of two */
+#define RTLOG_RING_LEN 512
+#define RTLOG_RING_MASK (RTLOG_RING_LEN - 1)
+#define RTLOG_FLUSH_MS 20
+/** @brief the longest message written, longer ones are cut */
+#define RTLOG_LINE_LEN 512
+#define NO_RING ((LogRing*) -1)
+
+struct LogRecord {
+	const char* fmt;
+	int level;
+	int nargs;
+	rtlog_uint_t tsc;
+	RtLogArg args[RTLOG_MAX_ARGS];
+};
+
+/**
+* @brief a single-producer/single-consumer ring of messages
+*
+* only the owning thread writes tail and only the writer thread writes head.
+*/
+struct LogRing {
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	volatile unsigned int dropped;
+	LogRecord records[RTLOG_RING_LEN];
+};
+
+static LogRing rings[RTLOG_RINGS];
+static volatile unsigned int nrings = 0;
+static volatile int running = 0;
+static FILE* out = NULL;
+
+#if defined(__QNX__)
+static pthread_t writer;
+static pthread_key_t ring_key;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+
+static void makeRingKey()
+{
+	pthread_key_create(&ring_key, NULL);
+}
+
+static inline rtlog_uint_t now()
+{
+	return ClockCycles();
+}
+
+/** @brief returns the calling thread's ring, claiming one on the first call */
+static inline LogRing* threadRing()
+{
+	LogRing* ring;
+	unsigned int slot;
+
+	pthread_once(&ring_once, makeRingKey);
+	ring = (LogRing*) pthread_getspecific(ring_key);
+	if(ring == NULL) {
+		slot = atomic_add_value(&nrings, 1);
+		ring = (slot < RTLOG_RINGS) ? rings + slot : NO_RING;
+		pthread_setspecific(ring_key, ring);
+	}
+
+	return ring;
+}
+#else
+static HANDLE writer = NULL;
+static __declspec(thread) LogRing* thread_ring = NULL;
+
+static inline rtlog_uint_t now()
+{
+	return __rdtsc();
+}
+
+/** @brief returns the calling thread's ring, claiming one on the first call */
+static inline LogRing* threadRing()
+{
+	unsigned int slot;
+
+	if(thread_ring == NULL) {
+		slot = InterlockedIncrement((volatile LONG*) &nrings) - 1;
+		thread_ring = (slot < RTLOG_RINGS) ? rings + slot : NO_RING;
+	}
+
+	return thread_ring;
+}
+#endif
+
+/** @brief appends one conversion of spec to buf, keeping pos within size */
+template<class T> static void put(char* buf, int size, int* pos, const char* spec, T value)
+{
+	int n;
+
+	if(*pos >= size - 1) {
+		return;
+	}
+
+	// _snprintf gives -1 and no terminator on a cut
+	n = rtlog_snprintf(buf + *pos, size - *pos, spec, value);
+	if(n < 0 || n >= size - *pos) {
+		n = size - 1 - *pos;
+	}
+	*pos += n;
+	buf[*pos] = '\0';
+}
+
+/**
+* @brief formats a message as snprintf would, from its recorded arguments
+*
+* Every conversion is handed to snprintf on its own, with its argument cast to the
+* type its length modifier names; the integers are then printed with a 64 bit
+* modifier, so one spelling of "ll" serves every compiler.  A conversion with no
+* argument left is copied as it is.
+*
+* @return the length of the message in buf, cut at size - 1
+*/
+
+int rtlog_format(char* buf, int size, const char* fmt, const RtLogArg* args, int nargs)
+{
+	char spec[32];
+	int pos = 0, arg = 0, len, n;
+	const char* p = fmt;
+	const char* start;
+	const char* s;
+	char conv;
+
+	if(size <= 0) {
+		return 0;
+	}
+	buf[0] = '\0';
+
+	while(*p != '\0' && pos < size - 1) {
+		if(*p != '%') {
+			buf[pos++] = *p++;
+			continue;
+		}
+		if(p[1] == '%') {
+			buf[pos++] = '%';
+			p += 2;
+			continue;
+		}
+
+		// flags, width and precision go to snprintf as they are
+		start = p++;
+		while(*p != '\0' && strchr("-+ #0", *p) != NULL) p++;
+		while(*p >= '0' && *p <= '9') p++;
+		if(*p == '.') {
+			p++;
+			while(*p >= '0' && *p <= '9') p++;
+		}
+		n = (int) (p - start);
+
+		// 0 none, 1 hh, 2 h, 3 l, 4 ll or I64
+		len = 0;
+		if(p[0] == 'h' && p[1] == 'h') { len = 1; p += 2; }
+		else if(p[0] == 'h') { len = 2; p++; }
+		else if(p[0] == 'l' && p[1] == 'l') { len = 4; p += 2; }
+		else if(p[0] == 'l') { len = 3; p++; }
+		else if(p[0] == 'I' && p[1] == '6' && p[2] == '4') { len = 4; p += 3; }
+		else if(p[0] == 'L') { p++; }
+
+		conv = *p;
+		if(conv == '\0') {
+			break;
+		}
+		p++;
+		if(arg >= nargs || n + 5 > (int) sizeof(spec) || strchr("diuoxXcseEfgGp", conv) == NULL) {
+			n = (int) (p - start);
+			if(n > size - 1 - pos) n = size - 1 - pos;
+			memcpy(buf + pos, start, n);
+			pos += n;
+			continue;
+		}
+
+		memcpy(spec, start, n);
+		spec[n] = '\0';
+		switch(conv) {
+		case 'd':
+		case 'i':
+			strcat(spec, RTLOG_LL);
+			n = (int) strlen(spec);
+			spec[n] = conv;
+			spec[n + 1] = '\0';
+			if(len == 1) put(buf, size, &pos, spec, (rtlog_int_t) (signed char) args[arg].v.i);
+			else if(len == 2) put(buf, size, &pos, spec, (rtlog_int_t) (short) args[arg].v.i);
+			else if(len == 0) put(buf, size, &pos, spec, (rtlog_int_t) (int) args[arg].v.i);
+			else if(len == 3) put(buf, size, &pos, spec, (rtlog_int_t) (long) args[arg].v.i);
+			else put(buf, size, &pos, spec, args[arg].v.i);
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			strcat(spec, RTLOG_LL);
+			n = (int) strlen(spec);
+			spec[n] = conv;
+			spec[n + 1] = '\0';
+			if(len == 1) put(buf, size, &pos, spec, (rtlog_uint_t) (unsigned char) args[arg].v.i);
+			else if(len == 2) put(buf, size, &pos, spec, (rtlog_uint_t) (unsigned short) args[arg].v.i);
+			else if(len == 0) put(buf, size, &pos, spec, (rtlog_uint_t) (unsigned int) args[arg].v.i);
+			else if(len == 3) put(buf, size, &pos, spec, (rtlog_uint_t) (unsigned long) args[arg].v.i);
+			else put(buf, size, &pos, spec, (rtlog_uint_t) args[arg].v.i);
+			break;
+		case 'c':
+			strcat(spec, "c");
+			put(buf, size, &pos, spec, (int) args[arg].v.i);
+			break;
+		case 's':
+			strcat(spec, "s");
+			s = (const char*) args[arg].v.p;
+			put(buf, size, &pos, spec, (s != NULL) ? s : "(null)");
+			break;
+		case 'p':
+			strcat(spec, "p");
+			put(buf, size, &pos, spec, args[arg].v.p);
+			break;
+		default:
+			n = (int) strlen(spec);
+			spec[n] = conv;
+			spec[n + 1] = '\0';
+			put(buf, size, &pos, spec, args[arg].v.d);
+			break;
+		}
+		arg++;
+	}
+
+	buf[pos] = '\0';
+	return pos;
+}
+
+/** @brief formats one message and writes it to the console and the file */
+static void emit(const LogRecord* rec)
+{
+	char line[RTLOG_LINE_LEN];
+
+	rtlog_format(line, sizeof(line), rec->fmt, rec->args, rec->nargs);
+	fputs(line, stdout);
+	if(out != NULL) {
+		fputs(line, out);
+	}
+}
+
+/** @brief writes the messages in every ring, the oldest of them first */
+static void drain()
+{
+	unsigned int i, n, oldest;
+	unsigned int head[RTLOG_RINGS], tail[RTLOG_RINGS];
+	const LogRecord* rec;
+
+	n = (nrings < RTLOG_RINGS) ? nrings : RTLOG_RINGS;
+	for(i = 0; i < n; i++) {
+		head[i] = rings[i].head;
+		tail[i] = rings[i].tail;
+	}
+	RTLOG_BARRIER();
+
+	for(;;) {
+		oldest = n;
+		for(i = 0; i < n; i++) {
+			if(head[i] != tail[i] && (oldest == n ||
+				rings[i].records[head[i] & RTLOG_RING_MASK].tsc <
+				rings[oldest].records[head[oldest] & RTLOG_RING_MASK].tsc)) {
+				oldest = i;
+			}
+		}
+		if(oldest == n) {
+			break;
+		}
+		rec = &rings[oldest].records[head[oldest] & RTLOG_RING_MASK];
+		emit(rec);
+		head[oldest]++;
+	}
+
+	RTLOG_BARRIER();
+	for(i = 0; i < n; i++) {
+		rings[i].head = head[i];
+	}
+
+	fflush(stdout);
+	if(out != NULL) {
+		fflush(out);
+	}
+}
+
+#if defined(__QNX__)
+static void* flush(void*)
+#else
+static DWORD WINAPI flush(LPVOID)
+#endif
+{
+	while(running) {
+		drain();
+#if defined(__QNX__)
+		delay(RTLOG_FLUSH_MS);
+#else
+		Sleep(RTLOG_FLUSH_MS);
+#endif
+	}
+
+	return 0;
+}
+
+/**
+* @brief starts the thread writing the messages, to file as well unless it is NULL
+*
+* The messages recorded before the call were printed at once, those of the threads
+* from now on wait in their rings for the writer.
+*
+* @return 0 on success, -1 if the file or the thread could not be created
+*/
+
+int rtlog_start(const char* file)
+{
+	if(running) {
+		return 0;
+	}
+
+	if(file != NULL) {
+		out = fopen(file, "w");
+		if(out == NULL) {
+			printf("rtlog_start: could not open %s\n", file);
+			return -1;
+		}
+	}
+
+	running = 1;
+#if defined(__QNX__)
+	if(pthread_create(&writer, NULL, flush, NULL) != EOK) {
+#else
+	writer = CreateThread(NULL, 0, flush, NULL, 0, NULL);
+	if(writer == NULL) {
+#endif
+		printf("rtlog_start: could not create the writer thread\n");
+		running = 0;
+		if(out != NULL) {
+			fclose(out);
+			out = NULL;
+		}
+		return -1;
+	}
+
+#if !defined(__QNX__)
+	// a message should not wait long behind the frame loop
+	SetThreadPriority(writer, THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+
+	return 0;
+}
+
+/** @brief stops the writer thread after writing every message */
+void rtlog_stop()
+{
+	if(!running) {
+		return;
+	}
+
+	running = 0;
+#if defined(__QNX__)
+	pthread_join(writer, NULL);
+#else
+	WaitForSingleObject(writer, INFINITE);
+	CloseHandle(writer);
+#endif
+
+	drain();
+	if(out != NULL) {
+		fclose(out);
+		out = NULL;
+	}
+}
+
+/** @brief the number of messages dropped because a ring was full */
+unsigned int rtlog_dropped()
+{
+	unsigned int i, n, dropped = 0;
+
+	n = (nrings < RTLOG_RINGS) ? nrings : RTLOG_RINGS;
+	for(i = 0; i < n; i++) {
+		dropped += rings[i].dropped;
+	}
+
+	return dropped;
+}
+
+/**
+* @brief records a message for the calling thread
+*
+* Without the writer the message is printed at once.  If the calling thread's ring
+* is full the message is dropped and counted, the hot path never waits on the writer.
+*/
+
+static void record(int level, const char* fmt, const RtLogArg* args, int nargs)
+{
+	unsigned int tail;
+	LogRing* ring;
+	LogRecord* rec;
+	int i;
+
+	if(!running) {
+		LogRecord msg;
+
+		msg.fmt = fmt;
+		msg.nargs = nargs;
+		for(i = 0; i < nargs; i++) {
+			msg.args[i] = args[i];
+		}
+		emit(&msg);
+		return;
+	}
+
+	ring = threadRing();
+	if(ring == NO_RING) {
+		return;
+	}
+
+	tail = ring->tail;
+	if(tail - ring->head >= RTLOG_RING_LEN) {
+		ring->dropped++;
+		return;
+	}
+
+	rec = &ring->records[tail & RTLOG_RING_MASK];
+	rec->fmt = fmt;
+	rec->level = level;
+	rec->nargs = nargs;
+	rec->tsc = now();
+	for(i = 0; i < nargs; i++) {
+		rec->args[i] = args[i];
+	}
+	RTLOG_BARRIER();
+	ring->tail = tail + 1;
+}
+
+void rtlog_write(int level, const char* fmt)
+{
+	record(level, fmt, NULL, 0);
+}
+
+void rtlog_write(int level, const char* fmt, RtLogArg a1)
+{
+	record(level, fmt, &a1, 1);
+}
+
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2)
+{
+	RtLogArg args[] = { a1, a2 };
+	record(level, fmt, args, 2);
+}
+
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3)
+{
+	RtLogArg args[] = { a1, a2, a3 };
+	record(level, fmt, args, 3);
+}
+
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3,
+	RtLogArg a4)
+{
+	RtLogArg args[] = { a1, a2, a3, a4 };
+	record(level, fmt, args, 4);
+}
+
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3,
+	RtLogArg a4, RtLogArg a5)
+{
+	RtLogArg args[] = { a1, a2, a3, a4, a5 };
+	record(level, fmt, args, 5);
+}
+
+void rtlog_write(int level, const char* fmt, RtLogArg a1, RtLogArg a2, RtLogArg a3,
+	RtLogArg a4, RtLogArg a5, RtLogArg a6)
+{
+	RtLogArg args[] = { a1, a2, a3, a4, a5, a6 };
+	record(level, fmt, args, 6);
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+#include "RtProfile.h"
+
+typedef HANDLE (WINAPI *AvSetMmThreadCharacteristicsFn)(LPCSTR, LPDWORD);
+typedef BOOL (WINAPI *AvRevertMmThreadCharacteristicsFn)(HANDLE);
+typedef UINT (WINAPI *TimePeriodFn)(UINT);
+
+static const char* setting_names[RT_SETTINGS] = {
+	"priority class", "thread priority", "mmcss", "timer", "affinity"
+};
+
+/** @brief a function of a system dll, NULL if the dll or the function is not there */
+static FARPROC system_proc(const char* dll, const char* name)
+{
+	HMODULE h = LoadLibraryA(dll);
+	return h ? GetProcAddress(h, name) : NULL;
+}
+
+static void result(RtProfile* p, int setting, BOOL ok)
+{
+	p->ok[setting] = ok ? 1 : -1;
+	p->error[setting] = ok ? 0 : GetLastError();
+}
+
+void rt_profile_defaults(RtProfileConfig* c)
+{
+	// realtime class would starve the disk and input threads of the OS
+	c->priority_class = HIGH_PRIORITY_CLASS;
+	c->thread_priority = THREAD_PRIORITY_TIME_CRITICAL;
+	c->set_thread_priority = 1;
+	c->mmcss_task = "Capture";
+	c->timer_ms = 1;
+	c->cpu = -1;
+}
+
+int rt_profile_apply(RtProfile* p, const RtProfileConfig* c)
+{
+	int i, failed = 0;
+
+	memset(p, 0, sizeof(*p));
+	p->cpu = -1;
+	p->thread = GetCurrentThread();
+
+	if(c->priority_class) {
+		p->old_priority_class = GetPriorityClass(GetCurrentProcess());
+		result(p, RT_PRIORITY_CLASS, SetPriorityClass(GetCurrentProcess(), c->priority_class));
+	}
+
+	if(c->set_thread_priority) {
+		p->old_thread_priority = GetThreadPriority(p->thread);
+		result(p, RT_THREAD_PRIORITY, SetThreadPriority(p->thread, c->thread_priority));
+	}
+
+	if(c->mmcss_task && c->mmcss_task[0]) {
+		AvSetMmThreadCharacteristicsFn set = (AvSetMmThreadCharacteristicsFn)
+			system_proc("avrt.dll", "AvSetMmThreadCharacteristicsA");
+		if(set) {
+			p->mmcss = set(c->mmcss_task, &p->mmcss_index);
+			result(p, RT_MMCSS, p->mmcss != NULL);
+		}
+		else {
+			result(p, RT_MMCSS, FALSE);
+		}
+	}
+
+	if(c->timer_ms) {
+		TimePeriodFn begin = (TimePeriodFn)system_proc("winmm.dll", "timeBeginPeriod");
+		// timeBeginPeriod returns TIMERR_NOERROR, 0, on success
+		if(begin && begin(c->timer_ms) == 0) {
+			p->timer_ms = c->timer_ms;
+			result(p, RT_TIMER, TRUE);
+		}
+		else {
+			SetLastError(ERROR_INVALID_PARAMETER);
+			result(p, RT_TIMER, FALSE);
+		}
+	}
+
+	if(c->cpu != -1) {
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		int cpu = (c->cpu == RT_LAST_CPU) ? (int)si.dwNumberOfProcessors - 1 : c->cpu;
+		if(cpu >= 0 && cpu < (int)si.dwNumberOfProcessors && cpu < (int)(8 * sizeof(DWORD_PTR))) {
+			p->old_affinity = SetThreadAffinityMask(p->thread, (DWORD_PTR)1 << cpu);
+			result(p, RT_AFFINITY, p->old_affinity != 0);
+			if(p->old_affinity) p->cpu = cpu;
+		}
+		else {
+			SetLastError(ERROR_INVALID_PARAMETER);
+			result(p, RT_AFFINITY, FALSE);
+		}
+	}
+
+	for(i = 0; i < RT_SETTINGS; i++) {
+		if(p->ok[i] < 0) failed++;
+	}
+	return failed;
+}
+
+void rt_profile_report(const RtProfile* p, FILE* out)
+{
+	for(int i = 0; i < RT_SETTINGS; i++) {
+		if(p->ok[i] == 0) {
+			fprintf(out, "rt profile: %-16s not asked for\n", setting_names[i]);
+		}
+		else if(p->ok[i] > 0) {
+			if(i == RT_TIMER) fprintf(out, "rt profile: %-16s %u ms\n", setting_names[i], p->timer_ms);
+			else if(i == RT_AFFINITY) fprintf(out, "rt profile: %-16s cpu %d\n", setting_names[i], p->cpu);
+			else fprintf(out, "rt profile: %-16s ok\n", setting_names[i]);
+		}
+		else {
+			fprintf(out, "rt profile: %-16s FAILED, error %lu\n", setting_names[i], (unsigned long)p->error[i]);
+		}
+	}
+}
+
+void rt_profile_revert(RtProfile* p)
+{
+	if(p->ok[RT_AFFINITY] > 0) {
+		SetThreadAffinityMask(p->thread, p->old_affinity);
+	}
+	if(p->ok[RT_TIMER] > 0) {
+		TimePeriodFn end = (TimePeriodFn)system_proc("winmm.dll", "timeEndPeriod");
+		if(end) end(p->timer_ms);
+	}
+	if(p->ok[RT_MMCSS] > 0) {
+		AvRevertMmThreadCharacteristicsFn revert = (AvRevertMmThreadCharacteristicsFn)
+			system_proc("avrt.dll", "AvRevertMmThreadCharacteristics");
+		if(revert) revert(p->mmcss);
+	}
+	if(p->ok[RT_THREAD_PRIORITY] > 0) {
+		SetThreadPriority(p->thread, p->old_thread_priority);
+	}
+	if(p->ok[RT_PRIORITY_CLASS] > 0) {
+		SetPriorityClass(GetCurrentProcess(), p->old_priority_class);
+	}
+	memset(p->ok, 0, sizeof(p->ok));
+}
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "TracePoint.h"
+
+#if defined(__QNX__)
+	#include <errno.h>
+	#include <pthread.h>
+	#include <unistd.h>
+	#include <atomic.h>
+	#include <sys/neutrino.h>
+	#include <sys/syspage.h>
+	#define TRACE_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+	#include <windows.h>
+	#include <intrin.h>
+	#define TRACE_BARRIER() _ReadWriteBarrier()
+#endif
+
+#define TRACE_MAGIC "TRCP"
+#define TRACE_VERSION 1
+/** @brief the most threads that can record trace points */
+#define TRACE_RINGS 16
+/** @brief trace points per thread between flushes, must be a power of two */
+#define TRACE_RING_LEN 4096
+#define TRACE_RING_MASK (TRACE_RING_LEN - 1)
+#define TRACE_FLUSH_MS 10
+#define NO_RING ((TraceRing*) -1)
+
+struct TraceEvent {
+	unsigned int id;
+	trace_tsc_t tsc;
+};
+
+/**
+* @brief a single-producer/single-consumer ring of trace points
+*
+* only the owning thread writes tail and only the flush thread writes head.
+*/
+struct TraceRing {
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	volatile unsigned int dropped;
+	TraceEvent events[TRACE_RING_LEN];
+};
+
+static TraceRing rings[TRACE_RINGS];
+static volatile unsigned int nrings = 0;
+static volatile int running = 0;
+static FILE* out = NULL;
+
+#if defined(__QNX__)
+static pthread_t flusher;
+static pthread_key_t ring_key;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+
+static void makeRingKey()
+{
+	pthread_key_create(&ring_key, NULL);
+}
+
+static inline trace_tsc_t now()
+{
+	return ClockCycles();
+}
+
+static trace_tsc_t cyclesPerSec()
+{
+	return SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+}
+
+/** @brief returns the calling thread's ring, claiming one on the first call */
+static inline TraceRing* threadRing()
+{
+	TraceRing* ring;
+	unsigned int slot;
+
+	pthread_once(&ring_once, makeRingKey);
+	ring = (TraceRing*) pthread_getspecific(ring_key);
+	if(ring == NULL) {
+		slot = atomic_add_value(&nrings, 1);
+		ring = (slot < TRACE_RINGS) ? rings + slot : NO_RING;
+		pthread_setspecific(ring_key, ring);
+	}
+
+	return ring;
+}
+#else
+static HANDLE flusher = NULL;
+static __declspec(thread) TraceRing* thread_ring = NULL;
+
+static inline trace_tsc_t now()
+{
+	return __rdtsc();
+}
+
+/** @brief the TSC has no documented rate on Windows, so measure it */
+static trace_tsc_t cyclesPerSec()
+{
+	LARGE_INTEGER freq, start, stop;
+	trace_tsc_t tsc;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&start);
+	tsc = now();
+	Sleep(50);
+	QueryPerformanceCounter(&stop);
+	tsc = now() - tsc;
+
+	return (trace_tsc_t) ((double) tsc * freq.QuadPart / (stop.QuadPart - start.QuadPart));
+}
+
+/** @brief returns the calling thread's ring, claiming one on the first call */
+static inline TraceRing* threadRing()
+{
+	unsigned int slot;
+
+	if(thread_ring == NULL) {
+		slot = InterlockedIncrement((volatile LONG*) &nrings) - 1;
+		thread_ring = (slot < TRACE_RINGS) ? rings + slot : NO_RING;
+	}
+
+	return thread_ring;
+}
+#endif
+
+/** @brief writes the trace points in every ring to the trace file */
+static void drain()
+{
+	unsigned int i, n, head, tail;
+	TraceRecord rec;
+
+	n = (nrings < TRACE_RINGS) ? nrings : TRACE_RINGS;
+	for(i = 0; i < n; i++) {
+		head = rings[i].head;
+		tail = rings[i].tail;
+		TRACE_BARRIER();
+
+		rec.thread = i;
+		for(; head != tail; head++) {
+			rec.id = rings[i].events[head & TRACE_RING_MASK].id;
+			rec.tsc = rings[i].events[head & TRACE_RING_MASK].tsc;
+			fwrite(&rec, sizeof(rec), 1, out);
+		}
+
+		TRACE_BARRIER();
+		rings[i].head = head;
+	}
+}
+
+#if defined(__QNX__)
+static void* flush(void*)
+#else
+static DWORD WINAPI flush(LPVOID)
+#endif
+{
+	while(running) {
+		drain();
+#if defined(__QNX__)
+		delay(TRACE_FLUSH_MS);
+#else
+		Sleep(TRACE_FLUSH_MS);
+#endif
+	}
+
+	return 0;
+}
+
+/**
+* @brief starts the flush thread writing to file
+*
+* The trace points recorded before the call are kept in the rings and written
+* out with the first flush.
+*
+* @return 0 on success, -1 if the file or the thread could not be created
+*/
+
+int trace_start(const char* file)
+{
+	TraceFileHeader hdr;
+
+	if(running) {
+		return 0;
+	}
+
+	out = fopen(file, "wb");
+	if(out == NULL) {
+		printf("trace_start: could not open %s\n", file);
+		return -1;
+	}
+
+	memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = TRACE_VERSION;
+	hdr.record_size = sizeof(TraceRecord);
+	hdr.cycles_per_sec = cyclesPerSec();
+	fwrite(&hdr, sizeof(hdr), 1, out);
+
+	running = 1;
+#if defined(__QNX__)
+	if(pthread_create(&flusher, NULL, flush, NULL) != EOK) {
+#else
+	flusher = CreateThread(NULL, 0, flush, NULL, 0, NULL);
+	if(flusher == NULL) {
+#endif
+		printf("trace_start: could not create the flush thread\n");
+		running = 0;
+		fclose(out);
+		out = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+* @brief records trace point id for the calling thread
+*
+* If the calling thread's ring is full the point is dropped and counted, the
+* hot path never waits on the flush thread.
+*/
+
+void trace_point(unsigned int id)
+{
+	unsigned int tail;
+	TraceRing* ring = threadRing();
+
+	if(ring == NO_RING) {
+		return;
+	}
+
+	tail = ring->tail;
+	if(tail - ring->head >= TRACE_RING_LEN) {
+		ring->dropped++;
+		return;
+	}
+
+	ring->events[tail & TRACE_RING_MASK].id = id;
+	ring->events[tail & TRACE_RING_MASK].tsc = now();
+	TRACE_BARRIER();
+	ring->tail = tail + 1;
+}
+
+/** @brief stops the flush thread after draining every ring */
+void trace_stop()
+{
+	if(!running) {
+		return;
+	}
+
+	running = 0;
+#if defined(__QNX__)
+	pthread_join(flusher, NULL);
+#else
+	WaitForSingleObject(flusher, INFINITE);
+	CloseHandle(flusher);
+#endif
+
+	drain();
+	fclose(out);
+	out = NULL;
+}
+
+/** @brief the number of trace points dropped because a ring was full */
+unsigned int trace_dropped()
+{
+	unsigned int i, n, dropped = 0;
+
+	n = (nrings < TRACE_RINGS) ? nrings : TRACE_RINGS;
+	for(i = 0; i < n; i++) {
+		dropped += rings[i].dropped;
+	}
+
+	return dropped;
+}
@@ -1,8 +1,14 @@
+#include <algorithm>
 #include <fstream>
 #include "Dots.h"
 #include "Camera.h"
+#include "DotsPublisher.h"
+#include "ResultBus.h"
 #include "Tracker.h"
 #include "TrackingAlg.h"
+#include "TracePoint.h"
+#include "PmcProfile.h"
+#include "WorkerPool.h"
 
 #define UPDATE 1
 #define INTERKEY 1000
@@ -16,52 +22,302 @@ using cv::Point2d;
 using cv::Scalar;
 
 Tracker::Tracker()
+	: _alg(NULL), _pool(NULL), _publisher(NULL), _bus(NULL), _det_thresh(-1),
+	_det_type(CV_THRESH_BINARY), _det_min_area(4), _det_max_size(64)
 {
 
 }
 
 Tracker::Tracker(TrackingAlg& alg)
+	: _pool(NULL), _publisher(NULL), _bus(NULL), _det_thresh(-1),
+	_det_type(CV_THRESH_BINARY), _det_min_area(4), _det_max_size(64)
 {
 	algorithm(alg);
 }
 
+Tracker::~Tracker()
+{
+	delete _pool;
+}
+
 /** @brief sets the new tracking algorithm */
 void Tracker::algorithm(TrackingAlg& alg)
 {
 	_alg = &alg;
 }
 
+/**
+* Tracks the dot tag with alg instead of the algorithm every other dot is
+* tracked with, so dots can be located differently, e.g., with a TrackDot
+* of another method or threshold.  The tracker does not own alg.
+*
+* @param[in] alg the algorithm of the dot
+* @param[in] tag the dot
+*/
+void Tracker::algorithm(TrackingAlg& alg, int tag)
+{
+	if(tag < 0) {
+		return;
+	}
+	if(static_cast<size_t> (tag) >= _dot_algs.size()) {
+		_dot_algs.resize(tag + 1, NULL);
+	}
+	_dot_algs[tag] = &alg;
+}
+
+void Tracker::defaultAlgorithm(int tag)
+{
+	if(tag >= 0 && static_cast<size_t> (tag) < _dot_algs.size()) {
+		_dot_algs[tag] = NULL;
+	}
+}
+
+TrackingAlg& Tracker::algorithmOf(int tag) const
+{
+	if(tag >= 0 && static_cast<size_t> (tag) < _dot_algs.size() && _dot_algs[tag] != NULL) {
+		return *_dot_algs[tag];
+	}
+
+	return *_alg;
+}
+
+/**
+* Splits the active dots over threads threads for every following track().
+* The dots are split into fixed, contiguous parts, so every dot is always
+* tracked by the same thread and the results do not depend on the threads.
+* The tracking algorithm's find() is called from several threads at the same
+* time and must not change any state shared between dots.
+*
+* @param[in] threads the number of threads, WorkerPool::cores() to use every
+*	processor and 1 (or less) to track serially
+*/
+void Tracker::parallel(int threads)
+{
+	delete _pool;
+	_pool = NULL;
+
+	if(threads > 1) {
+		_pool = new WorkerPool(threads);
+	}
+}
+
+/**
+* Hands the dots to pub at the end of every following track(), which copies
+* the active dots into its ring and returns; its thread sends them.  The
+* tracker does not own pub, which must stay open while it is set.
+*
+* @param[in] pub the publisher, NULL to stop publishing
+*/
+void Tracker::publisher(DotsPublisher* pub)
+{
+	_publisher = pub;
+}
+
+/**
+* Publishes the dots to bus at the end of every following track(), where
+* any number of readers copy them at their own pace.  The tracker does not
+* own bus, which must stay open while it is set.
+*
+* @param[in] bus the bus, NULL to stop publishing
+*/
+void Tracker::bus(ResultBus* bus)
+{
+	_bus = bus;
+}
+
+bool Tracker::trackDot(const ImageView& img, Camera& cam, Dots& dots, int tag)
+{
+	//dots.found(tag) = _alg->find_pbu(img, dots[tag], dots.pixel(tag), dots.area(tag)); // this does not give an error when the dots are even not tracked.
+	PMC_SAMPLE(pmc);
+
+	PMC_BEGIN(pmc);
+	dots.found(tag) = algorithmOf(tag).find(img, dots[tag], dots.pixel(tag), dots.area(tag));
+	PMC_END(PMC_FIND, tag, pmc);
+	dots.worldFrom(tag, cam);
+	if(dots.found(tag)) {
+		dots.record(tag);
+	}
+
+	//dots.area(tag) = 2; // added for checking the number of detected pixels.  may not be necessary later.
+
+	return dots.found(tag);
+}
+
+/**
+* Tracks the active dots [part * n / parts, (part + 1) * n / parts).  Every
+* dot only writes its own Dot and every part its own found flag, so the parts
+* never write the same memory.
+*/
+void Tracker::trackPart(void* ctx, int part, int parts)
+{
+	TrackJob* job = static_cast<TrackJob*> (ctx);
+	int n = static_cast<int> (job->active->size());
+	int i, start = part * n / parts, stop = (part + 1) * n / parts;
+	bool found_all = true;
+
+	for(i = start; i < stop; ++i) {
+		if(!job->tracker->trackDot(*job->img, *job->cam, *job->dots, (*job->active)[i]->tag())) {
+			found_all = false;
+		}
+	}
+
+	job->found[part] = found_all;
+}
+
 bool Tracker::track(Camera& cam, Dots& dots)
 {
-	int tag;
+	int i;
 	bool found_all;
 	Mat img;
 	ActiveDots::const_iterator dot, stop;
 
+	TRACE_POINT(TRACE_TRACK_START);
 	found_all = true;
 	if(!cam.retrieve(img)) {
+		TRACE_POINT(TRACE_TRACK_STOP);
 		return false;
 	}
+	ImageView view = cam.view(img);
 
 	// track dots in the active set
 	ActiveDots& a = dots.activeDots();
-	for(dot = a.begin(), stop = a.end(); dot < stop; ++dot) {
-		tag = (*dot)->tag();
-		//dots.found(tag) = _alg->find_pbu(img, dots[tag], dots.pixel(tag), dots.area(tag)); // this does not give an error when the dots are even not tracked.
-		dots.found(tag) = _alg->find(img, dots[tag], dots.pixel(tag), dots.area(tag));
-		dots.world(tag) = cam.pixelToWorld(dots.pixel(tag));
+	_alg->reserve(static_cast<int> (dots._dots.size()));
+	for(i = 0; i < static_cast<int> (_dot_algs.size()); ++i) {
+		if(_dot_algs[i] != NULL) {
+			_dot_algs[i]->reserve(static_cast<int> (dots._dots.size()));
+		}
+	}
+	if(_pool != NULL && a.size() > 1) {
+		TrackJob job;
+		job.tracker = this;
+		job.img = &view;
+		job.cam = &cam;
+		job.dots = &dots;
+		job.active = &a;
+		job.found.assign(_pool->size(), true);
+
+		_pool->run(trackPart, &job);
+		for(i = 0; i < _pool->size(); ++i) {
+			if(!job.found[i]) {
+				found_all = false;
+			}
+		}
+	}
+	else {
+		for(dot = a.begin(), stop = a.end(); dot < stop; ++dot) {
+			if(!trackDot(view, cam, dots, (*dot)->tag())) {
+				found_all = false;
+			}
+		}
+	}
 
-		//dots.area(tag) = 2; // added for checking the number of detected pixels.  may not be necessary later.
+	if(_publisher != NULL) {
+		_publisher->publish(dots);
+	}
+	if(_bus != NULL) {
+		_bus->publish(dots);
+	}
+
+	TRACE_POINT(TRACE_TRACK_STOP);
+	return found_all;
+}
+
+bool Tracker::blobOrder(const Blob& a, const Blob& b)
+{
+	return a.center.y < b.center.y;
+}
+
+bool Tracker::blobAbove(const Blob& a, double y)
+{
+	return a.center.y < y;
+}
+
+/**
+* Tracks the active dots of a full image without their tracking
+* algorithms.  track(...) thresholds the rectangle of every dot on its
+* own, so when hundreds of dots are close together the same pixels are
+* thresholded and searched once for every rectangle they are in.  This
+* thresholds the image once, in bands of rows on the threads of
+* parallel(...), and keeps only the center and area of every blob, see
+* detection(...); every dot is then given the nearest blob within the
+* largest blob size of where its track predicts it, in the order of the
+* active set.
+*
+* A dot is located at the centroid of its blob, like the MOMENTS method of
+* a TrackDot, and dots that are closer than a blob size may be swapped, so
+* this is for images whose dots are small and apart.
+*
+* @return true, if every active dot was found
+*/
+bool Tracker::trackFrame(Camera& cam, Dots& dots)
+{
+	int tag;
+	size_t i, j, best;
+	bool found_all = true;
+	double d, nearest, max2 = static_cast<double> (_det_max_size) * _det_max_size;
+	Mat img;
+	Point2d pred;
+	std::vector<Blob> blobs;
+	std::vector<char> used;
+	std::vector<Blob>::const_iterator b;
+
+	TRACE_POINT(TRACE_TRACK_START);
+	if(!cam.retrieve(img) || img.empty()) {
+		TRACE_POINT(TRACE_TRACK_STOP);
+		return false;
+	}
+	ImageView view = cam.view(img);
+
+	findBlobs(img, view, _pool, blobs);
+	std::sort(blobs.begin(), blobs.end(), blobOrder);
+	used.assign(blobs.size(), 0);
+
+	ActiveDots& a = dots.activeDots();
+	for(i = 0; i < a.size(); ++i) {
+		tag = a[i]->tag();
+		pred = a[i]->predictPixel(dots.timeStamp(tag));
+
+		// only the blobs in the rows of the dot's search square
+		best = blobs.size();
+		nearest = max2;
+		b = std::lower_bound(blobs.begin(), blobs.end(), pred.y - _det_max_size, blobAbove);
+		for(; b != blobs.end() && b->center.y <= pred.y + _det_max_size; ++b) {
+			j = b - blobs.begin();
+			Point2d p = b->center - pred;
+			d = p.x * p.x + p.y * p.y;
+			if(!used[j] && d < nearest) {
+				nearest = d;
+				best = j;
+			}
+		}
 
-		if(!dots.found(tag)) {
+		dots.found(tag) = best < blobs.size();
+		if(dots.found(tag)) {
+			used[best] = 1;
+			dots.pixel(tag) = blobs[best].center;
+			dots.area(tag) = blobs[best].area;
+			dots.worldFrom(tag, cam);
+			dots.record(tag);
+		}
+		else {
 			found_all = false;
 		}
 	}
 
+	TRACE_POINT(TRACE_TRACK_STOP);
 	return found_all;
 }
 
-/** @brief initialize dots based on information found in a file */
+/**
+* Initializes dots based on information found in a file.  Every line of the
+* file is the location "x y [z]" of a dot, the i-th line the dot with tag i,
+* and x, y set the pixel location of the dot, its world location follows
+* from the camera.  The dots are not found until they were tracked or
+* located, see location(...), so the file can hold the layout of the dots
+* location(...) looks for.  Empty lines are skipped.
+*
+* @return the number of locations read, or 0 if the file could not be read
+*/
 int Tracker::load(Camera& cam, Dots& dots, const string& file)
 {
 	int i;
@@ -77,6 +333,9 @@ int Tracker::load(Camera& cam, Dots& dots, const string& file)
 	i = 0;
 	while(!f.eof()) {
 		std::getline(f, line);
+		if(line.empty())
+			continue;
+
 		size_t pos1 = line.find(' ');
 		size_t pos2 = line.find(' ',  pos1 + 1);
 
@@ -88,11 +347,12 @@ int Tracker::load(Camera& cam, Dots& dots, const string& file)
 		sx = line.substr(0, pos1);
 		sy = line.substr(pos1 + 1, pos2 - pos1 - 1);
 		if(pos2 == line.size())
-			sz == "";
+			sz = "";
 		else
 			sz = line.substr(pos2 + 1, line.size() - pos2 - 1);
 
-		// read in x value
+		// read in x value, a missing z of the last line must not fail this one
+		ss.clear();
 		ss.str(sx);
 		ss.seekg(0);
 		ss >> x;
@@ -113,6 +373,11 @@ int Tracker::load(Camera& cam, Dots& dots, const string& file)
 
 		// set the corresponding dot's location
 		//world.push_back(Point3f(x, y , 0));
+		if(i < dots.size()) {
+			dots.pixel(i) = Point2d(x, y);
+			dots.worldFrom(i, cam);
+			dots.found(i) = false;
+		}
 		++i;
 	}
 
@@ -121,9 +386,275 @@ int Tracker::load(Camera& cam, Dots& dots, const string& file)
 }
 
 /** @brief initialize dots based on their pixel location */
+/**
+* Sets how location(...) finds blobs.  The image is binarized with
+* cv::threshold(..., thresh, 255, type), so dark dots on a bright
+* background need CV_THRESH_BINARY_INV, and a blob is every connected
+* component of at least min_area pixels that is at most max_size pixels
+* wide and high.  A negative thresh takes the Otsu threshold of the image.
+*
+* @param[in] thresh the threshold, or negative for the Otsu threshold
+* @param[in] type CV_THRESH_BINARY or CV_THRESH_BINARY_INV
+* @param[in] min_area the fewest pixels of a blob
+* @param[in] max_size the largest width and height of a blob, also how far a
+*	blob may be from where its dot is expected
+*/
+void Tracker::detection(double thresh, int type, int min_area, int max_size)
+{
+	_det_thresh = thresh;
+	_det_type = type;
+	_det_min_area = std::max(min_area, 1);
+	_det_max_size = std::max(max_size, 1);
+}
+
+/**
+* Finds the blobs whose top row is in the band of rows
+* [part * rows / parts, (part + 1) * rows / parts).  The band is binarized
+* with one row above it, so a blob that comes from the band above is seen
+* to start there, and max_size rows below it, so every blob small enough
+* is whole.  Every blob is found by exactly one band.
+*/
+void Tracker::detectPart(void* ctx, int part, int parts)
+{
+	DetectJob* job = static_cast<DetectJob*> (ctx);
+	const Mat& gray = *job->gray;
+	int start = part * gray.rows / parts, stop = (part + 1) * gray.rows / parts;
+	int top = std::max(start - 1, 0), bottom = std::min(stop + job->max_size, gray.rows);
+	std::vector<std::vector<cv::Point> > contours;
+	std::vector<Blob>& blobs = job->blobs[part];
+	Mat bin, edges;
+	Blob b;
+
+	blobs.clear();
+	if(start >= stop) {
+		return;
+	}
+
+	cv::threshold(gray.rowRange(top, bottom), bin, job->thresh, 255, job->type);
+	// findContours draws on its input
+	edges = bin.clone();
+	cv::findContours(edges, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE);
+
+	for(size_t i = 0; i < contours.size(); ++i) {
+		cv::Rect r = cv::boundingRect(Mat(contours[i]));
+		if(r.y + top < start || r.y + top >= stop ||
+			r.width > job->max_size || r.height > job->max_size) {
+			continue;
+		}
+
+		// the pixels of the blob, not the area inside its outline
+		cv::Moments m = cv::moments(bin(r), true);
+		if(m.m00 < job->min_area) {
+			continue;
+		}
+
+		b.center = Point2d(r.x + m.m10 / m.m00, r.y + top + m.m01 / m.m00);
+		b.area = static_cast<int> (m.m00);
+		blobs.push_back(b);
+	}
+}
+
+/**
+* Finds the blobs of img, see detection(...), in as many bands of rows as
+* pool has threads.  The centers are in the image frame of view.
+*/
+void Tracker::findBlobs(const Mat& img, const ImageView& view, WorkerPool* pool,
+	std::vector<Blob>& blobs) const
+{
+	size_t i, j;
+	Mat gray, tmp;
+	DetectJob job;
+
+	if(img.channels() == 3) {
+		cv::cvtColor(img, gray, CV_BGR2GRAY);
+	}
+	else {
+		gray = img;
+	}
+
+	job.gray = &gray;
+	job.type = _det_type;
+	job.min_area = _det_min_area;
+	job.max_size = _det_max_size;
+	job.thresh = _det_thresh;
+	if(job.thresh < 0) {
+		job.thresh = cv::threshold(gray, tmp, 0, 255, _det_type | CV_THRESH_OTSU);
+	}
+
+	if(pool != NULL) {
+		job.blobs.resize(pool->size());
+		pool->run(detectPart, &job);
+	}
+	else {
+		job.blobs.resize(1);
+		detectPart(&job, 0, 1);
+	}
+
+	blobs.clear();
+	for(i = 0; i < job.blobs.size(); ++i) {
+		for(j = 0; j < job.blobs[i].size(); ++j) {
+			job.blobs[i][j].center += Point2d(view.offset.x, view.offset.y);
+			blobs.push_back(job.blobs[i][j]);
+		}
+	}
+}
+
+/**
+* Tries the offsets that put one of the first dots of the layout on a
+* blob and returns the one that lines up the most dots with a blob within
+* tol, the smallest squared distances breaking ties.  The layout is where
+* the dots were last, or where load(...) put them, so a small move of the
+* whole set of dots or of the camera is taken out before matching.
+*/
+Point2d Tracker::alignLayout(const std::vector<Blob>& blobs, const std::vector<Point2d>& layout,
+	double tol)
+{
+	size_t i, j, k, anchors = std::min<size_t> (layout.size(), 3);
+	int n, best_n = -1;
+	double d, nearest, err, best_err = 0, tol2 = tol * tol;
+	Point2d off, best(0, 0);
+
+	for(k = 0; k <= anchors * blobs.size(); ++k) {
+		// no offset, then every anchor on every blob
+		off = Point2d(0, 0);
+		if(k > 0) {
+			off = blobs[(k - 1) % blobs.size()].center - layout[(k - 1) / blobs.size()];
+		}
+
+		n = 0;
+		err = 0;
+		for(i = 0; i < layout.size(); ++i) {
+			nearest = tol2;
+			for(j = 0; j < blobs.size(); ++j) {
+				Point2d p = blobs[j].center - layout[i] - off;
+				d = p.x * p.x + p.y * p.y;
+				if(d < nearest) {
+					nearest = d;
+				}
+			}
+			if(nearest < tol2) {
+				++n;
+				err += nearest;
+			}
+		}
+
+		if(n > best_n || (n == best_n && err < best_err)) {
+			best_n = n;
+			best_err = err;
+			best = off;
+		}
+	}
+
+	return best;
+}
+
+/** @brief blobs in raster order, top to bottom and left to right */
+static bool rasterOrder(const Point2d& a, const Point2d& b)
+{
+	return (a.y < b.y) || (a.y == b.y && a.x < b.x);
+}
+
+/**
+* Initializes the active dots without a user, from the blobs of the whole
+* image instead of clicks, see click(...).  The image is split into bands
+* of rows that are searched for blobs at the same time, on the threads of
+* parallel(...) or on every processor if the tracker tracks serially, see
+* detection(...) for what a blob is.
+*
+* The active dots whose pixel location is set, e.g., by load(...) or by
+* the last time they were tracked, are the layout the blobs are matched
+* to: the whole layout is moved onto the blobs, see alignLayout(...), and
+* every dot is given the nearest blob within the largest blob size of its
+* moved location.  Without a layout the dots are given the blobs in raster
+* order.  Every dot is then found with its own tracking algorithm at its
+* blob, so it is located like it will be tracked.
+*
+* @return the number of active dots found
+*/
 int Tracker::location(Camera& cam, Dots& dots)
 {
-	return 0;
+	int tag, found;
+	size_t i, j, best;
+	double d, nearest, area;
+	Mat img;
+	Point2d off, loc;
+	WorkerPool* own = NULL;
+	std::vector<Blob> blobs;
+	std::vector<Point2d> layout, centers;
+	std::vector<int> tags;
+	std::vector<char> used;
+
+	if(!cam.retrieve(img) || img.empty()) {
+		return 0;
+	}
+	ImageView view = cam.view(img);
+
+	// a pool of its own only for the start of a session
+	if(_pool == NULL) {
+		own = new WorkerPool(WorkerPool::cores());
+	}
+	findBlobs(img, view, own ? own : _pool, blobs);
+	delete own;
+
+	ActiveDots& a = dots.activeDots();
+	for(i = 0; i < a.size(); ++i) {
+		tag = a[i]->tag();
+		dots.found(tag) = false;
+		if(dots.pixel(tag).x != BAD_LOC || dots.pixel(tag).y != BAD_LOC) {
+			layout.push_back(dots.pixel(tag));
+			tags.push_back(tag);
+		}
+	}
+
+	used.assign(blobs.size(), 0);
+	if(!layout.empty() && !blobs.empty()) {
+		off = alignLayout(blobs, layout, _det_max_size);
+		for(i = 0; i < layout.size(); ++i) {
+			best = blobs.size();
+			nearest = _det_max_size * _det_max_size;
+			for(j = 0; j < blobs.size(); ++j) {
+				Point2d p = blobs[j].center - layout[i] - off;
+				d = p.x * p.x + p.y * p.y;
+				if(!used[j] && d < nearest) {
+					nearest = d;
+					best = j;
+				}
+			}
+			if(best < blobs.size()) {
+				used[best] = 1;
+				dots.pixel(tags[i]) = blobs[best].center;
+				dots.found(tags[i]) = true;
+			}
+		}
+	}
+	else if(layout.empty()) {
+		for(i = 0; i < blobs.size(); ++i) {
+			centers.push_back(blobs[i].center);
+		}
+		std::sort(centers.begin(), centers.end(), rasterOrder);
+		for(i = 0; i < a.size() && i < centers.size(); ++i) {
+			tag = a[i]->tag();
+			dots.pixel(tag) = centers[i];
+			dots.found(tag) = true;
+		}
+	}
+
+	// locate every dot like it will be tracked
+	found = 0;
+	for(i = 0; i < a.size(); ++i) {
+		tag = a[i]->tag();
+		if(dots.found(tag)) {
+			dots.found(tag) = algorithmOf(tag).find(view, dots[tag], loc, area);
+			if(dots.found(tag)) {
+				dots.pixel(tag) = loc;
+				dots.area(tag) = area;
+				++found;
+			}
+		}
+		dots.worldFrom(tag, cam);
+	}
+
+	return found;
 }
 
 /** @brief initialize dots based on where the user clicks on screen */
@@ -209,7 +740,7 @@ void Tracker::draw(Camera& cam, Dots& dots, Mat& dst)
 
 		ActiveDots& a = dots.activeDots();
 		for(ActiveDots::const_iterator dot = a.begin(); dot < a.end(); ++dot) {
-			_alg->draw(src, *(*dot), dst);
+			algorithmOf((*dot)->tag()).draw(src, *(*dot), dst);
 		}
 	}
 }
@@ -272,7 +803,7 @@ void Tracker::ClickPoints::showScreen(TrackingAlg& alg)
 			dots->found(t) = alg.find(img, (*dots)[t], new_loc, area);
 			if(dots->found(t)) {
 				dots->pixel(t) = new_loc;
-				dots->world(t) = cam->pixelToWorld(new_loc);
+				dots->worldFrom(t, *cam);
 			}
 
 			// draw its updated position
@@ -303,7 +834,7 @@ void Tracker::ClickPoints::onMouse(int e, int x, int y, int flags, void* data)
 		int tag = cp->tag;
 		cp->dots->found(tag) = true;
 		cp->dots->pixel(tag) = Point2d(x, y);
-		cp->dots->world(tag) = cp->cam->pixelToWorld(cp->dots->pixel(tag));
+		cp->dots->worldFrom(tag, *cp->cam);
 		if ( cp->dots->isDotActive(tag+1) ) (cp->tag)++; /// For automatic numbering, by Ji-Chul
 	}
 	else if(e == CV_EVENT_MOUSEMOVE) {
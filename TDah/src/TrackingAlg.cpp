@@ -16,6 +16,20 @@ TrackingAlg::~TrackingAlg()
 	return;
 }
 
+/**
+* Called by Tracker::track(...) before any dot is searched for, with the number
+* of dots (active or not), so an algorithm can keep state for every dot by its
+* tag.  find(...) may be called for several dots at the same time, but never
+* twice for one dot, so the state of a dot needs no locking.
+*
+* @param[in] dots the number of dots
+*/
+
+void TrackingAlg::reserve(int dots)
+{
+	return;
+}
+
 /**
 * Searches for a dot in the current image based on the previous known location
 * of the dot and, if the dot is found, updates the new location.
@@ -31,6 +45,31 @@ bool TrackingAlg::find(const Mat& img, const Dot& dot, Point2d& new_loc, double&
 {
 	return false;
 }
+
+/**
+* Searches for a dot in a view of the current image, whose offset places it
+* in the image frame the dots are in.  An algorithm that only implements
+* find(const Mat&, ...) is handed a Mat header of the view and its new
+* location is moved by the offset of the view.
+*
+* @param[in] img the view of the current image
+* @param[in] dot the dot to find
+* @param[out] new_loc the new location of the dot in the image frame
+* @param[out] area the size of the dot
+* @return true, if the dot is found and <code> new_loc </code> contains the new
+* location, false otherwise.
+*/
+
+bool TrackingAlg::find(const ImageView& img, const Dot& dot, Point2d& new_loc, double& area)
+{
+	if(!find(img.mat(), dot, new_loc, area)) {
+		return false;
+	}
+
+	new_loc.x += img.offset.x;
+	new_loc.y += img.offset.y;
+	return true;
+}
 bool TrackingAlg::find_pbu(const Mat& img, const Dot& dot, Point2d& new_loc, double& area)
 {
 	return false;
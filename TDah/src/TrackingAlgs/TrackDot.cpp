@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <highgui.h>
 #include "Dot.h"
 #include "TrackingAlgs/TrackDot.h"
@@ -10,7 +11,25 @@
 #include <sstream>
 #include <string>
 
+#if defined(__SSE2__) || defined(_M_IX86) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define TRACKDOT_SSE2 1
+#else
+	#define TRACKDOT_SSE2 0
+#endif
+
 #define WHITE 255
+/** @brief the fixed point weights cvtColor(..., CV_BGR2GRAY) uses for 8-bit images */
+#define GRAY_SHIFT 14
+#define GRAY_B 1868
+#define GRAY_G 9617
+#define GRAY_R 4899
+/**
+* @brief the sides of the square tracking rectangles the binary kernels are compiled
+* for, so their rows have a fixed length the compiler can unroll
+*/
+#define FIXED_SIDES 5
+static const int fixed_sides[FIXED_SIDES] = {16, 32, 40, 64, 128};
 #define LOC_COLOR Scalar(255, 0, 0)
 #define TAG_COLOR Scalar(0, 165, 255)
 
@@ -26,7 +45,35 @@ using cv::Rect;
 using cv::Size;
 using cv::Scalar;
 
+/**
+* @brief the value cv::threshold(...) gives pixel v of an 8-bit image for
+* threshold t and white WHITE, one specialization per threshold type
+*/
+template<int TYPE> struct Thresh;
+
+template<> struct Thresh<CV_THRESH_BINARY> {
+	static int at(int v, int t) { return v > t ? WHITE : 0; }
+};
+
+template<> struct Thresh<CV_THRESH_BINARY_INV> {
+	static int at(int v, int t) { return v > t ? 0 : WHITE; }
+};
+
+template<> struct Thresh<CV_THRESH_TRUNC> {
+	static int at(int v, int t) { return v > t ? t : v; }
+};
+
+template<> struct Thresh<CV_THRESH_TOZERO> {
+	static int at(int v, int t) { return v > t ? v : 0; }
+};
+
+template<> struct Thresh<CV_THRESH_TOZERO_INV> {
+	static int at(int v, int t) { return v > t ? 0 : v; }
+};
+
 TrackDot::TrackDot(int roi_width, int roi_height, int threshold_type)
+	: _method(CIRCLE), _channel(GRAY), _refine(false),
+	_code(NO_CODE)
 {
 	set(roi_width, roi_height, 0, threshold_type, 0, 
 		std::min(roi_width, roi_height) / 2);
@@ -34,6 +81,8 @@ TrackDot::TrackDot(int roi_width, int roi_height, int threshold_type)
 
 TrackDot::TrackDot(int roi_width, int roi_height, int threshold_type, 
 				   int threshold, double min_radius, double max_radius)
+	: _method(CIRCLE), _channel(GRAY), _refine(false),
+	_code(NO_CODE)
 {
 	set(roi_width, roi_height, threshold, 
 		threshold_type, min_radius, max_radius);
@@ -45,8 +94,16 @@ TrackDot::~TrackDot()
 
 }
 
+/**
+* Sets all dot tracking parameters.
+*
+* @param[in] fit how the circle is fit to the boundary pixels, one of fits
+* @param[in] step fit only every step-th boundary pixel, 1 fits all of them.
+*	Large dots have hundreds of boundary pixels, a few dozen fit as well.
+*/
 void TrackDot::set(int roi_width, int roi_height, int threshold, 
-				   int threshold_type, double min_radius, double max_radius)
+				   int threshold_type, double min_radius, double max_radius,
+				   int fit, int step)
 {
 	_click_window = "TrackDot";
 	_trackbar_window = "Threshold";
@@ -56,6 +113,196 @@ void TrackDot::set(int roi_width, int roi_height, int threshold,
 	_rh = roi_height;
 	_minr = min_radius;
 	_maxr = max_radius;
+	_fit = fit;
+	_step = std::max(step, 1);
+
+	// the kernels compiled for the rectangle, if there are any
+	_fixed = -1;
+	for(int i = 0; i < FIXED_SIDES; ++i) {
+		if(_rw == fixed_sides[i] && _rh == fixed_sides[i]) {
+			_fixed = i;
+		}
+	}
+
+	// the boundary buffers have to fit the new rectangle
+	for(size_t i = 0; i < _scratch.size(); ++i) {
+		_scratch[i].boundary.reserve(_rw * _rh);
+		_scratch[i].edge.reserve(_rw * _rh);
+		_scratch[i].residual.reserve(_rw * _rh);
+	}
+}
+
+/**
+* Makes sure every dot has its own scratch buffers.  The buffers are only
+* allocated the first time a dot is tracked or the tracking rectangle grows,
+* afterwards find() reuses them.
+*
+* @param[in] dots the number of dots
+*/
+void TrackDot::reserve(int dots)
+{
+	size_t i = _scratch.size();
+
+	if(static_cast<size_t> (dots) <= i) {
+		return;
+	}
+
+	_scratch.resize(dots);
+	for(; i < _scratch.size(); ++i) {
+		_scratch[i].pixel.create(_rh, _rw);
+		_scratch[i].boundary.reserve(_rw * _rh);
+		_scratch[i].edge.reserve(_rw * _rh);
+		_scratch[i].residual.reserve(_rw * _rh);
+		_scratch[i].measured = -1;
+		_scratch[i].identity = -1;
+	}
+}
+
+/**
+* Sets how find(...) locates a dot.  CIRCLE fits a circle to the boundary of
+* the dot (see set(...) for the fit), CENTROID takes the centroid of the
+* dot's pixels and MOMENTS the first moments of the thresholded rectangle,
+* which with CV_THRESH_TOZERO weights every pixel by its intensity.  A
+* Tracker can use a TrackDot of a different method for every dot.
+*
+* @param[in] m the method, one of methods
+*/
+void TrackDot::method(int m)
+{
+	_method = m;
+}
+
+int TrackDot::method() const
+{
+	return _method;
+}
+
+/**
+* Sets what color (CV_8UC3) images are thresholded on.  GRAY converts them
+* to gray scale like cvtColor(..., CV_BGR2GRAY), 0, 1 or 2 thresholds their
+* blue, green or red channel alone, which needs no conversion and separates
+* dots of one color from the background better.
+*
+* @param[in] c the channel, GRAY, 0, 1 or 2
+*/
+void TrackDot::channel(int c)
+{
+	_channel = (c >= 0 && c < 3) ? c : GRAY;
+}
+
+int TrackDot::channel() const
+{
+	return _channel;
+}
+
+/**
+* Sets whether the CIRCLE method refines the boundary before it keeps a
+* circle: the boundary pixels are moved to where the unthresholded image
+* crosses the threshold, a least squares circle is fit to them and the
+* points far off it are left out of a second fit, see refineCircle(...).
+* The fit of set(...) still has to pass the size filter, and stays when
+* the edge cannot be found.  Small dots and rectangles get a stable center
+* this way at the cost of a few samples per boundary pixel.
+*
+* @param[in] on true to refine the boundary
+*/
+void TrackDot::refine(bool on)
+{
+	_refine = on;
+}
+
+bool TrackDot::refine() const
+{
+	return _refine;
+}
+
+/**
+* Sets up identity-coded dots: markers of a few distinct sizes, or gray
+* levels, every one of which is given to one dot by identity(...).  find(...)
+* measures the class of every dot it finds, and reports a dot whose class is
+* not its identity as not found, so a dot that jumps onto the marker of
+* another one keeps its last location.  measuredClass(...) then says which
+* class was there and tagOfClass(...) whose marker it is, without matching the
+* lost dots to the blobs of the image.
+*
+* Class i holds the measures from bounds[i - 1] up to bounds[i], class 0 the
+* ones below bounds[0] and class bounds.size() the ones from the last bound
+* on.  SIZE_CODE measures the radius find(...) reports in area, in pixels.
+* INTENSITY_CODE measures the mean gray level of the pixels of the tracking
+* rectangle around the new location that pass the threshold, one more pass
+* over the rectangle per found dot.
+*
+* @param[in] c one of codes, NO_CODE measures nothing
+* @param[in] bounds the bounds between the classes, ascending
+*/
+void TrackDot::code(int c, const vector<double>& bounds)
+{
+	_code = (c == SIZE_CODE || c == INTENSITY_CODE) ? c : NO_CODE;
+	_bounds = bounds;
+	std::sort(_bounds.begin(), _bounds.end());
+	_class_tag.assign(_bounds.size() + 1, BAD_TAG);
+
+	for(size_t i = 0; i < _scratch.size(); ++i) {
+		_scratch[i].measured = -1;
+		if(_scratch[i].identity >= static_cast<int> (_class_tag.size())) {
+			_scratch[i].identity = -1;
+		}
+		else if(_scratch[i].identity >= 0) {
+			_class_tag[_scratch[i].identity] = static_cast<int> (i);
+		}
+	}
+}
+
+int TrackDot::code() const
+{
+	return _code;
+}
+
+/**
+* Gives a dot its identity class.  A class belongs to one dot at a time, the
+* dot that had it before has none after.
+*
+* @param[in] tag the tag of the dot
+* @param[in] cls the class, set up by code(...), or -1 for none
+*/
+void TrackDot::identity(int tag, int cls)
+{
+	if(tag < 0) {
+		return;
+	}
+	if(static_cast<size_t> (tag) >= _scratch.size()) {
+		reserve(tag + 1);
+	}
+	if(cls >= static_cast<int> (_class_tag.size())) {
+		cls = -1;
+	}
+
+	Scratch& s = _scratch[tag];
+	if(s.identity >= 0 && _class_tag[s.identity] == tag) {
+		_class_tag[s.identity] = BAD_TAG;
+	}
+	if(cls >= 0) {
+		if(_class_tag[cls] != BAD_TAG) {
+			_scratch[_class_tag[cls]].identity = -1;
+		}
+		_class_tag[cls] = tag;
+	}
+	s.identity = cls < 0 ? -1 : cls;
+}
+
+int TrackDot::identity(int tag) const
+{
+	return (tag >= 0 && static_cast<size_t> (tag) < _scratch.size()) ? _scratch[tag].identity : -1;
+}
+
+int TrackDot::measuredClass(int tag) const
+{
+	return (tag >= 0 && static_cast<size_t> (tag) < _scratch.size()) ? _scratch[tag].measured : -1;
+}
+
+int TrackDot::tagOfClass(int cls) const
+{
+	return (cls >= 0 && static_cast<size_t> (cls) < _class_tag.size()) ? _class_tag[cls] : BAD_TAG;
 }
 
 const string& TrackDot::clickingWindow()
@@ -84,10 +331,23 @@ Rect TrackDot::calcRoi(const Point2d& pixel, const Size& img_size) const
 	return Rect(x, y, _rw, _rh);
 }
 
+/**
+* Returns the view of the tracking rectangle calcRoi(...) gives for pixel,
+* a position in the image frame, inside the view of an image.
+*/
+
+ImageView TrackDot::trackingRect(const ImageView& img, const Point2d& pixel) const
+{
+	return img(calcRoi(Point2d(pixel.x - img.offset.x, pixel.y - img.offset.y), img.size()));
+}
+
 /**
 * Thresholds the source image and places it in the destination image.
 * The function will accept either gray scale images (CV_8UC1) or BGR
 * color images (CV_8UC3).  The output image will be gray scale (CV_8UC1).
+* A gray scale region is binarized straight out of the source image, a color
+* region is converted, see channel(...), and binarized in the same pass, and
+* dst keeps its buffer if it already has the size of the region.
 *
 * @param[in] src the source image
 * @param[in] roi the region-of-interest to grayscale
@@ -99,23 +359,653 @@ void TrackDot::threshold(const Mat& src, const Rect roi, Mat& dst) const
 	//Mat tdst;
 	// get 1-ch image subregion
 	if(src.type() == CV_8UC1) {
-		src(roi).copyTo(dst); // TODO do i really want to copy src into dst?
+		// binarize image
+		cv::threshold(src(roi), dst, _thr, WHITE, _thr_type);
+	}
+	else if(src.type() == CV_8UC3 && 
+		_thr_type >= CV_THRESH_BINARY && _thr_type <= CV_THRESH_TOZERO_INV) {
+		typedef void (TrackDot::*ColorFn)(const Mat&, const Rect, Mat&) const;
+		static const ColorFn fns[5] = {
+			&TrackDot::colorThreshold<CV_THRESH_BINARY>, &TrackDot::colorThreshold<CV_THRESH_BINARY_INV>,
+			&TrackDot::colorThreshold<CV_THRESH_TRUNC>, &TrackDot::colorThreshold<CV_THRESH_TOZERO>,
+			&TrackDot::colorThreshold<CV_THRESH_TOZERO_INV>
+		};
+
+		// convert and binarize image in one pass
+		(this->*fns[_thr_type])(src, roi, dst);
 	}
 	else if(src.type() == CV_8UC3) {
-		dst.create(_rh, _rw, CV_8UC1);
-		cv::cvtColor(src(roi), dst, CV_BGR2GRAY);
+		gray(src, roi, dst);
+
+		// binarize image
+		cv::threshold(dst, dst, _thr, WHITE, _thr_type);
 	}
 	else {
 		// raise an error, because image must be BGR, or grayscale
 		CV_Assert(src.type() == CV_8UC1 || src.type() == CV_8UC3);
 	}
-
-	// binarize image
-	cv::threshold(dst, dst, _thr, WHITE, _thr_type);
 	//cv::adaptiveThreshold(dst,tdst,WHITE,0,_thr_type,51,5);
 	//dst=tdst;
 }
 
+/**
+* Converts a color region-of-interest to gray scale exactly like
+* cvtColor(..., CV_BGR2GRAY), or copies its channel(...).
+*
+* @param[in] src the color (CV_8UC3) source image
+* @param[in] roi the region-of-interest to convert
+* @param[out] dst the gray scale (CV_8UC1) region
+*/
+
+void TrackDot::gray(const Mat& src, const Rect roi, Mat& dst) const
+{
+	int x, y;
+	const uchar* in;
+	uchar* out;
+
+	if(_channel == GRAY) {
+		cv::cvtColor(src(roi), dst, CV_BGR2GRAY);
+		return;
+	}
+
+	dst.create(roi.height, roi.width, CV_8UC1);
+	for(y = 0; y < roi.height; ++y) {
+		in = src.ptr<uchar>(roi.y + y) + 3 * roi.x + _channel;
+		out = dst.ptr<uchar>(y);
+		for(x = 0; x < roi.width; ++x) {
+			out[x] = in[3 * x];
+		}
+	}
+}
+
+/**
+* Thresholds a color region-of-interest with TYPE straight from its BGR
+* pixels, so the gray scale region is never written.  A pixel is converted
+* with the fixed point weights of cvtColor, or is its channel(...), so the
+* result is the same as converting and thresholding it.  SSE2 cannot spread
+* the three channels of a pixel into lanes, so the pass is scalar; it reads
+* the region once and writes the result once instead of twice each.
+*
+* @param[in] src the color (CV_8UC3) source image
+* @param[in] roi the region-of-interest to threshold
+* @param[out] dst the thresholded gray scale (CV_8UC1) region
+*/
+
+template<int TYPE>
+void TrackDot::colorThreshold(const Mat& src, const Rect roi, Mat& dst) const
+{
+	int x, y, v;
+	int t = _thr;
+	const uchar* in;
+	uchar* out;
+
+	dst.create(roi.height, roi.width, CV_8UC1);
+	for(y = 0; y < roi.height; ++y) {
+		in = src.ptr<uchar>(roi.y + y) + 3 * roi.x;
+		out = dst.ptr<uchar>(y);
+
+		if(_channel != GRAY) {
+			in += _channel;
+			for(x = 0; x < roi.width; ++x) {
+				out[x] = static_cast<uchar> (Thresh<TYPE>::at(in[3 * x], t));
+			}
+			continue;
+		}
+
+		for(x = 0; x < roi.width; ++x, in += 3) {
+			v = (in[0] * GRAY_B + in[1] * GRAY_G + in[2] * GRAY_R + 
+				(1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT;
+			out[x] = static_cast<uchar> (Thresh<TYPE>::at(v, t));
+		}
+	}
+}
+
+/**
+* Fits a circle to the boundary pixels with the fit chosen in set(...).  The
+* boundary is reordered and, if only every _step-th pixel is fit, shortened.
+* An enclosing circle cannot pass the size filter if the bounding box of the
+* pixels is already too large or too small for it, or for WELZL once the
+* circle of the pixels seen so far grows too large, so the fit stops early.
+*
+* @param[in,out] boundary the boundary pixels, not empty
+* @param[out] center the center of the circle
+* @param[out] radius the radius of the circle
+* @return false, if the circle cannot pass the size filter
+*/
+
+bool TrackDot::fitCircle(vector<Point>& boundary, Point2f& center, float& radius) const
+{
+	size_t i, j, k, n;
+	int minx, maxx, miny, maxy;
+	double cx, cy, r2, dx, dy, d;
+
+	// subsample and measure the bounding box
+	minx = maxx = boundary[0].x;
+	miny = maxy = boundary[0].y;
+	for(i = 0, n = 0; i < boundary.size(); i += _step, ++n) {
+		boundary[n] = boundary[i];
+		minx = std::min(minx, boundary[n].x);
+		maxx = std::max(maxx, boundary[n].x);
+		miny = std::min(miny, boundary[n].y);
+		maxy = std::max(maxy, boundary[n].y);
+	}
+	boundary.resize(n);
+
+	// the enclosing circle is at least as wide as the box and at most its diagonal
+	dx = maxx - minx;
+	dy = maxy - miny;
+	if(_fit != KASA && (std::max(dx, dy) / 2 >= _maxr || sqrt(dx * dx + dy * dy) / 2 <= _minr)) {
+		return false;
+	}
+
+	if(_fit == KASA) {
+		// collinear pixels are not a dot
+		if(!kasa(boundary, cx, cy, d)) {
+			return false;
+		}
+
+		center = Point2f(static_cast<float> (cx), static_cast<float> (cy));
+		radius = static_cast<float> (d);
+		return true;
+	}
+
+	if(_fit != WELZL) {
+		cv::minEnclosingCircle(Mat(boundary), center, radius);
+		return true;
+	}
+
+	// a fixed shuffle gives Welzl's expected linear time and the same circle every time
+	unsigned int seed = 2463534242u;
+	for(i = n - 1; i > 0; --i) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		std::swap(boundary[i], boundary[seed % (i + 1)]);
+	}
+
+#define OUTSIDE(p) ((p.x - cx) * (p.x - cx) + (p.y - cy) * (p.y - cy) > r2 * (1 + 1e-9))
+
+	cx = boundary[0].x;
+	cy = boundary[0].y;
+	r2 = 0;
+	for(i = 1; i < n; ++i) {
+		if(!OUTSIDE(boundary[i])) {
+			continue;
+		}
+
+		// boundary[i] is on the circle of boundary[0..i]
+		cx = boundary[i].x;
+		cy = boundary[i].y;
+		r2 = 0;
+		for(j = 0; j < i; ++j) {
+			if(!OUTSIDE(boundary[j])) {
+				continue;
+			}
+
+			// so are boundary[i] and boundary[j]
+			cx = (boundary[i].x + boundary[j].x) / 2.0;
+			cy = (boundary[i].y + boundary[j].y) / 2.0;
+			r2 = (boundary[i].x - cx) * (boundary[i].x - cx) + (boundary[i].y - cy) * (boundary[i].y - cy);
+			for(k = 0; k < j; ++k) {
+				if(!OUTSIDE(boundary[k])) {
+					continue;
+				}
+
+				// the circle through all three
+				double ax = boundary[i].x, ay = boundary[i].y;
+				double bx = boundary[j].x - ax, by = boundary[j].y - ay;
+				double qx = boundary[k].x - ax, qy = boundary[k].y - ay;
+				double b2 = bx * bx + by * by, q2 = qx * qx + qy * qy;
+				d = 2 * (bx * qy - by * qx);
+				if(fabs(d) < 1e-9) {
+					// collinear, boundary[k] lies beyond one end so it spans the circle
+					const Point& e = (q2 > b2) ? boundary[i] : boundary[j];
+					cx = (e.x + boundary[k].x) / 2.0;
+					cy = (e.y + boundary[k].y) / 2.0;
+					r2 = (e.x - cx) * (e.x - cx) + (e.y - cy) * (e.y - cy);
+					continue;
+				}
+				dx = (qy * b2 - by * q2) / d;
+				dy = (bx * q2 - qx * b2) / d;
+				cx = ax + dx;
+				cy = ay + dy;
+				r2 = dx * dx + dy * dy;
+			}
+		}
+
+		// the circle of boundary[0..i] only grows
+		if(sqrt(r2) >= _maxr) {
+			return false;
+		}
+	}
+
+#undef OUTSIDE
+
+	center = Point2f(static_cast<float> (cx), static_cast<float> (cy));
+	radius = static_cast<float> (sqrt(r2));
+	return true;
+}
+
+/**
+* Kasa's least squares circle through the points, solved in coordinates
+* centered on their mean so the sums stay small.
+*
+* @return false, if the points are collinear
+*/
+template<typename P>
+static bool kasa(const vector<P>& pts, double& cx, double& cy, double& radius)
+{
+	size_t i, n = pts.size();
+	double mx = 0, my = 0, suu = 0, svv = 0, suv = 0, suuu = 0, svvv = 0, suvv = 0, svuu = 0;
+	double dx, dy, d;
+
+	for(i = 0; i < n; ++i) {
+		mx += pts[i].x;
+		my += pts[i].y;
+	}
+	mx /= n;
+	my /= n;
+
+	// the normal equations in coordinates centered on the mean pixel
+	for(i = 0; i < n; ++i) {
+		dx = pts[i].x - mx;
+		dy = pts[i].y - my;
+		suu += dx * dx;
+		svv += dy * dy;
+		suv += dx * dy;
+		suuu += dx * dx * dx;
+		svvv += dy * dy * dy;
+		suvv += dx * dy * dy;
+		svuu += dy * dx * dx;
+	}
+
+	d = suu * svv - suv * suv;
+	if(fabs(d) < 1e-9) {
+		return false;
+	}
+	dx = ((suuu + suvv) * svv - (svvv + svuu) * suv) / (2 * d);
+	dy = ((svvv + svuu) * suu - (suuu + suvv) * suv) / (2 * d);
+
+	cx = mx + dx;
+	cy = my + dy;
+	radius = sqrt(dx * dx + dy * dy + (suu + svv) / n);
+	return true;
+}
+
+/**
+* The bilinear interpolation of a gray scale view at (x, y).
+*
+* @return false, if (x, y) is not between the centers of its pixels
+*/
+static bool sample(const ImageView& g, float x, float y, float& v)
+{
+	int x0, y0;
+	float fx, fy;
+	const uchar *r0, *r1;
+
+	if(x < 0 || y < 0 || x >= g.width - 1 || y >= g.height - 1) {
+		return false;
+	}
+
+	x0 = static_cast<int> (x);
+	y0 = static_cast<int> (y);
+	fx = x - x0;
+	fy = y - y0;
+	r0 = g.row(y0) + x0;
+	r1 = g.row(y0 + 1) + x0;
+	v = (1 - fy) * ((1 - fx) * r0[0] + fx * r0[1]) + fy * ((1 - fx) * r1[0] + fx * r1[1]);
+	return true;
+}
+
+/**
+* Fits a circle to the sub-pixel edge of a dot instead of to its boundary
+* pixels.  Every boundary pixel of fitCircle(...) is inside the dot next to
+* its edge; along the gradient of the unthresholded image through it the
+* intensity is sampled at five points a pixel apart, and the edge is where
+* it crosses the threshold, nearest the pixel first.  Pixels without a
+* gradient or a crossing, e.g., on a noise speck, are dropped.
+*
+* Kasa's circle is fit to the edge points, then the points more than three
+* times the median distance off the circle, at least a quarter pixel, are
+* left out and the circle is fit again, twice at most, so a few pixels of
+* a neighboring dot or a reflection do not pull the center.
+*
+* @param[in] rect the tracking rectangle
+* @param[in,out] s the scratch buffers of the dot, with the boundary
+* @param[out] center the center of the circle, relative to rect
+* @param[out] radius the radius of the circle
+* @return false, if fewer than five edge points are left; center and radius
+*	are unchanged then
+*/
+
+bool TrackDot::refineCircle(const ImageView& rect, Scratch& s, Point2f& center,
+	float& radius) const
+{
+	static const int order[4] = {1, 2, 0, 3};
+	size_t i, n;
+	int x, y, j, k, round;
+	float gx, gy, g, a, b, v[5];
+	double cx, cy, r, limit;
+	ImageView gv = rect;
+	const uchar* row;
+
+	if(rect.type == CV_8UC3) {
+		gray(rect.mat(), Rect(Point(), rect.size()), s.pixel);
+		gv = ImageView(s.pixel, Point());
+	}
+	else if(rect.type != CV_8UC1) {
+		return false;
+	}
+
+	s.edge.clear();
+	for(i = 0; i < s.boundary.size(); ++i) {
+		x = s.boundary[i].x;
+		y = s.boundary[i].y;
+		if(x < 1 || y < 1 || x >= gv.width - 1 || y >= gv.height - 1) {
+			continue;
+		}
+
+		row = gv.row(y);
+		gx = (row[x + 1] - row[x - 1]) * 0.5f;
+		gy = (gv.row(y + 1)[x] - gv.row(y - 1)[x]) * 0.5f;
+		g = sqrt(gx * gx + gy * gy);
+		if(g < 1) {
+			continue;
+		}
+		gx /= g;
+		gy /= g;
+
+		for(k = 0; k < 5; ++k) {
+			if(!sample(gv, x + (k - 2) * gx, y + (k - 2) * gy, v[k])) {
+				break;
+			}
+		}
+		if(k < 5) {
+			continue;
+		}
+
+		// the crossing of the segment nearest the pixel
+		for(k = 0; k < 4; ++k) {
+			j = order[k];
+			a = v[j] - _thr;
+			b = v[j + 1] - _thr;
+			if((a > 0) != (b > 0)) {
+				g = j - 2 + a / (a - b);
+				s.edge.push_back(Point2f(x + g * gx, y + g * gy));
+				break;
+			}
+		}
+	}
+
+	for(round = 0; ; ++round) {
+		if(s.edge.size() < 5 || !kasa(s.edge, cx, cy, r)) {
+			return false;
+		}
+		if(round == 2) {
+			break;
+		}
+
+		s.residual.resize(s.edge.size());
+		for(i = 0; i < s.edge.size(); ++i) {
+			s.residual[i] = static_cast<float> (fabs(sqrt((s.edge[i].x - cx) * (s.edge[i].x - cx) +
+				(s.edge[i].y - cy) * (s.edge[i].y - cy)) - r));
+		}
+		vector<float>::iterator mid = s.residual.begin() + s.residual.size() / 2;
+		std::nth_element(s.residual.begin(), mid, s.residual.end());
+		limit = std::max(3.0 * *mid, 0.25);
+
+		for(i = 0, n = 0; i < s.edge.size(); ++i) {
+			double dx = s.edge[i].x - cx, dy = s.edge[i].y - cy;
+			if(fabs(sqrt(dx * dx + dy * dy) - r) <= limit) {
+				s.edge[n++] = s.edge[i];
+			}
+		}
+		if(n == s.edge.size()) {
+			break;
+		}
+		s.edge.resize(n);
+	}
+
+	center = Point2f(static_cast<float> (cx), static_cast<float> (cy));
+	radius = static_cast<float> (r);
+	return true;
+}
+
+/**
+* Thresholds the gray scale region-of-interest of the source image with
+* TYPE and adds every non-zero pixel whose neighbors above and below differ
+* to the boundary, just like thresholding and then scanning the thresholded
+* image, but without writing it.  The threshold type is a template parameter,
+* so the test of every pixel has no branch on it.  The rows are scanned in
+* memory order, for CV_THRESH_BINARY and CV_THRESH_BINARY_INV 16 pixels at a
+* time with SSE2.  The first and last rows are never boundary pixels.  With a
+* SIDE the rectangle is SIDE x SIDE pixels instead of _rw x _rh, so the rows
+* have a length known at compile time and a side that is a multiple of 16
+* has no scalar tail.  The rows are read through the stride of the view,
+* straight out of the image.
+*
+* @param[in] rect the gray scale (CV_8UC1) tracking rectangle
+* @param[out] boundary the boundary pixels, relative to the rectangle
+*/
+
+template<int TYPE, int SIDE>
+void TrackDot::thresholdBoundary(const ImageView& rect, vector<Point>& boundary) const
+{
+	const int rw = SIDE ? SIDE : _rw;
+	const int rh = SIDE ? SIDE : _rh;
+	int x, y;
+	const uchar *up, *mid, *down;
+#if TRACKDOT_SSE2
+	int i, bits;
+	const bool binary = (TYPE == CV_THRESH_BINARY || TYPE == CV_THRESH_BINARY_INV);
+	const bool inv = (TYPE == CV_THRESH_BINARY_INV);
+	// there is no unsigned byte compare, so both sides are shifted into signed range
+	const __m128i flip = _mm_set1_epi8((char) 0x80);
+	const __m128i thr = _mm_set1_epi8((char) (_thr ^ 0x80));
+	__m128i u, m, d;
+#endif
+	int t = _thr;
+
+	for(y = 1; y < rh - 1; ++y) {
+		up = rect.row(y - 1);
+		mid = rect.row(y);
+		down = rect.row(y + 1);
+		x = 0;
+
+#if TRACKDOT_SSE2
+		// a binary result only depends on which side of the threshold a pixel is
+		for(; binary && x + 16 <= rw; x += 16) {
+			u = _mm_cmpgt_epi8(_mm_xor_si128(_mm_loadu_si128((const __m128i*) (up + x)), flip), thr);
+			m = _mm_cmpgt_epi8(_mm_xor_si128(_mm_loadu_si128((const __m128i*) (mid + x)), flip), thr);
+			d = _mm_cmpgt_epi8(_mm_xor_si128(_mm_loadu_si128((const __m128i*) (down + x)), flip), thr);
+
+			// inverting the threshold flips above and below alike, so only I(x, y) changes
+			u = _mm_xor_si128(u, d);
+			m = inv ? _mm_andnot_si128(m, u) : _mm_and_si128(m, u);
+
+			bits = _mm_movemask_epi8(m);
+			for(i = 0; bits != 0; ++i, bits >>= 1) {
+				if(bits & 1) {
+					boundary.push_back(Point(x + i, y));
+				}
+			}
+		}
+#endif
+
+		for(; x < rw; ++x) {
+			if(Thresh<TYPE>::at(mid[x], t) &&
+				Thresh<TYPE>::at(up[x], t) != Thresh<TYPE>::at(down[x], t)) {
+				boundary.push_back(Point(x, y));
+			}
+		}
+	}
+}
+
+/**
+* Finds the boundary of a dot in a CN-channel image.  A color rectangle is
+* converted to gray scale into the dot's scratch buffer first with gray(...),
+* the gray scale rectangle is then scanned by
+* thresholdBoundary<TYPE, SIDE>(...).
+*/
+
+template<int TYPE, int CN, int SIDE>
+void TrackDot::findBoundary(const ImageView& rect, Scratch& s) const
+{
+	if(CN == 1) {
+		thresholdBoundary<TYPE, SIDE>(rect, s.boundary);
+	}
+	else {
+		gray(rect.mat(), Rect(Point(), rect.size()), s.pixel);
+		thresholdBoundary<TYPE, SIDE>(ImageView(s.pixel, Point()), s.boundary);
+	}
+}
+
+/**
+* Adds up the pixels of the gray scale region-of-interest thresholded with
+* TYPE and t in one pass, without writing the thresholded image: sums[0] is
+* the sum of the weights, sums[1] and sums[2] the sums of the weights times
+* x and y and sums[3] the number of non-zero pixels.  A pixel weighs 1 if
+* it is not zero after thresholding, or with WEIGHTED its thresholded value.
+* The rows are scanned in memory order with integer sums, for
+* CV_THRESH_BINARY and CV_THRESH_BINARY_INV 16 pixels at a time with SSE2:
+* the sums of a row are taken by psadbw of the 0/1 mask and of the masked
+* column numbers.  The sums are exact, so the centroid is the same as the
+* sums of doubles of find_pbu(...) used to give.  With a SIDE the rectangle is
+* SIDE x SIDE pixels, like in thresholdBoundary(...).
+*
+* @param[in] rect the gray scale (CV_8UC1) tracking rectangle
+* @param[in] t the threshold
+* @param[out] sums the weight, x and y sums and the number of pixels
+*/
+
+template<int TYPE, bool WEIGHTED, int SIDE>
+void TrackDot::centroidSums(const ImageView& rect, int t, int64 sums[4]) const
+{
+	const int width = SIDE ? SIDE : rect.width;
+	const int height = SIDE ? SIDE : rect.height;
+	int x, y, w, n, sx, count;
+	const uchar* row;
+#if TRACKDOT_SSE2
+	const bool binary = (TYPE == CV_THRESH_BINARY || TYPE == CV_THRESH_BINARY_INV);
+	const bool inv = (TYPE == CV_THRESH_BINARY_INV);
+	const __m128i flip = _mm_set1_epi8((char) 0x80);
+	const __m128i thr = _mm_set1_epi8((char) (t ^ 0x80));
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i cols = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m128i m, c, acc_n, acc_x;
+#endif
+
+	sums[0] = sums[1] = sums[2] = sums[3] = 0;
+	for(y = 0; y < height; ++y) {
+		row = rect.row(y);
+		n = sx = count = 0;
+		x = 0;
+
+#if TRACKDOT_SSE2
+		if(binary) {
+			acc_n = acc_x = zero;
+			for(; x + 16 <= width; x += 16) {
+				m = _mm_cmpgt_epi8(_mm_xor_si128(_mm_loadu_si128((const __m128i*) (row + x)), flip), thr);
+				if(inv) {
+					m = _mm_andnot_si128(m, _mm_cmpeq_epi8(m, m));
+				}
+
+				// the pixels and their columns, x times the block's pixels plus the offsets
+				c = _mm_sad_epu8(_mm_and_si128(m, one), zero);
+				acc_n = _mm_add_epi64(acc_n, c);
+				acc_x = _mm_add_epi64(acc_x, _mm_add_epi64(_mm_mul_epu32(c, _mm_set1_epi32(x)),
+					_mm_sad_epu8(_mm_and_si128(m, cols), zero)));
+			}
+
+			// a row has less than 2^32 pixels, so both halves fit an int
+			count = _mm_cvtsi128_si32(acc_n) + _mm_cvtsi128_si32(_mm_srli_si128(acc_n, 8));
+			sx = _mm_cvtsi128_si32(acc_x) + _mm_cvtsi128_si32(_mm_srli_si128(acc_x, 8));
+			n = WEIGHTED ? count * WHITE : count;
+			sx = WEIGHTED ? sx * WHITE : sx;
+		}
+#endif
+
+		for(; x < width; ++x) {
+			w = Thresh<TYPE>::at(row[x], t);
+			if(w != 0) {
+				++count;
+				if(!WEIGHTED) {
+					w = 1;
+				}
+				n += w;
+				sx += w * x;
+			}
+		}
+
+		sums[0] += n;
+		sums[1] += sx;
+		sums[2] += static_cast<int64> (n) * y;
+		sums[3] += count;
+	}
+}
+
+/** @brief the binary centroidSums<TYPE, WEIGHTED, SIDE> of one side, by [weighted][type] */
+#define SUMS_SIDE(SIDE) { \
+	{&TrackDot::centroidSums<CV_THRESH_BINARY, false, SIDE>, \
+	&TrackDot::centroidSums<CV_THRESH_BINARY_INV, false, SIDE>}, \
+	{&TrackDot::centroidSums<CV_THRESH_BINARY, true, SIDE>, \
+	&TrackDot::centroidSums<CV_THRESH_BINARY_INV, true, SIDE>}}
+
+/**
+* Adds up the tracking rectangle of a dot with centroidSums<TYPE, WEIGHTED>
+* of the threshold type.  A color rectangle is converted to gray scale into
+* the dot's scratch buffer first with gray(...).  For other threshold types the rectangle
+* is thresholded with threshold(...) and its non-zero pixels are added up.
+* The binary types of a rectangle with one of the fixed_sides use the variant
+* compiled for its side.
+*/
+
+void TrackDot::centroid(const ImageView& rect, Scratch& s, bool weighted, int64 sums[4]) const
+{
+	typedef void (TrackDot::*SumsFn)(const ImageView&, int, int64*) const;
+	static const SumsFn fns[2][5] = {
+		{&TrackDot::centroidSums<CV_THRESH_BINARY, false, 0>, &TrackDot::centroidSums<CV_THRESH_BINARY_INV, false, 0>,
+		&TrackDot::centroidSums<CV_THRESH_TRUNC, false, 0>, &TrackDot::centroidSums<CV_THRESH_TOZERO, false, 0>,
+		&TrackDot::centroidSums<CV_THRESH_TOZERO_INV, false, 0>},
+		{&TrackDot::centroidSums<CV_THRESH_BINARY, true, 0>, &TrackDot::centroidSums<CV_THRESH_BINARY_INV, true, 0>,
+		&TrackDot::centroidSums<CV_THRESH_TRUNC, true, 0>, &TrackDot::centroidSums<CV_THRESH_TOZERO, true, 0>,
+		&TrackDot::centroidSums<CV_THRESH_TOZERO_INV, true, 0>}
+	};
+	static const SumsFn by_side[FIXED_SIDES][2][2] = {
+		SUMS_SIDE(16), SUMS_SIDE(32), SUMS_SIDE(40), SUMS_SIDE(64), SUMS_SIDE(128)
+	};
+	SumsFn fn = NULL;
+
+	if(_thr_type >= CV_THRESH_BINARY && _thr_type <= CV_THRESH_TOZERO_INV) {
+		fn = (_fixed >= 0 && _thr_type <= CV_THRESH_BINARY_INV) ?
+			by_side[_fixed][weighted][_thr_type] : fns[weighted][_thr_type];
+	}
+
+	if(fn == NULL) {
+		threshold(rect.mat(), Rect(Point(), rect.size()), s.pixel);
+		(this->*fns[weighted][CV_THRESH_TOZERO])(ImageView(s.pixel, Point()), 0, sums);
+	}
+	else if(rect.type == CV_8UC3) {
+		gray(rect.mat(), Rect(Point(), rect.size()), s.pixel);
+		(this->*fn)(ImageView(s.pixel, Point()), _thr, sums);
+	}
+	else {
+		// raise an error, because image must be BGR, or grayscale
+		CV_Assert(rect.type == CV_8UC1);
+		(this->*fn)(rect, _thr, sums);
+	}
+}
+
+/**
+* Returns the image frame position of point p of the tracking rectangle.
+*/
+
+Point2d TrackDot::imagePoint(const ImageView& rect, const Point2f& p)
+{
+	return Point2d(rect.offset.x + p.x, rect.offset.y + p.y);
+}
+
 /**
 * Draws a threshold patch inside the region-of-interest in the destination 
 * image centered at the dot's current location.
@@ -145,6 +1035,107 @@ void TrackDot::draw(const Mat& src, const Dot& dot, Mat& dst)
 		CV_FONT_HERSHEY_PLAIN, 1, TAG_COLOR);
 }
 
+/**
+* Finds a dot in an image with the method chosen by method(...).
+*
+* @param[in] img the image containing the dot
+* @param[in] dot the dot to find
+* @param[out] new_loc the new location of the dot
+* @param[out] area the size of the dot, the radius of a circle its size
+* @return true, if the dot is found and <code> new_loc </code> contains the new
+* location, false otherwise.
+*/
+
+bool TrackDot::find(const Mat& img, const Dot& dot, Point2d& new_loc, double& area)
+{
+	return find(ImageView(img), dot, new_loc, area);
+}
+
+/**
+* Finds a dot in a view of an image, like find(const Mat&, ...).  Its
+* tracking rectangle is read straight out of the view, and the new location
+* is in the image frame the offset of the view places it in.
+*/
+
+bool TrackDot::find(const ImageView& img, const Dot& dot, Point2d& new_loc, double& area)
+{
+	Point2d prev_loc = dot.pixel();
+	bool found;
+
+	switch(_method) {
+		case CENTROID:
+			found = findCentroid(img, dot, new_loc, area);
+			break;
+
+		case MOMENTS:
+			found = findMoments(img, dot, new_loc, area);
+			break;
+
+		default:
+			found = findCircle(img, dot, new_loc, area);
+			break;
+	}
+
+	if(_code == NO_CODE) {
+		return found;
+	}
+
+	// the find methods have reserved the scratch buffers of the dot
+	Scratch& s = _scratch[dot.tag()];
+	s.measured = found ? measureClass(img, s, new_loc, area) : -1;
+
+	// the marker of another dot, which keeps its identity
+	if(s.measured >= 0 && s.identity >= 0 && s.measured != s.identity) {
+		new_loc = prev_loc;
+		return false;
+	}
+
+	return found;
+}
+
+/**
+* Measures the class of a dot find(...) found, see code(...).
+*
+* @param[in] img the image the dot was found in
+* @param[in] s the scratch buffers of the dot
+* @param[in] new_loc where the dot was found
+* @param[in] area the radius the dot was found with
+* @return the class, -1 if the image has no gray level to measure
+*/
+
+int TrackDot::measureClass(const ImageView& img, Scratch& s, const Point2d& new_loc,
+	double area) const
+{
+	int64 sums[4];
+	double m = area;
+
+	if(_code == INTENSITY_CODE) {
+		ImageView rect = trackingRect(img, new_loc);
+
+		if(rect.type == CV_8UC3) {
+			gray(rect.mat(), Rect(Point(), rect.size()), s.pixel);
+			rect = ImageView(s.pixel, Point());
+		}
+		else if(rect.type != CV_8UC1) {
+			return -1;
+		}
+
+		// the gray levels themselves, of the pixels the threshold keeps
+		if(_thr_type == CV_THRESH_BINARY_INV || _thr_type == CV_THRESH_TOZERO_INV) {
+			centroidSums<CV_THRESH_TOZERO_INV, true, 0>(rect, _thr, sums);
+		}
+		else {
+			centroidSums<CV_THRESH_TOZERO, true, 0>(rect, _thr, sums);
+		}
+		if(sums[3] == 0) {
+			return -1;
+		}
+		m = sums[0]/double(sums[3]);
+	}
+
+	return static_cast<int> (std::upper_bound(_bounds.begin(), _bounds.end(), m) - _bounds.begin());
+}
+
 /**
 * finds a dot in an image by searching for the best fit circle on a subset
 * of boundary points of a binary image.  If the subset of boundary points form
@@ -160,50 +1151,82 @@ void TrackDot::draw(const Mat& src, const Dot& dot, Mat& dst)
 * location, false otherwise.
 */
 
-bool TrackDot::find(const Mat& img, const Dot& dot, Point2d& new_loc, double& area) // area: added for checking the number of detected pixels.  may not be necessary later.		
+/** @brief the binary findBoundary<TYPE, CN, SIDE> of one side, by [color][type] */
+#define BOUNDARY_SIDE(SIDE) { \
+	{&TrackDot::findBoundary<CV_THRESH_BINARY, 1, SIDE>, \
+	&TrackDot::findBoundary<CV_THRESH_BINARY_INV, 1, SIDE>}, \
+	{&TrackDot::findBoundary<CV_THRESH_BINARY, 3, SIDE>, \
+	&TrackDot::findBoundary<CV_THRESH_BINARY_INV, 3, SIDE>}}
+
+bool TrackDot::findCircle(const ImageView& img, const Dot& dot, Point2d& new_loc, double& area) // area: added for checking the number of detected pixels.  may not be necessary later.		
 {
+	typedef void (TrackDot::*BoundaryFn)(const ImageView&, Scratch&) const;
+	static const BoundaryFn boundaries[2][5] = {
+		{&TrackDot::findBoundary<CV_THRESH_BINARY, 1, 0>, &TrackDot::findBoundary<CV_THRESH_BINARY_INV, 1, 0>,
+		&TrackDot::findBoundary<CV_THRESH_TRUNC, 1, 0>, &TrackDot::findBoundary<CV_THRESH_TOZERO, 1, 0>,
+		&TrackDot::findBoundary<CV_THRESH_TOZERO_INV, 1, 0>},
+		{&TrackDot::findBoundary<CV_THRESH_BINARY, 3, 0>, &TrackDot::findBoundary<CV_THRESH_BINARY_INV, 3, 0>,
+		&TrackDot::findBoundary<CV_THRESH_TRUNC, 3, 0>, &TrackDot::findBoundary<CV_THRESH_TOZERO, 3, 0>,
+		&TrackDot::findBoundary<CV_THRESH_TOZERO_INV, 3, 0>}
+	};
+	static const BoundaryFn by_side[FIXED_SIDES][2][2] = {
+		BOUNDARY_SIDE(16), BOUNDARY_SIDE(32), BOUNDARY_SIDE(40), BOUNDARY_SIDE(64),
+		BOUNDARY_SIDE(128)
+	};
+	BoundaryFn fn;
 	int x, y, y0, yf;
 	float radius;
-	Mat_<uchar> pixel;
-	vector<Point> boundary;
 	Point2d& prev_loc = dot.pixel();
-	Rect roi = calcRoi(prev_loc, img.size());
+	ImageView rect = trackingRect(img, prev_loc);
 
-	// binarize image
-	threshold(img, roi, pixel);
+	// Tracker::track() reserves the buffers, a direct call may need them first
+	if(static_cast<size_t> (dot.tag()) >= _scratch.size()) {
+		reserve(dot.tag() + 1);
+	}
+	Mat_<uchar>& pixel = _scratch[dot.tag()].pixel;
+	vector<Point>& boundary = _scratch[dot.tag()].boundary;
+	boundary.clear();
+
+	if((img.type == CV_8UC1 || img.type == CV_8UC3) &&
+		_thr_type >= CV_THRESH_BINARY && _thr_type <= CV_THRESH_TOZERO_INV) {
+		// the threshold is tested on the fly by the variant of the image type, and of
+		// the side of the rectangle for the binary types
+		fn = (_fixed >= 0 && _thr_type <= CV_THRESH_BINARY_INV) ?
+			by_side[_fixed][img.type == CV_8UC3][_thr_type] :
+			boundaries[img.type == CV_8UC3][_thr_type];
+		(this->*fn)(rect, _scratch[dot.tag()]);
+	}
+	else {
+		// binarize image
+		threshold(rect.mat(), Rect(Point(), rect.size()), pixel);
 
-	// avoid boundary problem at y = 0 and y = _rh
-	y0 = 1;
-	yf = _rh - 1;
+		// avoid boundary problem at y = 0 and y = _rh
+		y0 = 1;
+		yf = _rh - 1;
 
-	// find (vertically-aligned) boundary pixels
-	for(x = 0; x < _rw; ++x) {
-		for(y = y0; y < yf; ++y) {
-			// does I(x, y) = WHITE && dI(x, y)/dy != 0, where I = intensity
-			// note: pixel(row, col) <=> pixel(y, x) <=> I(x, y)
-			if(pixel(y, x) && pixel(y - 1, x) - pixel(y + 1, x)) {
-				// add location of boundary pixel
-				boundary.push_back(Point(x, y));
+		// find (vertically-aligned) boundary pixels
+		for(x = 0; x < _rw; ++x) {
+			for(y = y0; y < yf; ++y) {
+				// does I(x, y) = WHITE && dI(x, y)/dy != 0, where I = intensity
+				// note: pixel(row, col) <=> pixel(y, x) <=> I(x, y)
+				if(pixel(y, x) && pixel(y - 1, x) - pixel(y + 1, x)) {
+					// add location of boundary pixel
+					boundary.push_back(Point(x, y));
+				}
 			}
 		}
 	}
 		
 	if(!boundary.empty()) {
 		Point2f p;
-		cv::minEnclosingCircle(Mat(boundary), p, radius);
-		if(radius > _minr && radius < _maxr) {
-			// update location only if it passes the size filter
-			Point tl;
-			Size wholeSize;
-			img.locateROI(wholeSize, tl);
+		if(fitCircle(boundary, p, radius) && radius > _minr && radius < _maxr) {
+			// the fit of the boundary pixels stays if the edge cannot be refined
+			if(_refine) {
+				refineCircle(rect, _scratch[dot.tag()], p, radius);
+			}
 
-			if(wholeSize == img.size()) {
-				new_loc = Point2d(roi.x + p.x, roi.y + p.y);
-			}
-			else {
-				new_loc = Point2d(tl.x + p.x, tl.y + p.y);
-			}
-			
+			// update location only if it passes the size filter
+			new_loc = imagePoint(rect, p);
 			area = radius; //cv::contourArea(Mat(boundary)); // added for checking the number of detected pixels.  may not be necessary later.
 			return true;
 		}
@@ -213,60 +1236,81 @@ bool TrackDot::find(const Mat& img, const Dot& dot, Point2d& new_loc, double& ar
 	return false;
 }
 
+/**
+* finds a dot in an image from the moments of the thresholded tracking
+* rectangle: the dot is at their centroid and its size is that of a disk of
+* as many pixels as are not zero.  With CV_THRESH_TOZERO the pixels are
+* weighted by their intensity, with CV_THRESH_BINARY this is the centroid.
+* Like find_pbu(...) there is no size filter.
+*
+* @param[in] img the image containing the dot
+* @param[in] dot the dot to find
+* @param[out] new_loc the new location of the dot
+* @param[out] area the radius of the disk
+* @return true, if the rectangle is not all zero
+*/
+
+bool TrackDot::findMoments(const ImageView& img, const Dot& dot, Point2d& new_loc, double& area)
+{
+	int64 sums[4];
+	Point2d& prev_loc = dot.pixel();
+	ImageView rect = trackingRect(img, prev_loc);
+
+	if(static_cast<size_t> (dot.tag()) >= _scratch.size()) {
+		reserve(dot.tag() + 1);
+	}
+
+	// weighted by the thresholded values, the moments m00, m10 and m01
+	centroid(rect, _scratch[dot.tag()], true, sums);
+	if(sums[0] == 0) {
+		new_loc = prev_loc;
+		return false;
+	}
+
+	new_loc = imagePoint(rect, Point2f(static_cast<float> (sums[1] / double(sums[0])),
+		static_cast<float> (sums[2] / double(sums[0]))));
+	area = sqrt(sums[3] / 3.14159);
+	return true;
+}
+
 bool TrackDot::find_pbu(const Mat& img, const Dot& dot, Point2d& new_loc, double& area) // area: added for checking the number of detected pixels.  may not be necessary later.
 {
-	int x, y, y0, yf, k, thresh, dot_size, ii, cnt=0;
-	int hist[256] = { 0 }; //initialize histogram to zero 
+	return findCentroid(ImageView(img), dot, new_loc, area);
+}
+
+/**
+* finds a dot in a view of an image at the centroid of the pixels of its
+* tracking rectangle that pass the threshold, see find_pbu(...).
+*/
+
+bool TrackDot::findCentroid(const ImageView& img, const Dot& dot, Point2d& new_loc, double& area)
+{
+	int64 sums[4];
 	float radius;
-	double cx=0, cy=0;
-	Mat_<uchar> pixel, dst;
-	vector<Point> boundary;
 	Point2d& prev_loc = dot.pixel();
-	Rect roi = calcRoi(prev_loc, img.size());
-
-	//img(roi).copyTo(dst);
-	
-		// binarize image
-	threshold(img, roi, dst);
-	ii=0;
+	ImageView rect = trackingRect(img, prev_loc);
 
-	for(x = 0; x < _rw; ++x) {
-		for(y = 0; y < _rh; ++y) {
-			if (dst(y,x)>0) {
-				cx += x;
-				cy += y;
-				++ii;
-			}
-		}
+	// Tracker::track() reserves the buffers, a direct call may need them first
+	if(static_cast<size_t> (dot.tag()) >= _scratch.size()) {
+		reserve(dot.tag() + 1);
 	}
 
-	k=0; 
+	// the number of foreground pixels and the sums of their x and y
+	centroid(rect, _scratch[dot.tag()], false, sums);
 	
 	// added by Ji-Chul
 	// It's the case when the tracker couldn't detect the dot.
 	// must return false.
-	if ( ii == 0 ) {
+	if ( sums[0] == 0 ) {
 		new_loc = prev_loc;
 		return false;
 	}
-	
 
-	//std::cout << ii << std::endl;
-    radius = sqrt(ii/3.14159);
+	radius = sqrt(sums[0]/3.14159);
 	Point2f p;
-	p.x=cx/double(ii);
-	p.y=cy/double(ii);
-
-	Point tl;
-	Size wholeSize;
-	img.locateROI(wholeSize, tl);
-
-	if(wholeSize == img.size()) {
-		new_loc = Point2d(roi.x + p.x, roi.y + p.y);
-	}
-	else {
-		new_loc = Point2d(tl.x + p.x, tl.y + p.y);
-	}
+	p.x=sums[1]/double(sums[0]);
+	p.y=sums[2]/double(sums[0]);
+	new_loc = imagePoint(rect, p);
 
 	area = radius; //cv::contourArea(Mat(boundary)); // added for checking the number of detected pixels.  may not be necessary later.
 	return true;
@@ -319,16 +1363,7 @@ bool TrackDot::find_pbu2(const Mat& img, const Dot& dot, Point2d& new_loc, doubl
 	//p.x=cx/double(ii);
 	//p.y=cy/double(ii);
 
-	Point tl;
-	Size wholeSize;
-	img.locateROI(wholeSize, tl);
-
-	if(wholeSize == img.size()) {
-		new_loc = Point2d(roi.x + p.x, roi.y + p.y);
-	}
-	else {
-		new_loc = Point2d(tl.x + p.x, tl.y + p.y);
-	}
+	new_loc = imagePoint(ImageView(img)(roi), p);
 
 	area = radius; //cv::contourArea(Mat(boundary)); // added for checking the number of detected pixels.  may not be necessary later.
 	return true;
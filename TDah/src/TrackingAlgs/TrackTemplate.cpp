@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <sstream>
+#include <highgui.h>
+#include "Dot.h"
+#include "TrackingAlgs/TrackTemplate.h"
+
+#if defined(__SSE2__) || defined(_M_IX86) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define TRACKTEMPLATE_SSE2 1
+#else
+	#define TRACKTEMPLATE_SSE2 0
+#endif
+
+/** @brief the smallest side of a template at the coarsest level */
+#define MIN_TEMPLATE_SIDE 4
+/** @brief the positions around the doubled best one a finer level tries */
+#define REFINE 2
+#define LOC_COLOR Scalar(255, 0, 0)
+#define TAG_COLOR Scalar(0, 165, 255)
+
+using std::stringstream;
+using std::vector;
+using cv::Mat;
+using cv::Mat_;
+using cv::Point2d;
+using cv::Point;
+using cv::Rect;
+using cv::Size;
+using cv::Scalar;
+
+/**
+* Makes a TrackTemplate, see set(...).
+*/
+
+TrackTemplate::TrackTemplate(int roi_width, int roi_height, int templ_width,
+							 int templ_height, double min_score, int levels)
+	: _tw(0), _th(0)
+{
+	set(roi_width, roi_height, templ_width, templ_height, min_score, levels);
+}
+
+/** @brief the destructor for this class */
+TrackTemplate::~TrackTemplate()
+{
+
+}
+
+/**
+* Sets all template tracking parameters.  The templates that were learned
+* are forgotten if their size changes.
+*
+* @param[in] roi_width the width of the tracking rectangle
+* @param[in] roi_height the height of the tracking rectangle
+* @param[in] templ_width the width of the template, at most roi_width
+* @param[in] templ_height the height of the template, at most roi_height
+* @param[in] min_score the least normalized cross-correlation, from -1 to 1,
+*	of a match; a dot whose best match scores less is not found
+* @param[in] levels the pyramid levels, 1 searches every position at full
+*	resolution.  There are at most MAX_LEVELS and fewer if the template
+*	would get smaller than MIN_TEMPLATE_SIDE at the coarsest.
+*/
+
+void TrackTemplate::set(int roi_width, int roi_height, int templ_width,
+						int templ_height, double min_score, int levels)
+{
+	CV_Assert(templ_width > 0 && templ_height > 0 &&
+		templ_width <= roi_width && templ_height <= roi_height);
+
+	_click_window = "TrackTemplate";
+	if(templ_width != _tw || templ_height != _th) {
+		for(size_t i = 0; i < _state.size(); ++i) {
+			_state[i].learned = false;
+		}
+	}
+	_rw = roi_width;
+	_rh = roi_height;
+	_tw = templ_width;
+	_th = templ_height;
+	_min_score = min_score;
+
+	_levels = std::min(std::max(levels, 1), static_cast<int> (MAX_LEVELS));
+	while(_levels > 1 && std::min(_tw, _th) >> (_levels - 1) < MIN_TEMPLATE_SIDE) {
+		--_levels;
+	}
+}
+
+int TrackTemplate::levels() const
+{
+	return _levels;
+}
+
+/**
+* Makes sure every dot has its own template and scratch buffers.  A dot
+* that has none yet learns its template the first time it is searched for.
+*
+* @param[in] dots the number of dots
+*/
+
+void TrackTemplate::reserve(int dots)
+{
+	size_t i = _state.size();
+
+	if(static_cast<size_t> (dots) <= i) {
+		return;
+	}
+
+	_state.resize(dots);
+	for(; i < _state.size(); ++i) {
+		_state[i].learned = false;
+	}
+}
+
+TrackTemplate::State& TrackTemplate::state(const Dot& dot)
+{
+	// Tracker::track() reserves the states, a direct call may need them first
+	if(static_cast<size_t> (dot.tag()) >= _state.size()) {
+		reserve(dot.tag() + 1);
+	}
+
+	return _state[dot.tag()];
+}
+
+void TrackTemplate::forget(int tag)
+{
+	if(tag >= 0 && static_cast<size_t> (tag) < _state.size()) {
+		_state[tag].learned = false;
+	}
+}
+
+bool TrackTemplate::learned(int tag) const
+{
+	return tag >= 0 && static_cast<size_t> (tag) < _state.size() && _state[tag].learned;
+}
+
+Rect TrackTemplate::calcRoi(const Point2d& pixel, const Size& img_size) const
+{
+	int x = cv::saturate_cast<int> (pixel.x);
+	int y = cv::saturate_cast<int> (pixel.y);
+
+	CV_Assert(img_size.width >= _rw && img_size.height >= _rh);
+	x = std::min(std::max(0, x - _rw / 2), img_size.width - _rw);
+	y = std::min(std::max(0, y - _rh / 2), img_size.height - _rh);
+
+	return Rect(x, y, _rw, _rh);
+}
+
+/**
+* Returns rect if it is gray scale, otherwise converts it into buf like
+* cvtColor(..., CV_BGR2GRAY) and returns the view of buf at the offset of
+* rect.
+*/
+
+ImageView TrackTemplate::grayView(const ImageView& rect, Mat_<uchar>& buf)
+{
+	if(rect.type == CV_8UC1) {
+		return rect;
+	}
+
+	// raise an error, because image must be BGR, or grayscale
+	CV_Assert(rect.type == CV_8UC3);
+	cv::cvtColor(rect.mat(), buf, CV_BGR2GRAY);
+	return ImageView(buf, rect.offset);
+}
+
+/**
+* Halves src into dst, every pixel of dst the rounded average of a 2x2
+* square of src.  An odd last row or column of src is dropped.
+*/
+
+void TrackTemplate::halve(const ImageView& src, Mat_<uchar>& dst)
+{
+	dst.create(src.height / 2, src.width / 2);
+	for(int y = 0; y < dst.rows; ++y) {
+		const uchar* a = src.row(2 * y);
+		const uchar* b = src.row(2 * y + 1);
+		uchar* d = dst[y];
+
+		for(int x = 0; x < dst.cols; ++x) {
+			d[x] = static_cast<uchar> ((a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2);
+		}
+	}
+}
+
+/**
+* Takes the template of a dot from the templ_width x templ_height pixels
+* around its location in a view of an image, and its smaller versions for
+* the levels of the pyramid from it.  Near the border of the view the
+* template is moved inside it, the anchor remembers where the dot is in it.
+*
+* @param[in] img the view of the image, placed in the image frame
+* @param[in] dot the dot, at its location in the image frame
+* @return true, if the template has any contrast
+*/
+
+bool TrackTemplate::learn(const ImageView& img, const Dot& dot)
+{
+	State& s = state(dot);
+	Mat_<uchar> gray, pyr[MAX_LEVELS];
+	Point2d p(dot.pixel().x - img.offset.x, dot.pixel().y - img.offset.y);
+	int x, y;
+
+	CV_Assert(img.width >= _tw && img.height >= _th);
+	x = std::min(std::max(0, cvRound(p.x) - _tw / 2), img.width - _tw);
+	y = std::min(std::max(0, cvRound(p.y) - _th / 2), img.height - _th);
+	s.anchor = Point2d(p.x - x, p.y - y);
+
+	ImageView v = grayView(img(Rect(x, y, _tw, _th)), gray);
+	s.learned = true;
+	for(int l = 0; l < _levels; ++l) {
+		Level& t = s.level[l];
+		double sq = 0;
+
+		if(l > 0) {
+			halve(v, pyr[l]);
+			v = ImageView(pyr[l], Point());
+		}
+
+		t.w = v.width;
+		t.h = v.height;
+		t.t.resize(t.w * t.h);
+		t.sum = 0;
+		for(int r = 0; r < t.h; ++r) {
+			const uchar* row = v.row(r);
+			for(int c = 0; c < t.w; ++c) {
+				t.t[r * t.w + c] = row[c];
+				t.sum += row[c];
+				sq += row[c] * row[c];
+			}
+		}
+
+		// a flat template correlates with nothing
+		t.var = t.w * t.h * sq - static_cast<double> (t.sum) * t.sum;
+		s.learned = s.learned && t.var > 0;
+	}
+
+	return s.learned;
+}
+
+/**
+* Returns the sum of the products of the template and the pixels of v below
+* it, with the template at (x, y).  With SSE2 16 pixels are widened and
+* multiplied and added in pairs at a time, the sums are exact in 32 bits for
+* templates of up to 32768 pixels.
+*/
+
+int TrackTemplate::correlate(const Level& t, const ImageView& v, int x, int y)
+{
+	int sum = 0;
+#if TRACKTEMPLATE_SSE2
+	__m128i acc = _mm_setzero_si128(), zero = _mm_setzero_si128();
+#endif
+
+	for(int r = 0; r < t.h; ++r) {
+		const uchar* p = v.row(y + r) + x;
+		const short* q = &t.t[r * t.w];
+		int c = 0;
+
+#if TRACKTEMPLATE_SSE2
+		for(; c + 16 <= t.w; c += 16) {
+			__m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*> (p + c));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(px, zero),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*> (q + c))));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(px, zero),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*> (q + c + 8))));
+		}
+		for(; c + 8 <= t.w; c += 8) {
+			__m128i px = _mm_loadl_epi64(reinterpret_cast<const __m128i*> (p + c));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(px, zero),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*> (q + c))));
+		}
+#endif
+		for(; c < t.w; ++c) {
+			sum += q[c] * p[c];
+		}
+	}
+
+#if TRACKTEMPLATE_SSE2
+	acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 8));
+	acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+	sum += _mm_cvtsi128_si32(acc);
+#endif
+	return sum;
+}
+
+/**
+* Scores the template at every position of r in v, the top-left corners of
+* the template, and keeps the scores in s.scores row by row.  The score is
+* the normalized cross-correlation
+*
+*   (n sum(t I) - sum(t) sum(I)) / sqrt(t.var (n sum(I^2) - sum(I)^2)),
+*
+* where the sums of I and I^2 under the template are four lookups into the
+* integral images of v, which are summed up from running row sums first.
+*
+* @return the best position, and its score in score
+*/
+
+Point TrackTemplate::search(State& s, const Level& t, const ImageView& v,
+							const Rect& r, float& score) const
+{
+	int w = v.width + 1, n = t.w * t.h;
+	Point best = r.tl();
+
+	s.sum.resize(w * (v.height + 1));
+	s.sqsum.resize(s.sum.size());
+	std::fill(s.sum.begin(), s.sum.begin() + w, 0);
+	std::fill(s.sqsum.begin(), s.sqsum.begin() + w, 0);
+	for(int y = 0; y < v.height; ++y) {
+		const uchar* p = v.row(y);
+		int* sum = &s.sum[(y + 1) * w];
+		int64* sqsum = &s.sqsum[(y + 1) * w];
+		int row = 0;
+		int64 sq = 0;
+
+		sum[0] = 0;
+		sqsum[0] = 0;
+		for(int x = 0; x < v.width; ++x) {
+			row += p[x];
+			sq += p[x] * p[x];
+			sum[x + 1] = sum[x + 1 - w] + row;
+			sqsum[x + 1] = sqsum[x + 1 - w] + sq;
+		}
+	}
+
+	score = -2;
+	s.scores.resize(r.area());
+	for(int y = r.y; y < r.y + r.height; ++y) {
+		for(int x = r.x; x < r.x + r.width; ++x) {
+			int a = y * w + x, b = (y + t.h) * w + x;
+			double sum = s.sum[b + t.w] - s.sum[b] - s.sum[a + t.w] + s.sum[a];
+			double sq = static_cast<double> (s.sqsum[b + t.w] - s.sqsum[b] - s.sqsum[a + t.w] + s.sqsum[a]);
+			double var = n * sq - sum * sum;
+			float c = 0;
+
+			if(var > 0) {
+				c = static_cast<float> ((n * static_cast<double> (correlate(t, v, x, y)) -
+					t.sum * sum) / sqrt(t.var * var));
+			}
+			s.scores[(y - r.y) * r.width + (x - r.x)] = c;
+			if(c > score) {
+				score = c;
+				best = Point(x, y);
+			}
+		}
+	}
+
+	return best;
+}
+
+bool TrackTemplate::find(const Mat& img, const Dot& dot, Point2d& new_loc, double& area)
+{
+	return find(ImageView(img), dot, new_loc, area);
+}
+
+/**
+* Finds a dot in a view of an image by matching its template in the
+* tracking rectangle around its last location, coarse to fine over the
+* pyramid.  The best position at full resolution is refined to subpixels
+* with a parabola through its score and those of its neighbors.  A dot
+* without a template learns it here and is found where it is.
+*
+* @param[in] img the view of the image containing the dot
+* @param[in] dot the dot to find
+* @param[out] new_loc the new location of the dot in the image frame
+* @param[out] area the score of the match
+* @return true, if the best match scores at least min_score and
+* <code> new_loc </code> contains the new location, false otherwise.
+*/
+
+bool TrackTemplate::find(const ImageView& img, const Dot& dot, Point2d& new_loc, double& area)
+{
+	State& s = state(dot);
+	Point2d& prev_loc = dot.pixel();
+	ImageView views[MAX_LEVELS];
+	Rect r;
+	Point best;
+	float score;
+	double dx = 0, dy = 0;
+
+	if(!s.learned) {
+		new_loc = prev_loc;
+		area = 1;
+		return learn(img, dot);
+	}
+
+	views[0] = grayView(img(calcRoi(Point2d(prev_loc.x - img.offset.x,
+		prev_loc.y - img.offset.y), img.size())), s.gray);
+	for(int l = 1; l < _levels; ++l) {
+		halve(views[l - 1], s.pyr[l]);
+		views[l] = ImageView(s.pyr[l], Point());
+	}
+
+	// every position at the coarsest level, then around the best one at the finer ones
+	for(int l = _levels - 1; l >= 0; --l) {
+		const Level& t = s.level[l];
+		Rect all(0, 0, views[l].width - t.w + 1, views[l].height - t.h + 1);
+
+		if(l == _levels - 1) {
+			r = all;
+		}
+		else {
+			r = Rect(2 * best.x - REFINE, 2 * best.y - REFINE, 2 * REFINE + 2, 2 * REFINE + 2) & all;
+		}
+		best = search(s, t, views[l], r, score);
+	}
+
+	if(score < _min_score) {
+		new_loc = prev_loc;
+		return false;
+	}
+
+	// the vertex of the parabola through the best score and its neighbors
+	int i = (best.y - r.y) * r.width + (best.x - r.x);
+	if(best.x > r.x && best.x < r.x + r.width - 1) {
+		double l = s.scores[i - 1], c = s.scores[i], rt = s.scores[i + 1];
+		if(l + rt - 2 * c < 0) {
+			dx = 0.5 * (l - rt) / (l + rt - 2 * c);
+		}
+	}
+	if(best.y > r.y && best.y < r.y + r.height - 1) {
+		double u = s.scores[i - r.width], c = s.scores[i], d = s.scores[i + r.width];
+		if(u + d - 2 * c < 0) {
+			dy = 0.5 * (u - d) / (u + d - 2 * c);
+		}
+	}
+
+	new_loc = Point2d(views[0].offset.x + best.x + dx + s.anchor.x,
+		views[0].offset.y + best.y + dy + s.anchor.y);
+	area = score;
+	return true;
+}
+
+/**
+* Draws the tracking rectangle of a dot and its template at the dot's
+* current location into the destination image.
+*
+* @param[in] src the source image
+* @param[in] dot the dot to draw
+* @param[out] dst the destination image
+*/
+
+void TrackTemplate::draw(const Mat& src, const Dot& dot, Mat& dst)
+{
+	stringstream ss;
+	Rect roi = calcRoi(dot.pixel(), src.size());
+	Point tl(cvRound(dot.pixel().x) - _tw / 2, cvRound(dot.pixel().y) - _th / 2);
+
+	if(dst.size() != src.size() || dst.type() != CV_8UC3) {
+		if(src.type() == CV_8UC1) {
+			cv::cvtColor(src, dst, CV_GRAY2BGR);
+		}
+		else {
+			src.copyTo(dst);
+		}
+	}
+
+	cv::rectangle(dst, roi.tl(), roi.br(), LOC_COLOR);
+	cv::rectangle(dst, tl, tl + Point(_tw, _th), TAG_COLOR);
+
+	ss << dot.tag();
+	cv::putText(dst, ss.str(), (roi.tl() + roi.br()) * 0.5,
+		CV_FONT_HERSHEY_PLAIN, 1, TAG_COLOR);
+}
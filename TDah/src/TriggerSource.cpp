@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <windows.h>
+
+#include "TriggerSource.h"
+
+/** @brief the values of NIDAQmx.h, which the library does not need to build */
+#define DAQMX_VAL_HZ 10373
+#define DAQMX_VAL_LOW 10214
+#define DAQMX_VAL_FINITE_SAMPS 10178
+#define DAQMX_VAL_CONT_SAMPS 10123
+#define DAQMX_VAL_SECONDS 10364
+#define DAQMX_VAL_RISING 10280
+#define DAQMX_VAL_LOW_FREQ_1_CTR 10105
+#define DAQMX_VAL_AUTO -1
+
+/** @brief the periods buffered on the board between polls */
+#define STAMP_BUFFER 10000
+/** @brief the pulses buffered for a continuous train */
+#define PULSE_BUFFER 1000
+/** @brief the range of the period measurement, s */
+#define MIN_PERIOD 1e-6
+#define MAX_PERIOD 1.0
+#define TIMEOUT 1.0
+
+typedef int (__stdcall *CreateTaskFn)(const char*, TaskHandle*);
+typedef int (__stdcall *CreateCOPulseChanFreqFn)(TaskHandle, const char*, const char*, int, int, double, double, double);
+typedef int (__stdcall *CfgImplicitTimingFn)(TaskHandle, int, unsigned __int64);
+typedef int (__stdcall *CreateCIPeriodChanFn)(TaskHandle, const char*, const char*, double, double, int, int, int, double, unsigned long, const char*);
+typedef int (__stdcall *SetCIPeriodTermFn)(TaskHandle, const char*, const char*);
+typedef int (__stdcall *TaskFn)(TaskHandle);
+typedef int (__stdcall *IsTaskDoneFn)(TaskHandle, unsigned long*);
+typedef int (__stdcall *WriteCtrFreqScalarFn)(TaskHandle, unsigned long, double, double, double, unsigned long*);
+typedef int (__stdcall *ReadCounterF64Fn)(TaskHandle, int, double, double*, unsigned long, int*, unsigned long*);
+typedef int (__stdcall *GetExtendedErrorInfoFn)(char*, unsigned long);
+
+/** @brief the functions of nicaiu.dll, all NULL if it or one of them is not there */
+static struct {
+	CreateTaskFn createTask;
+	CreateCOPulseChanFreqFn createCOPulseChanFreq;
+	CfgImplicitTimingFn cfgImplicitTiming;
+	CreateCIPeriodChanFn createCIPeriodChan;
+	SetCIPeriodTermFn setCIPeriodTerm;
+	TaskFn startTask;
+	TaskFn stopTask;
+	TaskFn clearTask;
+	IsTaskDoneFn isTaskDone;
+	WriteCtrFreqScalarFn writeCtrFreqScalar;
+	ReadCounterF64Fn readCounterF64;
+	GetExtendedErrorInfoFn getExtendedErrorInfo;
+} daqmx;
+
+static bool load_daqmx()
+{
+	if(daqmx.createTask) {
+		return true;
+	}
+
+	HMODULE h = LoadLibraryA("nicaiu.dll");
+	if(!h) {
+		return false;
+	}
+	daqmx.createCOPulseChanFreq = (CreateCOPulseChanFreqFn)GetProcAddress(h, "DAQmxCreateCOPulseChanFreq");
+	daqmx.cfgImplicitTiming = (CfgImplicitTimingFn)GetProcAddress(h, "DAQmxCfgImplicitTiming");
+	daqmx.createCIPeriodChan = (CreateCIPeriodChanFn)GetProcAddress(h, "DAQmxCreateCIPeriodChan");
+	daqmx.setCIPeriodTerm = (SetCIPeriodTermFn)GetProcAddress(h, "DAQmxSetCIPeriodTerm");
+	daqmx.startTask = (TaskFn)GetProcAddress(h, "DAQmxStartTask");
+	daqmx.stopTask = (TaskFn)GetProcAddress(h, "DAQmxStopTask");
+	daqmx.clearTask = (TaskFn)GetProcAddress(h, "DAQmxClearTask");
+	daqmx.isTaskDone = (IsTaskDoneFn)GetProcAddress(h, "DAQmxIsTaskDone");
+	daqmx.writeCtrFreqScalar = (WriteCtrFreqScalarFn)GetProcAddress(h, "DAQmxWriteCtrFreqScalar");
+	daqmx.readCounterF64 = (ReadCounterF64Fn)GetProcAddress(h, "DAQmxReadCounterF64");
+	daqmx.getExtendedErrorInfo = (GetExtendedErrorInfoFn)GetProcAddress(h, "DAQmxGetExtendedErrorInfo");
+	if(!daqmx.createCOPulseChanFreq || !daqmx.cfgImplicitTiming || !daqmx.createCIPeriodChan ||
+		!daqmx.setCIPeriodTerm || !daqmx.startTask || !daqmx.stopTask || !daqmx.clearTask ||
+		!daqmx.isTaskDone || !daqmx.writeCtrFreqScalar || !daqmx.readCounterF64 ||
+		!daqmx.getExtendedErrorInfo) {
+		return false;
+	}
+	// last, it tells the others are there
+	daqmx.createTask = (CreateTaskFn)GetProcAddress(h, "DAQmxCreateTask");
+	return daqmx.createTask != NULL;
+}
+
+TriggerSource::Config TriggerSource::defaults()
+{
+	Config cfg;
+
+	cfg.counter = "Dev4/ctr0";
+	cfg.stampCounter = NULL;
+	cfg.stampTerm = "/Dev4/Ctr0InternalOutput";
+	cfg.freq = 1000.;
+	cfg.duty = 0.5;
+	cfg.delay = 0.;
+	cfg.pulses = 0;
+
+	return cfg;
+}
+
+TriggerSource::TriggerSource() :
+	_pulse(0), _stamp(0), _freq(0.), _duty(0.), _changed(false),
+	_times(STAMPS), _stamped(0), _periods(STAMP_BUFFER)
+{
+	memset(&_cfg, 0, sizeof(_cfg));
+	_err[0] = '\0';
+}
+
+TriggerSource::~TriggerSource()
+{
+	close();
+}
+
+/** @brief keeps the error information of a failed call, returns true on success */
+bool TriggerSource::check(int rc, const char* what)
+{
+	if(rc >= 0) {
+		return true;
+	}
+
+	daqmx.getExtendedErrorInfo(_err, sizeof(_err));
+	printf("TriggerSource %s: %s\n", what, _err);
+	return false;
+}
+
+bool TriggerSource::open(const Config& cfg)
+{
+	close();
+	_cfg = cfg;
+	_freq = cfg.freq;
+	_duty = cfg.duty;
+
+	if(!load_daqmx()) {
+		strcpy_s(_err, sizeof(_err), "NI-DAQmx, nicaiu.dll, is not there");
+		printf("TriggerSource: %s\n", _err);
+		return false;
+	}
+
+	if(!check(daqmx.createTask("", &_pulse), "create pulse task") ||
+		!check(daqmx.createCOPulseChanFreq(_pulse, cfg.counter, "", DAQMX_VAL_HZ,
+			DAQMX_VAL_LOW, cfg.delay, cfg.freq, cfg.duty), "create pulse channel")) {
+		close();
+		return false;
+	}
+
+	if(cfg.pulses > 0) {
+		if(!check(daqmx.cfgImplicitTiming(_pulse, DAQMX_VAL_FINITE_SAMPS, cfg.pulses), "finite pulses")) {
+			close();
+			return false;
+		}
+	}
+	else if(!check(daqmx.cfgImplicitTiming(_pulse, DAQMX_VAL_CONT_SAMPS, PULSE_BUFFER), "continuous pulses")) {
+		close();
+		return false;
+	}
+
+	if(cfg.stampCounter == NULL) {
+		return true;
+	}
+
+	// every period of the train, on the timebase of the board
+	if(!check(daqmx.createTask("", &_stamp), "create stamp task") ||
+		!check(daqmx.createCIPeriodChan(_stamp, cfg.stampCounter, "", MIN_PERIOD, MAX_PERIOD,
+			DAQMX_VAL_SECONDS, DAQMX_VAL_RISING, DAQMX_VAL_LOW_FREQ_1_CTR, 0., 1, NULL), "create stamp channel") ||
+		!check(daqmx.setCIPeriodTerm(_stamp, cfg.stampCounter, cfg.stampTerm), "stamp terminal") ||
+		!check(daqmx.cfgImplicitTiming(_stamp, DAQMX_VAL_CONT_SAMPS, STAMP_BUFFER), "stamp timing")) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void TriggerSource::close()
+{
+	if(_pulse) {
+		daqmx.stopTask(_pulse);
+		daqmx.clearTask(_pulse);
+		_pulse = 0;
+	}
+
+	if(_stamp) {
+		daqmx.stopTask(_stamp);
+		daqmx.clearTask(_stamp);
+		_stamp = 0;
+	}
+}
+
+bool TriggerSource::start()
+{
+	if(!_pulse) {
+		return false;
+	}
+
+	_stamped = 0;
+	_changed = false;
+	resetJitter();
+
+	// the stamps have to be armed before the first pulse
+	if(_stamp && !check(daqmx.startTask(_stamp), "start stamps")) {
+		return false;
+	}
+
+	return check(daqmx.startTask(_pulse), "start pulses");
+}
+
+bool TriggerSource::stop()
+{
+	if(!_pulse) {
+		return false;
+	}
+
+	return check(daqmx.stopTask(_pulse), "stop pulses");
+}
+
+bool TriggerSource::done()
+{
+	unsigned long d = 0;
+
+	if(!_pulse) {
+		return false;
+	}
+
+	if(!check(daqmx.isTaskDone(_pulse, &d), "done")) {
+		return false;
+	}
+
+	return d != 0;
+}
+
+/**
+* The new frequency and duty are written to the running task and start with the
+* next pulse, the pulse in progress is not cut short.
+*/
+bool TriggerSource::setFrequency(double freq, double duty)
+{
+	if(!_pulse) {
+		return false;
+	}
+
+	if(!check(daqmx.writeCtrFreqScalar(_pulse, 0, TIMEOUT, freq, duty, NULL), "frequency")) {
+		return false;
+	}
+
+	_freq = freq;
+	_duty = duty;
+	_changed = true;
+	return true;
+}
+
+double TriggerSource::frequency() const
+{
+	return _freq;
+}
+
+/**
+* The first reading is the period from pulse 1 to pulse 2, so pulse 1 is time 0
+* and every reading adds the time of one more pulse.
+*/
+int TriggerSource::poll()
+{
+	int read = 0;
+	int i;
+
+	if(!_stamp) {
+		return 0;
+	}
+
+	if(!check(daqmx.readCounterF64(_stamp, DAQMX_VAL_AUTO, 0., &_periods[0],
+		static_cast<unsigned long> (_periods.size()), &read, NULL), "read stamps")) {
+		return -1;
+	}
+
+	if(read > 0 && _stamped == 0) {
+		_times[0] = 0.;
+		_stamped = 1;
+	}
+
+	for(i = 0; i < read; i++) {
+		_times[_stamped % STAMPS] = _times[(_stamped - 1) % STAMPS] + _periods[i];
+		_stamped++;
+	}
+
+	return read;
+}
+
+unsigned int TriggerSource::pulses() const
+{
+	return _stamped;
+}
+
+/**
+* Without a stamp counter the times are the nominal ones of the frequency, and
+* none is known once the frequency was changed.
+*/
+bool TriggerSource::stamp(unsigned int pulse, double& sec) const
+{
+	if(pulse == 0) {
+		return false;
+	}
+
+	if(!_stamp) {
+		if(_changed) {
+			return false;
+		}
+		sec = (pulse - 1) / _freq;
+		return true;
+	}
+
+	if(pulse > _stamped || _stamped - pulse >= STAMPS) {
+		return false;
+	}
+
+	sec = _times[(pulse - 1) % STAMPS];
+	return true;
+}
+
+/**
+* With hardware triggering image n of the grabber is the n-th pulse unless a pulse
+* was lost; poll() first so the stamp of the pulse is known.
+*/
+bool TriggerSource::frame(unsigned int pulse, double fg_us)
+{
+	double sec;
+
+	if(!stamp(pulse, sec)) {
+		return false;
+	}
+
+	_pairT.push_back(sec);
+	_pairD.push_back(fg_us - sec * 1e6);
+	return true;
+}
+
+/**
+* The least squares line of the delay over the time of the pulses takes out the
+* offset and the drift of the two clocks, what is left is the jitter.
+*/
+TriggerSource::Jitter TriggerSource::jitter() const
+{
+	Jitter j;
+	size_t i, n = _pairT.size();
+	double st = 0., sd = 0., stt = 0., stdd = 0., r, ss = 0.;
+
+	memset(&j, 0, sizeof(j));
+	j.n = static_cast<int> (n);
+	if(n == 0) {
+		return j;
+	}
+
+	for(i = 0; i < n; i++) {
+		st += _pairT[i];
+		sd += _pairD[i];
+		stt += _pairT[i] * _pairT[i];
+		stdd += _pairT[i] * _pairD[i];
+	}
+
+	double det = n * stt - st * st;
+	j.drift = (fabs(det) > 0.) ? (n * stdd - st * sd) / det : 0.;
+	j.offset = (sd - j.drift * st) / n;
+
+	j.min = j.max = _pairD[0] - j.offset - j.drift * _pairT[0];
+	for(i = 0; i < n; i++) {
+		r = _pairD[i] - j.offset - j.drift * _pairT[i];
+		ss += r * r;
+		if(r < j.min) {
+			j.min = r;
+		}
+		if(r > j.max) {
+			j.max = r;
+		}
+	}
+	j.std = sqrt(ss / n);
+
+	return j;
+}
+
+void TriggerSource::resetJitter()
+{
+	_pairT.clear();
+	_pairD.clear();
+}
+
+const char* TriggerSource::error() const
+{
+	return _err;
+}
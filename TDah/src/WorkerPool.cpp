@@ -0,0 +1,116 @@
+/**
+* @file WorkerPool.cpp
+*/
+
+#include <windows.h>
+#include "WorkerPool.h"
+
+/**
+* Creates threads - 1 worker threads, the calling thread is the last one.
+* A pool of 1 (or less) thread runs every job on the calling thread.
+*
+* @param[in] threads the number of parts jobs are split into
+*/
+
+WorkerPool::WorkerPool(int threads)
+{
+	_done = CreateEvent(NULL, FALSE, FALSE, NULL);
+	_pending = 0;
+	_quit = false;
+	_job = NULL;
+	_ctx = NULL;
+
+	for(int i = 1; i < threads; ++i) {
+		Worker w;
+		w.pool = this;
+		w.part = i;
+		w.go = CreateEvent(NULL, FALSE, FALSE, NULL);
+		w.thread = NULL;
+		_workers.push_back(w);
+	}
+
+	// the workers point into _workers, so it must not grow after this
+	for(size_t i = 0; i < _workers.size(); ++i) {
+		_workers[i].thread = CreateThread(NULL, 0, main, &_workers[i], 0, NULL);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	_quit = true;
+	for(size_t i = 0; i < _workers.size(); ++i) {
+		SetEvent(_workers[i].go);
+	}
+
+	for(size_t i = 0; i < _workers.size(); ++i) {
+		WaitForSingleObject(_workers[i].thread, INFINITE);
+		CloseHandle(_workers[i].thread);
+		CloseHandle(_workers[i].go);
+	}
+	CloseHandle(_done);
+}
+
+int WorkerPool::size() const
+{
+	return static_cast<int> (_workers.size()) + 1;
+}
+
+/**
+* Runs job(ctx, part, size()) for every part, part 0 on the calling thread.
+* Only one job can run at a time, so run() must not be called from a job.
+*
+* @param[in] job the function running one part
+* @param[in] ctx passed to every part
+*/
+
+void WorkerPool::run(Job job, void* ctx)
+{
+	int parts = size();
+
+	if(parts == 1) {
+		job(ctx, 0, 1);
+		return;
+	}
+
+	_job = job;
+	_ctx = ctx;
+	_pending = parts - 1;
+	MemoryBarrier();
+
+	for(size_t i = 0; i < _workers.size(); ++i) {
+		SetEvent(_workers[i].go);
+	}
+
+	job(ctx, 0, parts);
+	WaitForSingleObject(_done, INFINITE);
+	MemoryBarrier();
+}
+
+int WorkerPool::cores()
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return static_cast<int> (info.dwNumberOfProcessors);
+}
+
+/** @brief the loop run by every worker thread */
+unsigned long __stdcall WorkerPool::main(void* param)
+{
+	Worker* w = static_cast<Worker*> (param);
+	WorkerPool* pool = w->pool;
+
+	while(1) {
+		WaitForSingleObject(w->go, INFINITE);
+		if(pool->_quit) {
+			break;
+		}
+
+		pool->_job(pool->_ctx, w->part, pool->size());
+		if(InterlockedDecrement(&pool->_pending) == 0) {
+			SetEvent(pool->_done);
+		}
+	}
+
+	return 0;
+}
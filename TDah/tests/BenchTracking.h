@@ -0,0 +1,504 @@
+/** @file BenchTracking.h
+* @brief the benchmarks of the tracking pipeline
+*
+* This file is the input to the CxxTest script that is
+* used to create the BenchTracking.cpp file
+*
+* @note the BenchTracking.cpp file in the project is a place
+* holder for the auto-generatated .cpp file from CxxTest
+* using its python script.  This is done in V2K8 by running
+* a pre-build command in the build event properties setting.
+* The command (all on one line) executed is:
+ @verbatim
+  c:\cygwin\bin\python2.5.exe ../../tests/cxxtest/cxxtestgen.py
+  -o ../../tests/BenchTracking.cpp --gui=Win32Gui
+  --runner=ParenPrinter ../../tests/BenchTracking.h
+ @endverbatim
+*
+* where the relative directory is assumed to be from where the
+* Visual Studio project "Benchmark.vcproj" is located, which is currently
+* ./TDah/build/vs2k8.
+*
+* Every benchmark times a kernel on synthetic dot images after a few warmup
+* runs and traces its ns/dot and dots/s.  The ns/dot of a run are written
+* to BENCH_RESULTS, in the format of BENCH_BASELINE, and a benchmark that
+* is more than BENCH_TOLERANCE times slower than its baseline warns.  To
+* record a new baseline, run the Release build on the reference machine and
+* copy BENCH_RESULTS over BENCH_BASELINE.
+*/
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cxxtest/TestSuite.h>
+#include "Dots.h"
+#include "Camera.h"
+#include "Tracker.h"
+#include "WorkerPool.h"
+#include "TrackingAlgs/TrackDot.h"
+#include "TrackingAlgs/TrackTemplate.h"
+
+/** @brief the ns/dot every benchmark is compared with */
+#define BENCH_BASELINE "../../tests/BenchTracking.txt"
+/** @brief the ns/dot of this run */
+#define BENCH_RESULTS "BenchTracking.out"
+/** @brief the dot locations Tracker::load seeds the dots with */
+#define BENCH_DOTS "BenchTracking.dots"
+/** @brief how many times slower than its baseline a benchmark may be */
+#define BENCH_TOLERANCE 1.25
+
+using cv::Mat;
+using cv::Point2d;
+using cv::Point3d;
+using cv::Size;
+
+/** @brief a capture that returns the same synthetic image on every frame */
+class SyntheticCapture : public cv::VideoCapture
+{
+public:
+	virtual bool isOpened() const { return !img.empty(); };
+	virtual bool grab() { return isOpened(); };
+	virtual bool retrieve(cv::Mat& image, int ch = 0)
+	{
+		image = img;
+		return isOpened();
+	};
+	virtual double get(int prop) { return 0; };
+
+	cv::Mat img;
+};
+
+/** @brief one iteration of a benchmark */
+class Kernel
+{
+public:
+	virtual ~Kernel() {};
+	virtual void run() = 0;
+};
+
+/** @brief finds every dot with TrackingAlg::find without moving the dots */
+class FindKernel : public Kernel
+{
+public:
+	FindKernel(TrackingAlg& alg, const Mat& img, Dots& dots)
+		: alg(alg), img(img), dots(dots) {};
+
+	virtual void run()
+	{
+		Point2d p;
+		double area;
+		ActiveDots& a = dots.activeDots();
+
+		for(size_t i = 0; i < a.size(); ++i) {
+			alg.find(img, *a[i], p, area);
+		}
+	};
+
+	TrackingAlg& alg;
+	const Mat& img;
+	Dots& dots;
+};
+
+/** @brief converts a batch of pixels with Camera::pixelToWorld */
+class PixelKernel : public Kernel
+{
+public:
+	PixelKernel(Camera& cam, const std::vector<Point2d>& pixels)
+		: cam(cam), pixels(pixels), worlds(pixels.size()) {};
+
+	virtual void run()
+	{
+		cam.pixelToWorld(&pixels[0], &worlds[0], pixels.size());
+	};
+
+	Camera& cam;
+	const std::vector<Point2d>& pixels;
+	std::vector<Point3d> worlds;
+};
+
+/** @brief grabs a frame and tracks every dot with Tracker::track */
+class TrackKernel : public Kernel
+{
+public:
+	TrackKernel(Tracker& tracker, Camera& cam, Dots& dots)
+		: tracker(tracker), cam(cam), dots(dots), found(true) {};
+
+	virtual void run()
+	{
+		cam.grab(dots);
+		found = tracker.track(cam, dots) && found;
+	};
+
+	Tracker& tracker;
+	Camera& cam;
+	Dots& dots;
+	bool found;
+};
+
+/** @brief grabs a frame and tracks every dot from the blobs of the image with Tracker::trackFrame */
+class FrameKernel : public Kernel
+{
+public:
+	FrameKernel(Tracker& tracker, Camera& cam, Dots& dots)
+		: tracker(tracker), cam(cam), dots(dots), found(true) {};
+
+	virtual void run()
+	{
+		cam.grab(dots);
+		found = tracker.trackFrame(cam, dots) && found;
+	};
+
+	Tracker& tracker;
+	Camera& cam;
+	Dots& dots;
+	bool found;
+};
+
+/** @brief grabs a frame and finds every dot in the whole image with Tracker::location */
+class LocateKernel : public Kernel
+{
+public:
+	LocateKernel(Tracker& tracker, Camera& cam, Dots& dots)
+		: tracker(tracker), cam(cam), dots(dots), found(0) {};
+
+	virtual void run()
+	{
+		cam.grab(dots);
+		found = tracker.location(cam, dots);
+	};
+
+	Tracker& tracker;
+	Camera& cam;
+	Dots& dots;
+	int found;
+};
+
+/**
+* Draws cols x rows dark dots of radius r on a bright image, one in the
+* middle of every cell x cell square but off the pixel grid, and adds
+* gaussian noise of standard deviation noise.
+*/
+
+void dotImage(int cell, int cols, int rows, int r, double noise, Mat& img,
+			  std::vector<Point2d>& centers)
+{
+	Mat noisy, n;
+
+	img = Mat(rows * cell, cols * cell, CV_8UC1, cv::Scalar(220));
+	centers.clear();
+	for(int y = 0; y < rows; ++y) {
+		for(int x = 0; x < cols; ++x) {
+			Point2d c(x * cell + cell / 2 + 0.25, y * cell + cell / 2 + 0.5);
+
+			// draw at 1/16 of a pixel
+			cv::circle(img, cv::Point(cvRound(c.x * 16), cvRound(c.y * 16)),
+				r * 16, cv::Scalar(30), -1, CV_AA, 4);
+			centers.push_back(c);
+		}
+	}
+
+	if(noise > 0) {
+		n = Mat(img.size(), CV_16SC1);
+		cv::randn(n, cv::Scalar(0), cv::Scalar(noise));
+		img.convertTo(noisy, CV_16SC1);
+		noisy += n;
+		noisy.convertTo(img, CV_8UC1);
+	}
+}
+
+/** @brief makes one dot at every center and activates all of them */
+void seedDots(Camera& cam, Dots& dots, const std::vector<Point2d>& centers)
+{
+	Tracker tracker;
+	std::ofstream f(BENCH_DOTS);
+
+	for(size_t i = 0; i < centers.size(); ++i) {
+		f << centers[i].x << " " << centers[i].y << "\n";
+	}
+	f.close();
+
+	dots.makeDots(static_cast<int> (centers.size()));
+	tracker.load(cam, dots, BENCH_DOTS);
+	dots.makeAllDotsActive();
+	remove(BENCH_DOTS);
+}
+
+class BenchTrackingSuite : public CxxTest::TestSuite
+{
+public:
+	BenchTrackingSuite()
+	{
+		std::string line, name;
+		double ns;
+		std::ifstream f(BENCH_BASELINE);
+
+		// lines of "name ns", the name has no spaces, and # comments
+		while(std::getline(f, line)) {
+			std::stringstream ss(line);
+			if(line.empty() || line[0] == '#' || !(ss >> name >> ns)) {
+				continue;
+			}
+			_baseline[name] = ns;
+		}
+
+		std::ofstream out(BENCH_RESULTS);
+	}
+
+	void testFind( void )
+	{
+		int rois[] = {16, 32, 64};
+		double noises[] = {0, 8, 24};
+		int methods[] = {TrackDot::CIRCLE, TrackDot::CENTROID};
+		const char* names[] = {"circle", "centroid"};
+		std::vector<Point2d> centers;
+		Mat img;
+
+		for(int r = 0; r < 3; ++r) {
+			for(int n = 0; n < 3; ++n) {
+				Camera cam;
+				Dots dots;
+				TrackDot alg(rois[r], rois[r], CV_THRESH_BINARY_INV, 128, 1, rois[r] / 2);
+
+				dotImage(2 * rois[r], 8, 8, rois[r] / 4, noises[n], img, centers);
+				seedDots(cam, dots, centers);
+				alg.reserve(dots.size());
+
+				for(int m = 0; m < 2; ++m) {
+					std::stringstream name;
+					FindKernel k(alg, img, dots);
+
+					alg.method(methods[m]);
+					name << "find_" << names[m] << "_roi" << rois[r] << "_noise" << noises[n];
+					report(name.str(), time(k, 10, 200) / dots.size());
+				}
+			}
+		}
+	}
+
+	void testFindRefined( void )
+	{
+		double noises[] = {0, 8};
+		std::vector<Point2d> centers;
+		Mat img;
+
+		for(int n = 0; n < 2; ++n) {
+			Camera cam;
+			Dots dots;
+			TrackDot alg(16, 16, CV_THRESH_BINARY_INV, 128, 1, 8);
+			double err[2] = {0, 0};
+			Point2d p;
+			double area;
+
+			dotImage(32, 8, 8, 4, noises[n], img, centers);
+			seedDots(cam, dots, centers);
+			alg.reserve(dots.size());
+			ActiveDots& a = dots.activeDots();
+
+			// small dots in small rectangles, with and without the sub-pixel edge
+			for(int r = 0; r < 2; ++r) {
+				std::stringstream name;
+				FindKernel k(alg, img, dots);
+
+				alg.refine(r == 1);
+				for(size_t i = 0; i < a.size(); ++i) {
+					TS_ASSERT( alg.find(img, *a[i], p, area) );
+					err[r] += cv::norm(p - centers[a[i]->tag()]) / a.size();
+				}
+				name << "find_circle" << (r ? "_refined" : "") << "_roi16_noise" << noises[n];
+				report(name.str(), time(k, 10, 200) / dots.size());
+			}
+			TS_ASSERT_LESS_THAN( err[1], err[0] );
+		}
+	}
+
+	void testFindTemplate( void )
+	{
+		int rois[] = {40, 64};
+		int levels[] = {1, 2, 3};
+		double noises[] = {0, 8};
+		std::vector<Point2d> centers;
+		Mat img;
+
+		for(int r = 0; r < 2; ++r) {
+			for(int n = 0; n < 2; ++n) {
+				Camera cam;
+				Dots dots;
+
+				dotImage(2 * rois[r], 8, 8, rois[r] / 8, noises[n], img, centers);
+				seedDots(cam, dots, centers);
+
+				for(int l = 0; l < 3; ++l) {
+					std::stringstream name;
+					TrackTemplate alg(rois[r], rois[r], rois[r] / 2, rois[r] / 2, 0.7, levels[l]);
+					FindKernel k(alg, img, dots);
+					Point2d p;
+					double score;
+
+					// learn the templates before the timing
+					ActiveDots& a = dots.activeDots();
+					alg.reserve(dots.size());
+					for(size_t i = 0; i < a.size(); ++i) {
+						TS_ASSERT( alg.learn(ImageView(img), *a[i]) );
+					}
+					TS_ASSERT( alg.find(img, *a[0], p, score) );
+					TS_ASSERT_DELTA( p.x, centers[0].x, 0.5 );
+					TS_ASSERT_DELTA( p.y, centers[0].y, 0.5 );
+
+					name << "find_template_roi" << rois[r] << "_levels" << alg.levels()
+						<< "_noise" << noises[n];
+					report(name.str(), time(k, 10, 200) / dots.size());
+				}
+			}
+		}
+	}
+
+	void testPixelToWorld( void )
+	{
+		Camera cam;
+		double a[] = {800, 0, 320,
+					0, 800, 240,
+					0, 0, 1};
+		double k[] = {-0.2, 0.05, 0.001, -0.001, 0};
+		double t[] = {1, -2, 50};
+		std::vector<Point2d> pixels;
+
+		cam.setA(Mat(Camera::A_ROWS, Camera::A_COLS, Camera::TYPE, a));
+		cam.setK(Mat(Camera::K_ROWS, Camera::K_COLS, Camera::TYPE, k));
+		cam.setT(Mat(Camera::T_ROWS, Camera::T_COLS, Camera::TYPE, t));
+		for(int i = 0; i < 4096; ++i) {
+			pixels.push_back(Point2d((i * 37) % 640 + 0.3, (i * 91) % 480 + 0.7));
+		}
+
+		PixelKernel kernel(cam, pixels);
+		report("pixelToWorld_undistort", time(kernel, 10, 200) / pixels.size());
+
+		cam.undistortMap(Size(640, 480));
+		report("pixelToWorld_map", time(kernel, 10, 200) / pixels.size());
+	}
+
+	void testTrack( void )
+	{
+		int threads[] = {1, WorkerPool::cores()};
+		std::vector<Point2d> centers;
+		SyntheticCapture vc;
+
+		dotImage(64, 10, 8, 8, 8, vc.img, centers);
+		for(int i = 0; i < 2; ++i) {
+			std::stringstream name;
+			Camera cam(vc);
+			Dots dots;
+			TrackDot alg(32, 32, CV_THRESH_BINARY_INV, 128, 1, 16);
+			Tracker tracker(alg);
+
+			seedDots(cam, dots, centers);
+			tracker.parallel(threads[i]);
+
+			TrackKernel k(tracker, cam, dots);
+			name << "track_threads" << threads[i];
+			report(name.str(), time(k, 10, 200) / dots.size());
+			TS_ASSERT( k.found );
+		}
+	}
+
+	void testTrackFrame( void )
+	{
+		int threads[] = {1, WorkerPool::cores()};
+		std::vector<Point2d> centers;
+		SyntheticCapture vc;
+
+		dotImage(64, 10, 8, 8, 8, vc.img, centers);
+		for(int i = 0; i < 2; ++i) {
+			std::stringstream name;
+			Camera cam(vc);
+			Dots dots;
+			TrackDot alg(32, 32, CV_THRESH_BINARY_INV, 128, 1, 16);
+			Tracker tracker(alg);
+
+			seedDots(cam, dots, centers);
+			tracker.parallel(threads[i]);
+			tracker.detection(128, CV_THRESH_BINARY_INV, 16, 32);
+
+			FrameKernel k(tracker, cam, dots);
+			k.run();
+			TS_ASSERT( k.found );
+			TS_ASSERT_DELTA( dots.activeDots()[0]->pixelX(), centers[0].x, 0.5 );
+			TS_ASSERT_DELTA( dots.activeDots()[0]->pixelY(), centers[0].y, 0.5 );
+
+			name << "track_frame_threads" << threads[i];
+			report(name.str(), time(k, 10, 200) / dots.size());
+		}
+	}
+
+	void testLocate( void )
+	{
+		int threads[] = {1, WorkerPool::cores()};
+		std::vector<Point2d> centers, layout;
+		SyntheticCapture vc;
+
+		// the layout is off by a few pixels, like after the camera was bumped
+		dotImage(64, 10, 8, 8, 8, vc.img, centers);
+		for(size_t i = 0; i < centers.size(); ++i) {
+			layout.push_back(centers[i] + Point2d(6, -5));
+		}
+
+		for(int i = 0; i < 2; ++i) {
+			std::stringstream name;
+			Camera cam(vc);
+			Dots dots;
+			TrackDot alg(32, 32, CV_THRESH_BINARY_INV, 128, 1, 16);
+			Tracker tracker(alg);
+
+			seedDots(cam, dots, layout);
+			tracker.parallel(threads[i]);
+			tracker.detection(128, CV_THRESH_BINARY_INV, 16, 32);
+
+			LocateKernel k(tracker, cam, dots);
+			k.run();
+			TS_ASSERT_EQUALS( k.found, dots.size() );
+			TS_ASSERT_DELTA( dots.activeDots()[0]->pixelX(), centers[0].x, 0.5 );
+			TS_ASSERT_DELTA( dots.activeDots()[0]->pixelY(), centers[0].y, 0.5 );
+
+			name << "locate_threads" << threads[i];
+			report(name.str(), time(k, 2, 20) / dots.size());
+		}
+	}
+
+private:
+	std::map<std::string, double> _baseline;
+
+	/** @brief the ns one run of k takes, after warmup runs */
+	double time(Kernel& k, int warmup, int iters)
+	{
+		int64 start;
+
+		for(int i = 0; i < warmup; ++i) {
+			k.run();
+		}
+
+		start = cv::getTickCount();
+		for(int i = 0; i < iters; ++i) {
+			k.run();
+		}
+		return (cv::getTickCount() - start) * 1e9 / cv::getTickFrequency() / iters;
+	}
+
+	/** @brief traces, writes and checks the ns/dot of a benchmark */
+	void report(const std::string& name, double ns)
+	{
+		std::stringstream msg;
+		std::ofstream out(BENCH_RESULTS, std::ios::app);
+		std::map<std::string, double>::const_iterator b = _baseline.find(name);
+
+		out << name << " " << ns << "\n";
+		msg << name << ": " << ns << " ns/dot, " << 1e9 / ns << " dots/s";
+		TS_TRACE(msg.str().c_str());
+
+		if(b != _baseline.end() && ns > b->second * BENCH_TOLERANCE) {
+			msg << ", baseline " << b->second << " ns/dot";
+			TS_WARN(msg.str().c_str());
+		}
+	}
+};
@@ -20,9 +20,11 @@
 * ./TDah/build/vs2k8.
 */
 
+#include <fstream>
 #include <cxxtest/TestSuite.h>
 #include "Dots.h"
 #include "Camera.h"
+#include "Tracker.h"
 
 using cv::Point2f;
 using cv::Point3f;
@@ -172,4 +174,170 @@ public:
 
 		TS_ASSERT( !isSameCoord( cam ) );
 	}
+
+	void testBatchAndMapConversion( void )
+	{
+		using cv::Mat;
+		using cv::Point2d;
+		using cv::Point3d;
+		DummyCamera cam;
+		double a[] = {800, 0, 320,
+					0, 800, 240,
+					0, 0, 1};
+		double k[] = {-0.2, 0.05, 0.001, -0.001, 0};
+		double t[] = {1, -2, 50};
+		Point2d p[] = {Point2d(0, 0), Point2d(320.5, 240.25), Point2d(611.7, 13.2),
+					Point2d(700, 500)};
+		Point3d w[4], m[4];
+		const size_t n = sizeof(p) / sizeof(p[0]);
+
+		cam.setA(Mat(Camera::A_ROWS, Camera::A_COLS, Camera::TYPE, a));
+		cam.setK(Mat(Camera::K_ROWS, Camera::K_COLS, Camera::TYPE, k));
+		cam.setT(Mat(Camera::T_ROWS, Camera::T_COLS, Camera::TYPE, t));
+
+		// a batch gives the same points as one at a time
+		cam.pixelToWorld(p, w, n);
+		for(size_t i = 0; i < n; ++i) {
+			TS_ASSERT_DELTA(0, cv::norm(w[i] - cam.pixelToWorld(p[i])), 1e-9);
+		}
+
+		// the map is close to undistorting every point, (700, 500) is off the map
+		cam.undistortMap(cv::Size(640, 480));
+		cam.pixelToWorld(p, m, n);
+		for(size_t i = 0; i < n; ++i) {
+			TS_ASSERT_DELTA(0, cv::norm(w[i] - m[i]), 1e-3);
+		}
+		TS_ASSERT_EQUALS(w[3], m[3]);
+	}
+
+	void testUndistortTables( void )
+	{
+		using cv::Mat;
+		DummyCamera cam;
+		double a[] = {800, 0, 320,
+					0, 800, 240,
+					0, 0, 1};
+		double k[] = {-0.2, 0.05, 0.001, -0.001, 0};
+		cv::Rect roi(100, 50, 64, 32);
+		Mat img(480, 640, CV_8UC1), ref, all, part;
+
+		for(int y = 0; y < img.rows; ++y) {
+			for(int x = 0; x < img.cols; ++x) {
+				img.at<uchar>(y, x) = static_cast<uchar> ((x + 2 * y) / 8);
+			}
+		}
+		cam.setA(Mat(Camera::A_ROWS, Camera::A_COLS, Camera::TYPE, a));
+		cam.setK(Mat(Camera::K_ROWS, Camera::K_COLS, Camera::TYPE, k));
+
+		// the tables undistort like OpenCV, up to the rounding of fixed point
+		cv::undistort(img, ref, Mat(Camera::A_ROWS, Camera::A_COLS, Camera::TYPE, a),
+			Mat(Camera::K_ROWS, Camera::K_COLS, Camera::TYPE, k));
+		cam.undistort(img, all);
+		TS_ASSERT_LESS_THAN_EQUALS(cv::norm(ref, all, cv::NORM_INF), 1);
+
+		// a roi is that part of the whole image
+		cam.undistort(img, part, roi);
+		TS_ASSERT_EQUALS(part.cols, roi.width);
+		TS_ASSERT_EQUALS(part.rows, roi.height);
+		TS_ASSERT_EQUALS(cv::norm(part, all(roi), cv::NORM_INF), 0);
+	}
+
+	void testRayMeetsWorldPlane( void )
+	{
+		using cv::Mat;
+		using cv::Point2d;
+		using cv::Point3d;
+		DummyCamera cam;
+		double a[] = {800, 0, 320,
+					0, 800, 240,
+					0, 0, 1};
+		double k[] = {-0.2, 0.05, 0.001, -0.001, 0};
+		double r[] = {0, 1, 0,
+					1, 0, 0,
+					0, 0, -1};
+		double t[] = {1, -2, 50};
+		Point2d p(611.7, 13.2);
+		Point3d o, d, w;
+
+		cam.setA(Mat(Camera::A_ROWS, Camera::A_COLS, Camera::TYPE, a));
+		cam.setK(Mat(Camera::K_ROWS, Camera::K_COLS, Camera::TYPE, k));
+		cam.setR(Mat(Camera::R_ROWS, Camera::R_COLS, Camera::TYPE, r));
+		cam.setT(Mat(Camera::T_ROWS, Camera::T_COLS, Camera::TYPE, t));
+
+		// the ray is a unit vector that meets z = 0 where pixelToWorld puts the pixel
+		cam.ray(p, o, d);
+		TS_ASSERT_DELTA(1, cv::norm(d), 1e-9);
+		w = o - d * (o.z / d.z);
+		TS_ASSERT_DELTA(0, cv::norm(w - cam.pixelToWorld(p)), 1e-6);
+	}
+
+	void testSaveAndLoad( void )
+	{
+		using cv::Mat;
+		using cv::Point2d;
+		using cv::Point3d;
+		DummyCamera cam, copy, bad;
+		double a[] = {800, 0, 320,
+					0, 800, 240,
+					0, 0, 1};
+		double k[] = {-0.2, 0.05, 0.001, -0.001, 0};
+		double t[] = {1, -2, 50};
+		Point2d p[] = {Point2d(0, 0), Point2d(320.5, 240.25), Point2d(611.7, 13.2),
+					Point2d(700, 500)};
+		Point3d w[4], l[4];
+		const size_t n = sizeof(p) / sizeof(p[0]);
+
+		cam.setA(Mat(Camera::A_ROWS, Camera::A_COLS, Camera::TYPE, a));
+		cam.setK(Mat(Camera::K_ROWS, Camera::K_COLS, Camera::TYPE, k));
+		cam.setT(Mat(Camera::T_ROWS, Camera::T_COLS, Camera::TYPE, t));
+		cam.undistortMap(cv::Size(640, 480));
+
+		// the loaded camera converts exactly as the saved one, map included
+		TS_ASSERT( cam.save("camera.calib") );
+		TS_ASSERT( copy.load("camera.calib") );
+		cam.pixelToWorld(p, w, n);
+		copy.pixelToWorld(p, l, n);
+		for(size_t i = 0; i < n; ++i) {
+			TS_ASSERT_EQUALS(w[i], l[i]);
+		}
+
+		// a file of another format leaves the camera unchanged
+		std::ofstream out("camera.calib", std::ios::out | std::ios::binary);
+		out << "not a calibration";
+		out.close();
+		TS_ASSERT( !bad.load("camera.calib") );
+		TS_ASSERT( !bad.load("missing.calib") );
+		TS_ASSERT( isSameCoord( bad ) );
+		remove("camera.calib");
+	}
+
+	void testWorldOnRead( void )
+	{
+		using cv::Mat;
+		DummyCamera cam;
+		Tracker tracker;
+		Dots dots(2);
+		double a[] = {800, 0, 320,
+					0, 800, 240,
+					0, 0, 1};
+		double k[] = {-0.2, 0.05, 0.001, -0.001, 0};
+		double t[] = {1, -2, 50};
+
+		cam.setA(Mat(Camera::A_ROWS, Camera::A_COLS, Camera::TYPE, a));
+		cam.setK(Mat(Camera::K_ROWS, Camera::K_COLS, Camera::TYPE, k));
+		cam.setT(Mat(Camera::T_ROWS, Camera::T_COLS, Camera::TYPE, t));
+		dots.makeAllDotsActive();
+
+		std::ofstream out("dots.txt");
+		out << "611.7 13.2\n320.5 240.25\n";
+		out.close();
+		TS_ASSERT_EQUALS( tracker.load(cam, dots, "dots.txt"), 2 );
+		remove("dots.txt");
+
+		// the world locations are worked out when they are read, the same either way
+		ActiveDots& d = dots.activeDots();
+		TS_ASSERT_EQUALS( d[0]->world(), cam.pixelToWorld(d[0]->pixel()) );
+		TS_ASSERT_EQUALS( dots.worlds()[1], cam.pixelToWorld(dots.pixels()[1]) );
+		TS_ASSERT_EQUALS( d[1]->world(), dots.worlds()[1] );
+	}
 };
\ No newline at end of file
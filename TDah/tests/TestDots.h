@@ -22,6 +22,7 @@
 
 #include <cxxtest/TestSuite.h>
 #include "Dots.h"
+#include "DotsCodec.h"
 
 /**
 * Returns a count of the unique tag numbers created by makeDots().
@@ -182,4 +183,176 @@ public:
 		d.clearActiveDots();
 		TS_ASSERT( d.activeDots().empty() );
 	}
+
+	void testMakeDotInactive( void )
+	{
+		Dots d( 10 );
+		d.makeDotActive( 1 );
+		d.makeDotActive( 4 );
+		d.makeDotActive( 8 );
+
+		// the last active dot takes the place of the removed one
+		d.makeDotInactive( 1 );
+		ActiveDots& a = d.activeDots();
+		TS_ASSERT_EQUALS( a.size(), 2 );
+		TS_ASSERT( !d.isDotActive( 1 ) );
+		TS_ASSERT_EQUALS( a[0]->tag(), 8 );
+		TS_ASSERT_EQUALS( a[1]->tag(), 4 );
+
+		// removing an inactive dot does nothing, the rest still come out
+		d.makeDotInactive( 1 );
+		d.makeDotInactive( 4 );
+		TS_ASSERT_EQUALS( a.size(), 1 );
+		d.makeDotActive( 1 );
+		TS_ASSERT_EQUALS( a[1]->tag(), 1 );
+		d.makeDotInactive( 8 );
+		TS_ASSERT_EQUALS( a[0]->tag(), 1 );
+
+		d.clearActiveDots();
+		TS_ASSERT( a.empty() );
+		TS_ASSERT( !d.isDotActive( 1 ) );
+	}
+
+	void testNoHistory( void )
+	{
+		Dots d( 3 );
+		d.makeAllDotsActive();
+		ActiveDots& a = d.activeDots();
+
+		// a dot that was never tracked has no track, speed or prediction
+		TS_ASSERT_EQUALS( a[1]->historySize(), 0 );
+		TS_ASSERT_EQUALS( a[1]->timeStampAt( 0 ), -1 );
+		TS_ASSERT_EQUALS( a[1]->velocity(), cv::Point3d( 0, 0, 0 ) );
+		TS_ASSERT_EQUALS( a[1]->predictPixel( 100 ), a[1]->pixel() );
+	}
+
+	void testHistory( void )
+	{
+		Dots d( 3 );
+		d.makeAllDotsActive();
+		ActiveDots& a = d.activeDots();
+
+		// 0.5 apart, moving (2, 1) pixels and (4, -2, 0) world units per unit of time
+		for( int i = 0; i < 3; ++i ) {
+			d.pixel( 1 ) = cv::Point2d( 10 + i, 20 + 0.5 * i );
+			d.world( 1, cv::Point3d( 100 + 2 * i, 50 - i, 0 ) );
+			d.timeStamp( 1 ) = 0.5 * i;
+			d.found( 1 ) = true;
+			d.record( 1 );
+		}
+
+		TS_ASSERT_EQUALS( a[1]->historySize(), 3 );
+		TS_ASSERT_EQUALS( a[1]->timeStampAt( 0 ), 1.0 );
+		TS_ASSERT_EQUALS( a[1]->timeStampAt( 2 ), 0.0 );
+		TS_ASSERT_EQUALS( a[1]->pixelAt( 2 ), cv::Point2d( 10, 20 ) );
+		TS_ASSERT_EQUALS( a[1]->worldAt( 0 ), cv::Point3d( 104, 48, 0 ) );
+
+		TS_ASSERT_DELTA( a[1]->pixelVelocity().x, 2, 1e-9 );
+		TS_ASSERT_DELTA( a[1]->pixelVelocity().y, 1, 1e-9 );
+		TS_ASSERT_DELTA( a[1]->velocity().x, 4, 1e-9 );
+		TS_ASSERT_DELTA( a[1]->velocity().y, -2, 1e-9 );
+		TS_ASSERT_DELTA( a[1]->velocity().z, 0, 1e-9 );
+		TS_ASSERT_DELTA( a[1]->acceleration().x, 0, 1e-9 );
+
+		// half a unit of time after the newest location
+		cv::Point2d p = a[1]->predictPixel( 1.5 );
+		TS_ASSERT_DELTA( p.x, 13, 1e-9 );
+		TS_ASSERT_DELTA( p.y, 21.5, 1e-9 );
+
+		// a location that is not newer is not added
+		d.pixel( 1 ) = cv::Point2d( 0, 0 );
+		d.record( 1 );
+		TS_ASSERT_EQUALS( a[1]->historySize(), 3 );
+		TS_ASSERT_EQUALS( a[1]->pixelAt( 0 ), cv::Point2d( 12, 21 ) );
+
+		// the other dots have no track
+		TS_ASSERT_EQUALS( a[0]->historySize(), 0 );
+	}
+
+	void testAcquireAndReleaseDots( void )
+	{
+		Dots d( 3, 5 );
+		d.makeAllDotsActive();
+		ActiveDots& a = d.activeDots();
+		const Dot* first = a[0];
+
+		// the room beyond the first dots is free and not made active
+		TS_ASSERT_EQUALS( d.size(), 5 );
+		TS_ASSERT_EQUALS( d.freeDots(), 2 );
+		TS_ASSERT_EQUALS( a.size(), 3 );
+		TS_ASSERT( !d.isDotUsed( 3 ) );
+
+		// a new dot gets the lowest free tag, active at its pixel location
+		int tag = d.acquireDot( cv::Point2d( 12, 34 ) );
+		TS_ASSERT_EQUALS( tag, 3 );
+		TS_ASSERT( d.isDotActive( tag ) );
+		TS_ASSERT_EQUALS( d.activeDots().back()->pixel(), cv::Point2d( 12, 34 ) );
+		TS_ASSERT_EQUALS( d.activeDots().back()->historySize(), 0 );
+
+		// a released tag is handed out again, the other dots stay where they are
+		d.releaseDot( 1 );
+		TS_ASSERT( !d.isDotActive( 1 ) );
+		TS_ASSERT( !d.isDotUsed( 1 ) );
+		d.makeDotActive( 1 );
+		TS_ASSERT( !d.isDotActive( 1 ) );
+		TS_ASSERT_EQUALS( d.acquireDot( cv::Point2d( 5, 6 ) ), 1 );
+		TS_ASSERT_EQUALS( d.acquireDot( cv::Point2d( 7, 8 ) ), 4 );
+		TS_ASSERT_EQUALS( d.acquireDot( cv::Point2d( 9, 9 ) ), BAD_TAG );
+		TS_ASSERT_EQUALS( a[0], first );
+		TS_ASSERT_EQUALS( a.size(), 5 );
+
+		// releasing a free tag does nothing
+		d.releaseDot( 4 );
+		d.releaseDot( 4 );
+		TS_ASSERT_EQUALS( d.freeDots(), 1 );
+	}
+
+	void testCopyDots( void )
+	{
+		Dots d( 20 );
+		d.makeDotActive( 3 );
+		d.makeDotActive( 11 );
+
+		// the copy has its own views, active set and fields
+		Dots c( d );
+		TS_ASSERT_EQUALS( c.activeDots().size(), 2 );
+		TS_ASSERT( c.isDotActive( 11 ) );
+		TS_ASSERT( !c.isDotActive( 4 ) );
+		TS_ASSERT_DIFFERS( c.activeDots()[0], d.activeDots()[0] );
+		TS_ASSERT_EQUALS( c.activeDots()[1]->tag(), 11 );
+		TS_ASSERT_EQUALS( c.pixels()[11].x, d.pixels()[11].x );
+
+		d.clearActiveDots();
+		TS_ASSERT( c.activeDots()[0]->isActive() );
+		TS_ASSERT_EQUALS( c.size(), 20 );
+	}
+
+	void testCodecSnapshots( void )
+	{
+		Dots d( 10 ), r( 10 );
+		DotsCodec enc, dec, late;
+		std::vector<unsigned char> buf( DotsCodec::maxSize( 10 ) );
+		d.makeDotActive( 2 );
+		d.makeDotActive( 7 );
+
+		// a full snapshot gives the active set back
+		size_t full = enc.encode( d, &buf[0], buf.size() );
+		TS_ASSERT( full > 0 );
+		TS_ASSERT_EQUALS( DotsCodec::snapshotSize( &buf[0], full ), full );
+		TS_ASSERT( dec.decode( &buf[0], full, r ) );
+		TS_ASSERT_EQUALS( r.activeDots().size(), 2 );
+		TS_ASSERT( r.isDotActive( 7 ) );
+		TS_ASSERT_EQUALS( r.pixels()[7].x, d.pixels()[7].x );
+
+		// unchanged dots are a tag and the fields byte in a delta
+		size_t delta = enc.encode( d, &buf[0], buf.size(), true );
+		TS_ASSERT( delta < full );
+		TS_ASSERT( dec.decode( &buf[0], delta, r ) );
+
+		// a delta without the snapshot before it is refused
+		delta = enc.encode( d, &buf[0], buf.size(), true );
+		TS_ASSERT( !late.decode( &buf[0], delta, r ) );
+		TS_ASSERT( !dec.decode( &buf[0], delta - 1, r ) );
+		TS_ASSERT_EQUALS( enc.encode( d, &buf[0], 8 ), 0 );
+	}
 };